@@ -22,6 +22,13 @@
 // Given a byte array, returns an NSString containing those bytes encoded in Base64 encoding.
 FBSDK_EXTERN NSString *FBEncodeBase64(NSData *data);
 
+// The number of characters FBEncodeBase64ToBuffer writes for length bytes of input.
+FBSDK_EXTERN size_t FBEncodeBase64Length(size_t length);
+
+// Encodes length bytes into buffer, which must hold at least FBEncodeBase64Length(length)
+// characters.  No terminating NUL is written.  Returns the number of characters written.
+FBSDK_EXTERN size_t FBEncodeBase64ToBuffer(const void *bytes, size_t length, char *buffer);
+
 // Given a Base64-encoded string, decodes the string and returns an
 // NSData containing the decoded bytes.
 FBSDK_EXTERN NSData *FBDecodeBase64(NSString *base64);
@@ -61,6 +61,11 @@
 
 #import "FBBase64.h"
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define FB_BASE64_NEON 1
+#endif
+
 static const char _base64EncodingTable[64] =
 "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 static const short _base64DecodingTable[256] = {
@@ -82,18 +87,94 @@ static const short _base64DecodingTable[256] = {
     -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2
 };
 
-NSString *FBEncodeBase64(NSData *objData) {
-    const unsigned char *objRawData = [objData bytes];
-    char *objPointer;
-    char *strResult;
+#if FB_BASE64_NEON
+// Encodes whole 48 byte blocks, sixteen groups of three bytes at a time, and returns
+// how many input bytes it consumed.  The tail is left to the scalar loop.
+static size_t FBEncodeBase64BlocksNEON(const unsigned char *input, size_t length, char *output) {
+    const uint8x16x4_t table = vld1q_u8_x4((const uint8_t *)_base64EncodingTable);
+    const uint8x16_t lowSixBits = vdupq_n_u8(0x3f);
+    size_t consumed = 0;
+    while (length - consumed >= 48) {
+        uint8x16x3_t in = vld3q_u8(input + consumed);
+        uint8x16x4_t indexes;
+        indexes.val[0] = vshrq_n_u8(in.val[0], 2);
+        indexes.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), lowSixBits);
+        indexes.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), lowSixBits);
+        indexes.val[3] = vandq_u8(in.val[2], lowSixBits);
 
-    // Get the Raw Data length and ensure we actually have data
-    size_t intLength = [objData length];
-    if (intLength == 0) return @"";
+        uint8x16x4_t out;
+        out.val[0] = vqtbl4q_u8(table, indexes.val[0]);
+        out.val[1] = vqtbl4q_u8(table, indexes.val[1]);
+        out.val[2] = vqtbl4q_u8(table, indexes.val[2]);
+        out.val[3] = vqtbl4q_u8(table, indexes.val[3]);
+        vst4q_u8((uint8_t *)output, out);
 
-    // Setup the String-based Result placeholder and pointer within that placeholder
-    strResult = (char *)calloc(((intLength + 2) / 3) * 4, sizeof(char));
-    objPointer = strResult;
+        consumed += 48;
+        output += 64;
+    }
+    return consumed;
+}
+
+// Decodes leading 64 character blocks made up only of alphabet characters, and returns how
+// many characters it consumed.  It stops at the first block holding whitespace, padding or
+// anything invalid, which the scalar loop then handles with its usual rules.
+static size_t FBDecodeBase64BlocksNEON(const char *input, size_t length, unsigned char *output) {
+    static uint8_t decodingTable[128];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (int c = 0; c < 128; c++) {
+            short value = _base64DecodingTable[c];
+            decodingTable[c] = value < 0 ? 0xff : (uint8_t)value;
+        }
+    });
+    const uint8x16x4_t lowTable = vld1q_u8_x4(decodingTable);
+    const uint8x16x4_t highTable = vld1q_u8_x4(decodingTable + 64);
+    const uint8x16_t sixtyFour = vdupq_n_u8(64);
+    const uint8x16_t nonASCII = vdupq_n_u8(0x80);
+
+    size_t consumed = 0;
+    while (length - consumed >= 64) {
+        uint8x16x4_t in = vld4q_u8((const uint8_t *)input + consumed);
+        uint8x16x4_t values;
+        uint8x16_t invalid = vdupq_n_u8(0);
+        for (int k = 0; k < 4; k++) {
+            // indexes past the end of a table look up as zero, so each half only answers for its range
+            uint8x16_t c = in.val[k];
+            values.val[k] = vorrq_u8(vqtbl4q_u8(lowTable, c), vqtbl4q_u8(highTable, vsubq_u8(c, sixtyFour)));
+            invalid = vorrq_u8(invalid, vorrq_u8(values.val[k], vandq_u8(c, nonASCII)));
+        }
+        if (vmaxvq_u8(invalid) > 0x3f) {
+            break;
+        }
+
+        uint8x16x3_t out;
+        out.val[0] = vorrq_u8(vshlq_n_u8(values.val[0], 2), vshrq_n_u8(values.val[1], 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(values.val[1], 4), vshrq_n_u8(values.val[2], 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(values.val[2], 6), values.val[3]);
+        vst3q_u8(output, out);
+
+        consumed += 64;
+        output += 48;
+    }
+    return consumed;
+}
+#endif
+
+size_t FBEncodeBase64Length(size_t length) {
+    return ((length + 2) / 3) * 4;
+}
+
+size_t FBEncodeBase64ToBuffer(const void *bytes, size_t length, char *buffer) {
+    const unsigned char *objRawData = bytes;
+    char *objPointer = buffer;
+    size_t intLength = length;
+
+#if FB_BASE64_NEON
+    size_t vectorized = FBEncodeBase64BlocksNEON(objRawData, intLength, objPointer);
+    objRawData += vectorized;
+    objPointer += vectorized / 3 * 4;
+    intLength -= vectorized;
+#endif
 
     // Iterate through everything
     while (intLength > 2) { // keep going until we have less than 24 bits
@@ -121,8 +202,20 @@ NSString *FBEncodeBase64(NSData *objData) {
         }
     }
 
+    return objPointer - buffer;
+}
+
+NSString *FBEncodeBase64(NSData *objData) {
+    // Get the Raw Data length and ensure we actually have data
+    size_t intLength = [objData length];
+    if (intLength == 0) return @"";
+
+    // Setup the String-based Result placeholder
+    char *strResult = (char *)malloc(FBEncodeBase64Length(intLength));
+    size_t written = FBEncodeBase64ToBuffer([objData bytes], intLength, strResult);
+
     NSString *strToReturn = [[NSString alloc] initWithBytesNoCopy:strResult
-                                                           length:objPointer - strResult
+                                                           length:written
                                                          encoding:NSASCIIStringEncoding
                                                      freeWhenDone:YES];
     return [strToReturn autorelease];
@@ -138,6 +231,15 @@ NSData *FBDecodeBase64(NSString *strBase64) {
     unsigned char *objResult;
     objResult = calloc(intLength, sizeof(unsigned char));
 
+#if FB_BASE64_NEON
+    // Whole blocks of plain alphabet characters leave the state below where a
+    // fresh start would (i % 4 == 0), so the scalar loop just carries on after them
+    size_t vectorized = FBDecodeBase64BlocksNEON(objPointer, intLength, objResult);
+    objPointer += vectorized;
+    intLength -= vectorized;
+    j = (int)(vectorized / 4 * 3);
+#endif
+
     // Run through the whole string, converting as we go
     while ( ((intCurrent = *objPointer++) != '\0') && (intLength-- > 0)) {
         if (intCurrent == '=') {
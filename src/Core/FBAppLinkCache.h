@@ -0,0 +1,70 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+#import "FBMemoryBudget.h"
+
+@class BFAppLink;
+
+typedef void (^FBAppLinkCacheLookupHandler)(NSDictionary *appLinks);
+
+// Resolved app links, shared by every FBAppLinkResolver so that a URL is resolved
+// once rather than once per resolver.  Links are kept per user interface idiom, since
+// that decides which targets were asked for.  The most recently used countLimit links
+// are held in memory; with persistsLinks set they also go to the disk cache, so they
+// survive relaunches.  Entries expire after timeToLive.  Failed lookups can be remembered
+// too, in memory only, so a failing URL isn't retried on every resolve.  Memory is shed
+// under FBMemoryBudget, least recently used links first.
+@interface FBAppLinkCache : NSObject <FBMemoryBudgetClient>
+
++ (FBAppLinkCache *)sharedCache;
+
+@property (nonatomic, assign) NSTimeInterval timeToLive;
+// How long to keep links for URLs that have no app link metadata; those are more
+// likely to gain some, and are cheap to ask about again now and then.
+@property (nonatomic, assign) NSTimeInterval negativeTimeToLive;
+// How long a lookup the server turned down is remembered; other failures aren't.
+@property (nonatomic, assign) NSTimeInterval errorTimeToLive;
+@property (nonatomic, assign) NSUInteger countLimit;
+@property (nonatomic, assign) BOOL persistsLinks;
+
+// The link held in memory for url, or nil if there isn't one or it has expired.
+- (BFAppLink *)appLinkForURL:(NSURL *)url idiom:(UIUserInterfaceIdiom)idiom;
+
+// Looks the URLs up on disk, off the calling thread, and hands the ones found, keyed by
+// URL, to the handler on the main thread.  Links found are also kept in memory.  Without
+// persistsLinks, the handler is given an empty dictionary straight away.
+- (void)persistedAppLinksForURLs:(NSArray *)urls
+                           idiom:(UIUserInterfaceIdiom)idiom
+                      completion:(FBAppLinkCacheLookupHandler)handler;
+
+- (void)setAppLink:(BFAppLink *)appLink forURL:(NSURL *)url idiom:(UIUserInterfaceIdiom)idiom;
+- (void)setAppLink:(BFAppLink *)appLink
+            forURL:(NSURL *)url
+             idiom:(UIUserInterfaceIdiom)idiom
+        timeToLive:(NSTimeInterval)timeToLive;
+
+// The error the last lookup of url failed with, if that was less than errorTimeToLive ago.
+- (NSError *)errorForURL:(NSURL *)url idiom:(UIUserInterfaceIdiom)idiom;
+- (void)setError:(NSError *)error forURL:(NSURL *)url idiom:(UIUserInterfaceIdiom)idiom;
+
+// Forgets the links and errors held in memory; anything persisted stays until it expires.
+- (void)removeAllAppLinks;
+
+@end
@@ -0,0 +1,296 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBAppLinkCache.h"
+
+#import <Bolts/BFAppLink.h>
+#import <Bolts/BFAppLinkTarget.h>
+
+#import "FBDataDiskCache.h"
+#import "FBUtility.h"
+
+static const NSTimeInterval kDefaultTimeToLive = 24 * 60 * 60;
+static const NSTimeInterval kDefaultNegativeTimeToLive = 60 * 60;
+static const NSTimeInterval kDefaultErrorTimeToLive = 60;
+static const NSUInteger kDefaultCountLimit = 500;
+// Rough size of an entry, a few URLs and strings, for FBMemoryBudget
+static const NSUInteger kEstimatedEntryCost = 512;
+
+static NSString *const kPersistedExpiryKey = @"expires";
+static NSString *const kPersistedWebURLKey = @"web";
+static NSString *const kPersistedTargetsKey = @"targets";
+static NSString *const kPersistedTargetURLKey = @"url";
+static NSString *const kPersistedTargetAppStoreIdKey = @"app_store_id";
+static NSString *const kPersistedTargetAppNameKey = @"app_name";
+
+static NSString *FBAppLinkCacheKey(NSURL *url, UIUserInterfaceIdiom idiom) {
+    return [NSString stringWithFormat:@"%ld|%@", (long)idiom, url.absoluteString];
+}
+
+// Where the link is kept in the disk cache, which is keyed by URL
+static NSURL *FBAppLinkCacheDiskURL(NSURL *url, UIUserInterfaceIdiom idiom) {
+    return [NSURL URLWithString:[NSString stringWithFormat:@"fbapplink://cache/%ld?url=%@",
+                                 (long)idiom,
+                                 [FBUtility stringByURLEncodingString:url.absoluteString]]];
+}
+
+static NSData *FBAppLinkCacheEncode(BFAppLink *appLink, NSTimeInterval expiry) {
+    NSMutableArray *targets = [NSMutableArray arrayWithCapacity:appLink.targets.count];
+    for (BFAppLinkTarget *target in appLink.targets) {
+        NSMutableDictionary *persistedTarget = [NSMutableDictionary dictionary];
+        persistedTarget[kPersistedTargetURLKey] = target.URL.absoluteString ?: @"";
+        if (target.appStoreId) {
+            persistedTarget[kPersistedTargetAppStoreIdKey] = target.appStoreId;
+        }
+        if (target.appName) {
+            persistedTarget[kPersistedTargetAppNameKey] = target.appName;
+        }
+        [targets addObject:persistedTarget];
+    }
+
+    NSMutableDictionary *persisted = [NSMutableDictionary dictionary];
+    persisted[kPersistedExpiryKey] = @(expiry);
+    persisted[kPersistedTargetsKey] = targets;
+    if (appLink.webURL) {
+        persisted[kPersistedWebURLKey] = appLink.webURL.absoluteString;
+    }
+    return [NSJSONSerialization dataWithJSONObject:persisted options:0 error:nil];
+}
+
+// Returns nil for anything unreadable or expired
+static BFAppLink *FBAppLinkCacheDecode(NSData *data, NSURL *url, NSTimeInterval *expiry) {
+    NSDictionary *persisted = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+    if (![persisted isKindOfClass:[NSDictionary class]]) {
+        return nil;
+    }
+    *expiry = [persisted[kPersistedExpiryKey] doubleValue];
+    if (*expiry < [NSDate timeIntervalSinceReferenceDate]) {
+        return nil;
+    }
+
+    NSMutableArray *targets = [NSMutableArray array];
+    for (NSDictionary *persistedTarget in persisted[kPersistedTargetsKey]) {
+        [targets addObject:[BFAppLinkTarget appLinkTargetWithURL:[NSURL URLWithString:persistedTarget[kPersistedTargetURLKey]]
+                                                      appStoreId:persistedTarget[kPersistedTargetAppStoreIdKey]
+                                                         appName:persistedTarget[kPersistedTargetAppNameKey]]];
+    }
+    NSString *webURLString = persisted[kPersistedWebURLKey];
+    return [BFAppLink appLinkWithSourceURL:url
+                                   targets:targets
+                                    webURL:webURLString ? [NSURL URLWithString:webURLString] : nil];
+}
+
+@interface FBAppLinkCacheEntry : NSObject
+
+// Exactly one of appLink and error is set
+@property (nonatomic, retain) BFAppLink *appLink;
+@property (nonatomic, retain) NSError *error;
+@property (nonatomic, assign) NSTimeInterval expiry;
+@property (nonatomic, assign) NSTimeInterval lastAccess;
+
+@end
+
+@implementation FBAppLinkCacheEntry
+
+- (void)dealloc {
+    [_appLink release];
+    [_error release];
+    [super dealloc];
+}
+
+@end
+
+@implementation FBAppLinkCache {
+    NSMutableDictionary *_entries;
+}
+
++ (FBAppLinkCache *)sharedCache {
+    static FBAppLinkCache *_instance;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBAppLinkCache alloc] init];
+    });
+
+    return _instance;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _entries = [[NSMutableDictionary alloc] init];
+        _timeToLive = kDefaultTimeToLive;
+        _negativeTimeToLive = kDefaultNegativeTimeToLive;
+        _errorTimeToLive = kDefaultErrorTimeToLive;
+        _countLimit = kDefaultCountLimit;
+        _persistsLinks = YES;
+
+        [[FBMemoryBudget sharedBudget] registerClient:self priority:FBMemoryBudgetPriorityDefault];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[FBMemoryBudget sharedBudget] unregisterClient:self];
+    [_entries release];
+    [super dealloc];
+}
+
+- (BFAppLink *)appLinkForURL:(NSURL *)url idiom:(UIUserInterfaceIdiom)idiom {
+    return [[[self entryForURL:url idiom:idiom].appLink retain] autorelease];
+}
+
+- (NSError *)errorForURL:(NSURL *)url idiom:(UIUserInterfaceIdiom)idiom {
+    return [[[self entryForURL:url idiom:idiom].error retain] autorelease];
+}
+
+- (FBAppLinkCacheEntry *)entryForURL:(NSURL *)url idiom:(UIUserInterfaceIdiom)idiom {
+    NSString *key = FBAppLinkCacheKey(url, idiom);
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    @synchronized(self) {
+        FBAppLinkCacheEntry *entry = [_entries objectForKey:key];
+        if (!entry) {
+            return nil;
+        }
+        if (entry.expiry < now) {
+            [_entries removeObjectForKey:key];
+            return nil;
+        }
+        entry.lastAccess = now;
+        return [[entry retain] autorelease];
+    }
+}
+
+- (void)persistedAppLinksForURLs:(NSArray *)urls
+                           idiom:(UIUserInterfaceIdiom)idiom
+                      completion:(FBAppLinkCacheLookupHandler)handler {
+    NSMutableDictionary *appLinks = [NSMutableDictionary dictionary];
+    if (!self.persistsLinks || urls.count == 0) {
+        handler(appLinks);
+        return;
+    }
+
+    // The disk cache calls back on the main thread, so appLinks is only touched there
+    FBDataDiskCache *diskCache = [FBDataDiskCache sharedCache];
+    dispatch_group_t group = dispatch_group_create();
+    for (NSURL *url in urls) {
+        NSURL *diskURL = FBAppLinkCacheDiskURL(url, idiom);
+        dispatch_group_enter(group);
+        [diskCache dataForURL:diskURL completion:^(NSData *data) {
+            NSTimeInterval expiry = 0;
+            BFAppLink *appLink = FBAppLinkCacheDecode(data, url, &expiry);
+            if (appLink) {
+                appLinks[url] = appLink;
+                [self keepEntryWithAppLink:appLink error:nil forKey:FBAppLinkCacheKey(url, idiom) expiry:expiry];
+            } else if (data) {
+                [diskCache removeDataForUrl:diskURL];
+            }
+            dispatch_group_leave(group);
+        }];
+    }
+    handler = [handler copy];
+    dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+        handler(appLinks);
+        [handler release];
+    });
+    dispatch_release(group);
+}
+
+- (void)setAppLink:(BFAppLink *)appLink forURL:(NSURL *)url idiom:(UIUserInterfaceIdiom)idiom {
+    [self setAppLink:appLink forURL:url idiom:idiom timeToLive:self.timeToLive];
+}
+
+- (void)setAppLink:(BFAppLink *)appLink
+            forURL:(NSURL *)url
+             idiom:(UIUserInterfaceIdiom)idiom
+        timeToLive:(NSTimeInterval)timeToLive {
+    if (!appLink || !url) {
+        return;
+    }
+    NSTimeInterval expiry = [NSDate timeIntervalSinceReferenceDate] + timeToLive;
+    [self keepEntryWithAppLink:appLink error:nil forKey:FBAppLinkCacheKey(url, idiom) expiry:expiry];
+
+    if (self.persistsLinks) {
+        NSData *data = FBAppLinkCacheEncode(appLink, expiry);
+        if (data) {
+            [[FBDataDiskCache sharedCache] setData:data forURL:FBAppLinkCacheDiskURL(url, idiom)];
+        }
+    }
+}
+
+- (void)setError:(NSError *)error forURL:(NSURL *)url idiom:(UIUserInterfaceIdiom)idiom {
+    if (!error || !url || self.errorTimeToLive <= 0) {
+        return;
+    }
+    NSTimeInterval expiry = [NSDate timeIntervalSinceReferenceDate] + self.errorTimeToLive;
+    [self keepEntryWithAppLink:nil error:error forKey:FBAppLinkCacheKey(url, idiom) expiry:expiry];
+}
+
+- (void)removeAllAppLinks {
+    @synchronized(self) {
+        [_entries removeAllObjects];
+    }
+}
+
+- (void)keepEntryWithAppLink:(BFAppLink *)appLink
+                       error:(NSError *)error
+                      forKey:(NSString *)key
+                      expiry:(NSTimeInterval)expiry {
+    FBAppLinkCacheEntry *entry = [[[FBAppLinkCacheEntry alloc] init] autorelease];
+    entry.appLink = appLink;
+    entry.error = error;
+    entry.expiry = expiry;
+    entry.lastAccess = [NSDate timeIntervalSinceReferenceDate];
+    @synchronized(self) {
+        [_entries setObject:entry forKey:key];
+        NSUInteger countLimit = self.countLimit;
+        if (_entries.count > countLimit) {
+            // drop the least recently used quarter, so this doesn't happen on every insertion
+            [self trimToCount:MAX(countLimit * 3 / 4, 1)];
+        }
+    }
+    [[FBMemoryBudget sharedBudget] clientDidGrow:self];
+}
+
+// Must be called while synchronized on self
+- (void)trimToCount:(NSUInteger)keepCount {
+    if (_entries.count <= keepCount) {
+        return;
+    }
+    NSArray *keys = [_entries keysSortedByValueUsingComparator:^NSComparisonResult(FBAppLinkCacheEntry *a, FBAppLinkCacheEntry *b) {
+        if (a.lastAccess == b.lastAccess) {
+            return NSOrderedSame;
+        }
+        return a.lastAccess < b.lastAccess ? NSOrderedAscending : NSOrderedDescending;
+    }];
+    [_entries removeObjectsForKeys:[keys subarrayWithRange:NSMakeRange(0, keys.count - keepCount)]];
+}
+
+#pragma mark - FBMemoryBudgetClient
+
+- (NSUInteger)memoryBudgetCost {
+    @synchronized(self) {
+        return _entries.count * kEstimatedEntryCost;
+    }
+}
+
+- (void)shedMemoryToCost:(NSUInteger)cost {
+    @synchronized(self) {
+        [self trimToCount:cost / kEstimatedEntryCost];
+    }
+}
+
+@end
@@ -19,6 +19,9 @@
 @interface FBAudioResourceLoader : NSObject
 
 + (instancetype)sharedLoader;
+// Loads the shared loader on a background queue, so that its first playSound doesn't wait
+// for file I/O or audio setup.  Only the first call for each sound does anything.
++ (void)preload;
 
 - (BOOL)loadSound:(NSError **)error;
 - (void)playSound;
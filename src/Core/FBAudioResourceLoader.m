@@ -16,10 +16,23 @@
 
 #import "FBAudioResourceLoader.h"
 
+#import "FBDispatch.h"
 #import "FBDynamicFrameworkLoader.h"
 #import "FBLogger.h"
 #import "FBSettings.h"
 
+// System sounds by name and version, shared by every loader of the same sound, so that each is
+// written out and set up once per process.  Guarded by @synchronized on the dictionary.
+static NSMutableDictionary *FBAudioResourceLoaderSystemSoundIDs(void)
+{
+    static NSMutableDictionary *_systemSoundIDs = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _systemSoundIDs = [[NSMutableDictionary alloc] init];
+    });
+    return _systemSoundIDs;
+}
+
 @implementation FBAudioResourceLoader
 {
     NSFileManager *_fileManager;
@@ -56,6 +69,26 @@
     return loader;
 }
 
++ (void)preload
+{
+    static NSMutableSet *_preloadedNames = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _preloadedNames = [[NSMutableSet alloc] init];
+    });
+
+    NSString *name = [self name];
+    @synchronized(_preloadedNames) {
+        if (!name || [_preloadedNames containsObject:name]) {
+            return;
+        }
+        [_preloadedNames addObject:name];
+    }
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneUtility), ^{
+        [self sharedLoader];
+    });
+}
+
 #pragma mark - Object Lifecycle
 
 - (instancetype)init
@@ -68,8 +101,7 @@
 
 - (void)dealloc
 {
-    fbdfl_AudioServicesDisposeSystemSoundID(_systemSoundID);
-
+    // the system sound is shared, and kept for as long as the process runs
     [_fileManager release];
     [_fileURL release];
     [super dealloc];
@@ -79,17 +111,31 @@
 
 - (BOOL)loadSound:(NSError **)errorRef
 {
-    NSURL *fileURL = [self _fileURL:errorRef];
+    NSMutableDictionary *systemSoundIDs = FBAudioResourceLoaderSystemSoundIDs();
+    NSString *key = [NSString stringWithFormat:@"%@|%lu", [[self class] name], (unsigned long)[[self class] version]];
+    @synchronized(systemSoundIDs) {
+        NSNumber *systemSoundID = systemSoundIDs[key];
+        if (systemSoundID) {
+            _systemSoundID = [systemSoundID unsignedIntValue];
+            return YES;
+        }
+
+        NSURL *fileURL = [self _fileURL:errorRef];
+
+        if (![_fileManager fileExistsAtPath:[fileURL path]]) {
+            NSData *data = [[self class] data];
+            if (![data writeToURL:fileURL options:NSDataWritingAtomic error:errorRef]) {
+                return NO;
+            }
+        }
 
-    if (![_fileManager fileExistsAtPath:[fileURL path]]) {
-        NSData *data = [[self class] data];
-        if (![data writeToURL:fileURL options:NSDataWritingAtomic error:errorRef]) {
+        OSStatus status = fbdfl_AudioServicesCreateSystemSoundID((__bridge CFURLRef)fileURL, &_systemSoundID);
+        if (status != kAudioServicesNoError) {
             return NO;
         }
+        systemSoundIDs[key] = @(_systemSoundID);
+        return YES;
     }
-
-    OSStatus status = fbdfl_AudioServicesCreateSystemSoundID((__bridge CFURLRef)fileURL, &_systemSoundID);
-    return (status == kAudioServicesNoError);
 }
 
 - (void)playSound
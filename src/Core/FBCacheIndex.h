@@ -14,27 +14,77 @@
  * limitations under the License.
  */
 
+#import <pthread.h>
 #import <sqlite3.h>
 
 #import <Foundation/Foundation.h>
 
-@class FBCacheIndex;
+@protocol FBCacheIndexing;
+
+typedef struct {
+    uint64_t evictionCount;
+    uint64_t evictedBytes;
+    uint64_t trimCount;
+    NSTimeInterval trimDuration;
+    // Lookups and purges that had to wait on databaseQueue
+    uint64_t syncWaitCount;
+    NSTimeInterval syncWaitDuration;
+} FBCacheIndexStatistics;
 
 @protocol FBCacheIndexFileDelegate <NSObject>
 
 @required
 // Informs the disk cache to write contents to the specified file.  The callback
 // should not block and should be executed in order.
-- (void)cacheIndex:(FBCacheIndex *)cacheIndex
+- (void)cacheIndex:(id<FBCacheIndexing>)cacheIndex
  writeFileWithName:(NSString *)name
               data:(NSData *)data;
 // Informs the disk cache to delete the specified file.
-- (void)cacheIndex:(FBCacheIndex *)cacheIndex
+- (void)cacheIndex:(id<FBCacheIndexing>)cacheIndex
 deleteFileWithName:(NSString *)name;
 
 @end
 
-@interface FBCacheIndex : NSObject
+// What the disk cache needs from an index of its files: a map from key to
+// (file name, size, access time, namespace) that evicts the least recently used
+// files once they take up more than diskCapacity.  Implemented by FBCacheIndex,
+// on SQLite, and by FBMappedCacheIndex, on a memory mapped hash table.
+@protocol FBCacheIndexing <NSObject>
+
+- (instancetype)initWithCacheFolder:(NSString *)folderPath;
+
+@property (assign) id delegate;
+@property (nonatomic, readonly) NSUInteger currentDiskUsage;
+@property (nonatomic, assign) NSUInteger diskCapacity;
+
+- (NSString *)fileNameForKey:(NSString *)key;
+// Entries are stored in a namespace, so that related entries (e.g. all the
+// ones belonging to a session) can be purged together.  Entries stored
+// without a namespace are in the nil namespace.
+- (NSString *)storeFileForKey:(NSString *)key withData:(NSData *)data;
+- (NSString *)storeFileForKey:(NSString *)key
+                     withData:(NSData *)data
+                    namespace:(NSString *)cacheNamespace;
+// For files the caller has already put in place under the given name, so the
+// delegate is not asked to write anything.
+- (void)storeFileWithName:(NSString *)fileName
+                   forKey:(NSString *)key
+                 fileSize:(NSUInteger)fileSize
+                namespace:(NSString *)cacheNamespace;
+- (void)removeEntryForKey:(NSString *)key;
+// Returns the number of removed entries.
+- (NSUInteger)removeEntriesInNamespace:(NSString *)cacheNamespace;
+
+// Counters since the index was created or resetStatistics was last called.
+- (FBCacheIndexStatistics)statistics;
+- (void)resetStatistics;
+
+@end
+
+// Thread-safe: lookups only take a reader lock, and all database work is
+// serialized on databaseQueue.  Init doesn't wait on the database: it is
+// opened on databaseQueue, and started over if it can't be read.
+@interface FBCacheIndex : NSObject <FBCacheIndexing>
 {
 @private
     id<FBCacheIndexFileDelegate> _delegate;
@@ -45,18 +95,53 @@ deleteFileWithName:(NSString *)name;
     NSUInteger _diskCapacity;
 
     sqlite3 *_database;
-    sqlite3_stmt *_insertStatement;
-    sqlite3_stmt *_removeByKeyStatement;
-    sqlite3_stmt *_selectByKeyStatement;
-    sqlite3_stmt *_selectByKeyFragmentStatement;
-    sqlite3_stmt *_selectExcludingKeyFragmentStatement;
-    sqlite3_stmt *_trimStatement;
-    sqlite3_stmt *_updateStatement;
+
+    // Prepared statements, keyed by query text, kept for the lifetime of the
+    // connection.  Only accessed on _databaseQueue.
+    NSMutableDictionary *_statements;
+
+    // Entries waiting to be written in the next batched transaction.
+    // Only accessed on _databaseQueue.
+    NSMutableDictionary *_pendingEntries;
+    BOOL _flushScheduled;
+
+    // In-memory mirror of cache_index ordered by access time, oldest first.
+    // Maps key digests to list nodes.  Only accessed on _databaseQueue.
+    NSMutableDictionary *_evictionEntries;
+    id _evictionHead;
+    id _evictionTail;
+    BOOL _evictionIndexLoaded;
+    // Position of the incremental load of the eviction index
+    CFTimeInterval _loadCursorAccessTime;
+    sqlite3_int64 _loadCursorRowID;
+
+    // Set once the database has been opened, or recreated, and any upgrade
+    // has run.  Until then lookups only see _pendingEntries.
+    BOOL _databaseOpened;
+
+    // Orphaned file sweep, run once per launch.  Only accessed on _databaseQueue.
+    NSString *_folderPath;
+    BOOL _orphanSweepStarted;
+    NSDirectoryEnumerator *_orphanEnumerator;
+    NSSet *_knownFileNames;
+    NSDate *_orphanCutoffDate;
+
+    // Guards _pendingEntries, _evictionEntries, _evictionIndexLoaded and
+    // _databaseOpened so that lookups can be answered from any thread without
+    // going through _databaseQueue.  Mutations only happen on _databaseQueue, under the
+    // write lock.
+    pthread_rwlock_t _entriesLock;
 
     dispatch_queue_t _databaseQueue;
-}
 
-- (instancetype)initWithCacheFolder:(NSString *)folderPath;
+    // Statistics, updated atomically.  Durations are in microseconds.
+    volatile int64_t _evictionCount;
+    volatile int64_t _evictedBytes;
+    volatile int64_t _trimCount;
+    volatile int64_t _trimMicroseconds;
+    volatile int64_t _syncWaitCount;
+    volatile int64_t _syncWaitMicroseconds;
+}
 
 @property (assign) id delegate;
 @property (nonatomic, readonly) NSUInteger currentDiskUsage;
@@ -64,10 +149,12 @@ deleteFileWithName:(NSString *)name;
 @property (nonatomic, assign) NSUInteger entryCacheCountLimit;
 @property (nonatomic, readonly) dispatch_queue_t databaseQueue;
 
-- (NSString *)fileNameForKey:(NSString *)key;
-- (NSString *)storeFileForKey:(NSString *)key withData:(NSData *)data;
-- (void)removeEntryForKey:(NSString *)key;
-- (void)removeEntries:(NSString *)keyFragment excludingFragment:(BOOL)exclude;
+// Keys are only ever stored as this fixed-width digest, so they can't be
+// listed back out of the index.
++ (NSData *)digestForKey:(NSString *)key;
+
+// Namespaces are purged with an indexed delete.  Entries written before
+// namespaces existed are in the nil namespace.
 
 @end
 
@@ -16,9 +16,14 @@
 
 #import "FBCacheIndex.h"
 
+#import <CommonCrypto/CommonDigest.h>
+#import <libkern/OSAtomic.h>
+
+#import "FBDispatch.h"
 #import "FBDynamicFrameworkLoader.h"
 #import "FBLogger.h"
 #import "FBSettings.h"
+#import "FBUtility.h"
 
 #define CHECK_SQLITE(res, expectedResult, db) { \
 int result = (res); \
@@ -39,62 +44,111 @@ NSCAssert(NO, @""); \
 // Number of entries cached to memory
 static const NSInteger kDefaultCacheCountLimit = 500;
 
+// Window over which dirty entries are coalesced into a single transaction
+static const NSTimeInterval kWriteFlushInterval = 1.0;
+
+// Number of rows read per step of the incremental eviction index load.
+// Lookups that need the database get serviced in between.
+static const int kEvictionIndexLoadBatchSize = 256;
+// Files looked at per pass of the orphaned file sweep
+static const int kOrphanSweepBatchSize = 64;
+// Files newer than this may belong to an entry still on its way to the
+// database, so the sweep leaves them alone
+static const NSTimeInterval kOrphanMinimumAge = 60.0;
+
 static NSString *const cacheFilename = @"cache.db";
+
+// Keys are stored as their 16 byte digest rather than the full URL, which
+// keeps both the table's B-tree and the in-memory maps small.
 static const char *schema =
 "CREATE TABLE IF NOT EXISTS cache_index "
-"(uuid TEXT, key TEXT PRIMARY KEY, access_time REAL, file_size INTEGER)";
+"(uuid TEXT, key_hash BLOB PRIMARY KEY, access_time REAL, file_size INTEGER, namespace TEXT)";
+
+// Bumped whenever opening the database needs an upgrade step
+static const int kSchemaVersion = 1;
+static const char *selectSchemaVersionQuery = "PRAGMA user_version";
+static const char *storeSchemaVersionQuery = "PRAGMA user_version = 1";
+
+// Databases from before version 1 keyed cache_index on the full key.  The old
+// table is set aside, with the namespace column added if it predates that too,
+// and its rows are hashed into the new table once the index has opened.  Each
+// step is expected to fail harmlessly when there is nothing to upgrade.
+static const char *legacyUpgradeQueries[] = {
+    "ALTER TABLE cache_index ADD COLUMN namespace TEXT",
+    "DROP INDEX IF EXISTS cache_index_namespace",
+    "DROP INDEX IF EXISTS cache_index_access_time",
+    "ALTER TABLE cache_index RENAME TO cache_index_legacy",
+};
+
+static const char *selectLegacyEntriesQuery =
+"SELECT uuid, key, access_time, file_size, namespace FROM cache_index_legacy";
+
+static const char *dropLegacyEntriesQuery =
+"DROP TABLE cache_index_legacy";
+
+static const char *namespaceIndexSchema =
+"CREATE INDEX IF NOT EXISTS cache_index_namespace ON cache_index (namespace)";
+
+static const char *accessTimeIndexSchema =
+"CREATE INDEX IF NOT EXISTS cache_index_access_time ON cache_index (access_time)";
+
+static const char *metadataSchema =
+"CREATE TABLE IF NOT EXISTS cache_metadata (name TEXT PRIMARY KEY, value INTEGER)";
+
+// Left behind by versions that computed trims in SQL
+static const char *dropLegacyTrimTableQuery =
+"DROP TABLE IF EXISTS trimmed";
+
+// WAL lets readers proceed while a batch is being committed, and NORMAL
+// sync only fsyncs at checkpoints rather than on every commit
+static const char *journalModePragma = "PRAGMA journal_mode=WAL";
+static const char *synchronousPragma = "PRAGMA synchronous=NORMAL";
+
+static const char *beginTransactionQuery = "BEGIN TRANSACTION";
+static const char *commitTransactionQuery = "COMMIT TRANSACTION";
 
 static const char *insertQuery =
-"INSERT INTO cache_index VALUES (?, ?, ?, ?)";
+"INSERT INTO cache_index (uuid, key_hash, access_time, file_size, namespace) VALUES (?, ?, ?, ?, ?)";
 
 static const char *updateQuery =
 "UPDATE cache_index "
 "SET uuid=?, access_time=?, file_size=? "
-"WHERE key=?";
+"WHERE key_hash=?";
 
 static const char *selectByKeyQuery =
-"SELECT uuid, key, access_time, file_size FROM cache_index WHERE key = ?";
+"SELECT uuid, key_hash, access_time, file_size FROM cache_index WHERE key_hash = ?";
 
-static const char *selectByKeyFragmentQuery =
-"SELECT uuid, key, access_time, file_size FROM cache_index WHERE key LIKE ?";
+static const char *selectByNamespaceQuery =
+"SELECT uuid, key_hash, access_time, file_size FROM cache_index WHERE namespace = ?";
 
-static const char *selectExcludingKeyFragmentQuery =
-"SELECT uuid, key, access_time, file_size FROM cache_index WHERE key NOT LIKE ?";
+static const char *selectInNilNamespaceQuery =
+"SELECT uuid, key_hash, access_time, file_size FROM cache_index WHERE namespace IS NULL";
 
 static const char *selectStorageSizeQuery =
 "SELECT SUM(file_size) FROM cache_index";
 
+// Walks cache_index_access_time, using the rowid to break ties
+static const char *selectEvictionBatchQuery =
+"SELECT uuid, key_hash, access_time, file_size, rowid FROM cache_index "
+"WHERE access_time > ? OR (access_time = ? AND rowid > ?) "
+"ORDER BY access_time, rowid LIMIT ?";
+
+static const char *selectDiskUsageQuery =
+"SELECT value FROM cache_metadata WHERE name = 'disk_usage'";
+
+static const char *storeDiskUsageQuery =
+"INSERT OR REPLACE INTO cache_metadata (name, value) VALUES ('disk_usage', ?)";
+
 static const char *deleteEntryQuery =
-"DELETE FROM cache_index WHERE key=?";
-
-static const char *trimQuery =
-"CREATE TABLE trimmed AS "
-"SELECT uuid, key, access_time, file_size, running_total "
-"FROM ( "
-"SELECT a1.uuid, a1.key, a1.access_time, "
-"a1.file_size, SUM(a2.file_size) running_total "
-"FROM cache_index a1, cache_index a2 "
-"WHERE a1.access_time > a2.access_time OR "
-"(a1.access_time = a2.access_time AND a1.uuid = a2.uuid) "
-"GROUP BY a1.uuid ORDER BY a1.access_time) rt "
-"WHERE rt.running_total <= ?";
+"DELETE FROM cache_index WHERE key_hash=?";
 
-#pragma mark - C Helpers
+static const char *deleteByNamespaceQuery =
+"DELETE FROM cache_index WHERE namespace = ?";
 
-static void initializeStatement(
-                                sqlite3 *database,
-                                sqlite3_stmt **statement,
-                                const char *statementText)
-{
-    if (*statement == nil) {
-        CHECK_SQLITE_SUCCESS(
-                             fbdfl_sqlite3_prepare_v2(database, statementText, -1, statement, nil),
-                             database
-                             );
-    } else {
-        CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_reset(*statement), database);
-    }
-}
+static const char *deleteInNilNamespaceQuery =
+"DELETE FROM cache_index WHERE namespace IS NULL";
+
+#pragma mark - C Helpers
 
 static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
 {
@@ -103,22 +157,51 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
     }
 }
 
+static void addMicrosecondsSince(NSTimeInterval startTime, volatile int64_t *counter)
+{
+    OSAtomicAdd64Barrier((int64_t)(([FBUtility monotonicTime] - startTime) * USEC_PER_SEC), counter);
+}
+
+static NSData *digestForKey(NSString *key)
+{
+    NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char digest[CC_MD5_DIGEST_LENGTH];
+    CC_MD5(keyData.bytes, (CC_LONG)keyData.length, digest);
+    return [NSData dataWithBytes:digest length:sizeof(digest)];
+}
+
+static void resetCounter(volatile int64_t *counter)
+{
+    int64_t value;
+    do {
+        value = *counter;
+    } while (!OSAtomicCompareAndSwap64Barrier(value, 0, counter));
+}
+
 @interface FBCacheEntityInfo : NSObject
 {
 @private
     NSString *_uuid;
-    NSString *_key;
+    NSData *_keyDigest;
+    NSString *_cacheNamespace;
     CFTimeInterval _accessTime;
     NSUInteger _fileSize;
     BOOL _dirty;
 }
 
-- (instancetype)initWithKey:(NSString *)key
-                       uuid:(NSString *)uuid
-                 accessTime:(CFTimeInterval)accessTime
-                   fileSize:(NSUInteger)fileSize;
-
-@property (copy, readonly) NSString *key;
+- (instancetype)initWithKeyDigest:(NSData *)keyDigest
+                             uuid:(NSString *)uuid
+                       accessTime:(CFTimeInterval)accessTime
+                         fileSize:(NSUInteger)fileSize;
+- (instancetype)initWithKeyDigest:(NSData *)keyDigest
+                             uuid:(NSString *)uuid
+                       accessTime:(CFTimeInterval)accessTime
+                         fileSize:(NSUInteger)fileSize
+                   cacheNamespace:(NSString *)cacheNamespace;
+
+@property (copy, readonly) NSData *keyDigest;
+// Only used when inserting, so nil for entries read back from the database
+@property (copy, readonly) NSString *cacheNamespace;
 @property (copy, readonly) NSString *uuid;
 @property (assign, readonly) CFTimeInterval accessTime;
 @property (assign, readonly) NSUInteger fileSize;
@@ -128,17 +211,60 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
 
 @end
 
+// Node in the doubly linked eviction list.  Holds a snapshot of what is
+// stored in the database, as opposed to FBCacheEntityInfo which may carry
+// unflushed state.
+@interface FBCacheEvictionNode : NSObject
+{
+@public
+    NSData *_keyDigest;
+    NSString *_uuid;
+    CFTimeInterval _accessTime;
+    NSUInteger _fileSize;
+    FBCacheEvictionNode *_previous; // weak
+    FBCacheEvictionNode *_next; // weak
+}
+@end
+
+@implementation FBCacheEvictionNode
+
+- (void)dealloc
+{
+    [_keyDigest release];
+    [_uuid release];
+    [super dealloc];
+}
+
+@end
+
 @interface FBCacheIndex () <NSCacheDelegate>
 
-- (FBCacheEntityInfo *)_entryForKey:(NSString *)key;
+- (BOOL)_openDatabaseAtPath:(NSString *)path hasLegacyEntries:(BOOL *)hasLegacyEntries;
+- (void)_recoverDatabaseAtPath:(NSString *)path;
+- (void)_closeDatabase;
+- (void)_sweepOrphanedFilesBatch;
+- (FBCacheEntityInfo *)_entryForKeyDigest:(NSData *)keyDigest;
+- (void)_enqueueEntryForWrite:(FBCacheEntityInfo *)entry;
 - (void)_fetchCurrentDiskUsage;
-- (FBCacheEntityInfo *)_readEntryFromDatabase:(NSString *)key;
-- (NSMutableArray *)_readEntriesFromDatabase:(NSString *)keyFragment excludingFragment:(BOOL)exclude;
+- (void)_loadCurrentDiskUsage;
+- (void)_migrateLegacyEntries;
+- (void)_storeCurrentDiskUsage;
+- (BOOL)_loadEvictionIndexBatch;
+- (void)_scheduleEvictionIndexLoad;
+- (void)_finishLoadingEvictionIndex;
+- (void)_evictionIndexInsertEntry:(FBCacheEntityInfo *)entry;
+- (void)_evictionIndexRemoveNode:(FBCacheEvictionNode *)node;
+- (void)_flushPendingEntries;
+- (sqlite3_stmt *)_statementForQuery:(const char *)query;
+- (void)_beginTransaction;
+- (void)_commitTransaction;
+- (FBCacheEntityInfo *)_readEntryFromDatabase:(NSData *)keyDigest;
+- (NSMutableArray *)_removeEntriesFromDatabaseInNamespace:(NSString *)cacheNamespace;
 - (FBCacheEntityInfo *)_createCacheEntityInfo:(sqlite3_stmt *)selectStatement;
-- (void)_removeEntryFromDatabaseForKey:(NSString *)key;
+- (void)_removeEntryFromDatabaseForKeyDigest:(NSData *)keyDigest;
 - (void)_trimDatabase;
-- (void)_updateEntryInDatabaseForKey:(NSString *)key
-                               entry:(FBCacheEntityInfo *)entry;
+- (void)_updateEntryInDatabase:(FBCacheEntityInfo *)entry;
+- (void)_insertEntryInDatabase:(FBCacheEntityInfo *)entry;
 - (void)_writeEntryInDatabase:(FBCacheEntityInfo *)entry;
 
 @end
@@ -151,48 +277,39 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
 {
     self = [super init];
     if (self) {
+        pthread_rwlock_init(&_entriesLock, NULL);
+        _statements = [[NSMutableDictionary alloc] init];
+        _folderPath = [folderPath copy];
+
         NSString *cacheDBFullPath =
         [folderPath stringByAppendingPathComponent:cacheFilename];
 
-        dispatch_queue_t lowPriQueue =
-        dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
-        _databaseQueue = dispatch_queue_create(
-                                               "Data Cache queue",
-                                               DISPATCH_QUEUE_SERIAL);
-        dispatch_set_target_queue(_databaseQueue, lowPriQueue);
-
-        __block BOOL success = YES;
-
-        // TODO: This is really bad if higher layers are going to be
-        // multi-threaded.  And this has to be unblocked.
-        dispatch_sync(
-                      _databaseQueue,
-                      ^{
-                          success = (fbdfl_sqlite3_open_v2(
-                                                           cacheDBFullPath.UTF8String,
-                                                           &_database,
-                                                           SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
-                                                           nil) == SQLITE_OK);
-
-                          if (success) {
-                              success = (fbdfl_sqlite3_exec(
-                                                            _database,
-                                                            schema,
-                                                            nil,
-                                                            nil,
-                                                            nil) == SQLITE_OK);
-                          }
-                      }
-                      );
-
-        if (!success) {
-            [self release];
-            return nil;
-        }
+        _databaseQueue = FBDispatchQueueCreateSerial("Data Cache queue", FBDispatchLaneUtility);
 
-        // Get disk usage asynchronously
+        _pendingEntries = [[NSMutableDictionary alloc] init];
+        _evictionEntries = [[NSMutableDictionary alloc] init];
+        _loadCursorAccessTime = -DBL_MAX;
+
+        // Opening the database, and recovering it if it can't be read, happens
+        // off the caller's thread, so a bad cache can't hold up launch.  Until
+        // it is open, lookups only see what has been stored since.  Then disk
+        // usage is read and the eviction index built a batch at a time.
+        // Anything set aside by an upgrade is moved over first.
         dispatch_async(_databaseQueue, ^{
-            [self _fetchCurrentDiskUsage];
+            BOOL hasLegacyEntries = NO;
+            if (![self _openDatabaseAtPath:cacheDBFullPath hasLegacyEntries:&hasLegacyEntries]) {
+                [self _recoverDatabaseAtPath:cacheDBFullPath];
+            }
+            if (hasLegacyEntries) {
+                [self _migrateLegacyEntries];
+            }
+            [self _loadCurrentDiskUsage];
+
+            pthread_rwlock_wrlock(&_entriesLock);
+            _databaseOpened = YES;
+            pthread_rwlock_unlock(&_entriesLock);
+
+            [self _scheduleEvictionIndexLoad];
         });
 
         _cachedEntries = [[NSCache alloc] init];
@@ -207,21 +324,12 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
     if (_databaseQueue) {
         // Copy these locally so we don't capture self in the block
         sqlite3 *const db = _database;
-        sqlite3_stmt *const is = _insertStatement;
-        sqlite3_stmt *const sbks = _selectByKeyStatement;
-        sqlite3_stmt *const sbkfs = _selectByKeyFragmentStatement;
-        sqlite3_stmt *const sekfs = _selectExcludingKeyFragmentStatement;
-        sqlite3_stmt *const rbks = _removeByKeyStatement;
-        sqlite3_stmt *const ts = _trimStatement;
-        sqlite3_stmt *const us = _updateStatement;
+        NSArray *const statements = [[_statements allValues] retain];
         dispatch_async(_databaseQueue, ^{
-            releaseStatement(is, nil);
-            releaseStatement(sbks, nil);
-            releaseStatement(sbkfs, nil);
-            releaseStatement(sekfs, nil);
-            releaseStatement(rbks, nil);
-            releaseStatement(ts, nil);
-            releaseStatement(us, nil);
+            for (NSValue *statement in statements) {
+                releaseStatement([statement pointerValue], nil);
+            }
+            [statements release];
 
             CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_close(db), nil);
         });
@@ -231,11 +339,41 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
 
     _cachedEntries.delegate = nil;
     [_cachedEntries release];
+    [_pendingEntries release];
+    [_evictionEntries release];
+    [_statements release];
+    [_folderPath release];
+    [_orphanEnumerator release];
+    [_knownFileNames release];
+    [_orphanCutoffDate release];
+    pthread_rwlock_destroy(&_entriesLock);
     [super dealloc];
 }
 
 #pragma mark - Properties
 
+- (FBCacheIndexStatistics)statistics
+{
+    FBCacheIndexStatistics statistics;
+    statistics.evictionCount = (uint64_t)_evictionCount;
+    statistics.evictedBytes = (uint64_t)_evictedBytes;
+    statistics.trimCount = (uint64_t)_trimCount;
+    statistics.trimDuration = (NSTimeInterval)_trimMicroseconds / USEC_PER_SEC;
+    statistics.syncWaitCount = (uint64_t)_syncWaitCount;
+    statistics.syncWaitDuration = (NSTimeInterval)_syncWaitMicroseconds / USEC_PER_SEC;
+    return statistics;
+}
+
+- (void)resetStatistics
+{
+    resetCounter(&_evictionCount);
+    resetCounter(&_evictedBytes);
+    resetCounter(&_trimCount);
+    resetCounter(&_trimMicroseconds);
+    resetCounter(&_syncWaitCount);
+    resetCounter(&_syncWaitMicroseconds);
+}
+
 - (NSUInteger)entryCacheCountLimit
 {
     return _cachedEntries.countLimit;
@@ -248,9 +386,14 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
 
 #pragma mark - Public
 
++ (NSData *)digestForKey:(NSString *)key
+{
+    return digestForKey(key);
+}
+
 - (NSString *)fileNameForKey:(NSString *)key
 {
-    FBCacheEntityInfo *entryInfo = [self _entryForKey:key];
+    FBCacheEntityInfo *entryInfo = [self _entryForKeyDigest:digestForKey(key)];
     [entryInfo registerAccess];
     if (entryInfo) {
         return [[entryInfo.uuid retain] autorelease];
@@ -260,46 +403,67 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
 }
 
 - (NSString *)storeFileForKey:(NSString *)key withData:(NSData *)data
+{
+    return [self storeFileForKey:key withData:data namespace:nil];
+}
+
+- (NSString *)storeFileForKey:(NSString *)key
+                     withData:(NSData *)data
+                    namespace:(NSString *)cacheNamespace
 {
     CFUUIDRef uuid = CFUUIDCreate(kCFAllocatorDefault);
     NSString *uuidString =
     (NSString *)CFUUIDCreateString(kCFAllocatorDefault, uuid);
 
     CFRelease(uuid);
+    [self storeFileWithName:uuidString
+                     forKey:key
+                   fileSize:data.length
+                  namespace:cacheNamespace];
+
+    [self.delegate cacheIndex:self writeFileWithName:uuidString data:data];
+
+    return [uuidString autorelease];
+}
+
+- (void)storeFileWithName:(NSString *)fileName
+                   forKey:(NSString *)key
+                 fileSize:(NSUInteger)fileSize
+                namespace:(NSString *)cacheNamespace
+{
     FBCacheEntityInfo *entry = [[FBCacheEntityInfo alloc]
-                                initWithKey:key
-                                uuid:uuidString
+                                initWithKeyDigest:digestForKey(key)
+                                uuid:fileName
                                 accessTime:0
-                                fileSize:data.length];
+                                fileSize:fileSize
+                                cacheNamespace:cacheNamespace];
 
     [entry registerAccess];
     dispatch_async(_databaseQueue, ^{
-        [self _writeEntryInDatabase:entry];
+        [self _enqueueEntryForWrite:entry];
 
-        _currentDiskUsage += data.length;
+        _currentDiskUsage += fileSize;
         if (_currentDiskUsage > _diskCapacity) {
             [self _trimDatabase];
         }
     });
 
-    [self.delegate cacheIndex:self writeFileWithName:uuidString data:data];
-
-    [_cachedEntries setObject:entry forKey:key];
+    [_cachedEntries setObject:entry forKey:entry.keyDigest];
     [entry release];
-
-    return [uuidString autorelease];
 }
 
 - (void)removeEntryForKey:(NSString *)key
 {
-    FBCacheEntityInfo *entry = [self _entryForKey:key];
+    NSData *keyDigest = digestForKey(key);
+    FBCacheEntityInfo *entry = [self _entryForKeyDigest:keyDigest];
     entry.dirty = NO; // Removing, so no need to flush to disk
 
     NSInteger spaceSaved = entry.fileSize;
-    [_cachedEntries removeObjectForKey:key];
+    [_cachedEntries removeObjectForKey:keyDigest];
 
     dispatch_async(_databaseQueue, ^{
-        [self _removeEntryFromDatabaseForKey:key];
+        [self _beginTransaction];
+        [self _removeEntryFromDatabaseForKeyDigest:keyDigest];
         if (_currentDiskUsage >= spaceSaved) {
             _currentDiskUsage -= spaceSaved;
         } else {
@@ -307,37 +471,39 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
             // This means current disk usage is out of whack - let's re-read
             [self _fetchCurrentDiskUsage];
         };
+        [self _storeCurrentDiskUsage];
+        [self _commitTransaction];
 
         [self.delegate cacheIndex:self deleteFileWithName:entry.uuid];
     });
 }
 
-- (void)removeEntries:(NSString *)keyFragment excludingFragment:(BOOL)exclude
+- (NSUInteger)removeEntriesInNamespace:(NSString *)cacheNamespace
 {
-    if (keyFragment == nil) {
-        return;
-    }
-
     __block NSMutableArray *entries;
 
+    NSTimeInterval waitStartTime = [FBUtility monotonicTime];
     dispatch_sync(_databaseQueue, ^{
-        entries = [self _readEntriesFromDatabase:keyFragment excludingFragment:exclude];
+        [self _flushPendingEntries];
+
+        [self _beginTransaction];
+        entries = [[self _removeEntriesFromDatabaseInNamespace:cacheNamespace] retain];
+        [self _storeCurrentDiskUsage];
+        [self _commitTransaction];
     });
+    OSAtomicIncrement64Barrier(&_syncWaitCount);
+    addMicrosecondsSince(waitStartTime, &_syncWaitMicroseconds);
 
+    NSUInteger removedCount = entries.count;
     for (FBCacheEntityInfo *entry in entries) {
-        if ([_cachedEntries objectForKey:entry.key] == nil) {
-            // Adding to the cache since the call to removeEntryForKey will look for the entry and
-            // try to retrieve it from the DB which will in turn add it to the cache anyways. So
-            // pre-emptively adding it to the in memory cache saves some DB roundtrips.
-            //
-            // This is only done for NSCache entries that don't already exist since replacing the
-            // old one with the new one will trigger willEvictObject which will try and perform
-            // a DB write. Since the write is async, we might end up in a weird state.
-            [_cachedEntries setObject:entry forKey:entry.key];
-        }
-
-        [self removeEntryForKey:entry.key];
+        // Already gone from the database, so no need to flush on eviction
+        FBCacheEntityInfo *cachedEntry = [_cachedEntries objectForKey:entry.keyDigest];
+        cachedEntry.dirty = NO;
+        [_cachedEntries removeObjectForKey:entry.keyDigest];
     }
+    [entries release];
+
+    return removedCount;
 }
 
 #pragma mark - NSCache delegate
@@ -347,139 +513,361 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
     FBCacheEntityInfo *entryInfo = (FBCacheEntityInfo *)obj;
     if (entryInfo.dirty) {
         dispatch_async(_databaseQueue, ^{
-            [self _writeEntryInDatabase:entryInfo];
+            [self _enqueueEntryForWrite:entryInfo];
         });
     }
 }
 
 #pragma mark - Private
 
-- (void)_updateEntryInDatabaseForKey:(NSString *)key
-                               entry:(FBCacheEntityInfo *)entry
+// Must be called on _databaseQueue.  Opens the connection, which then stays
+// open until dealloc, and brings the schema up to date.  Returns NO, with the
+// connection closed, if the database can't be used.
+- (BOOL)_openDatabaseAtPath:(NSString *)path hasLegacyEntries:(BOOL *)hasLegacyEntries
+{
+    BOOL success = (fbdfl_sqlite3_open_v2(
+                                          path.UTF8String,
+                                          &_database,
+                                          SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                                          nil) == SQLITE_OK);
+
+    if (success) {
+        // Not fatal if unsupported, we just fall back to
+        // the default rollback journal
+        if (fbdfl_sqlite3_exec(_database, journalModePragma, nil, nil, nil) != SQLITE_OK ||
+            fbdfl_sqlite3_exec(_database, synchronousPragma, nil, nil, nil) != SQLITE_OK) {
+            [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                            formatString:@"FBCacheIndex: Unable to enable WAL journaling: %s",
+             fbdfl_sqlite3_errmsg(_database)];
+        }
+
+        sqlite3_stmt *versionStatement = nil;
+        int schemaVersion = 0;
+        if (fbdfl_sqlite3_prepare_v2(_database, selectSchemaVersionQuery, -1, &versionStatement, nil) == SQLITE_OK &&
+            fbdfl_sqlite3_step(versionStatement) == SQLITE_ROW) {
+            schemaVersion = fbdfl_sqlite3_column_int(versionStatement, 0);
+        }
+        // Still holds a read lock until finalized
+        releaseStatement(versionStatement, nil);
+        if (schemaVersion < kSchemaVersion) {
+            for (size_t i = 0; i < sizeof(legacyUpgradeQueries) / sizeof(legacyUpgradeQueries[0]); i++) {
+                int result = fbdfl_sqlite3_exec(_database, legacyUpgradeQueries[i], nil, nil, nil);
+                // The rename is the last step, so this only
+                // holds if there was an old table to set aside
+                *hasLegacyEntries = (result == SQLITE_OK);
+            }
+        }
+
+        success = (fbdfl_sqlite3_exec(_database, schema, nil, nil, nil) == SQLITE_OK);
+    }
+
+    if (success) {
+        const char *schemaUpdates[] = {
+            namespaceIndexSchema,
+            accessTimeIndexSchema,
+            metadataSchema,
+            dropLegacyTrimTableQuery,
+            storeSchemaVersionQuery,
+        };
+        for (size_t i = 0; success && i < sizeof(schemaUpdates) / sizeof(schemaUpdates[0]); i++) {
+            success = (fbdfl_sqlite3_exec(_database, schemaUpdates[i], nil, nil, nil) == SQLITE_OK);
+        }
+    }
+
+    if (!success) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                        formatString:@"FBCacheIndex: Unable to open %@: %s", path,
+         _database ? fbdfl_sqlite3_errmsg(_database) : "out of memory"];
+        [self _closeDatabase];
+        *hasLegacyEntries = NO;
+    }
+    return success;
+}
+
+// Must be called on _databaseQueue.  Starts over with an empty database in
+// place of one that can't be opened.  The files its entries pointed to are
+// left for the orphaned file sweep.  If even that fails the index is kept in
+// memory, so the cache still works, just not across launches.
+- (void)_recoverDatabaseAtPath:(NSString *)path
 {
-    initializeStatement(_database, &_updateStatement, updateQuery);
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    for (NSString *suffix in @[@"", @"-wal", @"-shm", @"-journal"]) {
+        [fileManager removeItemAtPath:[path stringByAppendingString:suffix] error:nil];
+    }
+
+    BOOL hasLegacyEntries = NO;
+    if (![self _openDatabaseAtPath:path hasLegacyEntries:&hasLegacyEntries] &&
+        ![self _openDatabaseAtPath:@":memory:" hasLegacyEntries:&hasLegacyEntries]) {
+        // Nothing left to try; every statement will fail, and be logged
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                            logEntry:@"FBCacheIndex: Unable to create a database"];
+    }
+}
+
+- (void)_closeDatabase
+{
+    for (NSValue *statement in [_statements objectEnumerator]) {
+        releaseStatement([statement pointerValue], nil);
+    }
+    [_statements removeAllObjects];
+
+    if (_database) {
+        fbdfl_sqlite3_close(_database);
+        _database = nil;
+    }
+}
+
+// Must be called on _databaseQueue.  Prepares the statement the first time the
+// query is used and resets it on every subsequent use.
+- (sqlite3_stmt *)_statementForQuery:(const char *)query
+{
+    NSValue *queryKey = [NSValue valueWithPointer:query];
+    sqlite3_stmt *statement = [[_statements objectForKey:queryKey] pointerValue];
+    if (statement == nil) {
+        CHECK_SQLITE_SUCCESS(
+                             fbdfl_sqlite3_prepare_v2(_database, query, -1, &statement, nil),
+                             _database
+                             );
+        [_statements setObject:[NSValue valueWithPointer:statement] forKey:queryKey];
+    } else {
+        CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_reset(statement), _database);
+    }
+
+    return statement;
+}
+
+- (void)_beginTransaction
+{
+    CHECK_SQLITE_DONE(fbdfl_sqlite3_step([self _statementForQuery:beginTransactionQuery]), _database);
+}
+
+- (void)_commitTransaction
+{
+    CHECK_SQLITE_DONE(fbdfl_sqlite3_step([self _statementForQuery:commitTransactionQuery]), _database);
+}
+
+// Must be called on _databaseQueue.  Rather than hitting the database (and the
+// disk) once per entry, dirty entries are collected and written together in a
+// single transaction once the flush window elapses.
+- (void)_enqueueEntryForWrite:(FBCacheEntityInfo *)entry
+{
+    FBCacheEntityInfo *pending = [_pendingEntries objectForKey:entry.keyDigest];
+    if (pending != nil && ![pending.uuid isEqualToString:entry.uuid]) {
+        // The pending file was superseded before it ever made it to the index
+        [self.delegate cacheIndex:self deleteFileWithName:pending.uuid];
+        _currentDiskUsage -= pending.fileSize;
+    }
+    pthread_rwlock_wrlock(&_entriesLock);
+    [_pendingEntries setObject:entry forKey:entry.keyDigest];
+    pthread_rwlock_unlock(&_entriesLock);
+
+    if (!_flushScheduled) {
+        _flushScheduled = YES;
+        dispatch_after(
+                       dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kWriteFlushInterval * NSEC_PER_SEC)),
+                       _databaseQueue,
+                       ^{
+                           [self _flushPendingEntries];
+                       });
+    }
+}
+
+// Must be called on _databaseQueue
+- (void)_flushPendingEntries
+{
+    _flushScheduled = NO;
+    if (_pendingEntries.count == 0) {
+        return;
+    }
+
+    [self _beginTransaction];
+    for (FBCacheEntityInfo *entry in [_pendingEntries objectEnumerator]) {
+        [self _writeEntryInDatabase:entry];
+    }
+    [self _storeCurrentDiskUsage];
+    [self _commitTransaction];
+
+    pthread_rwlock_wrlock(&_entriesLock);
+    [_pendingEntries removeAllObjects];
+    pthread_rwlock_unlock(&_entriesLock);
+}
+
+- (void)_updateEntryInDatabase:(FBCacheEntityInfo *)entry
+{
+    sqlite3_stmt *updateStatement = [self _statementForQuery:updateQuery];
 
     CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_text(
-                                                 _updateStatement,
+                                                 updateStatement,
                                                  1,
                                                  entry.uuid.UTF8String,
                                                  (int)entry.uuid.length,
                                                  nil), _database);
 
     CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_double(
-                                                   _updateStatement,
+                                                   updateStatement,
                                                    2,
                                                    entry.accessTime), _database);
 
     NSAssert(entry.fileSize <= INT_MAX, @"");
     CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_int(
-                                                _updateStatement,
+                                                updateStatement,
                                                 3,
                                                 (int)entry.fileSize), _database);
 
-    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_text(
-                                                 _updateStatement,
+    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_blob(
+                                                 updateStatement,
                                                  4,
-                                                 entry.key.UTF8String,
-                                                 (int)entry.key.length,
+                                                 entry.keyDigest.bytes,
+                                                 (int)entry.keyDigest.length,
                                                  nil), _database);
 
-    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(_updateStatement), _database);
+    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(updateStatement), _database);
 
     entry.dirty = NO;
 }
 
 - (void)_writeEntryInDatabase:(FBCacheEntityInfo *)entry
 {
-    FBCacheEntityInfo *existing = [self _readEntryFromDatabase:entry.key];
+    // The eviction index mirrors the table, so there is usually no need to
+    // query for an existing row.  While it is still loading, rows it hasn't
+    // reached yet have to be looked up.
+    FBCacheEvictionNode *existingNode = [_evictionEntries objectForKey:entry.keyDigest];
+    FBCacheEntityInfo *existing = nil;
+    if (existingNode) {
+        existing = [[[FBCacheEntityInfo alloc]
+                     initWithKeyDigest:existingNode->_keyDigest
+                     uuid:existingNode->_uuid
+                     accessTime:existingNode->_accessTime
+                     fileSize:existingNode->_fileSize] autorelease];
+    } else if (!_evictionIndexLoaded) {
+        existing = [self _readEntryFromDatabase:entry.keyDigest];
+    }
+
     if (existing) {
 
         // Entry already exists - update the entry
-        [self _updateEntryInDatabaseForKey:existing.key
-                                     entry:entry];
+        [self _updateEntryInDatabase:entry];
 
         if (![existing.uuid isEqualToString:entry.uuid]) {
             // The files have changed.  Schedule a delete for existing file
             [self.delegate cacheIndex:self deleteFileWithName:existing.uuid];
+
+            // The old file's size was already accounted for
+            _currentDiskUsage -= MIN(_currentDiskUsage, existing.fileSize);
+        }
+
+        if (existingNode) {
+            [self _evictionIndexRemoveNode:existingNode];
         }
+        [self _evictionIndexInsertEntry:entry];
         return;
     }
 
-    initializeStatement(_database, &_insertStatement, insertQuery);
+    [self _insertEntryInDatabase:entry];
+
+    entry.dirty = NO;
+    [self _evictionIndexInsertEntry:entry];
+}
+
+- (void)_insertEntryInDatabase:(FBCacheEntityInfo *)entry
+{
+    sqlite3_stmt *insertStatement = [self _statementForQuery:insertQuery];
     CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_text(
-                                                 _insertStatement,
+                                                 insertStatement,
                                                  1,
                                                  entry.uuid.UTF8String,
                                                  (int)entry.uuid.length,
                                                  nil), _database);
 
-    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_text(
-                                                 _insertStatement,
+    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_blob(
+                                                 insertStatement,
                                                  2,
-                                                 entry.key.UTF8String,
-                                                 (int)entry.key.length,
+                                                 entry.keyDigest.bytes,
+                                                 (int)entry.keyDigest.length,
                                                  nil), _database);
 
     CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_double(
-                                                   _insertStatement,
+                                                   insertStatement,
                                                    3,
                                                    entry.accessTime), _database);
 
     NSAssert(entry.fileSize <= INT_MAX, @"");
     CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_int(
-                                                _insertStatement,
+                                                insertStatement,
                                                 4,
                                                 (int)entry.fileSize), _database);
 
-    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(_insertStatement), _database);
+    if (entry.cacheNamespace) {
+        CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_text(
+                                                     insertStatement,
+                                                     5,
+                                                     entry.cacheNamespace.UTF8String,
+                                                     -1,
+                                                     nil), _database);
+    } else {
+        CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_null(insertStatement, 5), _database);
+    }
 
-    entry.dirty = NO;
+    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(insertStatement), _database);
 }
 
-- (FBCacheEntityInfo *)_readEntryFromDatabase:(NSString *)key
+- (FBCacheEntityInfo *)_readEntryFromDatabase:(NSData *)keyDigest
 {
-    initializeStatement(_database, &_selectByKeyStatement, selectByKeyQuery);
+    sqlite3_stmt *selectByKeyStatement = [self _statementForQuery:selectByKeyQuery];
 
-    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_text(
-                                                 _selectByKeyStatement,
+    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_blob(
+                                                 selectByKeyStatement,
                                                  1,
-                                                 key.UTF8String,
-                                                 (int)key.length,
+                                                 keyDigest.bytes,
+                                                 (int)keyDigest.length,
                                                  nil), _database);
 
-    return [self _createCacheEntityInfo:_selectByKeyStatement];
+    return [self _createCacheEntityInfo:selectByKeyStatement];
 }
 
-- (NSMutableArray *)_readEntriesFromDatabase:(NSString *)keyFragment
-                           excludingFragment:(BOOL)exclude
+- (NSMutableArray *)_removeEntriesFromDatabaseInNamespace:(NSString *)cacheNamespace
 {
     sqlite3_stmt *selectStatement;
-    const char *query;
-    if (exclude) {
-        selectStatement = _selectExcludingKeyFragmentStatement;
-        query = selectExcludingKeyFragmentQuery;
+    sqlite3_stmt *deleteStatement;
+    if (cacheNamespace) {
+        selectStatement = [self _statementForQuery:selectByNamespaceQuery];
+        CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_text(
+                                                     selectStatement,
+                                                     1,
+                                                     cacheNamespace.UTF8String,
+                                                     -1,
+                                                     nil), _database);
+
+        deleteStatement = [self _statementForQuery:deleteByNamespaceQuery];
+        CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_text(
+                                                     deleteStatement,
+                                                     1,
+                                                     cacheNamespace.UTF8String,
+                                                     -1,
+                                                     nil), _database);
     } else {
-        selectStatement = _selectByKeyFragmentStatement;
-        query = selectByKeyFragmentQuery;
+        selectStatement = [self _statementForQuery:selectInNilNamespaceQuery];
+        deleteStatement = [self _statementForQuery:deleteInNilNamespaceQuery];
     }
 
-    initializeStatement(_database, &selectStatement, query);
-    NSString *wildcardKeyFragment = [NSString stringWithFormat:@"%%%@%%", keyFragment];
-
-    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_text(
-                                                 selectStatement,
-                                                 1,
-                                                 wildcardKeyFragment.UTF8String,
-                                                 (int)wildcardKeyFragment.length,
-                                                 nil), _database);
-
     NSMutableArray *entries = [[[NSMutableArray alloc] init] autorelease];
     FBCacheEntityInfo *entry;
-
     while ((entry = [self _createCacheEntityInfo:selectStatement]) != nil) {
         [entries addObject:entry];
     }
 
+    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(deleteStatement), _database);
+
+    for (entry in entries) {
+        FBCacheEvictionNode *node = [_evictionEntries objectForKey:entry.keyDigest];
+        if (node) {
+            [self _evictionIndexRemoveNode:node];
+        }
+
+        _currentDiskUsage -= MIN(_currentDiskUsage, entry.fileSize);
+        [self.delegate cacheIndex:self deleteFileWithName:entry.uuid];
+    }
+
     return entries;
 }
 
@@ -492,16 +880,15 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
 
     const unsigned char *uuidStr =
     fbdfl_sqlite3_column_text(selectStatement, 0);
-    const unsigned char *key =
-    fbdfl_sqlite3_column_text(selectStatement, 1);
+    NSData *keyDigest =
+    [NSData dataWithBytes:fbdfl_sqlite3_column_blob(selectStatement, 1)
+                   length:fbdfl_sqlite3_column_bytes(selectStatement, 1)];
     CFTimeInterval accessTime =
     fbdfl_sqlite3_column_double(selectStatement, 2);
     NSUInteger fileSize = fbdfl_sqlite3_column_int(selectStatement, 3);
 
     FBCacheEntityInfo *entry = [[FBCacheEntityInfo alloc]
-                                initWithKey:[NSString
-                                             stringWithCString:(const char *)key
-                                             encoding:NSUTF8StringEncoding]
+                                initWithKeyDigest:keyDigest
                                 uuid:[NSString
                                       stringWithCString:(const char *)uuidStr
                                       encoding:NSUTF8StringEncoding]
@@ -510,71 +897,328 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
     return [entry autorelease];
 }
 
+// Rehashes the rows of a table set aside by a schema upgrade into cache_index,
+// in one transaction.  The statements are not kept, as the table goes away.
+- (void)_migrateLegacyEntries
+{
+    sqlite3_stmt *selectStatement = nil;
+    CHECK_SQLITE_SUCCESS(
+                         fbdfl_sqlite3_prepare_v2(_database, selectLegacyEntriesQuery, -1, &selectStatement, nil),
+                         _database
+                         );
+
+    [self _beginTransaction];
+    while (fbdfl_sqlite3_step(selectStatement) == SQLITE_ROW) {
+        const unsigned char *uuidStr = fbdfl_sqlite3_column_text(selectStatement, 0);
+        const unsigned char *key = fbdfl_sqlite3_column_text(selectStatement, 1);
+        const unsigned char *cacheNamespace = fbdfl_sqlite3_column_text(selectStatement, 4);
+        if (uuidStr == nil || key == nil) {
+            continue;
+        }
+
+        FBCacheEntityInfo *entry = [[FBCacheEntityInfo alloc]
+                                    initWithKeyDigest:digestForKey([NSString stringWithUTF8String:(const char *)key])
+                                    uuid:[NSString stringWithUTF8String:(const char *)uuidStr]
+                                    accessTime:fbdfl_sqlite3_column_double(selectStatement, 2)
+                                    fileSize:fbdfl_sqlite3_column_int(selectStatement, 3)
+                                    cacheNamespace:(cacheNamespace
+                                                    ? [NSString stringWithUTF8String:(const char *)cacheNamespace]
+                                                    : nil)];
+        [self _insertEntryInDatabase:entry];
+        [entry release];
+    }
+    releaseStatement(selectStatement, _database);
+
+    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_exec(_database, dropLegacyEntriesQuery, nil, nil, nil), _database);
+    [self _commitTransaction];
+}
+
+// Full-table aggregate; only used when the persisted counter is missing or
+// found to be wrong.
 - (void)_fetchCurrentDiskUsage
 {
-    sqlite3_stmt *sizeStatement = nil;
-    initializeStatement(_database, &sizeStatement, selectStorageSizeQuery);
+    sqlite3_stmt *sizeStatement = [self _statementForQuery:selectStorageSizeQuery];
 
     CHECK_SQLITE(fbdfl_sqlite3_step(sizeStatement), SQLITE_ROW, _database);
     _currentDiskUsage = fbdfl_sqlite3_column_int(sizeStatement, 0);
-    releaseStatement(sizeStatement, _database);
 }
 
-- (FBCacheEntityInfo *)_entryForKey:(NSString *)key
+- (void)_loadCurrentDiskUsage
+{
+    sqlite3_stmt *selectStatement = [self _statementForQuery:selectDiskUsageQuery];
+    if (fbdfl_sqlite3_step(selectStatement) == SQLITE_ROW) {
+        _currentDiskUsage = (NSUInteger)fbdfl_sqlite3_column_int64(selectStatement, 0);
+    } else {
+        // First launch with a database that predates the counter
+        [self _fetchCurrentDiskUsage];
+        [self _storeCurrentDiskUsage];
+    }
+}
+
+// Should be called inside the same transaction as the change in disk usage
+- (void)_storeCurrentDiskUsage
 {
-    __block FBCacheEntityInfo *entryInfo = [_cachedEntries objectForKey:key];
+    sqlite3_stmt *storeStatement = [self _statementForQuery:storeDiskUsageQuery];
+    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_int64(
+                                                  storeStatement,
+                                                  1,
+                                                  (sqlite3_int64)_currentDiskUsage), _database);
+    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(storeStatement), _database);
+}
+
+- (FBCacheEntityInfo *)_entryForKeyDigest:(NSData *)keyDigest
+{
+    FBCacheEntityInfo *entryInfo = [_cachedEntries objectForKey:keyDigest];
     if (entryInfo == nil) {
-        // TODO: This is really bad if higher layers are going to be
-        // multi-threaded.  And this has to be unblocked.
-        dispatch_sync(_databaseQueue, ^{
-            entryInfo = [self _readEntryFromDatabase:key];
-        });
+        BOOL indexLoaded;
+        BOOL databaseOpened;
+
+        // Once loaded, the in-memory indices mirror the database so there is
+        // no need to hop onto _databaseQueue, misses included.  Neither is
+        // there while the database is still being opened, since that can take
+        // a while and only what's pending can be found anyway.
+        pthread_rwlock_rdlock(&_entriesLock);
+        indexLoaded = _evictionIndexLoaded;
+        databaseOpened = _databaseOpened;
+        if (indexLoaded || !databaseOpened) {
+            entryInfo = [[_pendingEntries objectForKey:keyDigest] retain];
+            if (entryInfo == nil && indexLoaded) {
+                FBCacheEvictionNode *node = [_evictionEntries objectForKey:keyDigest];
+                if (node) {
+                    entryInfo = [[FBCacheEntityInfo alloc]
+                                 initWithKeyDigest:node->_keyDigest
+                                 uuid:node->_uuid
+                                 accessTime:node->_accessTime
+                                 fileSize:node->_fileSize];
+                }
+            }
+        }
+        pthread_rwlock_unlock(&_entriesLock);
+        [entryInfo autorelease];
+
+        if (!indexLoaded && databaseOpened) {
+            // Still building the eviction index, so fall back to the database.
+            // The index loads in batches, so this only waits for one of them.
+            __block FBCacheEntityInfo *databaseEntry = nil;
+            NSTimeInterval waitStartTime = [FBUtility monotonicTime];
+            dispatch_sync(_databaseQueue, ^{
+                databaseEntry = [_pendingEntries objectForKey:keyDigest];
+                if (databaseEntry == nil) {
+                    databaseEntry = [self _readEntryFromDatabase:keyDigest];
+                }
+                [[databaseEntry retain] autorelease];
+            });
+            OSAtomicIncrement64Barrier(&_syncWaitCount);
+            addMicrosecondsSince(waitStartTime, &_syncWaitMicroseconds);
+            entryInfo = databaseEntry;
+        }
 
         if (entryInfo) {
-            [_cachedEntries setObject:entryInfo forKey:key];
+            [_cachedEntries setObject:entryInfo forKey:keyDigest];
         }
     }
 
     return entryInfo;
 }
 
-- (void)_removeEntryFromDatabaseForKey:(NSString *)key
+- (void)_removeEntryFromDatabaseForKeyDigest:(NSData *)keyDigest
 {
-    initializeStatement(_database, &_removeByKeyStatement, deleteEntryQuery);
-    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_text(
-                                                 _removeByKeyStatement,
+    pthread_rwlock_wrlock(&_entriesLock);
+    [_pendingEntries removeObjectForKey:keyDigest];
+    pthread_rwlock_unlock(&_entriesLock);
+
+    FBCacheEvictionNode *node = [_evictionEntries objectForKey:keyDigest];
+    if (node) {
+        [self _evictionIndexRemoveNode:node];
+    }
+
+    sqlite3_stmt *removeByKeyStatement = [self _statementForQuery:deleteEntryQuery];
+    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_blob(
+                                                 removeByKeyStatement,
                                                  1,
-                                                 key.UTF8String,
-                                                 (int)key.length,
+                                                 keyDigest.bytes,
+                                                 (int)keyDigest.length,
                                                  nil), _database);
 
-    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(_removeByKeyStatement), _database);
+    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(removeByKeyStatement), _database);
 }
 
-- (void)_dropTrimmingTable
+// Must be called on _databaseQueue, once the eviction index has loaded.
+// Deletes data files that no entry points to, as left by a crash between
+// writing a file and flushing its entry, or by a database that had to be
+// recreated.  Runs once per launch, a batch of files per pass through the
+// queue, so lookups and writes are never stuck behind a whole directory scan.
+- (void)_flushOrphanedFiles
 {
-    sqlite3_stmt *trimCleanStatement = nil;
+    if (_orphanSweepStarted) {
+        return;
+    }
+    _orphanSweepStarted = YES;
 
-    static const char *trimDropQuery = "DROP TABLE IF EXISTS trimmed";
-    initializeStatement(_database, &trimCleanStatement, trimDropQuery);
+    NSMutableSet *knownFileNames = [[NSMutableSet alloc] initWithCapacity:_evictionEntries.count + _pendingEntries.count];
+    for (FBCacheEvictionNode *node in [_evictionEntries objectEnumerator]) {
+        [knownFileNames addObject:node->_uuid];
+    }
+    for (FBCacheEntityInfo *entry in [_pendingEntries objectEnumerator]) {
+        [knownFileNames addObject:entry.uuid];
+    }
+    _knownFileNames = knownFileNames;
+    // Anything stored after the known names were collected is newer than this
+    _orphanCutoffDate = [[NSDate alloc] initWithTimeIntervalSinceNow:-kOrphanMinimumAge];
+    _orphanEnumerator = [[[NSFileManager defaultManager] enumeratorAtPath:_folderPath] retain];
 
-    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(trimCleanStatement), _database);
-    releaseStatement(trimCleanStatement, _database);
+    [self _sweepOrphanedFilesBatch];
 }
 
-- (void)_flushOrphanedFiles
+- (void)_sweepOrphanedFilesBatch
+{
+    NSString *path = nil;
+    for (int examined = 0; examined < kOrphanSweepBatchSize && (path = [_orphanEnumerator nextObject]); examined++) {
+        NSDictionary *attributes = _orphanEnumerator.fileAttributes;
+        NSString *fileName = path.lastPathComponent;
+        if (![attributes.fileType isEqualToString:NSFileTypeRegular] ||
+            [fileName hasPrefix:cacheFilename] ||
+            [_knownFileNames containsObject:fileName] ||
+            [attributes.fileModificationDate compare:_orphanCutoffDate] != NSOrderedAscending) {
+            continue;
+        }
+        [self.delegate cacheIndex:self deleteFileWithName:fileName];
+    }
+
+    if (path) {
+        dispatch_async(_databaseQueue, ^{
+            [self _sweepOrphanedFilesBatch];
+        });
+    } else {
+        [_orphanEnumerator release];
+        _orphanEnumerator = nil;
+        [_knownFileNames release];
+        _knownFileNames = nil;
+        [_orphanCutoffDate release];
+        _orphanCutoffDate = nil;
+    }
+}
+
+#pragma mark - Eviction index
+
+// Reads the next batch of rows, oldest first, into the eviction index so that
+// trimming never has to go back to the database to figure out what to evict.
+// Returns YES once the whole table has been read.
+- (BOOL)_loadEvictionIndexBatch
+{
+    if (_evictionIndexLoaded) {
+        return YES;
+    }
+
+    sqlite3_stmt *batchStatement = [self _statementForQuery:selectEvictionBatchQuery];
+    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_double(batchStatement, 1, _loadCursorAccessTime), _database);
+    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_double(batchStatement, 2, _loadCursorAccessTime), _database);
+    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_int64(batchStatement, 3, _loadCursorRowID), _database);
+    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_int(batchStatement, 4, kEvictionIndexLoadBatchSize), _database);
+
+    int rowCount = 0;
+    FBCacheEntityInfo *entry;
+    while ((entry = [self _createCacheEntityInfo:batchStatement]) != nil) {
+        rowCount++;
+        _loadCursorAccessTime = entry.accessTime;
+        _loadCursorRowID = fbdfl_sqlite3_column_int64(batchStatement, 4);
+
+        // Rows written since the load started are already in the index
+        if ([_evictionEntries objectForKey:entry.keyDigest] == nil) {
+            [self _evictionIndexInsertEntry:entry];
+        }
+    }
+
+    if (rowCount < kEvictionIndexLoadBatchSize) {
+        pthread_rwlock_wrlock(&_entriesLock);
+        _evictionIndexLoaded = YES;
+        pthread_rwlock_unlock(&_entriesLock);
+    }
+
+    return _evictionIndexLoaded;
+}
+
+- (void)_scheduleEvictionIndexLoad
+{
+    if (![self _loadEvictionIndexBatch]) {
+        dispatch_async(_databaseQueue, ^{
+            [self _scheduleEvictionIndexLoad];
+        });
+    } else {
+        [self _flushOrphanedFiles];
+    }
+}
+
+- (void)_finishLoadingEvictionIndex
+{
+    while (![self _loadEvictionIndexBatch]) {
+    }
+}
+
+// Entries are almost always inserted with the most recent access time, so
+// scanning back from the tail is O(1) in practice.
+- (void)_evictionIndexInsertEntry:(FBCacheEntityInfo *)entry
+{
+    FBCacheEvictionNode *node = [[FBCacheEvictionNode alloc] init];
+    node->_keyDigest = [entry.keyDigest copy];
+    node->_uuid = [entry.uuid copy];
+    node->_accessTime = entry.accessTime;
+    node->_fileSize = entry.fileSize;
+
+    FBCacheEvictionNode *previous = _evictionTail;
+    while (previous != nil && previous->_accessTime > node->_accessTime) {
+        previous = previous->_previous;
+    }
+
+    node->_previous = previous;
+    if (previous) {
+        node->_next = previous->_next;
+        previous->_next = node;
+    } else {
+        node->_next = _evictionHead;
+        _evictionHead = node;
+    }
+
+    if (node->_next) {
+        node->_next->_previous = node;
+    } else {
+        _evictionTail = node;
+    }
+
+    pthread_rwlock_wrlock(&_entriesLock);
+    [_evictionEntries setObject:node forKey:node->_keyDigest];
+    pthread_rwlock_unlock(&_entriesLock);
+    [node release];
+}
+
+- (void)_evictionIndexRemoveNode:(FBCacheEvictionNode *)node
 {
-    // TODO: #1001434
+    if (node->_previous) {
+        node->_previous->_next = node->_next;
+    } else {
+        _evictionHead = node->_next;
+    }
+
+    if (node->_next) {
+        node->_next->_previous = node->_previous;
+    } else {
+        _evictionTail = node->_previous;
+    }
+
+    node->_previous = nil;
+    node->_next = nil;
+
+    pthread_rwlock_wrlock(&_entriesLock);
+    [_evictionEntries removeObjectForKey:node->_keyDigest];
+    pthread_rwlock_unlock(&_entriesLock);
 }
 
 // Trimming of cache entries based on LRU eviction policy.
-// All the computations are done at the DB level, as follows:
-// - create a temporary table 'trimmed', which computes which records need
-//   purging, based on access time and running total of file size
-// - iterate over 'trimmed', clear in-memory cache, queue data files for
-//   deletion on a background queue
-// - batch-remove these entries from the index
-// - drop the temporary 'trimmed' table.
+// Walks the eviction index from the least recently used entry, so the cost
+// is proportional to the number of evicted entries:
+// - pop entries off the head of the list until enough space is reclaimed
+// - clear in-memory cache, queue data files for deletion on a background queue
+// - remove these entries from the index in a single transaction
 - (void)_trimDatabase
 {
     NSAssert(_currentDiskUsage > _diskCapacity, @"");
@@ -582,70 +1226,45 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
         return;
     }
 
-    [self _dropTrimmingTable];
-    initializeStatement(_database, &_trimStatement, trimQuery);
-    CHECK_SQLITE_SUCCESS(fbdfl_sqlite3_bind_int(
-                                                _trimStatement,
-                                                1,
-                                                _currentDiskUsage - _diskCapacity * 0.8), _database);
-
-    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(_trimStatement), _database);
+    NSTimeInterval trimStartTime = [FBUtility monotonicTime];
 
-    // Need to re-prep this statement as it's bound to the temporary table
-    // and can be stored between trims
-    static const char *trimSelectQuery =
-    "SELECT uuid, key, file_size FROM trimmed";
-
-    sqlite3_stmt *trimSelectStatement = nil;
-    initializeStatement(
-                        _database,
-                        &trimSelectStatement,
-                        trimSelectQuery);
+    // Make sure the eviction index reflects everything that has been stored
+    [self _flushPendingEntries];
+    [self _finishLoadingEvictionIndex];
 
+    NSUInteger spaceToClean = _currentDiskUsage - _diskCapacity * 0.8;
     NSUInteger spaceCleaned = 0;
-    while (fbdfl_sqlite3_step(trimSelectStatement) == SQLITE_ROW) {
-        const unsigned char *uuidStr =
-        fbdfl_sqlite3_column_text(trimSelectStatement, 0);
-        const unsigned char *keyStr =
-        fbdfl_sqlite3_column_text(trimSelectStatement, 1);
-        spaceCleaned += fbdfl_sqlite3_column_int(trimSelectStatement, 2);
-
-        // Remove in-memory cache entry if present
-        NSString *key = [NSString
-                         stringWithCString:(const char *)keyStr
-                         encoding:NSUTF8StringEncoding];
+    int64_t evicted = 0;
 
-        NSString *uuid = [NSString
-                          stringWithCString:(const char *)uuidStr
-                          encoding:NSUTF8StringEncoding];
+    [self _beginTransaction];
+    while (_evictionHead != nil && spaceCleaned < spaceToClean) {
+        FBCacheEvictionNode *node = [[_evictionHead retain] autorelease];
+        spaceCleaned += node->_fileSize;
+        evicted++;
 
-        FBCacheEntityInfo *entry = [_cachedEntries objectForKey:key];
+        // Remove in-memory cache entry if present
+        FBCacheEntityInfo *entry = [_cachedEntries objectForKey:node->_keyDigest];
         entry.dirty = NO;
-        [_cachedEntries removeObjectForKey:key];
+        [_cachedEntries removeObjectForKey:node->_keyDigest];
+
+        [self _removeEntryFromDatabaseForKeyDigest:node->_keyDigest];
 
         // Delete the file
-        [self.delegate cacheIndex:self deleteFileWithName:uuid];
+        [self.delegate cacheIndex:self deleteFileWithName:node->_uuid];
     }
 
-    releaseStatement(trimSelectStatement, _database);
-
-    // Batch remove statement
-    sqlite3_stmt *trimCleanStatement = nil;
-    static const char *trimCleanQuery =
-    "DELETE FROM cache_index WHERE key IN (SELECT key from trimmed)";
-
-    initializeStatement(_database, &trimCleanStatement, trimCleanQuery);
-    CHECK_SQLITE_DONE(fbdfl_sqlite3_step(trimCleanStatement), _database);
-
-    releaseStatement(trimCleanStatement, _database);
-    trimCleanStatement = nil;
-
-    _currentDiskUsage -= spaceCleaned;
+    _currentDiskUsage -= MIN(_currentDiskUsage, spaceCleaned);
     NSAssert(_currentDiskUsage <= _diskCapacity, @"");
 
-    // Okay to drop the trimming table
-    [self _dropTrimmingTable];
+    [self _storeCurrentDiskUsage];
+    [self _commitTransaction];
+
     [self _flushOrphanedFiles];
+
+    OSAtomicAdd64Barrier(evicted, &_evictionCount);
+    OSAtomicAdd64Barrier((int64_t)spaceCleaned, &_evictedBytes);
+    OSAtomicIncrement64Barrier(&_trimCount);
+    addMicrosecondsSince(trimStartTime, &_trimMicroseconds);
 }
 
 @end
@@ -654,15 +1273,29 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
 
 #pragma mark - Lifecycle
 
-- (instancetype)initWithKey:(NSString *)key
-                       uuid:(NSString *)uuid
-                 accessTime:(CFTimeInterval)accessTime
-                   fileSize:(NSUInteger)fileSize
+- (instancetype)initWithKeyDigest:(NSData *)keyDigest
+                             uuid:(NSString *)uuid
+                       accessTime:(CFTimeInterval)accessTime
+                         fileSize:(NSUInteger)fileSize
+{
+    return [self initWithKeyDigest:keyDigest
+                              uuid:uuid
+                        accessTime:accessTime
+                          fileSize:fileSize
+                    cacheNamespace:nil];
+}
+
+- (instancetype)initWithKeyDigest:(NSData *)keyDigest
+                             uuid:(NSString *)uuid
+                       accessTime:(CFTimeInterval)accessTime
+                         fileSize:(NSUInteger)fileSize
+                   cacheNamespace:(NSString *)cacheNamespace
 {
     self = [super init];
     if (self != nil) {
-        _key = [key copy];
+        _keyDigest = [keyDigest copy];
         _uuid = [uuid copy];
+        _cacheNamespace = [cacheNamespace copy];
         _accessTime = accessTime;
         _fileSize = fileSize;
     }
@@ -672,7 +1305,8 @@ static void releaseStatement(sqlite3_stmt *statement, sqlite3 *database)
 
 - (void)dealloc {
     [_uuid release];
-    [_key release];
+    [_keyDigest release];
+    [_cacheNamespace release];
     [super dealloc];
 }
 
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBCancellationToken.h"
+
+@interface FBCancellationToken ()
+
+@property (nonatomic, retain) NSMutableArray *observers;
+@property (nonatomic, readwrite, getter=isCancellationRequested) BOOL cancellationRequested;
+
+@end
+
+@implementation FBCancellationToken
+
++ (FBCancellationToken *)cancellationToken {
+    return [[[self alloc] init] autorelease];
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _observers = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_observers release];
+    [super dealloc];
+}
+
+- (void)cancel {
+    NSArray *observers;
+    @synchronized (self) {
+        if (self.cancellationRequested) {
+            return;
+        }
+        self.cancellationRequested = YES;
+        observers = [[self.observers copy] autorelease];
+        [self.observers removeAllObjects];
+    }
+    // Observers cancel work, which may unregister other observers, so nothing
+    // is locked while they run.
+    for (void (^observer)(void) in observers) {
+        observer();
+    }
+}
+
+- (id)registerCancellationObserverWithBlock:(void (^)(void))block {
+    id registration = [[block copy] autorelease];
+    @synchronized (self) {
+        if (!self.cancellationRequested) {
+            [self.observers addObject:registration];
+            return registration;
+        }
+    }
+    block();
+    return registration;
+}
+
+- (void)unregisterCancellationObserver:(id)registration {
+    if (!registration) {
+        return;
+    }
+    @synchronized (self) {
+        [self.observers removeObjectIdenticalTo:registration];
+    }
+}
+
+@end
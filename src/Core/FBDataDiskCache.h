@@ -14,32 +14,136 @@
  * limitations under the License.
  */
 
+#import <pthread.h>
+
 #import <Foundation/Foundation.h>
 #import <UIKit/UIKit.h>
 
+#import "FBMemoryBudget.h"
 #import "FBSession.h"
 
-@class FBCacheIndex;
+@protocol FBCacheIndexing;
+@class FBDataDiskCacheWriter;
+
+typedef void (^FBDataDiskCacheCompletionHandler)(NSData *data);
+
+typedef struct {
+    uint64_t memoryHits;
+    uint64_t diskHits;
+    uint64_t misses;
+    // Fractions of all lookups, 0 when there have been none
+    double memoryHitRatio;
+    double diskHitRatio;
+    uint64_t evictionCount;
+    uint64_t evictedBytes;
+    // Offers kept out of the disk tier by the admission filter
+    uint64_t rejectedAdmissions;
+    uint64_t trimCount;
+    NSTimeInterval trimDuration;
+    // Callers blocked in dispatch_sync on the file or database queues
+    uint64_t syncWaitCount;
+    NSTimeInterval syncWaitDuration;
+    NSUInteger currentDiskUsage;
+} FBDataDiskCacheStatistics;
 
 // This is a Disk based cache used internally by Facebook SDK
-@interface FBDataDiskCache : NSObject
+// Lookups do not take a lock, while writes and removals are serialized with
+// respect to one another.  The in-memory tier is shed first under FBMemoryBudget,
+// since it is backed by disk.
+@interface FBDataDiskCache : NSObject <FBMemoryBudgetClient>
 {
 @private
-    NSCache *_inMemoryCache;
-    FBCacheIndex *_cacheIndex;
+    // In-memory tier, segmented by size so that a few large blobs can't
+    // evict the many small, frequently re-requested entries.
+    NSCache *_smallObjectCache;
+    NSCache *_largeObjectCache;
+    id<FBCacheIndexing> _cacheIndex;
     NSString *_dataCachePath;
+    pthread_mutex_t _writeLock;
+
+    // Shard directories known to exist.  Only accessed on _fileQueue.
+    NSMutableSet *_createdShardPaths;
 
     dispatch_queue_t _fileQueue;
+
+    // Statistics, kept the same way as FBCacheIndex's
+    volatile int64_t _memoryHits;
+    volatile int64_t _diskHits;
+    volatile int64_t _misses;
+    volatile int64_t _syncWaitCount;
+    volatile int64_t _syncWaitMicroseconds;
+    volatile int64_t _rejectedAdmissions;
+    // Bytes held by the in-memory tier, updated atomically
+    volatile int64_t _inMemoryBytes;
+
+    // Count-min sketch of recent lookups, used to decide which offered
+    // entries are worth a place on disk.  Guarded by _admissionLock.
+    uint8_t *_admissionSketch;
+    NSUInteger _admissionSampleCount;
+    pthread_mutex_t _admissionLock;
 }
 
 + (FBDataDiskCache *)sharedCache;
 
+// Total in-memory budget.  Setting it splits the budget between the small
+// and large object tiers.
 @property (nonatomic, assign) NSUInteger cacheSizeMemory;
+// Budget of the tier holding entries of up to smallObjectMaxSize bytes.
+// Setting it leaves the large object tier's budget unchanged.
+@property (nonatomic, assign) NSUInteger smallObjectCacheSizeMemory;
+@property (nonatomic, readonly) NSUInteger smallObjectMaxSize;
 @property (nonatomic, readonly) dispatch_queue_t fileQueue;
 
 - (NSData *)dataForURL:(NSURL *)dataURL;
+// Same as dataForURL: but never touches the index or disk on the calling thread.
+// The lookup runs on fileQueue, after any pending writes, and the completion is
+// always invoked asynchronously on the main thread, with nil on a miss.
+- (void)dataForURL:(NSURL *)dataURL completion:(FBDataDiskCacheCompletionHandler)completion;
 - (void)setData:(NSData *)data forURL:(NSURL *)url;
+// Text content, JSON included, is gzip compressed on disk when that saves
+// space, which lets more of it fit in the disk budget.  Lookups return it
+// decompressed.  A nil MIMEType stores the data as is.
+- (void)setData:(NSData *)data forURL:(NSURL *)url MIMEType:(NSString *)MIMEType;
+// Same as setData:forURL: for entries that may never be asked for again.  While
+// the disk tier has room everything is stored; once storing would force an
+// eviction, only URLs that have recently been looked up more than once are
+// written to disk, and the rest are only kept in memory.
+- (void)offerData:(NSData *)data forURL:(NSURL *)url;
+// Whether offerData:forURL: would store an entry of this size on disk.
+- (BOOL)shouldAdmitDataOfLength:(NSUInteger)length forURL:(NSURL *)url;
+// Returns a writer that streams data straight to a file in the cache, for
+// payloads too large to be worth buffering in memory first.
+- (FBDataDiskCacheWriter *)writerForURL:(NSURL *)url;
 - (void)removeDataForUrl:(NSURL *)url;
 - (void)removeDataForSession:(FBSession *)session;
 
+// Counters since the cache was created or resetStatistics was last called,
+// along with the current disk usage.
+- (FBDataDiskCacheStatistics)statistics;
+- (void)resetStatistics;
+
+@end
+
+
+// Appends are queued on the cache's fileQueue, so they never block the caller.
+// Exactly one of commit or discard must be called once writing is done.
+@interface FBDataDiskCacheWriter : NSObject
+{
+@private
+    FBDataDiskCache *_cache;
+    NSURL *_url;
+    NSString *_fileName;
+    NSString *_temporaryFilePath;
+    NSFileHandle *_fileHandle;
+    NSUInteger _length;
+    BOOL _failed;
+    BOOL _finished;
+}
+
+- (void)appendData:(NSData *)data;
+// Moves the file into the cache and returns its contents, mapped rather than
+// read into memory.  Returns nil if any of the writes failed.
+- (NSData *)commit;
+- (void)discard;
+
 @end
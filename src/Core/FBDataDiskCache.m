@@ -16,19 +16,139 @@
 
 #import "FBDataDiskCache.h"
 
+#import <libkern/OSAtomic.h>
+
 #import "FBAccessTokenData.h"
 #import "FBCacheIndex.h"
+#import "FBDispatch.h"
 #import "FBLogger.h"
+#import "FBMappedCacheIndex.h"
 #import "FBSettings.h"
+#import "FBStartupProfiler.h"
+#import "FBUtility.h"
 
 static const NSUInteger kMaxDataInMemorySize = 1 * 1024 * 1024; // 1MB
+static const NSUInteger kSmallObjectMaxSize = 16 * 1024; // 16KB, covers profile picture thumbnails
+static const double kSmallObjectMemoryFraction = 0.25;
 static const NSUInteger kMaxDiskCacheSize = 10 * 1024 * 1024; // 10MB
+// Text entries smaller than this aren't worth the inflate on every disk hit
+static const NSUInteger kMinCompressedEntrySize = 1024;
+// What each index backend keeps in the cache folder, to tell which one last used it
+static NSString *const kSQLiteIndexFileName = @"cache.db";
+static NSString *const kMappedIndexFileName = @"cache.idx";
 
 static NSString *const kDataDiskCachePath = @"DataDiskCache";
+// Files still being streamed in.  Anything left here is from a previous run.
+static NSString *const kIncomingPath = @"Incoming";
 static NSString *const kAccessTokenKey = @"access_token";
+// Marks entries stored gzip compressed, so no separate flag needs persisting
+static NSString *const kCompressedFileExtension = @"gz";
+
+// Namespace for entries that don't belong to any session (images and the like)
+static NSString *const kSharedNamespace = @"";
+
+// Files are spread over a two-level tree of kShardFanout x kShardFanout
+// directories (e.g. "DataDiskCache/7/c/<name>") so that no single directory
+// grows with the total number of cached files.
+static const uint32_t kShardFanout = 16;
+
+// The layout is persisted, so this must stay stable across OS versions,
+// which rules out -[NSString hash].
+static NSString *FBDataDiskCacheShardForName(NSString *name)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char *c = name.UTF8String; *c; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619u;
+    }
+
+    return [NSString stringWithFormat:@"%x/%x",
+            hash % kShardFanout,
+            (hash / kShardFanout) % kShardFanout];
+}
+
+// Admission sketch: kAdmissionSketchDepth rows of kAdmissionSketchWidth
+// saturating 4-bit counters (one byte each, for simplicity).  All counters are
+// halved every kAdmissionSampleSize lookups so that popularity fades and the
+// sketch tracks what is hot now rather than what was hot at launch.
+static const NSUInteger kAdmissionSketchDepth = 4;
+static const NSUInteger kAdmissionSketchWidth = 1024;
+static const uint8_t kAdmissionCounterMax = 15;
+static const NSUInteger kAdmissionSampleSize = 10 * kAdmissionSketchWidth;
+// Looked up at least this often since the last halving to be worth a disk write
+static const uint8_t kAdmissionMinFrequency = 2;
+
+static uint64_t FBDataDiskCacheHashURL(NSURL *url)
+{
+    // FNV-1a, over the whole string since CDN URLs differ mostly in the middle
+    uint64_t hash = 14695981039346656037ull;
+    for (const char *c = url.absoluteString.UTF8String; c && *c; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Counter for the given row, picked by double hashing on the two halves of hash
+static NSUInteger FBDataDiskCacheSketchIndex(uint64_t hash, NSUInteger row)
+{
+    uint32_t low = (uint32_t)hash;
+    uint32_t high = (uint32_t)(hash >> 32) | 1;
+    return row * kAdmissionSketchWidth + (low + row * high) % kAdmissionSketchWidth;
+}
+
+// Graph API responses are JSON, served as either of these
+static BOOL FBDataDiskCacheIsCompressibleMIMEType(NSString *MIMEType)
+{
+    return ([MIMEType hasPrefix:@"text/"] ||
+            [MIMEType isEqualToString:@"application/json"] ||
+            [MIMEType isEqualToString:@"application/javascript"]);
+}
+
+static void FBDataDiskCacheResetCounter(volatile int64_t *counter)
+{
+    int64_t value;
+    do {
+        value = *counter;
+    } while (!OSAtomicCompareAndSwap64Barrier(value, 0, counter));
+}
+
+// Entries whose URL carries an access token are scoped to that token's
+// session, everything else is shared.
+static NSString *FBDataDiskCacheNamespaceForURL(NSURL *url)
+{
+    NSString *urlString = url.absoluteString;
+    NSString *tokenPrefix = [kAccessTokenKey stringByAppendingString:@"="];
+    NSRange tokenRange = [urlString rangeOfString:tokenPrefix];
+    if (tokenRange.location == NSNotFound) {
+        return kSharedNamespace;
+    }
+
+    NSUInteger tokenStart = NSMaxRange(tokenRange);
+    NSRange separatorRange = [urlString rangeOfString:@"&"
+                                              options:0
+                                                range:NSMakeRange(tokenStart, urlString.length - tokenStart)];
+    NSUInteger tokenEnd = (separatorRange.location == NSNotFound) ? urlString.length : separatorRange.location;
+
+    return [FBUtility stringByURLDecodingString:
+            [urlString substringWithRange:NSMakeRange(tokenStart, tokenEnd - tokenStart)]];
+}
 
-@interface FBDataDiskCache () <FBCacheIndexFileDelegate>
+@interface FBDataDiskCache () <FBCacheIndexFileDelegate, NSCacheDelegate>
 @property (nonatomic, copy) NSString *dataCachePath;
+
+- (NSString *)_filePathForName:(NSString *)name;
+- (void)_dropEntryForURL:(NSURL *)url ifFileIsMissing:(NSString *)fileName;
+- (NSString *)_incomingFilePathForName:(NSString *)name;
+- (void)_createShardDirectoryForFilePath:(NSString *)filePath;
+- (void)_storeFileWithName:(NSString *)name data:(NSData *)data forURL:(NSURL *)url;
+- (void)_recordSyncWaitSince:(NSTimeInterval)startTime;
+- (void)_recordLookupForURL:(NSURL *)url;
+@end
+
+@interface FBDataDiskCacheWriter ()
+- (instancetype)initWithCache:(FBDataDiskCache *)cache url:(NSURL *)url;
 @end
 
 @implementation FBDataDiskCache
@@ -39,6 +159,10 @@ static NSString *const kAccessTokenKey = @"access_token";
 {
     self = [super init];
     if (self) {
+        pthread_mutex_init(&_writeLock, NULL);
+        pthread_mutex_init(&_admissionLock, NULL);
+        _admissionSketch = calloc(kAdmissionSketchDepth * kAdmissionSketchWidth, sizeof(uint8_t));
+
         NSArray *cacheList = NSSearchPathForDirectoriesInDomains(
                                                                  NSCachesDirectory,
                                                                  NSUserDomainMask,
@@ -48,25 +172,49 @@ static NSString *const kAccessTokenKey = @"access_token";
         _dataCachePath =
         [[cachePath stringByAppendingPathComponent:kDataDiskCachePath]
          copy];
+        _createdShardPaths = [[NSMutableSet alloc] init];
+
+        Class indexClass = [FBSettings isMappedCacheIndexEnabled] ? [FBMappedCacheIndex class] : [FBCacheIndex class];
+        // Files left by the other index would never be found or evicted by this one
+        NSString *otherIndexPath = [_dataCachePath stringByAppendingPathComponent:
+                                    (indexClass == [FBCacheIndex class]) ? kMappedIndexFileName : kSQLiteIndexFileName];
+        if ([[NSFileManager defaultManager] fileExistsAtPath:otherIndexPath]) {
+            [[NSFileManager defaultManager] removeItemAtPath:_dataCachePath error:nil];
+        }
         [[NSFileManager defaultManager]
          createDirectoryAtPath:_dataCachePath
          withIntermediateDirectories:YES
          attributes:nil
          error:nil];
 
-        dispatch_queue_t bgPriQueue =
-        dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0);
-        _fileQueue = dispatch_queue_create(
-                                           "File Cache Queue",
-                                           DISPATCH_QUEUE_SERIAL);
-        dispatch_set_target_queue(_fileQueue, bgPriQueue);
-
-        _cacheIndex = [[FBCacheIndex alloc] initWithCacheFolder:_dataCachePath];
+        _fileQueue = FBDispatchQueueCreateSerial("File Cache Queue", FBDispatchLaneBackground);
+
+        NSString *incomingPath = [_dataCachePath stringByAppendingPathComponent:kIncomingPath];
+        dispatch_async(_fileQueue, ^{
+            NSFileManager *fileManager = [NSFileManager defaultManager];
+            [fileManager removeItemAtPath:incomingPath error:nil];
+            [fileManager createDirectoryAtPath:incomingPath
+                   withIntermediateDirectories:YES
+                                    attributes:nil
+                                         error:nil];
+        });
+
+        _cacheIndex = [[indexClass alloc] initWithCacheFolder:_dataCachePath];
+        if (!_cacheIndex && indexClass != [FBCacheIndex class]) {
+            [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                                logEntry:@"FBDiskCache: unable to open the mapped index, using SQLite"];
+            _cacheIndex = [[FBCacheIndex alloc] initWithCacheFolder:_dataCachePath];
+        }
         _cacheIndex.diskCapacity = kMaxDiskCacheSize;
         _cacheIndex.delegate = self;
 
-        _inMemoryCache = [[NSCache alloc] init];
-        _inMemoryCache.totalCostLimit = kMaxDataInMemorySize;
+        _smallObjectCache = [[NSCache alloc] init];
+        _smallObjectCache.delegate = self;
+        _largeObjectCache = [[NSCache alloc] init];
+        _largeObjectCache.delegate = self;
+        self.cacheSizeMemory = kMaxDataInMemorySize;
+
+        [[FBMemoryBudget sharedBudget] registerClient:self priority:FBMemoryBudgetPriorityLow];
     }
 
     return self;
@@ -74,6 +222,11 @@ static NSString *const kAccessTokenKey = @"access_token";
 
 - (void)dealloc
 {
+    // First, so the budget can't be shedding from us while we're torn down
+    [[FBMemoryBudget sharedBudget] unregisterClient:self];
+    _smallObjectCache.delegate = nil;
+    _largeObjectCache.delegate = nil;
+
     if (_fileQueue) {
         dispatch_release(_fileQueue);
     }
@@ -82,7 +235,12 @@ static NSString *const kAccessTokenKey = @"access_token";
         [_cacheIndex release];
     }
     [_dataCachePath release];
-    [_inMemoryCache release];
+    [_createdShardPaths release];
+    [_smallObjectCache release];
+    [_largeObjectCache release];
+    free(_admissionSketch);
+    pthread_mutex_destroy(&_admissionLock);
+    pthread_mutex_destroy(&_writeLock);
     [super dealloc];
 }
 
@@ -92,6 +250,7 @@ static NSString *const kAccessTokenKey = @"access_token";
     static dispatch_once_t onceToken;
 
     dispatch_once(&onceToken, ^{
+        FBStartupProfilerMeasure("FBDataDiskCache sharedCache");
         _instance = [[FBDataDiskCache alloc] init];
     });
 
@@ -102,74 +261,223 @@ static NSString *const kAccessTokenKey = @"access_token";
 
 - (NSUInteger)cacheSizeMemory
 {
-    return _inMemoryCache.totalCostLimit;
+    return _smallObjectCache.totalCostLimit + _largeObjectCache.totalCostLimit;
 }
 
 - (void)setCacheSizeMemory:(NSUInteger)cacheSizeMemory
 {
-    _inMemoryCache.totalCostLimit = cacheSizeMemory;
+    NSUInteger smallObjectCacheSize = cacheSizeMemory * kSmallObjectMemoryFraction;
+    _smallObjectCache.totalCostLimit = smallObjectCacheSize;
+    _largeObjectCache.totalCostLimit = cacheSizeMemory - smallObjectCacheSize;
+}
+
+- (NSUInteger)smallObjectCacheSizeMemory
+{
+    return _smallObjectCache.totalCostLimit;
+}
+
+- (void)setSmallObjectCacheSizeMemory:(NSUInteger)smallObjectCacheSizeMemory
+{
+    _smallObjectCache.totalCostLimit = smallObjectCacheSizeMemory;
+}
+
+- (NSUInteger)smallObjectMaxSize
+{
+    return kSmallObjectMaxSize;
+}
+
+#pragma mark - FBMemoryBudgetClient
+
+- (NSUInteger)memoryBudgetCost
+{
+    return (NSUInteger)MAX(_inMemoryBytes, 0);
+}
+
+// NSCache can't be asked to evict part of its contents, so this sheds whole
+// tiers, the large objects first.
+- (void)shedMemoryToCost:(NSUInteger)cost
+{
+    [_largeObjectCache removeAllObjects];
+    if (self.memoryBudgetCost > cost) {
+        [_smallObjectCache removeAllObjects];
+    }
+}
+
+#pragma mark - NSCacheDelegate
+
+- (void)cache:(NSCache *)cache willEvictObject:(id)obj
+{
+    OSAtomicAdd64Barrier(-(int64_t)((NSData *)obj).length, &_inMemoryBytes);
 }
 
 #pragma mark - FBCacheIndexFileDelegate
 
-- (void)cacheIndex:(FBCacheIndex *)cacheIndex
+- (void)cacheIndex:(id<FBCacheIndexing>)cacheIndex
  writeFileWithName:(NSString *)name
               data:(NSData *)data
 {
-    NSString *filePath = [_dataCachePath stringByAppendingPathComponent:name];
+    NSString *filePath = [self _filePathForName:name];
     dispatch_async(_fileQueue, ^{
+        [self _createShardDirectoryForFilePath:filePath];
         [data writeToFile:filePath atomically:YES];
     });
 }
 
-- (void)cacheIndex:(FBCacheIndex *)cacheIndex
+- (void)cacheIndex:(id<FBCacheIndexing>)cacheIndex
 deleteFileWithName:(NSString *)name
 {
-    NSString *filePath = [_dataCachePath stringByAppendingPathComponent:name];
+    NSString *filePath = [self _filePathForName:name];
+    NSString *legacyFilePath = [_dataCachePath stringByAppendingPathComponent:name];
     dispatch_async(_fileQueue, ^{
-        [[NSFileManager defaultManager]
-         removeItemAtPath:filePath
-         error:nil];
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        if (![fileManager removeItemAtPath:filePath error:nil]) {
+            // May predate the sharded layout
+            [fileManager removeItemAtPath:legacyFilePath error:nil];
+        }
     });
 }
 
 #pragma mark - Other Methods
 
-- (BOOL)_doesFileExist:(NSString *)name
+- (NSData *)_inMemoryDataForURL:(NSURL *)url
+{
+    NSData *data = (NSData *)[_smallObjectCache objectForKey:url];
+    if (data == nil) {
+        data = (NSData *)[_largeObjectCache objectForKey:url];
+    }
+    return data;
+}
+
+- (void)_setInMemoryData:(NSData *)data forURL:(NSURL *)url
+{
+    NSCache *tier = _largeObjectCache;
+    NSCache *otherTier = _smallObjectCache;
+    if (data.length <= kSmallObjectMaxSize) {
+        tier = _smallObjectCache;
+        otherTier = _largeObjectCache;
+    }
+
+    // The entry may have changed size class.  Replacing an object doesn't tell
+    // the delegate, so the old one is removed first to keep _inMemoryBytes right.
+    [otherTier removeObjectForKey:url];
+    [tier removeObjectForKey:url];
+    [tier setObject:data forKey:url cost:data.length];
+    OSAtomicAdd64Barrier((int64_t)data.length, &_inMemoryBytes);
+    [[FBMemoryBudget sharedBudget] clientDidGrow:self];
+}
+
+- (void)_removeInMemoryDataForURL:(NSURL *)url
+{
+    [_smallObjectCache removeObjectForKey:url];
+    [_largeObjectCache removeObjectForKey:url];
+}
+
+- (NSString *)_filePathForName:(NSString *)name
+{
+    return [[_dataCachePath stringByAppendingPathComponent:FBDataDiskCacheShardForName(name)]
+            stringByAppendingPathComponent:name];
+}
+
+- (NSString *)_incomingFilePathForName:(NSString *)name
+{
+    return [[_dataCachePath stringByAppendingPathComponent:kIncomingPath]
+            stringByAppendingPathComponent:name];
+}
+
+// Must be called on _fileQueue
+- (void)_createShardDirectoryForFilePath:(NSString *)filePath
+{
+    NSString *shardPath = [filePath stringByDeletingLastPathComponent];
+    if (![_createdShardPaths containsObject:shardPath]) {
+        [[NSFileManager defaultManager]
+         createDirectoryAtPath:shardPath
+         withIntermediateDirectories:YES
+         attributes:nil
+         error:nil];
+        [_createdShardPaths addObject:shardPath];
+    }
+}
+
+// Returns the path to the file backing the given name, or nil if there is none.
+// Files written before the sharded layout, at the top level of the cache
+// directory, are still found and moved into their shard.
+- (NSString *)_existingFilePathForName:(NSString *)name
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *filePath = [self _filePathForName:name];
+    if ([fileManager fileExistsAtPath:filePath]) {
+        return filePath;
+    }
+
+    NSString *legacyFilePath = [_dataCachePath stringByAppendingPathComponent:name];
+    if (![fileManager fileExistsAtPath:legacyFilePath]) {
+        return nil;
+    }
+
+    dispatch_async(_fileQueue, ^{
+        [self _createShardDirectoryForFilePath:filePath];
+        [[NSFileManager defaultManager] moveItemAtPath:legacyFilePath toPath:filePath error:nil];
+    });
+    return legacyFilePath;
+}
+
+// The index isn't checked against the directory at startup, so an entry whose
+// file has gone missing is only noticed when it is looked up.  Checked again
+// on fileQueue, behind any write of the file still in flight, before the
+// entry is removed.
+- (void)_dropEntryForURL:(NSURL *)url ifFileIsMissing:(NSString *)fileName
 {
-    NSString *filePath = [_dataCachePath stringByAppendingPathComponent:name];
-    return [[NSFileManager defaultManager] fileExistsAtPath:filePath];
+    dispatch_async(_fileQueue, ^{
+        NSString *key = url.absoluteString;
+        if ([self _existingFilePathForName:fileName] == nil &&
+            [[_cacheIndex fileNameForKey:key] isEqualToString:fileName]) {
+            [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                            formatString:@"FBDiskCache: dropping entry with missing file %@", fileName];
+            [_cacheIndex removeEntryForKey:key];
+        }
+    });
 }
 
+// Both NSCache and FBCacheIndex lookups are thread-safe, so no locking is
+// needed here beyond the brief one around the admission sketch.
 - (NSData *)dataForURL:(NSURL *)dataURL
 {
-    // TODO: Synchronize this across threads
     NSData *data = nil;
     @try {
-        data = (NSData *)[_inMemoryCache objectForKey:dataURL];
+        [self _recordLookupForURL:dataURL];
+        data = [self _inMemoryDataForURL:dataURL];
         NSString *fileName =
         [_cacheIndex fileNameForKey:dataURL.absoluteString];
 
-        if (data == nil && fileName != nil) {
+        if (data) {
+            OSAtomicIncrement64Barrier(&_memoryHits);
+        } else if (fileName != nil) {
             // Not in-memory, on-disk only, read in
-            if ([self _doesFileExist:fileName]) {
-                NSString *cachePath =
-                [_dataCachePath stringByAppendingPathComponent:fileName];
-
+            NSString *cachePath = [self _existingFilePathForName:fileName];
+            if (cachePath && [fileName.pathExtension isEqualToString:kCompressedFileExtension]) {
+                // Inflated on the caller's thread, which for the asynchronous
+                // lookup is fileQueue
+                data = [FBUtility gunzipData:[NSData dataWithContentsOfFile:cachePath
+                                                                    options:NSDataReadingUncached
+                                                                      error:nil]];
+            } else if (cachePath) {
                 data = [NSData
                         dataWithContentsOfFile:cachePath
                         options:NSDataReadingMappedAlways | NSDataReadingUncached
                         error:nil];
+            }
 
-                if (data) {
-                    // It is possible that the file doesn't exist
-                    [_inMemoryCache
-                     setObject:data
-                     forKey:dataURL
-                     cost:data.length];
-                }
+            if (data) {
+                // It is possible that the file doesn't exist
+                [self _setInMemoryData:data forURL:dataURL];
+                OSAtomicIncrement64Barrier(&_diskHits);
+            } else {
+                [self _dropEntryForURL:dataURL ifFileIsMissing:fileName];
             }
         }
+        if (data == nil) {
+            OSAtomicIncrement64Barrier(&_misses);
+        }
     } @catch (NSException *exception) {
         [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors formatString:@"FBDiskCache error: %@", exception.reason];
     } @finally {
@@ -177,14 +485,85 @@ deleteFileWithName:(NSString *)name
     }
 }
 
+- (void)dataForURL:(NSURL *)dataURL completion:(FBDataDiskCacheCompletionHandler)completion
+{
+    NSData *data = [self _inMemoryDataForURL:dataURL];
+    if (data) {
+        [self _recordLookupForURL:dataURL];
+        OSAtomicIncrement64Barrier(&_memoryHits);
+        // Keep the entry's access time current without blocking the caller
+        dispatch_async(_fileQueue, ^{
+            [_cacheIndex fileNameForKey:dataURL.absoluteString];
+        });
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(data);
+        });
+        return;
+    }
+
+    // Someone is waiting for this one, so it shouldn't wait out the writes and trims
+    FBDispatchAsync(_fileQueue, FBDispatchLaneUserInteractive, ^{
+        NSData *diskData = [self dataForURL:dataURL];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(diskData);
+        });
+    });
+}
+
+- (FBDataDiskCacheStatistics)statistics
+{
+    FBCacheIndexStatistics indexStatistics = [_cacheIndex statistics];
+
+    FBDataDiskCacheStatistics statistics;
+    statistics.memoryHits = (uint64_t)_memoryHits;
+    statistics.diskHits = (uint64_t)_diskHits;
+    statistics.misses = (uint64_t)_misses;
+    uint64_t lookups = statistics.memoryHits + statistics.diskHits + statistics.misses;
+    statistics.memoryHitRatio = lookups ? (double)statistics.memoryHits / lookups : 0;
+    statistics.diskHitRatio = lookups ? (double)statistics.diskHits / lookups : 0;
+    statistics.evictionCount = indexStatistics.evictionCount;
+    statistics.evictedBytes = indexStatistics.evictedBytes;
+    statistics.rejectedAdmissions = (uint64_t)_rejectedAdmissions;
+    statistics.trimCount = indexStatistics.trimCount;
+    statistics.trimDuration = indexStatistics.trimDuration;
+    statistics.syncWaitCount = (uint64_t)_syncWaitCount + indexStatistics.syncWaitCount;
+    statistics.syncWaitDuration = (NSTimeInterval)_syncWaitMicroseconds / USEC_PER_SEC + indexStatistics.syncWaitDuration;
+    statistics.currentDiskUsage = _cacheIndex.currentDiskUsage;
+    return statistics;
+}
+
+- (void)resetStatistics
+{
+    FBDataDiskCacheResetCounter(&_memoryHits);
+    FBDataDiskCacheResetCounter(&_diskHits);
+    FBDataDiskCacheResetCounter(&_misses);
+    FBDataDiskCacheResetCounter(&_syncWaitCount);
+    FBDataDiskCacheResetCounter(&_syncWaitMicroseconds);
+    FBDataDiskCacheResetCounter(&_rejectedAdmissions);
+    [_cacheIndex resetStatistics];
+}
+
+- (void)_recordSyncWaitSince:(NSTimeInterval)startTime
+{
+    OSAtomicIncrement64Barrier(&_syncWaitCount);
+    OSAtomicAdd64Barrier((int64_t)(([FBUtility monotonicTime] - startTime) * USEC_PER_SEC), &_syncWaitMicroseconds);
+}
+
+- (FBDataDiskCacheWriter *)writerForURL:(NSURL *)url
+{
+    return [[[FBDataDiskCacheWriter alloc] initWithCache:self url:url] autorelease];
+}
+
 - (void)removeDataForUrl:(NSURL *)url
 {
-    // TODO: Synchronize this across threads
+    pthread_mutex_lock(&_writeLock);
     @try {
-        [_inMemoryCache removeObjectForKey:url];
+        [self _removeInMemoryDataForURL:url];
         [_cacheIndex removeEntryForKey:url.absoluteString];
     } @catch (NSException *exception) {
         [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors formatString:@"FBDiskCache error: %@", exception.reason];
+    } @finally {
+        pthread_mutex_unlock(&_writeLock);
     }
 }
 
@@ -199,31 +578,257 @@ deleteFileWithName:(NSString *)name
     // be to maintain refCounts of these entries associated with accessTokens
     // and use that to decide which images to delete. However, this might be
     // overkill for a cache. Maybe revisit later?
-    [_cacheIndex removeEntries:kAccessTokenKey excludingFragment:YES];
+    pthread_mutex_lock(&_writeLock);
+    @try {
+        [_cacheIndex removeEntriesInNamespace:kSharedNamespace];
+
+        // Entries written before namespaces existed can't be attributed to a
+        // session, so treat them as belonging to every session.
+        [_cacheIndex removeEntriesInNamespace:nil];
+
+        NSString *accessToken = session.accessTokenData.accessToken;
+        if (accessToken != nil) {
+            // Here we are removing all cache entries that have this session's access
+            // token in the url.
+            [_cacheIndex removeEntriesInNamespace:accessToken];
+        }
 
-    NSString *accessToken = session.accessTokenData.accessToken;
-    if (accessToken != nil) {
-        // Here we are removing all cache entries that have this session's access
-        // token in the url.
-        [_cacheIndex removeEntries:accessToken excludingFragment:NO];
+        // The index only keeps digests of the keys it removed, and what's left
+        // in memory is almost entirely shared or this session's, so drop it all.
+        // Other sessions' entries are still on disk.
+        [_smallObjectCache removeAllObjects];
+        [_largeObjectCache removeAllObjects];
+    } @catch (NSException *exception) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors formatString:@"FBDiskCache error: %@", exception.reason];
+    } @finally {
+        pthread_mutex_unlock(&_writeLock);
     }
 }
 
 - (void)setData:(NSData *)data forURL:(NSURL *)url
 {
-    // TODO: Synchronize this across threads
+    [self setData:data forURL:url MIMEType:nil];
+}
+
+- (void)setData:(NSData *)data forURL:(NSURL *)url MIMEType:(NSString *)MIMEType
+{
+    NSData *compressedData = nil;
+    if (data.length >= kMinCompressedEntrySize && FBDataDiskCacheIsCompressibleMIMEType(MIMEType)) {
+        compressedData = [FBUtility gzipData:data];
+        if (compressedData.length >= data.length) {
+            compressedData = nil;
+        }
+    }
+
+    // Serialized so that the index and the in-memory cache can't end up
+    // holding different versions of the same URL
+    pthread_mutex_lock(&_writeLock);
+    @try {
+        if (compressedData) {
+            NSString *uuid = [FBUtility newUUIDString];
+            NSString *fileName = [uuid stringByAppendingPathExtension:kCompressedFileExtension];
+            [uuid release];
+
+            // Queued ahead of anything the index may ask to be deleted
+            [self cacheIndex:_cacheIndex writeFileWithName:fileName data:compressedData];
+            [_cacheIndex
+             storeFileWithName:fileName
+             forKey:url.absoluteString
+             fileSize:compressedData.length
+             namespace:FBDataDiskCacheNamespaceForURL(url)];
+        } else {
+            [_cacheIndex
+             storeFileForKey:url.absoluteString
+             withData:data
+             namespace:FBDataDiskCacheNamespaceForURL(url)];
+        }
+
+        [self _setInMemoryData:data forURL:url];
+    } @catch (NSException *exception) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors formatString:@"FBDiskCache error: %@", exception.reason];
+    } @finally {
+        pthread_mutex_unlock(&_writeLock);
+    }
+}
+
+- (void)offerData:(NSData *)data forURL:(NSURL *)url
+{
+    if ([self shouldAdmitDataOfLength:data.length forURL:url]) {
+        [self setData:data forURL:url];
+        return;
+    }
+
+    OSAtomicIncrement64Barrier(&_rejectedAdmissions);
+    @try {
+        [self _setInMemoryData:data forURL:url];
+    } @catch (NSException *exception) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors formatString:@"FBDiskCache error: %@", exception.reason];
+    }
+}
+
+- (BOOL)shouldAdmitDataOfLength:(NSUInteger)length forURL:(NSURL *)url
+{
+    // Nothing would be evicted to make room, so there is nothing to protect
+    if (_cacheIndex.currentDiskUsage + length <= _cacheIndex.diskCapacity) {
+        return YES;
+    }
+
+    uint64_t hash = FBDataDiskCacheHashURL(url);
+    uint8_t frequency = kAdmissionCounterMax;
+    pthread_mutex_lock(&_admissionLock);
+    for (NSUInteger row = 0; row < kAdmissionSketchDepth; row++) {
+        frequency = MIN(frequency, _admissionSketch[FBDataDiskCacheSketchIndex(hash, row)]);
+    }
+    pthread_mutex_unlock(&_admissionLock);
+
+    return frequency >= kAdmissionMinFrequency;
+}
+
+- (void)_recordLookupForURL:(NSURL *)url
+{
+    uint64_t hash = FBDataDiskCacheHashURL(url);
+    pthread_mutex_lock(&_admissionLock);
+    for (NSUInteger row = 0; row < kAdmissionSketchDepth; row++) {
+        uint8_t *counter = &_admissionSketch[FBDataDiskCacheSketchIndex(hash, row)];
+        if (*counter < kAdmissionCounterMax) {
+            (*counter)++;
+        }
+    }
+    if (++_admissionSampleCount >= kAdmissionSampleSize) {
+        for (NSUInteger i = 0; i < kAdmissionSketchDepth * kAdmissionSketchWidth; i++) {
+            _admissionSketch[i] >>= 1;
+        }
+        _admissionSampleCount = 0;
+    }
+    pthread_mutex_unlock(&_admissionLock);
+}
+
+// Same as setData:forURL: for a file that is already in place
+- (void)_storeFileWithName:(NSString *)name data:(NSData *)data forURL:(NSURL *)url
+{
+    pthread_mutex_lock(&_writeLock);
     @try {
         [_cacheIndex
-         storeFileForKey:url.absoluteString
-         withData:data];
+         storeFileWithName:name
+         forKey:url.absoluteString
+         fileSize:data.length
+         namespace:FBDataDiskCacheNamespaceForURL(url)];
 
-        [_inMemoryCache
-         setObject:data
-         forKey:url
-         cost:data.length];
+        [self _setInMemoryData:data forURL:url];
     } @catch (NSException *exception) {
         [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors formatString:@"FBDiskCache error: %@", exception.reason];
+    } @finally {
+        pthread_mutex_unlock(&_writeLock);
+    }
+}
+
+@end
+
+@implementation FBDataDiskCacheWriter
+
+- (instancetype)initWithCache:(FBDataDiskCache *)cache url:(NSURL *)url
+{
+    self = [super init];
+    if (self) {
+        _cache = [cache retain];
+        _url = [url copy];
+
+        CFUUIDRef uuid = CFUUIDCreate(kCFAllocatorDefault);
+        _fileName = (NSString *)CFUUIDCreateString(kCFAllocatorDefault, uuid);
+        CFRelease(uuid);
+
+        _temporaryFilePath = [[cache _incomingFilePathForName:_fileName] copy];
+        dispatch_async(cache.fileQueue, ^{
+            if ([[NSFileManager defaultManager] createFileAtPath:_temporaryFilePath
+                                                        contents:nil
+                                                      attributes:nil]) {
+                _fileHandle = [[NSFileHandle fileHandleForWritingAtPath:_temporaryFilePath] retain];
+            }
+            _failed = (_fileHandle == nil);
+        });
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    NSAssert(_finished, @"FBDataDiskCacheWriter was neither committed nor discarded");
+    [_cache release];
+    [_url release];
+    [_fileName release];
+    [_temporaryFilePath release];
+    [_fileHandle release];
+    [super dealloc];
+}
+
+- (void)appendData:(NSData *)data
+{
+    NSAssert(!_finished, @"");
+    dispatch_async(_cache.fileQueue, ^{
+        if (_failed) {
+            return;
+        }
+
+        @try {
+            [_fileHandle writeData:data];
+        } @catch (NSException *exception) {
+            [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors formatString:@"FBDiskCache error: %@", exception.reason];
+            _failed = YES;
+        }
+    });
+}
+
+// Waits for the queued appends, so must not be called on fileQueue
+- (NSData *)commit
+{
+    NSAssert(!_finished, @"");
+    _finished = YES;
+
+    NSString *filePath = [_cache _filePathForName:_fileName];
+    __block BOOL moved = NO;
+    NSTimeInterval waitStartTime = [FBUtility monotonicTime];
+    dispatch_sync(_cache.fileQueue, ^{
+        [_fileHandle closeFile];
+
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        if (!_failed) {
+            [_cache _createShardDirectoryForFilePath:filePath];
+            moved = [fileManager moveItemAtPath:_temporaryFilePath toPath:filePath error:nil];
+        }
+        if (!moved) {
+            [fileManager removeItemAtPath:_temporaryFilePath error:nil];
+        }
+    });
+    [_cache _recordSyncWaitSince:waitStartTime];
+
+    if (!moved) {
+        return nil;
+    }
+
+    NSData *data = [NSData dataWithContentsOfFile:filePath
+                                          options:NSDataReadingMappedAlways
+                                            error:nil];
+    if (data) {
+        [_cache _storeFileWithName:_fileName data:data forURL:_url];
+    } else {
+        dispatch_async(_cache.fileQueue, ^{
+            [[NSFileManager defaultManager] removeItemAtPath:filePath error:nil];
+        });
     }
+
+    return data;
+}
+
+- (void)discard
+{
+    NSAssert(!_finished, @"");
+    _finished = YES;
+
+    dispatch_async(_cache.fileQueue, ^{
+        [_fileHandle closeFile];
+        [[NSFileManager defaultManager] removeItemAtPath:_temporaryFilePath error:nil];
+    });
 }
 
 @end
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+#import "FBSDKMacros.h"
+
+// The SDK's background work runs on one of these lanes, so that cache reads a visible
+// view is waiting for don't queue behind cache trims. On iOS 8 and later the lanes are
+// quality of service classes; before that, global queue priorities.
+typedef NS_ENUM(NSUInteger, FBDispatchLane) {
+    // Work something on screen is waiting for, such as reading a visible cell's data
+    FBDispatchLaneUserInteractive,
+    // Work that finishes a request, such as parsing responses and encoding bodies
+    FBDispatchLaneUtility,
+    // Maintenance nobody is waiting for, such as trimming caches and saving snapshots
+    FBDispatchLaneBackground,
+};
+
+// The global concurrent queue for the lane.
+FBSDK_EXTERN dispatch_queue_t FBDispatchGetGlobalQueue(FBDispatchLane lane);
+
+// A new serial queue that runs its blocks on the lane, unless they are boosted
+// with FBDispatchAsync. Release it with dispatch_release.
+FBSDK_EXTERN dispatch_queue_t FBDispatchQueueCreateSerial(const char *label, FBDispatchLane lane);
+
+// The concurrent counterpart of FBDispatchQueueCreateSerial, for barrier-guarded
+// state and work that may run in parallel. Release it with dispatch_release.
+FBSDK_EXTERN dispatch_queue_t FBDispatchQueueCreateConcurrent(const char *label, FBDispatchLane lane);
+
+// Like dispatch_async, except that the block runs on the given lane even on a queue
+// created for a lower one, raising the queue while the block is waiting. On systems
+// without quality of service classes the block runs at the queue's own priority.
+FBSDK_EXTERN void FBDispatchAsync(dispatch_queue_t queue, FBDispatchLane lane, dispatch_block_t block);
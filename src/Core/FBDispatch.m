@@ -0,0 +1,90 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBDispatch.h"
+
+#if defined(__IPHONE_8_0) && __IPHONE_OS_VERSION_MAX_ALLOWED >= __IPHONE_8_0
+#define FB_DISPATCH_QOS_AVAILABLE 1
+#else
+#define FB_DISPATCH_QOS_AVAILABLE 0
+#endif
+
+static long FBDispatchLanePriority(FBDispatchLane lane) {
+    switch (lane) {
+        case FBDispatchLaneUserInteractive:
+            return DISPATCH_QUEUE_PRIORITY_HIGH;
+        case FBDispatchLaneUtility:
+            return DISPATCH_QUEUE_PRIORITY_DEFAULT;
+        case FBDispatchLaneBackground:
+            return DISPATCH_QUEUE_PRIORITY_BACKGROUND;
+    }
+    return DISPATCH_QUEUE_PRIORITY_DEFAULT;
+}
+
+#if FB_DISPATCH_QOS_AVAILABLE
+static qos_class_t FBDispatchLaneQOSClass(FBDispatchLane lane) {
+    switch (lane) {
+        case FBDispatchLaneUserInteractive:
+            // The user interactive class is meant for the main thread's own event
+            // handling; work feeding a view from off the main thread is user initiated
+            return QOS_CLASS_USER_INITIATED;
+        case FBDispatchLaneUtility:
+            return QOS_CLASS_UTILITY;
+        case FBDispatchLaneBackground:
+            return QOS_CLASS_BACKGROUND;
+    }
+    return QOS_CLASS_DEFAULT;
+}
+#endif
+
+dispatch_queue_t FBDispatchGetGlobalQueue(FBDispatchLane lane) {
+    dispatch_queue_t queue = NULL;
+#if FB_DISPATCH_QOS_AVAILABLE
+    // Older systems don't know the classes, and return NULL for them
+    queue = dispatch_get_global_queue(FBDispatchLaneQOSClass(lane), 0);
+#endif
+    return queue ?: dispatch_get_global_queue(FBDispatchLanePriority(lane), 0);
+}
+
+dispatch_queue_t FBDispatchQueueCreateSerial(const char *label, FBDispatchLane lane) {
+    dispatch_queue_t queue = dispatch_queue_create(label, DISPATCH_QUEUE_SERIAL);
+    dispatch_set_target_queue(queue, FBDispatchGetGlobalQueue(lane));
+    return queue;
+}
+
+dispatch_queue_t FBDispatchQueueCreateConcurrent(const char *label, FBDispatchLane lane) {
+    dispatch_queue_t queue = dispatch_queue_create(label, DISPATCH_QUEUE_CONCURRENT);
+    dispatch_set_target_queue(queue, FBDispatchGetGlobalQueue(lane));
+    return queue;
+}
+
+void FBDispatchAsync(dispatch_queue_t queue, FBDispatchLane lane, dispatch_block_t block) {
+#if FB_DISPATCH_QOS_AVAILABLE
+    if (&dispatch_block_create_with_qos_class != NULL) {
+        // Enforcing the class on a block enqueued on a lower queue overrides the
+        // queue until the block has run, so it doesn't wait out the queue's priority
+        dispatch_block_t boosted = dispatch_block_create_with_qos_class(DISPATCH_BLOCK_ENFORCE_QOS_CLASS,
+                                                                         FBDispatchLaneQOSClass(lane),
+                                                                         0,
+                                                                         block);
+        dispatch_async(queue, boosted);
+        Block_release(boosted);
+        return;
+    }
+#endif
+    dispatch_async(queue, block);
+}
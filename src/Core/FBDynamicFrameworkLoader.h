@@ -15,11 +15,13 @@
  */
 
 #import <sqlite3.h>
+#import <zlib.h>
 
 #import <AudioToolbox/AudioToolbox.h>
 #import <Foundation/Foundation.h>
 #import <QuartzCore/QuartzCore.h>
 #import <Security/Security.h>
+#import <SystemConfiguration/SystemConfiguration.h>
 
 #import "FBSDKMacros.h"
 
@@ -107,6 +109,23 @@
  */
 + (void)setSqlitePath:(NSString *)path;
 
+/*!
+ @abstract
+ Returns the path to the zlib library
+
+ @return The path we will attempt to load the zlib library from
+ */
++ (NSString *)zlibPath;
+
+/*!
+ @abstract
+ Opens the libraries and frameworks the SDK resolves symbols from, so that the first call into
+ them only has to look the symbol up.  May be called from any thread.
+
+ @return void
+ */
++ (void)prewarm;
+
 @end
 
 // Security c-style APIs
@@ -124,11 +143,26 @@ SQLITE_API int fbdfl_sqlite3_exec(sqlite3 *db, const char *sql, int (*callback)(
 SQLITE_API int fbdfl_sqlite3_close(sqlite3 *db);
 SQLITE_API int fbdfl_sqlite3_bind_double(sqlite3_stmt *stmt, int index, double value);
 SQLITE_API int fbdfl_sqlite3_bind_int(sqlite3_stmt *stmt, int index, int value);
+SQLITE_API int fbdfl_sqlite3_bind_int64(sqlite3_stmt *stmt, int index, sqlite3_int64 value);
+SQLITE_API int fbdfl_sqlite3_bind_null(sqlite3_stmt *stmt, int index);
 SQLITE_API int fbdfl_sqlite3_bind_text(sqlite3_stmt *stmt, int index, const char *value, int n, void(*callback)(void *));
+SQLITE_API int fbdfl_sqlite3_bind_blob(sqlite3_stmt *stmt, int index, const void *value, int n, void(*callback)(void *));
 SQLITE_API int fbdfl_sqlite3_step(sqlite3_stmt *stmt);
 SQLITE_API double fbdfl_sqlite3_column_double(sqlite3_stmt *stmt, int iCol);
 SQLITE_API int fbdfl_sqlite3_column_int(sqlite3_stmt *stmt, int iCol);
+SQLITE_API sqlite3_int64 fbdfl_sqlite3_column_int64(sqlite3_stmt *stmt, int iCol);
 SQLITE_API const unsigned char *fbdfl_sqlite3_column_text(sqlite3_stmt *stmt, int iCol);
+SQLITE_API const void *fbdfl_sqlite3_column_blob(sqlite3_stmt *stmt, int iCol);
+SQLITE_API int fbdfl_sqlite3_column_bytes(sqlite3_stmt *stmt, int iCol);
+
+// zlib c-style APIs
+// These are local wrappers around the corresponding zlib methods from /usr/include/zlib.h
+int fbdfl_deflateInit2(z_streamp strm, int level, int method, int windowBits, int memLevel, int strategy);
+int fbdfl_deflate(z_streamp strm, int flush);
+int fbdfl_deflateEnd(z_streamp strm);
+int fbdfl_inflateInit2(z_streamp strm, int windowBits);
+int fbdfl_inflate(z_streamp strm, int flush);
+int fbdfl_inflateEnd(z_streamp strm);
 
 // QuartzCore c-style APIs
 // These are local wrappers around the corresponding transform methods from QuartzCore.framework/CATransform3D.h
@@ -143,3 +177,10 @@ FBSDK_EXTERN const CATransform3D fbdfl_CATransform3DIdentity;
 OSStatus fbdfl_AudioServicesCreateSystemSoundID(CFURLRef inFileURL, SystemSoundID *outSystemSoundID);
 OSStatus fbdfl_AudioServicesDisposeSystemSoundID(SystemSoundID inSystemSoundID);
 void fbdfl_AudioServicesPlaySystemSound(SystemSoundID inSystemSoundID);
+
+// SystemConfiguration c-style APIs
+// These are local wrappers around the corresponding methods in SystemConfiguration/SCNetworkReachability.h
+SCNetworkReachabilityRef fbdfl_SCNetworkReachabilityCreateWithAddress(CFAllocatorRef allocator, const struct sockaddr *address);
+Boolean fbdfl_SCNetworkReachabilityGetFlags(SCNetworkReachabilityRef target, SCNetworkReachabilityFlags *flags);
+Boolean fbdfl_SCNetworkReachabilitySetCallback(SCNetworkReachabilityRef target, SCNetworkReachabilityCallBack callout, SCNetworkReachabilityContext *context);
+Boolean fbdfl_SCNetworkReachabilitySetDispatchQueue(SCNetworkReachabilityRef target, dispatch_queue_t queue);
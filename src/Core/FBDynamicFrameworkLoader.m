@@ -17,25 +17,26 @@
 #import "FBDynamicFrameworkLoader.h"
 
 #import <dlfcn.h>
+#import <libkern/OSAtomic.h>
 
 #import "FBLogger.h"
 #import "FBSettings.h"
+#import "FBStartupProfiler.h"
 
-static dispatch_once_t g_dispatchTokenLibrary;
-static dispatch_once_t g_dispatchTokenSymbol;
+// Guarded by @synchronized ([FBDynamicFrameworkLoader class])
 static NSMutableDictionary *g_libraryMap = nil;
 static NSMutableDictionary *g_symbolMap = nil;
 
+// Only called with the lock held
 static void *openLibrary(NSString *libraryPath) {
     if (!g_libraryMap) {
-        dispatch_once(&g_dispatchTokenLibrary, ^{
-            g_libraryMap = [[NSMutableDictionary alloc] init];
-        });
+        g_libraryMap = [[NSMutableDictionary alloc] init];
     }
     id cachedHandle = [g_libraryMap objectForKey:libraryPath];
     if (cachedHandle) {
         return [cachedHandle pointerValue];
     }
+    FBStartupProfilerMeasure("FBDynamicFrameworkLoader dlopen");
     void *handle = dlopen([libraryPath fileSystemRepresentation], RTLD_LAZY);
     if (handle) {
         [FBLogger singleShotLogEntry:FBLoggingBehaviorInformational formatString:@"Dynamically loaded library at %@", libraryPath];
@@ -47,22 +48,49 @@ static void *openLibrary(NSString *libraryPath) {
 }
 
 static void *loadSymbol(NSString *libraryPath, NSString *symbolName) {
-    if (!g_symbolMap) {
-        dispatch_once(&g_dispatchTokenSymbol, ^{
+    @synchronized ([FBDynamicFrameworkLoader class]) {
+        if (!g_symbolMap) {
             g_symbolMap = [[NSMutableDictionary alloc] init];
-        });
+        }
+        NSString *key = [NSString stringWithFormat:@"%@:%@", libraryPath, symbolName];
+        id cachedHandle = [g_symbolMap objectForKey:key];
+        if (cachedHandle) {
+            return [cachedHandle pointerValue];
+        }
+        void *handle = openLibrary(libraryPath);
+        void *symbol = dlsym(handle, [symbolName cStringUsingEncoding:NSASCIIStringEncoding]);
+        [g_symbolMap setObject:[NSValue valueWithPointer:symbol] forKey:key];
+        return symbol;
     }
-    NSString *key = [NSString stringWithFormat:@"%@:%@", libraryPath, symbolName];
-    id cachedHandle = [g_symbolMap objectForKey:key];
-    if (cachedHandle) {
-        return [cachedHandle pointerValue];
-    }
-    void *handle = openLibrary(libraryPath);
-    void *symbol = dlsym(handle, [symbolName cStringUsingEncoding:NSASCIIStringEncoding]);
-    [g_symbolMap setObject:[NSValue valueWithPointer:symbol] forKey:key];
+}
+
+// Bumped by the path setters, so that symbols resolved from the old paths are resolved again
+static volatile int32_t g_pathGeneration = 1;
+
+typedef struct {
+    void *volatile symbol;
+    volatile int32_t generation;
+} FBDFLSlot;
+
+// The wrappers below keep what they resolve in a static slot, so after the first call
+// each costs two loads and the indirect call. Racing first calls resolve the same address,
+// so it doesn't matter whose store lands; a symbol that isn't there is looked up again.
+static void *resolveSymbol(FBDFLSlot *slot, NSString *libraryPath, NSString *symbolName) {
+    int32_t generation = g_pathGeneration;
+    void *symbol = loadSymbol(libraryPath, symbolName);
+    slot->symbol = symbol;
+    OSMemoryBarrier();
+    slot->generation = generation;
     return symbol;
 }
 
+// Declares `f`, of function pointer type `type`, resolved through its own slot. `libraryPath`
+// is only evaluated when the symbol still needs resolving.
+#define FBDFLResolve(f, type, libraryPath, symbolName) \
+    static FBDFLSlot f##Slot = { NULL, 0 }; \
+    type f = (type)((f##Slot.generation == g_pathGeneration && f##Slot.symbol) ? \
+                    f##Slot.symbol : resolveSymbol(&f##Slot, (libraryPath), (symbolName)))
+
 static NSString *buildFrameworkPath(NSString *framework) {
     NSString *path = [NSString stringWithFormat:[FBDynamicFrameworkLoader frameworkPathTemplate], framework, framework];
     return path;
@@ -72,6 +100,7 @@ static NSString *buildFrameworkPath(NSString *framework) {
 
 static NSString *g_frameworkPathTemplate = @"/System/Library/Frameworks/%@.framework/%@";
 static NSString *g_sqlitePath = @"/usr/lib/libsqlite3.dylib";
+static NSString *const g_zlibPath = @"/usr/lib/libz.dylib";
 
 + (Class)loadClass:(NSString *)className withFramework:(NSString *)frameworkName {
     NSString *symbolName = [NSString stringWithFormat:@"OBJC_CLASS_$_%@", className];
@@ -107,6 +136,7 @@ static NSString *g_sqlitePath = @"/usr/lib/libsqlite3.dylib";
     [pathTemplate retain];
     [g_frameworkPathTemplate release];
     g_frameworkPathTemplate = pathTemplate;
+    OSAtomicIncrement32Barrier(&g_pathGeneration);
 }
 
 + (NSString *)sqlitePath {
@@ -117,6 +147,23 @@ static NSString *g_sqlitePath = @"/usr/lib/libsqlite3.dylib";
     [path retain];
     [g_sqlitePath release];
     g_sqlitePath = path;
+    OSAtomicIncrement32Barrier(&g_pathGeneration);
+}
+
++ (NSString *)zlibPath {
+    return g_zlibPath;
+}
+
++ (void)prewarm {
+    NSArray *libraryPaths = @[[self sqlitePath],
+                              [self zlibPath],
+                              buildFrameworkPath(@"Security"),
+                              buildFrameworkPath(@"SystemConfiguration")];
+    @synchronized ([FBDynamicFrameworkLoader class]) {
+        for (NSString *libraryPath in libraryPaths) {
+            openLibrary(libraryPath);
+        }
+    }
 }
 
 @end
@@ -126,16 +173,11 @@ static NSString *g_sqlitePath = @"/usr/lib/libsqlite3.dylib";
 typedef int (*SecRandomCopyBytesFuncType)(SecRandomRef, size_t, uint8_t *);
 
 int fbdfl_SecRandomCopyBytes(SecRandomRef rnd, size_t count, uint8_t *bytes) {
-    NSString *handle = buildFrameworkPath(@"Security");
-    SecRandomCopyBytesFuncType f = (SecRandomCopyBytesFuncType)loadSymbol(handle, @"SecRandomCopyBytes");
+    FBDFLResolve(f, SecRandomCopyBytesFuncType, buildFrameworkPath(@"Security"), @"SecRandomCopyBytes");
     return f(rnd, count, bytes);
 }
 
 // SQLITE3 APIs
-void *loadSqliteSymbol(NSString *symbol) {
-    return loadSymbol([FBDynamicFrameworkLoader sqlitePath], symbol);
-}
-
 typedef SQLITE_API const char *(*sqlite3_errmsg_type)(sqlite3 *);
 typedef SQLITE_API int (*sqlite3_prepare_v2_type)(sqlite3 *, const char *, int, sqlite3_stmt **, const char **);
 typedef SQLITE_API int (*sqlite3_reset_type)(sqlite3_stmt *);
@@ -145,107 +187,178 @@ typedef SQLITE_API int (*sqlite3_exec_type)(sqlite3 *, const char *, int (*)(voi
 typedef SQLITE_API int (*sqlite3_close_type)(sqlite3 *);
 typedef SQLITE_API int (*sqlite3_bind_double_type)(sqlite3_stmt *, int, double);
 typedef SQLITE_API int (*sqlite3_bind_int_type)(sqlite3_stmt *, int, int);
+typedef SQLITE_API int (*sqlite3_bind_int64_type)(sqlite3_stmt *, int, sqlite3_int64);
+typedef SQLITE_API int (*sqlite3_bind_null_type)(sqlite3_stmt *, int);
 typedef SQLITE_API int (*sqlite3_bind_text_type)(sqlite3_stmt *, int, const char *, int, void(*)(void *));
+typedef SQLITE_API int (*sqlite3_bind_blob_type)(sqlite3_stmt *, int, const void *, int, void(*)(void *));
 typedef SQLITE_API int (*sqlite3_step_type)(sqlite3_stmt *);
 typedef SQLITE_API double (*sqlite3_column_double_type)(sqlite3_stmt *, int);
 typedef SQLITE_API int (*sqlite3_column_int_type)(sqlite3_stmt *, int);
+typedef SQLITE_API sqlite3_int64 (*sqlite3_column_int64_type)(sqlite3_stmt *, int);
 typedef SQLITE_API const unsigned char *(*sqlite3_column_text_type)(sqlite3_stmt *, int);
+typedef SQLITE_API const void *(*sqlite3_column_blob_type)(sqlite3_stmt *, int);
+typedef SQLITE_API int (*sqlite3_column_bytes_type)(sqlite3_stmt *, int);
 
 SQLITE_API const char *fbdfl_sqlite3_errmsg(sqlite3 *db) {
-    sqlite3_errmsg_type f = (sqlite3_errmsg_type)loadSqliteSymbol(@"sqlite3_errmsg");
+    FBDFLResolve(f, sqlite3_errmsg_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_errmsg");
     return f(db);
 }
 
 SQLITE_API int fbdfl_sqlite3_prepare_v2(sqlite3 *db, const char *zSql, int nByte, sqlite3_stmt **ppStmt, const char **pzTail) {
-    sqlite3_prepare_v2_type f = (sqlite3_prepare_v2_type)loadSqliteSymbol(@"sqlite3_prepare_v2");
+    FBDFLResolve(f, sqlite3_prepare_v2_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_prepare_v2");
     return f(db, zSql, nByte, ppStmt, pzTail);
 }
 
 SQLITE_API int fbdfl_sqlite3_reset(sqlite3_stmt *pStmt) {
-    sqlite3_reset_type f = (sqlite3_reset_type)loadSqliteSymbol(@"sqlite3_reset");
+    FBDFLResolve(f, sqlite3_reset_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_reset");
     return f(pStmt);
 }
 
 SQLITE_API int fbdfl_sqlite3_finalize(sqlite3_stmt *pStmt) {
-    sqlite3_finalize_type f = (sqlite3_finalize_type)loadSqliteSymbol(@"sqlite3_finalize");
+    FBDFLResolve(f, sqlite3_finalize_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_finalize");
     return f(pStmt);
 }
 
 SQLITE_API int fbdfl_sqlite3_open_v2(const char *filename, sqlite3 **ppDb, int flags, const char *zVfs) {
-    sqlite3_open_v2_type f = (sqlite3_open_v2_type)loadSqliteSymbol(@"sqlite3_open_v2");
+    FBDFLResolve(f, sqlite3_open_v2_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_open_v2");
     return f(filename, ppDb, flags, zVfs);
 }
 
 SQLITE_API int fbdfl_sqlite3_exec(sqlite3 *db, const char *sql, int (*callback)(void *, int, char **, char **), void *arg, char **errmsg) {
-    sqlite3_exec_type f = (sqlite3_exec_type)loadSqliteSymbol(@"sqlite3_exec");
+    FBDFLResolve(f, sqlite3_exec_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_exec");
     return f(db, sql, callback, arg, errmsg);
 }
 
 SQLITE_API int fbdfl_sqlite3_close(sqlite3 *db) {
-    sqlite3_close_type f = (sqlite3_close_type)loadSqliteSymbol(@"sqlite3_close");
+    FBDFLResolve(f, sqlite3_close_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_close");
     return f(db);
 }
 
 SQLITE_API int fbdfl_sqlite3_bind_double(sqlite3_stmt *stmt, int index , double value) {
-    sqlite3_bind_double_type f = (sqlite3_bind_double_type)loadSqliteSymbol(@"sqlite3_bind_double");
+    FBDFLResolve(f, sqlite3_bind_double_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_bind_double");
     return f(stmt, index, value);
 }
 
 SQLITE_API int fbdfl_sqlite3_bind_int(sqlite3_stmt *stmt, int index, int value) {
-    sqlite3_bind_int_type f = (sqlite3_bind_int_type)loadSqliteSymbol(@"sqlite3_bind_int");
+    FBDFLResolve(f, sqlite3_bind_int_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_bind_int");
     return f(stmt, index, value);
 }
 
+SQLITE_API int fbdfl_sqlite3_bind_int64(sqlite3_stmt *stmt, int index, sqlite3_int64 value) {
+    FBDFLResolve(f, sqlite3_bind_int64_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_bind_int64");
+    return f(stmt, index, value);
+}
+
+SQLITE_API int fbdfl_sqlite3_bind_null(sqlite3_stmt *stmt, int index) {
+    FBDFLResolve(f, sqlite3_bind_null_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_bind_null");
+    return f(stmt, index);
+}
+
 SQLITE_API int fbdfl_sqlite3_bind_text(sqlite3_stmt *stmt, int index, const char *value, int n, void(*callback)(void *)) {
-    sqlite3_bind_text_type f = (sqlite3_bind_text_type)loadSqliteSymbol(@"sqlite3_bind_text");
+    FBDFLResolve(f, sqlite3_bind_text_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_bind_text");
+    return f(stmt, index, value, n, callback);
+}
+
+SQLITE_API int fbdfl_sqlite3_bind_blob(sqlite3_stmt *stmt, int index, const void *value, int n, void(*callback)(void *)) {
+    FBDFLResolve(f, sqlite3_bind_blob_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_bind_blob");
     return f(stmt, index, value, n, callback);
 }
 
 SQLITE_API int fbdfl_sqlite3_step(sqlite3_stmt *stmt) {
-    sqlite3_step_type f = (sqlite3_step_type)loadSqliteSymbol(@"sqlite3_step");
+    FBDFLResolve(f, sqlite3_step_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_step");
     return f(stmt);
 }
 
 SQLITE_API double fbdfl_sqlite3_column_double(sqlite3_stmt *stmt, int iCol) {
-    sqlite3_column_double_type f = (sqlite3_column_double_type)loadSqliteSymbol(@"sqlite3_column_double");
+    FBDFLResolve(f, sqlite3_column_double_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_column_double");
     return f(stmt, iCol);
 }
 
 SQLITE_API int fbdfl_sqlite3_column_int(sqlite3_stmt *stmt, int iCol) {
-    sqlite3_column_int_type f = (sqlite3_column_int_type)loadSqliteSymbol(@"sqlite3_column_int");
+    FBDFLResolve(f, sqlite3_column_int_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_column_int");
+    return f(stmt, iCol);
+}
+
+SQLITE_API sqlite3_int64 fbdfl_sqlite3_column_int64(sqlite3_stmt *stmt, int iCol) {
+    FBDFLResolve(f, sqlite3_column_int64_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_column_int64");
     return f(stmt, iCol);
 }
 
 SQLITE_API const unsigned char *fbdfl_sqlite3_column_text(sqlite3_stmt *stmt, int iCol) {
-    sqlite3_column_text_type f = (sqlite3_column_text_type)loadSqliteSymbol(@"sqlite3_column_text");
+    FBDFLResolve(f, sqlite3_column_text_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_column_text");
+    return f(stmt, iCol);
+}
+
+SQLITE_API const void *fbdfl_sqlite3_column_blob(sqlite3_stmt *stmt, int iCol) {
+    FBDFLResolve(f, sqlite3_column_blob_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_column_blob");
     return f(stmt, iCol);
 }
 
+SQLITE_API int fbdfl_sqlite3_column_bytes(sqlite3_stmt *stmt, int iCol) {
+    FBDFLResolve(f, sqlite3_column_bytes_type, [FBDynamicFrameworkLoader sqlitePath], @"sqlite3_column_bytes");
+    return f(stmt, iCol);
+}
+
+// zlib APIs
+typedef int (*deflateInit2__type)(z_streamp, int, int, int, int, int, const char *, int);
+typedef int (*deflate_type)(z_streamp, int);
+typedef int (*deflateEnd_type)(z_streamp);
+typedef int (*inflateInit2__type)(z_streamp, int, const char *, int);
+typedef int (*inflate_type)(z_streamp, int);
+typedef int (*inflateEnd_type)(z_streamp);
+
+int fbdfl_deflateInit2(z_streamp strm, int level, int method, int windowBits, int memLevel, int strategy) {
+    // deflateInit2 is a macro around deflateInit2_, which checks the caller
+    // was built against a compatible zlib
+    FBDFLResolve(f, deflateInit2__type, [FBDynamicFrameworkLoader zlibPath], @"deflateInit2_");
+    return f(strm, level, method, windowBits, memLevel, strategy, ZLIB_VERSION, (int)sizeof(z_stream));
+}
+
+int fbdfl_deflate(z_streamp strm, int flush) {
+    FBDFLResolve(f, deflate_type, [FBDynamicFrameworkLoader zlibPath], @"deflate");
+    return f(strm, flush);
+}
+
+int fbdfl_deflateEnd(z_streamp strm) {
+    FBDFLResolve(f, deflateEnd_type, [FBDynamicFrameworkLoader zlibPath], @"deflateEnd");
+    return f(strm);
+}
+
+int fbdfl_inflateInit2(z_streamp strm, int windowBits) {
+    // Same as deflateInit2, a macro around inflateInit2_
+    FBDFLResolve(f, inflateInit2__type, [FBDynamicFrameworkLoader zlibPath], @"inflateInit2_");
+    return f(strm, windowBits, ZLIB_VERSION, (int)sizeof(z_stream));
+}
+
+int fbdfl_inflate(z_streamp strm, int flush) {
+    FBDFLResolve(f, inflate_type, [FBDynamicFrameworkLoader zlibPath], @"inflate");
+    return f(strm, flush);
+}
+
+int fbdfl_inflateEnd(z_streamp strm) {
+    FBDFLResolve(f, inflateEnd_type, [FBDynamicFrameworkLoader zlibPath], @"inflateEnd");
+    return f(strm);
+}
+
 typedef CATransform3D (*CATransform3DMakeScale_type)(CGFloat, CGFloat, CGFloat);
 typedef CATransform3D (*CATransform3DConcat_type)(CATransform3D, CATransform3D);
 const CATransform3D fbdfl_CATransform3DIdentity = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
 
 CATransform3D fbdfl_CATransform3DMakeScale (CGFloat sx, CGFloat sy, CGFloat sz)
 {
-    CATransform3DMakeScale_type f =
-        (CATransform3DMakeScale_type)[FBDynamicFrameworkLoader loadSymbol: @"CATransform3DMakeScale"
-                                                            withFramework: @"QuartzCore"];
+    FBDFLResolve(f, CATransform3DMakeScale_type, buildFrameworkPath(@"QuartzCore"), @"CATransform3DMakeScale");
     return f(sx, sy, sz);
 }
 
 CATransform3D fbdfl_CATransform3DMakeTranslation (CGFloat tx, CGFloat ty, CGFloat tz)
 {
-    CATransform3DMakeScale_type f =
-    (CATransform3DMakeScale_type)[FBDynamicFrameworkLoader loadSymbol: @"CATransform3DMakeTranslation"
-                                                        withFramework: @"QuartzCore"];
+    FBDFLResolve(f, CATransform3DMakeScale_type, buildFrameworkPath(@"QuartzCore"), @"CATransform3DMakeTranslation");
     return f(tx, ty, tz);
 }
 
 CATransform3D fbdfl_CATransform3DConcat (CATransform3D a, CATransform3D b)
 {
-    CATransform3DConcat_type f =
-    (CATransform3DConcat_type)[FBDynamicFrameworkLoader loadSymbol: @"CATransform3DConcat"
-                                                     withFramework: @"QuartzCore"];
+    FBDFLResolve(f, CATransform3DConcat_type, buildFrameworkPath(@"QuartzCore"), @"CATransform3DConcat");
     return f(a, b);
 }
 
@@ -253,26 +366,48 @@ CATransform3D fbdfl_CATransform3DConcat (CATransform3D a, CATransform3D b)
 typedef OSStatus (*AudioServicesCreateSystemSoundID_type)(CFURLRef, SystemSoundID *);
 OSStatus fbdfl_AudioServicesCreateSystemSoundID(CFURLRef inFileURL, SystemSoundID *outSystemSoundID)
 {
-    AudioServicesCreateSystemSoundID_type f =
-    (AudioServicesCreateSystemSoundID_type)[FBDynamicFrameworkLoader loadSymbol:@"AudioServicesCreateSystemSoundID"
-                                                                  withFramework:@"AudioToolbox"];
+    FBDFLResolve(f, AudioServicesCreateSystemSoundID_type, buildFrameworkPath(@"AudioToolbox"), @"AudioServicesCreateSystemSoundID");
     return f(inFileURL, outSystemSoundID);
 }
 
 typedef OSStatus (*AudioServicesDisposeSystemSoundID_type)(SystemSoundID);
 OSStatus fbdfl_AudioServicesDisposeSystemSoundID(SystemSoundID inSystemSoundID)
 {
-    AudioServicesDisposeSystemSoundID_type f =
-    (AudioServicesDisposeSystemSoundID_type)[FBDynamicFrameworkLoader loadSymbol:@"AudioServicesDisposeSystemSoundID"
-                                                                   withFramework:@"AudioToolbox"];
+    FBDFLResolve(f, AudioServicesDisposeSystemSoundID_type, buildFrameworkPath(@"AudioToolbox"), @"AudioServicesDisposeSystemSoundID");
     return f(inSystemSoundID);
 }
 
 typedef void (*AudioServicesPlaySystemSound_type)(SystemSoundID);
 void fbdfl_AudioServicesPlaySystemSound(SystemSoundID inSystemSoundID)
 {
-    AudioServicesPlaySystemSound_type f =
-    (AudioServicesPlaySystemSound_type)[FBDynamicFrameworkLoader loadSymbol:@"AudioServicesPlaySystemSound"
-                                                              withFramework:@"AudioToolbox"];
+    FBDFLResolve(f, AudioServicesPlaySystemSound_type, buildFrameworkPath(@"AudioToolbox"), @"AudioServicesPlaySystemSound");
     return f(inSystemSoundID);
 }
+
+typedef SCNetworkReachabilityRef (*SCNetworkReachabilityCreateWithAddress_type)(CFAllocatorRef, const struct sockaddr *);
+SCNetworkReachabilityRef fbdfl_SCNetworkReachabilityCreateWithAddress(CFAllocatorRef allocator, const struct sockaddr *address)
+{
+    FBDFLResolve(f, SCNetworkReachabilityCreateWithAddress_type, buildFrameworkPath(@"SystemConfiguration"), @"SCNetworkReachabilityCreateWithAddress");
+    return f ? f(allocator, address) : NULL;
+}
+
+typedef Boolean (*SCNetworkReachabilityGetFlags_type)(SCNetworkReachabilityRef, SCNetworkReachabilityFlags *);
+Boolean fbdfl_SCNetworkReachabilityGetFlags(SCNetworkReachabilityRef target, SCNetworkReachabilityFlags *flags)
+{
+    FBDFLResolve(f, SCNetworkReachabilityGetFlags_type, buildFrameworkPath(@"SystemConfiguration"), @"SCNetworkReachabilityGetFlags");
+    return f ? f(target, flags) : false;
+}
+
+typedef Boolean (*SCNetworkReachabilitySetCallback_type)(SCNetworkReachabilityRef, SCNetworkReachabilityCallBack, SCNetworkReachabilityContext *);
+Boolean fbdfl_SCNetworkReachabilitySetCallback(SCNetworkReachabilityRef target, SCNetworkReachabilityCallBack callout, SCNetworkReachabilityContext *context)
+{
+    FBDFLResolve(f, SCNetworkReachabilitySetCallback_type, buildFrameworkPath(@"SystemConfiguration"), @"SCNetworkReachabilitySetCallback");
+    return f ? f(target, callout, context) : false;
+}
+
+typedef Boolean (*SCNetworkReachabilitySetDispatchQueue_type)(SCNetworkReachabilityRef, dispatch_queue_t);
+Boolean fbdfl_SCNetworkReachabilitySetDispatchQueue(SCNetworkReachabilityRef target, dispatch_queue_t queue)
+{
+    FBDFLResolve(f, SCNetworkReachabilitySetDispatchQueue_type, buildFrameworkPath(@"SystemConfiguration"), @"SCNetworkReachabilitySetDispatchQueue");
+    return f ? f(target, queue) : false;
+}
@@ -53,3 +53,4 @@ NSString *const FBErrorDialogInvalidShareParameters = @"DialogInvalidShareParame
 NSString *const FBErrorDialogInvalidLikeObjectID = @"DialogInvalidLikeObjectID";
 
 NSString *const FBErrorAppEventsReasonKey = @"com.facebook.sdk:AppEventsReasonKey";
+NSString *const FBErrorRequestQueuedOfflineKey = @"com.facebook.sdk:RequestQueuedOfflineKey";
@@ -15,8 +15,8 @@
  */
 #import <Foundation/Foundation.h>
 
-// Internal class holding server side Facebook app settings we fetch once from the
-// server per process lifetime.
+// Internal class holding server side Facebook app settings we fetch from the
+// server, refreshed hourly and persisted across launches.
 
 @interface FBFetchedAppSettings : NSObject
 
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+typedef void (^FBImageDecoderCompletionHandler)(UIImage *image);
+
+// Decompresses downloaded pictures off the main thread, scaled down to the size they
+// will be drawn at, so that UIKit neither decodes full-size JPEGs nor scales them on
+// the main thread during the first render.  Decoded bitmaps are kept in a memory
+// cache, bounded by bytes of bitmap, that the system also trims under memory pressure.
+@interface FBImageDecoder : NSObject
+
++ (FBImageDecoder *)sharedDecoder;
+
+// Budget for the decoded bitmaps, in bytes.
+@property (nonatomic, assign) NSUInteger cacheSizeMemory;
+
+// The bitmap already decoded for key at this size, or nil.
+- (UIImage *)cachedImageForKey:(NSString *)key size:(CGSize)size filling:(BOOL)filling;
+
+// Decodes data and scales it down, keeping its aspect ratio, until it fits in size
+// (in points), or when filling is YES, until it just covers size.  Pictures that are
+// already small enough are only decompressed, and keep their scale of 1 as
+// +[UIImage imageWithData:] would give them.  completion is always called
+// asynchronously on the main thread, with nil if the data isn't an image.
+- (void)decodeImageData:(NSData *)data
+                 forKey:(NSString *)key
+                   size:(CGSize)size
+                filling:(BOOL)filling
+             completion:(FBImageDecoderCompletionHandler)completion;
+
+@end
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBImageDecoder.h"
+
+#import "FBDispatch.h"
+
+static const NSUInteger kDefaultCacheSizeMemory = 8 * 1024 * 1024; // 8MB, about 1300 80x80 pixel thumbnails
+
+static NSString *FBImageDecoderCacheKey(NSString *key, CGSize size, BOOL filling) {
+    return [NSString stringWithFormat:@"%@|%gx%g|%d", key, size.width, size.height, filling];
+}
+
+// Draws image into a bitmap of its own, which is what decompresses it.  Scales it down
+// to pixelSize when that is smaller, and otherwise keeps the pixels it has.
+static UIImage *FBImageDecoderDecodeImage(UIImage *image, CGSize pixelSize, BOOL filling, CGFloat screenScale) {
+    CGImageRef sourceImage = image.CGImage;
+    if (!sourceImage) {
+        return image;
+    }
+
+    size_t sourceWidth = CGImageGetWidth(sourceImage);
+    size_t sourceHeight = CGImageGetHeight(sourceImage);
+    CGFloat widthRatio = pixelSize.width / sourceWidth;
+    CGFloat heightRatio = pixelSize.height / sourceHeight;
+    CGFloat ratio = filling ? MAX(widthRatio, heightRatio) : MIN(widthRatio, heightRatio);
+    BOOL downscale = ratio > 0 && ratio < 1;
+
+    size_t width = downscale ? MAX((size_t)1, (size_t)round(sourceWidth * ratio)) : sourceWidth;
+    size_t height = downscale ? MAX((size_t)1, (size_t)round(sourceHeight * ratio)) : sourceHeight;
+
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace,
+                                                 kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        return image;
+    }
+
+    CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), sourceImage);
+    CGImageRef decodedImage = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    if (!decodedImage) {
+        return image;
+    }
+
+    // A scaled-down picture is drawn at the screen's scale, so it takes up the same
+    // points the full-size one would have been fitted into.
+    UIImage *result = [UIImage imageWithCGImage:decodedImage
+                                          scale:downscale ? screenScale : 1
+                                    orientation:image.imageOrientation];
+    CGImageRelease(decodedImage);
+    return result;
+}
+
+@implementation FBImageDecoder {
+    NSCache *_cache;
+    dispatch_queue_t _decodeQueue;
+    CGFloat _screenScale;
+}
+
++ (FBImageDecoder *)sharedDecoder
+{
+    static FBImageDecoder *_instance;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBImageDecoder alloc] init];
+    });
+
+    return _instance;
+}
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        _cache = [[NSCache alloc] init];
+        _cache.totalCostLimit = kDefaultCacheSizeMemory;
+        _decodeQueue = FBDispatchQueueCreateConcurrent("com.facebook.sdk.FBImageDecoder", FBDispatchLaneUserInteractive);
+        _screenScale = [UIScreen mainScreen].scale;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_cache release];
+    dispatch_release(_decodeQueue);
+    [super dealloc];
+}
+
+- (NSUInteger)cacheSizeMemory
+{
+    return _cache.totalCostLimit;
+}
+
+- (void)setCacheSizeMemory:(NSUInteger)cacheSizeMemory
+{
+    _cache.totalCostLimit = cacheSizeMemory;
+}
+
+- (UIImage *)cachedImageForKey:(NSString *)key size:(CGSize)size filling:(BOOL)filling
+{
+    return key ? [_cache objectForKey:FBImageDecoderCacheKey(key, size, filling)] : nil;
+}
+
+- (void)decodeImageData:(NSData *)data
+                 forKey:(NSString *)key
+                   size:(CGSize)size
+                filling:(BOOL)filling
+             completion:(FBImageDecoderCompletionHandler)completion
+{
+    NSString *cacheKey = key ? FBImageDecoderCacheKey(key, size, filling) : nil;
+    FBImageDecoderCompletionHandler completionCopy = [[completion copy] autorelease];
+    CGFloat screenScale = _screenScale;
+    CGSize pixelSize = CGSizeMake(size.width * screenScale, size.height * screenScale);
+
+    dispatch_async(_decodeQueue, ^{
+        UIImage *image = [UIImage imageWithData:data];
+        if (image) {
+            image = FBImageDecoderDecodeImage(image, pixelSize, filling, screenScale);
+            if (cacheKey) {
+                CGImageRef cgImage = image.CGImage;
+                [_cache setObject:image
+                           forKey:cacheKey
+                             cost:CGImageGetBytesPerRow(cgImage) * CGImageGetHeight(cgImage)];
+            }
+        }
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completionCopy) {
+                completionCopy(image);
+            }
+        });
+    });
+}
+
+@end
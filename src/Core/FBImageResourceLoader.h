@@ -24,9 +24,19 @@
             fromRetinaBytes:(const Byte *)retinaBytes
                retinaLength:(NSUInteger)retinaLength;
 
+// Images loaded by name are decoded and cached per screen scale, so views that are created
+// repeatedly share one instance and none of them has to decode it.
 + (UIImage *)imageNamed:(NSString *)imageName
               fromBytes:(const Byte *)bytes
                  length:(NSUInteger)length
         fromRetinaBytes:(const Byte *)retinaBytes
            retinaLength:(NSUInteger)retinaLength;
+
+// Draws the image into a bitmap on a background queue so that its first render on the main
+// thread does not have to decode it; the completion is called on the main thread.
++ (void)decodeImage:(UIImage *)image completion:(void (^)(UIImage *decodedImage))completion;
+
+// Loads, on the calling thread, the image a class generated by scripts/image_to_code.py hands out,
+// so that it is decoded and cached before the class is first asked for it.
++ (void)predecodeImageResource:(Class)imageResourceClass;
 @end
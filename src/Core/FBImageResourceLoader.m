@@ -16,9 +16,49 @@
 
 #import "FBImageResourceLoader.h"
 
+#import "FBDispatch.h"
 #import "FBSettings.h"
 #import "FBUtility.h"
 
+static NSCache *FBImageResourceLoaderCache(void)
+{
+    static NSCache *cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[NSCache alloc] init];
+    });
+    return cache;
+}
+
+// Images are kept decoded, per screen scale, since the scale decides which bytes are used.  The
+// bytes are compiled in, so name and scale identify an image for the life of the process.
+static NSString *FBImageResourceLoaderCacheKey(NSString *imageName) {
+    return [NSString stringWithFormat:@"%@@%gx", imageName, (double)[UIScreen mainScreen].scale];
+}
+
+// Draws the image into a bitmap so that rendering it later doesn't have to decode it
+static UIImage *FBImageResourceLoaderDecode(UIImage *image) {
+    CGImageRef imageRef = image.CGImage;
+    size_t width = CGImageGetWidth(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace,
+                                                 kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+    CGColorSpaceRelease(colorSpace);
+
+    UIImage *decodedImage = image;
+    if (context) {
+        CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+        CGImageRef decodedRef = CGBitmapContextCreateImage(context);
+        CGContextRelease(context);
+        if (decodedRef) {
+            decodedImage = [UIImage imageWithCGImage:decodedRef scale:image.scale orientation:image.imageOrientation];
+            CGImageRelease(decodedRef);
+        }
+    }
+    return decodedImage;
+}
+
 @implementation FBImageResourceLoader
 
 + (UIImage *)loadImageFromBytes:(const Byte *)bytes
@@ -45,17 +85,62 @@
                  length:(NSUInteger)length
         fromRetinaBytes:(const Byte *)retinaBytes
            retinaLength:(NSUInteger)retinaLength {
+    NSString *cacheKey = imageName ? FBImageResourceLoaderCacheKey(imageName) : nil;
+    UIImage *image = cacheKey ? [FBImageResourceLoaderCache() objectForKey:cacheKey] : nil;
+    if (image) {
+        return image;
+    }
+
     NSString *bundleName = [FBSettings resourceBundleName];
     if (bundleName) {
-        UIImage *image = [UIImage imageNamed:[NSString stringWithFormat:@"%@.bundle/%@", bundleName, imageName]];
-        if (image) {
-            return image;
+        image = [UIImage imageNamed:[NSString stringWithFormat:@"%@.bundle/%@", bundleName, imageName]];
+    }
+    if (!image) {
+        image = [FBImageResourceLoader imageFromBytes:bytes
+                                               length:length
+                                      fromRetinaBytes:retinaBytes
+                                         retinaLength:retinaLength];
+    }
+    if (image.CGImage && cacheKey) {
+        // decoded once here, rather than on the first render of every view using it
+        image = FBImageResourceLoaderDecode(image);
+        [FBImageResourceLoaderCache() setObject:image forKey:cacheKey];
+    }
+    return image;
+}
+
++ (void)decodeImage:(UIImage *)image completion:(void (^)(UIImage *decodedImage))completion {
+    if (!image.CGImage) {
+        if (completion) {
+            completion(image);
         }
+        return;
+    }
+    [image retain];
+    completion = [completion copy];
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneUtility), ^{
+        UIImage *decodedImage = [FBImageResourceLoaderDecode(image) retain];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion) {
+                completion(decodedImage);
+            }
+            [decodedImage release];
+            [completion release];
+            [image release];
+        });
+    });
+}
+
++ (void)predecodeImageResource:(Class)imageResourceClass {
+    // Generated classes name their images after themselves, less the "PNG" suffix
+    NSString *className = NSStringFromClass(imageResourceClass);
+    NSString *imageName = [NSString stringWithFormat:@"FacebookSDKImages/%@.png",
+                           [className substringToIndex:className.length - 3]];
+    if ([FBImageResourceLoaderCache() objectForKey:FBImageResourceLoaderCacheKey(imageName)]) {
+        return;
     }
-    return [FBImageResourceLoader imageFromBytes:bytes
-                                          length:length
-                                 fromRetinaBytes:retinaBytes
-                                    retinaLength:retinaLength];
+    // the class's image is decoded and cached on its way out
+    [imageResourceClass performSelector:@selector(image)];
 }
 
 @end
@@ -16,6 +16,30 @@
 
 #import <Foundation/Foundation.h>
 
+#import "FBSettings.h"
+
+// Define FB_LOGGING_ENABLED to 0 to compile out SDK logging entirely; every logger is then
+// inactive and the guarded call sites below reduce to nothing.
+#ifndef FB_LOGGING_ENABLED
+#define FB_LOGGING_ENABLED 1
+#endif
+
+#if FB_LOGGING_ENABLED
+#define FBLoggerIsEnabled(behavior) [FBLogger isLoggingBehaviorEnabled:(behavior)]
+#else
+#define FBLoggerIsEnabled(behavior) NO
+#endif
+
+// Appends to the logger only when it's active, so neither the arguments nor the
+// formatted string are built for a disabled (or nil) logger.
+#define FBLoggerAppendFormat(logger, ...) \
+    do { \
+        FBLogger *fb_logger__ = (logger); \
+        if (FB_LOGGING_ENABLED && fb_logger__.isActive) { \
+            [fb_logger__ appendFormat:__VA_ARGS__]; \
+        } \
+    } while (0)
+
 /*!
  @class FBLogger
 
@@ -63,6 +87,27 @@
 //
 + (NSUInteger)newSerialNumber;
 
+// Cheap check for whether a logging behavior is enabled.  Answers from a flag word that is
+// rebuilt whenever +[FBSettings setLoggingBehavior:] changes the set, so it's safe to call
+// from any thread on hot paths.  Prefer the FBLoggerIsEnabled() macro, which honors FB_LOGGING_ENABLED.
++ (BOOL)isLoggingBehaviorEnabled:(NSString *)loggingBehavior;
+
+// Called by FBSettings when the set of enabled logging behaviors changes.
++ (void)loggingBehaviorsDidChange;
+
+// Where emitted entries go: NSLog, unless a handler is set.  Backs the logging settings on FBSettings.
++ (BOOL)isAsynchronousSinkEnabled;
++ (void)setAsynchronousSinkEnabled:(BOOL)enabled;
++ (FBLoggingHandler)sinkHandler;
++ (void)setSinkHandler:(FBLoggingHandler)handler;
++ (FBLoggingHandler)sinkHandlerWritingToFileAtPath:(NSString *)path;
+
+// Total number of entries dropped by the asynchronous sink.
++ (NSUInteger)droppedEntryCount;
+
+// Blocks until everything queued so far has been written.
++ (void)flushSink;
+
 // Simple helper to write a single log entry, based upon whether the behavior matches a specified on.
 + (void)singleShotLogEntry:(NSString *)loggingBehavior
                   logEntry:(NSString *)logEntry;
@@ -79,7 +124,8 @@
 + (void)registerCurrentTime:(NSString *)loggingBehavior
                     withTag:(NSObject *)timestampTag;
 
-// When logging strings, replace all instances of 'replace' with instances of 'replaceWith'.
+// When logging strings, replace all instances of 'replace' with instances of 'replaceWith'.  Only the
+// most recently registered strings are kept, and all of them are matched in a single pass over each log.
 + (void)registerStringToReplace:(NSString *)replace
                     replaceWith:(NSString *)replaceWith;
 
@@ -16,13 +16,374 @@
 
 #import "FBLogger.h"
 
+#import <libkern/OSAtomic.h>
+
+#import "FBDispatch.h"
+#import "FBMetrics.h"
 #import "FBSession.h"
 #import "FBSettings.h"
-#import "FBUtility.h"
+
+@class FBLoggerRedactor;
+
+// Asynchronous sink: a bounded multi-producer, single-consumer ring.  Each slot's sequence number
+// says whose turn it is, so producers only contend on a compare-and-swap of the enqueue position
+// and never wait on the consumer.
+typedef struct {
+    volatile int64_t sequence;
+    NSString *entry;
+} FBLoggerSinkSlot;
+
+static const int64_t FBLoggerSinkCapacity = 1024;  // power of two
+static FBLoggerSinkSlot g_sinkSlots[FBLoggerSinkCapacity];
+static volatile int64_t g_sinkEnqueuePosition = 0;
+static int64_t g_sinkDequeuePosition = 0;          // only touched on g_sinkQueue
+static volatile uint32_t g_sinkDroppedSinceDrain = 0;
+static volatile int32_t g_sinkDroppedTotal = 0;
+static volatile BOOL g_asynchronousSinkEnabled = NO;
+static dispatch_queue_t g_sinkQueue = NULL;
+static dispatch_source_t g_sinkSource = NULL;
+static FBLoggingHandler g_sinkHandler = nil;
 
 static NSUInteger g_serialNumberCounter = 1111;
-static NSMutableDictionary *g_stringsToReplace = nil;
-static NSMutableDictionary *g_startTimesWithTags = nil;
+
+// Strings to redact, oldest first, capped so that a long-lived process that sees many
+// tokens doesn't keep growing the set.  The redactor is rebuilt lazily when they change.
+static const NSUInteger FBLoggerMaxStringsToReplace = 100;
+static NSMutableArray *g_stringsToReplace = nil;
+static NSMutableDictionary *g_replacementsForStrings = nil;
+static FBLoggerRedactor *g_redactor = nil;
+
+// Bit per known FBLoggingBehavior, plus a bit recording that the word has been built.
+static const uint32_t FBLoggerBehaviorMaskValid = 1u << 31;
+static volatile uint32_t g_enabledBehaviorMask = 0;
+
+static NSString *const *FBLoggerKnownBehaviors(NSUInteger *count) {
+    static NSString *const *behaviors = NULL;
+    static NSUInteger behaviorCount = 0;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        static NSString *knownBehaviors[9];
+        knownBehaviors[0] = FBLoggingBehaviorFBRequests;
+        knownBehaviors[1] = FBLoggingBehaviorFBURLConnections;
+        knownBehaviors[2] = FBLoggingBehaviorAccessTokens;
+        knownBehaviors[3] = FBLoggingBehaviorSessionStateTransitions;
+        knownBehaviors[4] = FBLoggingBehaviorPerformanceCharacteristics;
+        knownBehaviors[5] = FBLoggingBehaviorAppEvents;
+        knownBehaviors[6] = FBLoggingBehaviorInformational;
+        knownBehaviors[7] = FBLoggingBehaviorCacheErrors;
+        knownBehaviors[8] = FBLoggingBehaviorDeveloperErrors;
+        behaviors = knownBehaviors;
+        behaviorCount = sizeof(knownBehaviors) / sizeof(knownBehaviors[0]);
+    });
+    *count = behaviorCount;
+    return behaviors;
+}
+
+// Returns the bit for a known behavior, or 0 for one we don't track in the mask.
+static uint32_t FBLoggerBitForBehavior(NSString *loggingBehavior) {
+    NSUInteger count = 0;
+    NSString *const *behaviors = FBLoggerKnownBehaviors(&count);
+    // Callers nearly always pass the constants themselves, so try pointers first.
+    for (NSUInteger i = 0; i < count; i++) {
+        if (behaviors[i] == loggingBehavior) {
+            return 1u << i;
+        }
+    }
+    for (NSUInteger i = 0; i < count; i++) {
+        if ([behaviors[i] isEqualToString:loggingBehavior]) {
+            return 1u << i;
+        }
+    }
+    return 0;
+}
+
+static uint32_t FBLoggerBuildBehaviorMask(void) {
+    uint32_t mask = FBLoggerBehaviorMaskValid;
+    for (NSString *behavior in [FBSettings loggingBehavior]) {
+        mask |= FBLoggerBitForBehavior(behavior);
+    }
+    return mask;
+}
+
+static void FBLoggerSinkDeliver(NSString *entry) {
+    FBLoggingHandler handler = [FBLogger sinkHandler];
+    if (handler) {
+        handler(entry);
+    } else {
+        NSLog(@"FBSDKLog: %@", entry);
+    }
+}
+
+// Takes ownership of a retained entry; returns NO, leaving it to the caller, if the ring is full.
+static BOOL FBLoggerSinkEnqueue(NSString *entry) {
+    int64_t position = g_sinkEnqueuePosition;
+    FBLoggerSinkSlot *slot = NULL;
+    while (YES) {
+        slot = &g_sinkSlots[position & (FBLoggerSinkCapacity - 1)];
+        int64_t difference = slot->sequence - position;
+        if (difference == 0) {
+            if (OSAtomicCompareAndSwap64Barrier(position, position + 1, &g_sinkEnqueuePosition)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return NO;
+        }
+        position = g_sinkEnqueuePosition;
+    }
+    slot->entry = entry;
+    OSMemoryBarrier();
+    slot->sequence = position + 1;
+    return YES;
+}
+
+// Returns a retained entry, or nil if the ring is empty.  Only called on g_sinkQueue.
+static NSString *FBLoggerSinkDequeue(void) {
+    FBLoggerSinkSlot *slot = &g_sinkSlots[g_sinkDequeuePosition & (FBLoggerSinkCapacity - 1)];
+    if (slot->sequence != g_sinkDequeuePosition + 1) {
+        return nil;
+    }
+    OSMemoryBarrier();
+    NSString *entry = slot->entry;
+    slot->entry = nil;
+    OSMemoryBarrier();
+    slot->sequence = g_sinkDequeuePosition + FBLoggerSinkCapacity;
+    g_sinkDequeuePosition++;
+    return entry;
+}
+
+static void FBLoggerSinkDrain(void) {
+    NSString *entry = nil;
+    while ((entry = FBLoggerSinkDequeue())) {
+        @autoreleasepool {
+            FBLoggerSinkDeliver(entry);
+        }
+        [entry release];
+    }
+
+    uint32_t dropped = OSAtomicAnd32OrigBarrier(0, &g_sinkDroppedSinceDrain);
+    if (dropped) {
+        FBLoggerSinkDeliver([NSString stringWithFormat:@"%u log entries were dropped because logging fell behind", dropped]);
+    }
+}
+
+static void FBLoggerSinkSetUp(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (int64_t i = 0; i < FBLoggerSinkCapacity; i++) {
+            g_sinkSlots[i].sequence = i;
+        }
+        g_sinkQueue = FBDispatchQueueCreateSerial("com.facebook.sdk.FBLogger.sink", FBDispatchLaneBackground);
+        // A data-add source coalesces wakeups, so a burst of entries costs one drain.
+        g_sinkSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, g_sinkQueue);
+        dispatch_source_set_event_handler(g_sinkSource, ^{
+            FBLoggerSinkDrain();
+        });
+        dispatch_resume(g_sinkSource);
+    });
+}
+
+static void FBLoggerSinkWrite(NSString *entry) {
+    if (!g_asynchronousSinkEnabled) {
+        FBLoggerSinkDeliver(entry);
+        return;
+    }
+
+    NSString *copy = [entry copy];
+    if (FBLoggerSinkEnqueue(copy)) {
+        dispatch_source_merge_data(g_sinkSource, 1);
+    } else {
+        [copy release];
+        OSAtomicIncrement32Barrier((volatile int32_t *)&g_sinkDroppedSinceDrain);
+        OSAtomicIncrement32Barrier(&g_sinkDroppedTotal);
+    }
+}
+
+// Aho-Corasick matcher over UTF-16 code units, so that every registered string is
+// found in one pass over the log, however many of them there are.
+typedef struct {
+    NSInteger firstEdge;
+    NSInteger fail;
+    NSInteger pattern;      // index of the pattern ending at this node, or -1
+    NSInteger outputLink;   // nearest node on the fail chain that ends a pattern, or -1
+    NSUInteger depth;
+} FBLoggerRedactorNode;
+
+typedef struct {
+    unichar character;
+    NSInteger target;
+    NSInteger next;
+} FBLoggerRedactorEdge;
+
+@interface FBLoggerRedactor : NSObject {
+    FBLoggerRedactorNode *_nodes;
+    NSUInteger _nodeCount;
+    NSUInteger _nodeCapacity;
+    FBLoggerRedactorEdge *_edges;
+    NSUInteger _edgeCount;
+    NSUInteger _edgeCapacity;
+    NSArray *_replacements;
+}
+
+- (instancetype)initWithPatterns:(NSArray *)patterns replacements:(NSArray *)replacements;
+- (void)redactString:(NSMutableString *)string;
+
+@end
+
+@implementation FBLoggerRedactor
+
+- (instancetype)initWithPatterns:(NSArray *)patterns replacements:(NSArray *)replacements {
+    if ((self = [super init])) {
+        _replacements = [replacements copy];
+        [self addNodeWithDepth:0];
+
+        NSUInteger patternIndex = 0;
+        for (NSString *pattern in patterns) {
+            NSInteger node = 0;
+            for (NSUInteger i = 0; i < pattern.length; i++) {
+                unichar c = [pattern characterAtIndex:i];
+                NSInteger child = [self childOfNode:node character:c];
+                if (child < 0) {
+                    child = [self addNodeWithDepth:_nodes[node].depth + 1];
+                    [self addEdgeFromNode:node toNode:child character:c];
+                }
+                node = child;
+            }
+            if (node != 0) {
+                _nodes[node].pattern = patternIndex;
+            }
+            patternIndex++;
+        }
+
+        [self buildFailLinks];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_nodes);
+    free(_edges);
+    [_replacements release];
+    [super dealloc];
+}
+
+- (NSInteger)addNodeWithDepth:(NSUInteger)depth {
+    if (_nodeCount == _nodeCapacity) {
+        _nodeCapacity = MAX(_nodeCapacity * 2, 64);
+        _nodes = realloc(_nodes, _nodeCapacity * sizeof(FBLoggerRedactorNode));
+    }
+    FBLoggerRedactorNode node = { -1, 0, -1, -1, depth };
+    _nodes[_nodeCount] = node;
+    return _nodeCount++;
+}
+
+- (void)addEdgeFromNode:(NSInteger)from toNode:(NSInteger)to character:(unichar)c {
+    if (_edgeCount == _edgeCapacity) {
+        _edgeCapacity = MAX(_edgeCapacity * 2, 64);
+        _edges = realloc(_edges, _edgeCapacity * sizeof(FBLoggerRedactorEdge));
+    }
+    FBLoggerRedactorEdge edge = { c, to, _nodes[from].firstEdge };
+    _edges[_edgeCount] = edge;
+    _nodes[from].firstEdge = _edgeCount++;
+}
+
+- (NSInteger)childOfNode:(NSInteger)node character:(unichar)c {
+    for (NSInteger e = _nodes[node].firstEdge; e >= 0; e = _edges[e].next) {
+        if (_edges[e].character == c) {
+            return _edges[e].target;
+        }
+    }
+    return -1;
+}
+
+- (void)buildFailLinks {
+    // Breadth first, so every node's fail target is final before its children need it.
+    NSInteger *queue = malloc(_nodeCount * sizeof(NSInteger));
+    NSUInteger head = 0, tail = 0;
+    queue[tail++] = 0;
+    while (head < tail) {
+        NSInteger node = queue[head++];
+        for (NSInteger e = _nodes[node].firstEdge; e >= 0; e = _edges[e].next) {
+            NSInteger child = _edges[e].target;
+            unichar c = _edges[e].character;
+
+            NSInteger fail = 0;
+            if (node != 0) {
+                NSInteger f = _nodes[node].fail;
+                NSInteger next;
+                while ((next = [self childOfNode:f character:c]) < 0 && f != 0) {
+                    f = _nodes[f].fail;
+                }
+                fail = next >= 0 ? next : 0;
+            }
+            _nodes[child].fail = fail;
+            _nodes[child].outputLink = _nodes[fail].pattern >= 0 ? fail : _nodes[fail].outputLink;
+            queue[tail++] = child;
+        }
+    }
+    free(queue);
+}
+
+- (void)redactString:(NSMutableString *)string {
+    NSUInteger length = string.length;
+    if (length == 0 || _nodeCount <= 1) {
+        return;
+    }
+
+    unichar *characters = malloc(length * sizeof(unichar));
+    [string getCharacters:characters range:NSMakeRange(0, length)];
+
+    // Longest match starting at each position; only allocated once something matches.
+    NSUInteger *matchLengths = NULL;
+    NSInteger *matchPatterns = NULL;
+
+    NSInteger node = 0;
+    for (NSUInteger i = 0; i < length; i++) {
+        unichar c = characters[i];
+        NSInteger next;
+        while ((next = [self childOfNode:node character:c]) < 0 && node != 0) {
+            node = _nodes[node].fail;
+        }
+        node = next >= 0 ? next : 0;
+
+        NSInteger output = _nodes[node].pattern >= 0 ? node : _nodes[node].outputLink;
+        for (; output >= 0; output = _nodes[output].outputLink) {
+            if (!matchLengths) {
+                matchLengths = calloc(length, sizeof(NSUInteger));
+                matchPatterns = calloc(length, sizeof(NSInteger));
+            }
+            NSUInteger depth = _nodes[output].depth;
+            NSUInteger start = i + 1 - depth;
+            if (depth > matchLengths[start]) {
+                matchLengths[start] = depth;
+                matchPatterns[start] = _nodes[output].pattern;
+            }
+        }
+    }
+    free(characters);
+
+    if (matchLengths) {
+        // Take the leftmost, then longest, non-overlapping matches, and splice from the end
+        // backwards so earlier ranges stay valid.
+        NSMutableArray *ranges = [NSMutableArray array];
+        for (NSUInteger i = 0; i < length; ) {
+            if (matchLengths[i]) {
+                [ranges addObject:[NSValue valueWithRange:NSMakeRange(i, matchLengths[i])]];
+                i += matchLengths[i];
+            } else {
+                i++;
+            }
+        }
+        for (NSValue *value in [ranges reverseObjectEnumerator]) {
+            NSRange range = [value rangeValue];
+            [string replaceCharactersInRange:range
+                                  withString:[_replacements objectAtIndex:matchPatterns[range.location]]];
+        }
+        free(matchLengths);
+        free(matchPatterns);
+    }
+}
+
+@end
 
 @interface FBLogger ()
 
@@ -36,7 +397,7 @@ static NSMutableDictionary *g_startTimesWithTags = nil;
 
 - (instancetype)initWithLoggingBehavior:(NSString *)loggingBehavior {
     if ((self = [super init])) {
-        _isActive = [[FBSettings loggingBehavior] containsObject:loggingBehavior];
+        _isActive = FBLoggerIsEnabled(loggingBehavior);
         _loggingBehavior = loggingBehavior;
         if (_isActive) {
             _internalContents = [[NSMutableString alloc] init];
@@ -74,7 +435,7 @@ static NSMutableDictionary *g_startTimesWithTags = nil;
 }
 
 - (void)appendFormat:(NSString *)formatString, ... {
-    if (_isActive) {
+    if (FB_LOGGING_ENABLED && _isActive) {
         va_list vaArguments;
         va_start(vaArguments, formatString);
         NSString *logString = [[[NSString alloc] initWithFormat:formatString arguments:vaArguments] autorelease];
@@ -94,12 +455,7 @@ static NSMutableDictionary *g_startTimesWithTags = nil;
 - (void)emitToNSLog {
     if (_isActive) {
 
-        for (NSString *key in [g_stringsToReplace keyEnumerator]) {
-            [_internalContents replaceOccurrencesOfString:key
-                                               withString:[g_stringsToReplace objectForKey:key]
-                                                  options:NSLiteralSearch
-                                                    range:NSMakeRange(0, _internalContents.length)];
-        }
+        [[FBLogger redactor] redactString:_internalContents];
 
         // Xcode 4.4 hangs on extremely long NSLog output (http://openradar.appspot.com/11972490).  Truncate if needed.
         const int MAX_LOG_STRING_LENGTH = 10000;
@@ -107,7 +463,7 @@ static NSMutableDictionary *g_startTimesWithTags = nil;
         if (_internalContents.length > MAX_LOG_STRING_LENGTH) {
             logString = [NSString stringWithFormat:@"TRUNCATED: %@", [_internalContents substringToIndex:MAX_LOG_STRING_LENGTH]];
         }
-        NSLog(@"FBSDKLog: %@", logString);
+        FBLoggerSinkWrite(logString);
 
         [_internalContents setString:@""];
     }
@@ -119,9 +475,92 @@ static NSMutableDictionary *g_startTimesWithTags = nil;
     return g_serialNumberCounter++;
 }
 
++ (BOOL)isAsynchronousSinkEnabled {
+    return g_asynchronousSinkEnabled;
+}
+
++ (void)setAsynchronousSinkEnabled:(BOOL)enabled {
+    if (enabled) {
+        FBLoggerSinkSetUp();
+        g_asynchronousSinkEnabled = YES;
+    } else if (g_asynchronousSinkEnabled) {
+        g_asynchronousSinkEnabled = NO;
+        [self flushSink];
+    }
+}
+
++ (FBLoggingHandler)sinkHandler {
+    @synchronized (self) {
+        return [[g_sinkHandler retain] autorelease];
+    }
+}
+
++ (void)setSinkHandler:(FBLoggingHandler)handler {
+    @synchronized (self) {
+        if (handler != g_sinkHandler) {
+            [g_sinkHandler release];
+            g_sinkHandler = [handler copy];
+        }
+    }
+}
+
++ (FBLoggingHandler)sinkHandlerWritingToFileAtPath:(NSString *)path {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    if (![fileManager fileExistsAtPath:path]) {
+        [fileManager createFileAtPath:path contents:nil attributes:nil];
+    }
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:path];
+    if (!fileHandle) {
+        return nil;
+    }
+    [fileHandle seekToEndOfFile];
+
+    return [[^(NSString *logEntry) {
+        @synchronized (fileHandle) {
+            [fileHandle writeData:[[logEntry stringByAppendingString:@"\n"] dataUsingEncoding:NSUTF8StringEncoding]];
+        }
+    } copy] autorelease];
+}
+
++ (NSUInteger)droppedEntryCount {
+    return (NSUInteger)g_sinkDroppedTotal;
+}
+
++ (void)flushSink {
+    if (g_sinkQueue) {
+        dispatch_sync(g_sinkQueue, ^{
+            FBLoggerSinkDrain();
+        });
+    }
+}
+
++ (BOOL)isLoggingBehaviorEnabled:(NSString *)loggingBehavior {
+    if (!loggingBehavior) {
+        return NO;
+    }
+
+    uint32_t bit = FBLoggerBitForBehavior(loggingBehavior);
+    if (!bit) {
+        // Not one of ours; fall back to asking the set directly.
+        return [[FBSettings loggingBehavior] containsObject:loggingBehavior];
+    }
+
+    uint32_t mask = g_enabledBehaviorMask;
+    if (!(mask & FBLoggerBehaviorMaskValid)) {
+        [self loggingBehaviorsDidChange];
+        mask = g_enabledBehaviorMask;
+    }
+    return (mask & bit) != 0;
+}
+
++ (void)loggingBehaviorsDidChange {
+    g_enabledBehaviorMask = FBLoggerBuildBehaviorMask();
+    OSMemoryBarrier();
+}
+
 + (void)singleShotLogEntry:(NSString *)loggingBehavior
                   logEntry:(NSString *)logEntry {
-    if ([[FBSettings loggingBehavior] containsObject:loggingBehavior]) {
+    if (FBLoggerIsEnabled(loggingBehavior)) {
         FBLogger *logger = [[FBLogger alloc] initWithLoggingBehavior:loggingBehavior];
         [logger appendString:logEntry];
         [logger emitToNSLog];
@@ -132,7 +571,7 @@ static NSMutableDictionary *g_startTimesWithTags = nil;
 + (void)singleShotLogEntry:(NSString *)loggingBehavior
               formatString:(NSString *)formatString, ... {
 
-    if ([[FBSettings loggingBehavior] containsObject:loggingBehavior]) {
+    if (FBLoggerIsEnabled(loggingBehavior)) {
         va_list vaArguments;
         va_start(vaArguments, formatString);
         NSString *logString = [[[NSString alloc] initWithFormat:formatString arguments:vaArguments] autorelease];
@@ -147,25 +586,17 @@ static NSMutableDictionary *g_startTimesWithTags = nil;
               timestampTag:(NSObject *)timestampTag
               formatString:(NSString *)formatString, ... {
 
-    if ([[FBSettings loggingBehavior] containsObject:loggingBehavior]) {
+    if (FBLoggerIsEnabled(loggingBehavior)) {
         va_list vaArguments;
         va_start(vaArguments, formatString);
         NSString *logString = [[[NSString alloc] initWithFormat:formatString arguments:vaArguments] autorelease];
         va_end(vaArguments);
 
-        // Start time of this "timestampTag" is stashed in the dictionary.
-        // Treat the incoming object tag simply as an address, since it's only used to identify during lifetime.  If
-        // we send in as an object, the dictionary will try to copy it.
-        NSNumber *tagAsNumber = [NSNumber numberWithUnsignedLong:(unsigned long)(void *)timestampTag];
-        NSNumber *startTimeNumber = [g_startTimesWithTags objectForKey:tagAsNumber];
-
-        // Only log if there's been an associated start time.
-        if (startTimeNumber) {
-            unsigned long elapsed = [FBUtility currentTimeInMilliseconds] - startTimeNumber.unsignedLongValue;
-            [g_startTimesWithTags removeObjectForKey:tagAsNumber];  // served its purpose, remove
-
+        // Only log if there's been an associated start time, which the span then gives up.
+        double elapsed = 0;
+        if ([[FBMetrics sharedMetrics] endSpanForTag:timestampTag metric:nil elapsedMilliseconds:&elapsed]) {
             // Log string is appended with "%d msec", with nothing intervening.  This gives the most control to the caller.
-            logString = [NSString stringWithFormat:@"%@%lu msec", logString, elapsed];
+            logString = [NSString stringWithFormat:@"%@%lu msec", logString, (unsigned long)elapsed];
 
             [self singleShotLogEntry:loggingBehavior logEntry:logString];
         }
@@ -175,24 +606,14 @@ static NSMutableDictionary *g_startTimesWithTags = nil;
 + (void)registerCurrentTime:(NSString *)loggingBehavior
                     withTag:(NSObject *)timestampTag {
 
-    if ([[FBSettings loggingBehavior] containsObject:loggingBehavior]) {
-
-        if (!g_startTimesWithTags) {
-            g_startTimesWithTags = [[NSMutableDictionary alloc] init];
-        }
-
-        if (g_startTimesWithTags.count >= 1000) {
+    if (FBLoggerIsEnabled(loggingBehavior)) {
+        FBMetrics *metrics = [FBMetrics sharedMetrics];
+        if (metrics.openSpanCount >= 1000) {
             [FBLogger singleShotLogEntry:FBLoggingBehaviorDeveloperErrors logEntry:
                     @"Unexpectedly large number of outstanding perf logging start times, something is likely wrong."];
         }
 
-        unsigned long currTime = [FBUtility currentTimeInMilliseconds];
-
-        // Treat the incoming object tag simply as an address, since it's only used to identify during lifetime.  If
-        // we send in as an object, the dictionary will try to copy it.
-        unsigned long tagAsNumber = (unsigned long)(void *)timestampTag;
-        [g_startTimesWithTags setObject:[NSNumber numberWithUnsignedLong:currTime]
-                                 forKey:[NSNumber numberWithUnsignedLong:tagAsNumber]];
+        [metrics beginSpanForTag:timestampTag];
     }
 }
 
@@ -200,15 +621,50 @@ static NSMutableDictionary *g_startTimesWithTags = nil;
 + (void)registerStringToReplace:(NSString *)replace
                     replaceWith:(NSString *)replaceWith {
 
-    // Strings sent in here never get cleaned up, but that's OK, don't ever expect too many.
-
-    if ([[FBSettings loggingBehavior] count] > 0) {  // otherwise there's no logging.
-
-        if (!g_stringsToReplace) {
-            g_stringsToReplace = [[NSMutableDictionary alloc] init];
+    if ([[FBSettings loggingBehavior] count] > 0 && replace.length) {  // otherwise there's no logging.
+
+        @synchronized (self) {
+            if (!g_stringsToReplace) {
+                g_stringsToReplace = [[NSMutableArray alloc] init];
+                g_replacementsForStrings = [[NSMutableDictionary alloc] init];
+            }
+
+            // The same token is registered for every request it's used on; leave things be then.
+            if ([[g_stringsToReplace lastObject] isEqualToString:replace] &&
+                [[g_replacementsForStrings objectForKey:replace] isEqualToString:replaceWith]) {
+                return;
+            }
+
+            // Keep the most recently registered strings, which are the ones still in use.
+            [g_stringsToReplace removeObject:replace];
+            [g_replacementsForStrings removeObjectForKey:replace];
+            if (replaceWith) {
+                [g_stringsToReplace addObject:replace];
+                [g_replacementsForStrings setObject:replaceWith forKey:replace];
+            }
+            while (g_stringsToReplace.count > FBLoggerMaxStringsToReplace) {
+                [g_replacementsForStrings removeObjectForKey:[g_stringsToReplace objectAtIndex:0]];
+                [g_stringsToReplace removeObjectAtIndex:0];
+            }
+
+            [g_redactor release];
+            g_redactor = nil;
         }
+    }
+}
 
-        [g_stringsToReplace setValue:replaceWith forKey:replace];
++ (FBLoggerRedactor *)redactor {
+    @synchronized (self) {
+        if (!g_redactor && g_stringsToReplace.count) {
+            NSMutableArray *patterns = [NSMutableArray arrayWithCapacity:g_stringsToReplace.count];
+            NSMutableArray *replacements = [NSMutableArray arrayWithCapacity:g_stringsToReplace.count];
+            for (NSString *string in g_stringsToReplace) {
+                [patterns addObject:string];
+                [replacements addObject:[g_replacementsForStrings objectForKey:string]];
+            }
+            g_redactor = [[FBLoggerRedactor alloc] initWithPatterns:patterns replacements:replacements];
+        }
+        return [[g_redactor retain] autorelease];
     }
 }
 
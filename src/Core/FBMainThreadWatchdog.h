@@ -0,0 +1,65 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+#import "FBSDKMacros.h"
+
+// Define FB_MAIN_THREAD_WATCHDOG_ENABLED to 0 to compile the watchdog out of the
+// SDK's entry points entirely.
+#ifndef FB_MAIN_THREAD_WATCHDOG_ENABLED
+#define FB_MAIN_THREAD_WATCHDOG_ENABLED 1
+#endif
+
+typedef struct {
+    const char *apiName;
+    NSTimeInterval startTime;
+    BOOL counted;
+} FBMainThreadWatchdogScope;
+
+FBSDK_EXTERN FBMainThreadWatchdogScope FBMainThreadWatchdogScopeBegin(const char *apiName);
+FBSDK_EXTERN void FBMainThreadWatchdogScopeEnd(FBMainThreadWatchdogScope *scope);
+
+// Measures main thread time from here to the end of the enclosing scope, and reports
+// the enclosing method if it runs over the budget. Calls into the SDK from within a
+// measured call are counted toward the outer one only.
+#if FB_MAIN_THREAD_WATCHDOG_ENABLED
+#define FBMainThreadWatchdogMeasure() \
+    FBMainThreadWatchdogScope fb_watchdogScope__ __attribute__((cleanup(FBMainThreadWatchdogScopeEnd), unused)) = \
+        FBMainThreadWatchdogScopeBegin(__PRETTY_FUNCTION__)
+#else
+#define FBMainThreadWatchdogMeasure() do { } while (0)
+#endif
+
+/*!
+ @class FBMainThreadWatchdog
+
+ @abstract
+ Reports SDK calls that spend longer than a budget on the main thread, through
+ FBLoggingBehaviorPerformanceCharacteristics.
+
+ @unsorted
+ */
+@interface FBMainThreadWatchdog : NSObject
+
+// Zero, the default, turns the watchdog off.
++ (NSTimeInterval)budget;
++ (void)setBudget:(NSTimeInterval)budget;
+
++ (NSUInteger)overrunCount;
+
+@end
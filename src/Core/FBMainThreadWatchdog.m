@@ -0,0 +1,93 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBMainThreadWatchdog.h"
+
+#import <pthread.h>
+#import <libkern/OSAtomic.h>
+
+#import "FBLogger.h"
+#import "FBSettings.h"
+#import "FBUtility.h"
+
+static volatile NSTimeInterval g_budget = 0;
+static volatile int32_t g_overrunCount = 0;
+
+// Only touched on the main thread.
+static NSUInteger g_depth = 0;
+
+static void FBMainThreadWatchdogReport(const char *apiName, NSTimeInterval elapsed, NSTimeInterval budget) {
+    OSAtomicIncrement32Barrier(&g_overrunCount);
+    if (!FBLoggerIsEnabled(FBLoggingBehaviorPerformanceCharacteristics)) {
+        return;
+    }
+
+    // Called from the measured method's frame, so its caller is still on the stack.
+    NSArray *stack = [NSThread callStackSymbols];
+    [FBLogger singleShotLogEntry:FBLoggingBehaviorPerformanceCharacteristics
+                    formatString:@"FBMainThreadWatchdog: %s spent %.1f ms on the main thread (budget %.1f ms)\n%@",
+                                 apiName,
+                                 elapsed * 1000,
+                                 budget * 1000,
+                                 [stack componentsJoinedByString:@"\n"]];
+}
+
+FBMainThreadWatchdogScope FBMainThreadWatchdogScopeBegin(const char *apiName) {
+    FBMainThreadWatchdogScope scope = { apiName, 0, NO };
+    if (g_budget <= 0 || !pthread_main_np()) {
+        return scope;
+    }
+
+    scope.counted = YES;
+    if (g_depth++ == 0) {
+        scope.startTime = [FBUtility monotonicTime];
+    }
+    return scope;
+}
+
+void FBMainThreadWatchdogScopeEnd(FBMainThreadWatchdogScope *scope) {
+    if (!scope->counted) {
+        return;
+    }
+
+    g_depth--;
+    if (scope->startTime == 0) {
+        return;
+    }
+
+    NSTimeInterval budget = g_budget;
+    NSTimeInterval elapsed = [FBUtility monotonicTime] - scope->startTime;
+    if (budget > 0 && elapsed > budget) {
+        FBMainThreadWatchdogReport(scope->apiName, elapsed, budget);
+    }
+}
+
+@implementation FBMainThreadWatchdog
+
++ (NSTimeInterval)budget {
+    return g_budget;
+}
+
++ (void)setBudget:(NSTimeInterval)budget {
+    g_budget = MAX(budget, 0);
+}
+
++ (NSUInteger)overrunCount {
+    return (NSUInteger)g_overrunCount;
+}
+
+@end
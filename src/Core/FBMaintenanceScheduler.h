@@ -0,0 +1,50 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+// Runs the SDK's periodic work, such as the app events flush, off one timer so
+// that it shares wakeups instead of each feature waking the device on its own.
+// Each task may run up to its leeway early to be grouped with another one that
+// is due.  Nothing runs while the app is in the background; tasks that came due
+// in the meantime run once when it returns to the foreground.  Tasks may be
+// added or removed from any thread, and run on the queue they were added with.
+@interface FBMaintenanceScheduler : NSObject
+{
+@private
+    dispatch_queue_t _queue;
+    dispatch_source_t _timer;
+    NSMutableArray *_tasks;
+    BOOL _inBackground;
+}
+
++ (FBMaintenanceScheduler *)sharedScheduler;
+
+// Runs block on queue every interval seconds, the first time interval seconds
+// from now.  Returns a handle for the other methods; the scheduler holds on to
+// the task until it is removed.
+- (id)addTaskWithInterval:(NSTimeInterval)interval
+                   leeway:(NSTimeInterval)leeway
+                    queue:(dispatch_queue_t)queue
+                    block:(dispatch_block_t)block;
+
+// Changes the task's period, with the next run interval seconds from now.
+- (void)setInterval:(NSTimeInterval)interval forTask:(id)task;
+
+- (void)removeTask:(id)task;
+
+@end
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBMaintenanceScheduler.h"
+
+#import <UIKit/UIKit.h>
+
+#import "FBDispatch.h"
+#import "FBUtility.h"
+
+@interface FBMaintenanceTask : NSObject
+{
+@public
+    dispatch_queue_t _queue;
+    dispatch_block_t _block;
+    NSTimeInterval _interval;
+    NSTimeInterval _leeway;
+    // In FBUtility monotonicTime
+    NSTimeInterval _fireTime;
+}
+@end
+
+// Must be called on the main thread
+static BOOL FBMaintenanceSchedulerApplicationIsInBackground(void)
+{
+    return [[UIApplication sharedApplication] applicationState] == UIApplicationStateBackground;
+}
+
+@implementation FBMaintenanceTask
+
+- (void)dealloc
+{
+    dispatch_release(_queue);
+    [_block release];
+    [super dealloc];
+}
+
+@end
+
+@implementation FBMaintenanceScheduler
+
+#pragma mark - Lifecycle
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        _tasks = [[NSMutableArray alloc] init];
+        _queue = FBDispatchQueueCreateSerial("com.facebook.sdk.FBMaintenanceScheduler", FBDispatchLaneBackground);
+
+        // The timer is cancelled in dealloc, so its handler doesn't retain the scheduler
+        __block FBMaintenanceScheduler *weakSelf = self;
+        _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+        dispatch_source_set_timer(_timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        dispatch_source_set_event_handler(_timer, ^{
+            [weakSelf runDueTasks];
+        });
+        dispatch_resume(_timer);
+
+        // The app may have been launched into the background, e.g. for a background fetch
+        if ([NSThread isMainThread]) {
+            _inBackground = FBMaintenanceSchedulerApplicationIsInBackground();
+        } else {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                BOOL inBackground = FBMaintenanceSchedulerApplicationIsInBackground();
+                dispatch_async(_queue, ^{
+                    _inBackground = inBackground;
+                    [self scheduleTimer];
+                });
+            });
+        }
+
+        NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+        [center addObserver:self
+                   selector:@selector(applicationDidEnterBackground:)
+                       name:UIApplicationDidEnterBackgroundNotification
+                     object:nil];
+        [center addObserver:self
+                   selector:@selector(applicationWillEnterForeground:)
+                       name:UIApplicationWillEnterForegroundNotification
+                     object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    dispatch_source_cancel(_timer);
+    dispatch_release(_timer);
+    dispatch_release(_queue);
+    [_tasks release];
+    [super dealloc];
+}
+
++ (FBMaintenanceScheduler *)sharedScheduler
+{
+    static FBMaintenanceScheduler *_instance;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBMaintenanceScheduler alloc] init];
+    });
+
+    return _instance;
+}
+
+#pragma mark - Public
+
+- (id)addTaskWithInterval:(NSTimeInterval)interval
+                   leeway:(NSTimeInterval)leeway
+                    queue:(dispatch_queue_t)queue
+                    block:(dispatch_block_t)block
+{
+    FBMaintenanceTask *task = [[[FBMaintenanceTask alloc] init] autorelease];
+    dispatch_retain(queue);
+    task->_queue = queue;
+    task->_block = [block copy];
+    task->_interval = interval;
+    task->_leeway = leeway;
+    task->_fireTime = [FBUtility monotonicTime] + interval;
+
+    dispatch_async(_queue, ^{
+        [_tasks addObject:task];
+        [self scheduleTimer];
+    });
+    return task;
+}
+
+- (void)setInterval:(NSTimeInterval)interval forTask:(id)task
+{
+    FBMaintenanceTask *maintenanceTask = task;
+    dispatch_async(_queue, ^{
+        maintenanceTask->_interval = interval;
+        maintenanceTask->_fireTime = [FBUtility monotonicTime] + interval;
+        [self scheduleTimer];
+    });
+}
+
+- (void)removeTask:(id)task
+{
+    dispatch_async(_queue, ^{
+        [_tasks removeObjectIdenticalTo:task];
+        [self scheduleTimer];
+    });
+}
+
+#pragma mark - Private
+
+// Called on _queue.  Runs every task that is due or within its leeway of being
+// due, so tasks that come due close together share one wakeup.
+- (void)runDueTasks
+{
+    if (_inBackground) {
+        return;
+    }
+
+    NSTimeInterval now = [FBUtility monotonicTime];
+    for (FBMaintenanceTask *task in _tasks) {
+        if (task->_fireTime - task->_leeway <= now) {
+            task->_fireTime = now + task->_interval;
+            dispatch_async(task->_queue, task->_block);
+        }
+    }
+    [self scheduleTimer];
+}
+
+// Called on _queue.  Points the timer at the earliest task, with the smallest
+// leeway any task allows so none runs later than it asked.
+- (void)scheduleTimer
+{
+    if (_inBackground || _tasks.count == 0) {
+        dispatch_source_set_timer(_timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        return;
+    }
+
+    NSTimeInterval fireTime = DBL_MAX;
+    NSTimeInterval leeway = DBL_MAX;
+    for (FBMaintenanceTask *task in _tasks) {
+        fireTime = MIN(fireTime, task->_fireTime);
+        leeway = MIN(leeway, task->_leeway);
+    }
+
+    NSTimeInterval delay = MAX(fireTime - [FBUtility monotonicTime], 0);
+    dispatch_source_set_timer(_timer,
+                              dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                              DISPATCH_TIME_FOREVER,
+                              (uint64_t)(leeway * NSEC_PER_SEC));
+}
+
+- (void)applicationDidEnterBackground:(NSNotification *)notification
+{
+    dispatch_async(_queue, ^{
+        _inBackground = YES;
+        [self scheduleTimer];
+    });
+}
+
+- (void)applicationWillEnterForeground:(NSNotification *)notification
+{
+    dispatch_async(_queue, ^{
+        _inBackground = NO;
+        // Anything that came due while in the background runs now, once
+        [self scheduleTimer];
+    });
+}
+
+@end
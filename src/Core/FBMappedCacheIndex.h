@@ -0,0 +1,57 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <pthread.h>
+
+#import <Foundation/Foundation.h>
+
+#import "FBCacheIndex.h"
+
+// An FBCacheIndexing backend that keeps the index in a memory mapped,
+// open addressing hash table file, so a lookup is a few memory reads under a
+// mutex rather than a trip through SQLite and a queue.  Adds and removals are
+// appended to a log before the table is changed, and the log is replayed over
+// the table when it is next opened; a checkpoint now and then syncs the table
+// and empties the log.  Access times are not logged, so a crash can only make
+// eviction order a little stale.  Thread-safe.
+@interface FBMappedCacheIndex : NSObject <FBCacheIndexing>
+{
+@private
+    id _delegate;
+    NSUInteger _diskCapacity;
+
+    NSString *_tablePath;
+    NSString *_logPath;
+
+    // Guards everything below
+    pthread_mutex_t _lock;
+    int _tableFile;
+    int _logFile;
+    void *_table;
+    size_t _tableLength;
+    BOOL _checkpointScheduled;
+
+    dispatch_queue_t _maintenanceQueue;
+
+    // Statistics, kept the same way as FBCacheIndex's
+    volatile int64_t _evictionCount;
+    volatile int64_t _evictedBytes;
+    volatile int64_t _trimCount;
+    volatile int64_t _trimMicroseconds;
+}
+
+@end
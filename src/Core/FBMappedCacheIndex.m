@@ -0,0 +1,763 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBMappedCacheIndex.h"
+
+#import <CommonCrypto/CommonDigest.h>
+#import <fcntl.h>
+#import <libkern/OSAtomic.h>
+#import <stddef.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#import "FBDispatch.h"
+#import "FBLogger.h"
+#import "FBUtility.h"
+
+static NSString *const kTableFileName = @"cache.idx";
+static NSString *const kLogFileName = @"cache.idx.log";
+
+static const uint32_t kTableMagic = 0x46424349; // "FBCI"
+static const uint32_t kTableVersion = 1;
+// Slot counts are powers of two, so a probe wraps with a mask
+static const uint32_t kMinimumCapacity = 1024;
+// Share of slots in use, removed ones included, before the table is rebuilt
+static const double kMaximumLoad = 0.7;
+// From the first logged change to the checkpoint that folds it into the table
+static const NSTimeInterval kCheckpointDelay = 5.0;
+// The slots start here, leaving the header room to grow
+static const size_t kSlotsOffset = 64;
+
+enum {
+    FBMappedCacheSlotEmpty = 0,
+    FBMappedCacheSlotOccupied,
+    // Ends no probe, unlike an empty slot, and is reused by the next insert along it
+    FBMappedCacheSlotRemoved,
+};
+
+enum {
+    FBMappedCacheLogStore = 1,
+    FBMappedCacheLogRemove,
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t removedCount;
+    uint32_t reserved;
+    uint64_t diskUsage;
+} FBMappedCacheHeader;
+
+typedef struct {
+    uint8_t keyDigest[CC_MD5_DIGEST_LENGTH];
+    char fileName[48];
+    // 0 for the nil namespace
+    uint64_t namespaceHash;
+    CFAbsoluteTime accessTime;
+    uint64_t fileSize;
+    uint32_t state;
+    // Over everything before it but accessTime, so that a torn slot is noticed on
+    // open.  Lookups rewrite accessTime in place, and the worst a torn one can do
+    // is misorder eviction, so it isn't worth dropping the entry and its file.
+    uint32_t checksum;
+} FBMappedCacheSlot;
+
+typedef struct {
+    uint32_t operation;
+    // Over the whole record, with this field zeroed
+    uint32_t checksum;
+    FBMappedCacheSlot slot;
+} FBMappedCacheLogRecord;
+
+typedef struct {
+    CFAbsoluteTime accessTime;
+    uint32_t index;
+} FBMappedCacheEvictionCandidate;
+
+#pragma mark - C Helpers
+
+// FNV-1a; only has to catch torn writes, not tampering
+static uint32_t FBMappedCacheChecksum(const void *bytes, size_t length)
+{
+    const uint8_t *cursor = bytes;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= cursor[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t FBMappedCacheSlotChecksum(const FBMappedCacheSlot *slot)
+{
+    FBMappedCacheSlot sealed = *slot;
+    sealed.accessTime = 0;
+    return FBMappedCacheChecksum(&sealed, offsetof(FBMappedCacheSlot, checksum));
+}
+
+static void FBMappedCacheSealSlot(FBMappedCacheSlot *slot)
+{
+    slot->checksum = FBMappedCacheSlotChecksum(slot);
+}
+
+static BOOL FBMappedCacheSlotIsSealed(const FBMappedCacheSlot *slot)
+{
+    return slot->checksum == FBMappedCacheSlotChecksum(slot);
+}
+
+static uint32_t FBMappedCacheRecordChecksum(FBMappedCacheLogRecord record)
+{
+    record.checksum = 0;
+    return FBMappedCacheChecksum(&record, sizeof(record));
+}
+
+static void FBMappedCacheDigest(NSString *string, uint8_t *digest)
+{
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    CC_MD5(data.bytes, (CC_LONG)data.length, digest);
+}
+
+static uint64_t FBMappedCacheNamespaceHash(NSString *cacheNamespace)
+{
+    if (!cacheNamespace) {
+        return 0;
+    }
+    uint8_t digest[CC_MD5_DIGEST_LENGTH];
+    FBMappedCacheDigest(cacheNamespace, digest);
+    uint64_t hash;
+    memcpy(&hash, digest, sizeof(hash));
+    return hash ?: 1;
+}
+
+static size_t FBMappedCacheTableLength(uint32_t capacity)
+{
+    return kSlotsOffset + (size_t)capacity * sizeof(FBMappedCacheSlot);
+}
+
+static FBMappedCacheSlot *FBMappedCacheSlots(void *table)
+{
+    return (FBMappedCacheSlot *)((char *)table + kSlotsOffset);
+}
+
+// The slot holding digest if *found, otherwise the one it should go in: the
+// first removed slot along its probe, or failing that the empty slot ending it
+static uint32_t FBMappedCacheFindSlot(void *table, const uint8_t *digest, BOOL *found)
+{
+    FBMappedCacheHeader *header = table;
+    FBMappedCacheSlot *slots = FBMappedCacheSlots(table);
+    uint32_t mask = header->capacity - 1;
+    uint64_t hash;
+    memcpy(&hash, digest, sizeof(hash));
+    uint32_t index = (uint32_t)hash & mask;
+    uint32_t firstRemoved = UINT32_MAX;
+    for (uint32_t probes = 0; probes < header->capacity; probes++) {
+        FBMappedCacheSlot *slot = &slots[index];
+        if (slot->state == FBMappedCacheSlotEmpty) {
+            break;
+        } else if (slot->state == FBMappedCacheSlotRemoved) {
+            if (firstRemoved == UINT32_MAX) {
+                firstRemoved = index;
+            }
+        } else if (memcmp(slot->keyDigest, digest, CC_MD5_DIGEST_LENGTH) == 0) {
+            *found = YES;
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+    *found = NO;
+    return (firstRemoved != UINT32_MAX) ? firstRemoved : index;
+}
+
+static int FBMappedCacheCompareCandidates(const void *a, const void *b)
+{
+    CFAbsoluteTime first = ((const FBMappedCacheEvictionCandidate *)a)->accessTime;
+    CFAbsoluteTime second = ((const FBMappedCacheEvictionCandidate *)b)->accessTime;
+    return (first < second) ? -1 : ((first > second) ? 1 : 0);
+}
+
+static void FBMappedCacheAddMicrosecondsSince(NSTimeInterval startTime, volatile int64_t *counter)
+{
+    OSAtomicAdd64Barrier((int64_t)(([FBUtility monotonicTime] - startTime) * USEC_PER_SEC), counter);
+}
+
+static void FBMappedCacheResetCounter(volatile int64_t *counter)
+{
+    int64_t value;
+    do {
+        value = *counter;
+    } while (!OSAtomicCompareAndSwap64Barrier(value, 0, counter));
+}
+
+@interface FBMappedCacheIndex ()
+
+- (BOOL)_storeFileWithName:(NSString *)fileName
+                    forKey:(NSString *)key
+                  fileSize:(NSUInteger)fileSize
+                 namespace:(NSString *)cacheNamespace;
+- (BOOL)_openTable;
+- (void)_replayLog;
+- (BOOL)_rebuildTableWithCapacity:(uint32_t)capacity;
+- (BOOL)_storeSlot:(const FBMappedCacheSlot *)slot replacedFileName:(NSString **)replacedFileName;
+- (void)_removeSlotAtIndex:(uint32_t)index;
+- (void)_logOperation:(uint32_t)operation slot:(const FBMappedCacheSlot *)slot;
+- (void)_checkpoint;
+- (void)_trim;
+
+@end
+
+@implementation FBMappedCacheIndex
+
+@synthesize delegate = _delegate;
+@synthesize diskCapacity = _diskCapacity;
+
+#pragma mark - Lifecycle
+
+- (instancetype)initWithCacheFolder:(NSString *)folderPath
+{
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        _tableFile = -1;
+        _logFile = -1;
+        _tablePath = [[folderPath stringByAppendingPathComponent:kTableFileName] copy];
+        _logPath = [[folderPath stringByAppendingPathComponent:kLogFileName] copy];
+        _maintenanceQueue = FBDispatchQueueCreateSerial("Mapped Cache Index queue", FBDispatchLaneUtility);
+
+        if (![self _openTable]) {
+            [self release];
+            return nil;
+        }
+        [self _replayLog];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    // Nothing scheduled can still be pending, since it would be holding on to us
+    if (_table) {
+        [self _checkpoint];
+        munmap(_table, _tableLength);
+    }
+    if (_tableFile >= 0) {
+        close(_tableFile);
+    }
+    if (_logFile >= 0) {
+        close(_logFile);
+    }
+    if (_maintenanceQueue) {
+        dispatch_release(_maintenanceQueue);
+    }
+    [_tablePath release];
+    [_logPath release];
+    pthread_mutex_destroy(&_lock);
+    [super dealloc];
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)currentDiskUsage
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger diskUsage = (NSUInteger)((FBMappedCacheHeader *)_table)->diskUsage;
+    pthread_mutex_unlock(&_lock);
+    return diskUsage;
+}
+
+- (FBCacheIndexStatistics)statistics
+{
+    FBCacheIndexStatistics statistics;
+    statistics.evictionCount = (uint64_t)_evictionCount;
+    statistics.evictedBytes = (uint64_t)_evictedBytes;
+    statistics.trimCount = (uint64_t)_trimCount;
+    statistics.trimDuration = (NSTimeInterval)_trimMicroseconds / USEC_PER_SEC;
+    // Nothing here ever waits on a queue
+    statistics.syncWaitCount = 0;
+    statistics.syncWaitDuration = 0;
+    return statistics;
+}
+
+- (void)resetStatistics
+{
+    FBMappedCacheResetCounter(&_evictionCount);
+    FBMappedCacheResetCounter(&_evictedBytes);
+    FBMappedCacheResetCounter(&_trimCount);
+    FBMappedCacheResetCounter(&_trimMicroseconds);
+}
+
+#pragma mark - Public
+
+- (NSString *)fileNameForKey:(NSString *)key
+{
+    uint8_t digest[CC_MD5_DIGEST_LENGTH];
+    FBMappedCacheDigest(key, digest);
+
+    NSString *fileName = nil;
+    pthread_mutex_lock(&_lock);
+    BOOL found = NO;
+    uint32_t index = FBMappedCacheFindSlot(_table, digest, &found);
+    if (found) {
+        FBMappedCacheSlot *slot = &FBMappedCacheSlots(_table)[index];
+        slot->accessTime = CFAbsoluteTimeGetCurrent();
+        fileName = [[NSString alloc] initWithUTF8String:slot->fileName];
+    }
+    pthread_mutex_unlock(&_lock);
+
+    return [fileName autorelease];
+}
+
+- (NSString *)storeFileForKey:(NSString *)key withData:(NSData *)data
+{
+    return [self storeFileForKey:key withData:data namespace:nil];
+}
+
+- (NSString *)storeFileForKey:(NSString *)key
+                     withData:(NSData *)data
+                    namespace:(NSString *)cacheNamespace
+{
+    NSString *uuidString = [FBUtility newUUIDString];
+    if (![self _storeFileWithName:uuidString
+                           forKey:key
+                         fileSize:data.length
+                        namespace:cacheNamespace]) {
+        // Not written, since nothing would ever delete it
+        [uuidString release];
+        return nil;
+    }
+
+    [self.delegate cacheIndex:self writeFileWithName:uuidString data:data];
+
+    return [uuidString autorelease];
+}
+
+- (void)storeFileWithName:(NSString *)fileName
+                   forKey:(NSString *)key
+                 fileSize:(NSUInteger)fileSize
+                namespace:(NSString *)cacheNamespace
+{
+    [self _storeFileWithName:fileName forKey:key fileSize:fileSize namespace:cacheNamespace];
+}
+
+// Deletes the file when it can't be indexed, and returns whether it was
+- (BOOL)_storeFileWithName:(NSString *)fileName
+                    forKey:(NSString *)key
+                  fileSize:(NSUInteger)fileSize
+                 namespace:(NSString *)cacheNamespace
+{
+    FBMappedCacheSlot slot;
+    memset(&slot, 0, sizeof(slot));
+    const char *fileNameBytes = fileName.UTF8String;
+    if (!fileNameBytes || strlcpy(slot.fileName, fileNameBytes, sizeof(slot.fileName)) >= sizeof(slot.fileName)) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                        formatString:@"FBMappedCacheIndex: file name too long to index: %@", fileName];
+        [self.delegate cacheIndex:self deleteFileWithName:fileName];
+        return NO;
+    }
+    FBMappedCacheDigest(key, slot.keyDigest);
+    slot.namespaceHash = FBMappedCacheNamespaceHash(cacheNamespace);
+    slot.accessTime = CFAbsoluteTimeGetCurrent();
+    slot.fileSize = fileSize;
+    slot.state = FBMappedCacheSlotOccupied;
+    FBMappedCacheSealSlot(&slot);
+
+    NSString *replacedFileName = nil;
+    pthread_mutex_lock(&_lock);
+    BOOL stored = [self _storeSlot:&slot replacedFileName:&replacedFileName];
+    if (stored) {
+        [self _logOperation:FBMappedCacheLogStore slot:&slot];
+    }
+    BOOL needsTrim = ((FBMappedCacheHeader *)_table)->diskUsage > _diskCapacity;
+    pthread_mutex_unlock(&_lock);
+
+    if (!stored) {
+        [self.delegate cacheIndex:self deleteFileWithName:fileName];
+    }
+    if (replacedFileName) {
+        [self.delegate cacheIndex:self deleteFileWithName:replacedFileName];
+        [replacedFileName release];
+    }
+    if (needsTrim) {
+        dispatch_async(_maintenanceQueue, ^{
+            [self _trim];
+        });
+    }
+    return stored;
+}
+
+- (void)removeEntryForKey:(NSString *)key
+{
+    uint8_t digest[CC_MD5_DIGEST_LENGTH];
+    FBMappedCacheDigest(key, digest);
+
+    NSString *fileName = nil;
+    pthread_mutex_lock(&_lock);
+    BOOL found = NO;
+    uint32_t index = FBMappedCacheFindSlot(_table, digest, &found);
+    if (found) {
+        FBMappedCacheSlot *slot = &FBMappedCacheSlots(_table)[index];
+        fileName = [[NSString alloc] initWithUTF8String:slot->fileName];
+        [self _logOperation:FBMappedCacheLogRemove slot:slot];
+        [self _removeSlotAtIndex:index];
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (fileName) {
+        [self.delegate cacheIndex:self deleteFileWithName:fileName];
+        [fileName release];
+    }
+}
+
+- (NSUInteger)removeEntriesInNamespace:(NSString *)cacheNamespace
+{
+    uint64_t namespaceHash = FBMappedCacheNamespaceHash(cacheNamespace);
+    NSMutableArray *fileNames = [NSMutableArray array];
+
+    pthread_mutex_lock(&_lock);
+    FBMappedCacheSlot *slots = FBMappedCacheSlots(_table);
+    uint32_t capacity = ((FBMappedCacheHeader *)_table)->capacity;
+    for (uint32_t index = 0; index < capacity; index++) {
+        FBMappedCacheSlot *slot = &slots[index];
+        if (slot->state == FBMappedCacheSlotOccupied && slot->namespaceHash == namespaceHash) {
+            [fileNames addObject:[NSString stringWithUTF8String:slot->fileName]];
+            [self _logOperation:FBMappedCacheLogRemove slot:slot];
+            [self _removeSlotAtIndex:index];
+        }
+    }
+    pthread_mutex_unlock(&_lock);
+
+    for (NSString *fileName in fileNames) {
+        [self.delegate cacheIndex:self deleteFileWithName:fileName];
+    }
+    return fileNames.count;
+}
+
+#pragma mark - Table
+
+// Maps the table, starting it over if the file is missing or can't be read,
+// and drops any slot that was only partly written
+- (BOOL)_openTable
+{
+    _tableFile = open(_tablePath.fileSystemRepresentation, O_RDWR | O_CREAT, 0600);
+    if (_tableFile < 0) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                        formatString:@"FBMappedCacheIndex: unable to open %@: %s", _tablePath, strerror(errno)];
+        return NO;
+    }
+
+    struct stat fileStat;
+    FBMappedCacheHeader header;
+    BOOL valid = (fstat(_tableFile, &fileStat) == 0 &&
+                  fileStat.st_size >= (off_t)kSlotsOffset &&
+                  pread(_tableFile, &header, sizeof(header), 0) == sizeof(header) &&
+                  header.magic == kTableMagic &&
+                  header.version == kTableVersion &&
+                  header.capacity >= kMinimumCapacity &&
+                  (header.capacity & (header.capacity - 1)) == 0 &&
+                  fileStat.st_size == (off_t)FBMappedCacheTableLength(header.capacity));
+    if (!valid) {
+        if (fileStat.st_size > 0) {
+            [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                                logEntry:@"FBMappedCacheIndex: starting over from an unreadable index"];
+        }
+        header.capacity = kMinimumCapacity;
+        if (ftruncate(_tableFile, 0) != 0 ||
+            ftruncate(_tableFile, (off_t)FBMappedCacheTableLength(header.capacity)) != 0) {
+            return NO;
+        }
+        // whatever the log holds was for the table being discarded
+        unlink(_logPath.fileSystemRepresentation);
+    }
+
+    _tableLength = FBMappedCacheTableLength(header.capacity);
+    _table = mmap(NULL, _tableLength, PROT_READ | PROT_WRITE, MAP_SHARED, _tableFile, 0);
+    if (_table == MAP_FAILED) {
+        _table = NULL;
+        return NO;
+    }
+
+    FBMappedCacheHeader *mappedHeader = _table;
+    if (!valid) {
+        mappedHeader->magic = kTableMagic;
+        mappedHeader->version = kTableVersion;
+        mappedHeader->capacity = header.capacity;
+        return YES;
+    }
+
+    // One pass to drop torn slots, which also recomputes the header's totals in
+    // case it was written out without them
+    FBMappedCacheSlot *slots = FBMappedCacheSlots(_table);
+    uint32_t count = 0;
+    uint32_t removedCount = 0;
+    uint64_t diskUsage = 0;
+    for (uint32_t index = 0; index < mappedHeader->capacity; index++) {
+        FBMappedCacheSlot *slot = &slots[index];
+        if (slot->state == FBMappedCacheSlotEmpty) {
+            continue;
+        }
+        if (slot->state != FBMappedCacheSlotOccupied || !FBMappedCacheSlotIsSealed(slot)) {
+            // kept as removed rather than empty, so that probes through it still work
+            slot->state = FBMappedCacheSlotRemoved;
+        }
+        if (slot->state == FBMappedCacheSlotOccupied) {
+            count++;
+            diskUsage += slot->fileSize;
+        } else {
+            removedCount++;
+        }
+    }
+    mappedHeader->count = count;
+    mappedHeader->removedCount = removedCount;
+    mappedHeader->diskUsage = diskUsage;
+    return YES;
+}
+
+// Applies every whole record in the log, in order, up to the first one that
+// doesn't check out, which can only be a write cut short.  Files replaced or
+// removed by replayed records were already handed to the delegate to delete.
+- (void)_replayLog
+{
+    NSData *log = [NSData dataWithContentsOfFile:_logPath options:NSDataReadingMappedIfSafe error:nil];
+    const FBMappedCacheLogRecord *records = log.bytes;
+    NSUInteger recordCount = log.length / sizeof(FBMappedCacheLogRecord);
+    for (NSUInteger i = 0; i < recordCount; i++) {
+        FBMappedCacheLogRecord record;
+        memcpy(&record, &records[i], sizeof(record));
+        if (record.checksum != FBMappedCacheRecordChecksum(record)) {
+            break;
+        }
+        if (record.operation == FBMappedCacheLogStore) {
+            NSString *replacedFileName = nil;
+            [self _storeSlot:&record.slot replacedFileName:&replacedFileName];
+            [replacedFileName release];
+        } else if (record.operation == FBMappedCacheLogRemove) {
+            BOOL found = NO;
+            uint32_t index = FBMappedCacheFindSlot(_table, record.slot.keyDigest, &found);
+            if (found) {
+                [self _removeSlotAtIndex:index];
+            }
+        }
+    }
+
+    _logFile = open(_logPath.fileSystemRepresentation, O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (_logFile < 0) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                        formatString:@"FBMappedCacheIndex: unable to open %@: %s", _logPath, strerror(errno)];
+    }
+    if (recordCount > 0) {
+        [self _checkpoint];
+    }
+}
+
+// Moves every entry into a new table file of the given capacity, which then
+// replaces the current one.  On failure the current table is left as it was.
+- (BOOL)_rebuildTableWithCapacity:(uint32_t)capacity
+{
+    NSString *newTablePath = [_tablePath stringByAppendingPathExtension:@"new"];
+    int newTableFile = open(newTablePath.fileSystemRepresentation, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (newTableFile < 0) {
+        return NO;
+    }
+    size_t newTableLength = FBMappedCacheTableLength(capacity);
+    void *newTable = MAP_FAILED;
+    if (ftruncate(newTableFile, (off_t)newTableLength) == 0) {
+        newTable = mmap(NULL, newTableLength, PROT_READ | PROT_WRITE, MAP_SHARED, newTableFile, 0);
+    }
+    if (newTable == MAP_FAILED) {
+        close(newTableFile);
+        unlink(newTablePath.fileSystemRepresentation);
+        return NO;
+    }
+
+    FBMappedCacheHeader *header = _table;
+    FBMappedCacheHeader *newHeader = newTable;
+    newHeader->magic = kTableMagic;
+    newHeader->version = kTableVersion;
+    newHeader->capacity = capacity;
+    newHeader->count = header->count;
+    newHeader->diskUsage = header->diskUsage;
+
+    FBMappedCacheSlot *slots = FBMappedCacheSlots(_table);
+    FBMappedCacheSlot *newSlots = FBMappedCacheSlots(newTable);
+    for (uint32_t index = 0; index < header->capacity; index++) {
+        if (slots[index].state == FBMappedCacheSlotOccupied) {
+            BOOL found = NO;
+            uint32_t newIndex = FBMappedCacheFindSlot(newTable, slots[index].keyDigest, &found);
+            newSlots[newIndex] = slots[index];
+        }
+    }
+
+    if (msync(newTable, newTableLength, MS_SYNC) != 0 ||
+        rename(newTablePath.fileSystemRepresentation, _tablePath.fileSystemRepresentation) != 0) {
+        munmap(newTable, newTableLength);
+        close(newTableFile);
+        unlink(newTablePath.fileSystemRepresentation);
+        return NO;
+    }
+
+    munmap(_table, _tableLength);
+    close(_tableFile);
+    _table = newTable;
+    _tableLength = newTableLength;
+    _tableFile = newTableFile;
+    return YES;
+}
+
+// Puts slot in the table, over any entry for the same key.  *replacedFileName is
+// set, retained, to that entry's file if it was a different one.
+- (BOOL)_storeSlot:(const FBMappedCacheSlot *)slot replacedFileName:(NSString **)replacedFileName
+{
+    FBMappedCacheHeader *header = _table;
+    if (header->count + header->removedCount + 1 > header->capacity * kMaximumLoad) {
+        // Doubles until the live entries fill at most half the allowed load, which
+        // for a table mostly made of removed slots just clears them out
+        uint32_t capacity = header->capacity;
+        while (header->count + 1 > capacity * kMaximumLoad / 2) {
+            capacity *= 2;
+        }
+        if (![self _rebuildTableWithCapacity:capacity]) {
+            [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                                logEntry:@"FBMappedCacheIndex: unable to grow the index"];
+            header = _table;
+            if (header->count + header->removedCount + 1 >= header->capacity) {
+                return NO;
+            }
+        }
+        header = _table;
+    }
+
+    BOOL found = NO;
+    uint32_t index = FBMappedCacheFindSlot(_table, slot->keyDigest, &found);
+    FBMappedCacheSlot *target = &FBMappedCacheSlots(_table)[index];
+    if (found) {
+        header->diskUsage -= MIN(header->diskUsage, target->fileSize);
+        if (strncmp(target->fileName, slot->fileName, sizeof(target->fileName)) != 0) {
+            *replacedFileName = [[NSString alloc] initWithUTF8String:target->fileName];
+        }
+    } else {
+        if (target->state == FBMappedCacheSlotRemoved) {
+            header->removedCount--;
+        }
+        header->count++;
+    }
+    *target = *slot;
+    header->diskUsage += slot->fileSize;
+    return YES;
+}
+
+- (void)_removeSlotAtIndex:(uint32_t)index
+{
+    FBMappedCacheHeader *header = _table;
+    FBMappedCacheSlot *slot = &FBMappedCacheSlots(_table)[index];
+    header->diskUsage -= MIN(header->diskUsage, slot->fileSize);
+    header->count--;
+    header->removedCount++;
+    slot->state = FBMappedCacheSlotRemoved;
+    FBMappedCacheSealSlot(slot);
+}
+
+#pragma mark - Log
+
+// Called with the lock held.  A removal is logged before it is made; a store only
+// once it has been made, since it can fail and must not be replayed then.
+- (void)_logOperation:(uint32_t)operation slot:(const FBMappedCacheSlot *)slot
+{
+    if (_logFile < 0) {
+        return;
+    }
+    FBMappedCacheLogRecord record;
+    record.operation = operation;
+    record.slot = *slot;
+    record.checksum = FBMappedCacheRecordChecksum(record);
+    if (write(_logFile, &record, sizeof(record)) != sizeof(record)) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorCacheErrors
+                        formatString:@"FBMappedCacheIndex: unable to log a change: %s", strerror(errno)];
+    }
+
+    if (!_checkpointScheduled) {
+        _checkpointScheduled = YES;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kCheckpointDelay * NSEC_PER_SEC)),
+                       _maintenanceQueue, ^{
+                           pthread_mutex_lock(&_lock);
+                           [self _checkpoint];
+                           pthread_mutex_unlock(&_lock);
+                       });
+    }
+}
+
+// Once the table is on disk the log has nothing left to add, so it is emptied.
+// Called with the lock held, or from init and dealloc.
+- (void)_checkpoint
+{
+    _checkpointScheduled = NO;
+    if (_table && msync(_table, _tableLength, MS_SYNC) == 0 && _logFile >= 0) {
+        ftruncate(_logFile, 0);
+    }
+}
+
+#pragma mark - Eviction
+
+// Evicts the least recently used entries until disk usage is down to 80% of capacity
+- (void)_trim
+{
+    NSTimeInterval trimStartTime = [FBUtility monotonicTime];
+    NSMutableArray *fileNames = [NSMutableArray array];
+    uint64_t spaceCleaned = 0;
+
+    pthread_mutex_lock(&_lock);
+    FBMappedCacheHeader *header = _table;
+    if (header->diskUsage <= _diskCapacity) {
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+    uint64_t spaceToClean = header->diskUsage - (uint64_t)(_diskCapacity * 0.8);
+
+    FBMappedCacheSlot *slots = FBMappedCacheSlots(_table);
+    FBMappedCacheEvictionCandidate *candidates = malloc(sizeof(FBMappedCacheEvictionCandidate) * MAX(header->count, 1));
+    uint32_t candidateCount = 0;
+    for (uint32_t index = 0; index < header->capacity && candidateCount < header->count; index++) {
+        if (slots[index].state == FBMappedCacheSlotOccupied) {
+            candidates[candidateCount].accessTime = slots[index].accessTime;
+            candidates[candidateCount].index = index;
+            candidateCount++;
+        }
+    }
+    qsort(candidates, candidateCount, sizeof(FBMappedCacheEvictionCandidate), FBMappedCacheCompareCandidates);
+
+    for (uint32_t i = 0; i < candidateCount && spaceCleaned < spaceToClean; i++) {
+        FBMappedCacheSlot *slot = &slots[candidates[i].index];
+        spaceCleaned += slot->fileSize;
+        [fileNames addObject:[NSString stringWithUTF8String:slot->fileName]];
+        [self _logOperation:FBMappedCacheLogRemove slot:slot];
+        [self _removeSlotAtIndex:candidates[i].index];
+    }
+    free(candidates);
+    pthread_mutex_unlock(&_lock);
+
+    for (NSString *fileName in fileNames) {
+        [self.delegate cacheIndex:self deleteFileWithName:fileName];
+    }
+
+    OSAtomicAdd64Barrier((int64_t)fileNames.count, &_evictionCount);
+    OSAtomicAdd64Barrier((int64_t)spaceCleaned, &_evictedBytes);
+    OSAtomicIncrement64Barrier(&_trimCount);
+    FBMappedCacheAddMicrosecondsSince(trimStartTime, &_trimMicroseconds);
+}
+
+@end
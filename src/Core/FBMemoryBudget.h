@@ -0,0 +1,79 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+// How expensive a client's memory is to get back, lowest first.  Under pressure
+// clients are shed in this order.
+typedef NS_ENUM(NSUInteger, FBMemoryBudgetPriority) {
+    // Rebuilt from something local, such as the disk cache
+    FBMemoryBudgetPriorityLow = 0,
+    FBMemoryBudgetPriorityDefault,
+    // Only rebuilt with network requests
+    FBMemoryBudgetPriorityHigh,
+};
+
+@protocol FBMemoryBudgetClient <NSObject>
+
+@required
+// Roughly how many bytes the client holds.
+- (NSUInteger)memoryBudgetCost;
+// Releases memory until the client holds at most cost bytes, 0 meaning all of it.
+// Both methods are called from any thread with the budget's lock held, so they
+// must not call back into the budget.
+- (void)shedMemoryToCost:(NSUInteger)cost;
+
+@end
+
+// Keeps the memory held by the SDK's in-memory caches under one ceiling.  Clients
+// register with a priority and report when they grow; whenever their total is
+// over the ceiling, they are shed from the lowest priority up until it fits.  On
+// a memory warning everything is shed down to a quarter of the ceiling.
+// Clients are not retained, and must unregister before they are deallocated.
+// Growth may be reported from any thread; the check it triggers, and any
+// shedding, happens shortly afterwards on a background queue.
+//
+// Picker data sources are not clients.  What they hold is the rows of a table on
+// screen and its index, which the table would ask for again right away, and they
+// may only be touched on the main thread while shedding happens on any.  The
+// pictures and row bitmaps they draw from are NSCaches with budgets of their own,
+// larger than this ceiling, that the system already trims under memory pressure.
+@interface FBMemoryBudget : NSObject
+{
+@private
+    NSMutableArray *_registrations;
+    NSUInteger _ceiling;
+    volatile int32_t _checkScheduled;
+}
+
++ (FBMemoryBudget *)sharedBudget;
+
+// Total bytes the clients may hold.  Defaults to 4MB.
+@property (atomic, assign) NSUInteger ceiling;
+
+- (void)registerClient:(id<FBMemoryBudgetClient>)client priority:(FBMemoryBudgetPriority)priority;
+- (void)unregisterClient:(id<FBMemoryBudgetClient>)client;
+
+// Lock-free and coalesced, so cheap enough to call on every insertion.  The
+// ceiling is checked shortly afterwards on a background queue.
+- (void)clientDidGrow:(id<FBMemoryBudgetClient>)client;
+
+// Sheds clients, lowest priority first, until their total fits in ceiling.
+// Returns the total afterwards.
+- (NSUInteger)shedToCeiling:(NSUInteger)ceiling;
+
+@end
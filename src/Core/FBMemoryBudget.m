@@ -0,0 +1,160 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBMemoryBudget.h"
+
+#import <libkern/OSAtomic.h>
+#import <UIKit/UIKit.h>
+
+#import "FBDispatch.h"
+
+static const NSUInteger kDefaultCeiling = 4 * 1024 * 1024; // 4MB
+// Growth reported within this window is checked against the ceiling once
+static const NSTimeInterval kCheckDelay = 0.5;
+static const NSUInteger kMemoryWarningCeilingDivisor = 4;
+
+@interface FBMemoryBudgetRegistration : NSObject
+{
+@public
+    id<FBMemoryBudgetClient> _client; // weak
+    FBMemoryBudgetPriority _priority;
+}
+@end
+
+@implementation FBMemoryBudgetRegistration
+@end
+
+@implementation FBMemoryBudget
+
+@synthesize ceiling = _ceiling;
+
+#pragma mark - Lifecycle
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        _registrations = [[NSMutableArray alloc] init];
+        _ceiling = kDefaultCeiling;
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(didReceiveMemoryWarning:)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [_registrations release];
+    [super dealloc];
+}
+
++ (FBMemoryBudget *)sharedBudget
+{
+    static FBMemoryBudget *_instance;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBMemoryBudget alloc] init];
+    });
+
+    return _instance;
+}
+
+#pragma mark - Public
+
+- (void)registerClient:(id<FBMemoryBudgetClient>)client priority:(FBMemoryBudgetPriority)priority
+{
+    FBMemoryBudgetRegistration *registration = [[[FBMemoryBudgetRegistration alloc] init] autorelease];
+    registration->_client = client;
+    registration->_priority = priority;
+
+    @synchronized(self) {
+        // Kept ordered by priority, and by registration within a priority
+        NSUInteger index = _registrations.count;
+        while (index > 0 &&
+               ((FBMemoryBudgetRegistration *)_registrations[index - 1])->_priority > priority) {
+            index--;
+        }
+        [_registrations insertObject:registration atIndex:index];
+    }
+}
+
+- (void)unregisterClient:(id<FBMemoryBudgetClient>)client
+{
+    @synchronized(self) {
+        for (NSUInteger i = 0; i < _registrations.count; i++) {
+            if (((FBMemoryBudgetRegistration *)_registrations[i])->_client == client) {
+                [_registrations removeObjectAtIndex:i];
+                break;
+            }
+        }
+    }
+}
+
+- (void)clientDidGrow:(id<FBMemoryBudgetClient>)client
+{
+    if (!OSAtomicCompareAndSwap32Barrier(0, 1, &_checkScheduled)) {
+        return;
+    }
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kCheckDelay * NSEC_PER_SEC)),
+                   FBDispatchGetGlobalQueue(FBDispatchLaneBackground),
+                   ^{
+                       OSAtomicCompareAndSwap32Barrier(1, 0, &_checkScheduled);
+                       [self shedToCeiling:self.ceiling];
+                   });
+}
+
+- (NSUInteger)shedToCeiling:(NSUInteger)ceiling
+{
+    @synchronized(self) {
+        NSUInteger count = _registrations.count;
+        NSUInteger *costs = malloc(MAX(count, 1) * sizeof(NSUInteger));
+        NSUInteger total = 0;
+        for (NSUInteger i = 0; i < count; i++) {
+            costs[i] = [((FBMemoryBudgetRegistration *)_registrations[i])->_client memoryBudgetCost];
+            total += costs[i];
+        }
+
+        for (NSUInteger i = 0; i < count && total > ceiling; i++) {
+            id<FBMemoryBudgetClient> client = ((FBMemoryBudgetRegistration *)_registrations[i])->_client;
+            NSUInteger excess = total - ceiling;
+            [client shedMemoryToCost:(costs[i] > excess ? costs[i] - excess : 0)];
+
+            NSUInteger cost = [client memoryBudgetCost];
+            total = total - costs[i] + MIN(cost, costs[i]);
+        }
+
+        free(costs);
+        return total;
+    }
+}
+
+#pragma mark - Private
+
+- (void)didReceiveMemoryWarning:(NSNotification *)notification
+{
+    NSUInteger ceiling = self.ceiling / kMemoryWarningCeilingDivisor;
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneUtility), ^{
+        [self shedToCeiling:ceiling];
+    });
+}
+
+@end
@@ -0,0 +1,366 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBMetrics.h"
+
+#include <mach/mach_time.h>
+#include <malloc/malloc.h>
+
+NSString *const FBMetricRequestLatency = @"request_latency_ms";
+NSString *const FBMetricBytesSent = @"bytes_sent";
+NSString *const FBMetricBytesReceived = @"bytes_received";
+NSString *const FBMetricCacheHits = @"cache_hits";
+NSString *const FBMetricCacheMisses = @"cache_misses";
+NSString *const FBMetricRequestRetries = @"request_retries";
+NSString *const FBMetricCircuitBreakerTrips = @"circuit_breaker_trips";
+NSString *const FBMetricCircuitBreakerRejections = @"circuit_breaker_rejections";
+NSString *const FBMetricBatchEncodingPeakBytes = @"batch_encoding_peak_bytes";
+NSString *const FBMetricResponseParsingPeakBytes = @"response_parsing_peak_bytes";
+NSString *const FBMetricRequestCompletionPeakBytes = @"request_completion_peak_bytes";
+NSString *const FBMetricAppEventsEncodingPeakBytes = @"app_events_encoding_peak_bytes";
+NSString *const FBMetricAppBridgeEncodingPeakBytes = @"app_bridge_encoding_peak_bytes";
+
+NSString *const FBNetworkFeatureAppEvents = @"app_events";
+NSString *const FBNetworkFeatureFriendPicker = @"friend_picker";
+NSString *const FBNetworkFeaturePlacePicker = @"place_picker";
+NSString *const FBNetworkFeatureProfilePicture = @"profile_picture";
+NSString *const FBNetworkFeatureLike = @"like";
+NSString *const FBNetworkFeatureAppSettings = @"app_settings";
+NSString *const FBNetworkFeatureAppLinkResolver = @"app_link_resolver";
+NSString *const FBNetworkFeatureOther = @"other";
+
+NSString *const FBMetricCountKey = @"count";
+NSString *const FBMetricSumKey = @"sum";
+NSString *const FBMetricMinKey = @"min";
+NSString *const FBMetricMaxKey = @"max";
+NSString *const FBMetricBucketsKey = @"buckets";
+
+// Enough power-of-two buckets for byte counts well past a gigabyte.
+static const NSUInteger FBMetricsBucketCount = 32;
+
+static double FBMetricsMillisecondsFromMachTime(uint64_t machTime) {
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    return (double)machTime * timebase.numer / timebase.denom / NSEC_PER_MSEC;
+}
+
+// Bytes allocated across all malloc zones
+static size_t FBMetricsHeapBytesInUse(void) {
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(NULL, &statistics);
+    return statistics.size_in_use;
+}
+
+static NSUInteger FBMetricsBucketForValue(double value) {
+    NSUInteger bucket = 0;
+    while (value >= 1 && bucket < FBMetricsBucketCount - 1) {
+        value /= 2;
+        bucket++;
+    }
+    return bucket;
+}
+
+@interface FBMetricsHistogram : NSObject {
+@public
+    NSUInteger _count;
+    double _sum;
+    double _min;
+    double _max;
+    NSUInteger _buckets[FBMetricsBucketCount];
+}
+
+- (void)addValue:(double)value;
+- (double)estimatedPercentile:(double)percentile;
+- (NSDictionary *)dictionaryValue;
+
+@end
+
+@implementation FBMetricsHistogram
+
+- (void)addValue:(double)value {
+    if (_count == 0 || value < _min) {
+        _min = value;
+    }
+    if (_count == 0 || value > _max) {
+        _max = value;
+    }
+    _count++;
+    _sum += value;
+    _buckets[FBMetricsBucketForValue(value)]++;
+}
+
+- (double)estimatedPercentile:(double)percentile {
+    if (_count == 0) {
+        return 0;
+    }
+    double rank = MAX(0, MIN(percentile, 100)) / 100 * _count;
+    NSUInteger seen = 0;
+    for (NSUInteger i = 0; i < FBMetricsBucketCount; i++) {
+        if (_buckets[i] == 0 || seen + _buckets[i] < rank) {
+            seen += _buckets[i];
+            continue;
+        }
+        double lower = i == 0 ? 0 : ldexp(1, (int)i - 1);
+        double upper = ldexp(1, (int)i);
+        double estimate = lower + (upper - lower) * (rank - seen) / _buckets[i];
+        return MAX(_min, MIN(estimate, _max));
+    }
+    return _max;
+}
+
+- (NSDictionary *)dictionaryValue {
+    NSMutableArray *buckets = [NSMutableArray arrayWithCapacity:FBMetricsBucketCount];
+    for (NSUInteger i = 0; i < FBMetricsBucketCount; i++) {
+        [buckets addObject:[NSNumber numberWithUnsignedInteger:_buckets[i]]];
+    }
+    return @{ FBMetricCountKey : [NSNumber numberWithUnsignedInteger:_count],
+              FBMetricSumKey : [NSNumber numberWithDouble:_sum],
+              FBMetricMinKey : [NSNumber numberWithDouble:_min],
+              FBMetricMaxKey : [NSNumber numberWithDouble:_max],
+              FBMetricBucketsKey : buckets };
+}
+
+@end
+
+@interface FBMetricsNetworkUsage : NSObject {
+@public
+    NSUInteger _count;
+    unsigned long long _bytesSent;
+    unsigned long long _bytesReceived;
+}
+
+- (NSDictionary *)dictionaryValue;
+
+@end
+
+@implementation FBMetricsNetworkUsage
+
+- (NSDictionary *)dictionaryValue {
+    return @{ FBMetricCountKey : [NSNumber numberWithUnsignedInteger:_count],
+              FBMetricBytesSent : [NSNumber numberWithUnsignedLongLong:_bytesSent],
+              FBMetricBytesReceived : [NSNumber numberWithUnsignedLongLong:_bytesReceived] };
+}
+
+@end
+
+@interface FBMetrics ()
+
+@property (nonatomic, retain) NSMutableDictionary *spanStartTimes;
+@property (nonatomic, retain) NSMutableDictionary *histograms;
+@property (nonatomic, retain) NSMutableDictionary *counters;
+@property (nonatomic, retain) NSMutableDictionary *networkUsage;
+
+@end
+
+@implementation FBMetrics
+
++ (FBMetrics *)sharedMetrics {
+    static FBMetrics *_instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBMetrics alloc] init];
+    });
+    return _instance;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _spanStartTimes = [[NSMutableDictionary alloc] init];
+        _histograms = [[NSMutableDictionary alloc] init];
+        _counters = [[NSMutableDictionary alloc] init];
+        _networkUsage = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_spanStartTimes release];
+    [_histograms release];
+    [_counters release];
+    [_networkUsage release];
+    [super dealloc];
+}
+
+#pragma mark - Spans
+
+// Treat the tag simply as an address, since it's only used to identify during its lifetime.  If
+// we used the object as a key, the dictionary would try to copy it.
+- (NSValue *)keyForTag:(NSObject *)tag {
+    return [NSValue valueWithPointer:tag];
+}
+
+- (NSUInteger)openSpanCount {
+    @synchronized (self) {
+        return self.spanStartTimes.count;
+    }
+}
+
+- (void)beginSpanForTag:(NSObject *)tag {
+    NSNumber *startTime = [NSNumber numberWithUnsignedLongLong:mach_absolute_time()];
+    @synchronized (self) {
+        [self.spanStartTimes setObject:startTime forKey:[self keyForTag:tag]];
+    }
+}
+
+- (BOOL)endSpanForTag:(NSObject *)tag
+               metric:(NSString *)metric
+  elapsedMilliseconds:(double *)elapsedMilliseconds {
+    uint64_t now = mach_absolute_time();
+    NSNumber *startTime = nil;
+    NSValue *key = [self keyForTag:tag];
+    @synchronized (self) {
+        startTime = [[[self.spanStartTimes objectForKey:key] retain] autorelease];
+        [self.spanStartTimes removeObjectForKey:key];
+    }
+    if (!startTime) {
+        return NO;
+    }
+
+    double elapsed = FBMetricsMillisecondsFromMachTime(now - startTime.unsignedLongLongValue);
+    if (elapsedMilliseconds) {
+        *elapsedMilliseconds = elapsed;
+    }
+    if (metric) {
+        [self recordValue:elapsed forMetric:metric];
+    }
+    return YES;
+}
+
+- (void)cancelSpanForTag:(NSObject *)tag {
+    @synchronized (self) {
+        [self.spanStartTimes removeObjectForKey:[self keyForTag:tag]];
+    }
+}
+
+#pragma mark - Values
+
+- (void)recordValue:(double)value forMetric:(NSString *)metric {
+    @synchronized (self) {
+        FBMetricsHistogram *histogram = [self.histograms objectForKey:metric];
+        if (!histogram) {
+            histogram = [[[FBMetricsHistogram alloc] init] autorelease];
+            [self.histograms setObject:histogram forKey:metric];
+        }
+        [histogram addValue:value];
+    }
+
+    id<FBMetricsDelegate> delegate = self.delegate;
+    if ([delegate respondsToSelector:@selector(metrics:didRecordValue:forMetric:)]) {
+        [delegate metrics:self didRecordValue:value forMetric:metric];
+    }
+}
+
+#pragma mark - Allocations
+
+- (void)beginAllocationSample:(FBMetricsAllocationSample *)sample {
+    sample->startBytes = FBMetricsHeapBytesInUse();
+    sample->peakBytes = sample->startBytes;
+}
+
+- (void)updateAllocationSample:(FBMetricsAllocationSample *)sample {
+    sample->peakBytes = MAX(sample->peakBytes, FBMetricsHeapBytesInUse());
+}
+
+- (void)endAllocationSample:(FBMetricsAllocationSample *)sample metric:(NSString *)metric {
+    [self updateAllocationSample:sample];
+    [self recordValue:(double)(sample->peakBytes - sample->startBytes) forMetric:metric];
+}
+
+- (void)incrementCounter:(NSString *)counter by:(NSUInteger)amount {
+    @synchronized (self) {
+        NSUInteger current = [[self.counters objectForKey:counter] unsignedIntegerValue];
+        [self.counters setObject:[NSNumber numberWithUnsignedInteger:current + amount] forKey:counter];
+    }
+
+    id<FBMetricsDelegate> delegate = self.delegate;
+    if ([delegate respondsToSelector:@selector(metrics:didIncrementCounter:by:)]) {
+        [delegate metrics:self didIncrementCounter:counter by:amount];
+    }
+}
+
+- (double)cacheHitRate {
+    @synchronized (self) {
+        double hits = [[self.counters objectForKey:FBMetricCacheHits] doubleValue];
+        double misses = [[self.counters objectForKey:FBMetricCacheMisses] doubleValue];
+        return (hits + misses) > 0 ? hits / (hits + misses) : 0;
+    }
+}
+
+- (double)estimatedPercentile:(double)percentile
+                    forMetric:(NSString *)metric
+                  sampleCount:(NSUInteger *)sampleCount {
+    @synchronized (self) {
+        FBMetricsHistogram *histogram = [self.histograms objectForKey:metric];
+        if (sampleCount) {
+            *sampleCount = histogram ? histogram->_count : 0;
+        }
+        return [histogram estimatedPercentile:percentile];
+    }
+}
+
+#pragma mark - Network usage
+
+- (void)recordBytesSent:(unsigned long long)bytesSent
+          bytesReceived:(unsigned long long)bytesReceived
+             forFeature:(NSString *)feature {
+    feature = feature ?: FBNetworkFeatureOther;
+    @synchronized (self) {
+        FBMetricsNetworkUsage *usage = [self.networkUsage objectForKey:feature];
+        if (!usage) {
+            usage = [[[FBMetricsNetworkUsage alloc] init] autorelease];
+            [self.networkUsage setObject:usage forKey:feature];
+        }
+        usage->_count++;
+        usage->_bytesSent += bytesSent;
+        usage->_bytesReceived += bytesReceived;
+    }
+}
+
+- (NSDictionary *)networkUsageByFeature {
+    @synchronized (self) {
+        NSMutableDictionary *usageByFeature = [NSMutableDictionary dictionaryWithCapacity:self.networkUsage.count];
+        for (NSString *feature in self.networkUsage) {
+            [usageByFeature setObject:[[self.networkUsage objectForKey:feature] dictionaryValue] forKey:feature];
+        }
+        return usageByFeature;
+    }
+}
+
+#pragma mark - Snapshot
+
+- (NSDictionary *)snapshot {
+    @synchronized (self) {
+        NSMutableDictionary *snapshot = [NSMutableDictionary dictionaryWithDictionary:self.counters];
+        for (NSString *metric in self.histograms) {
+            [snapshot setObject:[[self.histograms objectForKey:metric] dictionaryValue] forKey:metric];
+        }
+        return snapshot;
+    }
+}
+
+- (void)reset {
+    @synchronized (self) {
+        [self.histograms removeAllObjects];
+        [self.counters removeAllObjects];
+        [self.networkUsage removeAllObjects];
+    }
+}
+
+@end
@@ -19,8 +19,27 @@
 
 FBSDK_EXTERN NSString *const FBPLISTUrlSchemeSuffixKey;
 
+// The settings consulted while building requests, as they stood at one moment.  Snapshots never
+// change; any change to one of these settings publishes a new one, so reading them takes no lock
+// and never goes back to the Info.plist.
+@interface FBSettingsSnapshot : NSObject
+
+@property (nonatomic, readonly, copy) NSString *appID;
+@property (nonatomic, readonly, copy) NSString *clientToken;
+@property (nonatomic, readonly, copy) NSString *displayName;
+@property (nonatomic, readonly, copy) NSString *urlSchemeSuffix;
+@property (nonatomic, readonly, copy) NSString *facebookDomainPart;
+@property (nonatomic, readonly, copy) NSString *appVersion;
+@property (nonatomic, readonly, copy) NSSet *loggingBehavior;
+@property (nonatomic, readonly) CGFloat JPEGCompressionQuality;
+
+@end
+
 @interface FBSettings (Internal)
 
+// Returns the current snapshot; callers reading several settings should read them all from one
++ (FBSettingsSnapshot *)snapshot;
+
 + (void)autoPublishInstall:(NSString *)appID;
 
 /*!
@@ -17,12 +17,35 @@
 #import "FBSettings.h"
 #import "FBSettings+Internal.h"
 
+#import <libkern/OSAtomic.h>
 #import <UIKit/UIKit.h>
 
+#import "FBAppEvents+Internal.h"
+#import "FBBackgroundUploader.h"
+#import "FBDataDiskCache.h"
+#import "FBDialogClosePNG.h"
+#import "FBDispatch.h"
+#import "FBDynamicFrameworkLoader.h"
 #import "FBError.h"
+#import "FBFriendPickerViewDefaultPNG.h"
+#import "FBImageResourceLoader.h"
+#import "FBLikeButtonBackgroundPNG.h"
+#import "FBLikeButtonBackgroundSelectedPNG.h"
+#import "FBLikeButtonIconPNG.h"
+#import "FBLikeButtonIconSelectedPNG.h"
 #import "FBLogger.h"
+#import "FBLoginViewButtonPNG.h"
+#import "FBLoginViewButtonPressedPNG.h"
+#import "FBMainThreadWatchdog.h"
+#import "FBPlacePickerViewGenericPlacePNG.h"
+#import "FBProfilePictureViewBlankProfilePortraitPNG.h"
+#import "FBProfilePictureViewBlankProfileSquarePNG.h"
 #import "FBRequest.h"
+#import "FBRequestRetryPolicy.h"
 #import "FBSession+Internal.h"
+#import "FBSessionTokenCachingStrategy.h"
+#import "FBStartupProfiler.h"
+#import "FBTrace.h"
 #import "FBUtility.h"
 #import "FacebookSDK.h"
 
@@ -56,22 +79,160 @@ NSString *const FBMobileInstallEvent = @"MOBILE_APP_INSTALL";
 
 NSTimeInterval const FBPublishDelay = 0.1;
 
-@implementation FBSettings
+@interface FBSettingsSnapshot ()
+
+@property (nonatomic, readwrite, copy) NSString *appID;
+@property (nonatomic, readwrite, copy) NSString *clientToken;
+@property (nonatomic, readwrite, copy) NSString *displayName;
+@property (nonatomic, readwrite, copy) NSString *urlSchemeSuffix;
+@property (nonatomic, readwrite, copy) NSString *facebookDomainPart;
+@property (nonatomic, readwrite, copy) NSString *appVersion;
+@property (nonatomic, readwrite, copy) NSSet *loggingBehavior;
+@property (nonatomic, readwrite) CGFloat JPEGCompressionQuality;
+
+@end
+
+@implementation FBSettingsSnapshot
 
+- (void)dealloc {
+    [_appID release];
+    [_clientToken release];
+    [_displayName release];
+    [_urlSchemeSuffix release];
+    [_facebookDomainPart release];
+    [_appVersion release];
+    [_loggingBehavior release];
+    [super dealloc];
+}
+
+@end
+
+// The values set explicitly, which take precedence over the Info.plist.  Guarded by
+// @synchronized ([FBSettings class]); the getters read the published snapshot instead.
 static NSSet *g_loggingBehavior;
-static BOOL g_autoPublishInstall = YES;
-static dispatch_once_t g_publishInstallOnceToken;
 static NSString *g_appVersion;
-static NSUInteger g_betaFeatures = 0;
 static NSString *g_clientToken;
 static NSString *g_defaultDisplayName = nil;
 static NSString *g_defaultAppID = nil;
 static CGFloat g_defaultJPEGCompressionQuality = 0.9;
 static NSString *g_defaultUrlSchemeSuffix = nil;
 static NSString *g_facebookDomainPart = nil;
+
+static FBSettingsSnapshot *volatile g_snapshot = nil;
+// Replaced snapshots are kept rather than released, as a reader may still be using one.  Settings
+// change a handful of times per run, so this stays small.
+static NSMutableArray *g_retiredSnapshots = nil;
+
+// Called with the lock held
+static FBSettingsSnapshot *FBSettingsPublishSnapshot(void) {
+    NSBundle *bundle = [NSBundle mainBundle];
+    FBSettingsSnapshot *snapshot = [[FBSettingsSnapshot alloc] init];
+    snapshot.appID = g_defaultAppID ?: [bundle objectForInfoDictionaryKey:FBPLISTAppIDKey];
+    snapshot.clientToken = g_clientToken ?: [bundle objectForInfoDictionaryKey:FBPLISTClientTokenKey];
+    snapshot.displayName = g_defaultDisplayName ?: [bundle objectForInfoDictionaryKey:FBPLISTDisplayNameKey];
+    snapshot.urlSchemeSuffix = g_defaultUrlSchemeSuffix ?: [bundle objectForInfoDictionaryKey:FBPLISTUrlSchemeSuffixKey];
+    snapshot.facebookDomainPart = g_facebookDomainPart ?: [bundle objectForInfoDictionaryKey:FBPLISTDomainPartKey];
+    snapshot.appVersion = g_appVersion ?: [bundle objectForInfoDictionaryKey:FBPLISTAppVersionKey];
+    snapshot.JPEGCompressionQuality = g_defaultJPEGCompressionQuality;
+
+    NSSet *loggingBehavior = g_loggingBehavior;
+    if (!loggingBehavior) {
+        NSArray *bundleLoggingBehaviors = [bundle objectForInfoDictionaryKey:FBPLISTLoggingBehaviorKey];
+        if (bundleLoggingBehaviors) {
+            loggingBehavior = [NSSet setWithArray:bundleLoggingBehaviors];
+        } else {
+            // Establish set of default enabled logging behaviors.  You can completely disable logging by
+            // specifying an empty array for FacebookLoggingBehavior in your Info.plist.
+            loggingBehavior = [NSSet setWithObject:FBLoggingBehaviorDeveloperErrors];
+        }
+    }
+    snapshot.loggingBehavior = loggingBehavior;
+
+    FBSettingsSnapshot *previous = g_snapshot;
+    if (previous) {
+        if (!g_retiredSnapshots) {
+            g_retiredSnapshots = [[NSMutableArray alloc] init];
+        }
+        [g_retiredSnapshots addObject:previous];
+        [previous release];
+    }
+    // Make the snapshot's contents visible before the snapshot itself
+    OSMemoryBarrier();
+    g_snapshot = snapshot;
+    return snapshot;
+}
+
+// Sets `*setting` to a copy of `value`, republishing if it changed
+static void FBSettingsUpdateString(NSString **setting, NSString *value) {
+    @synchronized ([FBSettings class]) {
+        if (![*setting isEqualToString:value]) {
+            [*setting release];
+            *setting = [value copy];
+            FBSettingsPublishSnapshot();
+        }
+    }
+}
+
+// Reconnects to uploads an earlier run left with the system, so their results come in.
+// Done at launch, and again when uploads are enabled later on; both are idempotent.
+static void FBSettingsReconnectBackgroundUploads(void) {
+    void (^reconnect)(void) = ^{
+        if ([FBBackgroundUploader isAvailable]) {
+            [FBBackgroundUploader sharedUploader];
+            [FBAppEvents reconcileBackgroundUploads];
+        }
+    };
+    if ([NSThread isMainThread]) {
+        reconnect();
+    } else {
+        dispatch_async(dispatch_get_main_queue(), reconnect);
+    }
+}
+
+@implementation FBSettings
+
+static BOOL g_autoPublishInstall = YES;
+static dispatch_once_t g_publishInstallOnceToken;
+static NSUInteger g_betaFeatures = 0;
 static NSString *g_resourceBundleName = nil;
 static FBRestrictedTreatment g_restrictedTreatment;
 static BOOL g_enableLegacyGraphAPI = NO;
+static BOOL g_enableRequestCompression = NO;
+static BOOL g_enableConnectionPrewarming = NO;
+static BOOL g_enableAdaptiveRequestTimeouts = NO;
+static BOOL g_enableRequestHedging = NO;
+static BOOL g_enableFriendListDeltaSync = NO;
+static BOOL g_enableBackgroundUploads = NO;
+static NSUInteger g_maximumUploadImageDimension = 0;
+static BOOL g_enableAdaptiveJPEGQuality = NO;
+static BOOL g_enableRequestScheduling = NO;
+static BOOL g_enableLegacyRequestBatching = NO;
+static BOOL g_enableMappedCacheIndex = NO;
+static BOOL g_enablePrerenderedPickerRows = NO;
+static FBRequestRetryPolicy *g_requestRetryPolicy = nil;
+
+#pragma mark - Lifecycle
+
+// Installs are published once per launch from here, rather than from whichever SDK call comes first,
+// so connections and image loads don't carry the check.
++ (void)load {
+    @autoreleasepool {
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(applicationDidFinishLaunching:)
+                                                     name:UIApplicationDidFinishLaunchingNotification
+                                                   object:nil];
+    }
+}
+
++ (void)applicationDidFinishLaunching:(NSNotification *)notification {
+    [[NSNotificationCenter defaultCenter] removeObserver:self
+                                                    name:UIApplicationDidFinishLaunchingNotification
+                                                  object:nil];
+    [FBSettings autoPublishInstall:nil];
+    FBSettingsReconnectBackgroundUploads();
+}
+
+#pragma mark -
 
 + (NSString *)sdkVersion {
     return FB_IOS_SDK_VERSION_STRING;
@@ -87,6 +248,223 @@ static BOOL g_enableLegacyGraphAPI = NO;
     }
 }
 
++ (BOOL)isRequestCompressionEnabled {
+    return g_enableRequestCompression;
+}
+
++ (void)enableRequestCompression:(BOOL)enable {
+    g_enableRequestCompression = enable;
+}
+
++ (BOOL)isConnectionPrewarmingEnabled {
+    return g_enableConnectionPrewarming;
+}
+
++ (void)enableConnectionPrewarming:(BOOL)enable {
+    g_enableConnectionPrewarming = enable;
+}
+
++ (BOOL)isAdaptiveRequestTimeoutsEnabled {
+    return g_enableAdaptiveRequestTimeouts;
+}
+
++ (void)enableAdaptiveRequestTimeouts:(BOOL)enable {
+    g_enableAdaptiveRequestTimeouts = enable;
+}
+
++ (BOOL)isRequestHedgingEnabled {
+    return g_enableRequestHedging;
+}
+
++ (void)enableRequestHedging:(BOOL)enable {
+    g_enableRequestHedging = enable;
+}
+
++ (BOOL)isFriendListDeltaSyncEnabled {
+    return g_enableFriendListDeltaSync;
+}
+
++ (void)enableFriendListDeltaSync:(BOOL)enable {
+    g_enableFriendListDeltaSync = enable;
+}
+
++ (BOOL)isBackgroundUploadsEnabled {
+    return g_enableBackgroundUploads;
+}
+
++ (void)enableBackgroundUploads:(BOOL)enable {
+    g_enableBackgroundUploads = enable;
+    if (enable) {
+        FBSettingsReconnectBackgroundUploads();
+    }
+}
+
++ (NSUInteger)maximumUploadImageDimension {
+    return g_maximumUploadImageDimension;
+}
+
++ (void)setMaximumUploadImageDimension:(NSUInteger)dimension {
+    g_maximumUploadImageDimension = dimension;
+}
+
++ (BOOL)isAdaptiveJPEGQualityEnabled {
+    return g_enableAdaptiveJPEGQuality;
+}
+
++ (void)enableAdaptiveJPEGQuality:(BOOL)enable {
+    g_enableAdaptiveJPEGQuality = enable;
+}
+
++ (BOOL)isRequestSchedulingEnabled {
+    return g_enableRequestScheduling;
+}
+
++ (void)enableRequestScheduling:(BOOL)enable {
+    g_enableRequestScheduling = enable;
+}
+
++ (BOOL)isLegacyRequestBatchingEnabled {
+    return g_enableLegacyRequestBatching;
+}
+
++ (void)enableLegacyRequestBatching:(BOOL)enable {
+    g_enableLegacyRequestBatching = enable;
+}
+
++ (BOOL)isMappedCacheIndexEnabled {
+    return g_enableMappedCacheIndex;
+}
+
++ (void)enableMappedCacheIndex:(BOOL)enable {
+    g_enableMappedCacheIndex = enable;
+}
+
++ (BOOL)isPrerenderedPickerRowsEnabled {
+    return g_enablePrerenderedPickerRows;
+}
+
++ (void)enablePrerenderedPickerRows:(BOOL)enable {
+    g_enablePrerenderedPickerRows = enable;
+}
+
++ (FBRequestRetryPolicy *)requestRetryPolicy {
+    @synchronized ([FBSettings class]) {
+        return [[g_requestRetryPolicy retain] autorelease];
+    }
+}
+
++ (void)setRequestRetryPolicy:(FBRequestRetryPolicy *)policy {
+    @synchronized ([FBSettings class]) {
+        if (policy != g_requestRetryPolicy) {
+            [g_requestRetryPolicy release];
+            g_requestRetryPolicy = [policy retain];
+        }
+    }
+}
+
++ (BOOL)isAsynchronousLoggingEnabled {
+    return [FBLogger isAsynchronousSinkEnabled];
+}
+
++ (void)enableAsynchronousLogging:(BOOL)enable {
+    [FBLogger setAsynchronousSinkEnabled:enable];
+}
+
++ (FBLoggingHandler)loggingHandler {
+    return [FBLogger sinkHandler];
+}
+
++ (void)setLoggingHandler:(FBLoggingHandler)handler {
+    [FBLogger setSinkHandler:handler];
+}
+
++ (FBLoggingHandler)loggingHandlerWritingToFileAtPath:(NSString *)path {
+    return [FBLogger sinkHandlerWritingToFileAtPath:path];
+}
+
++ (BOOL)isTracingEnabled {
+    return [FBTrace isEnabled];
+}
+
++ (void)enableTracing:(BOOL)enable {
+    [FBTrace setEnabled:enable];
+}
+
++ (FBTraceHandler)traceHandler {
+    return [FBTrace handler];
+}
+
++ (void)setTraceHandler:(FBTraceHandler)handler {
+    [FBTrace setHandler:handler];
+}
+
++ (NSTimeInterval)mainThreadWorkBudget {
+    return [FBMainThreadWatchdog budget];
+}
+
++ (void)setMainThreadWorkBudget:(NSTimeInterval)budget {
+    [FBMainThreadWatchdog setBudget:budget];
+}
+
++ (BOOL)isStartupProfilingEnabled {
+    return [FBStartupProfiler isEnabled];
+}
+
++ (void)enableStartupProfiling:(BOOL)enable {
+    [FBStartupProfiler setEnabled:enable];
+}
+
++ (NSDictionary *)startupProfile {
+    return [FBStartupProfiler profile];
+}
+
++ (void)prewarmWithCompletionHandler:(void (^)(void))handler {
+    dispatch_queue_t queue = FBDispatchGetGlobalQueue(FBDispatchLaneUtility);
+    dispatch_group_t group = dispatch_group_create();
+
+    dispatch_group_async(group, queue, ^{
+        [FBDataDiskCache sharedCache];
+    });
+    dispatch_group_async(group, queue, ^{
+        [FBDynamicFrameworkLoader prewarm];
+    });
+    dispatch_group_async(group, queue, ^{
+        [[FBSessionTokenCachingStrategy defaultInstance] fetchFBAccessTokenData];
+    });
+    dispatch_group_async(group, queue, ^{
+        [FBAppEvents prewarm];
+    });
+    dispatch_group_async(group, queue, ^{
+        NSArray *imageResources = @[[FBLoginViewButtonPNG class],
+                                    [FBLoginViewButtonPressedPNG class],
+                                    [FBProfilePictureViewBlankProfilePortraitPNG class],
+                                    [FBProfilePictureViewBlankProfileSquarePNG class],
+                                    [FBLikeButtonBackgroundPNG class],
+                                    [FBLikeButtonBackgroundSelectedPNG class],
+                                    [FBLikeButtonIconPNG class],
+                                    [FBLikeButtonIconSelectedPNG class],
+                                    [FBFriendPickerViewDefaultPNG class],
+                                    [FBPlacePickerViewGenericPlacePNG class],
+                                    [FBDialogClosePNG class]];
+        dispatch_apply(imageResources.count, queue, ^(size_t i) {
+            [FBImageResourceLoader predecodeImageResource:[imageResources objectAtIndex:i]];
+        });
+    });
+    // The fetched app settings are only touched on the main thread
+    dispatch_group_async(group, dispatch_get_main_queue(), ^{
+        [FBUtility loadPersistedAppSettings:[FBSettings defaultAppID]];
+    });
+
+    if (handler) {
+        handler = [handler copy];
+        dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+            handler();
+            [handler release];
+        });
+    }
+    dispatch_release(group);
+}
+
 + (NSString *)platformVersion {
     if ([[self class] isPlatformCompatibilityEnabled]) {
         return @"v1.0";
@@ -95,118 +473,92 @@ static BOOL g_enableLegacyGraphAPI = NO;
     }
 }
 
-+ (NSString *)appVersion {
-    if (!g_appVersion) {
-        g_appVersion = [[[NSBundle mainBundle] objectForInfoDictionaryKey:FBPLISTAppVersionKey] copy];
++ (FBSettingsSnapshot *)snapshot {
+    FBSettingsSnapshot *snapshot = g_snapshot;
+    if (!snapshot) {
+        @synchronized ([FBSettings class]) {
+            snapshot = g_snapshot ?: FBSettingsPublishSnapshot();
+        }
     }
-    return g_appVersion;
+    return snapshot;
+}
+
++ (NSString *)appVersion {
+    return [FBSettings snapshot].appVersion;
 }
 
 + (void)setAppVersion:(NSString *)appVersion {
-    if (![g_appVersion isEqualToString:appVersion]) {
-        [g_appVersion release];
-        g_appVersion = [appVersion copy];
-    }
+    FBSettingsUpdateString(&g_appVersion, appVersion);
 }
 
 + (NSString *)clientToken {
-    if (!g_clientToken) {
-        g_clientToken = [[[NSBundle mainBundle] objectForInfoDictionaryKey:FBPLISTClientTokenKey] copy];
-    }
-    return g_clientToken;
+    return [FBSettings snapshot].clientToken;
 }
 
 + (void)setClientToken:(NSString *)clientToken {
-    if (![g_clientToken isEqualToString:clientToken]) {
-        [g_clientToken release];
-        g_clientToken = [clientToken copy];
-    }
+    FBSettingsUpdateString(&g_clientToken, clientToken);
 }
 
 + (NSString *)defaultAppID {
-    if (!g_defaultAppID) {
-        g_defaultAppID = [[[NSBundle mainBundle] objectForInfoDictionaryKey:FBPLISTAppIDKey] copy];
-    }
-    return g_defaultAppID;
+    return [FBSettings snapshot].appID;
 }
 
 + (void)setDefaultAppID:(NSString *)appID {
-    if (![g_defaultAppID isEqualToString:appID]) {
-        [g_defaultAppID release];
-        g_defaultAppID = [appID copy];
-    }
+    FBSettingsUpdateString(&g_defaultAppID, appID);
 }
 
 + (NSString *)defaultDisplayName {
-    if (!g_defaultDisplayName) {
-        g_defaultDisplayName = [[[NSBundle mainBundle] objectForInfoDictionaryKey:FBPLISTDisplayNameKey] copy];
-    }
-    return g_defaultDisplayName;
+    return [FBSettings snapshot].displayName;
 }
 
 + (void)setDefaultDisplayName:(NSString *)displayName {
-    if (![g_defaultDisplayName isEqualToString:displayName]) {
-        [g_defaultDisplayName release];
-        g_defaultDisplayName = [displayName copy];
-    }
+    FBSettingsUpdateString(&g_defaultDisplayName, displayName);
 }
 
 + (CGFloat)defaultJPEGCompressionQuality {
-    return g_defaultJPEGCompressionQuality;
+    return [FBSettings snapshot].JPEGCompressionQuality;
 }
 
 + (void)setdefaultJPEGCompressionQuality:(CGFloat)compressionQuality {
-    g_defaultJPEGCompressionQuality = compressionQuality;
+    @synchronized ([FBSettings class]) {
+        if (g_defaultJPEGCompressionQuality != compressionQuality) {
+            g_defaultJPEGCompressionQuality = compressionQuality;
+            FBSettingsPublishSnapshot();
+        }
+    }
 }
 
 + (NSString *)defaultUrlSchemeSuffix {
-    if (!g_defaultUrlSchemeSuffix) {
-        g_defaultUrlSchemeSuffix = [[[NSBundle mainBundle] objectForInfoDictionaryKey:FBPLISTUrlSchemeSuffixKey] copy];
-    }
-    return g_defaultUrlSchemeSuffix;
+    return [FBSettings snapshot].urlSchemeSuffix;
 }
 
 + (void)setDefaultUrlSchemeSuffix:(NSString *)urlSchemeSuffix {
-    if (![g_defaultUrlSchemeSuffix isEqualToString:urlSchemeSuffix]) {
-        [g_defaultUrlSchemeSuffix release];
-        g_defaultUrlSchemeSuffix = [urlSchemeSuffix copy];
-    }
+    FBSettingsUpdateString(&g_defaultUrlSchemeSuffix, urlSchemeSuffix);
 }
 
 + (NSString *)facebookDomainPart {
-    if (!g_facebookDomainPart) {
-        g_facebookDomainPart = [[[NSBundle mainBundle] objectForInfoDictionaryKey:FBPLISTDomainPartKey] copy];
-    }
-    return g_facebookDomainPart;
+    return [FBSettings snapshot].facebookDomainPart;
 }
 
 + (void)setFacebookDomainPart:(NSString *)facebookDomainPart
 {
-    if (![g_facebookDomainPart isEqualToString:facebookDomainPart]) {
-        [g_facebookDomainPart release];
-        g_facebookDomainPart = [facebookDomainPart copy];
-    }
+    FBSettingsUpdateString(&g_facebookDomainPart, facebookDomainPart);
 }
 
 + (NSSet *)loggingBehavior {
-    if (!g_loggingBehavior) {
-        NSArray *bundleLoggingBehaviors = [[NSBundle mainBundle] objectForInfoDictionaryKey:FBPLISTLoggingBehaviorKey];
-        if (bundleLoggingBehaviors) {
-            g_loggingBehavior = [[NSSet alloc] initWithArray:bundleLoggingBehaviors];
-        } else {
-            // Establish set of default enabled logging behaviors.  You can completely disable logging by
-            // specifying an empty array for FacebookLoggingBehavior in your Info.plist.
-            g_loggingBehavior = [[NSSet alloc] initWithObjects:FBLoggingBehaviorDeveloperErrors, nil];
-        }
-    }
-    return g_loggingBehavior;
+    return [FBSettings snapshot].loggingBehavior;
 }
 
 + (void)setLoggingBehavior:(NSSet *)loggingBehavior {
-    if (![g_loggingBehavior isEqualToSet:loggingBehavior]) {
+    @synchronized ([FBSettings class]) {
+        if ([g_loggingBehavior isEqualToSet:loggingBehavior]) {
+            return;
+        }
         [g_loggingBehavior release];
         g_loggingBehavior = [loggingBehavior copy];
+        FBSettingsPublishSnapshot();
     }
+    [FBLogger loggingBehaviorsDidChange];
 }
 
 + (NSString *)resourceBundleName {
@@ -260,7 +612,11 @@ static BOOL g_enableLegacyGraphAPI = NO;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 + (void)autoPublishInstall:(NSString *)appID {
-    if ([FBSettings shouldAutoPublishInstall]) {
+    FBStartupProfilerMeasure("FBSettings autoPublishInstall:");
+    // Without an app ID there is nothing to publish yet, so leave the once token for a
+    // later call that has one, such as a session created with an explicit app ID.
+    appID = appID ?: [FBSettings defaultAppID];
+    if (appID && [FBSettings shouldAutoPublishInstall]) {
         dispatch_once(&g_publishInstallOnceToken, ^{
             // dispatch_once is great, but not re-entrant.  Inside publishInstall we use FBRequest, which will
             // cause this function to get invoked a second time.  By scheduling the work, we can sidestep the problem.
@@ -357,19 +713,18 @@ static BOOL g_enableLegacyGraphAPI = NO;
         NSString *responseKey = [NSString stringWithFormat:FBLastInstallResponse, appID, nil];
 
         NSDate *lastPing = [defaults objectForKey:pingKey];
-        id lastResponseData = [defaults objectForKey:responseKey];
-
-        NSString *attributionID = [FBUtility attributionID];
-        NSString *advertiserID = [FBUtility advertiserID];
 
         if (lastPing) {
-            // Short circuit
+            // Short circuit, before we go looking for the attribution and advertiser IDs
             if (handler) {
-                handler(lastResponseData, nil);
+                handler([defaults objectForKey:responseKey], nil);
             }
             return;
         }
 
+        NSString *attributionID = [FBUtility attributionID];
+        NSString *advertiserID = [FBUtility advertiserID];
+
         if (!(attributionID || advertiserID)) {
             if (handler) {
                 handler(
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+#import "FBSDKMacros.h"
+
+// Define FB_STARTUP_PROFILER_ENABLED to 0 to compile the startup measurements out entirely.
+#ifndef FB_STARTUP_PROFILER_ENABLED
+#define FB_STARTUP_PROFILER_ENABLED 1
+#endif
+
+// Non-zero while profiling is on, so a measurement that isn't wanted is a single load and branch.
+FBSDK_EXTERN volatile int32_t g_FBStartupProfilerActive;
+
+typedef struct {
+    const char *name;
+    NSTimeInterval startTime;
+} FBStartupProfilerScope;
+
+FBSDK_EXTERN FBStartupProfilerScope FBStartupProfilerScopeBegin(const char *name);
+FBSDK_EXTERN void FBStartupProfilerScopeEnd(FBStartupProfilerScope *scope);
+
+// Adds the time from here to the end of the enclosing scope to the startup profile, under `name`,
+// which must be a string literal. Meant for one-time setup: +initialize, singletons and the like.
+#if FB_STARTUP_PROFILER_ENABLED
+#define FBStartupProfilerMeasure(name) \
+    FBStartupProfilerScope fb_startupProfilerScope__ __attribute__((cleanup(FBStartupProfilerScopeEnd), unused)) = \
+        FBStartupProfilerScopeBegin(name)
+#else
+#define FBStartupProfilerMeasure(name) do { } while (0)
+#endif
+
+/*!
+ @class FBStartupProfiler
+
+ @abstract
+ Adds up the time the SDK's one-time setup takes, and which threads it runs on, so the SDK's share
+ of app launch can be budgeted.
+
+ @unsorted
+ */
+@interface FBStartupProfiler : NSObject
+
++ (BOOL)isEnabled;
++ (void)setEnabled:(BOOL)enabled;
+
+// Maps each measured name to a dictionary of the FBStartupProfile*Key values
++ (NSDictionary *)profile;
++ (void)reset;
+
+@end
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBStartupProfiler.h"
+
+#import <pthread.h>
+#import <libkern/OSAtomic.h>
+
+#import "FBLogger.h"
+#import "FBSettings.h"
+#import "FBUtility.h"
+
+NSString *const FBStartupProfileCountKey = @"count";
+NSString *const FBStartupProfileDurationKey = @"duration";
+NSString *const FBStartupProfileMainThreadDurationKey = @"mainThreadDuration";
+NSString *const FBStartupProfileStartKey = @"start";
+NSString *const FBStartupProfileThreadKey = @"thread";
+
+volatile int32_t g_FBStartupProfilerActive = 0;
+
+// When profiling was turned on; starts are reported relative to it
+static NSTimeInterval g_enabledTime = 0;
+// Guarded by @synchronized ([FBStartupProfiler class])
+static NSMutableDictionary *g_profile = nil;
+
+// The main thread, or else the queue or thread the work ran on, as the profile names it
+static NSString *FBStartupProfilerCurrentThreadName(void) {
+    if (pthread_main_np()) {
+        return @"main";
+    }
+    const char *label = dispatch_queue_get_label(DISPATCH_CURRENT_QUEUE_LABEL);
+    if (label && *label) {
+        return [NSString stringWithUTF8String:label];
+    }
+    NSString *threadName = [[NSThread currentThread] name];
+    return threadName.length ? threadName : [NSString stringWithFormat:@"thread %p", [NSThread currentThread]];
+}
+
+FBStartupProfilerScope FBStartupProfilerScopeBegin(const char *name) {
+    FBStartupProfilerScope scope = { name, 0 };
+    if (g_FBStartupProfilerActive) {
+        scope.startTime = [FBUtility monotonicTime];
+    }
+    return scope;
+}
+
+void FBStartupProfilerScopeEnd(FBStartupProfilerScope *scope) {
+    if (scope->startTime == 0) {
+        return;
+    }
+
+    NSTimeInterval duration = [FBUtility monotonicTime] - scope->startTime;
+    BOOL mainThread = pthread_main_np() != 0;
+    NSString *name = [NSString stringWithUTF8String:scope->name];
+    NSString *threadName = FBStartupProfilerCurrentThreadName();
+
+    @synchronized ([FBStartupProfiler class]) {
+        if (!g_FBStartupProfilerActive) {
+            return;
+        }
+        NSMutableDictionary *entry = [g_profile objectForKey:name];
+        if (!entry) {
+            // The first run is the one that counts toward launch, so its start and thread are kept
+            entry = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+                     [NSNumber numberWithDouble:scope->startTime - g_enabledTime], FBStartupProfileStartKey,
+                     threadName, FBStartupProfileThreadKey,
+                     nil];
+            [g_profile setObject:entry forKey:name];
+        }
+        NSUInteger count = [[entry objectForKey:FBStartupProfileCountKey] unsignedIntegerValue] + 1;
+        [entry setObject:[NSNumber numberWithUnsignedInteger:count] forKey:FBStartupProfileCountKey];
+        [entry setObject:[NSNumber numberWithDouble:[[entry objectForKey:FBStartupProfileDurationKey] doubleValue] + duration]
+                  forKey:FBStartupProfileDurationKey];
+        [entry setObject:[NSNumber numberWithDouble:[[entry objectForKey:FBStartupProfileMainThreadDurationKey] doubleValue] +
+                          (mainThread ? duration : 0)]
+                  forKey:FBStartupProfileMainThreadDurationKey];
+    }
+
+    [FBLogger singleShotLogEntry:FBLoggingBehaviorPerformanceCharacteristics
+                    formatString:@"FBStartupProfiler: %@ took %.2f ms on %@", name, duration * 1000, threadName];
+}
+
+@implementation FBStartupProfiler
+
++ (BOOL)isEnabled {
+    return g_FBStartupProfilerActive != 0;
+}
+
++ (void)setEnabled:(BOOL)enabled {
+    @synchronized (self) {
+        if (enabled == (g_FBStartupProfilerActive != 0)) {
+            return;
+        }
+        if (enabled) {
+            g_enabledTime = [FBUtility monotonicTime];
+            if (!g_profile) {
+                g_profile = [[NSMutableDictionary alloc] init];
+            }
+        }
+        OSAtomicCompareAndSwap32Barrier(!enabled, enabled, &g_FBStartupProfilerActive);
+    }
+}
+
++ (NSDictionary *)profile {
+    NSMutableDictionary *profile = [NSMutableDictionary dictionary];
+    @synchronized (self) {
+        for (NSString *name in g_profile) {
+            [profile setObject:[[[g_profile objectForKey:name] copy] autorelease] forKey:name];
+        }
+    }
+    return profile;
+}
+
++ (void)reset {
+    @synchronized (self) {
+        [g_profile removeAllObjects];
+        g_enabledTime = [FBUtility monotonicTime];
+    }
+}
+
+@end
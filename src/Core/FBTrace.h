@@ -0,0 +1,66 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+#import "FBSDKMacros.h"
+#import "FBSettings.h"
+
+// Define FB_TRACE_ENABLED to 0 to compile out the SDK's trace points entirely.
+#ifndef FB_TRACE_ENABLED
+#define FB_TRACE_ENABLED 1
+#endif
+
+// Non-zero while tracing is on. The macros read it directly, so a trace point
+// that isn't being traced is a single load and branch.
+FBSDK_EXTERN volatile int32_t g_FBTraceActive;
+
+FBSDK_EXTERN void FBTraceEmit(FBTracePoint point, BOOL begin, uintptr_t identifier);
+
+// Marks the begin and end of a phase. `identifier` pairs the two up when phases
+// of the same kind overlap; usually the object doing the work.
+#define FBTraceBegin(point, identifier) \
+    do { \
+        if (FB_TRACE_ENABLED && g_FBTraceActive) { \
+            FBTraceEmit((point), YES, (uintptr_t)(identifier)); \
+        } \
+    } while (0)
+
+#define FBTraceEnd(point, identifier) \
+    do { \
+        if (FB_TRACE_ENABLED && g_FBTraceActive) { \
+            FBTraceEmit((point), NO, (uintptr_t)(identifier)); \
+        } \
+    } while (0)
+
+/*!
+ @class FBTrace
+
+ @abstract
+ Emits the SDK's trace points as signposts, and to an optional handler.
+
+ @unsorted
+ */
+@interface FBTrace : NSObject
+
++ (BOOL)isEnabled;
++ (void)setEnabled:(BOOL)enabled;
+
++ (FBTraceHandler)handler;
++ (void)setHandler:(FBTraceHandler)handler;
+
+@end
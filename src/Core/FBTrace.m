@@ -0,0 +1,90 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBTrace.h"
+
+#import <dlfcn.h>
+#import <libkern/OSAtomic.h>
+
+// Signature of kdebug_signpost_start and kdebug_signpost_end. They're looked up
+// at runtime so the SDK still links, and traces to the handler, on OS versions
+// without them.
+typedef int (*FBTraceSignpostFunction)(uint32_t code, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t arg4);
+
+// Number of colors the Points of Interest instrument cycles through.
+static const uintptr_t FBTraceSignpostColorCount = 4;
+
+volatile int32_t g_FBTraceActive = 0;
+
+static FBTraceSignpostFunction g_signpostStart = NULL;
+static FBTraceSignpostFunction g_signpostEnd = NULL;
+static FBTraceHandler g_traceHandler = nil;
+
+static void FBTraceLoadSignposts(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        g_signpostStart = (FBTraceSignpostFunction)dlsym(RTLD_DEFAULT, "kdebug_signpost_start");
+        g_signpostEnd = (FBTraceSignpostFunction)dlsym(RTLD_DEFAULT, "kdebug_signpost_end");
+    });
+}
+
+void FBTraceEmit(FBTracePoint point, BOOL begin, uintptr_t identifier) {
+    FBTraceSignpostFunction signpost = begin ? g_signpostStart : g_signpostEnd;
+    if (signpost) {
+        signpost((uint32_t)point, identifier, 0, 0, point % FBTraceSignpostColorCount);
+    }
+
+    FBTraceHandler handler = nil;
+    @synchronized ([FBTrace class]) {
+        handler = [g_traceHandler retain];
+    }
+    if (handler) {
+        handler(point, begin, identifier);
+        [handler release];
+    }
+}
+
+@implementation FBTrace
+
++ (BOOL)isEnabled {
+    return g_FBTraceActive != 0;
+}
+
++ (void)setEnabled:(BOOL)enabled {
+    if (enabled) {
+        FBTraceLoadSignposts();
+    }
+    g_FBTraceActive = enabled ? 1 : 0;
+    OSMemoryBarrier();
+}
+
++ (FBTraceHandler)handler {
+    @synchronized (self) {
+        return [[g_traceHandler retain] autorelease];
+    }
+}
+
++ (void)setHandler:(FBTraceHandler)handler {
+    @synchronized (self) {
+        if (handler != g_traceHandler) {
+            [g_traceHandler release];
+            g_traceHandler = [handler copy];
+        }
+    }
+}
+
+@end
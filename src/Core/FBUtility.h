@@ -34,13 +34,23 @@ typedef enum FBAdvertisingTrackingStatus {
 @interface FBUtility : NSObject
 
 + (NSDictionary *)queryParamsDictionaryFromFBURL:(NSURL *)url;
+// While block runs, calls on this thread to queryParamsDictionaryFromFBURL: for url parse it only
+// the first time, and later ones get a copy.  Nothing about url is kept once block returns.
++ (void)parseQueryParamsOnceForURL:(NSURL *)url during:(void (^)(void))block;
 + (NSDictionary *)dictionaryByParsingURLQueryPart:(NSString *)encodedString;
 + (NSString *)stringBySerializingQueryParameters:(NSDictionary *)queryParameters;
+// Same serialization as stringBySerializingQueryParameters:, written straight onto the end of data.
+// NSData values are taken to be UTF-8 and escaped byte for byte.
++ (void)appendSerializedQueryParameters:(NSDictionary *)queryParameters toData:(NSMutableData *)data;
 + (NSString *)stringByURLDecodingString:(NSString *)escapedString;
 + (NSString *)stringByURLEncodingString:(NSString *)unescapedString;
+// Same escaping as stringByURLEncodingString:, written straight onto the end of data
++ (void)appendURLEncodedString:(NSString *)unescapedString toData:(NSMutableData *)data;
 + (id<FBGraphObject>)graphObjectInArray:(NSArray *)array withSameIDAs:(id<FBGraphObject>)item;
 
 + (unsigned long)currentTimeInMilliseconds;
+// Seconds on a monotonic clock, for measuring durations
++ (NSTimeInterval)monotonicTime;
 + (NSTimeInterval)randomTimeInterval:(NSTimeInterval)minValue withMaxValue:(NSTimeInterval)maxValue;
 + (void)centerView:(UIView *)view tableView:(UITableView *)tableView;
 + (NSString *)stringFBIDFromObject:(id)object;
@@ -64,6 +74,8 @@ typedef enum FBAdvertisingTrackingStatus {
 // Only returns nil if no settings have been fetched; otherwise it returns the last fetched settings.
 // If the settings are stale, an async request will be issued to fetch them.
 + (FBFetchedAppSettings *)fetchedAppSettings;
+// Picks up the settings kept from an earlier launch, if any, without going to the server.  Main thread only.
++ (void)loadPersistedAppSettings:(NSString *)appID;
 + (NSString *)attributionID;
 + (NSString *)advertiserID;
 + (FBAdvertisingTrackingStatus)advertisingTrackingStatus;
@@ -77,6 +89,28 @@ typedef enum FBAdvertisingTrackingStatus {
                 writingOptions:(NSJSONWritingOptions)writingOptions;
 + (id)simpleJSONDecode:(NSString *)jsonEncoding
                  error:(NSError **)error;
+// Encodes straight to UTF-8 bytes, without an intermediate NSString
++ (NSData *)simpleJSONEncodeToData:(id)data
+                             error:(NSError **)error;
+// Decodes straight from UTF-8 bytes, without an intermediate NSString
++ (id)simpleJSONDecodeData:(NSData *)data
+                     error:(NSError **)error;
+// JPEG encodes an image for upload, first scaling it down to
+// +[FBSettings maximumUploadImageDimension] and at the quality picked by
+// +[FBSettings isAdaptiveJPEGQualityEnabled].  Safe to call off the main thread.
++ (NSData *)JPEGDataForUploadImage:(UIImage *)image;
+// JPEG encodes the images with JPEGDataForUploadImage:, spread across
+// all cores.  The results are in the same order as the images, with NSNull for
+// any image that failed to encode.  The asynchronous variant does the encoding
+// on a background queue and calls back on the main thread.
++ (NSArray *)JPEGDataForImages:(NSArray *)images;
++ (void)JPEGDataForImages:(NSArray *)images
+               completion:(void (^)(NSArray *imageData))completion;
+// gzip compresses the data, for use with a "Content-Encoding: gzip" header.
+// Returns nil if zlib fails.
++ (NSData *)gzipData:(NSData *)data;
+// Reverses gzipData:.  Returns nil if the data isn't complete, valid gzip.
++ (NSData *)gunzipData:(NSData *)data;
 + (BOOL)isRetinaDisplay;
 + (NSString *)newUUIDString;
 + (BOOL)isRegisteredURLScheme:(NSString *)urlScheme;
@@ -87,6 +121,10 @@ typedef enum FBAdvertisingTrackingStatus {
 + (NSString *)buildFacebookUrlWithPre:(NSString *)pre
                                  post:(NSString *)post
                               version:(NSString *)version;
+// The same as buildFacebookUrlWithPre:post:version: with no post, so without a
+// trailing slash.  The result is cached, so asking for it again is cheap.
++ (NSString *)facebookURLPrefixWithPre:(NSString *)pre
+                               version:(NSString *)version;
 + (BOOL)isMultitaskingSupported;
 + (BOOL)isSystemAccountStoreAvailable;
 + (void)deleteFacebookCookies;
@@ -19,19 +19,33 @@
 #import "FBUtility.h"
 #import "FBGraphObject.h"
 #import "FBLogger.h"
+#import "FBMetrics.h"
 #import "FBRequest+Internal.h"
 #import "FBRequestConnection+Internal.h"
 #import "FBSession.h"
 #import "FBDynamicFrameworkLoader.h"
+#import "FBDispatch.h"
 #import "FBSettings+Internal.h"
 
 #import <AdSupport/AdSupport.h>
+#include <mach/mach_time.h>
 #include <sys/time.h>
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 static const double APPSETTINGS_STALE_THRESHOLD_SECONDS = 60 * 60; // one hour.
+static const double APPSETTINGS_PERSISTED_MAX_AGE_SECONDS = 60 * 60 * 24 * 7; // one week.
 static FBFetchedAppSettings *g_fetchedAppSettings = nil;
 static NSError *g_fetchedAppSettingsError = nil;
 static NSDate *g_fetchedAppSettingsTimestamp = nil;
+static BOOL g_fetchedAppSettingsRefreshInFlight = NO;
+
+static NSString *const kAppSettingsPersistKey = @"com.facebook.sdk:FBFetchedAppSettings";
+static NSString *const kAppSettingsPersistKeyAppID = @"appID";
+static NSString *const kAppSettingsPersistKeyTimestamp = @"timestamp";
+static NSString *const kAppSettingsPersistKeySettings = @"settings";
 
 static const NSString *kAppSettingsFieldAppName = @"name";
 static const NSString *kAppSettingsFieldSupportsAttribution = @"supports_attribution";
@@ -39,9 +53,262 @@ static const NSString *kAppSettingsFieldSupportsImplicitLogging = @"supports_imp
 static const NSString *kAppSettingsFieldEnableLoginTooltip = @"gdpv4_nux_enabled";
 static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_content";
 
+// Window bits asking deflate for a gzip rather than zlib wrapper
+static const int kGzipWindowBits = 15 + 16;
+
+static const char kHexDigits[] = "0123456789ABCDEF";
+
+// Adaptive JPEG quality steps down this much per doubling of the pixel count
+// above kAdaptiveJPEGQualityBasePixels, but never below kAdaptiveJPEGQualityFloor
+static const double kAdaptiveJPEGQualityBasePixels = 1024 * 1024;
+static const CGFloat kAdaptiveJPEGQualityStep = 0.05;
+static const CGFloat kAdaptiveJPEGQualityFloor = 0.6;
+
+// Draws the image into a bitmap no larger than maxDimension on either side.  The
+// pixels stay in the CGImage's own orientation, which the result carries so the
+// JPEG is tagged the same way as the original.  Returns the image itself if it
+// already fits, and nil if drawing fails.
+static UIImage *FBUtilityScaledImage(UIImage *image, NSUInteger maxDimension) {
+    CGImageRef cgImage = image.CGImage;
+    if (!cgImage || maxDimension == 0) {
+        return image;
+    }
+    size_t width = CGImageGetWidth(cgImage);
+    size_t height = CGImageGetHeight(cgImage);
+    size_t longest = MAX(width, height);
+    if (longest <= maxDimension) {
+        return image;
+    }
+
+    double scale = (double)maxDimension / longest;
+    size_t scaledWidth = MAX((size_t)1, (size_t)round(width * scale));
+    size_t scaledHeight = MAX((size_t)1, (size_t)round(height * scale));
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    // JPEG has no alpha, so skip it to keep the bitmap smaller
+    CGContextRef context = CGBitmapContextCreate(NULL, scaledWidth, scaledHeight, 8, 0, colorSpace,
+                                                 kCGBitmapByteOrder32Little | kCGImageAlphaNoneSkipFirst);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        return nil;
+    }
+    CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
+    CGContextDrawImage(context, CGRectMake(0, 0, scaledWidth, scaledHeight), cgImage);
+    CGImageRef scaledImage = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    if (!scaledImage) {
+        return nil;
+    }
+    UIImage *result = [UIImage imageWithCGImage:scaledImage scale:1 orientation:image.imageOrientation];
+    CGImageRelease(scaledImage);
+    return result;
+}
+
+static CGFloat FBUtilityAdaptiveJPEGQuality(CGFloat quality, UIImage *image) {
+    CGImageRef cgImage = image.CGImage;
+    double pixels = cgImage ? (double)CGImageGetWidth(cgImage) * CGImageGetHeight(cgImage) : 0;
+    if (pixels <= kAdaptiveJPEGQualityBasePixels) {
+        return quality;
+    }
+    CGFloat adapted = quality - kAdaptiveJPEGQualityStep * log2(pixels / kAdaptiveJPEGQualityBasePixels);
+    return MAX(adapted, MIN(quality, kAdaptiveJPEGQualityFloor));
+}
+
+// Base URLs come from a handful of (prefix, domain part, version) combinations,
+// so the last few composed are kept rather than rebuilt for every request.
+// Guarded by @synchronized ([FBUtility class]).
+typedef struct {
+    NSString *pre;
+    NSString *domainPart;
+    NSString *version;
+    NSString *url;
+} FBUtilityURLPrefix;
+static const NSUInteger kURLPrefixCacheSize = 8;
+static FBUtilityURLPrefix g_urlPrefixes[kURLPrefixCacheSize];
+static NSUInteger g_nextURLPrefix = 0;
+
+static BOOL FBUtilityStringsEqual(NSString *a, NSString *b) {
+    return a == b || (a && b && [a isEqualToString:b]);
+}
+
+// Returns pre, the Facebook domain with any domain part, and "/" followed by
+// version when it isn't empty
+static NSString *FBUtilityURLPrefixFor(NSString *pre, NSString *domainPart, NSString *version) {
+    @synchronized ([FBUtility class]) {
+        for (NSUInteger i = 0; i < kURLPrefixCacheSize; i++) {
+            FBUtilityURLPrefix *entry = &g_urlPrefixes[i];
+            if (entry->url &&
+                FBUtilityStringsEqual(entry->pre, pre) &&
+                FBUtilityStringsEqual(entry->domainPart, domainPart) &&
+                FBUtilityStringsEqual(entry->version, version)) {
+                return [[entry->url retain] autorelease];
+            }
+        }
+
+        NSString *domain = domainPart ? [NSString stringWithFormat:@"%@.%@", domainPart, FB_BASE_URL] : FB_BASE_URL;
+        NSString *url = [NSString stringWithFormat:@"%@%@%@%@", pre, domain, version.length ? @"/" : @"", version];
+
+        FBUtilityURLPrefix *entry = &g_urlPrefixes[g_nextURLPrefix];
+        g_nextURLPrefix = (g_nextURLPrefix + 1) % kURLPrefixCacheSize;
+        [entry->pre release];
+        [entry->domainPart release];
+        [entry->version release];
+        [entry->url release];
+        entry->pre = [pre copy];
+        entry->domainPart = [domainPart copy];
+        entry->version = [version copy];
+        entry->url = [url retain];
+        return url;
+    }
+}
+
+// Bytes that appendURLEncodedString:toData: passes through; everything else is
+// percent escaped, which matches what stringByURLEncodingString: produces
+static BOOL FBUtilityIsUnescapedURLByte(unsigned char byte) {
+    static BOOL table[256];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (int c = 'a'; c <= 'z'; c++) {
+            table[c] = YES;
+        }
+        for (int c = 'A'; c <= 'Z'; c++) {
+            table[c] = YES;
+        }
+        for (int c = '0'; c <= '9'; c++) {
+            table[c] = YES;
+        }
+        table['-'] = table['_'] = table['.'] = table['~'] = YES;
+    });
+    return table[byte];
+}
+
+// Length of the leading run of bytes that need no escaping.  On 64-bit ARM this
+// classifies sixteen bytes per step, which covers most of an access token or ID.
+static size_t FBUtilityUnescapedURLPrefixLength(const unsigned char *bytes, size_t length) {
+    size_t i = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t caseBit = vdupq_n_u8(0x20);
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vld1q_u8(bytes + i);
+        uint8x16_t lower = vorrq_u8(v, caseBit);
+        uint8x16_t ok = vandq_u8(vcgeq_u8(lower, vdupq_n_u8('a')), vcleq_u8(lower, vdupq_n_u8('z')));
+        ok = vorrq_u8(ok, vandq_u8(vcgeq_u8(v, vdupq_n_u8('0')), vcleq_u8(v, vdupq_n_u8('9'))));
+        ok = vorrq_u8(ok, vceqq_u8(v, vdupq_n_u8('-')));
+        ok = vorrq_u8(ok, vceqq_u8(v, vdupq_n_u8('.')));
+        ok = vorrq_u8(ok, vceqq_u8(v, vdupq_n_u8('_')));
+        ok = vorrq_u8(ok, vceqq_u8(v, vdupq_n_u8('~')));
+        if (vminvq_u8(ok) != 0xFF) {
+            break;
+        }
+    }
+#endif
+    while (i < length && FBUtilityIsUnescapedURLByte(bytes[i])) {
+        i++;
+    }
+    return i;
+}
+
+// Percent escapes length bytes onto the end of data.  Returns NO, leaving data as it was,
+// if asciiOnly is set and a byte outside 7-bit ASCII turns up.
+static BOOL FBUtilityAppendURLEncodedBytes(const unsigned char *bytes, size_t length, BOOL asciiOnly, NSMutableData *data) {
+    NSUInteger start = data.length;
+    // every byte escapes to at most three
+    [data increaseLengthBy:length * 3];
+    char *out = (char *)data.mutableBytes + start;
+    char *cursor = out;
+    size_t i = 0;
+    while (i < length) {
+        size_t run = FBUtilityUnescapedURLPrefixLength(bytes + i, length - i);
+        memcpy(cursor, bytes + i, run);
+        cursor += run;
+        i += run;
+        if (i == length) {
+            break;
+        }
+        unsigned char byte = bytes[i++];
+        if (asciiOnly && byte >= 0x80) {
+            [data setLength:start];
+            return NO;
+        }
+        *cursor++ = '%';
+        *cursor++ = kHexDigits[byte >> 4];
+        *cursor++ = kHexDigits[byte & 0xF];
+    }
+    [data setLength:start + (cursor - out)];
+    return YES;
+}
+
+static NSArray *FBUtilityAppSettingsFields(void) {
+    return @[kAppSettingsFieldAppName, kAppSettingsFieldSupportsAttribution, kAppSettingsFieldSupportsImplicitLogging,
+             kAppSettingsFieldEnableLoginTooltip, kAppSettingsFieldLoginTooltipContent];
+}
+
+static void FBUtilitySetFetchedAppSettings(NSString *appID, NSDictionary *result, NSDate *timestamp) {
+    [g_fetchedAppSettingsTimestamp release];
+    [g_fetchedAppSettings release];
+
+    g_fetchedAppSettings = [[FBFetchedAppSettings alloc] initWithAppID:appID];
+    g_fetchedAppSettingsTimestamp = [timestamp retain];
+
+    g_fetchedAppSettings.serverAppName = result[kAppSettingsFieldAppName];
+    g_fetchedAppSettings.supportsAttribution = [result[kAppSettingsFieldSupportsAttribution] boolValue];
+    g_fetchedAppSettings.supportsImplicitSdkLogging = [result[kAppSettingsFieldSupportsImplicitLogging] boolValue];
+    g_fetchedAppSettings.enableLoginTooltip = [result[kAppSettingsFieldEnableLoginTooltip] boolValue];
+    g_fetchedAppSettings.loginTooltipContent = result[kAppSettingsFieldLoginTooltipContent];
+}
+
+// Keeps the fields we use, so the next launch can start from them instead of waiting on the server
+static void FBUtilityPersistAppSettings(NSString *appID, NSDictionary *result, NSDate *timestamp) {
+    NSMutableDictionary *settings = [NSMutableDictionary dictionary];
+    for (NSString *field in FBUtilityAppSettingsFields()) {
+        id value = result[field];
+        if ([value isKindOfClass:[NSString class]] || [value isKindOfClass:[NSNumber class]]) {
+            settings[field] = value;
+        }
+    }
+
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    [defaults setObject:@{ kAppSettingsPersistKeyAppID : appID,
+                           kAppSettingsPersistKeyTimestamp : [NSNumber numberWithDouble:[timestamp timeIntervalSince1970]],
+                           kAppSettingsPersistKeySettings : settings }
+                 forKey:kAppSettingsPersistKey];
+    [defaults synchronize];
+}
+
+// Seeds the in memory settings from the last launch's, if they were for this app and aren't too old.
+// They are likely stale, which gets them refreshed while they're being used.
+static void FBUtilityLoadPersistedAppSettings(NSString *appID) {
+    if (g_fetchedAppSettings || g_fetchedAppSettingsError || !appID.length) {
+        return;
+    }
+
+    NSDictionary *persisted = [[NSUserDefaults standardUserDefaults] dictionaryForKey:kAppSettingsPersistKey];
+    NSDictionary *settings = persisted[kAppSettingsPersistKeySettings];
+    NSDate *timestamp = [NSDate dateWithTimeIntervalSince1970:[persisted[kAppSettingsPersistKeyTimestamp] doubleValue]];
+    NSTimeInterval age = [[NSDate date] timeIntervalSinceDate:timestamp];
+    if (![persisted[kAppSettingsPersistKeyAppID] isEqual:appID] ||
+        ![settings isKindOfClass:[NSDictionary class]] ||
+        age < 0 ||
+        age > APPSETTINGS_PERSISTED_MAX_AGE_SECONDS) {
+        return;
+    }
+
+    FBUtilitySetFetchedAppSettings(appID, settings, timestamp);
+}
+
+// Thread dictionary key of the URL whose parameters are being parsed once, and what they parsed to
+static NSString *const FBUtilityParsedURLScopeKey = @"com.facebook.sdk:FBUtilityParsedURLScope";
+static NSString *const FBUtilityParsedURLKey = @"url";
+static NSString *const FBUtilityParsedURLParamsKey = @"params";
+
 @implementation FBUtility
 
 + (NSDictionary *)queryParamsDictionaryFromFBURL:(NSURL *)url {
+    NSMutableDictionary *scope = [[[NSThread currentThread] threadDictionary] objectForKey:FBUtilityParsedURLScopeKey];
+    BOOL inScope = url && [url isEqual:[scope objectForKey:FBUtilityParsedURLKey]];
+    if (inScope && [scope objectForKey:FBUtilityParsedURLParamsKey]) {
+        return [[[scope objectForKey:FBUtilityParsedURLParamsKey] mutableCopy] autorelease];
+    }
+
     // version 3.2.3 of the Facebook app encodes the parameters in the query but
     // version 3.3 and above encode the parameters in the fragment;
     // merge them together with fragment taking priority.
@@ -54,9 +321,36 @@ static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_conten
         [result addEntriesFromDictionary:[FBUtility dictionaryByParsingURLQueryPart:[url fragment]]];
     }
 
+    if (inScope) {
+        [scope setObject:[[result copy] autorelease] forKey:FBUtilityParsedURLParamsKey];
+    }
+
     return result;
 }
 
++ (void)parseQueryParamsOnceForURL:(NSURL *)url during:(void (^)(void))block {
+    if (!url) {
+        block();
+        return;
+    }
+
+    // Kept in the thread dictionary only while block runs; the URL may carry an access token
+    NSMutableDictionary *threadDictionary = [[NSThread currentThread] threadDictionary];
+    id outerScope = [[threadDictionary objectForKey:FBUtilityParsedURLScopeKey] retain];
+    [threadDictionary setObject:[NSMutableDictionary dictionaryWithObject:url forKey:FBUtilityParsedURLKey]
+                         forKey:FBUtilityParsedURLScopeKey];
+    @try {
+        block();
+    } @finally {
+        if (outerScope) {
+            [threadDictionary setObject:outerScope forKey:FBUtilityParsedURLScopeKey];
+        } else {
+            [threadDictionary removeObjectForKey:FBUtilityParsedURLScopeKey];
+        }
+        [outerScope release];
+    }
+}
+
 // finishes the parsing job that NSURL starts
 + (NSDictionary *)dictionaryByParsingURLQueryPart:(NSString *)encodedString {
 
@@ -89,32 +383,62 @@ static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_conten
 }
 
 + (NSString *)stringBySerializingQueryParameters:(NSDictionary *)queryParameters {
-    NSMutableString *queryString = [[[NSMutableString alloc] init] autorelease];
-    BOOL hasParameters = NO;
-    if (queryParameters) {
-        for (NSString *key in queryParameters) {
-            if (hasParameters) {
-                [queryString appendString:@"&"];
-            }
-            id value = queryParameters[key];
-            if ([value isKindOfClass:[NSString class]]) {
-                value = [FBUtility stringByURLEncodingString:value];
+    // the whole query is built as bytes in one buffer, sized for the common case up front
+    NSMutableData *query = [NSMutableData dataWithCapacity:queryParameters.count * 32];
+    [FBUtility appendSerializedQueryParameters:queryParameters toData:query];
+    return [[[NSString alloc] initWithData:query encoding:NSUTF8StringEncoding] autorelease];
+}
+
++ (void)appendSerializedQueryParameters:(NSDictionary *)queryParameters toData:(NSMutableData *)query {
+    BOOL first = YES;
+    for (NSString *key in queryParameters) {
+        if (!first) {
+            [query appendBytes:"&" length:1];
+        }
+        first = NO;
+        const char *keyBytes = [key description].UTF8String;
+        [query appendBytes:keyBytes length:strlen(keyBytes)];
+        [query appendBytes:"=" length:1];
+
+        id value = queryParameters[key];
+        if ([value isKindOfClass:[NSString class]]) {
+            [FBUtility appendURLEncodedString:value toData:query];
+        } else if ([value isKindOfClass:[NSData class]]) {
+            FBUtilityAppendURLEncodedBytes([(NSData *)value bytes], [(NSData *)value length], NO, query);
+        } else {
+            const char *valueBytes = [value description].UTF8String;
+            if (valueBytes) {
+                [query appendBytes:valueBytes length:strlen(valueBytes)];
             }
-            [queryString appendFormat:@"%@=%@", key, value];
-            hasParameters = YES;
         }
     }
-
-    return [[queryString copy] autorelease];
 }
 
 // the reverse of url encoding
 + (NSString *)stringByURLDecodingString:(NSString *)escapedString {
+    const char *ascii = CFStringGetCStringPtr((CFStringRef)escapedString, kCFStringEncodingASCII);
+    if (ascii && !strpbrk(ascii, "%+")) {
+        // nothing to decode
+        return [[escapedString copy] autorelease];
+    }
     return [[escapedString stringByReplacingOccurrencesOfString:@"+" withString:@" "]
             stringByReplacingPercentEscapesUsingEncoding:NSUTF8StringEncoding];
 }
 
 + (NSString *)stringByURLEncodingString:(NSString *)unescapedString {
+    const char *ascii = CFStringGetCStringPtr((CFStringRef)unescapedString, kCFStringEncodingASCII);
+    if (ascii) {
+        size_t length = strlen(ascii);
+        if (FBUtilityUnescapedURLPrefixLength((const unsigned char *)ascii, length) == length) {
+            return [[unescapedString copy] autorelease];
+        }
+        NSMutableData *data = [NSMutableData dataWithCapacity:length * 3];
+        if (FBUtilityAppendURLEncodedBytes((const unsigned char *)ascii, length, YES, data)) {
+            return [[[NSString alloc] initWithData:data encoding:NSASCIIStringEncoding] autorelease];
+        }
+    }
+
+    // anything beyond ASCII goes through CoreFoundation
     NSString *result = (NSString *)CFURLCreateStringByAddingPercentEscapes(
                                                                            kCFAllocatorDefault,
                                                                            (CFStringRef)unescapedString,
@@ -125,12 +449,31 @@ static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_conten
     return result;
 }
 
++ (void)appendURLEncodedString:(NSString *)unescapedString toData:(NSMutableData *)data {
+    const char *bytes = CFStringGetCStringPtr((CFStringRef)unescapedString, kCFStringEncodingUTF8);
+    if (!bytes) {
+        bytes = unescapedString.UTF8String;
+    }
+    if (bytes) {
+        FBUtilityAppendURLEncodedBytes((const unsigned char *)bytes, strlen(bytes), NO, data);
+    }
+}
+
 + (unsigned long)currentTimeInMilliseconds {
     struct timeval time;
     gettimeofday(&time, NULL);
     return (time.tv_sec * 1000) + (time.tv_usec / 1000);
 }
 
++ (NSTimeInterval)monotonicTime {
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    return (NSTimeInterval)mach_absolute_time() * timebase.numer / timebase.denom / NSEC_PER_SEC;
+}
+
 + (NSTimeInterval)randomTimeInterval:(NSTimeInterval)minValue withMaxValue:(NSTimeInterval)maxValue {
     return minValue + (maxValue - minValue) * (double)arc4random() / UINT32_MAX;
 }
@@ -235,12 +578,19 @@ static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_conten
 #pragma mark - permissions related
 
 + (BOOL)isPublishPermission:(NSString *)permission {
+    static NSSet *publishPermissions = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        publishPermissions = [[NSSet alloc] initWithObjects:
+                              @"ads_management",
+                              @"create_event",
+                              @"user_games_activity",
+                              @"rsvp_event",
+                              nil];
+    });
     return [permission hasPrefix:@"publish"] ||
     [permission hasPrefix:@"manage"] ||
-    [permission isEqualToString:@"ads_management"] ||
-    [permission isEqualToString:@"create_event"] ||
-    [permission isEqualToString:@"user_games_activity"] ||
-    [permission isEqualToString:@"rsvp_event"];
+    [publishPermissions containsObject:permission];
 }
 
 + (BOOL)areAllPermissionsReadPermissions:(NSArray *)permissions {
@@ -268,64 +618,81 @@ static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_conten
 // Make a call to the Graph API to get a variety of data for the app, and on completion, invoke the callback with
 // the result.  Cache the result for subsequent invocations.  Expect only to ever be called with one appID.  Results
 // with calling with a second appid are undefined (in reality will just return the previously requested app's results).
+//
+// The result is also persisted, and settings that are merely stale (including the last launch's) are handed to the
+// callback straight away while a refresh happens behind them.  Only with nothing cached does the callback wait on
+// the server.
 
 + (void)fetchAppSettings:(NSString *)appID
                 callback:(void (^)(FBFetchedAppSettings *, NSError *))callback {
-    if ([FBUtility isFetchedFBAppSettingsStale] || (!g_fetchedAppSettingsError && !g_fetchedAppSettings)) {
-
-        NSString *pingPath = [NSString stringWithFormat:@"%@?fields=%@",
-                              appID,
-                              [@[kAppSettingsFieldAppName, kAppSettingsFieldSupportsAttribution, kAppSettingsFieldSupportsImplicitLogging,
-                                 kAppSettingsFieldEnableLoginTooltip, kAppSettingsFieldLoginTooltipContent] componentsJoinedByString:@","]
-                              ];
-        FBRequest *pingRequest = [[[FBRequest alloc] initWithSession:nil graphPath:pingPath] autorelease];
-        pingRequest.skipClientToken = YES;
-        pingRequest.canCloseSessionOnError = NO;
-        [pingRequest startWithCompletionHandler:^(FBRequestConnection *connection, id result, NSError *error) {
-            [g_fetchedAppSettingsError release];
-            g_fetchedAppSettingsError = nil;
-
-            if (error) {
-                if (g_fetchedAppSettings) {
-                    // We have older app settings but the refresh received an error.
-                    // Log and ignore the error.
-                    [FBLogger singleShotLogEntry:FBLoggingBehaviorInformational formatString:@"fetchAppSettings refresh failed with %@", error];
-                } else {
-                    // Only set the error if we don't have previously fetched app settings.
-                    // (i.e., if we have app settings and a new call gets an error, we'll
-                    // ignore the error and surface the last successfully fetched settings).
-                    g_fetchedAppSettingsError = error;
-                    [g_fetchedAppSettingsError retain];
-                }
+    FBUtilityLoadPersistedAppSettings(appID);
+
+    if (!([FBUtility isFetchedFBAppSettingsStale] || (!g_fetchedAppSettingsError && !g_fetchedAppSettings))) {
+        [FBUtility callTheFetchAppSettingsCallback:callback];
+        return;
+    }
+
+    if (g_fetchedAppSettings) {
+        // Stale while revalidate
+        [FBUtility callTheFetchAppSettingsCallback:callback];
+        callback = nil;
+        if (g_fetchedAppSettingsRefreshInFlight) {
+            return;
+        }
+        g_fetchedAppSettingsRefreshInFlight = YES;
+    }
+
+    NSString *pingPath = [NSString stringWithFormat:@"%@?fields=%@",
+                          appID,
+                          [FBUtilityAppSettingsFields() componentsJoinedByString:@","]
+                          ];
+    FBRequest *pingRequest = [[[FBRequest alloc] initWithSession:nil graphPath:pingPath] autorelease];
+    pingRequest.skipClientToken = YES;
+    pingRequest.canCloseSessionOnError = NO;
+    FBRequestConnection *pingConnection = [[[FBRequestConnection alloc] init] autorelease];
+    pingConnection.networkFeature = FBNetworkFeatureAppSettings;
+    pingConnection.priority = FBRequestPriorityBackground;
+    [pingConnection addRequest:pingRequest completionHandler:^(FBRequestConnection *connection, id result, NSError *error) {
+        g_fetchedAppSettingsRefreshInFlight = NO;
+        [g_fetchedAppSettingsError release];
+        g_fetchedAppSettingsError = nil;
+
+        if (error) {
+            if (g_fetchedAppSettings) {
+                // We have older app settings but the refresh received an error.
+                // Log and ignore the error.
+                [FBLogger singleShotLogEntry:FBLoggingBehaviorInformational formatString:@"fetchAppSettings refresh failed with %@", error];
             } else {
-                if ([result respondsToSelector:@selector(objectForKey:)]) {
-                    [g_fetchedAppSettingsTimestamp release];
-                    [g_fetchedAppSettings release];
-
-                    g_fetchedAppSettings = [[FBFetchedAppSettings alloc] initWithAppID:appID];
-                    g_fetchedAppSettingsTimestamp = [[NSDate date] retain];
-
-                    g_fetchedAppSettings.serverAppName = result[kAppSettingsFieldAppName];
-                    g_fetchedAppSettings.supportsAttribution = [result[kAppSettingsFieldSupportsAttribution] boolValue];
-                    g_fetchedAppSettings.supportsImplicitSdkLogging = [result[kAppSettingsFieldSupportsImplicitLogging] boolValue];
-                    g_fetchedAppSettings.enableLoginTooltip = [result[kAppSettingsFieldEnableLoginTooltip] boolValue];
-                    g_fetchedAppSettings.loginTooltipContent = result[kAppSettingsFieldLoginTooltipContent];
-                }
+                // Only set the error if we don't have previously fetched app settings.
+                // (i.e., if we have app settings and a new call gets an error, we'll
+                // ignore the error and surface the last successfully fetched settings).
+                g_fetchedAppSettingsError = error;
+                [g_fetchedAppSettingsError retain];
             }
-            [FBUtility callTheFetchAppSettingsCallback:callback];
-        }];
-    } else {
+        } else {
+            if ([result respondsToSelector:@selector(objectForKey:)]) {
+                NSDate *now = [NSDate date];
+                FBUtilitySetFetchedAppSettings(appID, result, now);
+                FBUtilityPersistAppSettings(appID, result, now);
+            }
+        }
         [FBUtility callTheFetchAppSettingsCallback:callback];
-    }
+    }];
+    [pingConnection start];
 }
 
 + (FBFetchedAppSettings *)fetchedAppSettings {
+    FBUtilityLoadPersistedAppSettings([FBSettings defaultAppID]);
     if ([FBUtility isFetchedFBAppSettingsStale]) {
         [FBUtility fetchAppSettings:g_fetchedAppSettings.appID callback:nil];
     }
     return g_fetchedAppSettings;
 }
 
++ (void)loadPersistedAppSettings:(NSString *)appID {
+    FBUtilityLoadPersistedAppSettings(appID);
+}
+
 + (BOOL)isFetchedFBAppSettingsStale {
     return g_fetchedAppSettingsTimestamp && ([[NSDate date] timeIntervalSinceDate:g_fetchedAppSettingsTimestamp] > APPSETTINGS_STALE_THRESHOLD_SECONDS);
 }
@@ -437,14 +804,27 @@ static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_conten
     }
 }
 
++ (NSData *)simpleJSONEncodeToData:(id)data
+                             error:(NSError **)error {
+    if (data) {
+        return [NSJSONSerialization dataWithJSONObject:data options:0 error:error];
+    } else {
+        return nil;
+    }
+}
+
 + (id)simpleJSONDecode:(NSString *)jsonEncoding {
     return [FBUtility simpleJSONDecode:jsonEncoding error:nil];
 }
 
 + (id)simpleJSONDecode:(NSString *)jsonEncoding
                  error:(NSError **)error {
-    NSData *data = [jsonEncoding dataUsingEncoding:NSUTF8StringEncoding];
+    return [FBUtility simpleJSONDecodeData:[jsonEncoding dataUsingEncoding:NSUTF8StringEncoding]
+                                     error:error];
+}
 
++ (id)simpleJSONDecodeData:(NSData *)data
+                     error:(NSError **)error {
     if (data) {
         return [NSJSONSerialization JSONObjectWithData:data options:0 error:error];
     } else {
@@ -452,6 +832,112 @@ static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_conten
     }
 }
 
++ (NSData *)JPEGDataForUploadImage:(UIImage *)image {
+    NSData *data = nil;
+    // The scaled bitmap goes with the pool rather than outliving the encoding
+    @autoreleasepool {
+        UIImage *scaled = FBUtilityScaledImage(image, [FBSettings maximumUploadImageDimension]) ?: image;
+        CGFloat quality = [FBSettings defaultJPEGCompressionQuality];
+        if ([FBSettings isAdaptiveJPEGQualityEnabled]) {
+            quality = FBUtilityAdaptiveJPEGQuality(quality, scaled);
+        }
+        data = [UIImageJPEGRepresentation(scaled, quality) retain];
+    }
+    return [data autorelease];
+}
+
++ (NSArray *)JPEGDataForImages:(NSArray *)images {
+    NSUInteger count = images.count;
+    NSData **encoded = calloc(count, sizeof(NSData *));
+
+    // Each iteration only writes its own slot, so no locking is needed
+    dispatch_apply(count, FBDispatchGetGlobalQueue(FBDispatchLaneUtility), ^(size_t i) {
+        encoded[i] = [[FBUtility JPEGDataForUploadImage:[images objectAtIndex:i]] retain];
+    });
+
+    NSMutableArray *imageData = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        [imageData addObject:encoded[i] ?: [NSNull null]];
+        [encoded[i] release];
+    }
+    free(encoded);
+
+    return imageData;
+}
+
++ (void)JPEGDataForImages:(NSArray *)images
+               completion:(void (^)(NSArray *imageData))completion {
+    NSArray *imagesCopy = [[images copy] autorelease];
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneUserInteractive), ^{
+        NSArray *imageData = [FBUtility JPEGDataForImages:imagesCopy];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(imageData);
+        });
+    });
+}
+
++ (NSData *)gzipData:(NSData *)data {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (fbdfl_deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, kGzipWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return nil;
+    }
+
+    // Text payloads shrink a lot, so start at half the size and grow as needed
+    NSMutableData *compressed = [NSMutableData dataWithLength:MAX(data.length / 2, 64)];
+    stream.next_in = (Bytef *)data.bytes;
+    stream.avail_in = (uInt)data.length;
+
+    int status;
+    do {
+        if (stream.total_out >= compressed.length) {
+            [compressed increaseLengthBy:compressed.length];
+        }
+        stream.next_out = (Bytef *)compressed.mutableBytes + stream.total_out;
+        stream.avail_out = (uInt)(compressed.length - stream.total_out);
+        status = fbdfl_deflate(&stream, Z_FINISH);
+    } while (status == Z_OK);
+
+    fbdfl_deflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        return nil;
+    }
+
+    compressed.length = stream.total_out;
+    return compressed;
+}
+
++ (NSData *)gunzipData:(NSData *)data {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (fbdfl_inflateInit2(&stream, kGzipWindowBits) != Z_OK) {
+        return nil;
+    }
+
+    // Mirrors gzipData:, expecting text to expand a few times over
+    NSMutableData *decompressed = [NSMutableData dataWithLength:MAX(data.length * 4, 64)];
+    stream.next_in = (Bytef *)data.bytes;
+    stream.avail_in = (uInt)data.length;
+
+    int status;
+    do {
+        if (stream.total_out >= decompressed.length) {
+            [decompressed increaseLengthBy:decompressed.length];
+        }
+        stream.next_out = (Bytef *)decompressed.mutableBytes + stream.total_out;
+        stream.avail_out = (uInt)(decompressed.length - stream.total_out);
+        status = fbdfl_inflate(&stream, Z_NO_FLUSH);
+    } while (status == Z_OK);
+
+    fbdfl_inflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        return nil;
+    }
+
+    decompressed.length = stream.total_out;
+    return decompressed;
+}
+
 + (BOOL)isRetinaDisplay {
     // Check for displayLinkWithTarget:selector: since that is only available on iOS 4.0+
     // deal with edge case where scale returns 2.0 on a iPad running 3.2 with 2x
@@ -507,15 +993,7 @@ static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_conten
 + (NSString *)buildFacebookUrlWithPre:(NSString *)pre
                                  post:(NSString *)post
                               version:(NSString *)version {
-    // break-out domainPart, domain, version and post
-    NSString *domainPart = [FBSettings facebookDomainPart];
-    NSString *domain = FB_BASE_URL;
-
     version = version ?: [FBSettings platformVersion];
-    if (version.length) {
-        version = [NSString stringWithFormat:@"/%@", version];
-    }
-
     post = post ?: @"";
 
     if ([post length] > 2 &&
@@ -547,12 +1025,13 @@ static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_conten
         }
     }
 
-    // construct url
-    if (domainPart) {
-        domain = [NSString stringWithFormat:@"%@.%@", domainPart, FB_BASE_URL];
-    }
-    NSString *result = [NSString stringWithFormat:@"%@%@%@%@", pre, domain, version, post];
-    return result;
+    NSString *prefix = FBUtilityURLPrefixFor(pre, [FBSettings facebookDomainPart], version);
+    return post.length ? [prefix stringByAppendingString:post] : prefix;
+}
+
++ (NSString *)facebookURLPrefixWithPre:(NSString *)pre
+                               version:(NSString *)version {
+    return FBUtilityURLPrefixFor(pre, [FBSettings facebookDomainPart], version ?: [FBSettings platformVersion]);
 }
 
 + (BOOL)isMultitaskingSupported {
@@ -561,11 +1040,18 @@ static const NSString *kAppSettingsFieldLoginTooltipContent = @"gdpv4_nux_conten
 }
 
 + (BOOL)isSystemAccountStoreAvailable {
-    id accountStore = nil;
-    id accountTypeFB = nil;
+    // whether the OS supports the Facebook account type does not change while we run,
+    // and answering it means standing up an account store, so only do that once
+    static BOOL available = NO;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        id accountStore = nil;
+        id accountTypeFB = nil;
 
-    return (accountStore = [[[NSClassFromString(@"ACAccountStore") alloc] init] autorelease]) &&
-    (accountTypeFB = [accountStore accountTypeWithAccountTypeIdentifier:@"com.apple.facebook"]);
+        available = (accountStore = [[[NSClassFromString(@"ACAccountStore") alloc] init] autorelease]) &&
+        (accountTypeFB = [accountStore accountTypeWithAccountTypeIdentifier:@"com.apple.facebook"]);
+    });
+    return available;
 }
 
 + (void)deleteFacebookCookies {
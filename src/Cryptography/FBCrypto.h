@@ -50,4 +50,31 @@
  */
 - (NSData *)decrypt:(NSString *)base64EncodedCipherText additionalSignedData:(NSData *)additionalSignedData;
 
+/**
+ * Same as decrypt:additionalSignedData:, but hands the plain text to handler in fixed-size chunks as it is
+ * decrypted instead of collecting it.  Nothing is handed on if the MAC does not match.  Returns NO if
+ * decryption fails or handler returns NO.
+ */
+- (BOOL)decrypt:(NSString *)base64EncodedCipherText
+    additionalSignedData:(NSData *)additionalSignedData
+            chunkHandler:(BOOL (^)(const uint8_t *bytes, size_t length))handler;
+
+/**
+ * Same format as encrypt:additionalDataToSign:, before base64 encoding, but reads exactly plainTextLength bytes
+ * from plainTextStream in fixed-size chunks.  Apart from the returned data, memory use does not grow with the
+ * payload.  Returns nil if the stream ends early or fails.
+ */
+- (NSData *)encryptInputStream:(NSInputStream *)plainTextStream
+                        length:(NSUInteger)plainTextLength
+          additionalDataToSign:(NSData *)additionalDataToSign;
+
+/**
+ * Checks the MAC of cipherData, the unencoded form of what encrypt:additionalDataToSign: returns, and then
+ * decrypts it into outputStream in fixed-size chunks.  Returns NO without writing anything if the MAC does
+ * not match, or NO if decrypting or writing fails part way.
+ */
+- (BOOL)decryptData:(NSData *)cipherData
+    additionalSignedData:(NSData *)additionalSignedData
+          toOutputStream:(NSOutputStream *)outputStream;
+
 @end
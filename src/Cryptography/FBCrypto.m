@@ -24,6 +24,14 @@
 static const uint8_t kFB_CRYPTO_CURRENT_VERSION = 1;
 static const uint8_t kFB_CRYPTO_CURRENT_MASTER_KEY_LENGTH = 16;
 
+// How much plain or cipher text is worked on at once; a multiple of the AES block size
+static const size_t kFB_CRYPTO_CHUNK_LENGTH = 64 * 1024;
+
+static const size_t kFB_CRYPTO_HEADER_LENGTH = 1 + CC_SHA256_DIGEST_LENGTH + kCCBlockSizeAES128;
+
+// Hands plain text, or decrypted output, on in pieces.  Returns NO to stop.
+typedef BOOL (^FBCryptoChunkHandler)(const uint8_t *bytes, size_t length);
+
 static void FBWriteIntBigEndian(uint8_t *buffer, uint32_t value)
 {
     buffer[3] = (uint8_t)(value & 0xff);
@@ -51,6 +59,11 @@ static void blankData(NSData *data)
 @implementation FBCrypto {
     NSData *_encryptionKeyData;
     NSData *_macKeyData;
+    // keyed once, then copied for each message so the key schedule isn't redone
+    CCHmacContext _macKeyContext;
+    // one idle cryptor per direction, reset with each message's IV instead of being recreated
+    CCCryptorRef _idleEncryptor;
+    CCCryptorRef _idleDecryptor;
 }
 
 // Note: the following simple derivation function is NOT suitable for passwords or weak keys
@@ -90,6 +103,7 @@ static NSData *makeSubKey(uint8_t *key, size_t len, uint32_t idx)
         _encryptionKeyData = [makeSubKey(first+1, len-1, 1) retain];
         _macKeyData = [makeSubKey(first+1, len-1, 2) retain];
         blankData(masterKeyData);
+        CCHmacInit(&_macKeyContext, kCCHmacAlgSHA256, _macKeyData.bytes, _macKeyData.length);
         return self;
     } else {
         return nil;
@@ -115,12 +129,20 @@ static NSData *makeSubKey(uint8_t *key, size_t len, uint32_t idx)
     if ((self = [super init])) {
         _macKeyData = [FBDecodeBase64(macKey) retain];
         _encryptionKeyData = [FBDecodeBase64(encryptionKey) retain];
+        CCHmacInit(&_macKeyContext, kCCHmacAlgSHA256, _macKeyData.bytes, _macKeyData.length);
     }
     return self;
 }
 
 - (void)dealloc
 {
+    if (_idleEncryptor) {
+        CCCryptorRelease(_idleEncryptor);
+    }
+    if (_idleDecryptor) {
+        CCCryptorRelease(_idleDecryptor);
+    }
+    bzero(&_macKeyContext, sizeof(_macKeyContext));
     blankData(_encryptionKeyData);
     blankData(_macKeyData);
     [_encryptionKeyData release];
@@ -143,131 +165,321 @@ static NSData *makeSubKey(uint8_t *key, size_t len, uint32_t idx)
  *
  * [IV 16 bytes] . [length of ciphertext 4 bytes] . [ciphertext] . [length of additionalDataToSign, 4 bytes] . [additionalDataToSign])
  * length is written in big-endian
+ *
+ * The ciphertext is fed in separately, as it is produced or read, so it never needs to be copied into one buffer.
  */
-- (NSData *)_macForIV:(NSData *)IV cipherData:(NSData *)cipherData additionalDataToSign:(NSData *)additionalDataToSign
+- (void)_beginMAC:(CCHmacContext *)context IV:(const uint8_t *)IV cipherDataLength:(size_t)cipherDataLength
 {
-    NSAssert(cipherData.length <= INT_MAX, @"");
-    int cipherDataLength = (int)cipherData.length;
-
-    NSAssert(additionalDataToSign.length <= INT_MAX, @"");
-    int additionalDataToSignLength = (int)additionalDataToSign.length;
-
-    size_t macBufferLength = kCCBlockSizeAES128 + 4 + cipherData.length + 4 + additionalDataToSign.length;
-    uint8_t *macBuffer = malloc(macBufferLength);
-    int offsetIV = 0;
-    int offsetCipherTextLength = offsetIV + kCCBlockSizeAES128;
-    int offsetCipherText = offsetCipherTextLength + 4;
+    NSAssert(cipherDataLength <= INT_MAX, @"");
+    uint8_t lengthBuffer[4];
 
-    int offsetAdditionalDataLength = offsetCipherText + cipherDataLength;
-    int offsetAdditionalData = offsetAdditionalDataLength + 4;
+    *context = _macKeyContext;
+    CCHmacUpdate(context, IV, kCCBlockSizeAES128); // [IV 16 bytes]
+    FBWriteIntBigEndian(lengthBuffer, (uint32_t)cipherDataLength);
+    CCHmacUpdate(context, lengthBuffer, sizeof(lengthBuffer)); // [length of ciphertext 4 bytes]
+}
 
-    memcpy(macBuffer + offsetIV, IV.bytes, kCCBlockSizeAES128); // [IV 16 bytes]
-    FBWriteIntBigEndian(macBuffer + offsetCipherTextLength, cipherDataLength); // [length of ciphertext 4 bytes]
-    memcpy(macBuffer + offsetCipherText, cipherData.bytes, cipherDataLength); // [ciphertext]
-    FBWriteIntBigEndian(macBuffer + offsetAdditionalDataLength, additionalDataToSignLength); // [length of additionalDataToSign, 4 bytes]
-    memcpy(macBuffer + offsetAdditionalData, additionalDataToSign.bytes, additionalDataToSignLength);
+// Hands out the idle cryptor for operation, reset to IV, or a new one if it is in use elsewhere
+- (CCCryptorRef)_checkOutCryptor:(CCOperation)operation IV:(const void *)IV
+{
+    CCCryptorRef cryptor = NULL;
+    @synchronized(self) {
+        CCCryptorRef *idle = (operation == kCCEncrypt) ? &_idleEncryptor : &_idleDecryptor;
+        cryptor = *idle;
+        *idle = NULL;
+    }
+    if (cryptor && CCCryptorReset(cryptor, IV) == kCCSuccess) {
+        return cryptor;
+    }
+    if (cryptor) {
+        CCCryptorRelease(cryptor);
+        cryptor = NULL;
+    }
+    if (CCCryptorCreate(operation, kCCAlgorithmAES128, 0,
+                        _encryptionKeyData.bytes, kCCKeySizeAES256,
+                        IV, &cryptor) != kCCSuccess) {
+        return NULL;
+    }
+    return cryptor;
+}
 
-    uint8_t *result = malloc(CC_SHA256_DIGEST_LENGTH);
+- (void)_checkInCryptor:(CCCryptorRef)cryptor operation:(CCOperation)operation
+{
+    @synchronized(self) {
+        CCCryptorRef *idle = (operation == kCCEncrypt) ? &_idleEncryptor : &_idleDecryptor;
+        if (!*idle) {
+            *idle = cryptor;
+            cryptor = NULL;
+        }
+    }
+    if (cryptor) {
+        CCCryptorRelease(cryptor);
+    }
+}
 
-    CCHmac(kCCHmacAlgSHA256, _macKeyData.bytes, _macKeyData.length, macBuffer, macBufferLength, result);
-    free(macBuffer);
+- (void)_finishMAC:(CCHmacContext *)context additionalDataToSign:(NSData *)additionalDataToSign result:(uint8_t *)result
+{
+    NSAssert(additionalDataToSign.length <= INT_MAX, @"");
+    uint8_t lengthBuffer[4];
 
-    return [NSData dataWithBytesNoCopy:result length:CC_SHA256_DIGEST_LENGTH];
+    FBWriteIntBigEndian(lengthBuffer, (uint32_t)additionalDataToSign.length);
+    CCHmacUpdate(context, lengthBuffer, sizeof(lengthBuffer)); // [length of additionalDataToSign, 4 bytes]
+    CCHmacUpdate(context, additionalDataToSign.bytes, additionalDataToSign.length);
+    CCHmacFinal(context, result);
 }
 
 /**
- * return base64_encode([VERSION 1 byte] + [MAC 32 bytes] + [IV 16 bytes] + [AES256(Padded Data, multiples of 16)]
+ * return [VERSION 1 byte] + [MAC 32 bytes] + [IV 16 bytes] + [AES256(Padded Data, multiples of 16)]
+ *
+ * producer calls the handler it is given with the plain text, in order, in pieces of any size.
  */
-- (NSString *)encrypt:(NSData *)plainText additionalDataToSign:(NSData *)additionalDataToSign
+- (NSData *)_encryptPlainTextLength:(NSUInteger)plainTextLength
+               additionalDataToSign:(NSData *)additionalDataToSign
+                           producer:(BOOL (^)(FBCryptoChunkHandler handler))producer
 {
-    NSAssert(plainText.length <= INT_MAX, @"");
-    int plainTextLength = (int)plainText.length;
+    NSAssert(plainTextLength <= INT_MAX, @"");
 
-    uint8_t numPaddingBytes = kCCBlockSizeAES128 - (plainText.length % kCCBlockSizeAES128); // Pad 1 .. 16 bytes
-    int cipherDataLength = plainTextLength + numPaddingBytes;
-    size_t bufferSize = 1 + CC_SHA256_DIGEST_LENGTH + kCCBlockSizeAES128 + cipherDataLength;
-    int offsetMAC = 1;
-    int offsetIV = offsetMAC + CC_SHA256_DIGEST_LENGTH;
-    int offsetCipherData = offsetIV + kCCBlockSizeAES128;
+    uint8_t numPaddingBytes = kCCBlockSizeAES128 - (plainTextLength % kCCBlockSizeAES128); // Pad 1 .. 16 bytes
+    size_t cipherDataLength = plainTextLength + numPaddingBytes;
+    size_t offsetMAC = 1;
+    size_t offsetIV = offsetMAC + CC_SHA256_DIGEST_LENGTH;
+    size_t offsetCipherData = offsetIV + kCCBlockSizeAES128;
 
-    uint8_t *buffer = calloc(bufferSize, sizeof(uint8_t));
-    buffer[0] = kFB_CRYPTO_CURRENT_VERSION; // First byte is the version number
     NSData *IV = [[self class] randomBytes:kCCBlockSizeAES128];
-    memcpy(buffer + offsetIV, IV.bytes, IV.length);
-
-    memcpy(buffer + offsetCipherData, plainText.bytes, plainTextLength); // Copy input in
-    fbdfl_SecRandomCopyBytes([FBDynamicFrameworkLoader loadkSecRandomDefault], numPaddingBytes, buffer + offsetCipherData + plainTextLength); // Random pad
-    buffer[offsetCipherData + cipherDataLength - 1] = numPaddingBytes; // Record the number of padded bytes at the end
-
-    size_t numOutputBytes = 0;
-    CCCryptorStatus cryptStatus = CCCrypt(kCCEncrypt, kCCAlgorithmAES128, 0,
-                                          _encryptionKeyData.bytes, kCCKeySizeAES256,
-                                          IV.bytes,
-                                          buffer + offsetCipherData, cipherDataLength,
-                                          buffer + offsetCipherData, cipherDataLength,
-                                          &numOutputBytes);
-
-    NSData *mac = [self _macForIV:IV
-                       cipherData:[NSData dataWithBytesNoCopy:buffer + offsetCipherData length:cipherDataLength freeWhenDone:NO]
-             additionalDataToSign:additionalDataToSign];
-    memcpy(buffer + offsetMAC, mac.bytes, CC_SHA256_DIGEST_LENGTH);
-
-    if (cryptStatus == kCCSuccess) {
-        return FBEncodeBase64([NSData dataWithBytesNoCopy:buffer length:bufferSize]);
+    CCCryptorRef cryptor = IV ? [self _checkOutCryptor:kCCEncrypt IV:IV.bytes] : NULL;
+    if (!cryptor) {
+        return nil;
+    }
+
+    NSMutableData *result = [NSMutableData dataWithLength:kFB_CRYPTO_HEADER_LENGTH + cipherDataLength];
+    uint8_t *buffer = result.mutableBytes;
+    buffer[0] = kFB_CRYPTO_CURRENT_VERSION; // First byte is the version number
+    memcpy(buffer + offsetIV, IV.bytes, kCCBlockSizeAES128);
+
+    __block CCHmacContext macContext;
+    [self _beginMAC:&macContext IV:IV.bytes cipherDataLength:cipherDataLength];
+
+    __block size_t cipherDataWritten = 0;
+    __block size_t plainTextRead = 0;
+    __block BOOL failed = NO;
+    // Encrypts straight into the result, and signs each piece of cipher text as it comes out
+    BOOL (^encryptChunk)(const uint8_t *, size_t) = ^BOOL(const uint8_t *bytes, size_t length) {
+        size_t moved = 0;
+        uint8_t *output = buffer + offsetCipherData + cipherDataWritten;
+        if (CCCryptorUpdate(cryptor, bytes, length, output, cipherDataLength - cipherDataWritten, &moved) != kCCSuccess) {
+            failed = YES;
+            return NO;
+        }
+        CCHmacUpdate(&macContext, output, moved);
+        cipherDataWritten += moved;
+        return YES;
+    };
+
+    BOOL produced = producer(^BOOL(const uint8_t *bytes, size_t length) {
+        if (plainTextRead + length > plainTextLength) {
+            failed = YES;
+            return NO;
+        }
+        plainTextRead += length;
+        return encryptChunk(bytes, length);
+    });
+
+    if (produced && !failed && plainTextRead == plainTextLength) {
+        uint8_t padding[kCCBlockSizeAES128];
+        fbdfl_SecRandomCopyBytes([FBDynamicFrameworkLoader loadkSecRandomDefault], numPaddingBytes, padding); // Random pad
+        padding[numPaddingBytes - 1] = numPaddingBytes; // Record the number of padded bytes at the end
+        encryptChunk(padding, numPaddingBytes);
+        bzero(padding, sizeof(padding));
+
+        size_t moved = 0;
+        if (!failed &&
+            CCCryptorFinal(cryptor, buffer + offsetCipherData + cipherDataWritten,
+                           cipherDataLength - cipherDataWritten, &moved) == kCCSuccess) {
+            CCHmacUpdate(&macContext, buffer + offsetCipherData + cipherDataWritten, moved);
+            cipherDataWritten += moved;
+        } else {
+            failed = YES;
+        }
+    } else {
+        failed = YES;
     }
-    free(buffer);
-    return nil;
+    [self _checkInCryptor:cryptor operation:kCCEncrypt];
+
+    [self _finishMAC:&macContext additionalDataToSign:additionalDataToSign result:buffer + offsetMAC];
+
+    if (failed || cipherDataWritten != cipherDataLength) {
+        blankData(result);
+        return nil;
+    }
+    return result;
 }
 
-- (NSData *)decrypt:(NSString *)base64EncodedCipherText additionalSignedData:(NSData *)additionalSignedData
+- (BOOL)_decryptData:(NSData *)cipherText
+    additionalSignedData:(NSData *)additionalSignedData
+                consumer:(FBCryptoChunkHandler)consumer
 {
-    NSData *cipherText = FBDecodeBase64(base64EncodedCipherText);
     NSAssert(cipherText.length <= INT_MAX, @"");
-    int cipherTextLength = (int)cipherText.length;
+    size_t cipherTextLength = cipherText.length;
 
-    if (!cipherText || cipherTextLength < 1 + CC_SHA256_DIGEST_LENGTH + kCCBlockSizeAES128) {
-        return nil;
+    if (!cipherText || cipherTextLength < kFB_CRYPTO_HEADER_LENGTH + kCCBlockSizeAES128) {
+        return NO;
     }
-    int cipherDataLength = cipherTextLength  - (1 + CC_SHA256_DIGEST_LENGTH + kCCBlockSizeAES128);
+    size_t cipherDataLength = cipherTextLength - kFB_CRYPTO_HEADER_LENGTH;
     if (cipherDataLength % kCCBlockSizeAES128 != 0) {
-        return nil;
+        return NO;
     }
-    uint8_t *buffer = (uint8_t *)cipherText.bytes;
+    const uint8_t *buffer = cipherText.bytes;
 
-    int offsetMAC = 1;
-    int offsetIV = offsetMAC + CC_SHA256_DIGEST_LENGTH;
-    int offsetCipherData = offsetIV + kCCBlockSizeAES128;
+    size_t offsetMAC = 1;
+    size_t offsetIV = offsetMAC + CC_SHA256_DIGEST_LENGTH;
+    size_t offsetCipherData = offsetIV + kCCBlockSizeAES128;
 
     if (buffer[0] != kFB_CRYPTO_CURRENT_VERSION) {
-        return nil; // Version does not match
+        return NO; // Version does not match
     }
 
-    NSData *IV = [NSData dataWithBytesNoCopy:buffer + offsetIV length:kCCBlockSizeAES128 freeWhenDone:NO];
-    NSData *cipherData = [NSData dataWithBytesNoCopy:buffer + offsetCipherData length:cipherDataLength freeWhenDone:NO];
-    NSData *mac = [self _macForIV:IV cipherData:cipherData additionalDataToSign:additionalSignedData];
-    NSData *macFromStream = [NSData dataWithBytesNoCopy:buffer + offsetMAC length:CC_SHA256_DIGEST_LENGTH freeWhenDone:NO];
-    if (![mac isEqualToData:macFromStream]) {
-        return nil; // MAC does not match
+    // Signed in place, rather than copied out alongside the IV and lengths
+    uint8_t mac[CC_SHA256_DIGEST_LENGTH];
+    CCHmacContext macContext;
+    [self _beginMAC:&macContext IV:buffer + offsetIV cipherDataLength:cipherDataLength];
+    CCHmacUpdate(&macContext, buffer + offsetCipherData, cipherDataLength);
+    [self _finishMAC:&macContext additionalDataToSign:additionalSignedData result:mac];
+    if (memcmp(mac, buffer + offsetMAC, CC_SHA256_DIGEST_LENGTH) != 0) {
+        return NO; // MAC does not match
     }
 
+    CCCryptorRef cryptor = [self _checkOutCryptor:kCCDecrypt IV:buffer + offsetIV];
+    if (!cryptor) {
+        return NO;
+    }
+
+    // Everything but the last block goes straight out; the last block carries the padding count
+    uint8_t *outputBuffer = malloc(kFB_CRYPTO_CHUNK_LENGTH + kCCBlockSizeAES128);
+    BOOL succeeded = (outputBuffer != NULL);
+    size_t bodyLength = cipherDataLength - kCCBlockSizeAES128;
+    size_t offset = 0;
+    while (succeeded && offset < bodyLength) {
+        size_t chunkLength = MIN(kFB_CRYPTO_CHUNK_LENGTH, bodyLength - offset);
+        size_t moved = 0;
+        succeeded = (CCCryptorUpdate(cryptor, buffer + offsetCipherData + offset, chunkLength,
+                                     outputBuffer, kFB_CRYPTO_CHUNK_LENGTH + kCCBlockSizeAES128, &moved) == kCCSuccess) &&
+        (moved == 0 || consumer(outputBuffer, moved));
+        offset += chunkLength;
+    }
 
-    uint8_t *outputBuffer = malloc(cipherDataLength);
-    size_t numOutputBytes = 0;
-    CCCryptorStatus cryptStatus = CCCrypt(kCCDecrypt, kCCAlgorithmAES128, 0,
-                                          _encryptionKeyData.bytes, kCCKeySizeAES256,
-                                          IV.bytes,
-                                          buffer + offsetCipherData, cipherDataLength,
-                                          outputBuffer, cipherDataLength,
-                                          &numOutputBytes);
-    if (cryptStatus == kCCSuccess) {
-        int numPaddingBytes = outputBuffer[cipherDataLength - 1];
-        if (!(numPaddingBytes >= 1 && numPaddingBytes <= kCCBlockSizeAES128)) {
-            numPaddingBytes = 0;
+    if (succeeded) {
+        size_t moved = 0;
+        size_t finalMoved = 0;
+        succeeded = (CCCryptorUpdate(cryptor, buffer + offsetCipherData + bodyLength, kCCBlockSizeAES128,
+                                     outputBuffer, kFB_CRYPTO_CHUNK_LENGTH + kCCBlockSizeAES128, &moved) == kCCSuccess) &&
+        (CCCryptorFinal(cryptor, outputBuffer + moved, kFB_CRYPTO_CHUNK_LENGTH + kCCBlockSizeAES128 - moved,
+                        &finalMoved) == kCCSuccess);
+        moved += finalMoved;
+        if (succeeded && moved > 0) {
+            size_t numPaddingBytes = outputBuffer[moved - 1];
+            if (!(numPaddingBytes >= 1 && numPaddingBytes <= kCCBlockSizeAES128) || numPaddingBytes > moved) {
+                numPaddingBytes = 0;
+            }
+            succeeded = (moved == numPaddingBytes) || consumer(outputBuffer, moved - numPaddingBytes);
         }
-        return [NSData dataWithBytesNoCopy:outputBuffer length:cipherDataLength - numPaddingBytes];
     }
-    free(outputBuffer);
-    return nil;
+
+    [self _checkInCryptor:cryptor operation:kCCDecrypt];
+    if (outputBuffer) {
+        bzero(outputBuffer, kFB_CRYPTO_CHUNK_LENGTH + kCCBlockSizeAES128);
+        free(outputBuffer);
+    }
+    return succeeded;
+}
+
+- (NSString *)encrypt:(NSData *)plainText additionalDataToSign:(NSData *)additionalDataToSign
+{
+    const uint8_t *bytes = plainText.bytes;
+    NSUInteger length = plainText.length;
+    NSData *result = [self _encryptPlainTextLength:length
+                              additionalDataToSign:additionalDataToSign
+                                          producer:^BOOL(FBCryptoChunkHandler handler) {
+                                              // already in memory, so encrypted straight from where it is
+                                              return length == 0 || handler(bytes, length);
+                                          }];
+    return result ? FBEncodeBase64(result) : nil;
+}
+
+- (NSData *)encryptInputStream:(NSInputStream *)plainTextStream
+                        length:(NSUInteger)plainTextLength
+          additionalDataToSign:(NSData *)additionalDataToSign
+{
+    return [self _encryptPlainTextLength:plainTextLength
+                    additionalDataToSign:additionalDataToSign
+                                producer:^BOOL(FBCryptoChunkHandler handler) {
+                                    uint8_t *chunk = malloc(kFB_CRYPTO_CHUNK_LENGTH);
+                                    if (!chunk) {
+                                        return NO;
+                                    }
+                                    if (plainTextStream.streamStatus == NSStreamStatusNotOpen) {
+                                        [plainTextStream open];
+                                    }
+                                    NSUInteger remaining = plainTextLength;
+                                    BOOL succeeded = YES;
+                                    while (succeeded && remaining > 0) {
+                                        NSInteger read = [plainTextStream read:chunk
+                                                                     maxLength:MIN(kFB_CRYPTO_CHUNK_LENGTH, remaining)];
+                                        succeeded = read > 0 && handler(chunk, (size_t)read);
+                                        if (succeeded) {
+                                            remaining -= read;
+                                        }
+                                    }
+                                    bzero(chunk, kFB_CRYPTO_CHUNK_LENGTH);
+                                    free(chunk);
+                                    return succeeded;
+                                }];
+}
+
+- (NSData *)decrypt:(NSString *)base64EncodedCipherText additionalSignedData:(NSData *)additionalSignedData
+{
+    NSData *cipherText = FBDecodeBase64(base64EncodedCipherText);
+    if (cipherText.length < kFB_CRYPTO_HEADER_LENGTH) {
+        return nil;
+    }
+    NSMutableData *result = [NSMutableData dataWithCapacity:cipherText.length - kFB_CRYPTO_HEADER_LENGTH];
+    BOOL succeeded = [self _decryptData:cipherText
+                   additionalSignedData:additionalSignedData
+                               consumer:^BOOL(const uint8_t *bytes, size_t length) {
+                                   [result appendBytes:bytes length:length];
+                                   return YES;
+                               }];
+    return succeeded ? result : nil;
+}
+
+- (BOOL)decrypt:(NSString *)base64EncodedCipherText
+    additionalSignedData:(NSData *)additionalSignedData
+            chunkHandler:(BOOL (^)(const uint8_t *bytes, size_t length))handler
+{
+    return [self _decryptData:FBDecodeBase64(base64EncodedCipherText)
+         additionalSignedData:additionalSignedData
+                     consumer:handler];
+}
+
+- (BOOL)decryptData:(NSData *)cipherData
+    additionalSignedData:(NSData *)additionalSignedData
+          toOutputStream:(NSOutputStream *)outputStream
+{
+    if (outputStream.streamStatus == NSStreamStatusNotOpen) {
+        [outputStream open];
+    }
+    return [self _decryptData:cipherData
+         additionalSignedData:additionalSignedData
+                     consumer:^BOOL(const uint8_t *bytes, size_t length) {
+                         size_t written = 0;
+                         while (written < length) {
+                             NSInteger count = [outputStream write:bytes + written maxLength:length - written];
+                             if (count <= 0) {
+                                 return NO;
+                             }
+                             written += count;
+                         }
+                         return YES;
+                     }];
 }
 
 @end
@@ -19,11 +19,39 @@
 #import "FBAppCall.h"
 
 @class FBAppBridgeScheme;
+@class FBSession;
+
+/*
+ The URL for an app call built ahead of presentation by prepareDialogAppCall:, along with the
+ pasteboards holding its attachments. Main thread only.
+ */
+@interface FBAppBridgePreparedCall : NSObject
+
+@property (nonatomic, retain) FBAppBridgeScheme *bridgeScheme;
+@property (nonatomic, retain) FBSession *session;
+@property (nonatomic, retain) NSURL *url;
+@property (nonatomic, readonly) BOOL finished;
+// set when the call is presented before preparation finishes
+@property (nonatomic, copy) FBAppCallHandler pendingHandler;
+// the implicit app event the caller logs when the call is presented
+@property (nonatomic, copy) NSString *presentationEventName;
+
+- (void)finishWithURL:(NSURL *)url pasteboardNames:(NSArray *)pasteboardNames;
+// Hands over ownership of the pasteboards, which are otherwise removed with the prepared call
+- (NSArray *)takePasteboardNames;
+
+@end
 
 @interface FBAppBridge : NSObject
 
 + (instancetype)sharedInstance;
 
+// Serializes, converts and encrypts the app call off the main thread, so that dispatching it
+// later with the same scheme and session only has to open the URL.
+- (void)prepareDialogAppCall:(FBAppCall *)appCall
+                bridgeScheme:(FBAppBridgeScheme *)bridgeScheme
+                     session:(FBSession *)session;
+
 - (void)dispatchDialogAppCall:(FBAppCall *)appCall
                  bridgeScheme:(FBAppBridgeScheme *)bridgeScheme
                       session:(FBSession *)session
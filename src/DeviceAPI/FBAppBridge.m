@@ -22,9 +22,11 @@
 #import "FBBase64.h"
 #import "FBCrypto.h"
 #import "FBDialogsData+Internal.h"
+#import "FBDispatch.h"
 #import "FBError.h"
 #import "FBSession+Internal.h"
 #import "FBSettings+Internal.h"
+#import "FBTrace.h"
 #import "FBUtility.h"
 #import "FacebookSDK.h"
 
@@ -121,17 +123,174 @@ The protocol used to communicate with the Facebook application requires argument
 failed. Check the arguments and clientState to assure that they are well-formed.";
 static NSString *const FBAppBridgePasteboardNamesKey = @"FBAppBridgePasteboards";
 
+// A pending call holds its dialog data, images included, until the Facebook app answers. If
+// the answer never comes (the Facebook app was killed, or the app never wires up
+// handleDidBecomeActive), the call is cancelled once it is this old or this many newer calls
+// are waiting, so abandoned payloads don't stay in memory for the life of the app.
+static const NSTimeInterval kFBAppBridgePendingCallLifetime = 30 * 60;
+static const NSUInteger kFBAppBridgeMaxPendingCalls = 8;
+
 static FBAppBridge *g_sharedInstance;
 
+// The symmetric key as last read from or written to NSUserDefaults, and a crypto object
+// holding the keys derived from it.  Guarded by @synchronized([FBAppBridge class]).
+static NSString *g_symmetricKey;
+static FBCrypto *g_symmetricKeyCrypto;
+
+// Pasteboard name snapshots are written here, so two trips to the background in quick
+// succession can't have the older snapshot land last
+static dispatch_queue_t FBAppBridgeSaveQueue(void) {
+    static dispatch_queue_t queue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        queue = FBDispatchQueueCreateSerial("com.facebook.sdk.FBAppBridge", FBDispatchLaneBackground);
+    });
+    return queue;
+}
+
+// Decodes %XX escapes and '+' in place, returning the decoded length
+static NSUInteger FBAppBridgeURLDecodeBytes(uint8_t *bytes, NSUInteger length) {
+    NSUInteger out = 0;
+    for (NSUInteger i = 0; i < length; i++) {
+        uint8_t byte = bytes[i];
+        if (byte == '+') {
+            byte = ' ';
+        } else if (byte == '%' && i + 2 < length && isxdigit(bytes[i + 1]) && isxdigit(bytes[i + 2])) {
+            char hex[3] = {(char)bytes[i + 1], (char)bytes[i + 2], 0};
+            byte = (uint8_t)strtol(hex, NULL, 16);
+            i += 2;
+        }
+        bytes[out++] = byte;
+    }
+    return out;
+}
+
+// Collects one key=value pair of a query string at a time, so the decrypted query is never held
+// whole.  The JSON valued parameters are left as decoded bytes, ready for NSJSONSerialization.
+@interface FBAppBridgeQueryParser : NSObject {
+    NSMutableDictionary *_result;
+    NSMutableData *_key;
+    NSMutableData *_value;
+    BOOL _inValue;
+}
+- (void)appendBytes:(const uint8_t *)bytes length:(size_t)length;
+- (void)finishPair;
+- (NSMutableDictionary *)finish;
+@end
+
+@implementation FBAppBridgeQueryParser
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _result = [[NSMutableDictionary alloc] init];
+        _key = [[NSMutableData alloc] init];
+        _value = [[NSMutableData alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_result release];
+    [_key release];
+    [_value release];
+    [super dealloc];
+}
+
+- (void)appendBytes:(const uint8_t *)bytes length:(size_t)length {
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (bytes[i] == '&' || (bytes[i] == '=' && !_inValue)) {
+            [(_inValue ? _value : _key) appendBytes:bytes + start length:i - start];
+            start = i + 1;
+            if (bytes[i] == '&') {
+                [self finishPair];
+            } else {
+                _inValue = YES;
+            }
+        }
+    }
+    [(_inValue ? _value : _key) appendBytes:bytes + start length:length - start];
+}
+
+- (void)finishPair {
+    if (_key.length || _value.length) {
+        _key.length = FBAppBridgeURLDecodeBytes(_key.mutableBytes, _key.length);
+        _value.length = FBAppBridgeURLDecodeBytes(_value.mutableBytes, _value.length);
+        NSString *key = [[[NSString alloc] initWithData:_key encoding:NSUTF8StringEncoding] autorelease];
+        id value = nil;
+        if ([key isEqualToString:@"bridge_args"] ||
+            [key isEqualToString:@"method_args"] ||
+            [key isEqualToString:@"method_results"]) {
+            value = [NSData dataWithData:_value];
+        } else {
+            value = [[[NSString alloc] initWithData:_value encoding:NSUTF8StringEncoding] autorelease];
+        }
+        if (key.length && value) {
+            _result[key] = value;
+        }
+    }
+    _key.length = 0;
+    _value.length = 0;
+    _inValue = NO;
+}
+
+- (NSMutableDictionary *)finish {
+    [self finishPair];
+    return _result;
+}
+
+@end
+
 @interface FBAppBridge ()
 
 @property (nonatomic, retain) NSMutableDictionary *pendingAppCalls;
 @property (nonatomic, retain) NSMutableDictionary *callbacks;
+// IDs of pendingAppCalls, oldest first, and when each was tracked
+@property (nonatomic, retain) NSMutableOrderedSet *pendingAppCallIDs;
+@property (nonatomic, retain) NSMutableDictionary *pendingAppCallTimes;
 @property (nonatomic, retain) FBAppBridgeTypeToJSONConverter *jsonConverter;
 @property (nonatomic, copy) NSString *appID;
 @property (nonatomic, copy) NSString *bundleID;
 @property (nonatomic, copy) NSString *appName;
 
+// Pasteboards created for each pending app call, keyed by call ID. Read from NSUserDefaults
+// once, then written back only when the app goes to the background. Main thread only.
+@property (nonatomic, retain) NSMutableDictionary *pasteboardNames;
+@property (nonatomic, assign) BOOL pasteboardNamesNeedSaving;
+
+@end
+
+@implementation FBAppBridgePreparedCall {
+    NSArray *_pasteboardNames;
+}
+
+- (void)dealloc {
+    // never presented, so nothing else will clean these up
+    for (NSString *pasteboardName in _pasteboardNames) {
+        [UIPasteboard removePasteboardWithName:pasteboardName];
+    }
+    [_pasteboardNames release];
+    [_bridgeScheme release];
+    [_session release];
+    [_url release];
+    [_pendingHandler release];
+    [_presentationEventName release];
+    [super dealloc];
+}
+
+- (void)finishWithURL:(NSURL *)url pasteboardNames:(NSArray *)pasteboardNames {
+    self.url = url;
+    [_pasteboardNames release];
+    _pasteboardNames = [pasteboardNames copy];
+    _finished = YES;
+}
+
+- (NSArray *)takePasteboardNames {
+    NSArray *pasteboardNames = [_pasteboardNames autorelease];
+    _pasteboardNames = nil;
+    return pasteboardNames;
+}
+
 @end
 
 @implementation FBAppBridge
@@ -164,19 +323,31 @@ static FBAppBridge *g_sharedInstance;
 
         self.pendingAppCalls = [NSMutableDictionary dictionary];
         self.callbacks = [NSMutableDictionary dictionary];
+        self.pendingAppCallIDs = [NSMutableOrderedSet orderedSet];
+        self.pendingAppCallTimes = [NSMutableDictionary dictionary];
         self.jsonConverter = [[[FBAppBridgeTypeToJSONConverter alloc] init] autorelease];
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(applicationDidEnterBackground:)
+                                                     name:UIApplicationDidEnterBackgroundNotification
+                                                   object:nil];
     }
     return self;
 }
 
 - (void)dealloc
 {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+
     // Probably don't need the releases for singletons
     [_pendingAppCalls release];
     [_callbacks release];
+    [_pendingAppCallIDs release];
+    [_pendingAppCallTimes release];
     [_jsonConverter release];
     [_appID release];
     [_bundleID release];
+    [_pasteboardNames release];
 
     [super dealloc];
 }
@@ -193,21 +364,59 @@ static FBAppBridge *g_sharedInstance;
     });
 }
 
-- (void)performDialogAppCall:(FBAppCall *)appCall
+- (void)prepareDialogAppCall:(FBAppCall *)appCall
                 bridgeScheme:(FBAppBridgeScheme *)bridgeScheme
-                     session:(FBSession *)session
-           completionHandler:(FBAppCallHandler)handler {
+                     session:(FBSession *)session {
     if (!session) {
         session = FBSession.activeSessionIfExists;
     }
     if (!appCall.isValid || !appCall.dialogData || !bridgeScheme) {
-        // NOTE : the FBConditionalLog is wrapped in an if to allow us to return and prevent exceptions
-        // further down. No need to check the condition again since we know we are in an error state.
-        // TODO : Change this to an assert and remove the if.
-        FBConditionalLog(YES, FBLoggingBehaviorDeveloperErrors, @"FBAppBridge: Must provide a valid AppCall object & bridge scheme.");
         return;
     }
 
+    FBAppBridgePreparedCall *preparedCall = [[[FBAppBridgePreparedCall alloc] init] autorelease];
+    preparedCall.bridgeScheme = bridgeScheme;
+    preparedCall.session = session;
+    appCall.preparedBridgeCall = preparedCall;
+
+    // the shared converter keeps per-conversion state, so the preparation gets its own
+    FBAppBridgeTypeToJSONConverter *converter = [[[FBAppBridgeTypeToJSONConverter alloc] init] autorelease];
+    [appCall retain];
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneUserInteractive), ^{
+        NSMutableArray *pasteboardNames = [NSMutableArray array];
+        NSURL *url = [self urlForDialogAppCall:appCall
+                                  bridgeScheme:bridgeScheme
+                                       session:session
+                                     converter:converter
+                               pasteboardNames:pasteboardNames
+                                  errorMessage:NULL];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [preparedCall finishWithURL:url pasteboardNames:pasteboardNames];
+            FBAppCallHandler pendingHandler = preparedCall.pendingHandler;
+            if (pendingHandler && appCall.preparedBridgeCall == preparedCall) {
+                [self performDialogAppCall:appCall
+                              bridgeScheme:bridgeScheme
+                                   session:session
+                         completionHandler:pendingHandler];
+            }
+            [appCall release];
+        });
+    });
+}
+
+// Builds the URL that opens the dialog, putting large attachments on pasteboards and adding their
+// names to pasteboardNames.  Returns nil, and removes any pasteboards, if the call's data cannot
+// be serialized.  Safe to call off the main thread with a converter of its own.
+- (NSURL *)urlForDialogAppCall:(FBAppCall *)appCall
+                  bridgeScheme:(FBAppBridgeScheme *)bridgeScheme
+                       session:(FBSession *)session
+                     converter:(FBAppBridgeTypeToJSONConverter *)converter
+               pasteboardNames:(NSMutableArray *)pasteboardNames
+                  errorMessage:(NSString **)errorMessage {
+    if (errorMessage) {
+        *errorMessage = kSerializeErrorMessage;
+    }
+
     NSMutableDictionary *queryParams = [NSMutableDictionary dictionaryWithObjectsAndKeys:
                                         self.appID, FBBridgeURLParams.appId,
                                         [FBAppBridge symmetricKeyAndForceRefresh:NO], FBBridgeURLParams.cipherKey,
@@ -227,8 +436,7 @@ static FBAppBridge *g_sharedInstance;
             bridgeParams[FBBridgeKey.clientState] = clientStateString;
         } else {
             // clientState is not valid JSON
-            [self invoke:handler forFailedAppCall:appCall withMessage:kSerializeErrorMessage];
-            return;
+            return nil;
         }
     }
 
@@ -237,28 +445,82 @@ static FBAppBridge *g_sharedInstance;
         queryParams[FBBridgeURLParams.schemeSuffix] = urlSchemeSuffix;
     }
 
-    NSString *jsonString = [self jsonStringFromDictionary:bridgeParams];
-    if (!jsonString) {
-        [self invoke:handler forFailedAppCall:appCall withMessage:kSerializeErrorMessage];
-        return;
+    NSData *jsonData = [self jsonDataFromDictionary:bridgeParams converter:converter];
+    if (!jsonData) {
+        return nil;
+    }
+    queryParams[FBBridgeURLParams.bridgeArgs] = jsonData;
+    // each conversion reports only its own pasteboards
+    [pasteboardNames addObjectsFromArray:converter.createdPasteboardNames];
+
+    jsonData = [self jsonDataFromDictionary:appCall.dialogData.arguments converter:converter];
+    [pasteboardNames addObjectsFromArray:converter.createdPasteboardNames];
+    if (!jsonData) {
+        for (NSString *pasteboardName in pasteboardNames) {
+            [UIPasteboard removePasteboardWithName:pasteboardName];
+        }
+        [pasteboardNames removeAllObjects];
+        return nil;
     }
-    queryParams[FBBridgeURLParams.bridgeArgs] = jsonString;
+    queryParams[FBBridgeURLParams.methodArgs] = jsonData;
+
+    return [bridgeScheme urlForMethod:appCall.dialogData.method
+                          queryParams:queryParams];
+}
 
-    jsonString = [self jsonStringFromDictionary:appCall.dialogData.arguments];
-    if (!jsonString) {
-        [self invoke:handler forFailedAppCall:appCall withMessage:kSerializeErrorMessage];
+- (void)performDialogAppCall:(FBAppCall *)appCall
+                bridgeScheme:(FBAppBridgeScheme *)bridgeScheme
+                     session:(FBSession *)session
+           completionHandler:(FBAppCallHandler)handler {
+    if (!session) {
+        session = FBSession.activeSessionIfExists;
+    }
+    if (!appCall.isValid || !appCall.dialogData || !bridgeScheme) {
+        // NOTE : the FBConditionalLog is wrapped in an if to allow us to return and prevent exceptions
+        // further down. No need to check the condition again since we know we are in an error state.
+        // TODO : Change this to an assert and remove the if.
+        FBConditionalLog(YES, FBLoggingBehaviorDeveloperErrors, @"FBAppBridge: Must provide a valid AppCall object & bridge scheme.");
         return;
     }
-    queryParams[FBBridgeURLParams.methodArgs] = jsonString;
 
-    NSURL *url = [bridgeScheme urlForMethod:appCall.dialogData.method
-                                queryParams:queryParams];
+    FBAppBridgePreparedCall *preparedCall = appCall.preparedBridgeCall;
+    if (preparedCall && preparedCall.bridgeScheme == bridgeScheme && preparedCall.session == session) {
+        if (!preparedCall.finished) {
+            // presented before the preparation is done; it picks the call up when it is
+            preparedCall.pendingHandler = handler ?: ^(FBAppCall *call) {};
+            return;
+        }
+    } else {
+        preparedCall = nil;
+    }
+    appCall.preparedBridgeCall = nil;
+
+    NSURL *url = nil;
+    NSArray *pasteboardNames = nil;
+    NSString *errorMessage = nil;
+    if (preparedCall.url) {
+        url = preparedCall.url;
+        pasteboardNames = [preparedCall takePasteboardNames];
+    } else {
+        NSMutableArray *createdPasteboardNames = [NSMutableArray array];
+        url = [self urlForDialogAppCall:appCall
+                           bridgeScheme:bridgeScheme
+                                session:session
+                              converter:self.jsonConverter
+                        pasteboardNames:createdPasteboardNames
+                           errorMessage:&errorMessage];
+        pasteboardNames = createdPasteboardNames;
+    }
+    if (!url) {
+        [self invoke:handler forFailedAppCall:appCall withMessage:errorMessage];
+        return;
+    }
 
     // Track the callback and AppCall, now that we are just about to invoke the url
     [self trackAppCall:appCall withCompletionHandler:handler];
 
     // Remember what items we put on the pasteboard for this call.
-    [self savePasteboardNames:self.jsonConverter.createdPasteboardNames forAppCallID:appCall.ID];
+    [self savePasteboardNames:pasteboardNames forAppCallID:appCall.ID];
 
     BOOL success = [[UIApplication sharedApplication] openURL:url];
 
@@ -363,40 +625,67 @@ forFailedAppCall:(FBAppCall *)appCall
     // the app was made active without the response URL from the native facebook app.
 
     NSError *error = nil;
-    NSArray *allPendingAppCalls = [self.pendingAppCalls allValues];
-
-    for (FBAppCall *call in allPendingAppCalls) {
-        [call retain];
-        FBAppCallHandler handler = [[self.callbacks[call.ID] retain] autorelease];
-        [self stopTrackingCallWithID:call.ID];
-
-        @try {
-            if (handler) {
-                if (!error) {
-                    error = [NSError errorWithDomain:FacebookSDKDomain
-                                                     code:FBErrorAppActivatedWhilePendingAppCall
-                                                 userInfo:@{NSLocalizedDescriptionKey : @"The user navigated away from "
-                                  @"the Facebook app prior to completing this AppCall. This AppCall is now cancelled "
-                                  @"and needs to be retried to get a successful completion"}];
-                }
-                call.error = error;
-
-                // Passing nil for results, since we are effectively cancelling this action
-                handler(call);
-            }
+    NSArray *allPendingAppCallIDs = [self.pendingAppCallIDs array];
+
+    for (NSString *callID in allPendingAppCallIDs) {
+        if (!error) {
+            error = [NSError errorWithDomain:FacebookSDKDomain
+                                        code:FBErrorAppActivatedWhilePendingAppCall
+                                    userInfo:@{NSLocalizedDescriptionKey : @"The user navigated away from "
+                     @"the Facebook app prior to completing this AppCall. This AppCall is now cancelled "
+                     @"and needs to be retried to get a successful completion"}];
         }
-        @finally {
-            [call release];
+        [self cancelAppCallWithID:callID error:error];
+    }
+
+}
+
+- (void)cancelAppCallWithID:(NSString *)callID error:(NSError *)error {
+    FBAppCall *call = [self.pendingAppCalls[callID] retain];
+    FBAppCallHandler handler = [[self.callbacks[callID] retain] autorelease];
+    [self stopTrackingCallWithID:callID];
+
+    @try {
+        if (call && handler) {
+            call.error = error;
+
+            // Passing nil for results, since we are effectively cancelling this action
+            handler(call);
         }
     }
+    @finally {
+        [call release];
+    }
+}
 
+// Cancels pending calls that are too old, or too many, to still be waiting on the Facebook app.
+// The IDs are in tracking order, so only the oldest few are ever looked at.
+- (void)expireStalePendingAppCalls {
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    NSError *error = nil;
+    while (self.pendingAppCallIDs.count) {
+        NSString *callID = self.pendingAppCallIDs.firstObject;
+        NSTimeInterval trackedTime = [self.pendingAppCallTimes[callID] doubleValue];
+        if (self.pendingAppCallIDs.count <= kFBAppBridgeMaxPendingCalls &&
+            now - trackedTime < kFBAppBridgePendingCallLifetime) {
+            break;
+        }
+        if (!error) {
+            error = [NSError errorWithDomain:FacebookSDKDomain
+                                        code:FBErrorAppActivatedWhilePendingAppCall
+                                    userInfo:@{NSLocalizedDescriptionKey : @"The Facebook app did not complete this "
+                     @"AppCall in time. This AppCall is now cancelled and needs to be retried to get a successful "
+                     @"completion"}];
+        }
+        [self cancelAppCallWithID:callID error:error];
+    }
 }
 
 - (BOOL)processResponse:(NSDictionary *)queryParams
                  method:(NSString *)method
                 session:(FBSession *)session
         fallbackHandler:(FBAppCallHandler)fallbackHandler {
-    NSDictionary *bridgeArgs = [self dictionaryFromJSONString:queryParams[FBBridgeURLParams.bridgeArgs]];
+    NSDictionary *bridgeArgs = [self dictionaryFromJSON:queryParams[FBBridgeURLParams.bridgeArgs]];
     NSString *callID = bridgeArgs[FBBridgeKey.actionID];
     NSString *version = queryParams[FBBridgeURLParams.version];
 
@@ -414,7 +703,7 @@ forFailedAppCall:(FBAppCall *)appCall
     // to the native Facebook app. We can create a duplicate FBAppCall object to pass to the
     // fallback handler, from the data in the url.
     if (!call && fallbackHandler) {
-        NSDictionary *methodArgs = [self dictionaryFromJSONString:queryParams[FBBridgeURLParams.methodArgs]];
+        NSDictionary *methodArgs = [self dictionaryFromJSON:queryParams[FBBridgeURLParams.methodArgs]];
         NSDictionary *clientState = [FBUtility simpleJSONDecode:bridgeArgs[FBBridgeKey.clientState]];
 
         FBDialogsData *dialogData = [[[FBDialogsData alloc] initWithMethod:method
@@ -431,7 +720,7 @@ forFailedAppCall:(FBAppCall *)appCall
     [self stopTrackingCallWithID:callID];
 
     // TODO: Log if handler was not found.
-    call.dialogData.results = [self dictionaryFromJSONString:queryParams[FBBridgeURLParams.methodResults]];
+    call.dialogData.results = [self dictionaryFromJSON:queryParams[FBBridgeURLParams.methodResults]];
     call.error = [FBAppBridge errorFromDictionary:bridgeArgs[FBBridgeKey.error]];
 
     @try {
@@ -468,38 +757,57 @@ forFailedAppCall:(FBAppCall *)appCall
                                          nil];
     NSString *additionalData = [additionalDataComponents componentsJoinedByString:@":"];
 
-    // Now that we have all required info, decrypt!
-    FBCrypto *crypto = [[FBCrypto alloc] initWithMasterKey:symmetricKey];
-    NSData *decryptedData = [crypto decrypt:cipherText
-                       additionalSignedData:[additionalData dataUsingEncoding:NSUTF8StringEncoding]];
-    [crypto release];
-    if (!decryptedData) {
+    // Now that we have all required info, decrypt, parsing the query params as they come out
+    FBCrypto *crypto = [FBAppBridge cryptoForSymmetricKey:symmetricKey];
+    FBAppBridgeQueryParser *parser = [[[FBAppBridgeQueryParser alloc] init] autorelease];
+    BOOL decrypted = [crypto decrypt:cipherText
+                additionalSignedData:[additionalData dataUsingEncoding:NSUTF8StringEncoding]
+                        chunkHandler:^BOOL(const uint8_t *bytes, size_t length) {
+                            [parser appendBytes:bytes length:length];
+                            return YES;
+                        }];
+    if (!decrypted) {
         return nil;
     }
 
-    // Now create the decrypted query params dictionary
-    NSString *queryParamsStr = [[NSString alloc] initWithData:decryptedData
-                                                     encoding:NSUTF8StringEncoding];
-    NSMutableDictionary *queryParams = [NSMutableDictionary dictionaryWithDictionary:
-                                        [FBUtility dictionaryByParsingURLQueryPart:queryParamsStr]];
+    NSMutableDictionary *queryParams = [parser finish];
     queryParams[FBBridgeURLParams.version] = version;
-    [queryParamsStr release];
 
     return queryParams;
 }
 
 + (NSString *)symmetricKeyAndForceRefresh:(BOOL)forceRefresh {
-    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
-    NSString *symmetricKey = [defaults objectForKey:FBBridgeURLParams.cipherKey];
-    if (!symmetricKey || forceRefresh) {
-        // Generate keys
-        symmetricKey = [FBCrypto makeMasterKey];
+    @synchronized([FBAppBridge class]) {
+        if (!g_symmetricKey && !forceRefresh) {
+            g_symmetricKey = [[[NSUserDefaults standardUserDefaults] objectForKey:FBBridgeURLParams.cipherKey] copy];
+        }
+        if (!g_symmetricKey || forceRefresh) {
+            // Generate keys, dropping anything derived from the old ones
+            [g_symmetricKeyCrypto release];
+            g_symmetricKeyCrypto = nil;
+            [g_symmetricKey release];
+            g_symmetricKey = [[FBCrypto makeMasterKey] copy];
+
+            // Store the keys
+            [[NSUserDefaults standardUserDefaults] setObject:g_symmetricKey forKey:FBBridgeURLParams.cipherKey];
+        }
 
-        // Store the keys
-        [defaults setObject:symmetricKey forKey:FBBridgeURLParams.cipherKey];
+        return [[g_symmetricKey retain] autorelease];
     }
+}
 
-    return symmetricKey;
+// Derives the keys for symmetricKey once, and keeps them until the key changes
++ (FBCrypto *)cryptoForSymmetricKey:(NSString *)symmetricKey {
+    @synchronized([FBAppBridge class]) {
+        if (![symmetricKey isEqualToString:g_symmetricKey]) {
+            // not the key we hold on to, so nothing to cache it against
+            return [[[FBCrypto alloc] initWithMasterKey:symmetricKey] autorelease];
+        }
+        if (!g_symmetricKeyCrypto) {
+            g_symmetricKeyCrypto = [[FBCrypto alloc] initWithMasterKey:symmetricKey];
+        }
+        return [[g_symmetricKeyCrypto retain] autorelease];
+    }
 }
 
 - (void)addAppMetadataToDictionary:(NSMutableDictionary *)dictionary {
@@ -515,54 +823,100 @@ forFailedAppCall:(FBAppCall *)appCall
 
 - (void)trackAppCall:(FBAppCall *)call
 withCompletionHandler:(FBAppCallHandler)handler {
+    FBTraceBegin(FBTracePointAppBridgeRoundTrip, call.ID.hash);
     self.pendingAppCalls[call.ID] = call;
+    [self.pendingAppCallIDs removeObject:call.ID];
+    [self.pendingAppCallIDs addObject:call.ID];
+    self.pendingAppCallTimes[call.ID] = @([NSDate timeIntervalSinceReferenceDate]);
     if (!handler) {
         // a noop handler if nil is passed in
         handler = ^(FBAppCall *call) {};
     }
     // Can immediately autorelease since adding it to self.callbacks causes a retain.
     self.callbacks[call.ID] = [Block_copy(handler) autorelease];
+
+    [self expireStalePendingAppCalls];
 }
 
 - (void)stopTrackingCallWithID:(NSString *)callID {
+    if (self.pendingAppCalls[callID]) {
+        FBTraceEnd(FBTracePointAppBridgeRoundTrip, callID.hash);
+    }
     [self.pendingAppCalls removeObjectForKey:callID];
     [self.callbacks removeObjectForKey:callID];
+    [self.pendingAppCallIDs removeObject:callID];
+    [self.pendingAppCallTimes removeObjectForKey:callID];
 
     [self deletePasteboardsForAppCallID:callID];
 }
 
-- (NSString *)jsonStringFromDictionary:(NSDictionary *)dictionary {
+- (NSData *)jsonDataFromDictionary:(NSDictionary *)dictionary converter:(FBAppBridgeTypeToJSONConverter *)converter {
     if (!dictionary) {
         return nil;
     }
-    NSDictionary *wrappedDictionary = [self.jsonConverter jsonDictionaryFromDictionaryWithAppBridgeTypes:dictionary];
-    return [FBUtility simpleJSONEncode:wrappedDictionary];
+    NSDictionary *wrappedDictionary = [converter jsonDictionaryFromDictionaryWithAppBridgeTypes:dictionary];
+    return [NSJSONSerialization dataWithJSONObject:wrappedDictionary options:0 error:NULL];
 }
 
-- (NSDictionary *)dictionaryFromJSONString:(NSString *)jsonString {
-    if (!jsonString) {
+// json is either a string or, for decrypted responses, the UTF-8 bytes
+- (NSDictionary *)dictionaryFromJSON:(id)json {
+    if (!json) {
         return nil;
     }
-    NSDictionary *jsonDictionary = [FBUtility simpleJSONDecode:jsonString];
+    NSDictionary *jsonDictionary = nil;
+    if ([json isKindOfClass:[NSData class]]) {
+        jsonDictionary = [FBUtility simpleJSONDecodeData:json error:NULL];
+    } else {
+        jsonDictionary = [FBUtility simpleJSONDecode:json];
+    }
     return [self.jsonConverter dictionaryWithAppBridgeTypesFromJSONDictionary:jsonDictionary];
 }
 
+- (NSMutableDictionary *)pasteboardNames {
+    if (!_pasteboardNames) {
+        NSDictionary *saved = [[NSUserDefaults standardUserDefaults] objectForKey:FBAppBridgePasteboardNamesKey];
+        _pasteboardNames = [saved isKindOfClass:[NSDictionary class]] ? [saved mutableCopy] : [[NSMutableDictionary alloc] init];
+    }
+    return _pasteboardNames;
+}
+
+- (void)applicationDidEnterBackground:(NSNotification *)notification {
+    if (!self.pasteboardNamesNeedSaving) {
+        return;
+    }
+    self.pasteboardNamesNeedSaving = NO;
+
+    // a single write of a snapshot, off the main thread, finished before we are suspended
+    NSDictionary *snapshot = [[self.pasteboardNames copy] autorelease];
+    UIApplication *application = [UIApplication sharedApplication];
+    __block UIBackgroundTaskIdentifier taskID = [application beginBackgroundTaskWithExpirationHandler:^{
+        [application endBackgroundTask:taskID];
+        taskID = UIBackgroundTaskInvalid;
+    }];
+    dispatch_async(FBAppBridgeSaveQueue(), ^{
+        NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
+        [userDefaults setObject:snapshot forKey:FBAppBridgePasteboardNamesKey];
+        [userDefaults synchronize];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (taskID != UIBackgroundTaskInvalid) {
+                [application endBackgroundTask:taskID];
+                taskID = UIBackgroundTaskInvalid;
+            }
+        });
+    });
+}
+
 - (void)savePasteboardNames:(NSArray *)pasteboardNames forAppCallID:(NSString *)appCallID {
     if (pasteboardNames.count == 0) {
         return;
     }
 
-    NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
-    NSMutableDictionary *dictionary = [[[userDefaults objectForKey:FBAppBridgePasteboardNamesKey] mutableCopy] autorelease];
-
-    dictionary[appCallID] = pasteboardNames;
-    [userDefaults setObject:dictionary forKey:FBAppBridgePasteboardNamesKey];
-    [userDefaults synchronize];
+    self.pasteboardNames[appCallID] = pasteboardNames;
+    self.pasteboardNamesNeedSaving = YES;
 }
 
 - (void)deletePasteboardsForAppCallID:(NSString *)appCallID {
-    NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
-    NSMutableDictionary *dictionary = [[[userDefaults objectForKey:FBAppBridgePasteboardNamesKey] mutableCopy] autorelease];
+    NSMutableDictionary *dictionary = self.pasteboardNames;
     NSArray *pasteboardNames = dictionary[appCallID];
 
     if (!pasteboardNames) {
@@ -577,9 +931,7 @@ withCompletionHandler:(FBAppCallHandler)handler {
     }
 
     [dictionary removeObjectForKey:appCallID];
-
-    [userDefaults setObject:dictionary forKey:FBAppBridgePasteboardNamesKey];
-    [userDefaults synchronize];
+    self.pasteboardNamesNeedSaving = YES;
 }
 
 + (UIImage *)appIconFromBundleInfo:(NSDictionary *)bundleInfo {
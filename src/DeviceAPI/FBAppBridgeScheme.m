@@ -60,6 +60,27 @@ static NSString *const FBAppBridgeVersions[] = {
     @"20140116",
     @"20140410",
 };
+
+// Installed versions, or NSNull when none was found, keyed by scheme prefix, method and minimum
+// version; cleared each time the app becomes active. Guarded by @synchronized(g_installedVersions).
+static NSMutableDictionary *g_installedVersions;
+
+static NSMutableDictionary *FBAppBridgeSchemeInstalledVersions(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        g_installedVersions = [[NSMutableDictionary alloc] init];
+        [[NSNotificationCenter defaultCenter] addObserverForName:UIApplicationDidBecomeActiveNotification
+                                                          object:nil
+                                                           queue:nil
+                                                      usingBlock:^(NSNotification *note) {
+                                                          @synchronized(g_installedVersions) {
+                                                              [g_installedVersions removeAllObjects];
+                                                          }
+                                                      }];
+    });
+    return g_installedVersions;
+}
+
 @implementation FBAppBridgeScheme
 
 // private init.
@@ -186,22 +207,47 @@ static NSString *const FBAppBridgeVersions[] = {
             queryParams:(NSDictionary *)queryParams
           schemeVersion:(NSString *)schemeVersion
                 version:(NSString *)version {
+    // the URL is written into one buffer; the arguments are usually most of it
+    NSString *prefix = [NSString stringWithFormat:@"%@%@://dialog/%@?", [[self class] schemePrefix], schemeVersion, method];
+    NSMutableData *urlData = [NSMutableData dataWithCapacity:prefix.length + 64];
+    [urlData appendData:[prefix dataUsingEncoding:NSUTF8StringEncoding]];
+    if (queryParams) {
+        [FBUtility appendSerializedQueryParameters:queryParams toData:urlData];
+    }
     if (version) {
-        NSMutableDictionary *mutableQueryParams = [NSMutableDictionary dictionaryWithDictionary:queryParams];
-        mutableQueryParams[@"version"] = version;
-        queryParams = mutableQueryParams;
+        if (queryParams.count) {
+            [urlData appendBytes:"&" length:1];
+        }
+        [FBUtility appendSerializedQueryParameters:@{@"version": version} toData:urlData];
     }
-    NSString *queryParamsStr = (queryParams) ? [FBUtility stringBySerializingQueryParameters:queryParams] : @"";
-    return [NSURL URLWithString:[NSString stringWithFormat:
-                                 @"%@%@://dialog/%@?%@",
-                                 [[self class] schemePrefix],
-                                 schemeVersion,
-                                 method,
-                                 queryParamsStr]];
+    return [(NSURL *)CFURLCreateWithBytes(kCFAllocatorDefault,
+                                          urlData.bytes,
+                                          (CFIndex)urlData.length,
+                                          kCFStringEncodingUTF8,
+                                          NULL) autorelease];
 }
 
 + (NSString *)installedFBNativeAppVersionForMethod:(NSString *)method
                                         minVersion:(NSString *)minVersion {
+    NSMutableDictionary *installedVersions = FBAppBridgeSchemeInstalledVersions();
+    NSString *key = [NSString stringWithFormat:@"%@|%@|%@", [self schemePrefix], method, minVersion];
+    id cachedVersion = nil;
+    @synchronized(installedVersions) {
+        cachedVersion = [[installedVersions[key] retain] autorelease];
+    }
+    if (cachedVersion) {
+        return (cachedVersion == [NSNull null]) ? nil : cachedVersion;
+    }
+
+    NSString *version = [self probeInstalledFBNativeAppVersionForMethod:method minVersion:minVersion];
+    @synchronized(installedVersions) {
+        installedVersions[key] = version ?: [NSNull null];
+    }
+    return version;
+}
+
++ (NSString *)probeInstalledFBNativeAppVersionForMethod:(NSString *)method
+                                             minVersion:(NSString *)minVersion {
     NSArray *bridgeVersions = [[self class] bridgeVersions];
     NSString *version = nil;
     for (NSInteger index = bridgeVersions.count - 1; index >= 0; index--) {
@@ -21,7 +21,9 @@
 /*!
  @abstract
  Following a call to jsonDictionaryFromDictionaryWithAppBridgeTypes:, this property
- will contain the names of any items that were put on the pasteboard.
+ will contain the names of any items that were put on the pasteboard. Data and images
+ of 32KB or more are passed this way instead of being Base64 encoded; the caller owns
+ the pasteboards and removes them once the call completes.
  */
 @property (nonatomic, retain) NSMutableArray *createdPasteboardNames;
 
@@ -19,8 +19,10 @@
 #import <UIKit/UIKit.h>
 
 #import "FBBase64.h"
+#import "FBDispatch.h"
 #import "FBError.h"
-#import "FBSettings+Internal.h"
+#import "FBMetrics.h"
+#import "FBUtility.h"
 
 /*
  jsonReadyValue: A representation of the extended type that is safe for JSON serialization.
@@ -56,19 +58,111 @@ static const struct {
 
 static NSString *const FBAppBridgeTypeIdentifier = @"com.facebook.Facebook.FBAppBridgeType";
 
+// Attachments at least this large travel as raw bytes on a named pasteboard rather than as
+// Base64 in the URL, which would grow them by a third and copy them through several strings.
+static const NSUInteger FBAppBridgePasteboardThreshold = 32 * 1024;
+
+@interface FBAppBridgeTypeToJSONConverter ()
+
+// JPEG data for the images being converted, keyed by the (non-retained) image
+@property (nonatomic, retain) NSDictionary *encodedImages;
+
+// Base64 strings for attachment data small enough to go inline, keyed by the (non-retained) data
+@property (nonatomic, retain) NSDictionary *encodedStrings;
+
+@end
+
 @implementation FBAppBridgeTypeToJSONConverter
 
 - (void)dealloc
 {
     [_createdPasteboardNames release];
+    [_encodedImages release];
+    [_encodedStrings release];
     [super dealloc];
 }
 
 - (NSDictionary *)jsonDictionaryFromDictionaryWithAppBridgeTypes:(NSDictionary *)dictionaryWithAppBridgeTypes {
+    FBMetrics *metrics = [FBMetrics sharedMetrics];
+    FBMetricsAllocationSample allocationSample;
+    [metrics beginAllocationSample:&allocationSample];
     self.createdPasteboardNames = [NSMutableArray array];
 
-    return [self convertedDictionaryFromDictionary:dictionaryWithAppBridgeTypes
-                                  convertingToJSON:YES];
+    // Encode all the attachments up front so that several of them get encoded in
+    // parallel rather than one after the other; the JSON is then assembled from the results
+    NSMutableArray *attachments = [NSMutableArray array];
+    [self addAttachmentsFromObject:dictionaryWithAppBridgeTypes toArray:attachments];
+    if (attachments.count) {
+        [self encodeAttachments:attachments];
+    }
+
+    [metrics updateAllocationSample:&allocationSample];
+
+    NSDictionary *jsonDictionary = [self convertedDictionaryFromDictionary:dictionaryWithAppBridgeTypes
+                                                          convertingToJSON:YES];
+    self.encodedImages = nil;
+    self.encodedStrings = nil;
+    [metrics endAllocationSample:&allocationSample metric:FBMetricAppBridgeEncodingPeakBytes];
+
+    return jsonDictionary;
+}
+
+- (void)addAttachmentsFromObject:(id)object toArray:(NSMutableArray *)attachments {
+    if ([object isKindOfClass:[NSDictionary class]]) {
+        for (id value in [(NSDictionary *)object objectEnumerator]) {
+            [self addAttachmentsFromObject:value toArray:attachments];
+        }
+    } else if ([object isKindOfClass:[NSArray class]]) {
+        for (id value in (NSArray *)object) {
+            [self addAttachmentsFromObject:value toArray:attachments];
+        }
+    } else if ([object isKindOfClass:[UIImage class]] || [object isKindOfClass:[NSData class]]) {
+        [attachments addObject:object];
+    }
+}
+
+- (void)encodeAttachments:(NSArray *)attachments {
+    NSUInteger count = attachments.count;
+    NSData **data = calloc(count, sizeof(NSData *));
+    NSString **strings = calloc(count, sizeof(NSString *));
+
+    // Each iteration only writes its own slots, so no locking is needed. Large attachments
+    // go on a pasteboard while the JSON is assembled, so they are not Base64 encoded here.
+    // Worker threads only drain their pools now and then, so each attachment's
+    // temporaries, such as the bitmap of an image being compressed, go with it.
+    dispatch_apply(count, FBDispatchGetGlobalQueue(FBDispatchLaneUserInteractive), ^(size_t i) {
+        @autoreleasepool {
+            id attachment = [attachments objectAtIndex:i];
+            if ([attachment isKindOfClass:[UIImage class]]) {
+                data[i] = [[FBUtility JPEGDataForUploadImage:attachment] retain];
+            } else {
+                data[i] = [attachment retain];
+            }
+            if (data[i] && data[i].length < FBAppBridgePasteboardThreshold) {
+                strings[i] = [FBEncodeBase64(data[i]) retain];
+            }
+        }
+    });
+
+    NSMutableDictionary *encodedImages = [NSMutableDictionary dictionary];
+    NSMutableDictionary *encodedStrings = [NSMutableDictionary dictionary];
+    for (NSUInteger i = 0; i < count; i++) {
+        id attachment = [attachments objectAtIndex:i];
+        if ([attachment isKindOfClass:[UIImage class]]) {
+            encodedImages[[NSValue valueWithNonretainedObject:attachment]] = data[i] ?: [NSNull null];
+        }
+        if (strings[i]) {
+            encodedStrings[[NSValue valueWithNonretainedObject:data[i]]] = strings[i];
+        }
+        [data[i] release];
+        [strings[i] release];
+    }
+    free(data);
+    free(strings);
+
+    // encodedImages keeps the JPEG data, and so the keys of encodedStrings, alive
+    self.encodedImages = encodedImages;
+    self.encodedStrings = encodedStrings;
 }
 
 - (NSDictionary *)dictionaryWithAppBridgeTypesFromJSONDictionary:(NSDictionary *)jsonDictionary {
@@ -88,15 +182,28 @@ static NSString *const FBAppBridgeTypeIdentifier = @"com.facebook.Facebook.FBApp
     } else if ([object isKindOfClass:[NSArray class]]) {
         return [self convertedArrayFromArray:(NSArray *)object
                             convertingToJSON:convertingToJSON];
-    } else if (convertingToJSON) {
-        if ([object isKindOfClass:[NSData class]]) {
-            return [self jsonFromData:(NSData *)object
-                                  tag:FBAppBridgeTypesTags.data];
-        } else if ([object isKindOfClass:[UIImage class]]) {
-            UIImage *image = (UIImage *)object;
-            return [self jsonFromData:UIImageJPEGRepresentation(image, [FBSettings defaultJPEGCompressionQuality])
-                                  tag:FBAppBridgeTypesTags.png];
+    } else if (convertingToJSON &&
+               ([object isKindOfClass:[NSData class]] || [object isKindOfClass:[UIImage class]])) {
+        // An attachment's temporaries (a JPEG encoded here, a pasteboard, Base64
+        // not done up front) are dropped as soon as its JSON is ready
+        NSMutableDictionary *json = nil;
+        @autoreleasepool {
+            if ([object isKindOfClass:[NSData class]]) {
+                json = [[self jsonFromData:(NSData *)object
+                                       tag:FBAppBridgeTypesTags.data] retain];
+            } else {
+                UIImage *image = (UIImage *)object;
+                id imageData = self.encodedImages[[NSValue valueWithNonretainedObject:image]];
+                if (!imageData) {
+                    imageData = [FBUtility JPEGDataForUploadImage:image];
+                } else if (imageData == [NSNull null]) {
+                    imageData = nil;
+                }
+                json = [[self jsonFromData:imageData
+                                       tag:FBAppBridgeTypesTags.png] retain];
+            }
         }
+        return [json autorelease];
     }
 
     // If we don't have special processing, return the same object
@@ -105,20 +212,26 @@ static NSString *const FBAppBridgeTypeIdentifier = @"com.facebook.Facebook.FBApp
 
 - (NSDictionary *)convertedDictionaryFromDictionary:(NSDictionary *)dictionary
                                    convertingToJSON:(BOOL)convertingToJSON {
-    NSArray *keys = [dictionary allKeys];
-    if (!keys.count) {
-        return dictionary;
-    }
-    NSMutableDictionary *convertedDictionary = [NSMutableDictionary dictionary];
-    for (id key in keys) {
-        id convertedObject = [self convertedObjectFromObject:dictionary[key]
+    // Most of a payload (Open Graph objects, strings, numbers) needs no conversion, so a copy is
+    // only made once something actually changes, and untouched subtrees are shared as they are
+    __block NSMutableDictionary *convertedDictionary = nil;
+    [dictionary enumerateKeysAndObjectsUsingBlock:^(id key, id object, BOOL *stop) {
+        id convertedObject = [self convertedObjectFromObject:object
                                             convertingToJSON:convertingToJSON];
+        if (convertedObject == object) {
+            return;
+        }
+        if (!convertedDictionary) {
+            convertedDictionary = [NSMutableDictionary dictionaryWithDictionary:dictionary];
+        }
         if (convertedObject) {
             convertedDictionary[key] = convertedObject;
+        } else {
+            [convertedDictionary removeObjectForKey:key];
         }
-    }
+    }];
 
-    return convertedDictionary;
+    return convertedDictionary ?: dictionary;
 }
 
 - (NSArray *)convertedArrayFromArray:(NSArray *)array convertingToJSON:(BOOL)convertingToJSON {
@@ -127,24 +240,38 @@ static NSString *const FBAppBridgeTypeIdentifier = @"com.facebook.Facebook.FBApp
         return array;
     }
 
-    NSMutableArray *convertedArray = [NSMutableArray arrayWithCapacity:length];
-    for (int i = 0; i < length; i++) {
-        id convertedObject = [self convertedObjectFromObject:array[i]
+    NSMutableArray *convertedArray = nil;
+    for (NSUInteger i = 0; i < length; i++) {
+        id object = array[i];
+        id convertedObject = [self convertedObjectFromObject:object
                                             convertingToJSON:convertingToJSON];
-        if (convertedObject) {
-            convertedArray[i] = convertedObject;
-        } else {
-            convertedArray[i] = [NSNull null];
+        if (convertedObject == object) {
+            continue;
+        }
+        if (!convertedArray) {
+            convertedArray = [NSMutableArray arrayWithArray:array];
         }
+        convertedArray[i] = convertedObject ?: [NSNull null];
     }
 
-    return convertedArray;
+    return convertedArray ?: array;
 }
 
 - (NSMutableDictionary *)jsonFromData:(NSData *)data tag:(NSString *)tag {
     NSMutableDictionary *json = [NSMutableDictionary dictionary];
-    NSString *jsonReadyValue = FBEncodeBase64(data);
-    json[FBAppBridgeTypesMetadata.isBase64] = [NSNumber numberWithBool:YES];
+    NSString *jsonReadyValue = nil;
+    if (data.length >= FBAppBridgePasteboardThreshold) {
+        jsonReadyValue = [self pasteboardNameForData:data];
+    }
+    if (jsonReadyValue) {
+        json[FBAppBridgeTypesMetadata.isPasteboard] = [NSNumber numberWithBool:YES];
+    } else {
+        jsonReadyValue = data ? self.encodedStrings[[NSValue valueWithNonretainedObject:data]] : nil;
+        if (!jsonReadyValue) {
+            jsonReadyValue = FBEncodeBase64(data);
+        }
+        json[FBAppBridgeTypesMetadata.isBase64] = [NSNumber numberWithBool:YES];
+    }
 
     json[FBAppBridgeTypesMetadata.tag] = tag ?: @"";
     json[FBAppBridgeTypesMetadata.jsonReadyValue] = jsonReadyValue ?: @"";
@@ -152,6 +279,23 @@ static NSString *const FBAppBridgeTypeIdentifier = @"com.facebook.Facebook.FBApp
     return json;
 }
 
+// Puts data on a new pasteboard and returns its name, or nil if the pasteboard could not be created.
+- (NSString *)pasteboardNameForData:(NSData *)data {
+    NSString *uuid = [FBUtility newUUIDString];
+    NSString *name = [NSString stringWithFormat:@"%@.%@", FBAppBridgeTypeIdentifier, uuid];
+    [uuid release];
+
+    UIPasteboard *board = [UIPasteboard pasteboardWithName:name create:YES];
+    if (!board) {
+        return nil;
+    }
+    // the receiving app reads it after we leave the foreground
+    board.persistent = YES;
+    [board setData:data forPasteboardType:FBAppBridgeTypeIdentifier];
+    [self.createdPasteboardNames addObject:board.name];
+    return board.name;
+}
+
 + (instancetype)appBridgeTypeFromJSON:(NSDictionary *)dictionary {
     NSString *jsonReadyValue = dictionary[FBAppBridgeTypesMetadata.jsonReadyValue];
     NSNumber *hasBase64 = dictionary[FBAppBridgeTypesMetadata.isBase64];
@@ -162,7 +306,7 @@ static NSString *const FBAppBridgeTypeIdentifier = @"com.facebook.Facebook.FBApp
     } else if (hasPasteboard) {
         UIPasteboard *board = [UIPasteboard pasteboardWithName:jsonReadyValue create:NO];
         if (board) {
-            appBridgeType = [board valueForPasteboardType:FBAppBridgeTypeIdentifier];
+            appBridgeType = [board dataForPasteboardType:FBAppBridgeTypeIdentifier];
             [UIPasteboard removePasteboardWithName:board.name];
         }
     }
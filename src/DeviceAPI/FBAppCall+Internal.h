@@ -16,6 +16,8 @@
 
 #import "FBAppCall.h"
 
+@class FBAppBridgePreparedCall;
+
 @interface FBAppCall (Internal)
 
 // Defined here for the rest of the SDK to use
@@ -28,6 +30,9 @@
 @property (nonatomic, readwrite, retain) FBAppLinkData *appLinkData;
 @property (nonatomic, readwrite, retain) FBAccessTokenData *accessTokenData;
 
+// Set while the call has been prepared by FBAppBridge but not yet dispatched
+@property (nonatomic, retain) FBAppBridgePreparedCall *preparedBridgeCall;
+
 - (instancetype)initWithID:(NSString *)ID;
 
 /*!
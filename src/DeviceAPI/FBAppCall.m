@@ -21,10 +21,12 @@
 #import "FBAppEvents+Internal.h"
 #import "FBAppEvents.h"
 #import "FBAppLinkData+Internal.h"
+#import "FBBackgroundUploader.h"
 #import "FBDialogsData+Internal.h"
 #import "FBError.h"
 #import "FBGraphObject.h"
 #import "FBLogger.h"
+#import "FBMainThreadWatchdog.h"
 #import "FBRequest.h"
 #import "FBSession+Internal.h"
 #import "FBSessionUtility.h"
@@ -43,6 +45,12 @@
 @property (nonatomic, readwrite, retain) FBDialogsData *dialogData;
 @property (nonatomic, readwrite, retain) FBAppLinkData *appLinkData;
 @property (nonatomic, readwrite, retain) FBAccessTokenData *accessTokenData;
+@property (nonatomic, retain) FBAppBridgePreparedCall *preparedBridgeCall;
+
++ (BOOL)routeOpenURL:(NSURL *)url
+   sourceApplication:(NSString *)sourceApplication
+         withSession:(FBSession *)session
+     fallbackHandler:(FBAppCallHandler)handler;
 
 @end
 
@@ -166,6 +174,7 @@ NSString *const FBDeferredAppLinkEvent = @"DEFERRED_APP_LINK";
     [_dialogData release];
     [_appLinkData release];
     [_accessTokenData release];
+    [_preparedBridgeCall release];
 
     [super dealloc];
 }
@@ -255,6 +264,22 @@ NSString *const FBDeferredAppLinkEvent = @"DEFERRED_APP_LINK";
     sourceApplication:(NSString *)sourceApplication
           withSession:(FBSession *)session
       fallbackHandler:(FBAppCallHandler)handler {
+    FBMainThreadWatchdogMeasure();
+    // Each handler the URL is offered to below reads its parameters
+    __block BOOL handled = NO;
+    [FBUtility parseQueryParamsOnceForURL:url during:^{
+        handled = [FBAppCall routeOpenURL:url
+                        sourceApplication:sourceApplication
+                              withSession:session
+                          fallbackHandler:handler];
+    }];
+    return handled;
+}
+
++ (BOOL)routeOpenURL:(NSURL *)url
+   sourceApplication:(NSString *)sourceApplication
+         withSession:(FBSession *)session
+     fallbackHandler:(FBAppCallHandler)handler {
     FBSession *workingSession = session ?: FBSession.activeSessionIfExists;
 
     // Wrap the fallback handler to intercept login flow for FBSession
@@ -377,6 +402,15 @@ NSString *const FBDeferredAppLinkEvent = @"DEFERRED_APP_LINK";
     }
 }
 
++ (BOOL)handleEventsForBackgroundURLSession:(NSString *)identifier
+                          completionHandler:(void (^)(void))completionHandler {
+    if (![FBBackgroundUploader isAvailable]) {
+        return NO;
+    }
+    return [[FBBackgroundUploader sharedUploader] handleEventsForBackgroundURLSession:identifier
+                                                                    completionHandler:completionHandler];
+}
+
 + (BOOL)tryOpenSession:(FBSession *)session
        withAccessToken:(FBAccessTokenData *)accessToken {
     if (!accessToken) {
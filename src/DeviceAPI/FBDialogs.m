@@ -306,6 +306,65 @@
                                                      handler:handler];
 }
 
++ (FBAppCall *)prepareShareDialogWithParams:(FBDialogsParams *)params
+                                clientState:(NSDictionary *)clientState {
+    if ([FBSettings restrictedTreatment] != FBRestrictedTreatmentNO) {
+        return nil;
+    }
+
+    FBAppBridgeScheme *bridgeScheme = nil;
+    NSString *method = @"share";
+    if ([params isKindOfClass:[FBOpenGraphActionParams class]]) {
+        FBOpenGraphActionParams *actionParams = (FBOpenGraphActionParams *)params;
+        bridgeScheme = [FBAppBridgeScheme bridgeSchemeForFBAppForOpenGraphActionShareDialogParams:actionParams];
+        actionParams.bridgeScheme = bridgeScheme;
+        method = @"ogshare";
+    } else if ([params isKindOfClass:[FBPhotoParams class]]) {
+        bridgeScheme = [FBAppBridgeScheme bridgeSchemeForFBAppForShareDialogPhotos];
+    } else if ([params isKindOfClass:[FBLinkShareParams class]]) {
+        bridgeScheme = [FBAppBridgeScheme bridgeSchemeForFBAppForShareDialogParams:(FBLinkShareParams *)params];
+    }
+    if (!bridgeScheme || [params validate]) {
+        return nil;
+    }
+
+    FBDialogsData *dialogData = [[[FBDialogsData alloc] initWithMethod:method
+                                                             arguments:[params dictionaryMethodArgs]]
+                                 autorelease];
+    dialogData.clientState = clientState;
+
+    FBAppCall *call = [[[FBAppCall alloc] init] autorelease];
+    call.dialogData = dialogData;
+    [[FBAppBridge sharedInstance] prepareDialogAppCall:call bridgeScheme:bridgeScheme session:nil];
+    call.preparedBridgeCall.presentationEventName = [[self class] eventNameForParams:params bridgeScheme:bridgeScheme];
+    return call.preparedBridgeCall ? call : nil;
+}
+
++ (FBAppCall *)presentPreparedShareDialog:(FBAppCall *)call
+                                  handler:(FBDialogAppCallCompletionHandler)handler {
+    FBAppBridgePreparedCall *preparedCall = call.preparedBridgeCall;
+    if (!preparedCall) {
+        return nil;
+    }
+    if ([FBDialogs cancelAppCallBecauseOfRestrictedTreatment:handler]) {
+        return nil;
+    }
+
+    [[FBAppBridge sharedInstance] dispatchDialogAppCall:call
+                                           bridgeScheme:preparedCall.bridgeScheme
+                                                session:nil
+                                      completionHandler:^(FBAppCall *call) {
+                                          if (handler) {
+                                              handler(call, call.dialogData.results, call.error);
+                                          }
+                                      }];
+    [FBAppEvents logImplicitEvent:preparedCall.presentationEventName
+                       valueToSum:nil
+                       parameters:@{ FBAppEventParameterDialogOutcome : FBAppEventsDialogOutcomeValue_Completed }
+                          session:nil];
+    return call;
+}
+
 + (FBAppCall *)presentShareDialogWithParams:(FBDialogsParams *)params
                                bridgeScheme:(FBAppBridgeScheme *)bridgeScheme
                                 clientState:(NSDictionary *)clientState
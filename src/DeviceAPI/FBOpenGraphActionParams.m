@@ -149,7 +149,7 @@ NSString *const FBPostObject = @"fbsdk:create_object";
 }
 
 - (id)flattenGraphObjects:(id)dict {
-    NSMutableDictionary *flattened = [[[NSMutableDictionary alloc] initWithDictionary:dict] autorelease];
+    NSMutableDictionary *flattened = [[[NSMutableDictionary alloc] initWithCapacity:[dict count]] autorelease];
     for (NSString *key in dict) {
         id value = [dict objectForKey:key];
         // Since flattenGraphObjects is only called for the OG action AND image is a special
@@ -183,21 +183,22 @@ NSString *const FBPostObject = @"fbsdk:create_object";
 
 - (BOOL)containsUIImages:(id)param
 {
-    BOOL containsUIImages = NO;
-    NSArray *values = nil;
+    // stops at the first image rather than walking the rest of the action
+    if ([param isKindOfClass:[UIImage class]]) {
+        return YES;
+    }
+    id<NSFastEnumeration> values = nil;
     if ([param isKindOfClass:[NSDictionary class]]) {
-        values = ((NSDictionary *)param).allValues;
+        values = [(NSDictionary *)param objectEnumerator];
     } else if ([param isKindOfClass:[NSArray class]]) {
         values = param;
-    } else if ([param isKindOfClass:[UIImage class]]) {
-        return YES;
     }
-    if (values) {
-        for (id value in values) {
-            containsUIImages = containsUIImages || [self containsUIImages:value];
+    for (id value in values) {
+        if ([self containsUIImages:value]) {
+            return YES;
         }
     }
-    return containsUIImages;
+    return NO;
 }
 
 @end
@@ -200,6 +200,22 @@ typedef void (^FBAppLinkFallbackHandler)(NSError *error);
  */
 + (void)handleDidBecomeActiveWithSession:(FBSession *)session;
 
+/*!
+ @abstract
+ Call this method from the application delegate's
+ application:handleEventsForBackgroundURLSession:completionHandler: when
+ `[FBSettings enableBackgroundUploads:]` is on. The SDK reconciles the uploads it handed the
+ system and calls completionHandler once the session's events have been delivered.
+
+ @param identifier The identifier passed to the application delegate.
+
+ @param completionHandler The completion handler passed to the application delegate.
+
+ @return YES if the session was the SDK's, NO if the app should handle it itself.
+ */
++ (BOOL)handleEventsForBackgroundURLSession:(NSString *)identifier
+                          completionHandler:(void (^)(void))completionHandler;
+
 /*!
  @abstract
  Call this method from the main thread to fetch deferred applink data. This may require
@@ -448,5 +448,43 @@ FBSDK_EXTERN NSString *const FBAppEventParameterValueNo;
  */
 + (void)flush;
 
+/*
+ * Control over high-frequency events
+ */
+
+/*!
+
+ @method
+
+ @abstract
+ Merge identical events with the given name between flushes, rather than sending each one.
+
+ @discussion
+ Events with the same name and parameters are sent as a single event carrying an `_eventCount` parameter with
+ how many were logged, the sum of their `valueToSum`, and the log time of the first.  Merged events are written
+ to storage when they're flushed or the app leaves the active state, rather than as each is logged.
+
+ @param aggregatesEvents   Whether to merge events with this name.  Defaults to NO.
+
+ @param eventName          The name of the event, as passed to `logEvent:`.
+ */
++ (void)setAggregatesEvents:(BOOL)aggregatesEvents forEventName:(NSString *)eventName;
+
+/*!
+
+ @method
+
+ @abstract
+ Only record the given fraction of events with the given name.
+
+ @discussion
+ Each event is kept at random with the given probability, and those kept carry a `_samplingRate` parameter so
+ that counts can be scaled back up.  Sampling happens before any aggregation.
+
+ @param samplingRate   Between 0 and 1.  1, the default, keeps every event.
+
+ @param eventName      The name of the event, as passed to `logEvent:`.
+ */
++ (void)setSamplingRate:(double)samplingRate forEventName:(NSString *)eventName;
 
 @end
@@ -31,18 +31,45 @@
  */
 @interface FBAppLinkResolver : NSObject<BFAppLinkResolving>
 
+/*!
+ @abstract
+ The queue that server responses are turned into App Links on, and that the tasks returned
+ by this resolver are completed from.
+
+ @discussion
+ Defaults to a serial background queue shared by all resolvers, so large batches are not
+ processed on the main thread. Set it before resolving, to a serial queue; continuations
+ that update the UI should use `[BFExecutor mainThreadExecutor]`.
+ */
+@property (nonatomic, assign) dispatch_queue_t processingQueue;
+
 /*!
  @abstract Asynchronously resolves App Link data for multiple URLs.
 
  @param urls An array of NSURLs to resolve into App Links.
  @returns A BFTask that will return dictionary mapping input NSURLs to their
-  corresponding BFAppLink.
+  corresponding BFAppLink. URLs that could not be resolved are left out of the dictionary;
+  the task only fails when none of the URLs could be resolved.
 
  @discussion
  You should set the client token before making this call. See `[FBSettings setClientToken:]`
  */
 - (BFTask *)appLinksFromURLsInBackground:(NSArray *)urls;
 
+/*!
+ @abstract Resolves App Links ahead of need, for URLs that are about to be shown.
+
+ @param urls An array of NSURLs that the user may soon tap.
+
+ @discussion
+ Resolved App Links are kept in a cache shared by all resolvers, so a later call to
+ `appLinkFromURLInBackground:` for one of these URLs can usually complete without a round trip.
+ Prefetches made in quick succession, from any resolver, are gathered into one lookup. URLs that
+ are already resolved or being resolved are skipped, and at most a hundred URLs a minute are
+ prefetched; the rest are ignored, so this may be called freely, for instance as table cells appear.
+ */
+- (void)prefetchAppLinksForURLs:(NSArray *)urls;
+
 /*!
  @abstract Allocates and initializes a new instance of FBAppLinkResolver.
  */
@@ -23,7 +23,12 @@
 #import <Bolts/BFTask.h>
 #import <Bolts/BFTaskCompletionSource.h>
 
+#import "FBAppLinkCache.h"
+#import "FBDispatch.h"
+#import "FBError.h"
+#import "FBMetrics.h"
 #import "FBRequest+Internal.h"
+#import "FBRequestConnection+Internal.h"
 #import "FBRequestConnection.h"
 #import "FBSettings.h"
 #import "FBUtility.h"
@@ -37,54 +42,233 @@ static NSString *const kIPhoneKey = @"iphone";
 static NSString *const kIPadKey = @"ipad";
 static NSString *const kShouldFallbackKey = @"should_fallback";
 
+// Keeps each request's URL well short of what the server accepts
+static const NSUInteger kMaximumURLsPerRequest = 50;
+static const NSUInteger kMaximumIdsLength = 1500;
+
+// The completion source of each URL being resolved, from the disk cache lookup until the server
+// answers, so overlapping calls attach to it rather than looking the URL up again.  Guarded by
+// @synchronized ([FBAppLinkResolver class]).
+static NSMutableDictionary *g_inFlightLinks = nil;
+
+// Prefetches are gathered for this long before being looked up together
+static const NSTimeInterval kPrefetchDelay = 0.25;
+// At most this many URLs are prefetched per kPrefetchBudgetInterval
+static const NSUInteger kPrefetchBudget = 100;
+static const NSTimeInterval kPrefetchBudgetInterval = 60;
+
+// Prefetch state, guarded by @synchronized ([FBAppLinkResolver class]).  The URLs waiting to be
+// looked up are kept per user interface idiom, as NSMutableOrderedSets.
+static NSMutableDictionary *g_pendingPrefetches = nil;
+static BOOL g_prefetchScheduled = NO;
+static NSTimeInterval g_prefetchBudgetStart = 0;
+static NSUInteger g_prefetchBudgetUsed = 0;
+
+static dispatch_queue_t FBAppLinkResolverDefaultProcessingQueue(void) {
+    static dispatch_queue_t queue = NULL;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        queue = FBDispatchQueueCreateSerial("com.facebook.sdk.FBAppLinkResolver", FBDispatchLaneUtility);
+    });
+    return queue;
+}
+
+static NSString *FBAppLinkResolverInFlightKey(NSURL *url, UIUserInterfaceIdiom idiom) {
+    return [NSString stringWithFormat:@"%ld|%@", (long)idiom, url.absoluteString];
+}
+
+// Only a server that turned the lookup down is worth believing for a while; timeouts, being
+// offline and server trouble say nothing about the URL.
+static BOOL FBAppLinkResolverIsPermanentError(NSError *error) {
+    NSInteger statusCode = [[error.userInfo objectForKey:FBErrorHTTPStatusCodeKey] integerValue];
+    return statusCode >= 400 && statusCode <= 499;
+}
+
 @interface FBAppLinkResolver ()
 
-@property (nonatomic, strong) NSMutableDictionary *cachedLinks;
 @property (nonatomic, assign) UIUserInterfaceIdiom userInterfaceIdiom;
 @end
 
-@implementation FBAppLinkResolver
+@implementation FBAppLinkResolver {
+    dispatch_queue_t _processingQueue;
+}
 
 - (id)initWithUserInterfaceIdiom:(UIUserInterfaceIdiom)userInterfaceIdiom {
     if (self = [super init]) {
-        self.cachedLinks = [NSMutableDictionary dictionary];
         self.userInterfaceIdiom = userInterfaceIdiom;
+        self.processingQueue = FBAppLinkResolverDefaultProcessingQueue();
     }
     return self;
 }
 
 - (void)dealloc {
-    [_cachedLinks release];
+    if (_processingQueue) {
+        dispatch_release(_processingQueue);
+    }
     [super dealloc];
 }
 
+- (dispatch_queue_t)processingQueue {
+    return _processingQueue;
+}
+
+- (void)setProcessingQueue:(dispatch_queue_t)processingQueue {
+    if (processingQueue) {
+        dispatch_retain(processingQueue);
+    }
+    if (_processingQueue) {
+        dispatch_release(_processingQueue);
+    }
+    _processingQueue = processingQueue;
+}
+
 - (BFTask *)appLinksFromURLsInBackground:(NSArray *)urls {
     if (![FBSettings clientToken]) {
         [FBLogger singleShotLogEntry:FBLoggingBehaviorDeveloperErrors
                             logEntry:@"clientToken is missing for FBAppLinkResolver"];
     }
+    FBAppLinkCache *cache = [FBAppLinkCache sharedCache];
+    UIUserInterfaceIdiom idiom = self.userInterfaceIdiom;
     NSMutableDictionary *appLinks = [NSMutableDictionary dictionary];
     NSMutableArray *toFind = [NSMutableArray array];
-    NSMutableArray *toFindStrings = [NSMutableArray array];
+    NSError *firstError = nil;
     for (NSURL *url in urls) {
-        @synchronized (self.cachedLinks) {
-            if (self.cachedLinks[url]) {
-                appLinks[url] = self.cachedLinks[url];
-            } else {
-                [toFind addObject:url];
-                [toFindStrings addObject:[FBUtility stringByURLEncodingString:url.absoluteString]];
-            }
+        NSError *error = [cache errorForURL:url idiom:idiom];
+        if (error) {
+            // This URL failed a moment ago; asking again so soon would fail too
+            firstError = firstError ?: error;
+            continue;
+        }
+        BFAppLink *link = [cache appLinkForURL:url idiom:idiom];
+        if (link) {
+            appLinks[url] = link;
+        } else {
+            [toFind addObject:url];
         }
     }
     if (toFind.count == 0) {
-        // All of the URLs have already been found.
+        // All of the URLs have already been found, or have failed.
+        if (appLinks.count == 0 && firstError) {
+            return [BFTask taskWithError:firstError];
+        }
         return [BFTask taskWithResult:appLinks];
     }
+
+    // Attach to the resolutions already under way, and take on the rest
+    NSMutableArray *linkURLs = [NSMutableArray arrayWithCapacity:toFind.count];
+    NSMutableArray *linkTasks = [NSMutableArray arrayWithCapacity:toFind.count];
+    NSMutableArray *toLookUp = [NSMutableArray array];
+    NSMutableArray *linkSources = [NSMutableArray array];
+    @synchronized ([FBAppLinkResolver class]) {
+        if (!g_inFlightLinks) {
+            g_inFlightLinks = [[NSMutableDictionary alloc] init];
+        }
+        for (NSURL *url in toFind) {
+            NSString *key = FBAppLinkResolverInFlightKey(url, idiom);
+            BFTaskCompletionSource *linkSource = g_inFlightLinks[key];
+            if (!linkSource) {
+                // A resolution that finished since the lookup above has cached its link by now
+                BFAppLink *link = [cache appLinkForURL:url idiom:idiom];
+                if (link) {
+                    appLinks[url] = link;
+                    continue;
+                }
+                linkSource = [BFTaskCompletionSource taskCompletionSource];
+                g_inFlightLinks[key] = linkSource;
+                [toLookUp addObject:url];
+                [linkSources addObject:linkSource];
+            }
+            [linkURLs addObject:url];
+            [linkTasks addObject:linkSource.task];
+        }
+    }
+
+    if (toLookUp.count) {
+        [self lookUpAppLinksFromURLs:toLookUp linkSources:linkSources];
+    }
+
+    BFTaskCompletionSource *tcs = [BFTaskCompletionSource taskCompletionSource];
+    [firstError retain];
+    [[BFTask taskForCompletionOfAllTasks:linkTasks] continueWithBlock:^id(BFTask *task) {
+        NSError *error = [firstError autorelease];
+        for (NSUInteger i = 0; i < linkTasks.count; i++) {
+            BFTask *linkTask = linkTasks[i];
+            if (linkTask.error) {
+                error = error ?: linkTask.error;
+            } else if (linkTask.result) {
+                appLinks[linkURLs[i]] = linkTask.result;
+            }
+        }
+        // One URL failing doesn't fail the others
+        if (appLinks.count == 0 && error) {
+            [tcs setError:error];
+        } else {
+            [tcs setResult:appLinks];
+        }
+        return nil;
+    }];
+    return tcs.task;
+}
+
+// Resolves URLs this call took on, first from the disk cache, then from the server
+- (void)lookUpAppLinksFromURLs:(NSArray *)urls linkSources:(NSArray *)linkSources {
+    UIUserInterfaceIdiom idiom = self.userInterfaceIdiom;
+    [[FBAppLinkCache sharedCache] persistedAppLinksForURLs:urls idiom:idiom completion:^(NSDictionary *persistedLinks) {
+        NSMutableArray *toRequest = [NSMutableArray arrayWithCapacity:urls.count];
+        NSMutableArray *requestSources = [NSMutableArray arrayWithCapacity:urls.count];
+        for (NSUInteger i = 0; i < urls.count; i++) {
+            NSURL *url = urls[i];
+            BFAppLink *link = persistedLinks[url];
+            if (link) {
+                [FBAppLinkResolver finishResolvingURL:url idiom:idiom linkSource:linkSources[i] link:link timeToLive:0 error:nil];
+            } else {
+                [toRequest addObject:url];
+                [requestSources addObject:linkSources[i]];
+            }
+        }
+        if (toRequest.count) {
+            [self requestAppLinksFromURLs:toRequest linkSources:requestSources];
+        }
+    }];
+}
+
+// The link or error is cached before the resolution stops being in flight, so anyone who
+// no longer finds it in flight finds it in the cache.  Links are only cached for a positive
+// timeToLive; those from the disk cache already are, and are passed 0.  Only permanent
+// errors are cached.
++ (void)finishResolvingURL:(NSURL *)url
+                     idiom:(UIUserInterfaceIdiom)idiom
+                linkSource:(BFTaskCompletionSource *)linkSource
+                      link:(BFAppLink *)link
+                timeToLive:(NSTimeInterval)timeToLive
+                     error:(NSError *)error {
+    FBAppLinkCache *cache = [FBAppLinkCache sharedCache];
+    if (error) {
+        if (FBAppLinkResolverIsPermanentError(error)) {
+            [cache setError:error forURL:url idiom:idiom];
+        }
+    } else if (link && timeToLive > 0) {
+        [cache setAppLink:link forURL:url idiom:idiom timeToLive:timeToLive];
+    }
+    @synchronized ([FBAppLinkResolver class]) {
+        [g_inFlightLinks removeObjectForKey:FBAppLinkResolverInFlightKey(url, idiom)];
+    }
+    if (error) {
+        [linkSource setError:error];
+    } else {
+        [linkSource setResult:link];
+    }
+}
+
+// Asks the server for the URLs' app links, split into requests of bounded length,
+// which go out together as one batch
+- (void)requestAppLinksFromURLs:(NSArray *)urls linkSources:(NSArray *)linkSources {
+    UIUserInterfaceIdiom idiom = self.userInterfaceIdiom;
     NSMutableArray *fields = [NSMutableArray arrayWithObject:kIOSKey];
 
     NSString *idiomSpecificField = nil;
 
-    switch (self.userInterfaceIdiom) {
+    switch (idiom) {
         case UIUserInterfaceIdiomPad:
             idiomSpecificField = kIPadKey;
             break;
@@ -97,55 +281,149 @@ static NSString *const kShouldFallbackKey = @"should_fallback";
     if (idiomSpecificField) {
         [fields addObject:idiomSpecificField];
     }
-    NSString *path = [NSString stringWithFormat:@"?type=al&fields=%@&ids=%@",
-                      [fields componentsJoinedByString:@","],
-                      [toFindStrings componentsJoinedByString:@","]];
-    FBRequest *request = [[[FBRequest alloc] initWithSession:nil
-                                                   graphPath:path
-                                                  parameters:nil
-                                                  HTTPMethod:@"GET"] autorelease];
-    [request overrideVersionPartWith:@""];
-    BFTaskCompletionSource *tcs = [BFTaskCompletionSource taskCompletionSource];
-    [request startWithCompletionHandler:^(FBRequestConnection *connection, id result, NSError *error) {
-        if (error) {
-            [tcs setError:error];
-            return;
-        }
-        for (NSURL *url in toFind) {
-            id nestedObject = [result objectForKey:url.absoluteString];
-            NSMutableArray *rawTargets = [NSMutableArray array];
-            if (idiomSpecificField) {
-                [rawTargets addObjectsFromArray:[nestedObject objectForKey:idiomSpecificField]];
+    NSString *fieldsString = [fields componentsJoinedByString:@","];
+
+    FBRequestConnection *resolveConnection = [[[FBRequestConnection alloc] init] autorelease];
+    resolveConnection.networkFeature = FBNetworkFeatureAppLinkResolver;
+    resolveConnection.completionQueue = self.processingQueue;
+
+    NSUInteger chunkStart = 0;
+    while (chunkStart < urls.count) {
+        // Each chunk gets at least one URL, however long it is
+        NSMutableArray *idStrings = [NSMutableArray array];
+        NSUInteger idsLength = 0;
+        NSUInteger chunkEnd = chunkStart;
+        while (chunkEnd < urls.count && idStrings.count < kMaximumURLsPerRequest) {
+            NSString *idString = [FBUtility stringByURLEncodingString:[urls[chunkEnd] absoluteString]];
+            if (idStrings.count && idsLength + idString.length + 1 > kMaximumIdsLength) {
+                break;
             }
-            [rawTargets addObjectsFromArray:[nestedObject objectForKey:kIOSKey]];
+            [idStrings addObject:idString];
+            idsLength += idString.length + 1;
+            chunkEnd++;
+        }
+        NSRange chunkRange = NSMakeRange(chunkStart, chunkEnd - chunkStart);
+        NSArray *chunkURLs = [urls subarrayWithRange:chunkRange];
+        NSArray *chunkSources = [linkSources subarrayWithRange:chunkRange];
+        chunkStart = chunkEnd;
 
-            NSMutableArray *targets = [NSMutableArray arrayWithCapacity:rawTargets.count];
-            for (id rawTarget in rawTargets) {
-                [targets addObject:[BFAppLinkTarget appLinkTargetWithURL:[NSURL URLWithString:[rawTarget objectForKey:kURLKey]]
-                                                              appStoreId:[rawTarget objectForKey:kIOSAppStoreIdKey]
-                                                                 appName:[rawTarget objectForKey:kIOSAppNameKey]]];
+        NSString *path = [NSString stringWithFormat:@"?type=al&fields=%@&ids=%@",
+                          fieldsString,
+                          [idStrings componentsJoinedByString:@","]];
+        FBRequest *request = [[[FBRequest alloc] initWithSession:nil
+                                                       graphPath:path
+                                                      parameters:nil
+                                                      HTTPMethod:@"GET"] autorelease];
+        [request overrideVersionPartWith:@""];
+        [resolveConnection addRequest:request completionHandler:^(FBRequestConnection *connection, id result, NSError *error) {
+            for (NSUInteger i = 0; i < chunkURLs.count; i++) {
+                NSURL *url = chunkURLs[i];
+                id nestedObject = [result objectForKey:url.absoluteString];
+                BFAppLink *link = error ? nil : [FBAppLinkResolver appLinkForURL:url
+                                                                     fromResult:nestedObject
+                                                             idiomSpecificField:idiomSpecificField];
+                // A URL without app link metadata only gets the web fallback, and is asked about again sooner
+                BOOL hasMetadata = link.targets.count > 0 || [nestedObject objectForKey:kWebKey];
+                FBAppLinkCache *cache = [FBAppLinkCache sharedCache];
+                [FBAppLinkResolver finishResolvingURL:url
+                                                idiom:idiom
+                                           linkSource:chunkSources[i]
+                                                 link:link
+                                           timeToLive:hasMetadata ? cache.timeToLive : cache.negativeTimeToLive
+                                                error:error];
             }
+        }];
+    }
+    [resolveConnection start];
+}
+
++ (BFAppLink *)appLinkForURL:(NSURL *)url
+                  fromResult:(id)nestedObject
+          idiomSpecificField:(NSString *)idiomSpecificField {
+    NSMutableArray *rawTargets = [NSMutableArray array];
+    if (idiomSpecificField) {
+        [rawTargets addObjectsFromArray:[nestedObject objectForKey:idiomSpecificField]];
+    }
+    [rawTargets addObjectsFromArray:[nestedObject objectForKey:kIOSKey]];
 
-            id webTarget = [nestedObject objectForKey:kWebKey];
-            NSString *webFallbackString = [webTarget objectForKey:kURLKey];
-            NSURL *fallbackUrl = webFallbackString ? [NSURL URLWithString:webFallbackString] : url;
+    NSMutableArray *targets = [NSMutableArray arrayWithCapacity:rawTargets.count];
+    for (id rawTarget in rawTargets) {
+        [targets addObject:[BFAppLinkTarget appLinkTargetWithURL:[NSURL URLWithString:[rawTarget objectForKey:kURLKey]]
+                                                      appStoreId:[rawTarget objectForKey:kIOSAppStoreIdKey]
+                                                         appName:[rawTarget objectForKey:kIOSAppNameKey]]];
+    }
 
-            NSNumber *shouldFallback = [webTarget objectForKey:kShouldFallbackKey];
-            if (shouldFallback && !shouldFallback.boolValue) {
-                fallbackUrl = nil;
-            }
+    id webTarget = [nestedObject objectForKey:kWebKey];
+    NSString *webFallbackString = [webTarget objectForKey:kURLKey];
+    NSURL *fallbackUrl = webFallbackString ? [NSURL URLWithString:webFallbackString] : url;
 
-            BFAppLink *link = [BFAppLink appLinkWithSourceURL:url
-                                                      targets:targets
-                                                       webURL:fallbackUrl];
-            @synchronized (self.cachedLinks) {
-                self.cachedLinks[url] = link;
+    NSNumber *shouldFallback = [webTarget objectForKey:kShouldFallbackKey];
+    if (shouldFallback && !shouldFallback.boolValue) {
+        fallbackUrl = nil;
+    }
+
+    return [BFAppLink appLinkWithSourceURL:url
+                                   targets:targets
+                                    webURL:fallbackUrl];
+}
+
+- (void)prefetchAppLinksForURLs:(NSArray *)urls {
+    FBAppLinkCache *cache = [FBAppLinkCache sharedCache];
+    UIUserInterfaceIdiom idiom = self.userInterfaceIdiom;
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    BOOL schedule = NO;
+    @synchronized ([FBAppLinkResolver class]) {
+        if (now - g_prefetchBudgetStart > kPrefetchBudgetInterval) {
+            g_prefetchBudgetStart = now;
+            g_prefetchBudgetUsed = 0;
+        }
+        if (!g_pendingPrefetches) {
+            g_pendingPrefetches = [[NSMutableDictionary alloc] init];
+        }
+        NSMutableOrderedSet *pending = g_pendingPrefetches[@(idiom)];
+        if (!pending) {
+            pending = [NSMutableOrderedSet orderedSet];
+            g_pendingPrefetches[@(idiom)] = pending;
+        }
+        for (NSURL *url in urls) {
+            if (g_prefetchBudgetUsed >= kPrefetchBudget) {
+                break;
             }
-            appLinks[url] = link;
+            if ([pending containsObject:url] ||
+                g_inFlightLinks[FBAppLinkResolverInFlightKey(url, idiom)] ||
+                [cache appLinkForURL:url idiom:idiom] ||
+                [cache errorForURL:url idiom:idiom]) {
+                continue;
+            }
+            [pending addObject:url];
+            g_prefetchBudgetUsed++;
         }
-        [tcs setResult:appLinks];
-    }];
-    return tcs.task;
+        if (pending.count && !g_prefetchScheduled) {
+            g_prefetchScheduled = YES;
+            schedule = YES;
+        }
+    }
+
+    if (schedule) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kPrefetchDelay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            [FBAppLinkResolver lookUpPendingPrefetches];
+        });
+    }
+}
+
++ (void)lookUpPendingPrefetches {
+    NSDictionary *pendingPrefetches = nil;
+    @synchronized ([FBAppLinkResolver class]) {
+        pendingPrefetches = [[g_pendingPrefetches retain] autorelease];
+        [g_pendingPrefetches release];
+        g_pendingPrefetches = nil;
+        g_prefetchScheduled = NO;
+    }
+    for (NSNumber *idiom in pendingPrefetches) {
+        FBAppLinkResolver *resolver = [[[FBAppLinkResolver alloc] initWithUserInterfaceIdiom:idiom.integerValue] autorelease];
+        // Only the cache wants the result
+        [resolver appLinksFromURLsInBackground:[pendingPrefetches[idiom] array]];
+    }
 }
 
 - (BFTask *)appLinkFromURLInBackground:(NSURL *)url {
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @class FBCancellationToken
+
+ @abstract
+ Lets an app stop SDK work it no longer needs, such as the requests behind a screen that
+ was dismissed.
+
+ @discussion
+ Pass the same token to any number of <FBRequestConnection>s and other SDK objects that
+ accept one; calling `cancel` cancels all of them, and anything started with a token that
+ is already cancelled is cancelled straight away. Tokens are not reusable; create a new one
+ for new work. Cancel on the main thread.
+ */
+@interface FBCancellationToken : NSObject
+
+/*!
+ @abstract
+ Returns a new token that has not been cancelled.
+ */
++ (FBCancellationToken *)cancellationToken;
+
+/*! @abstract Whether `cancel` has been called. */
+@property (nonatomic, readonly, getter=isCancellationRequested) BOOL cancellationRequested;
+
+/*!
+ @abstract
+ Cancels all of the work using this token. Calling it again does nothing.
+ */
+- (void)cancel;
+
+/*!
+ @abstract
+ Calls the given block when the token is cancelled, or right away if it already was.
+
+ @discussion
+ The block runs on the thread that calls `cancel` and is released once it has run or
+ been unregistered.
+
+ @param block           The block to call.
+
+ @return An object to pass to `unregisterCancellationObserver:` when the work is done.
+ */
+- (id)registerCancellationObserverWithBlock:(void (^)(void))block;
+
+/*!
+ @abstract
+ Stops the block registered with `registerCancellationObserverWithBlock:` from being called.
+
+ @param registration    The object returned when the block was registered. nil is ignored.
+ */
+- (void)unregisterCancellationObserver:(id)registration;
+
+@end
@@ -604,6 +604,41 @@ typedef void (^FBDialogAppCallCompletionHandler)(
                                          clientState:(NSDictionary *)clientState
                                              handler:(FBDialogAppCallCompletionHandler)handler;
 
+/*!
+ @abstract
+ Prepares a share dialog in the Facebook application ahead of time, for example when the
+ share button appears, so that presenting it later only has to switch apps.
+
+ @param params An FBLinkShareParams, FBPhotoParams or FBOpenGraphActionParams for the dialog.
+
+ @param clientState An NSDictionary that's passed through when the completion handler
+ is called. May be nil.
+
+ @return An FBAppCall to pass to `presentPreparedShareDialog:handler:`, or nil if the
+ corresponding canPresentShareDialog method returns NO or the params are not valid.
+
+ @discussion Conversion, encryption and encoding of the params happen off the main thread.
+ The params must not be changed after this call. Releasing the returned call without
+ presenting it discards the preparation.
+ */
++ (FBAppCall *)prepareShareDialogWithParams:(FBDialogsParams *)params
+                                clientState:(NSDictionary *)clientState;
+
+/*!
+ @abstract
+ Presents a share dialog prepared by `prepareShareDialogWithParams:clientState:`. If
+ preparation has not finished yet, the dialog is presented as soon as it does.
+
+ @param call The FBAppCall returned by `prepareShareDialogWithParams:clientState:`.
+
+ @param handler A completion handler that may be called when the share is
+ complete. May be nil. If non-nil, the handler will always be called asynchronously.
+
+ @return The call that was passed in, or nil if it was not a prepared share dialog.
+ */
++ (FBAppCall *)presentPreparedShareDialog:(FBAppCall *)call
+                                  handler:(FBDialogAppCallCompletionHandler)handler;
+
 #pragma mark - Message Dialog
 
 /*!
@@ -126,6 +126,12 @@ typedef NS_ENUM(NSUInteger, FBErrorCode) {
      Reserved for future use.
     */
     FBErrorOperationDisallowedForRestrictedTreament,
+
+    /*!
+     The request was not sent because recent requests to its host kept failing, and the
+     circuit breaker of the installed `FBRequestRetryPolicy` is open. Try again later.
+    */
+    FBErrorServiceUnavailable,
 };
 
 /*!
@@ -376,6 +382,13 @@ FBSDK_EXTERN NSString *const FBErrorDialogInvalidLikeObjectID;
 */
 FBSDK_EXTERN NSString *const FBErrorAppEventsReasonKey;
 
+/*!
+ The key in the userInfo NSDictionary of NSError for a request that failed while
+ the device was offline and, because it set `queuesWhenOffline`, was saved to be sent
+ again once the network is back. The value is an NSNumber wrapping YES.
+ */
+FBSDK_EXTERN NSString *const FBErrorRequestQueuedOfflineKey;
+
 // Exception strings raised by the Facebook SDK
 
 /*!
@@ -30,6 +30,10 @@
  one of the prefetchAndCacheForSession methods to fetch a friend list prior to the
  point where a dialog is presented. The cache is also updated with each presentation of the request
  dialog using the cache instance.
+
+ The list is kept on disk per session, so a new instance starts from the last list seen for the same
+ access token. Presenting a request dialog refreshes the list from the server only once it is more
+ than an hour old.
  */
 @interface FBFrictionlessRecipientCache : FBCacheDescriptor<FBWebDialogsDelegate>
 
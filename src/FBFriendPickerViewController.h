@@ -145,6 +145,13 @@ typedef NS_ENUM(NSUInteger, FBFriendDisplayOrdering) {
  */
 @property (nonatomic) FBFriendDisplayOrdering displayOrdering;
 
+/*!
+ @abstract
+ Limits the friends shown to those with a word in their name starting with each word of
+ the search text, ignoring case and accents. Call `updateView` after changing it.
+ */
+@property (nonatomic, copy) NSString *searchText;
+
 /*!
  @abstract
  Initializes a friend picker view controller.
@@ -192,6 +199,8 @@ typedef NS_ENUM(NSUInteger, FBFriendDisplayOrdering) {
  @discussion
  Use this if the filter or sort properties change. This may affect the order or
  display of friend information but should not need require new data.
+ The table is reloaded once the new order has been worked out, which happens off the
+ main thread, so the change may show up on a later run loop pass.
  */
 - (void)updateView;
 
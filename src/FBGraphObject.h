@@ -220,6 +220,21 @@
  */
 + (NSMutableDictionary<FBGraphObject> *)graphObjectWrappingDictionary:(NSDictionary *)jsonDictionary;
 
+/*!
+ @method
+ @abstract
+ Used to wrap an existing dictionary with a read-only `FBGraphObject` facade
+
+ @discussion
+ Unlike `graphObjectWrappingDictionary:`, the source dictionary is neither copied nor modified. Nested dictionaries
+ and arrays are wrapped as they are read, and the wrappers are not stored back into the source, so reading a few
+ fields from each node of a large response costs only the nodes actually visited. Any attempt to mutate the
+ returned object, or objects reached through it, raises an `NSInternalInconsistencyException`.
+
+ @param jsonDictionary              the dictionary representing the underlying object to wrap
+ */
++ (NSDictionary<FBGraphObject> *)readOnlyGraphObjectWrappingDictionary:(NSDictionary *)jsonDictionary;
+
 /*!
  @method
  @abstract
@@ -265,5 +280,21 @@
  */
 + (BOOL)isGraphObjectID:(id<FBGraphObject>)anObject sameAs:(id<FBGraphObject>)anotherObject;
 
+/*!
+ @method
+ @abstract
+ Returns the Graph API field names read through the properties of a protocol, such as
+ `@protocol(FBGraphUser)`, for use as the `fields` parameter of a request.
+
+ @discussion
+ Properties of the protocols it adopts are included, except for those of `FBGraphObject`
+ itself. `objectID` and `objectDescription` map to the `id` and `description` fields.
+ Properties typed as other graph objects, such as `location`, ask for the field as a
+ whole rather than for the nested object's own fields.
+
+ @param protocol          a protocol adopting `FBGraphObject`
+ */
++ (NSSet *)fieldsForProtocol:(Protocol *)protocol;
+
 
 @end
@@ -193,6 +193,10 @@ typedef NS_ENUM(NSUInteger, FBLoginViewTooltipBehavior) {
  @abstract
  Tells the delegate that the view is has now fetched user info
 
+ @discussion
+ When the session's token was loaded from the cache, this is first called with the user
+ info saved along with it, and again if refreshing it from the server brings any changes.
+
  @param loginView   The login view that transitioned its view mode
 
  @param user        The user info object describing the logged in user
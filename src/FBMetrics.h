@@ -0,0 +1,256 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+#import "FBSDKMacros.h"
+
+@class FBMetrics;
+
+/*! Histogram of the time, in milliseconds, from starting an FBRequestConnection to its response */
+FBSDK_EXTERN NSString *const FBMetricRequestLatency;
+
+/*! Histogram of the HTTP body size, in bytes, of each request sent */
+FBSDK_EXTERN NSString *const FBMetricBytesSent;
+
+/*! Histogram of the response body size, in bytes, of each response received */
+FBSDK_EXTERN NSString *const FBMetricBytesReceived;
+
+/*! Counter of request cache lookups that were answered from the cache */
+FBSDK_EXTERN NSString *const FBMetricCacheHits;
+
+/*! Counter of request cache lookups that had to go to the server */
+FBSDK_EXTERN NSString *const FBMetricCacheMisses;
+
+/*! Counter of requests retried by the installed <FBRequestRetryPolicy> */
+FBSDK_EXTERN NSString *const FBMetricRequestRetries;
+
+/*! Counter of times an <FBRequestRetryPolicy> circuit breaker opened for a host */
+FBSDK_EXTERN NSString *const FBMetricCircuitBreakerTrips;
+
+/*! Counter of requests failed without being sent because their host's circuit was open */
+FBSDK_EXTERN NSString *const FBMetricCircuitBreakerRejections;
+
+/*! Histogram of the peak heap growth, in bytes, while encoding the requests of a batch */
+FBSDK_EXTERN NSString *const FBMetricBatchEncodingPeakBytes;
+
+/*! Histogram of the peak heap growth, in bytes, while parsing a response */
+FBSDK_EXTERN NSString *const FBMetricResponseParsingPeakBytes;
+
+/*! Histogram of the peak heap growth, in bytes, while setting up the completion of a connection's requests */
+FBSDK_EXTERN NSString *const FBMetricRequestCompletionPeakBytes;
+
+/*! Histogram of the peak heap growth, in bytes, while encoding the App Events of a flush */
+FBSDK_EXTERN NSString *const FBMetricAppEventsEncodingPeakBytes;
+
+/*! Histogram of the peak heap growth, in bytes, while converting a native app call to JSON */
+FBSDK_EXTERN NSString *const FBMetricAppBridgeEncodingPeakBytes;
+
+/*! Features that network usage is accounted to by <[FBMetrics networkUsageByFeature]> */
+FBSDK_EXTERN NSString *const FBNetworkFeatureAppEvents;
+FBSDK_EXTERN NSString *const FBNetworkFeatureFriendPicker;
+FBSDK_EXTERN NSString *const FBNetworkFeaturePlacePicker;
+FBSDK_EXTERN NSString *const FBNetworkFeatureProfilePicture;
+FBSDK_EXTERN NSString *const FBNetworkFeatureLike;
+FBSDK_EXTERN NSString *const FBNetworkFeatureAppSettings;
+FBSDK_EXTERN NSString *const FBNetworkFeatureAppLinkResolver;
+/*! Requests made directly by the app, and any SDK traffic not attributed to one of the other features */
+FBSDK_EXTERN NSString *const FBNetworkFeatureOther;
+
+/*! Keys of the dictionaries returned for histograms by <[FBMetrics snapshot]> */
+FBSDK_EXTERN NSString *const FBMetricCountKey;
+FBSDK_EXTERN NSString *const FBMetricSumKey;
+FBSDK_EXTERN NSString *const FBMetricMinKey;
+FBSDK_EXTERN NSString *const FBMetricMaxKey;
+FBSDK_EXTERN NSString *const FBMetricBucketsKey;
+
+/*!
+ @typedef
+
+ @abstract
+ State of a measurement of heap growth, see <[FBMetrics beginAllocationSample:]>.
+ */
+typedef struct {
+    size_t startBytes;
+    size_t peakBytes;
+} FBMetricsAllocationSample;
+
+/*!
+ @protocol
+
+ @abstract
+ Receives every value recorded by an <FBMetrics> registry, for forwarding to an APM service.
+
+ @discussion
+ Callbacks arrive synchronously on whichever thread recorded the value, outside the registry's lock,
+ so they should be quick and thread-safe.
+ */
+@protocol FBMetricsDelegate <NSObject>
+
+@optional
+
+/*!
+ @abstract Called when a value is added to a histogram metric.
+ */
+- (void)metrics:(FBMetrics *)metrics didRecordValue:(double)value forMetric:(NSString *)metric;
+
+/*!
+ @abstract Called when a counter metric is incremented.
+ */
+- (void)metrics:(FBMetrics *)metrics didIncrementCounter:(NSString *)counter by:(NSUInteger)amount;
+
+@end
+
+/*!
+ @class FBMetrics
+
+ @abstract
+ Thread-safe registry of the SDK's performance metrics.
+
+ @discussion
+ Spans are timed with `mach_absolute_time`, so they are monotonic and unaffected by changes to the
+ wall clock. Histograms keep a count, sum, minimum and maximum along with power-of-two buckets:
+ bucket 0 holds values below 1, and bucket `i` holds values in [2^(i-1), 2^i).
+ */
+@interface FBMetrics : NSObject
+
+/*!
+ @abstract Returns the registry the SDK records into.
+ */
++ (FBMetrics *)sharedMetrics;
+
+/*!
+ @abstract Receives each recorded value. Not retained; set it to nil before it is deallocated.
+ */
+@property (atomic, assign) id<FBMetricsDelegate> delegate;
+
+/*!
+ @abstract The number of spans that have been begun but not yet ended or cancelled.
+ */
+@property (nonatomic, readonly) NSUInteger openSpanCount;
+
+/*!
+ @abstract Hits as a fraction of all request cache lookups, or 0 when there have been none.
+ */
+@property (nonatomic, readonly) double cacheHitRate;
+
+/*!
+ @abstract Starts timing a span identified by `tag`, replacing any span already open for it.
+
+ @discussion
+ The tag is used only for its address and is not retained.
+ */
+- (void)beginSpanForTag:(NSObject *)tag;
+
+/*!
+ @abstract Stops timing the span identified by `tag`.
+
+ @param tag The tag passed to `beginSpanForTag:`.
+ @param metric If not nil, the histogram that the elapsed milliseconds are recorded into.
+ @param elapsedMilliseconds If not NULL, receives the elapsed milliseconds.
+
+ @return NO if no span was open for `tag`.
+ */
+- (BOOL)endSpanForTag:(NSObject *)tag
+               metric:(NSString *)metric
+  elapsedMilliseconds:(double *)elapsedMilliseconds;
+
+/*!
+ @abstract Discards the span identified by `tag`, if any, without recording it.
+ */
+- (void)cancelSpanForTag:(NSObject *)tag;
+
+/*!
+ @abstract Adds a value to the histogram named `metric`.
+ */
+- (void)recordValue:(double)value forMetric:(NSString *)metric;
+
+/*!
+ @abstract Starts measuring how far the heap grows during an operation.
+
+ @discussion
+ The heap is process-wide, so allocations made meanwhile on other threads are counted too. The
+ peak is only as fine as the calls to `updateAllocationSample:`, which operations working in chunks
+ make at the end of each chunk, before its autorelease pool is drained.
+ */
+- (void)beginAllocationSample:(FBMetricsAllocationSample *)sample;
+
+/*!
+ @abstract Takes the current size of the heap into account for the peak of `sample`.
+ */
+- (void)updateAllocationSample:(FBMetricsAllocationSample *)sample;
+
+/*!
+ @abstract Takes a last reading and adds the peak growth of `sample`, in bytes, to the histogram named `metric`.
+ */
+- (void)endAllocationSample:(FBMetricsAllocationSample *)sample metric:(NSString *)metric;
+
+/*!
+ @abstract Estimates a percentile of the histogram named `metric`.
+
+ @param percentile The percentile to estimate, between 0 and 100.
+ @param metric The histogram to estimate from.
+ @param sampleCount If not NULL, receives the number of values in the histogram.
+
+ @discussion
+ The estimate interpolates linearly within the power-of-two bucket holding the percentile and is
+ clamped to the histogram's minimum and maximum. Returns 0 if nothing has been recorded.
+ */
+- (double)estimatedPercentile:(double)percentile
+                    forMetric:(NSString *)metric
+                  sampleCount:(NSUInteger *)sampleCount;
+
+/*!
+ @abstract Increments the counter named `counter` by `amount`.
+ */
+- (void)incrementCounter:(NSString *)counter by:(NSUInteger)amount;
+
+/*!
+ @abstract Adds one network round trip and its bytes to the usage of `feature`.
+
+ @param feature One of the `FBNetworkFeature*` constants, or nil for `FBNetworkFeatureOther`.
+ */
+- (void)recordBytesSent:(unsigned long long)bytesSent
+          bytesReceived:(unsigned long long)bytesReceived
+             forFeature:(NSString *)feature;
+
+/*!
+ @abstract Returns the network usage accounted to each feature so far.
+
+ @discussion
+ Maps each feature with any usage to a dictionary with the total `FBMetricBytesSent` and
+ `FBMetricBytesReceived` body bytes, and the `FBMetricCountKey` number of round trips. Bytes served
+ from the SDK's caches aren't counted.
+ */
+- (NSDictionary *)networkUsageByFeature;
+
+/*!
+ @abstract Returns the current metrics.
+
+ @discussion
+ Counters map to an `NSNumber`. Histograms map to a dictionary with the `FBMetricCountKey`,
+ `FBMetricSumKey`, `FBMetricMinKey` and `FBMetricMaxKey` numbers and an `FBMetricBucketsKey`
+ array of bucket counts.
+ */
+- (NSDictionary *)snapshot;
+
+/*!
+ @abstract Clears all histograms, counters and network usage. Open spans are kept.
+ */
+- (void)reset;
+
+@end
@@ -171,6 +171,8 @@
  @discussion
  Use this if the filter properties change. This may affect the order or
  display of information.
+ The table is reloaded once the new order has been worked out, which happens off the
+ main thread, so the change may show up on a later run loop pass.
  */
 - (void)updateView;
 
@@ -76,4 +76,44 @@ typedef enum {
 - (instancetype)initWithProfileID:(NSString *)profileID
                   pictureCropping:(FBProfilePictureCropping)pictureCropping;
 
+/*!
+ @abstract
+ Starts fetching the profile pictures that views of the given size and cropping would show,
+ so that they are ready by the time such views are given the profile IDs.
+
+ @discussion
+ Call this from the main thread with the IDs of rows that are about to scroll into view. The
+ pictures are fetched into the SDK's image cache at a low priority, and pictures already cached
+ or being fetched are skipped. A view that asks for a picture that is still being prefetched
+ waits for that fetch rather than starting another.
+
+ Request priorities are only honoured by the request scheduler, so this does nothing unless
+ `[FBSettings enableRequestScheduling:YES]` has been called.
+
+ @param profileIDs      The Facebook IDs of the users, places or objects whose pictures to fetch.
+ @param size            The size, in points, of the views that will show the pictures.
+ @param pictureCropping The cropping those views will use.
+ */
++ (void)prefetchPicturesForProfileIDs:(NSArray *)profileIDs
+                                 size:(CGSize)size
+                      pictureCropping:(FBProfilePictureCropping)pictureCropping;
+
+/*!
+ @abstract
+ Stops prefetching the given pictures, for example when the rows they were prefetched for are
+ scrolled past without being shown.
+
+ @discussion
+ Call this from the main thread with the same size and cropping that were passed to
+ `prefetchPicturesForProfileIDs:size:pictureCropping:`. A picture that a view is already waiting
+ for keeps loading for that view.
+
+ @param profileIDs      The Facebook IDs whose prefetches to cancel.
+ @param size            The size that was passed when prefetching.
+ @param pictureCropping The cropping that was passed when prefetching.
+ */
++ (void)cancelPrefetchingPicturesForProfileIDs:(NSArray *)profileIDs
+                                          size:(CGSize)size
+                               pictureCropping:(FBProfilePictureCropping)pictureCropping;
+
 @end
@@ -45,6 +45,34 @@ FBSDK_EXTERN NSString *const FBGraphBasePath __attribute__((deprecated));
  */
 typedef NSUInteger FBRequestState __attribute__((deprecated));
 
+/*!
+ @typedef NS_ENUM (NSUInteger, FBRequestCachePolicy)
+ @abstract Whether a GET request may be answered from the SDK's response cache.
+
+ @discussion
+ Responses are kept for the time the server allows with its `Cache-Control` or
+ `Expires` headers, or for the request's `cacheMaxAge` when it sends neither.
+ Responses marked `no-store` are never kept. Only GET requests sent on a connection
+ of their own are cached; the policy is ignored otherwise.
+ */
+typedef NS_ENUM(NSUInteger, FBRequestCachePolicy) {
+    /*! Always go to the server, and leave the cache alone. */
+    FBRequestCachePolicyNetworkOnly = 0,
+
+    /*!
+     Complete from the cache while the cached response is fresh, and go to the server
+     (revalidating the cached copy) once it has expired.
+     */
+    FBRequestCachePolicyCacheFirst,
+
+    /*!
+     As `FBRequestCachePolicyCacheFirst`, except that an expired response is still
+     used to complete the request right away, and refreshed from the server in the
+     background for next time.
+     */
+    FBRequestCachePolicyStaleWhileRevalidate,
+};
+
 /*!
  @class FBRequest
 
@@ -204,7 +232,10 @@ typedef NSUInteger FBRequestState __attribute__((deprecated));
 
  `NSString` parameters are used to generate URL parameter values or JSON
  parameters.  `NSData` and `UIImage` parameters are added as attachments
- to the HTTP body and referenced by name in the URL and/or JSON.
+ to the HTTP body and referenced by name in the URL and/or JSON.  A file `NSURL`
+ parameter is attached with the file's contents as they are on disk, read as the
+ body is sent; use one for a photo already saved as a JPEG to upload it without
+ re-encoding.
  */
 @property (nonatomic, retain, readonly) NSMutableDictionary *parameters;
 
@@ -266,6 +297,40 @@ typedef NSUInteger FBRequestState __attribute__((deprecated));
  */
 @property (nonatomic, retain) id<FBGraphObject> graphObject;
 
+/*!
+ @abstract
+ Whether the request may be saved and sent again later if it fails because the
+ device is offline. Defaults to NO.
+
+ @discussion
+ Only set this for writes that are safe to repeat, since a request that timed out
+ may have reached the server. A saved request is written to disk and sent again,
+ batched with others for the same access token, once the network is back, even
+ after a relaunch. The completion handler is still called with the original error,
+ with `FBErrorRequestQueuedOfflineKey` set in its userInfo; it is not called again
+ when the request is finally sent. Requests with `UIImage`, `NSData` or file `NSURL`
+ parameters, and GET requests, are never saved.
+ */
+@property (nonatomic, assign) BOOL queuesWhenOffline;
+
+/*!
+ @abstract
+ Whether the response may be served from, and saved to, the SDK's response cache.
+ Defaults to `FBRequestCachePolicyNetworkOnly`.
+
+ @discussion
+ Cached responses are kept per user, and are removed along with the rest of a
+ session's cached data when its token information is cleared.
+ */
+@property (nonatomic, assign) FBRequestCachePolicy cachePolicy;
+
+/*!
+ @abstract
+ How long, in seconds, a response is considered fresh when the server says nothing
+ about caching it. Only used when `cachePolicy` allows caching. Defaults to 300.
+ */
+@property (nonatomic, assign) NSTimeInterval cacheMaxAge;
+
 /*!
  @methodgroup Instance methods
  */
@@ -518,6 +583,44 @@ typedef NSUInteger FBRequestState __attribute__((deprecated));
  */
 + (FBRequest *)requestForGraphPath:(NSString *)graphPath;
 
+/*!
+ @method
+ Returns a newly initialized request object for a Graph API read, for the active session,
+ that asks only for the given fields.
+
+ @discussion
+ The fields are sent sorted, so requests for the same fields share a cache entry.
+
+ This method does not initialize an <FBRequestConnection> object. To initiate the API
+ call first instantiate an <FBRequestConnection> object, add the request to this object,
+ then call the `start` method on the connection instance.
+
+ @param graphPath        The Graph API endpoint to use for the request, for example "me".
+ @param fields           The names of the fields to ask for.
+ */
++ (FBRequest *)requestForGraphPath:(NSString *)graphPath
+                            fields:(NSSet *)fields;
+
+/*!
+ @method
+ Returns a newly initialized request object for a Graph API read, for the active session,
+ that asks only for the fields read through the properties of a graph object protocol.
+
+ @discussion
+ Use this when the result will only be read as, for example, an <FBGraphUser>, so that
+ the response leaves out fields the app never looks at. See
+ `+[FBGraphObject fieldsForProtocol:]` for how the fields are chosen.
+
+ This method does not initialize an <FBRequestConnection> object. To initiate the API
+ call first instantiate an <FBRequestConnection> object, add the request to this object,
+ then call the `start` method on the connection instance.
+
+ @param graphPath        The Graph API endpoint to use for the request, for example "me".
+ @param protocol         The protocol the result will be read through, for example `@protocol(FBGraphUser)`.
+ */
++ (FBRequest *)requestForGraphPath:(NSString *)graphPath
+               projectedToProtocol:(Protocol *)protocol;
+
 /*!
  @method
 
@@ -21,8 +21,10 @@
 #import "FBSDKMacros.h"
 
 // up-front decl's
+@class FBCancellationToken;
 @class FBRequest;
 @class FBRequestConnection;
+@class FBRequestTimings;
 @class FBSession;
 @class UIImage;
 
@@ -72,6 +74,28 @@ typedef enum {
     FBRequestConnectionErrorBehaviorReconnectSession     = 4,
 } FBRequestConnectionErrorBehavior;
 
+/*!
+ @typedef FBRequestPriority enum
+
+ @abstract Ranks network requests against each other when request scheduling is enabled
+ with `[FBSettings enableRequestScheduling:]`.
+
+ @discussion Each priority has its own limit on how many of its requests are in flight,
+ and waiting requests of a higher priority are started first.
+ */
+typedef enum {
+    /*! A request the user is waiting on, such as a post or a screen's content. The default. */
+    FBRequestPriorityUserInitiated = 0,
+    /*! An image that is on screen, such as a profile picture in a picker. */
+    FBRequestPriorityVisibleImage,
+    /*! Content fetched ahead of being needed. */
+    FBRequestPriorityPrefetch,
+    /*! Work the user never sees, such as App Events. */
+    FBRequestPriorityBackground,
+    /*! The number of priorities; not a valid priority. */
+    FBRequestPriorityCount
+} FBRequestPriority;
+
 /*!
  Normally requests return JSON data that is parsed into a set of `NSDictionary`
  and `NSArray` objects.
@@ -82,6 +106,17 @@ typedef enum {
  */
 FBSDK_EXTERN NSString *const FBNonJSONResponseProperty;
 
+/*!
+ Posted on the main thread when an upload handed to the system by
+ `[FBSettings enableBackgroundUploads:]` finishes after the app that started it
+ was terminated, so its completion handler is gone. The userInfo holds the Graph
+ paths the upload posted to under FBRequestConnectionBackgroundUploadGraphPathsKey
+ and, if it failed, an `NSError` under FBRequestConnectionBackgroundUploadErrorKey.
+ */
+FBSDK_EXTERN NSString *const FBRequestConnectionBackgroundUploadDidFinishNotification;
+FBSDK_EXTERN NSString *const FBRequestConnectionBackgroundUploadGraphPathsKey;
+FBSDK_EXTERN NSString *const FBRequestConnectionBackgroundUploadErrorKey;
+
 /*!
  @typedef FBRequestHandler
 
@@ -197,6 +232,56 @@ typedef void (^FBRequestHandler)(FBRequestConnection *connection,
  */
 @property (nonatomic, assign) FBRequestConnectionErrorBehavior errorBehavior;
 
+/*!
+ @abstract
+ The queue that request handlers are called on.  Defaults to the main queue.
+
+ @discussion
+ This must be set before the connection is started, and should be a serial
+ queue.  Handlers are still called in the order the requests were added, but
+ each one is called as soon as its own result is ready, rather than after the
+ token extension and session repair work for the whole connection.  For
+ connections with more requests than fit in one batch, each batch's handlers
+ are called as soon as that batch returns.
+ */
+@property (nonatomic, assign) dispatch_queue_t completionQueue;
+
+/*!
+ @abstract
+ A breakdown of where the time went for the connection, from when it was
+ started.
+
+ @discussion
+ Nil until the connection is started.  It is complete by the time the first
+ request handler is called, so handlers can read it from the connection they
+ are passed.
+ */
+@property (nonatomic, retain, readonly) FBRequestTimings *timings;
+
+/*!
+ @abstract
+ A token that cancels the connection, as `cancel` would, when it is cancelled.
+
+ @discussion
+ This must be set before the connection is started. A connection started with a
+ token that is already cancelled calls its handlers with an
+ `FBErrorOperationCancelled` error without going to the network. Retries the SDK
+ makes on the connection's behalf use the same token.
+ */
+@property (nonatomic, retain) FBCancellationToken *cancellationToken;
+
+/*!
+ @abstract
+ How the connection ranks against the SDK's other network requests. Defaults to
+ `FBRequestPriorityUserInitiated`.
+
+ @discussion
+ Only has an effect when `[FBSettings isRequestSchedulingEnabled]`. It may be changed
+ after the connection is started, to promote a request that became urgent or demote
+ one that no longer is, whether it is still waiting for its turn or already running.
+ */
+@property (nonatomic, assign) FBRequestPriority priority;
+
 /*!
  @methodgroup Adding requests
  */
@@ -266,6 +351,29 @@ typedef void (^FBRequestHandler)(FBRequestConnection *connection,
  completionHandler:(FBRequestHandler)handler
    batchParameters:(NSDictionary *)batchParameters;
 
+/*!
+ @method
+
+ @abstract
+ Returns a placeholder for part of the result of a request in this connection, for use
+ in the graph path or parameters of a request added after it.
+
+ @discussion
+ The server substitutes the placeholder before running the later request, so a request
+ can consume the result of another in the same round-trip, for example posting an
+ Open Graph object whose image was uploaded earlier in the batch. The request is given a
+ batch entry name if it doesn't already have one, and its own handler still receives its
+ result. The later request is sent with "depends_on" set to the first request it refers to.
+
+ @param request         A request already added to this connection.
+
+ @param JSONPath        The part of the result to refer to, for example @"$.id" or @"$.data.*.id".
+
+ @return A string of the form "{result=name:JSONPath}".
+ */
+- (NSString *)resultReferenceForRequest:(FBRequest *)request
+                               JSONPath:(NSString *)JSONPath;
+
 /*!
  @methodgroup Instance methods
  */
@@ -294,6 +402,16 @@ typedef void (^FBRequestHandler)(FBRequestConnection *connection,
  */
 - (void)start;
 
+/*!
+ @method
+
+ @abstract
+ Sets `cancellationToken` and then starts the connection, as `start` does.
+
+ @param cancellationToken   The token that cancels the connection.
+ */
+- (void)startWithCancellationToken:(FBCancellationToken *)cancellationToken;
+
 /*!
  @method
 
@@ -464,6 +582,25 @@ typedef void (^FBRequestHandler)(FBRequestConnection *connection,
 + (FBRequestConnection *)startWithGraphPath:(NSString *)graphPath
                           completionHandler:(FBRequestHandler)handler;
 
+/*!
+ @method
+
+ @abstract
+ Simple method to make a graph API read that asks only for the fields read through the
+ properties of a graph object protocol, creates an <FBRequest> object, then uses an
+ <FBRequestConnection> object to start the connection with Facebook. The request uses
+ the active session represented by `[FBSession activeSession]`.
+
+ See <requestForGraphPath:projectedToProtocol:>
+
+ @param graphPath        The Graph API endpoint to use for the request, for example "me".
+ @param protocol         The protocol the result will be read through, for example `@protocol(FBGraphUser)`.
+ @param handler          The handler block to call when the request completes with a success, error, or cancel action.
+ */
++ (FBRequestConnection *)startWithGraphPath:(NSString *)graphPath
+                        projectedToProtocol:(Protocol *)protocol
+                          completionHandler:(FBRequestHandler)handler;
+
 /*!
  @method
 
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @class FBRequestRetryPolicy
+
+ @abstract
+ Retries requests that fail transiently, and stops sending requests to a host that keeps failing.
+
+ @discussion
+ Once installed with `[FBSettings setRequestRetryPolicy:]`, the policy applies to requests made by
+ `FBRequestConnection` that only read: single GET requests, and batches made up entirely of GETs.
+ Requests that change state are never retried, since they may have taken effect before failing.
+
+ Retries wait a random time of up to `initialBackoff * 2^(retry - 1)`, capped at `maximumBackoff`,
+ so that clients failing together don't retry together.
+
+ Each host also has a circuit breaker. After `circuitBreakerFailureThreshold` consecutive transient
+ failures it opens, and requests to the host fail right away with `FBErrorServiceUnavailable`
+ rather than adding to its load. After `circuitBreakerResetInterval` a single trial request is let
+ through, which closes the circuit again if it succeeds.
+
+ Retries and circuit breaker activity are counted in `[FBMetrics sharedMetrics]` under
+ `FBMetricRequestRetries`, `FBMetricCircuitBreakerTrips` and `FBMetricCircuitBreakerRejections`.
+
+ Subclasses can override `shouldRetryAfterError:response:` and `backoffBeforeRetry:` to change which
+ failures are retried and how long to wait. A policy may be used from any thread.
+ */
+@interface FBRequestRetryPolicy : NSObject
+
+/*!
+ @abstract The most times a request is retried after its first attempt. Defaults to 2.
+ */
+@property (atomic) NSUInteger maximumRetryCount;
+
+/*!
+ @abstract The longest wait before the first retry, in seconds. Defaults to 0.5.
+ */
+@property (atomic) NSTimeInterval initialBackoff;
+
+/*!
+ @abstract The longest wait before any retry, in seconds. Defaults to 8.
+ */
+@property (atomic) NSTimeInterval maximumBackoff;
+
+/*!
+ @abstract The number of consecutive transient failures that opens a host's circuit, or 0 to never
+ open it. Defaults to 5.
+ */
+@property (atomic) NSUInteger circuitBreakerFailureThreshold;
+
+/*!
+ @abstract How long an open circuit fails requests before letting a trial request through, in
+ seconds. Defaults to 30.
+ */
+@property (atomic) NSTimeInterval circuitBreakerResetInterval;
+
+/*!
+ @abstract The hosts whose circuits are currently open.
+ */
+@property (atomic, readonly) NSSet *hostsWithOpenCircuits;
+
+/*!
+ @abstract Returns whether a failed attempt is transient, and so worth retrying and counted
+ against the host's circuit breaker.
+
+ @param error The error the attempt failed with, or nil if it got a response.
+ @param response The response, or nil if the attempt failed with an error.
+
+ @discussion
+ By default timeouts, lost connections and other network failures are transient, as are HTTP 5xx
+ responses other than 501 Not Implemented.
+ */
+- (BOOL)shouldRetryAfterError:(NSError *)error response:(NSHTTPURLResponse *)response;
+
+/*!
+ @abstract Returns how long to wait before a retry, in seconds.
+
+ @param retryNumber 1 for the first retry, 2 for the second, and so on.
+ */
+- (NSTimeInterval)backoffBeforeRetry:(NSUInteger)retryNumber;
+
+/*!
+ @abstract Returns whether requests to `host` are currently failing fast.
+ */
+- (BOOL)isCircuitOpenForHost:(NSString *)host;
+
+@end
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @class FBRequestTimings
+
+ @abstract
+ Where the time went for one started <FBRequestConnection>.
+
+ @discussion
+ All values are in seconds, measured with a monotonic clock, and are 0 for phases that
+ didn't happen; a result served from the cache, for instance, has no network phases. When the
+ connection went out as several batches, the network phases run from the first batch's response
+ to the last batch finishing.
+
+ The connection APIs the SDK runs on don't report DNS lookup, TCP connect and TLS handshake
+ separately, so they are included in `timeToFirstByte`.
+ */
+@interface FBRequestTimings : NSObject
+
+/*! @abstract From starting the connection to the first response headers arriving. */
+@property (nonatomic, readonly) NSTimeInterval timeToFirstByte;
+
+/*! @abstract From the first response headers to the last response body finishing. */
+@property (nonatomic, readonly) NSTimeInterval downloadDuration;
+
+/*! @abstract Time spent parsing the JSON response. */
+@property (nonatomic, readonly) NSTimeInterval parseDuration;
+
+/*! @abstract From the response arriving to the first request handler being called. */
+@property (nonatomic, readonly) NSTimeInterval handlerDispatchLatency;
+
+/*! @abstract From starting the connection to the first request handler being called. */
+@property (nonatomic, readonly) NSTimeInterval totalDuration;
+
+@end
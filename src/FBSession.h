@@ -218,6 +218,27 @@ typedef FBSessionRequestPermissionResultHandler FBSessionReauthorizeResultHandle
  */
 typedef void (^FBSessionRenewSystemCredentialsHandler)(ACAccountCredentialRenewResult result, NSError *error) ;
 
+/*!
+ @typedef
+
+ @abstract Block type used to define blocks called by <[FBSession refreshAccessTokenIfNeededWithCompletionHandler:]>.
+ @discussion `didRefresh` is YES if any refresh requests were sent; `error` is the first error
+ those requests reported, if any.
+ */
+typedef void (^FBSessionRefreshAccessTokenHandler)(FBSession *session, BOOL didRefresh, NSError *error);
+
+/*!
+ @typedef
+
+ @abstract Block type used to define blocks set with <[FBSession setLoginTimingHandler:]>.
+ @discussion `authMethod` names the login strategy that was used last (for example
+ "fb_application_web_auth" or "integrated_auth"), `result` is "success", "error" or "cancelled",
+ and `phaseTimings` maps each phase the login reached ("method_start", "callback_received",
+ "token_validation_start", "token_validation_end", "end") to the milliseconds elapsed since the
+ login started.
+ */
+typedef void (^FBSessionLoginTimingHandler)(NSString *authMethod, NSString *result, NSDictionary *phaseTimings);
+
 /*!
  @class FBSession
 
@@ -546,6 +567,19 @@ __attribute__((deprecated));
  */
 - (void)refreshPermissionsWithCompletionHandler:(FBSessionRequestPermissionResultHandler)handler;
 
+/*!
+ @abstract Extends the access token and refreshes permissions now, if either is due.
+ @param handler Called on the main thread once the refresh has finished, or right away if
+ nothing was due.
+ @discussion Normally the SDK extends the token by piggybacking on the next request the
+ app sends, so the first request after a long idle period may have to be repaired and retried.
+ Apps that opt in to background fetch can call this method from
+ `application:performFetchWithCompletionHandler:` so the token is already fresh when the user
+ comes back. It uses the same thresholds as the piggybacked refresh, and a refresh done here
+ is not repeated on the next request.
+ */
+- (void)refreshAccessTokenIfNeededWithCompletionHandler:(FBSessionRefreshAccessTokenHandler)handler;
+
 /*!
  @abstract
  A helper method that is used to provide an implementation for
@@ -816,4 +850,30 @@ __attribute__((deprecated));
  logged in via Safari or Facebook SSO.
  */
 + (void)renewSystemCredentials:(FBSessionRenewSystemCredentialsHandler)handler;
+
+/*!
+ @method
+
+ @abstract Prepares the device Facebook account store for a login in the background.
+
+ @discussion The first iOS integrated login otherwise pays for setting up the account store,
+ resolving the Facebook account type and, after a password change, renewing credentials, all
+ while the user waits. Call this once the app is idle (for example, after the first screen has
+ appeared) and before showing a login button so that tapping it proceeds immediately. It does
+ nothing on devices without a Facebook account, and never shows any UI.
+ */
++ (void)prewarmSystemAccountStore;
+
+/*!
+ @method
+
+ @abstract Sets a handler that is given per-phase timings for each login and reauthorization as it ends.
+
+ @param handler The handler, called on the main thread; nil stops reporting.
+
+ @discussion The same timings are attached to the SDK's own login events. They are meant for finding
+ which login strategy is slow in the field, such as how long users spend in the Facebook app or Safari
+ before control returns.
+ */
++ (void)setLoginTimingHandler:(FBSessionLoginTimingHandler)handler;
 @end
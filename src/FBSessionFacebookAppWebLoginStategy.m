@@ -26,8 +26,7 @@
 
 - (BOOL)tryPerformAuthorizeWithParams:(FBSessionLoginStrategyParams *)params session:(FBSession *)session logger:(FBSessionAuthLogger *)logger {
     if (params.tryFBAppAuth && !TEST_DISABLE_FACEBOOKLOGIN) {
-        NSDictionary *clientState = @{FBSessionAuthLoggerParamAuthMethodKey: self.methodName,
-                                      FBSessionAuthLoggerParamIDKey : logger.ID ?: @""};
+        NSDictionary *clientState = [logger clientStateForAuthMethod:self.methodName];
         params.webParams[FBLoginUXClientState] = [session jsonClientStateWithDictionary:clientState];
         return [session authorizeUsingFacebookApplication:params.webParams];
     }
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+@class FBSession;
+
+/*!
+ @class FBSessionPool
+
+ @abstract
+ Keeps sessions for several accounts alive so an app can switch between them cheaply.
+
+ @discussion
+ Normally <[FBSession setActiveSession:]> closes the session it replaces, so switching back to an
+ account means reloading its token and refetching everything cached against it. Sessions held by a
+ pool are not closed when another session becomes active; they stay open with their token, and the
+ SDK keeps the caches it holds for them (such as like button state) until they are removed from the
+ pool. Switching accounts is then just a matter of calling `activateSessionForKey:`.
+
+ Keys are chosen by the application; a user ID or the token cache key name used for the account
+ both work well.
+ */
+@interface FBSessionPool : NSObject
+
+/*!
+ @abstract Returns the shared pool that <[FBSession setActiveSession:]> consults.
+ */
++ (FBSessionPool *)sharedPool;
+
+/*!
+ @abstract The keys of the sessions currently in the pool.
+ */
+@property (nonatomic, readonly, copy) NSArray *keys;
+
+/*!
+ @abstract Adds a session to the pool, replacing (and closing) any other session held for `key`.
+
+ @param session The session to keep alive.
+ @param key The application-defined key for the account.
+ */
+- (void)addSession:(FBSession *)session forKey:(NSString *)key;
+
+/*!
+ @abstract Returns the session held for `key`, or nil.
+
+ @param key The application-defined key for the account.
+ */
+- (FBSession *)sessionForKey:(NSString *)key;
+
+/*!
+ @abstract Removes the session held for `key` from the pool.
+
+ @param key The application-defined key for the account.
+
+ @discussion The session is closed unless it is the active session; in that case it will be closed
+ as usual when another session replaces it.
+ */
+- (void)removeSessionForKey:(NSString *)key;
+
+/*!
+ @abstract Makes the session held for `key` the active session, without closing the session it replaces
+ if that one is also pooled.
+
+ @param key The application-defined key for the account.
+
+ @return The new active session, or nil if no session is held for `key`.
+ */
+- (FBSession *)activateSessionForKey:(NSString *)key;
+
+/*!
+ @abstract Returns YES if the session is held by this pool.
+
+ @param session The session to look for.
+ */
+- (BOOL)containsSession:(FBSession *)session;
+
+@end
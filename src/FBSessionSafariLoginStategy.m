@@ -26,8 +26,7 @@
 
 - (BOOL)tryPerformAuthorizeWithParams:(FBSessionLoginStrategyParams *)params session:(FBSession *)session logger:(FBSessionAuthLogger *)logger {
     if (params.trySafariAuth) {
-        NSDictionary *clientState = @{FBSessionAuthLoggerParamAuthMethodKey: self.methodName,
-                                      FBSessionAuthLoggerParamIDKey : logger.ID ?: @""};
+        NSDictionary *clientState = [logger clientStateForAuthMethod:self.methodName];
         params.webParams[FBLoginUXClientState] = [session jsonClientStateWithDictionary:clientState];
         return [session authorizeUsingSafari:params.webParams];
     }
@@ -125,6 +125,21 @@
  */
 + (FBSessionTokenCachingStrategy *)nullCacheInstance;
 
+/*!
+ @abstract
+ Returns an instance that caches to `NSUserDefaults` like the default one, but without blocking the caller.
+
+ @discussion
+ Writes and clears are applied to an in-memory copy, which is what later fetches return, and are saved to
+ `NSUserDefaults` on a background queue. Several writes in quick succession, such as the token extensions
+ that follow ordinary requests, result in a single save of the latest value. Any pending save is completed
+ when the application enters the background.
+
+ @param tokenInformationKeyName     Specifies a key name to use for cached token information in NSUserDefaults, nil
+ indicates a default value of @"FBAccessTokenInformationKey"
+ */
++ (FBSessionTokenCachingStrategy *)asynchronousCacheInstanceWithUserDefaultTokenInformationKeyName:(NSString *)tokenInformationKeyName;
+
 /*!
  @abstract
  Helper function called by the SDK as well as application code, used to determine whether a given dictionary
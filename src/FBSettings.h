@@ -50,7 +50,27 @@ FBSDK_EXTERN NSString *const FBLoggingBehaviorCacheErrors;
 /*! Log errors likely to be preventable by the developer. This is in the default set of enabled logging behaviors. */
 FBSDK_EXTERN NSString *const FBLoggingBehaviorDeveloperErrors;
 
+/*
+ * Keys of the entries returned by <[FBSettings startupProfile]>.
+ */
+
+/*! The number of times the setup ran, as an `NSNumber` */
+FBSDK_EXTERN NSString *const FBStartupProfileCountKey;
+
+/*! The total time the setup took, in seconds */
+FBSDK_EXTERN NSString *const FBStartupProfileDurationKey;
+
+/*! The part of `FBStartupProfileDurationKey` spent on the main thread, in seconds */
+FBSDK_EXTERN NSString *const FBStartupProfileMainThreadDurationKey;
+
+/*! When the setup first ran, in seconds after profiling was enabled */
+FBSDK_EXTERN NSString *const FBStartupProfileStartKey;
+
+/*! The thread or queue the setup first ran on, as a string; "main" for the main thread */
+FBSDK_EXTERN NSString *const FBStartupProfileThreadKey;
+
 @class FBGraphObject;
+@class FBRequestRetryPolicy;
 
 /*!
  @typedef
@@ -60,6 +80,46 @@ FBSDK_EXTERN NSString *const FBLoggingBehaviorDeveloperErrors;
  */
 typedef void (^FBInstallResponseDataHandler)(FBGraphObject *response, NSError *error);
 
+/*!
+ @typedef
+
+ @abstract Block type used to receive the SDK's log entries in place of NSLog.
+ */
+typedef void (^FBLoggingHandler)(NSString *logEntry);
+
+/*!
+ @typedef NS_ENUM (NSUInteger, FBTracePoint)
+
+ @abstract Phases of SDK work marked with begin and end trace points. The value is the signpost code
+ shown for the phase in the Points of Interest instrument.
+ */
+typedef NS_ENUM(NSUInteger, FBTracePoint) {
+    /*! Constructing an `FBRequest` */
+    FBTracePointRequestCreate = 1,
+    /*! Adding token extension and permission refresh requests to a connection */
+    FBTracePointPiggybackRequests,
+    /*! Building the URL request and body for a batch */
+    FBTracePointBuildRequestBody,
+    /*! The network round trip of a single URL connection */
+    FBTracePointNetwork,
+    /*! Parsing the JSON response of a connection */
+    FBTracePointParseResponse,
+    /*! Session follow-up work and completion handlers for a connection's results */
+    FBTracePointCompletion,
+    /*! Posting logged app events to the server */
+    FBTracePointAppEventsFlush,
+    /*! A native dialog call, from switching to the Facebook app until its response is handled */
+    FBTracePointAppBridgeRoundTrip,
+};
+
+/*!
+ @typedef
+
+ @abstract Block type used to observe the SDK's trace points.
+ @discussion `identifier` is the same for the begin and end of one occurrence of a phase.
+ */
+typedef void (^FBTraceHandler)(FBTracePoint point, BOOL begin, uintptr_t identifier);
+
 /*!
  @typedef
 
@@ -122,6 +182,129 @@ typedef NS_ENUM(NSUInteger, FBRestrictedTreatment) {
  */
 + (void)setLoggingBehavior:(NSSet *)loggingBehavior;
 
+/*!
+ @method
+ @abstract Returns YES if log entries are written from a background queue. Defaults to NO.
+ */
++ (BOOL)isAsynchronousLoggingEnabled;
+
+/*!
+ @method
+ @abstract Configures the SDK to queue log entries and write them from a background queue,
+ rather than on the thread that logs them.
+ @param enable indicates whether log entries are written asynchronously
+ @discussion Entries are queued in a fixed-size buffer. If the SDK logs faster than the entries
+   can be written, new entries are dropped rather than slowing down the code being logged, and a
+   count of the dropped entries is written once the queue catches up. Disabling asynchronous
+   logging writes out anything still queued.
+ */
++ (void)enableAsynchronousLogging:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns the handler log entries are sent to, or nil if they go to NSLog.
+ */
++ (FBLoggingHandler)loggingHandler;
+
+/*!
+ @method
+ @abstract Sends log entries to `handler` rather than to NSLog.
+ @param handler the handler to call with each log entry, or nil to go back to NSLog
+ @discussion With asynchronous logging enabled the handler is called on a background queue.
+ */
++ (void)setLoggingHandler:(FBLoggingHandler)handler;
+
+/*!
+ @method
+ @abstract Returns a logging handler that appends each entry, on its own line, to the file at `path`.
+ @param path the file to append to; it is created if it doesn't exist
+ */
++ (FBLoggingHandler)loggingHandlerWritingToFileAtPath:(NSString *)path;
+
+/*!
+ @method
+ @abstract Returns YES if the SDK emits trace points. Defaults to NO.
+ */
++ (BOOL)isTracingEnabled;
+
+/*!
+ @method
+ @abstract Configures the SDK to mark the phases of its work with begin and end trace points.
+ @param enable indicates whether trace points are emitted
+ @discussion Trace points are emitted as signposts where the OS supports them, so SDK work can be lined
+   up against the app's own in the Points of Interest instrument; see `FBTracePoint` for the codes.
+   While tracing is disabled a trace point costs a single flag check.
+ */
++ (void)enableTracing:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns the handler trace points are reported to, if any.
+ */
++ (FBTraceHandler)traceHandler;
+
+/*!
+ @method
+ @abstract Reports each trace point to `handler` as well, while tracing is enabled.
+ @param handler the handler to call with each trace point, or nil for none
+ @discussion The handler is called on whichever thread reaches the trace point, so it should be quick.
+ */
++ (void)setTraceHandler:(FBTraceHandler)handler;
+
+/*!
+ @method
+ @abstract Returns the time an SDK call may spend on the main thread before it is reported. Defaults to 0,
+ meaning calls aren't measured.
+ */
++ (NSTimeInterval)mainThreadWorkBudget;
+
+/*!
+ @method
+ @abstract Reports SDK calls that spend longer than `budget` on the main thread.
+ @param budget the allowed main thread time, in seconds, or 0 to stop measuring
+ @discussion Each report names the SDK method and includes the call stack, and is logged with
+   `FBLoggingBehaviorPerformanceCharacteristics`, which must be enabled to see it. The measuring adds a little
+   work to every SDK call on the main thread, so this is meant for debug builds.
+ */
++ (void)setMainThreadWorkBudget:(NSTimeInterval)budget;
+
+/*!
+ @method
+ @abstract Returns YES if the SDK measures its one-time setup. Defaults to NO.
+ */
++ (BOOL)isStartupProfilingEnabled;
+
+/*!
+ @method
+ @abstract Configures the SDK to measure the setup it does on first use, such as opening its disk cache,
+ creating the App Events state and loading system frameworks.
+ @param enable indicates whether setup is measured
+ @discussion To see the SDK's share of app launch, enable this before anything else uses the SDK, for instance
+   at the top of `application:willFinishLaunchingWithOptions:`. Each measurement is also logged with
+   `FBLoggingBehaviorPerformanceCharacteristics`.
+ */
++ (void)enableStartupProfiling:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns what was measured while startup profiling was enabled.
+ @discussion Maps the name of each piece of setup to a dictionary of the `FBStartupProfile*Key` values.
+ */
++ (NSDictionary *)startupProfile;
+
+/*!
+ @method
+ @abstract Does the SDK's one-time setup in the background, so the first use of the SDK from the UI doesn't
+ wait on it.
+ @param handler called on the main thread once the setup is done; may be nil
+ @discussion Opens the disk cache and the libraries the SDK loads at runtime, reads the cached token, the App
+   Events kept from earlier launches and the last fetched app settings, and decodes the images of the SDK's
+   common views, with the pieces running in parallel. Nothing is sent to the server. Meant to be called as early
+   as `application:didFinishLaunchingWithOptions:`, after any `FBSettings` that affects these, such as
+   `setDefaultAppID:` or `setResourceBundleName:`, has been set.
+ */
++ (void)prewarmWithCompletionHandler:(void (^)(void))handler;
+
 /*! @abstract deprecated method */
 + (BOOL)shouldAutoPublishInstall __attribute__ ((deprecated));
 
@@ -353,4 +536,230 @@ typedef NS_ENUM(NSUInteger, FBRestrictedTreatment) {
 */
 + (void)enablePlatformCompatibility:(BOOL)enable;
 
+/*!
+ @method
+ @abstract Returns YES if request bodies may be sent gzip compressed. Defaults to NO.
+*/
++ (BOOL)isRequestCompressionEnabled;
+
+/*!
+ @method
+ @abstract Configures the SDK to gzip compress larger request bodies, such as batches and `FBAppEvents` uploads.
+ @param enable indicates whether to compress request bodies
+ @discussion Bodies are sent with a "Content-Encoding: gzip" header, and only when compression
+   actually makes them smaller.  Uploads large enough to be streamed are never compressed, as
+   they are mostly image data.
+*/
++ (void)enableRequestCompression:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns YES if the SDK opens connections to Facebook hosts ahead of the first request. Defaults to NO.
+*/
++ (BOOL)isConnectionPrewarmingEnabled;
+
+/*!
+ @method
+ @abstract Configures the SDK to open connections to the Graph API host, and to the host profile
+   pictures were last served from, when a session loads a cached token or an `FBLoginView` appears.
+ @param enable indicates whether to prewarm connections
+ @discussion The first real request then reuses an open connection and skips DNS, TCP and TLS setup.
+   Only available on iOS 7 and later, where requests share one `NSURLSession`.
+*/
++ (void)enableConnectionPrewarming:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns whether connections that only read from the Graph API derive their timeout from
+   observed request latency instead of using a fixed timeout. Defaults to NO.
+*/
++ (BOOL)isAdaptiveRequestTimeoutsEnabled;
+
+/*!
+ @method
+ @abstract Configures `FBRequestConnection` to time out read-only connections after a multiple of
+   the 99th percentile of observed request latency.
+ @param enable indicates whether to adapt request timeouts
+ @discussion The timeout stays between 15 and 180 seconds, and is only adapted once enough requests
+   have completed to estimate the percentile. Connections given an explicit timeout are unaffected.
+*/
++ (void)enableAdaptiveRequestTimeouts:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns whether slow single GET requests are hedged with a duplicate request. Defaults to NO.
+*/
++ (BOOL)isRequestHedgingEnabled;
+
+/*!
+ @method
+ @abstract Configures `FBRequestConnection` to send a duplicate of a single GET request that has not
+   completed within the 95th percentile of observed request latency.
+ @param enable indicates whether to hedge requests
+ @discussion Whichever request completes first is used and the other is cancelled. This trades a
+   little extra traffic for fewer very slow reads; requests that change state are never hedged.
+*/
++ (void)enableRequestHedging:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns the policy that retries transiently failed reads and fails fast for hosts that
+   keep failing. Defaults to nil, in which case failures are reported straight away.
+*/
++ (FBRequestRetryPolicy *)requestRetryPolicy;
+
+/*!
+ @method
+ @abstract Installs the policy `FBRequestConnection` applies to requests that only read.
+ @param policy the policy to apply, or nil to stop retrying
+ @discussion Connections already started keep the policy they started with.
+*/
++ (void)setRequestRetryPolicy:(FBRequestRetryPolicy *)policy;
+
+/*!
+ @method
+ @abstract Returns whether friend pickers shown from a cache only fetch what changed. Defaults to NO.
+*/
++ (BOOL)isFriendListDeltaSyncEnabled;
+
+/*!
+ @method
+ @abstract Configures `FBFriendPickerViewController` to bring a friend list shown from the cache up
+   to date by fetching friend IDs alone, and then details for new friends only, rather than every page.
+ @param enable indicates whether to sync cached friend lists with deltas
+ @discussion The Graph API has no change feed for friends, so changes to a friend who is still in
+   the list, such as a new name or picture, are only picked up by a full fetch. The list is fetched
+   in full when it was last fetched that way more than a day ago, when there are too many friends for
+   one page of IDs, or when too many friends were added.
+*/
++ (void)enableFriendListDeltaSync:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns whether App Events and large uploads go through a background `NSURLSession`. Defaults to NO.
+*/
++ (BOOL)isBackgroundUploadsEnabled;
+
+/*!
+ @method
+ @abstract Configures the SDK to hand App Events pending when the app leaves the foreground, and request
+   bodies large enough to be streamed such as photo uploads, to a background `NSURLSession`, so that the
+   system finishes them while the app is suspended.
+ @param enable indicates whether to use background uploads
+ @discussion Only available on iOS 7 and later. Uploads that finish after the app was terminated are
+   reconciled at the next launch: App Events they carried are not sent again, and other uploads are reported
+   with `FBRequestConnectionBackgroundUploadDidFinishNotification`. Call
+   `[FBAppCall handleEventsForBackgroundURLSession:completionHandler:]` from your application delegate's
+   `application:handleEventsForBackgroundURLSession:completionHandler:`. Set this before any events are logged.
+*/
++ (void)enableBackgroundUploads:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns the largest width or height, in pixels, that a `UIImage` is uploaded at. Defaults to 0,
+   which uploads images at their full resolution.
+*/
++ (NSUInteger)maximumUploadImageDimension;
+
+/*!
+ @method
+ @abstract Sets the largest width or height, in pixels, that a `UIImage` is uploaded at.
+ @param dimension the largest dimension, or 0 for no limit
+ @discussion Larger images passed to `startForUploadPhoto:`, `FBPhotoParams`, staging resource uploads or as
+   any other `UIImage` request parameter are scaled down, keeping their aspect ratio, before being JPEG
+   encoded. The scaling happens on a background queue along with the encoding. The server downsamples
+   large photos anyway, so 2048 uploads at about the size they are displayed. Images given as `NSData`
+   or file `NSURL` parameters are sent as they are.
+*/
++ (void)setMaximumUploadImageDimension:(NSUInteger)dimension;
+
+/*!
+ @method
+ @abstract Returns YES if the JPEG quality of uploaded images is lowered for large images. Defaults to NO.
+*/
++ (BOOL)isAdaptiveJPEGQualityEnabled;
+
+/*!
+ @method
+ @abstract Configures the SDK to lower the JPEG quality of uploaded images as their pixel count grows.
+ @param enable indicates whether to use adaptive JPEG quality
+ @discussion Images of a megapixel or less are encoded at the default compression quality, and each
+   doubling beyond that takes 0.05 off it, down to no less than 0.6. Artifacts are hardest to see in
+   the largest images, which is where most of the bytes go.
+*/
++ (void)enableAdaptiveJPEGQuality:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns YES if the SDK's network requests are started by priority. Defaults to NO.
+*/
++ (BOOL)isRequestSchedulingEnabled;
+
+/*!
+ @method
+ @abstract Configures the SDK to start its network requests through one scheduler that ranks them
+   by `FBRequestPriority`, instead of sending each as soon as it is made.
+ @param enable indicates whether to use request scheduling
+ @discussion At most 8 requests are in flight at once: up to 6 user initiated requests, 4 on screen
+   images, 2 prefetches and 1 background request such as an App Events flush. Requests over their
+   limit wait, and the highest priority waiting request starts when a slot frees up, so picture
+   loads and telemetry don't hold up a request the user is waiting on. Set it before making requests.
+*/
++ (void)enableRequestScheduling:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns YES if Graph API requests made through the deprecated `Facebook` class are batched. Defaults to NO.
+*/
++ (BOOL)isLegacyRequestBatchingEnabled;
+
+/*!
+ @method
+ @abstract Configures the deprecated `Facebook` class to send the Graph API requests it is asked for
+   during one pass of the main run loop together, as a single batch.
+ @param enable indicates whether to batch legacy requests
+ @discussion Each request's `FBRequestDelegate` is still called for that request alone, except that
+   `request:didLoadRawResponse:` is passed the request's own response body, re-encoded as JSON, rather
+   than the raw data of the whole batch. REST API requests are always sent on their own.
+
+ A request waiting for its batch is not in `kFBRequestStateLoading`, so `-[FBRequest loading]` returns NO,
+   and its delegate's `requestLoading:` is not called until the batch is sent on the next pass of the run loop.
+*/
++ (void)enableLegacyRequestBatching:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns YES if the disk cache keeps its index in a memory mapped file rather than in SQLite. Defaults to NO.
+*/
++ (BOOL)isMappedCacheIndexEnabled;
+
+/*!
+ @method
+ @abstract Configures the SDK's disk cache to keep its index in a memory mapped hash table file, so that
+   looking up a cached image or response doesn't wait on SQLite.
+ @param enable indicates whether to use the memory mapped index
+ @discussion Takes effect when the disk cache is first opened, so set it before making requests. The two
+   indexes don't share entries: when the setting changes between launches, the disk cache starts out empty.
+*/
++ (void)enableMappedCacheIndex:(BOOL)enable;
+
+/*!
+ @method
+ @abstract Returns YES if picker rows are drawn from bitmaps rendered in the background. Defaults to NO.
+*/
++ (BOOL)isPrerenderedPickerRowsEnabled;
+
+/*!
+ @method
+ @abstract Configures the friend and place pickers to draw each row's title, subtitle and picture as a
+   single bitmap, rendered on a background queue, instead of through separate labels and an image view.
+ @param enable indicates whether to prerender picker rows
+ @discussion Bitmaps are kept in memory for each item and row size, so scrolling back over a row costs
+   no layout or text measurement at all. A row appears without its text until its bitmap is ready,
+   which is normally well within a frame. The text is drawn with the fonts and colors of the cell's
+   labels, as left by `graphObjectTableDataSource:customizeTableCell:`, but other changes made to the
+   labels and image view there don't show.
+*/
++ (void)enablePrerenderedPickerRows:(BOOL)enable;
+
 @end
@@ -16,6 +16,8 @@
 
 #import <Foundation/Foundation.h>
 
+@class FBTaskExecutor;
+
 /*!
  The consumer view of a Task. A FBTask has methods to
  inspect the state of the task, and to add continuations to
@@ -49,6 +51,29 @@
  */
 + (FBTask *)taskDependentOnTasks:(NSArray *)tasks;
 
+/*!
+ Returns a task that will be completed once all of the input tasks have
+ completed. If they all succeed, its result is an array of their results
+ in the same order, with `NSNull` standing in for nil. Otherwise it takes on
+ the exception or error of the first failed task in the array, or is
+ cancelled if any task was cancelled.
+ */
++ (FBTask *)taskForCompletionOfAllTasks:(NSArray *)tasks;
+
+/*!
+ Identical to `taskForCompletionOfAllTasks:`, except that when failFast is YES
+ the returned task completes as soon as any input task fails or is cancelled,
+ and the input tasks still running are cancelled.
+ */
++ (FBTask *)taskForCompletionOfAllTasks:(NSArray *)tasks failFast:(BOOL)failFast;
+
+/*!
+ Returns a task that will be completed with the result of the first input task
+ to succeed. If none succeed, it takes on the outcome of the first task in the
+ array, as `taskForCompletionOfAllTasks:` would.
+ */
++ (FBTask *)taskForCompletionOfAnyTask:(NSArray *)tasks;
+
 /*!
  Returns a task that will be completed a certain amount of time in the future.
  @param delay The amount of time to wait before the
@@ -98,6 +123,14 @@
  */
 - (FBTask *)dependentTaskWithBlock:(id(^)(FBTask *task))block queue:(dispatch_queue_t)queue;
 
+/*!
+ Identical to `dependentTaskWithBlock:`, except the block
+ is run by the specified executor. With an executor that runs
+ inline when already on its target, a chain of continuations
+ costs a single dispatch.
+ */
+- (FBTask *)dependentTaskWithBlock:(id(^)(FBTask *task))block executor:(FBTaskExecutor *)executor;
+
 /*!
  Identical to `dependentTaskWithBlock:`, except that the block is only run
  if this task did not produce a cancellation, error, or exception.
@@ -112,6 +145,12 @@
 */
 - (FBTask *)completionTaskWithQueue:(dispatch_queue_t)queue block:(id(^)(FBTask *task))block;
 
+/*!
+ Identical to `completionTaskWithBlock:`, except the block
+ is run by the specified executor.
+*/
+- (FBTask *)completionTaskWithExecutor:(FBTaskExecutor *)executor block:(id(^)(FBTask *task))block;
+
 /*!
  Waits until this operation is completed.
  This method is inefficient and consumes a thread resource while
@@ -18,41 +18,56 @@
 
 #import <libkern/OSAtomic.h>
 
+#import "FBDispatch.h"
 #import "FBTaskCompletionSource.h"
+#import "FBTaskExecutor.h"
 
 __attribute__ ((noinline)) void logOperationOnMainThread() {
     NSLog(@"Warning: A long-running FBTask operation is being executed on the main thread. \n"
           " Break on logOperationOnMainThread() to debug.");
 }
 
+// A task goes from pending to completing when its outcome is claimed, and to
+// completed once the outcome is stored; readers only look at the outcome after
+// seeing it completed.
+enum {
+    FBTaskStatePending = 0,
+    FBTaskStateCompleting,
+    FBTaskStateCompleted,
+};
+
+// Continuations are pushed onto a lock-free stack, which is swapped for this
+// marker when the task completes; anything added after that runs straight away.
+typedef struct FBTaskContinuation {
+    void (^block)();
+    struct FBTaskContinuation *next;
+} FBTaskContinuation;
+
+static FBTaskContinuation *const kFBTaskContinuationsClosed = (FBTaskContinuation *)1;
+
 @interface FBTask () {
+    volatile int32_t _state;
+    FBTaskContinuation *volatile _continuations;
+    // Only created once somebody waits
+    NSCondition *volatile _condition;
     id<NSObject> _result;
     NSError *_error;
     NSException *_exception;
     BOOL _cancelled;
 }
-
-@property (nonatomic, retain, readwrite) NSObject *lock;
-@property (nonatomic, retain, readwrite) NSCondition *condition;
-@property (nonatomic, assign, readwrite) BOOL completed;
-@property (nonatomic, retain, readwrite) NSMutableArray *callbacks;
 @end
 
 @implementation FBTask
 
-- (instancetype)init {
-    if ((self = [super init])) {
-        _lock = [[NSObject alloc] init];
-        _condition = [[NSCondition alloc] init];
-        _callbacks = [[NSMutableArray array] retain];
-    }
-    return self;
-}
-
 - (void)dealloc {
-    [_lock release];
+    FBTaskContinuation *continuation = _continuations;
+    while (continuation && continuation != kFBTaskContinuationsClosed) {
+        FBTaskContinuation *next = continuation->next;
+        [continuation->block release];
+        free(continuation);
+        continuation = next;
+    }
     [_condition release];
-    [_callbacks release];
     [_result release];
     [_error release];
     [_exception release];
@@ -102,156 +117,277 @@ __attribute__ ((noinline)) void logOperationOnMainThread() {
     return tcs.task;
 }
 
++ (FBTask *)taskForCompletionOfAllTasks:(NSArray *)tasks {
+    return [self taskForCompletionOfAllTasks:tasks failFast:NO];
+}
+
++ (FBTask *)taskForCompletionOfAllTasks:(NSArray *)tasks failFast:(BOOL)failFast {
+    tasks = [[tasks copy] autorelease];
+    __block int32_t remaining = (int32_t)tasks.count;
+    if (remaining == 0) {
+        return [FBTask taskWithResult:@[]];
+    }
+
+    FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
+    for (FBTask *task in tasks) {
+        [task dependentTaskWithBlock:^id(FBTask *task) {
+            if (failFast && (task.exception || task.error || task.isCancelled)) {
+                if ([FBTask trySetOutcomeOfTask:task onCompletionSource:tcs]) {
+                    for (FBTask *sibling in tasks) {
+                        [sibling trySetCancelled];
+                    }
+                }
+            }
+            if (OSAtomicDecrement32Barrier(&remaining) == 0) {
+                [FBTask trySetOutcomeOfAllTasks:tasks onCompletionSource:tcs];
+            }
+            return nil;
+        } executor:[FBTaskExecutor immediateExecutor]];
+    }
+    return tcs.task;
+}
+
++ (FBTask *)taskForCompletionOfAnyTask:(NSArray *)tasks {
+    tasks = [[tasks copy] autorelease];
+    __block int32_t remaining = (int32_t)tasks.count;
+    if (remaining == 0) {
+        return [FBTask taskWithResult:nil];
+    }
+
+    FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
+    for (FBTask *task in tasks) {
+        [task dependentTaskWithBlock:^id(FBTask *task) {
+            if (!task.exception && !task.error && !task.isCancelled) {
+                [tcs trySetResult:task.result];
+            }
+            if (OSAtomicDecrement32Barrier(&remaining) == 0) {
+                [FBTask trySetOutcomeOfAllTasks:tasks onCompletionSource:tcs];
+            }
+            return nil;
+        } executor:[FBTaskExecutor immediateExecutor]];
+    }
+    return tcs.task;
+}
+
+// Once every task has completed, reports the first failure in array order, so
+// the outcome doesn't depend on which task happened to finish first.
++ (BOOL)trySetOutcomeOfAllTasks:(NSArray *)tasks onCompletionSource:(FBTaskCompletionSource *)tcs {
+    for (FBTask *task in tasks) {
+        if (task.exception || task.error) {
+            return [self trySetOutcomeOfTask:task onCompletionSource:tcs];
+        }
+    }
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:tasks.count];
+    for (FBTask *task in tasks) {
+        if (task.isCancelled) {
+            return [tcs trySetCancelled];
+        }
+        [results addObject:task.result ?: [NSNull null]];
+    }
+    return [tcs trySetResult:results];
+}
+
++ (BOOL)trySetOutcomeOfTask:(FBTask *)task onCompletionSource:(FBTaskCompletionSource *)tcs {
+    if (task.isCancelled) {
+        return [tcs trySetCancelled];
+    } else if (task.exception) {
+        return [tcs trySetException:task.exception];
+    } else if (task.error) {
+        return [tcs trySetError:task.error];
+    }
+    return [tcs trySetResult:task.result];
+}
+
 + (FBTask *)taskWithDelay:(dispatch_time_t)delay {
     FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
-    dispatch_after(delay, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(void){
+    dispatch_after(delay, FBDispatchGetGlobalQueue(FBDispatchLaneUtility), ^(void){
         tcs.result = nil;
     });
     return tcs.task;
 }
 
 - (id<NSObject>)result {
-    @synchronized (self.lock) {
-        return _result;
-    }
+    return self.isCompleted ? _result : nil;
 }
 
 - (void)setResult:(id<NSObject>)result {
-    if (![self trySetResult:result]) {
+    if (![self trySetResult:result] && !self.wasCancelled) {
         [NSException raise:NSInternalInconsistencyException
                     format:@"Cannot set the result on a completed task."];
     }
 }
 
 - (BOOL)trySetResult:(id<NSObject>)result {
-    @synchronized (self.lock) {
-        if (self.completed) {
-            return NO;
-        }
-        self.completed = YES;
-        _result = [result retain];
-        [self runContinuations];
-        return YES;
+    if (![self claimCompletion]) {
+        return NO;
     }
+    _result = [result retain];
+    [self finishCompletion];
+    return YES;
 }
 
 - (NSError *)error {
-    @synchronized (self.lock) {
-        return _error;
-    }
+    return self.isCompleted ? _error : nil;
 }
 
 - (void)setError:(NSError *)error {
-    if (![self trySetError:error]) {
+    if (![self trySetError:error] && !self.wasCancelled) {
         [NSException raise:NSInternalInconsistencyException
                     format:@"Cannot set the error on a completed task."];
     }
 }
 
 - (BOOL)trySetError:(NSError *)error {
-    @synchronized (self.lock) {
-        if (self.completed) {
-            return NO;
-        }
-        self.completed = YES;
-        _error = [error retain];
-        [self runContinuations];
-        return YES;
+    if (![self claimCompletion]) {
+        return NO;
     }
+    _error = [error retain];
+    [self finishCompletion];
+    return YES;
 }
 
 - (NSException *)exception {
-    @synchronized (self.lock) {
-        return _exception;
-    }
+    return self.isCompleted ? _exception : nil;
 }
 
 - (void)setException:(NSException *)exception {
-    if (![self trySetException:exception]) {
+    if (![self trySetException:exception] && !self.wasCancelled) {
         [NSException raise:NSInternalInconsistencyException
                     format:@"Cannot set the exception on a completed task."];
     }
 }
 
 - (BOOL)trySetException:(NSException *)exception {
-    @synchronized (self.lock) {
-        if (self.completed) {
-            return NO;
-        }
-        self.completed = YES;
-        _exception = [exception retain];
-        [self runContinuations];
-        return YES;
+    if (![self claimCompletion]) {
+        return NO;
     }
+    _exception = [exception retain];
+    [self finishCompletion];
+    return YES;
 }
 
 - (BOOL)isCancelled {
-    @synchronized (self.lock) {
-        return _cancelled;
-    }
+    return self.isCompleted && _cancelled;
 }
 
 - (void)cancel {
-    @synchronized (self.lock) {
-        if (![self trySetCancelled]) {
-            [NSException raise:NSInternalInconsistencyException
-                        format:@"Cannot cancel a completed task."];
-        }
+    if (![self trySetCancelled]) {
+        [NSException raise:NSInternalInconsistencyException
+                    format:@"Cannot cancel a completed task."];
     }
 }
 
 - (BOOL)trySetCancelled {
-    @synchronized (self.lock) {
-        if (self.completed) {
-            return NO;
-        }
-        self.completed = YES;
-        _cancelled = YES;
-        [self runContinuations];
-        return YES;
+    if (![self claimCompletion]) {
+        return NO;
+    }
+    _cancelled = YES;
+    [self finishCompletion];
+    return YES;
+}
+
+// A task can be cancelled from the consumer side, e.g. by
+// taskForCompletionOfAllTasks:failFast:, so its source setting an outcome
+// afterwards is not a mistake.
+- (BOOL)wasCancelled {
+    // Cancellation is stored just before the state flips to completed.
+    while (_state == FBTaskStateCompleting) {
+        OSMemoryBarrier();
     }
+    return self.isCancelled;
 }
 
 - (BOOL)isCompleted {
-    @synchronized (self.lock) {
-        return _completed;
-    }
+    OSMemoryBarrier();
+    return _state == FBTaskStateCompleted;
+}
+
+// Only one caller gets to set the outcome.
+- (BOOL)claimCompletion {
+    return OSAtomicCompareAndSwap32Barrier(FBTaskStatePending, FBTaskStateCompleting, &_state);
 }
 
-- (void)setCompleted {
-    @synchronized (self.lock) {
-        _completed = YES;
+- (void)finishCompletion {
+    OSMemoryBarrier();
+    _state = FBTaskStateCompleted;
+    OSMemoryBarrier();
+
+    NSCondition *condition = _condition;
+    if (condition) {
+        [condition lock];
+        [condition broadcast];
+        [condition unlock];
     }
+
+    [self runContinuations];
 }
 
 - (void)runContinuations {
-    @synchronized (self.lock) {
-        [self.condition lock];
-        [self.condition broadcast];
-        [self.condition unlock];
-        for (void (^callback)() in self.callbacks) {
-            callback();
+    FBTaskContinuation *continuations;
+    do {
+        continuations = _continuations;
+    } while (!OSAtomicCompareAndSwapPtrBarrier(continuations, kFBTaskContinuationsClosed, (void *volatile *)&_continuations));
+
+    // Pushed newest first; run them in the order they were added. No lock is
+    // held, so a continuation is free to add more.
+    FBTaskContinuation *ordered = NULL;
+    while (continuations) {
+        FBTaskContinuation *next = continuations->next;
+        continuations->next = ordered;
+        ordered = continuations;
+        continuations = next;
+    }
+    while (ordered) {
+        FBTaskContinuation *next = ordered->next;
+        ordered->block();
+        [ordered->block release];
+        free(ordered);
+        ordered = next;
+    }
+}
+
+// Returns NO if the task has already completed, in which case the caller runs the block.
+- (BOOL)addContinuation:(void (^)())block {
+    FBTaskContinuation *continuation = NULL;
+    for (;;) {
+        FBTaskContinuation *head = _continuations;
+        if (head == kFBTaskContinuationsClosed) {
+            if (continuation) {
+                [continuation->block release];
+                free(continuation);
+            }
+            return NO;
+        }
+        if (!continuation) {
+            continuation = malloc(sizeof(FBTaskContinuation));
+            continuation->block = [block copy];
+        }
+        continuation->next = head;
+        if (OSAtomicCompareAndSwapPtrBarrier(head, continuation, (void *volatile *)&_continuations)) {
+            return YES;
         }
-        [self.callbacks removeAllObjects];
     }
 }
 
 - (FBTask *)dependentTaskWithBlock:(id(^)(FBTask *task))block {
-    return [self dependentTaskWithBlock:block queue:nil];
+    return [self dependentTaskWithBlock:block executor:[FBTaskExecutor defaultExecutor]];
 }
 
 - (FBTask *)dependentTaskWithBlock:(id(^)(FBTask *task))block queue:(dispatch_queue_t)queue {
+    return [self dependentTaskWithBlock:block executor:[FBTaskExecutor asyncExecutorWithDispatchQueue:queue]];
+}
+
+- (FBTask *)dependentTaskWithBlock:(id(^)(FBTask *task))block executor:(FBTaskExecutor *)executor {
     block = [[block copy] autorelease];
 
     FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
-    queue = queue ?: dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    executor = executor ?: [FBTaskExecutor defaultExecutor];
 
     // Capture all of the state that needs to used when the continuation is complete.
     void (^wrappedBlock)() = ^() {
-        // Always dispatching callbacks async consumes less stack space, and seems
-        // to be a little faster, but loses stacktrace information. If you're debugging,
-        // consider commenting this line out and running the block synchronously.
-        dispatch_async(queue, ^{
+        // Dispatching callbacks async consumes less stack space but loses stacktrace
+        // information; pass an executor that runs inline when debugging.
+        [executor execute:^{
             id result = nil;
             @try {
                 result = block(self);
@@ -272,21 +408,14 @@ __attribute__ ((noinline)) void logOperationOnMainThread() {
                         tcs.result = task.result;
                     }
                     return nil;
-                } queue:queue];
+                } executor:[FBTaskExecutor immediateExecutor]];
             } else {
                 tcs.result = result;
             }
-        });
+        }];
     };
 
-    BOOL completed;
-    @synchronized (self.lock) {
-        completed = self.completed;
-        if (!completed) {
-            [self.callbacks addObject:[[wrappedBlock copy] autorelease]];
-        }
-    }
-    if (completed) {
+    if (![self addContinuation:wrappedBlock]) {
         wrappedBlock();
     }
 
@@ -294,25 +423,23 @@ __attribute__ ((noinline)) void logOperationOnMainThread() {
 }
 
 - (FBTask *)completionTaskWithBlock:(id(^)(FBTask *task))block {
-    block = [block copy];
-    return [self dependentTaskWithBlock:^id(FBTask *task) {
-        if (task.error || task.exception || task.isCancelled) {
-            return task;
-        } else {
-            return [task dependentTaskWithBlock:block];
-        }
-    }];
+    return [self completionTaskWithExecutor:[FBTaskExecutor defaultExecutor] block:block];
 }
 
 - (FBTask *)completionTaskWithQueue:(dispatch_queue_t)queue block:(id(^)(FBTask *task))block {
-    block = [block copy];
+    return [self completionTaskWithExecutor:[FBTaskExecutor asyncExecutorWithDispatchQueue:queue] block:block];
+}
+
+- (FBTask *)completionTaskWithExecutor:(FBTaskExecutor *)executor block:(id(^)(FBTask *task))block {
+    block = [[block copy] autorelease];
+    // Checking for failure is cheap, so only the block itself pays for a dispatch.
     return [self dependentTaskWithBlock:^id(FBTask *task) {
         if (task.error || task.exception || task.isCancelled) {
             return task;
         } else {
-            return [task dependentTaskWithBlock:block queue:queue];
+            return [task dependentTaskWithBlock:block executor:executor];
         }
-    }];
+    } executor:[FBTaskExecutor immediateExecutor]];
 }
 
 - (void)warnOperationOnMainThread {
@@ -330,14 +457,28 @@ __attribute__ ((noinline)) void logOperationOnMainThread() {
         [self warnOperationOnMainThread];
     }
 
-    @synchronized (self.lock) {
-        if (self.isCompleted) {
-            return;
+    if (self.isCompleted) {
+        return;
+    }
+
+    NSCondition *condition = _condition;
+    if (!condition) {
+        NSCondition *newCondition = [[NSCondition alloc] init];
+        if (OSAtomicCompareAndSwapPtrBarrier(nil, newCondition, (void *volatile *)&_condition)) {
+            condition = newCondition;
+        } else {
+            [newCondition release];
+            condition = _condition;
         }
-        [self.condition lock];
     }
-    [self.condition wait];
-    [self.condition unlock];
+
+    // Completion looks for the condition only after marking the task completed,
+    // so checking again under its lock can't miss the broadcast.
+    [condition lock];
+    while (!self.isCompleted) {
+        [condition wait];
+    }
+    [condition unlock];
 }
 
 - (id)waitForResult:(NSError **)error {
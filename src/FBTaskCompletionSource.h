@@ -36,19 +36,25 @@
 
 /*!
  Completes the task by setting the result.
- Attempting to set this for a completed task will raise an exception.
+ Attempting to set this for a completed task will raise an exception,
+ unless the task was cancelled by a combinator such as
+ `taskForCompletionOfAllTasks:failFast:`, in which case the value is dropped.
  */
 - (void)setResult:(id<NSObject>)result;
 
 /*!
  Completes the task by setting the error.
- Attempting to set this for a completed task will raise an exception.
+ Attempting to set this for a completed task will raise an exception,
+ unless the task was cancelled by a combinator such as
+ `taskForCompletionOfAllTasks:failFast:`, in which case the value is dropped.
  */
 - (void)setError:(NSError *)error;
 
 /*!
  Completes the task by setting an exception.
- Attempting to set this for a completed task will raise an exception.
+ Attempting to set this for a completed task will raise an exception,
+ unless the task was cancelled by a combinator such as
+ `taskForCompletionOfAllTasks:failFast:`, in which case the value is dropped.
  */
 - (void)setException:(NSException *)exception;
 
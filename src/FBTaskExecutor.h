@@ -0,0 +1,63 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+/*!
+ Decides where and when the continuations of an FBTask run.
+ */
+@interface FBTaskExecutor : NSObject
+
+/*!
+ Dispatches every block asynchronously to the global queue of the utility lane.
+ */
++ (FBTaskExecutor *)defaultExecutor;
+
+/*!
+ Runs every block right away on the calling thread, falling back to the
+ default executor once continuations are nested too deeply on the stack.
+ Only suitable for short blocks that don't care which thread they run on.
+ */
++ (FBTaskExecutor *)immediateExecutor;
+
+/*!
+ Runs blocks right away when already on the main thread, and dispatches them
+ asynchronously to the main queue otherwise.
+ */
++ (FBTaskExecutor *)mainThreadExecutor;
+
+/*!
+ Runs blocks right away when already running on the given queue, and
+ dispatches them asynchronously to it otherwise. Global queues cannot be
+ recognized, so blocks are always dispatched to them.
+ @param queue The queue blocks must run on.
+ */
++ (FBTaskExecutor *)executorWithDispatchQueue:(dispatch_queue_t)queue;
+
+/*!
+ Always dispatches blocks asynchronously to the given queue, even when
+ already running on it.
+ @param queue The queue blocks must run on.
+ */
++ (FBTaskExecutor *)asyncExecutorWithDispatchQueue:(dispatch_queue_t)queue;
+
+/*!
+ Runs the given block according to this executor's rules.
+ */
+- (void)execute:(void(^)())block;
+
+@end
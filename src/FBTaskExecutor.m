@@ -0,0 +1,176 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBTaskExecutor.h"
+
+#import <pthread.h>
+
+#import "FBDispatch.h"
+
+// How many continuations may run inline on top of each other before we
+// unwind the stack with a dispatch.
+static const NSUInteger FBTaskExecutorMaxInlineDepth = 20;
+
+static pthread_key_t FBTaskExecutorDepthKey(void) {
+    static pthread_key_t key;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&key, NULL);
+    });
+    return key;
+}
+
+// The queue whose executor block is running on this thread. The queues are
+// usually the app's, so we keep this to ourselves rather than tagging them
+// with dispatch_queue_set_specific.
+static pthread_key_t FBTaskExecutorCurrentQueueKey(void) {
+    static pthread_key_t key;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&key, NULL);
+    });
+    return key;
+}
+
+@interface FBTaskExecutor ()
+
+@property (nonatomic, assign) dispatch_queue_t queue;
+@property (nonatomic, assign) BOOL mainThread;
+@property (nonatomic, assign) BOOL immediate;
+@property (nonatomic, assign) BOOL async;
+
+@end
+
+@implementation FBTaskExecutor
+
+- (id)initWithQueue:(dispatch_queue_t)queue mainThread:(BOOL)mainThread immediate:(BOOL)immediate {
+    return [self initWithQueue:queue mainThread:mainThread immediate:immediate async:NO];
+}
+
+- (id)initWithQueue:(dispatch_queue_t)queue
+         mainThread:(BOOL)mainThread
+          immediate:(BOOL)immediate
+              async:(BOOL)async {
+    if ((self = [super init])) {
+        if (queue) {
+            dispatch_retain(queue);
+        }
+        _queue = queue;
+        _mainThread = mainThread;
+        _immediate = immediate;
+        _async = async;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_queue) {
+        dispatch_release(_queue);
+    }
+    [super dealloc];
+}
+
++ (FBTaskExecutor *)defaultExecutor {
+    static FBTaskExecutor *_instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBTaskExecutor alloc] initWithQueue:FBDispatchGetGlobalQueue(FBDispatchLaneUtility)
+                                               mainThread:NO
+                                                immediate:NO
+                                                    async:YES];
+    });
+    return _instance;
+}
+
++ (FBTaskExecutor *)immediateExecutor {
+    static FBTaskExecutor *_instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBTaskExecutor alloc] initWithQueue:nil mainThread:NO immediate:YES];
+    });
+    return _instance;
+}
+
++ (FBTaskExecutor *)mainThreadExecutor {
+    static FBTaskExecutor *_instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBTaskExecutor alloc] initWithQueue:dispatch_get_main_queue() mainThread:YES immediate:NO];
+    });
+    return _instance;
+}
+
++ (FBTaskExecutor *)executorWithDispatchQueue:(dispatch_queue_t)queue {
+    if (!queue || queue == FBDispatchGetGlobalQueue(FBDispatchLaneUtility)) {
+        return [self defaultExecutor];
+    }
+    if (queue == dispatch_get_main_queue()) {
+        return [self mainThreadExecutor];
+    }
+    return [[[FBTaskExecutor alloc] initWithQueue:queue mainThread:NO immediate:NO] autorelease];
+}
+
++ (FBTaskExecutor *)asyncExecutorWithDispatchQueue:(dispatch_queue_t)queue {
+    if (!queue || queue == FBDispatchGetGlobalQueue(FBDispatchLaneUtility)) {
+        return [self defaultExecutor];
+    }
+    return [[[FBTaskExecutor alloc] initWithQueue:queue mainThread:NO immediate:NO async:YES] autorelease];
+}
+
+- (BOOL)isOnTarget {
+    if (self.immediate) {
+        return YES;
+    }
+    if (self.async) {
+        return NO;
+    }
+    if (self.mainThread) {
+        return pthread_main_np() != 0;
+    }
+    return pthread_getspecific(FBTaskExecutorCurrentQueueKey()) == (void *)self.queue;
+}
+
+- (void)execute:(void(^)())block {
+    pthread_key_t key = FBTaskExecutorDepthKey();
+    uintptr_t depth = (uintptr_t)pthread_getspecific(key);
+    if (depth < FBTaskExecutorMaxInlineDepth && [self isOnTarget]) {
+        pthread_setspecific(key, (void *)(depth + 1));
+        @try {
+            block();
+        } @finally {
+            pthread_setspecific(key, (void *)depth);
+        }
+        return;
+    }
+    if (!self.queue || self.mainThread) {
+        dispatch_async(self.queue ?: FBDispatchGetGlobalQueue(FBDispatchLaneUtility), block);
+        return;
+    }
+    dispatch_queue_t queue = self.queue;
+    dispatch_async(queue, ^{
+        pthread_key_t queueKey = FBTaskExecutorCurrentQueueKey();
+        void *previous = pthread_getspecific(queueKey);
+        pthread_setspecific(queueKey, (void *)queue);
+        @try {
+            block();
+        } @finally {
+            pthread_setspecific(queueKey, previous);
+        }
+    });
+}
+
+@end
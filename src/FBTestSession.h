@@ -61,6 +61,14 @@ FBSDK_EXTERN NSString *kThirdTestUserTag;
  scenarios which require a new user in a known clean state, a new test user will always be
  created, and it will be automatically deleted when the FBTestSession is closed.
 
+ Shared test users are leased: while one FBTestSession has a user open, no other session, in this
+ process or another test process pointed at the same pool, is given it. This makes it safe to run
+ independent test classes concurrently; each gets a user of its own, with more created as needed.
+ The app's test users are remembered on disk for a day, so later test runs reuse them without
+ listing them again. The pool lives in the caches directory, or in the directory named by the
+ IOS_SDK_TEST_USER_POOL_DIRECTORY environment variable; point simulators that run tests at the
+ same time at one shared directory. Delete the pool after removing test users by other means.
+
  Note that the shared test user functionality depends on a naming convention for the test users.
  It is important that any testing of functionality which will mutate the permissions for a
  test user NOT use a shared test user, or this scheme will break down. If a shared test user
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+#import "FBGraphObject.h"
+
+@class FBRequestRetryPolicy;
+@class FBSession;
+@class FBVideoUpload;
+
+/*!
+ @typedef FBVideoUploadHandler
+
+ @abstract Called when an upload finishes, fails or is cancelled.
+
+ @param upload The upload.
+ @param result The response to the finish phase, with the video's ID under "video_id", or nil on error.
+ @param error The error, or nil if the video was posted.
+ */
+typedef void (^FBVideoUploadHandler)(FBVideoUpload *upload, id<FBGraphObject> result, NSError *error);
+
+/*!
+ @typedef FBVideoUploadProgressHandler
+
+ @abstract Called each time the server acknowledges a chunk.
+ */
+typedef void (^FBVideoUploadProgressHandler)(FBVideoUpload *upload, unsigned long long bytesUploaded, unsigned long long totalBytes);
+
+/*!
+ @class FBVideoUpload
+
+ @abstract
+ Posts a video file with the Graph API's resumable upload protocol.
+
+ @discussion
+ Rather than sending the whole video in one request, the upload opens an upload session
+ (the start phase), sends the file a chunk at a time at the offsets the server asks for
+ (the transfer phase), and then publishes the video with `parameters` (the finish phase).
+ Only one chunk is read from the file at a time, and a chunk that fails transiently is sent
+ again after a backoff, following `retryPolicy`, instead of starting the video over.
+
+ If the upload fails anyway, calling `startWithCompletionHandler:` again resumes it from the
+ last offset the server acknowledged. The server decides the offset of each chunk once it has
+ the previous one, so chunks of one upload always go out one after another.
+
+ All methods must be called, and handlers are called, on the main thread.
+ */
+@interface FBVideoUpload : NSObject
+
+/*!
+ @abstract Creates an upload of a video file.
+
+ @param session The session to post with, or nil for the active session.
+ @param graphPath Where to post the video, such as @"me/videos".
+ @param fileURL The file URL of the video.
+ @param parameters Parameters sent with the finish phase, such as "title" and "description".
+ */
+- (instancetype)initWithSession:(FBSession *)session
+                      graphPath:(NSString *)graphPath
+                        fileURL:(NSURL *)fileURL
+                     parameters:(NSDictionary *)parameters;
+
+/*! @abstract The file being uploaded. */
+@property (nonatomic, readonly, retain) NSURL *fileURL;
+
+/*! @abstract The server's ID for the upload session, once the start phase has completed. */
+@property (nonatomic, readonly, copy) NSString *uploadSessionID;
+
+/*! @abstract The ID of the video being posted, once the start phase has completed. */
+@property (nonatomic, readonly, copy) NSString *videoID;
+
+/*! @abstract The bytes the server has acknowledged so far. */
+@property (nonatomic, readonly) unsigned long long bytesUploaded;
+
+/*! @abstract The size of the file, once the upload has started. */
+@property (nonatomic, readonly) unsigned long long fileSize;
+
+/*!
+ @abstract Decides which failed requests are sent again, and how long to wait first. Defaults to a
+ policy that retries each request up to 5 times.
+ */
+@property (nonatomic, retain) FBRequestRetryPolicy *retryPolicy;
+
+/*! @abstract Called as chunks are acknowledged. */
+@property (nonatomic, copy) FBVideoUploadProgressHandler progressHandler;
+
+/*!
+ @abstract Starts the upload, or resumes it after a failure.
+
+ @param handler Called once the upload has finished, failed or been cancelled.
+ */
+- (void)startWithCompletionHandler:(FBVideoUploadHandler)handler;
+
+/*!
+ @abstract Stops the upload, calling the handler with an `FBErrorOperationCancelled` error. It can
+ be resumed later with `startWithCompletionHandler:`.
+ */
+- (void)cancel;
+
+@end
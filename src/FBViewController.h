@@ -16,6 +16,7 @@
 
 #import <UIKit/UIKit.h>
 
+@class FBCancellationToken;
 @class FBViewController;
 
 /*!
@@ -101,6 +102,19 @@ typedef void (^FBModalCompletionHandler)(FBViewController *sender, BOOL donePres
  */
 @property (nonatomic, readonly, retain) UIView *canvasView;
 
+/*!
+ @abstract
+ The token that cancels the network work done on behalf of this view controller, such as
+ loading its data and pictures.
+
+ @discussion
+ It is cancelled, and replaced with a new one, when the view controller dismisses itself
+ after Done or Cancel is pressed. Cancel it yourself when dismissing the view controller
+ some other way, or use it to cancel your own <FBRequestConnection>s along with the
+ view controller's.
+ */
+@property (nonatomic, readonly, retain) FBCancellationToken *cancellationToken;
+
 /*!
  @abstract
  Provides a wrapper that presents the view controller modally and automatically dismisses it
@@ -161,6 +161,18 @@ typedef void (^FBWebDialogHandler)(
                                  parameters:(NSDictionary *)parameters
                                     handler:(FBWebDialogHandler)handler;
 
+/*!
+ @abstract
+ Prepares the web view used by the next dialog, so that presenting it does not wait for
+ WebKit to start up.
+
+ @discussion
+ The work is deferred until the main run loop is idle. Call from the main thread, for
+ example once the screen that offers a dialog has appeared. Prepared state is dropped on
+ memory warnings.
+ */
++ (void)prewarm;
+
 @end
 
 /*!
@@ -19,6 +19,7 @@
 #import "FBAppCall.h"
 #import "FBAppEvents.h"
 #import "FBCacheDescriptor.h"
+#import "FBCancellationToken.h"
 #import "FBDialogs.h"
 #import "FBError.h"
 #import "FBErrorUtility.h"
@@ -31,6 +32,7 @@
 #import "FBInsights.h"
 #import "FBLikeControl.h"
 #import "FBLoginView.h"
+#import "FBMetrics.h"
 #import "FBNativeDialogs.h"         // deprecated, use FBDialogs.h
 #import "FBOpenGraphAction.h"
 #import "FBOpenGraphActionShareDialogParams.h"
@@ -38,12 +40,16 @@
 #import "FBPlacePickerViewController.h"
 #import "FBProfilePictureView.h"
 #import "FBRequest.h"
+#import "FBRequestRetryPolicy.h"
+#import "FBRequestTimings.h"
 #import "FBSession.h"
+#import "FBSessionPool.h"
 #import "FBSessionTokenCachingStrategy.h"
 #import "FBSettings.h"
 #import "FBShareDialogParams.h"
 #import "FBShareDialogPhotoParams.h"
 #import "FBUserSettingsViewController.h"
+#import "FBVideoUpload.h"
 #import "FBWebDialogs.h"
 #import "NSError+FBError.h"
 
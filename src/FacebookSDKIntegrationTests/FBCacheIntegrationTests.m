@@ -94,7 +94,7 @@ static FBCacheIndex *initTempCacheIndex(
 
 #pragma mark - FBCacheIndexFileDelegate
 
-- (void)cacheIndex:(FBCacheIndex *)cacheIndex
+- (void)cacheIndex:(id<FBCacheIndexing>)cacheIndex
  writeFileWithName:(NSString *)name
               data:(NSData *)data
 {
@@ -106,7 +106,7 @@ static FBCacheIndex *initTempCacheIndex(
     });
 }
 
-- (void)cacheIndex:(FBCacheIndex *)cacheIndex
+- (void)cacheIndex:(id<FBCacheIndexing>)cacheIndex
 deleteFileWithName:(NSString *)name
 {
     NSString *filePath = [_dataCachePath stringByAppendingPathComponent:name];
@@ -165,7 +165,8 @@ deleteFileWithName:(NSString *)name
 
     __block FBCacheEntityInfo *info = nil;
     dispatch_sync(cacheIndex.databaseQueue, ^{
-        info = [cacheIndex performSelector:@selector(_readEntryFromDatabase:) withObject:@"test1"];
+        info = [cacheIndex performSelector:@selector(_readEntryFromDatabase:)
+                                withObject:[FBCacheIndex digestForKey:@"test1"]];
     });
 
     STAssertNotNil(info, @"Index not written to disk!");
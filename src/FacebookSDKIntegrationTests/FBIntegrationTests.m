@@ -25,7 +25,8 @@
 #include <pthread.h>
 
 static NSMutableDictionary *mapTestCasesToSessions;
-// Concurrency not an issue today, but guard our static global in any case.
+// Test classes may run concurrently, each with its own leased test users, so guard
+// our static global.
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
 #pragma mark Private interface
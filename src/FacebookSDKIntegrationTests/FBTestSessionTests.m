@@ -95,6 +95,110 @@
     [session close];
 }
 
+- (void)testOpenSharedUsersAreNotHandedOutTwice
+{
+    FBTestSession *first = [FBTestSession sessionWithSharedUserWithPermissions:nil];
+    [self loginSession:first];
+    FBTestSession *second = [FBTestSession sessionWithSharedUserWithPermissions:nil];
+    [self loginSession:second];
+
+    STAssertFalse([first.testUserID isEqualToString:second.testUserID], @"a leased user was shared");
+    NSString *firstUserID = [[first.testUserID copy] autorelease];
+    [first close];
+    [second close];
+
+    // Once given back, the user is reused
+    FBTestSession *third = [FBTestSession sessionWithSharedUserWithPermissions:nil];
+    [self loginSession:third];
+    STAssertNotNil(third.testUserID, @"no test user");
+    STAssertTrue([third.testUserID isEqualToString:firstUserID] || [third.testUserID isEqualToString:second.testUserID],
+                 @"a released user should have been reused");
+    [third close];
+}
+
+
+// Where FBTestSession keeps the app's pool of test users and their leases
+- (NSString *)poolDirectoryForSession:(FBTestSession *)session
+{
+    NSString *root = [[[NSProcessInfo processInfo] environment] objectForKey:@"IOS_SDK_TEST_USER_POOL_DIRECTORY"];
+    if (!root.length) {
+        NSString *caches = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
+        root = [caches stringByAppendingPathComponent:@"com.facebook.sdk.FBTestSession"];
+    }
+    return [root stringByAppendingPathComponent:session.testAppID];
+}
+
+- (NSString *)writeLeaseForUserID:(NSString *)userID ownerPID:(pid_t)pid inDirectory:(NSString *)directory
+{
+    NSString *path = [[directory stringByAppendingPathComponent:userID] stringByAppendingPathExtension:@"lease"];
+    [[NSString stringWithFormat:@"%d", (int)pid] writeToFile:path atomically:YES encoding:NSUTF8StringEncoding error:nil];
+    return path;
+}
+
+- (void)testSharedUserIsSavedToThePool
+{
+    FBTestSession *session = [FBTestSession sessionWithSharedUserWithPermissions:nil];
+    [self loginSession:session];
+
+    NSString *poolPath = [[self poolDirectoryForSession:session] stringByAppendingPathComponent:@"users.plist"];
+    NSDictionary *pool = [NSDictionary dictionaryWithContentsOfFile:poolPath];
+    STAssertNotNil(pool[@"users"][session.testUserID], @"the leased user should be in the pool");
+    STAssertTrue([pool[@"timestamp"] isKindOfClass:[NSDate class]], @"the pool should record when it was listed");
+    [session close];
+}
+
+- (void)testLeaseHeldByAnotherProcessIsRespected
+{
+    FBTestSession *first = [FBTestSession sessionWithSharedUserWithPermissions:nil];
+    [self loginSession:first];
+    NSString *userID = [[first.testUserID copy] autorelease];
+    NSString *directory = [self poolDirectoryForSession:first];
+    [first close];
+
+    // The test runner is alive, so its lease stands
+    NSString *leasePath = [self writeLeaseForUserID:userID ownerPID:getppid() inDirectory:directory];
+    FBTestSession *second = [FBTestSession sessionWithSharedUserWithPermissions:nil];
+    [self loginSession:second];
+
+    STAssertNotNil(second.testUserID, @"no test user");
+    STAssertFalse([second.testUserID isEqualToString:userID], @"a user leased by another process was handed out");
+    [second close];
+    [[NSFileManager defaultManager] removeItemAtPath:leasePath error:nil];
+}
+
+- (void)testLeaseLeftByADeadProcessIsTakenOver
+{
+    FBTestSession *first = [FBTestSession sessionWithSharedUserWithPermissions:nil];
+    [self loginSession:first];
+    NSString *userID = [[first.testUserID copy] autorelease];
+    NSString *directory = [self poolDirectoryForSession:first];
+    [first close];
+
+    // Every other pooled user is leased by a live process, so only the abandoned lease is free
+    NSMutableArray *otherLeases = [NSMutableArray array];
+    NSDictionary *pool = [NSDictionary dictionaryWithContentsOfFile:[directory stringByAppendingPathComponent:@"users.plist"]];
+    for (NSString *otherUserID in pool[@"users"]) {
+        if (![otherUserID isEqualToString:userID]) {
+            [otherLeases addObject:[self writeLeaseForUserID:otherUserID ownerPID:getppid() inDirectory:directory]];
+        }
+    }
+    // No process has this pid
+    NSString *leasePath = [self writeLeaseForUserID:userID ownerPID:0x7ffffffe inDirectory:directory];
+
+    FBTestSession *second = [FBTestSession sessionWithSharedUserWithPermissions:nil];
+    [self loginSession:second];
+
+    STAssertEqualObjects(second.testUserID, userID, @"the abandoned lease should have been taken over");
+    NSString *owner = [NSString stringWithContentsOfFile:leasePath encoding:NSUTF8StringEncoding error:nil];
+    STAssertEquals([owner intValue], (int)getpid(), @"the lease should now name this process");
+    [second close];
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:leasePath], @"closing should give the lease back");
+
+    for (NSString *otherLease in otherLeases) {
+        [[NSFileManager defaultManager] removeItemAtPath:otherLease error:nil];
+    }
+}
+
 @end
 
 #endif
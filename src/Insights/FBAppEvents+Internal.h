@@ -17,7 +17,9 @@
 #import "FBAppEvents.h"
 #import "FBSDKMacros.h"
 
+@class FBAppEventsFlushPolicy;
 @class FBRequest;
+@class FBRequestConnection;
 
 // Internally known event names
 
@@ -102,7 +104,10 @@ typedef enum {
     FBAppEventsFlushReasonSessionChange,
     FBAppEventsFlushReasonPersistedEvents,
     FBAppEventsFlushReasonEventThreshold,
-    FBAppEventsFlushReasonEagerlyFlushingEvent
+    FBAppEventsFlushReasonEagerlyFlushingEvent,
+    FBAppEventsFlushReasonRetry,
+    FBAppEventsFlushReasonPiggyback,
+    FBAppEventsFlushReasonBackgroundUpload
 } FBAppEventsFlushReason;
 
 @interface FBAppEvents (Internal)
@@ -114,6 +119,24 @@ typedef enum {
 
 + (FBRequest *)customAudienceThirdPartyIDRequest:(FBSession *)session;
 
+// Adds up to maximumCount requests posting events that are waiting to go out to a batch for appID
+// that is being sent anyway, so the upload rides that radio wakeup instead of one of its own.
+// Does nothing unless events have been logged.  Call on the main thread, before the connection starts.
++ (void)addPiggybackRequestsToConnection:(FBRequestConnection *)connection
+                                forAppID:(NSString *)appID
+                            maximumCount:(NSUInteger)maximumCount;
+
+// Decides when events are flushed and how many are buffered.  Setting nil restores the default policy.
++ (FBAppEventsFlushPolicy *)flushPolicy;
++ (void)setFlushPolicy:(FBAppEventsFlushPolicy *)flushPolicy;
+
+// Opens the event journal, reading back what an earlier run left in it.  May be called from any thread.
++ (void)prewarm;
+
+// Settles events an earlier run handed to background uploads as their results come in.  Does
+// nothing after the first call.  Call on the main thread, with background uploads available.
++ (void)reconcileBackgroundUploads;
+
 // *** Expose internally for testing/mocking only ***
 + (FBAppEvents *)singleton;
 - (void)handleActivitiesPostCompletion:(NSError *)error
@@ -125,6 +148,7 @@ typedef enum {
                    session:(FBSession *)session;
 
 - (void)instanceFlush:(FBAppEventsFlushReason)flushReason;
+- (void)reconcileBackgroundUploads;
 
 // *** end ***
 
@@ -19,13 +19,24 @@
 
 #import <UIKit/UIApplication.h>
 
+#import "FBAppEventsFlushPolicy.h"
+#import "FBAppEventsJournal.h"
+#import "FBBackgroundUploader.h"
+#import "FBDispatch.h"
 #import "FBError.h"
 #import "FBLogger.h"
+#import "FBMainThreadWatchdog.h"
+#import "FBMaintenanceScheduler.h"
+#import "FBMetrics.h"
 #import "FBRequest+Internal.h"
+#import "FBRequestConnection+Internal.h"
+#import "FBRequestConnection.h"
 #import "FBSession+Internal.h"
 #import "FBSessionAppEventsState.h"
 #import "FBSessionManualTokenCachingStrategy.h"
 #import "FBSettings+Internal.h"
+#import "FBStartupProfiler.h"
+#import "FBTrace.h"
 #import "FBUtility.h"
 
 //
@@ -139,13 +150,30 @@ typedef enum {
 @property (readwrite, atomic) FBAppEventsFlushBehavior     flushBehavior;
 @property (readwrite, atomic) BOOL                         haveOutstandingPersistedData;
 @property (readwrite, atomic, retain) FBSession                   *lastSessionLoggedTo;
-@property (readwrite, atomic, retain) NSTimer                     *flushTimer;
-@property (readwrite, atomic, retain) NSTimer                     *attributionIDRecheckTimer;
+@property (readwrite, atomic, assign) dispatch_queue_t            flushQueue;
+// Handles for the tasks run by FBMaintenanceScheduler
+@property (readwrite, atomic, retain) id                          flushTask;
+@property (readwrite, atomic, retain) id                          attributionIDRecheckTask;
 @property (readwrite, atomic) AppSupportsAttributionStatus appSupportsAttributionStatus;
 @property (readwrite, atomic) BOOL                         appSupportsImplicitLogging;
 @property (readwrite, atomic) BOOL                         haveFetchedAppSettings;
-@property (readwrite, atomic, retain) NSRegularExpression         *eventNameRegex;
-@property (readwrite, atomic, retain) NSMutableSet                *validatedIdentifiers;
+@property (readwrite, atomic, retain) FBAppEventsJournal          *journal;
+@property (readwrite, atomic, retain) FBAppEventsFlushPolicy      *flushPolicy;
+// Opt-in per event name handling of high-frequency events.  Guarded by @synchronized (self).
+@property (readwrite, atomic, retain) NSMutableSet                *aggregatedEventNames;
+@property (readwrite, atomic, retain) NSMutableDictionary         *eventSamplingRates;
+// Backoff state after an upload that didn't get through.  Only touched on the flushQueue.
+@property (readwrite, atomic) NSUInteger                   uploadRetryCount;
+@property (readwrite, atomic) BOOL                         uploadRetryPending;
+// Every session logged to that may still have events to send.  Guarded by @synchronized (self).
+@property (readwrite, atomic, retain) NSMutableSet                *sessionsWithPendingEvents;
+// Journal sequence numbers of events an earlier run handed to a background upload that hasn't
+// been reconciled yet, which are kept out of recovery meanwhile.  Only touched on the flushQueue.
+@property (readwrite, atomic, retain) NSMutableSet                *backgroundUploadSequenceNumbers;
+// Set once the journal's recovered events have been taken.  Only touched on the flushQueue.
+@property (readwrite, atomic) BOOL                         haveRecoveredJournalEvents;
+// Set once background uploads are being reconciled.  Only touched on the main thread.
+@property (readwrite, atomic) BOOL                         reconcilingBackgroundUploads;
 
 // Dictionary from appIDs to ClientToken-based app-authenticated session for that appID.
 @property (readwrite, atomic, retain) NSMutableDictionary         *appAuthSessions;
@@ -156,7 +184,9 @@ typedef enum {
 
 @implementation FBAppEvents
 
+// Events persisted as one JSON file by earlier versions of the SDK
 NSString *const FBAppEventsPersistedEventsFilename   = @"com-facebook-sdk-AppEventsPersistedEvents.json";
+NSString *const FBAppEventsJournalFilename           = @"com-facebook-sdk-AppEventsJournal.bin";
 
 NSString *const FBAppEventsPersistKeyNumSkipped      = @"numSkipped";
 NSString *const FBAppEventsPersistKeyEvents          = @"events";
@@ -164,11 +194,45 @@ NSString *const FBAppEventsPersistKeyEvents          = @"events";
 
 #pragma mark - Constants
 
-const int NUM_LOG_EVENTS_TO_TRY_TO_FLUSH_AFTER       = 100;
-const int FLUSH_PERIOD_IN_SECONDS                    = 60;
 const int APP_SUPPORTS_ATTRIBUTION_ID_RECHECK_PERIOD = 60 * 60 * 24;
 const int MAX_IDENTIFIER_LENGTH                      = 40;
 
+// Failed uploads are retried after 5s, 10s, 20s... up to 15 minutes, each less up to half for jitter
+static const NSTimeInterval kUploadRetryBaseDelay = 5;
+static const NSTimeInterval kUploadRetryMaxDelay = 15 * 60;
+
+// How early the flush and attribution recheck may run to share a wakeup with other SDK work
+static const NSTimeInterval kFlushTimerLeeway = 10;
+static const NSTimeInterval kAttributionIDRecheckLeeway = 60 * 60;
+
+static void *const kFlushQueueKey = (void *)&kFlushQueueKey;
+
+static NSString *const kBackgroundUploadSequenceNumbersKey = @"sequenceNumbers";
+
+// Event names and parameter keys must only have 0-9A-Za-z, underscore, hyphen, and space (but no hyphen
+// or space in the first position), ie. match ^[0-9a-zA-Z_]+[0-9a-zA-Z _-]*$.  Identifiers are at most
+// MAX_IDENTIFIER_LENGTH characters, so a scan is cheaper than looking up a cached result would be.
+static BOOL FBAppEventsIsValidIdentifierCharacters(NSString *identifier) {
+    unichar characters[MAX_IDENTIFIER_LENGTH];
+    NSUInteger length = identifier.length;
+    if (length == 0 || length > MAX_IDENTIFIER_LENGTH) {
+        return NO;
+    }
+    [identifier getCharacters:characters range:NSMakeRange(0, length)];
+
+    for (NSUInteger i = 0; i < length; i++) {
+        unichar c = characters[i];
+        BOOL isAlphanumericOrUnderscore = (c >= '0' && c <= '9') ||
+            (c >= 'a' && c <= 'z') ||
+            (c >= 'A' && c <= 'Z') ||
+            c == '_';
+        if (!isAlphanumericOrUnderscore && (i == 0 || (c != ' ' && c != '-'))) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
 #pragma mark - logEvent variants
 
 /*
@@ -207,6 +271,7 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
       valueToSum:(NSNumber *)valueToSum
       parameters:(NSDictionary *)parameters
          session:(FBSession *)session {
+    FBMainThreadWatchdogMeasure();
     [FBAppEvents.singleton instanceLogEvent:eventName
                                 valueToSum:valueToSum
                                 parameters:parameters
@@ -250,6 +315,7 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
            currency:(NSString *)currency
          parameters:(NSDictionary *)parameters
             session:(FBSession *)session {
+    FBMainThreadWatchdogMeasure();
 
     // A purchase event is just a regular logged event with a given event name
     // and treating the currency value as going into the parameters dictionary.
@@ -316,6 +382,7 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
 }
 
 + (void)activateApp {
+    FBMainThreadWatchdogMeasure();
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
     // activateApp supercedes publishInstall in the public API, but we need to
@@ -337,20 +404,54 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
 }
 
 + (void)flush {
+    FBMainThreadWatchdogMeasure();
     [FBAppEvents.singleton instanceFlush:FBAppEventsFlushReasonExplicit];
 }
 
++ (void)setAggregatesEvents:(BOOL)aggregatesEvents forEventName:(NSString *)eventName {
+    FBAppEvents *appEvents = FBAppEvents.singleton;
+    @synchronized (appEvents) {
+        if (aggregatesEvents) {
+            [appEvents.aggregatedEventNames addObject:eventName];
+        } else {
+            [appEvents.aggregatedEventNames removeObject:eventName];
+        }
+    }
+}
+
++ (void)setSamplingRate:(double)samplingRate forEventName:(NSString *)eventName {
+    FBAppEvents *appEvents = FBAppEvents.singleton;
+    @synchronized (appEvents) {
+        if (samplingRate >= 1) {
+            [appEvents.eventSamplingRates removeObjectForKey:eventName];
+        } else {
+            [appEvents.eventSamplingRates setObject:[NSNumber numberWithDouble:MAX(samplingRate, 0)] forKey:eventName];
+        }
+    }
+}
+
++ (FBAppEventsFlushPolicy *)flushPolicy {
+    return FBAppEvents.singleton.flushPolicy;
+}
+
++ (void)setFlushPolicy:(FBAppEventsFlushPolicy *)flushPolicy {
+    FBAppEvents.singleton.flushPolicy = flushPolicy ?: [[[FBAppEventsFlushPolicy alloc] init] autorelease];
+}
+
 #pragma mark - Private Methods
 
 
+// Set once by +singleton; read directly where creating it would be wasted work
+static FBAppEvents *g_singleton = nil;
+
 + (FBAppEvents *)singleton {
     static dispatch_once_t pred;
-    static FBAppEvents *shared = nil;
 
     dispatch_once(&pred, ^{
-        shared = [[FBAppEvents alloc] init];
+        FBStartupProfilerMeasure("FBAppEvents singleton");
+        g_singleton = [[FBAppEvents alloc] init];
     });
-    return shared;
+    return g_singleton;
 }
 
 
@@ -360,7 +461,9 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
  *
  * Logging events may be invoked from any thread.  The FBSession-specific logging data structures
  * will be locked before being updated.  Flushes, be they invoked explicitly or implicitly, will be
- * dispatched to the main thread.
+ * dispatched to the serial flushQueue, which also runs the flush timer and handles flush results.
+ * Only the UIApplication notification hooks, and the brief hops to start the upload and settings
+ * requests (which schedule their connections on the main run loop), touch the main thread.
  *
  * FBSessionAppEventsState is a chunk of state that hangs off of FBSession and holds event state
  * destined for that session.
@@ -368,12 +471,12 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
  * That FBSessionAppEventsState instance itself is used as the synchronization object for most logging
  * state.  For multi-thread accessed global state, we synchronize mostly on the FBAppEvents singleton object.
  *
- * The other singleton state is intended to be accessed from the main thread only (though certain ones, like
+ * The other singleton state is intended to be accessed from the flushQueue only (though certain ones, like
  * flushBehavior, are innocuous enough that it doesn't matter).
  *
- * Every method here that is expected to be called from the main thread should have
- * [FBAppEvents ensureOnMainThread] at its top.  This just does an FBConditionalLog if it's not the main thread,
- * but indicates a clear logic error in how this is being used when that occurs.
+ * Every method here that is expected to be called from the flushQueue or the main thread should have
+ * [FBAppEvents ensureOnFlushQueue] or [FBAppEvents ensureOnMainThread] at its top.  These just do an
+ * FBConditionalLog if called elsewhere, but indicate a clear logic error in how this is being used when that occurs.
  */
 
 
@@ -385,22 +488,44 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
         self.haveOutstandingPersistedData = YES;
         self.flushBehavior = FBAppEventsFlushBehaviorAuto;
         self.appSupportsAttributionStatus = AppSupportsAttributionUnknown;
+        self.journal = [FBAppEvents sharedJournal];
+        self.flushPolicy = [[[FBAppEventsFlushPolicy alloc] init] autorelease];
+        self.sessionsWithPendingEvents = [NSMutableSet set];
+        self.aggregatedEventNames = [NSMutableSet set];
+        self.eventSamplingRates = [NSMutableDictionary dictionary];
 
         self.appAuthSessions = [[[NSMutableDictionary alloc] init] autorelease];
         _anonymousSessions = [[NSMutableDictionary alloc] init];
 
-        // Timer fires unconditionally on a regular interval... handler decides whether to call flush.
-        self.flushTimer = [NSTimer scheduledTimerWithTimeInterval:FLUSH_PERIOD_IN_SECONDS
-                                                           target:self
-                                                         selector:@selector(flushTimerFired:)
-                                                         userInfo:nil
-                                                          repeats:YES];
-
-        self.attributionIDRecheckTimer = [NSTimer scheduledTimerWithTimeInterval:APP_SUPPORTS_ATTRIBUTION_ID_RECHECK_PERIOD
-                                                                          target:self
-                                                                        selector:@selector(attributionIDRecheckTimerFired:)
-                                                                        userInfo:nil
-                                                                         repeats:YES];
+        self.flushQueue = FBDispatchQueueCreateSerial("com.facebook.sdk.FBAppEvents", FBDispatchLaneUtility);
+        dispatch_queue_set_specific(self.flushQueue, kFlushQueueKey, kFlushQueueKey, NULL);
+
+        // Timer fires unconditionally... handler decides whether to call flush, and when to fire next.
+        // Both timers run off the SDK's shared maintenance scheduler, so they group with other
+        // periodic work and stop while the app is in the background.
+        FBMaintenanceScheduler *scheduler = [FBMaintenanceScheduler sharedScheduler];
+        self.flushTask = [scheduler addTaskWithInterval:self.flushPolicy.flushPeriod
+                                                 leeway:kFlushTimerLeeway
+                                                  queue:self.flushQueue
+                                                  block:^{
+                                                      [self flushTimerFired:nil];
+                                                  }];
+
+        self.attributionIDRecheckTask = [scheduler addTaskWithInterval:APP_SUPPORTS_ATTRIBUTION_ID_RECHECK_PERIOD
+                                                                leeway:kAttributionIDRecheckLeeway
+                                                                 queue:dispatch_get_main_queue()
+                                                                 block:^{
+                                                                     [self attributionIDRecheckTimerFired:nil];
+                                                                 }];
+
+        // The uploader lives on the main thread; this still gets in ahead of
+        // applicationDidBecomeActive recovering the journal
+        self.backgroundUploadSequenceNumbers = [NSMutableSet set];
+        if ([FBBackgroundUploader isAvailable]) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self reconcileBackgroundUploads];
+            });
+        }
 
         // Register an observer to watch for app moving out of the active state, which we use
         // to signal a flush.  Since this is static, we don't unregister anywhere.
@@ -410,6 +535,13 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
          name:UIApplicationWillResignActiveNotification
          object:NULL];
 
+        // Only an app that actually leaves the screen hands its events to a background upload
+        [[NSNotificationCenter defaultCenter]
+         addObserver:self
+         selector:@selector(applicationDidEnterBackground)
+         name:UIApplicationDidEnterBackgroundNotification
+         object:NULL];
+
         // Register for app termination, where we'll persist unsent events.
         [[NSNotificationCenter defaultCenter]
          addObserver:self
@@ -432,7 +564,7 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
 
 - (BOOL)validateIdentifier:(NSString *)identifier {
 
-    if (identifier == nil || identifier.length == 0 || identifier.length > MAX_IDENTIFIER_LENGTH || ![self regexValidateIdentifier:identifier]) {
+    if (!FBAppEventsIsValidIdentifierCharacters(identifier)) {
         [FBAppEvents logAndNotify:[NSString stringWithFormat:@"Invalid identifier: '%@'.  Must be between 1 and %d characters, and must be contain only alphanumerics, _, - or spaces, starting with alphanumeric or _.",
                                   identifier, MAX_IDENTIFIER_LENGTH]];
         return NO;
@@ -441,32 +573,6 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
     return YES;
 }
 
-- (BOOL)regexValidateIdentifier:(NSString *)identifier {
-
-    if (!self.eventNameRegex) {
-
-        // Event name must only have 0-9A-Za-z, underscore, hyphen, and space (but no hyphen or space in the first position).
-        NSString *regex = @"^[0-9a-zA-Z_]+[0-9a-zA-Z _-]*$";
-
-        NSError *regexError;
-        self.eventNameRegex = [NSRegularExpression regularExpressionWithPattern:regex
-                                                                        options:nil
-                                                                          error:&regexError];
-        self.validatedIdentifiers = [[[NSMutableSet alloc] init] autorelease];
-    }
-
-    if (![self.validatedIdentifiers containsObject:identifier]) {
-        NSUInteger numMatches = [self.eventNameRegex numberOfMatchesInString:identifier options:nil range:NSMakeRange(0, identifier.length)];
-        if (numMatches > 0) {
-            [self.validatedIdentifiers addObject:identifier];
-        } else {
-            return NO;
-        }
-    }
-
-    return YES;
-}
-
 - (void)instanceLogEvent:(NSString *)eventName
               valueToSum:(NSNumber *)valueToSum
               parameters:(NSDictionary *)parameters
@@ -508,6 +614,16 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
         return;
     }
 
+    NSNumber *samplingRate = nil;
+    BOOL aggregate = NO;
+    @synchronized (self) {
+        samplingRate = [[[self.eventSamplingRates objectForKey:eventName] retain] autorelease];
+        aggregate = [self.aggregatedEventNames containsObject:eventName];
+    }
+    if (samplingRate && (double)arc4random() / UINT32_MAX >= samplingRate.doubleValue) {
+        return;
+    }
+
     // Push the event onto the queue for later flushing.
 
     FBSession *sessionToLogTo = [self sessionToSendRequestTo:session];
@@ -525,6 +641,11 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
         [eventDictionary setObject:@"1" forKey:@"_implicitlyLogged"];
     }
 
+    if (samplingRate) {
+        // Lets what arrives be scaled back up
+        [eventDictionary setObject:samplingRate forKey:@"_samplingRate"];
+    }
+
     @synchronized (self) {
         if ([FBSettings appVersion]) {
             [eventDictionary setObject:[FBSettings appVersion] forKey:@"_appVersion"];
@@ -544,8 +665,14 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
         }
 
         FBSessionAppEventsState *appEventsState = sessionToLogTo.appEventsState;
+        [self prepareAppEventsState:appEventsState];
 
-        [appEventsState addEvent:eventDictionary isImplicit:isImplicitlyLogged];
+        if (aggregate) {
+            [appEventsState addAggregatedEvent:eventDictionary isImplicit:isImplicitlyLogged];
+        } else {
+            [appEventsState addEvent:eventDictionary isImplicit:isImplicitlyLogged];
+        }
+        [self.sessionsWithPendingEvents addObject:sessionToLogTo];
 
         if (!isImplicitlyLogged) {
             [FBLogger singleShotLogEntry:FBLoggingBehaviorAppEvents
@@ -563,7 +690,8 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
 
         if (self.flushBehavior != FBAppEventsFlushBehaviorExplicitOnly) {
 
-            if (appEventsState.getAccumulatedEventCount > NUM_LOG_EVENTS_TO_TRY_TO_FLUSH_AFTER) {
+            NSUInteger pendingEventCount = [appEventsState getAccumulatedEventCount] + [appEventsState getSpilledEventCount];
+            if ([self.flushPolicy shouldFlushWithPendingEventCount:pendingEventCount]) {
                 [self flush:FBAppEventsFlushReasonEventThreshold session:sessionToLogTo];
             } else if (eventsRetrievedFromPersistedData) {
                 [self flush:FBAppEventsFlushReasonPersistedEvents session:sessionToLogTo];
@@ -586,8 +714,8 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
     // Always flush asynchronously, even on main thread, for two reasons:
     // - most consistent code path for all threads.
     // - allow locks being held by caller to be released prior to actual flushing work being done.
-    dispatch_async(dispatch_get_main_queue(), ^{
-        [self flushOnMainQueue:flushReason session:session];
+    dispatch_async(self.flushQueue, ^{
+        [self flushOnFlushQueue:flushReason session:session];
     });
 }
 
@@ -595,33 +723,41 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
 
  Event sending procedure:
 
- - always executing on the main thread, and the flush is targeted at the appEventsState on the session
- - if request is currently in-flight, return
- - extend the 'inFlight' event list with the list of current events
- - clear out the current event list (since logEvents during this request will add to it)
- - send request
+ - always executing on the flushQueue, and the flush is targeted at the appEventsState on the session,
+   plus any other session logged to that still has events pending
+ - for each of those sessions:
+   + if its request is currently in-flight, skip it
+   + extend the 'inFlight' event list with the list of current events
+   + clear out the current event list (since logEvents during this request will add to it)
+ - send one request per session, all in a single batch
  - if request result is:
    + success: clear out the inFlight event list, invoke the delegate with success
    + server error: clear out the inFlight event list, log, and publish to NotificationCenter with error
-   + cannot connect: keep inFlight event list intact
+   + cannot connect: keep inFlight event list intact, and retry with exponential backoff and jitter,
+     holding off other automatic flushes meanwhile
 
  After N minutes, the process will be re-invoked if there are items in the inFlight list, or
  you haven't chosen ExplicitOnly flush.
 
- On app deactivation/backgrounding: persist the inFlight events.  No time to try to send.
- On app termination: Persist the inFlight events
- On app activation: Read back from persisted data and flush asap.
+ On app deactivation/backgrounding: sync the event journal.  No time to try to send.
+ On app termination: Sync the event journal.
+ On app activation: Read back events journaled by an earlier launch and flush asap.
 
  */
-- (void)flushOnMainQueue:(FBAppEventsFlushReason)flushReason
-                 session:(FBSession *)session {
+- (void)flushOnFlushQueue:(FBAppEventsFlushReason)flushReason
+                  session:(FBSession *)session {
 
-    [FBAppEvents ensureOnMainThread];
-    FBSessionAppEventsState *appEventsState = session.appEventsState;
+    [FBAppEvents ensureOnFlushQueue];
 
-    // If trying to flush a session already in flight, just ignore and continue to accum events
-    // until we try to flush again.
-    if (appEventsState.requestInFlight || self.appSupportsAttributionStatus == AppSupportsAttributionQueryInFlight) {
+    if (self.appSupportsAttributionStatus == AppSupportsAttributionQueryInFlight) {
+        return;
+    }
+
+    // Backing off after a failed upload; the retry takes everything pending with it.  An explicit
+    // flush still goes straight out.
+    if (self.uploadRetryPending &&
+        flushReason != FBAppEventsFlushReasonExplicit &&
+        flushReason != FBAppEventsFlushReasonRetry) {
         return;
     }
 
@@ -632,52 +768,222 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
         // If we haven't yet determined whether the app supports sending the attribution ID, we'll need
         // to make an initial request to determine this, and then call back in once we know.
         self.appSupportsAttributionStatus = AppSupportsAttributionQueryInFlight;
-        [FBUtility fetchAppSettings:appid
-                           callback:^(FBFetchedAppSettings *settings, NSError *error) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [FBUtility fetchAppSettings:appid
+                               callback:^(FBFetchedAppSettings *settings, NSError *error) {
+                                   dispatch_async(self.flushQueue, ^{
+                                       // Treat an error as if the app doesn't allow sending of attribution ID.
+                                       self.appSupportsAttributionStatus = settings.supportsAttribution && !error
+                                         ? AppSupportsAttributionTrue : AppSupportsAttributionFalse;
 
-                               [FBAppEvents ensureOnMainThread];
+                                       self.appSupportsImplicitLogging = settings.supportsImplicitSdkLogging;
 
-                               // Treat an error as if the app doesn't allow sending of attribution ID.
-                               self.appSupportsAttributionStatus = settings.supportsAttribution && !error
-                                 ? AppSupportsAttributionTrue : AppSupportsAttributionFalse;
+                                       self.haveFetchedAppSettings = YES;
 
-                               self.appSupportsImplicitLogging = settings.supportsImplicitSdkLogging;
+                                       // Kick off the original flush, now that we have the info we need.
+                                       [self flushOnFlushQueue:flushReason session:session];
+                                   });
+                               }
+            ];
+        });
 
-                               self.haveFetchedAppSettings = YES;
+        return;
 
-                               // Kick off the original flush, now that we have the info we need.
-                               [self flushOnMainQueue:flushReason session:session];
-                           }
-        ];
+    }
+
+    // Whatever any other session has pending rides along in the same batch, so a flush only wakes
+    // the radio once however many sessions have been logged to.
+    NSMutableArray *sessions = [NSMutableArray array];
+    if (session) {
+        [sessions addObject:session];
+    }
+    @synchronized (self) {
+        for (FBSession *pendingSession in self.sessionsWithPendingEvents) {
+            if (pendingSession != session) {
+                [sessions addObject:pendingSession];
+            }
+        }
+    }
+
+    NSMutableArray *uploads = [NSMutableArray array];
+    for (FBSession *sessionToFlush in sessions) {
+        NSDictionary *upload = [self prepareUploadForSession:sessionToFlush];
+        if (upload) {
+            [uploads addObject:upload];
+        }
+    }
 
+    if (!uploads.count) {
         return;
+    }
 
+    for (NSDictionary *upload in uploads) {
+        FBTraceBegin(FBTracePointAppEventsFlush, upload[@"session"]);
     }
 
-    NSString *jsonEncodedEvents;
-    NSUInteger eventCount, numSkipped;
-    @synchronized (appEventsState) {
+    // The attribution ID comes off a UIPasteboard, and the request's connection
+    // is scheduled on the current run loop, so those two bits go on the main thread.
+    dispatch_async(dispatch_get_main_queue(), ^{
+        FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+        connection.networkFeature = FBNetworkFeatureAppEvents;
+        connection.priority = FBRequestPriorityBackground;
+
+        if (flushReason == FBAppEventsFlushReasonBackgroundUpload) {
+            // Should the app be gone by the time this finishes, the next launch uses the
+            // sequence numbers to tell which journaled events are already sent
+            NSMutableArray *sequenceNumbers = [NSMutableArray array];
+            for (NSDictionary *upload in uploads) {
+                [sequenceNumbers addObjectsFromArray:upload[@"sequenceNumbers"]];
+            }
+            connection.backgroundUploadKind = FBBackgroundUploadKindAppEvents;
+            connection.backgroundUploadContext = @{kBackgroundUploadSequenceNumbersKey : sequenceNumbers};
+        }
 
-        [appEventsState.inFlightEvents addObjectsFromArray:appEventsState.accumulatedEvents];
-        [appEventsState.accumulatedEvents removeAllObjects];
-        eventCount = appEventsState.inFlightEvents.count;
+        for (NSDictionary *upload in uploads) {
+            [self addActivitiesRequestForUpload:upload flushReason:flushReason toConnection:connection];
+        }
 
-        if (!eventCount) {
-            return;
+        [connection start];
+    });
+}
+
+// Adds the activities post for an upload from prepareUploadForSession: to connection.
+- (void)addActivitiesRequestForUpload:(NSDictionary *)upload
+                          flushReason:(FBAppEventsFlushReason)flushReason
+                         toConnection:(FBRequestConnection *)connection {
+
+    [FBAppEvents ensureOnMainThread];
+
+    FBSession *uploadSession = upload[@"session"];
+    NSMutableDictionary *postParameters = upload[@"parameters"];
+    NSString *prettyPrintedJsonEvents = upload[@"prettyPrintedEvents"];
+
+    [self appendAttributionAndAdvertiserIDs:postParameters
+                                    session:uploadSession];
+
+    NSString *loggingEntry = nil;
+    if (prettyPrintedJsonEvents) {
+        // Remove this param -- just an encoding of the events which we pretty print later.
+        NSMutableDictionary *paramsForPrinting = [NSMutableDictionary dictionaryWithDictionary:postParameters];
+        [paramsForPrinting removeObjectForKey:@"custom_events_file"];
+
+        loggingEntry = [NSString stringWithFormat:@"FBAppEvents: Flushed @ %ld, %@ events due to '%@' - %@\nEvents: %@",
+                        [FBAppEvents unixTimeNow],
+                        upload[@"eventCount"],
+                        [FBAppEvents flushReasonToString:flushReason],
+                        paramsForPrinting,
+                        prettyPrintedJsonEvents];
+    }
+
+    FBRequest *request = [[[FBRequest alloc] initWithSession:uploadSession
+                                                   graphPath:[NSString stringWithFormat:@"%@/activities", uploadSession.appID]
+                                                  parameters:postParameters
+                                                  HTTPMethod:@"POST"] autorelease];
+    request.canCloseSessionOnError = NO;
+
+    [connection addRequest:request
+         completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+             dispatch_async(self.flushQueue, ^{
+                 [self handleActivitiesPostCompletion:error
+                                         loggingEntry:loggingEntry
+                                              session:uploadSession];
+             });
+         }];
+}
+
++ (void)addPiggybackRequestsToConnection:(FBRequestConnection *)connection
+                                forAppID:(NSString *)appID
+                            maximumCount:(NSUInteger)maximumCount {
+    // Apps that never log events shouldn't have the machinery started up for them
+    [g_singleton instanceAddPiggybackRequestsToConnection:connection forAppID:appID maximumCount:maximumCount];
+}
+
+- (void)instanceAddPiggybackRequestsToConnection:(FBRequestConnection *)connection
+                                        forAppID:(NSString *)appID
+                                    maximumCount:(NSUInteger)maximumCount {
+
+    [FBAppEvents ensureOnMainThread];
+
+    // Until the app settings are in, flushOnFlushQueue has to go first and find out about attribution
+    AppSupportsAttributionStatus attributionStatus = self.appSupportsAttributionStatus;
+    if (maximumCount == 0 ||
+        self.flushBehavior == FBAppEventsFlushBehaviorExplicitOnly ||
+        (attributionStatus != AppSupportsAttributionTrue && attributionStatus != AppSupportsAttributionFalse)) {
+        return;
+    }
+
+    // The batch has a single batch_app_id, so only sessions for the same app can ride along
+    NSMutableArray *sessions = [NSMutableArray array];
+    @synchronized (self) {
+        for (FBSession *pendingSession in self.sessionsWithPendingEvents) {
+            if ([pendingSession.appID isEqualToString:appID]) {
+                [sessions addObject:pendingSession];
+            }
         }
+    }
+    if (!sessions.count) {
+        return;
+    }
+
+    // Only moving events in flight happens here; the flush queue never waits on the main thread
+    NSMutableArray *uploads = [NSMutableArray array];
+    dispatch_sync(self.flushQueue, ^{
+        for (FBSession *session in sessions) {
+            if (uploads.count >= maximumCount) {
+                break;
+            }
+            NSDictionary *upload = [self prepareUploadForSession:session];
+            if (upload) {
+                FBTraceBegin(FBTracePointAppEventsFlush, session);
+                [uploads addObject:upload];
+            }
+        }
+    });
 
-        jsonEncodedEvents = [appEventsState jsonEncodeInFlightEvents:self.appSupportsImplicitLogging];
-        numSkipped = appEventsState.numSkippedEventsDueToFullBuffer;
+    for (NSDictionary *upload in uploads) {
+        [self addActivitiesRequestForUpload:upload flushReason:FBAppEventsFlushReasonPiggyback toConnection:connection];
+    }
+}
+
+// Moves a session's events in flight and builds the parameters for posting them, returning nil if it has
+// nothing to send or a post is already in flight for it.
+- (NSDictionary *)prepareUploadForSession:(FBSession *)session {
+
+    [FBAppEvents ensureOnFlushQueue];
+    FBSessionAppEventsState *appEventsState = session.appEventsState;
+
+    // If trying to flush a session already in flight, just ignore and continue to accum events
+    // until we try to flush again.
+    if (appEventsState.requestInFlight) {
+        return nil;
+    }
+
+    // Only the flush queue moves events into flight, so nothing changes them between these calls,
+    // while loggers on other threads keep accumulating without waiting on the encode.
+    [appEventsState closeAggregationWindow];
+    [appEventsState restoreSpilledEvents];
+    NSUInteger eventCount = [appEventsState moveAccumulatedEventsInFlight];
+    if (!eventCount) {
+        @synchronized (self) {
+            if (![appEventsState getAccumulatedEventCount] && ![appEventsState getSpilledEventCount]) {
+                [self.sessionsWithPendingEvents removeObject:session];
+            }
+        }
+        return nil;
     }
 
     // Move custom events field off the URL and into a POST field only by encoding into UTF8, which the server
     // will then handle as an uploaded file.  It also allows request compression to work on event data.
-    NSData *utf8EncodedEvents = [jsonEncodedEvents dataUsingEncoding:NSUTF8StringEncoding];
+    FBMetrics *metrics = [FBMetrics sharedMetrics];
+    FBMetricsAllocationSample allocationSample;
+    [metrics beginAllocationSample:&allocationSample];
+    NSData *utf8EncodedEvents = [appEventsState jsonDataForInFlightEvents:self.appSupportsImplicitLogging];
+    NSUInteger numSkipped = [appEventsState getNumSkippedEvents];
 
     if (!utf8EncodedEvents) {
         [FBLogger singleShotLogEntry:FBLoggingBehaviorAppEvents
                             logEntry:@"FBAppEvents: Flushing skipped - no events after removing implicitly logged ones.\n"];
-        return;
+        return nil;
     }
 
     NSMutableDictionary *postParameters =
@@ -691,42 +997,39 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
         postParameters[@"num_skipped_events"] = [NSString stringWithFormat:@"%lu", (unsigned long)numSkipped];
     }
 
-    [self appendAttributionAndAdvertiserIDs:postParameters
-                                              session:session];
-
-    NSString *loggingEntry = nil;
-    if ([[FBSettings loggingBehavior] containsObject:FBLoggingBehaviorAppEvents]) {
-
-        id decodedEvents = [FBUtility simpleJSONDecode:jsonEncodedEvents];
-        NSString *prettyPrintedJsonEvents = [FBUtility simpleJSONEncode:decodedEvents
-                                                                  error:nil
-                                                         writingOptions:NSJSONWritingPrettyPrinted];
-
-        // Remove this param -- just an encoding of the events which we pretty print later.
-        NSMutableDictionary *paramsForPrinting = [NSMutableDictionary dictionaryWithDictionary:postParameters];
-        [paramsForPrinting removeObjectForKey:@"custom_events_file"];
-
-        loggingEntry = [NSString stringWithFormat:@"FBAppEvents: Flushed @ %ld, %lu events due to '%@' - %@\nEvents: %@",
-                         [FBAppEvents unixTimeNow],
-                         (unsigned long)eventCount,
-                         [FBAppEvents flushReasonToString:flushReason],
-                         paramsForPrinting,
-                         prettyPrintedJsonEvents];
+    NSMutableArray *sequenceNumbers = [NSMutableArray arrayWithCapacity:eventCount];
+    for (NSDictionary *eventAndImplicitFlag in [appEventsState inFlightEvents]) {
+        NSNumber *sequenceNumber = [FBAppEventsJournal sequenceNumberOfEvent:eventAndImplicitFlag];
+        if (sequenceNumber) {
+            [sequenceNumbers addObject:sequenceNumber];
+        }
     }
 
-    FBRequest *request = [[[FBRequest alloc] initWithSession:session
-                                                   graphPath:[NSString stringWithFormat:@"%@/activities", appid]
-                                                  parameters:postParameters
-                                                  HTTPMethod:@"POST"] autorelease];
-    request.canCloseSessionOnError = NO;
-
-    [request startWithCompletionHandler:^(FBRequestConnection *connection, id result, NSError *error) {
-        [self handleActivitiesPostCompletion:error
-                                loggingEntry:loggingEntry
-                                     session:session];
-    }];
+    NSMutableDictionary *upload = [NSMutableDictionary dictionaryWithDictionary:
+                                   @{ @"session" : session,
+                                      @"parameters" : postParameters,
+                                      @"eventCount" : [NSNumber numberWithUnsignedInteger:eventCount],
+                                      @"sequenceNumbers" : sequenceNumbers,
+                                   }];
+
+    if (FBLoggerIsEnabled(FBLoggingBehaviorAppEvents)) {
+        // Only the pretty printed string is kept; the decoded events go right away
+        @autoreleasepool {
+            id decodedEvents = [FBUtility simpleJSONDecodeData:utf8EncodedEvents error:nil];
+            NSString *prettyPrintedJsonEvents = [FBUtility simpleJSONEncode:decodedEvents
+                                                                      error:nil
+                                                             writingOptions:NSJSONWritingPrettyPrinted];
+            if (prettyPrintedJsonEvents) {
+                upload[@"prettyPrintedEvents"] = prettyPrintedJsonEvents;
+            }
+            [metrics updateAllocationSample:&allocationSample];
+        }
+    }
+    [metrics endAllocationSample:&allocationSample metric:FBMetricAppEventsEncodingPeakBytes];
 
     appEventsState.requestInFlight = YES;
+
+    return upload;
 }
 
 - (void)appendAttributionAndAdvertiserIDs:(NSMutableDictionary *)postParameters
@@ -862,7 +1165,7 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
         FlushResultNoConnectivity
     } FlushResult;
 
-    [FBAppEvents ensureOnMainThread];
+    [FBAppEvents ensureOnFlushQueue];
 
     FlushResult flushResult = FlushResultSuccess;
     if (error) {
@@ -874,28 +1177,38 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
         flushResult = errorCode == 400 ? FlushResultServerError : FlushResultNoConnectivity;
     }
 
+    FBTraceEnd(FBTracePointAppEventsFlush, session);
+
     FBSessionAppEventsState *appEventsState = session.appEventsState;
     BOOL allEventsAreImplicit = YES;
-    @synchronized (appEventsState) {
-        if (flushResult != FlushResultNoConnectivity) {
-            for (NSDictionary *eventAndImplicitFlag in appEventsState.inFlightEvents) {
-                if (![eventAndImplicitFlag[kFBAppEventIsImplicit] boolValue]) {
-                    allEventsAreImplicit = NO;
-                    break;
-                }
-            }
+    if (flushResult != FlushResultNoConnectivity) {
+        allEventsAreImplicit = [appEventsState areAllInFlightEventsImplicit];
 
-            // Either success or a real server error.  Either way, no more in flight events.
-            [appEventsState clearInFlightAndStats];
-        }
-
-        appEventsState.requestInFlight = NO;
+        // Either success or a real server error.  Either way, no more in flight events.
+        [appEventsState clearInFlightAndStats];
     }
 
+    appEventsState.requestInFlight = NO;
+
     if (flushResult == FlushResultServerError) {
         [FBAppEvents logAndNotify:[error description] allowLogAsDeveloperError:!allEventsAreImplicit];
     }
 
+    if (flushResult == FlushResultNoConnectivity) {
+        if (self.flushBehavior != FBAppEventsFlushBehaviorExplicitOnly) {
+            [self scheduleUploadRetry:session];
+        }
+    } else {
+        self.uploadRetryCount = 0;
+    }
+
+    // Events that spilled to the journal during a burst go out right behind this batch
+    if (flushResult == FlushResultSuccess &&
+        [appEventsState getSpilledEventCount] > 0 &&
+        self.flushBehavior != FBAppEventsFlushBehaviorExplicitOnly) {
+        [self flush:FBAppEventsFlushReasonEventThreshold session:session];
+    }
+
     NSString *resultString = @"<unknown>";
     switch (flushResult) {
         case FlushResultSuccess:
@@ -916,17 +1229,62 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
 }
 
 
+// Every session in a batch fails together, so one pending retry covers them all.
+- (void)scheduleUploadRetry:(FBSession *)session {
+    [FBAppEvents ensureOnFlushQueue];
+    if (self.uploadRetryPending) {
+        return;
+    }
+
+    self.uploadRetryCount++;
+    NSTimeInterval backoff = MIN(kUploadRetryBaseDelay * pow(2, MIN(self.uploadRetryCount - 1, (NSUInteger)16)), kUploadRetryMaxDelay);
+    [self scheduleUploadRetry:session
+                        after:[FBUtility randomTimeInterval:backoff / 2 withMaxValue:backoff]];
+}
+
+- (void)scheduleUploadRetry:(FBSession *)session
+                      after:(NSTimeInterval)delay {
+    self.uploadRetryPending = YES;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), self.flushQueue, ^{
+        if (![self.flushPolicy isNetworkReachable]) {
+            // No point spending an attempt; look again within a flush period, without backing off
+            // further, so the upload goes soon after the network comes back.
+            NSTimeInterval recheck = MIN(kUploadRetryBaseDelay * pow(2, MIN(self.uploadRetryCount, (NSUInteger)16)),
+                                         self.flushPolicy.flushPeriod);
+            [self scheduleUploadRetry:session after:recheck];
+            return;
+        }
+
+        self.uploadRetryPending = NO;
+        [self flushOnFlushQueue:FBAppEventsFlushReasonRetry session:session];
+    });
+}
+
+- (void)scheduleFlushTimer:(NSTimeInterval)interval {
+    [[FBMaintenanceScheduler sharedScheduler] setInterval:interval forTask:self.flushTask];
+}
+
 - (void)flushTimerFired:(id)arg {
-    [FBAppEvents ensureOnMainThread];
+    [FBAppEvents ensureOnFlushQueue];
 
     @synchronized (self) {
-        if (self.flushBehavior != FBAppEventsFlushBehaviorExplicitOnly) {
-            if (self.lastSessionLoggedTo.appEventsState.inFlightEvents.count > 0 ||
-                self.lastSessionLoggedTo.appEventsState.accumulatedEvents.count > 0) {
+        // Includes sessions left behind by a session change whose flush didn't get through
+        NSUInteger pendingEventCount = 0;
+        for (FBSession *session in self.sessionsWithPendingEvents) {
+            FBSessionAppEventsState *appEventsState = session.appEventsState;
+            pendingEventCount += [appEventsState getInFlightEventCount] +
+                [appEventsState getAccumulatedEventCount] +
+                [appEventsState getSpilledEventCount];
+        }
 
-                [self flush:FBAppEventsFlushReasonTimer session:self.lastSessionLoggedTo];
-            }
+        if (self.flushBehavior != FBAppEventsFlushBehaviorExplicitOnly &&
+            pendingEventCount > 0 &&
+            [self.flushPolicy isNetworkReachable]) {
+
+            [self flush:FBAppEventsFlushReasonTimer session:self.lastSessionLoggedTo];
         }
+
+        [self scheduleFlushTimer:[self.flushPolicy flushIntervalWithPendingEventCount:pendingEventCount]];
     }
 }
 
@@ -946,13 +1304,17 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
 
     // Can only actively update state and log when we have a session, otherwise we
     // set a BOOL to tell us to update as soon as we can afterwards.
-    if (self.lastSessionLoggedTo) {
+    FBSession *session = self.lastSessionLoggedTo;
+    if (session) {
 
-        BOOL eventsRetrieved = [self updateAppEventsStateWithPersistedData:self.lastSessionLoggedTo];
+        // Reading back the journal is file work, so keep it off the main thread
+        dispatch_async(self.flushQueue, ^{
+            BOOL eventsRetrieved = [self updateAppEventsStateWithPersistedData:session];
 
-        if (eventsRetrieved && self.flushBehavior != FBAppEventsFlushBehaviorExplicitOnly) {
-            [self flush:FBAppEventsFlushReasonPersistedEvents session:self.lastSessionLoggedTo];
-        }
+            if (eventsRetrieved && self.flushBehavior != FBAppEventsFlushBehaviorExplicitOnly) {
+                [self flushOnFlushQueue:FBAppEventsFlushReasonPersistedEvents session:session];
+            }
+        });
 
     } else {
 
@@ -961,27 +1323,54 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
     }
 }
 
+// Hooks a session's event state up to the shared journal and the current buffer limits.
+- (void)prepareAppEventsState:(FBSessionAppEventsState *)appEventsState {
+    if (!appEventsState.journal) {
+        appEventsState.journal = self.journal;
+    }
+    FBAppEventsFlushPolicy *flushPolicy = self.flushPolicy;
+    appEventsState.maxBufferedEventCount = flushPolicy.maxBufferedEventCount;
+    appEventsState.maxSpilledEventCount = flushPolicy.maxSpilledEventCount;
+}
+
 // Read back previously persisted events, if any, into specified session, returning whether any events were retrieved.
 - (BOOL)updateAppEventsStateWithPersistedData:(FBSession *)session {
 
-    BOOL eventsRetrieved = NO;
+    FBSessionAppEventsState *appEventsState = session.appEventsState;
+    [self prepareAppEventsState:appEventsState];
+
+    // Journaled events only need recovering once per launch; after that
+    // they're all still in memory.
+    NSUInteger numSkipped = 0;
+    NSMutableArray *retrievedObjects = [NSMutableArray arrayWithArray:[self.journal takeRecoveredEvents:&numSkipped]];
+    self.haveRecoveredJournalEvents = YES;
+
+    // Events still out with a background upload from an earlier run wait for its result
+    NSSet *backgroundUploadSequenceNumbers = self.backgroundUploadSequenceNumbers;
+    if (backgroundUploadSequenceNumbers.count) {
+        [retrievedObjects filterUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(NSDictionary *event, NSDictionary *bindings) {
+            return ![backgroundUploadSequenceNumbers containsObject:[FBAppEventsJournal sequenceNumberOfEvent:event]];
+        }]];
+    }
+
     NSDictionary *persistedData = [FBAppEvents retrievePersistedAppEventData];
     if (persistedData) {
-
+        // Move anything left in the old format into the journal
         [FBAppEvents clearPersistedAppEventData];
+        numSkipped += [[persistedData objectForKey:FBAppEventsPersistKeyNumSkipped] unsignedIntegerValue];
+        for (NSDictionary *eventAndImplicitFlag in [persistedData objectForKey:FBAppEventsPersistKeyEvents]) {
+            [retrievedObjects addObject:[self.journal appendEvent:eventAndImplicitFlag]];
+        }
+    }
 
-        FBSessionAppEventsState *appEventsState = session.appEventsState;
-        @synchronized (appEventsState) {
-            appEventsState.numSkippedEventsDueToFullBuffer += [[persistedData objectForKey:FBAppEventsPersistKeyNumSkipped] unsignedIntegerValue];
-            NSArray *retrievedObjects = [persistedData objectForKey:FBAppEventsPersistKeyEvents];
-            if (retrievedObjects.count) {
-                [appEventsState.inFlightEvents addObjectsFromArray:retrievedObjects];
-                eventsRetrieved = YES;
-            }
+    [appEventsState addInFlightEvents:retrievedObjects numSkipped:numSkipped];
+    if (retrievedObjects.count) {
+        @synchronized (self) {
+            [self.sessionsWithPendingEvents addObject:session];
         }
     }
 
-    return eventsRetrieved;
+    return retrievedObjects.count > 0;
 }
 
 - (void)applicationMovingFromActiveState {
@@ -990,6 +1379,68 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
     [self persistDataIfNotInFlight];
 }
 
+- (void)applicationDidEnterBackground {
+    // With background uploads the system can send them while the app is suspended
+    if ([FBBackgroundUploader isAvailable] &&
+        self.flushBehavior != FBAppEventsFlushBehaviorExplicitOnly) {
+        [self instanceFlush:FBAppEventsFlushReasonBackgroundUpload];
+    }
+}
+
++ (void)reconcileBackgroundUploads {
+    [[FBAppEvents singleton] reconcileBackgroundUploads];
+}
+
+// Finds out which events earlier runs handed to background uploads, and settles
+// them as the uploads' results come in: sent events are acknowledged, and the
+// rest go out again with the next flush.
+- (void)reconcileBackgroundUploads {
+    [FBAppEvents ensureOnMainThread];
+    if (self.reconcilingBackgroundUploads) {
+        return;
+    }
+    self.reconcilingBackgroundUploads = YES;
+
+    FBBackgroundUploader *uploader = [FBBackgroundUploader sharedUploader];
+    NSMutableSet *pending = [NSMutableSet set];
+    for (NSDictionary *context in [uploader pendingContextsForKind:FBBackgroundUploadKindAppEvents]) {
+        [pending addObjectsFromArray:context[kBackgroundUploadSequenceNumbersKey]];
+    }
+    dispatch_async(self.flushQueue, ^{
+        [self.backgroundUploadSequenceNumbers unionSet:pending];
+    });
+
+    [uploader setReconciler:^(NSDictionary *context, NSURLResponse *response, NSData *data, NSError *error) {
+        NSArray *sequenceNumbers = context[kBackgroundUploadSequenceNumbersKey];
+        // Like handleActivitiesPostCompletion, a 400 means the events were bad, and are dropped
+        NSInteger statusCode = [[[error userInfo] objectForKey:FBErrorHTTPStatusCodeKey] integerValue];
+        BOOL settled = !error || statusCode == 400;
+
+        dispatch_async(self.flushQueue, ^{
+            [self.backgroundUploadSequenceNumbers minusSet:[NSSet setWithArray:sequenceNumbers]];
+            if (settled) {
+                [self.journal acknowledgeEventsWithSequenceNumbers:sequenceNumbers];
+                return;
+            }
+
+            // Not recovered yet, they will be along with everything else.  Otherwise they're
+            // brought back from the journal, or failing a session to send them with, recovered
+            // again at the next launch.
+            FBSession *session = self.lastSessionLoggedTo;
+            if (!self.haveRecoveredJournalEvents || !session) {
+                return;
+            }
+            [session.appEventsState addSpilledSequenceNumbers:sequenceNumbers];
+            @synchronized (self) {
+                [self.sessionsWithPendingEvents addObject:session];
+            }
+            if (self.flushBehavior != FBAppEventsFlushBehaviorExplicitOnly) {
+                [self flushOnFlushQueue:FBAppEventsFlushReasonPersistedEvents session:session];
+            }
+        });
+    } forKind:FBBackgroundUploadKindAppEvents];
+}
+
 - (void)applicationTerminating {
     // When terminating, we don't have time to wait for the result of a flush, so
     // just persist events to storage, and we'll process them at the next activation.
@@ -999,14 +1450,9 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
 - (void)persistDataIfNotInFlight {
     [FBAppEvents ensureOnMainThread];
 
-    FBSessionAppEventsState *appEventsState = self.lastSessionLoggedTo.appEventsState;
-    if (appEventsState.requestInFlight) {
-        // In flight request may or may not succeed, so there's no right thing to do here.  Err by just not doing anything on termination;
-        return;
-    }
-
-    // Persist right away if needed (rather than trying one last sync) since we're about to be booted out.
-    [FBAppEvents persistAppEventsData:appEventsState];
+    // Events, in flight or not, are journaled as they're logged.  Make sure
+    // the journal is on disk right away, since we're about to be booted out.
+    [FBAppEvents persistAppEventsData:self.lastSessionLoggedTo.appEventsState];
 }
 
 + (void)logAndNotify:(NSString *)msg allowLogAsDeveloperError:(BOOL *)allowLogAsDeveloperError {
@@ -1021,7 +1467,7 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
 
     NSString *behaviorToLog = FBLoggingBehaviorAppEvents;
     if (allowLogAsDeveloperError) {
-        if ([[FBSettings loggingBehavior] containsObject:FBLoggingBehaviorDeveloperErrors]) {
+        if (FBLoggerIsEnabled(FBLoggingBehaviorDeveloperErrors)) {
             // Rather than log twice, prefer 'DeveloperErrors' if it's set over AppEvents.
             behaviorToLog = FBLoggingBehaviorDeveloperErrors;
         }
@@ -1042,48 +1488,23 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
 + (void)persistAppEventsData:(FBSessionAppEventsState *)appEventsState {
 
     [FBAppEvents ensureOnMainThread];
-    NSString *content;
-
-    // We just persist from the last session being logged to.  When we switch sessions, we flush out
-    // the one being moved away from.  So, modulo in-flight sessions, the only one with real data will
-    // be the last one.
-
-    @synchronized (appEventsState) {
-        [appEventsState.inFlightEvents addObjectsFromArray:appEventsState.accumulatedEvents];
-        [appEventsState.accumulatedEvents removeAllObjects];
-
-        [FBLogger singleShotLogEntry:FBLoggingBehaviorAppEvents
-                        formatString:@"FBAppEvents Persist: Writing %lu events", (unsigned long)appEventsState.inFlightEvents.count];
-
-        if (!appEventsState.inFlightEvents.count) {
-            return;
-        }
 
-        NSDictionary *appEventData = @{
-            FBAppEventsPersistKeyNumSkipped   : [NSNumber numberWithUnsignedInteger:appEventsState.numSkippedEventsDueToFullBuffer],
-            FBAppEventsPersistKeyEvents       : appEventsState.inFlightEvents,
-        };
-
-        content = [FBUtility simpleJSONEncode:appEventData];
-
-        [appEventsState clearInFlightAndStats];
-    }
-
-    //save content to the documents directory
-    [content writeToFile:[FBAppEvents persistenceFilePath]
-              atomically:YES
-                encoding:NSStringEncodingConversionAllowLossy
-                   error:nil];
+    // We just persist from the last session being logged to.  Every event was appended to the journal
+    // when it was logged, and is still there until a flush clears it, so all that's left is syncing,
+    // once any merged events have been written out too.
+    [appEventsState closeAggregationWindow];
+    [FBLogger singleShotLogEntry:FBLoggingBehaviorAppEvents
+                    formatString:@"FBAppEvents Persist: Syncing %lu events",
+     (unsigned long)([appEventsState getInFlightEventCount] + [appEventsState getAccumulatedEventCount])];
 
+    [appEventsState.journal synchronize];
 }
 
 + (NSDictionary *)retrievePersistedAppEventData {
 
-    NSString *content = [[NSString alloc] initWithContentsOfFile:[FBAppEvents persistenceFilePath]
-                                                    usedEncoding:nil
-                                                           error:nil];
-    NSDictionary *results = [FBUtility simpleJSONDecode:content];
-    [content release];
+    // NSJSONSerialization detects the encoding itself, as the string read did
+    NSData *content = [NSData dataWithContentsOfFile:[FBAppEvents persistenceFilePath]];
+    NSDictionary *results = [FBUtility simpleJSONDecodeData:content error:nil];
 
     [FBLogger singleShotLogEntry:FBLoggingBehaviorAppEvents
                     formatString:@"FBAppEvents Persist: Read %lu events",
@@ -1104,10 +1525,34 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
     return [docDirectory stringByAppendingPathComponent:FBAppEventsPersistedEventsFilename];
 }
 
++ (FBAppEventsJournal *)sharedJournal {
+    static dispatch_once_t onceToken;
+    static FBAppEventsJournal *journal = nil;
+
+    dispatch_once(&onceToken, ^{
+        journal = [[FBAppEventsJournal alloc] initWithPath:[FBAppEvents journalFilePath]];
+    });
+    return journal;
+}
+
++ (void)prewarm {
+    [FBAppEvents sharedJournal];
+}
+
++ (NSString *)journalFilePath {
+    NSArray *paths = NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES);
+    NSString *docDirectory = [paths objectAtIndex:0];
+    return [docDirectory stringByAppendingPathComponent:FBAppEventsJournalFilename];
+}
+
 + (void)ensureOnMainThread {
     FBConditionalLog([NSThread isMainThread], FBLoggingBehaviorInformational, @"*** This method expected to be called on the main thread.");
 }
 
++ (void)ensureOnFlushQueue {
+    FBConditionalLog(dispatch_get_specific(kFlushQueueKey) != NULL, FBLoggingBehaviorInformational, @"*** This method expected to be called on the FBAppEvents flush queue.");
+}
+
 #pragma mark - Custom Audience token stuff
 
 // This code lives here in FBAppEvents because it shares many of the runtime characteristics of the FBAppEvents logging,
@@ -1192,6 +1637,18 @@ const int MAX_IDENTIFIER_LENGTH                      = 40;
         case FBAppEventsFlushReasonEagerlyFlushingEvent:
             result = @"EagerlyFlushingEvent";
             break;
+
+        case FBAppEventsFlushReasonRetry:
+            result = @"Retry";
+            break;
+
+        case FBAppEventsFlushReasonPiggyback:
+            result = @"Piggyback";
+            break;
+
+        case FBAppEventsFlushReasonBackgroundUpload:
+            result = @"BackgroundUpload";
+            break;
     }
 
     return result;
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+#import <SystemConfiguration/SystemConfiguration.h>
+#import <UIKit/UIKit.h>
+
+// Decides when FBAppEvents flushes and how much it buffers.  The defaults
+// match the fixed limits the SDK has always used; on top of them, flushing is
+// held back while the network is unreachable, slowed down on a low battery,
+// and sped up while a backlog is building.
+//
+// Subclass and override the shouldFlush/flushInterval methods to plug in a
+// different strategy.  Those are called on the App Events flush queue.
+@interface FBAppEventsFlushPolicy : NSObject
+{
+@private
+    SCNetworkReachabilityRef _reachability;
+    UIDeviceBatteryState _batteryState;
+    float _batteryLevel;
+}
+
+// Logged events to wait for before flushing.  Defaults to 100.
+@property (atomic, assign) NSUInteger eventCountThreshold;
+
+// Time between timer driven flushes.  Defaults to 60 seconds.
+@property (atomic, assign) NSTimeInterval flushPeriod;
+
+// Events held in memory before further ones spill to the journal.  Defaults to 1000.
+@property (atomic, assign) NSUInteger maxBufferedEventCount;
+
+// Events held in the journal beyond the in memory buffer before further ones
+// are skipped.  Defaults to 10000; 0 drops events as soon as memory is full.
+@property (atomic, assign) NSUInteger maxSpilledEventCount;
+
+// Whether a just-logged event should trigger a flush, given the events
+// waiting to go out (in memory plus spilled)
+- (BOOL)shouldFlushWithPendingEventCount:(NSUInteger)pendingEventCount;
+
+// Delay until the flush timer should next fire
+- (NSTimeInterval)flushIntervalWithPendingEventCount:(NSUInteger)pendingEventCount;
+
+// Whether a flush has any chance of reaching the server right now
+- (BOOL)isNetworkReachable;
+
+// Only known when the app has turned on battery monitoring
+- (BOOL)isBatteryLow;
+
+@end
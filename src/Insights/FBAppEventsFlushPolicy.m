@@ -0,0 +1,140 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "FBAppEventsFlushPolicy.h"
+
+#import <netinet/in.h>
+
+#import "FBDynamicFrameworkLoader.h"
+
+static const NSUInteger kDefaultEventCountThreshold = 100;
+static const NSTimeInterval kDefaultFlushPeriod = 60;
+static const NSUInteger kDefaultMaxBufferedEventCount = 1000;
+static const NSUInteger kDefaultMaxSpilledEventCount = 10000;
+
+// Below this, unless charging, flushes are batched up more
+static const float kLowBatteryLevel = 0.2;
+static const NSUInteger kLowBatteryMultiplier = 4;
+
+// Never flush on a backlog more often than this
+static const NSTimeInterval kMinimumFlushInterval = 5;
+
+@interface FBAppEventsFlushPolicy ()
+
+- (void)batteryDidChange:(NSNotification *)notification;
+
+@end
+
+@implementation FBAppEventsFlushPolicy
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _eventCountThreshold = kDefaultEventCountThreshold;
+        _flushPeriod = kDefaultFlushPeriod;
+        _maxBufferedEventCount = kDefaultMaxBufferedEventCount;
+        _maxSpilledEventCount = kDefaultMaxSpilledEventCount;
+
+        // The zero address stands for the internet at large, and unlike a
+        // host name never needs a lookup before flags are known
+        struct sockaddr_in zeroAddress;
+        memset(&zeroAddress, 0, sizeof(zeroAddress));
+        zeroAddress.sin_len = sizeof(zeroAddress);
+        zeroAddress.sin_family = AF_INET;
+        _reachability = fbdfl_SCNetworkReachabilityCreateWithAddress(kCFAllocatorDefault, (const struct sockaddr *)&zeroAddress);
+
+        // Battery details only update while the app has monitoring on; the
+        // SDK doesn't turn it on itself
+        _batteryState = UIDeviceBatteryStateUnknown;
+        _batteryLevel = -1;
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(batteryDidChange:)
+                                                     name:UIDeviceBatteryStateDidChangeNotification
+                                                   object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(batteryDidChange:)
+                                                     name:UIDeviceBatteryLevelDidChangeNotification
+                                                   object:nil];
+        if ([NSThread isMainThread]) {
+            [self batteryDidChange:nil];
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    if (_reachability) {
+        CFRelease(_reachability);
+    }
+    [super dealloc];
+}
+
+#pragma mark - Policy
+
+- (BOOL)shouldFlushWithPendingEventCount:(NSUInteger)pendingEventCount {
+    if (![self isNetworkReachable]) {
+        // The events wait in memory and the journal until a flush can get through
+        return NO;
+    }
+
+    NSUInteger threshold = self.eventCountThreshold;
+    if ([self isBatteryLow] && pendingEventCount < self.maxBufferedEventCount / 2) {
+        threshold *= kLowBatteryMultiplier;
+    }
+    return pendingEventCount > threshold;
+}
+
+- (NSTimeInterval)flushIntervalWithPendingEventCount:(NSUInteger)pendingEventCount {
+    NSTimeInterval interval = self.flushPeriod;
+    if (pendingEventCount >= self.maxBufferedEventCount / 2) {
+        // Drain a backlog before it has to spill
+        interval = MAX(interval / kLowBatteryMultiplier, kMinimumFlushInterval);
+    } else if ([self isBatteryLow]) {
+        interval *= kLowBatteryMultiplier;
+    }
+    return interval;
+}
+
+- (BOOL)isNetworkReachable {
+    @synchronized (self) {
+        SCNetworkReachabilityFlags flags = 0;
+        if (!_reachability || !fbdfl_SCNetworkReachabilityGetFlags(_reachability, &flags)) {
+            // Can't tell, so let the flush find out
+            return YES;
+        }
+        return (flags & kSCNetworkReachabilityFlagsReachable) != 0;
+    }
+}
+
+- (BOOL)isBatteryLow {
+    @synchronized (self) {
+        return _batteryState == UIDeviceBatteryStateUnplugged &&
+            _batteryLevel >= 0 &&
+            _batteryLevel < kLowBatteryLevel;
+    }
+}
+
+#pragma mark - Private
+
+- (void)batteryDidChange:(NSNotification *)notification {
+    UIDevice *device = [UIDevice currentDevice];
+    @synchronized (self) {
+        _batteryState = device.batteryState;
+        _batteryLevel = device.batteryLevel;
+    }
+}
+
+@end
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+// Append-only, on-disk record of the App Events that haven't been accepted by
+// the server yet, so that a crash or kill loses nothing that was logged.
+//
+// The file starts with a small header holding the offset of the first
+// unacknowledged record, followed by length-prefixed JSON records.  Logging
+// an event appends one record.  Acknowledging the oldest events just moves the
+// header's offset forward, and the file is truncated back to the header once
+// nothing is left unacknowledged.  A record torn by a crash mid-write is
+// dropped the next time the journal is opened.
+//
+// All methods are thread-safe.
+@interface FBAppEventsJournal : NSObject
+{
+@private
+    NSString *_path;
+    int _fd;
+    unsigned long long _checkpointOffset;
+    unsigned long long _endOffset;
+    uint32_t _numSkipped;
+    uint64_t _nextSequenceNumber;
+    // Sequence numbers of the unacknowledged events, oldest first, and the
+    // file offset just past each one
+    NSMutableArray *_liveSequenceNumbers;
+    NSMutableArray *_liveEndOffsets;
+    NSMutableSet *_acknowledgedSequenceNumbers;
+    // Events left unacknowledged by an earlier run of the app
+    NSMutableArray *_recoveredEvents;
+    uint32_t _recoveredNumSkipped;
+}
+
+- (instancetype)initWithPath:(NSString *)path;
+
+// Records the event, returning a copy of it tagged with its sequence number,
+// which is what later needs to be acknowledged.  The "event" member may already
+// be encoded JSON data; in what's handed back, and in anything read back from
+// disk, it always is.  Returns nil if the event can't be encoded.
+- (NSDictionary *)appendEvent:(NSDictionary *)eventAndImplicitFlag;
+
+// Records an event that doesn't fit in memory, returning the sequence number
+// to read it back with, or nil if it couldn't be written
+- (NSNumber *)spillEvent:(NSDictionary *)eventAndImplicitFlag;
+
+// Reads back spilled events, tagged as appendEvent: would have returned them.
+// Sequence numbers must be in the order they were handed out.
+- (NSArray *)readEventsWithSequenceNumbers:(NSArray *)sequenceNumbers;
+
+// Counts an event that was dropped because the buffer was full
+- (void)recordSkippedEvent;
+
+// Hands back, once, the events and skipped count an earlier run of the app
+// left behind
+- (NSArray *)takeRecoveredEvents:(NSUInteger *)numSkipped;
+
+// Forgets events the server has accepted (or permanently rejected), along
+// with the skipped count that went out with them
+- (void)acknowledgeEvents:(NSArray *)eventsAndImplicitFlags;
+// The same, for events known only by sequence number, such as ones an earlier
+// run sent; any not yet taken as recovered events no longer will be
+- (void)acknowledgeEventsWithSequenceNumbers:(NSArray *)sequenceNumbers;
+
+// The sequence number an event from appendEvent: or the journal is tagged with
++ (NSNumber *)sequenceNumberOfEvent:(NSDictionary *)eventAndImplicitFlag;
+
+// Forces the journal to stable storage
+- (void)synchronize;
+
+@end
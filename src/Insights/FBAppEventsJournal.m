@@ -0,0 +1,466 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBAppEventsJournal.h"
+
+#import <fcntl.h>
+#import <libkern/OSByteOrder.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#import "FBLogger.h"
+#import "FBUtility.h"
+
+static const uint32_t kJournalMagic = 0x314a4246; // "FBJ1"
+
+// magic, skipped event count, checkpoint offset
+static const unsigned long long kHeaderLength = 4 + 4 + 8;
+
+// Once this much of the file is acknowledged records, copy the rest down
+static const unsigned long long kCompactionThreshold = 64 * 1024;
+
+static NSString *const kRecordSequenceNumberKey = @"journalSequenceNumber";
+static NSString *const kRecordAcknowledgedKey = @"journalAcknowledged";
+static NSString *const kRecordEventKey = @"event";
+
+// Events are held as their already encoded JSON, which is spliced into the
+// record as is rather than being parsed and encoded again
+static NSData *FBAppEventsJournalEncodeRecord(NSDictionary *record) {
+    NSData *event = [record objectForKey:kRecordEventKey];
+    if (![event isKindOfClass:[NSData class]]) {
+        return [FBUtility simpleJSONEncodeToData:record error:nil];
+    }
+
+    NSMutableDictionary *rest = [[record mutableCopy] autorelease];
+    [rest removeObjectForKey:kRecordEventKey];
+    NSData *restJSON = [FBUtility simpleJSONEncodeToData:rest error:nil];
+    if (!restJSON) {
+        return nil;
+    }
+
+    static const char kEventMember[] = "\"event\":";
+    NSMutableData *json = [NSMutableData dataWithCapacity:restJSON.length + sizeof(kEventMember) + event.length + 1];
+    [json appendBytes:restJSON.bytes length:restJSON.length - 1];
+    if (rest.count) {
+        [json appendBytes:"," length:1];
+    }
+    [json appendBytes:kEventMember length:sizeof(kEventMember) - 1];
+    [json appendData:event];
+    [json appendBytes:"}" length:1];
+    return json;
+}
+
+// Gives a record read back from disk the same shape appendEvent: hands out
+static NSDictionary *FBAppEventsJournalEventFromRecord(NSDictionary *record) {
+    id event = [record objectForKey:kRecordEventKey];
+    if ([event isKindOfClass:[NSData class]]) {
+        return record;
+    }
+    NSData *eventJSON = [FBUtility simpleJSONEncodeToData:event error:nil];
+    if (!eventJSON) {
+        return nil;
+    }
+    NSMutableDictionary *normalized = [[record mutableCopy] autorelease];
+    [normalized setObject:eventJSON forKey:kRecordEventKey];
+    return normalized;
+}
+
+@interface FBAppEventsJournal ()
+
+- (void)open;
+- (void)reset;
+- (void)loadRecordsFromData:(NSData *)data;
+- (BOOL)writeHeader;
+- (BOOL)appendRecord:(NSDictionary *)record;
+- (void)compact;
+
+@end
+
+@implementation FBAppEventsJournal
+
+#pragma mark - Lifecycle
+
+- (instancetype)initWithPath:(NSString *)path {
+    if ((self = [super init])) {
+        _path = [path copy];
+        _fd = -1;
+        _liveSequenceNumbers = [[NSMutableArray alloc] init];
+        _liveEndOffsets = [[NSMutableArray alloc] init];
+        _acknowledgedSequenceNumbers = [[NSMutableSet alloc] init];
+        _recoveredEvents = [[NSMutableArray alloc] init];
+        [self open];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_fd >= 0) {
+        close(_fd);
+    }
+    [_path release];
+    [_liveSequenceNumbers release];
+    [_liveEndOffsets release];
+    [_acknowledgedSequenceNumbers release];
+    [_recoveredEvents release];
+    [super dealloc];
+}
+
+#pragma mark - Public
+
+- (NSDictionary *)appendEvent:(NSDictionary *)eventAndImplicitFlag {
+    @synchronized (self) {
+        NSNumber *sequenceNumber = [NSNumber numberWithUnsignedLongLong:_nextSequenceNumber++];
+        NSMutableDictionary *record = [[FBAppEventsJournalEventFromRecord(eventAndImplicitFlag) mutableCopy] autorelease];
+        if (!record) {
+            return nil;
+        }
+        [record setObject:sequenceNumber forKey:kRecordSequenceNumberKey];
+
+        // Even if the write fails the event still goes out from memory; it
+        // just won't survive a crash
+        if ([self appendRecord:record]) {
+            [_liveSequenceNumbers addObject:sequenceNumber];
+            [_liveEndOffsets addObject:[NSNumber numberWithUnsignedLongLong:_endOffset]];
+        }
+        return record;
+    }
+}
+
+- (NSNumber *)spillEvent:(NSDictionary *)eventAndImplicitFlag {
+    @synchronized (self) {
+        NSDictionary *record = [self appendEvent:eventAndImplicitFlag];
+        NSNumber *sequenceNumber = [record objectForKey:kRecordSequenceNumberKey];
+        return [sequenceNumber isEqual:[_liveSequenceNumbers lastObject]] ? sequenceNumber : nil;
+    }
+}
+
+- (NSArray *)readEventsWithSequenceNumbers:(NSArray *)sequenceNumbers {
+    @synchronized (self) {
+        NSMutableArray *events = [NSMutableArray arrayWithCapacity:sequenceNumbers.count];
+        if (_fd < 0 || !sequenceNumbers.count) {
+            return events;
+        }
+
+        // Live records are in sequence order, so one read covers the whole span
+        NSRange liveRange = NSMakeRange(0, _liveSequenceNumbers.count);
+        NSUInteger first = [_liveSequenceNumbers indexOfObject:[sequenceNumbers objectAtIndex:0]
+                                                 inSortedRange:liveRange
+                                                       options:NSBinarySearchingFirstEqual
+                                               usingComparator:^(id a, id b) { return [a compare:b]; }];
+        NSUInteger last = [_liveSequenceNumbers indexOfObject:[sequenceNumbers lastObject]
+                                                inSortedRange:liveRange
+                                                      options:NSBinarySearchingFirstEqual
+                                              usingComparator:^(id a, id b) { return [a compare:b]; }];
+        if (first == NSNotFound || last == NSNotFound || last < first) {
+            return events;
+        }
+
+        unsigned long long start = first ? [[_liveEndOffsets objectAtIndex:first - 1] unsignedLongLongValue] : _checkpointOffset;
+        unsigned long long end = [[_liveEndOffsets objectAtIndex:last] unsignedLongLongValue];
+        NSUInteger length = (NSUInteger)(end - start);
+        NSMutableData *data = [NSMutableData dataWithLength:length];
+        if (pread(_fd, data.mutableBytes, length, (off_t)start) != (ssize_t)length) {
+            return events;
+        }
+
+        NSSet *wanted = [NSSet setWithArray:sequenceNumbers];
+        const uint8_t *bytes = data.bytes;
+        NSUInteger offset = 0;
+        while (length - offset >= sizeof(uint32_t)) {
+            uint32_t recordLength = OSReadLittleInt32(bytes, offset);
+            if (length - offset - sizeof(uint32_t) < recordLength) {
+                break;
+            }
+            NSData *recordData = [NSData dataWithBytesNoCopy:(void *)(bytes + offset + sizeof(uint32_t))
+                                                      length:recordLength
+                                                freeWhenDone:NO];
+            offset += sizeof(uint32_t) + recordLength;
+
+            id record = [FBUtility simpleJSONDecodeData:recordData error:nil];
+            if ([record isKindOfClass:[NSDictionary class]] &&
+                [wanted containsObject:[record objectForKey:kRecordSequenceNumberKey]]) {
+                record = FBAppEventsJournalEventFromRecord(record);
+                if (record) {
+                    [events addObject:record];
+                }
+            }
+        }
+        return events;
+    }
+}
+
+- (void)recordSkippedEvent {
+    @synchronized (self) {
+        _numSkipped++;
+        [self writeHeader];
+    }
+}
+
+- (NSArray *)takeRecoveredEvents:(NSUInteger *)numSkipped {
+    @synchronized (self) {
+        NSArray *events = [[_recoveredEvents copy] autorelease];
+        [_recoveredEvents removeAllObjects];
+        if (numSkipped) {
+            *numSkipped = _recoveredNumSkipped;
+        }
+        _recoveredNumSkipped = 0;
+        return events;
+    }
+}
+
++ (NSNumber *)sequenceNumberOfEvent:(NSDictionary *)eventAndImplicitFlag {
+    return [eventAndImplicitFlag objectForKey:kRecordSequenceNumberKey];
+}
+
+- (void)acknowledgeEvents:(NSArray *)eventsAndImplicitFlags {
+    NSMutableArray *acknowledged = [NSMutableArray arrayWithCapacity:eventsAndImplicitFlags.count];
+    for (NSDictionary *eventAndImplicitFlag in eventsAndImplicitFlags) {
+        NSNumber *sequenceNumber = [eventAndImplicitFlag objectForKey:kRecordSequenceNumberKey];
+        if (sequenceNumber) {
+            [acknowledged addObject:sequenceNumber];
+        }
+    }
+    [self acknowledgeEventsWithSequenceNumbers:acknowledged];
+}
+
+- (void)acknowledgeEventsWithSequenceNumbers:(NSArray *)acknowledged {
+    @synchronized (self) {
+        if (_fd < 0) {
+            return;
+        }
+
+        NSSet *acknowledgedSet = [NSSet setWithArray:acknowledged];
+        NSIndexSet *recoveredIndexes = [_recoveredEvents indexesOfObjectsPassingTest:^BOOL(NSDictionary *event, NSUInteger idx, BOOL *stop) {
+            return [acknowledgedSet containsObject:[event objectForKey:kRecordSequenceNumberKey]];
+        }];
+        [_recoveredEvents removeObjectsAtIndexes:recoveredIndexes];
+
+        [_acknowledgedSequenceNumbers addObjectsFromArray:acknowledged];
+        _numSkipped = 0;
+
+        // Acknowledged events at the front just move the checkpoint
+        while (_liveSequenceNumbers.count &&
+               [_acknowledgedSequenceNumbers containsObject:[_liveSequenceNumbers objectAtIndex:0]]) {
+            [_acknowledgedSequenceNumbers removeObject:[_liveSequenceNumbers objectAtIndex:0]];
+            _checkpointOffset = [[_liveEndOffsets objectAtIndex:0] unsignedLongLongValue];
+            [_liveSequenceNumbers removeObjectAtIndex:0];
+            [_liveEndOffsets removeObjectAtIndex:0];
+        }
+
+        if (!_liveSequenceNumbers.count) {
+            [self reset];
+            return;
+        }
+
+        // Anything acknowledged out of order (events for another session
+        // logged in between) is noted in the journal so it isn't recovered
+        NSMutableArray *outOfOrder = [NSMutableArray array];
+        for (NSNumber *sequenceNumber in acknowledged) {
+            if ([_acknowledgedSequenceNumbers containsObject:sequenceNumber]) {
+                [outOfOrder addObject:sequenceNumber];
+            }
+        }
+        if (outOfOrder.count) {
+            [self appendRecord:[NSDictionary dictionaryWithObject:outOfOrder forKey:kRecordAcknowledgedKey]];
+        }
+        [self writeHeader];
+
+        if (_checkpointOffset - kHeaderLength > kCompactionThreshold) {
+            [self compact];
+        }
+    }
+}
+
+- (void)synchronize {
+    @synchronized (self) {
+        if (_fd >= 0) {
+            fsync(_fd);
+        }
+    }
+}
+
+#pragma mark - Private
+
+- (void)open {
+    _fd = open([_path fileSystemRepresentation], O_RDWR | O_CREAT, 0644);
+    if (_fd < 0) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorAppEvents
+                        formatString:@"FBAppEvents Persist: Unable to open journal at %@ (errno %d)", _path, errno];
+        return;
+    }
+
+    struct stat info;
+    uint8_t header[kHeaderLength];
+    if (fstat(_fd, &info) != 0 ||
+        info.st_size < (off_t)kHeaderLength ||
+        pread(_fd, header, sizeof(header), 0) != sizeof(header) ||
+        OSReadLittleInt32(header, 0) != kJournalMagic) {
+        [self reset];
+        return;
+    }
+
+    _checkpointOffset = OSReadLittleInt64(header, 8);
+    if (_checkpointOffset < kHeaderLength || _checkpointOffset > (unsigned long long)info.st_size) {
+        [self reset];
+        return;
+    }
+    _numSkipped = OSReadLittleInt32(header, 4);
+    _recoveredNumSkipped = _numSkipped;
+
+    NSUInteger length = (NSUInteger)(info.st_size - _checkpointOffset);
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    if (pread(_fd, data.mutableBytes, length, (off_t)_checkpointOffset) != (ssize_t)length) {
+        [self reset];
+        return;
+    }
+    [self loadRecordsFromData:data];
+
+    // Drop anything torn by a crash mid-append
+    if (_endOffset < (unsigned long long)info.st_size) {
+        ftruncate(_fd, (off_t)_endOffset);
+    }
+
+    [FBLogger singleShotLogEntry:FBLoggingBehaviorAppEvents
+                    formatString:@"FBAppEvents Persist: Recovered %lu journaled events",
+                    (unsigned long)_recoveredEvents.count];
+}
+
+- (void)loadRecordsFromData:(NSData *)data {
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    NSUInteger offset = 0;
+    NSMutableArray *events = [NSMutableArray array];
+    NSMutableArray *endOffsets = [NSMutableArray array];
+    NSMutableSet *acknowledged = [NSMutableSet set];
+
+    while (length - offset >= sizeof(uint32_t)) {
+        uint32_t recordLength = OSReadLittleInt32(bytes, offset);
+        if (length - offset - sizeof(uint32_t) < recordLength) {
+            break;
+        }
+        NSData *recordData = [NSData dataWithBytesNoCopy:(void *)(bytes + offset + sizeof(uint32_t))
+                                                  length:recordLength
+                                            freeWhenDone:NO];
+        id record = [FBUtility simpleJSONDecodeData:recordData error:nil];
+        if (![record isKindOfClass:[NSDictionary class]]) {
+            break;
+        }
+        offset += sizeof(uint32_t) + recordLength;
+
+        NSNumber *sequenceNumber = [record objectForKey:kRecordSequenceNumberKey];
+        NSArray *acknowledgedSequenceNumbers = [record objectForKey:kRecordAcknowledgedKey];
+        if (sequenceNumber) {
+            [events addObject:FBAppEventsJournalEventFromRecord(record) ?: record];
+            [endOffsets addObject:[NSNumber numberWithUnsignedLongLong:_checkpointOffset + offset]];
+            _nextSequenceNumber = MAX(_nextSequenceNumber, sequenceNumber.unsignedLongLongValue + 1);
+        } else if ([acknowledgedSequenceNumbers isKindOfClass:[NSArray class]]) {
+            [acknowledged addObjectsFromArray:acknowledgedSequenceNumbers];
+        }
+    }
+    _endOffset = _checkpointOffset + offset;
+
+    for (NSUInteger i = 0; i < events.count; i++) {
+        NSDictionary *event = [events objectAtIndex:i];
+        NSNumber *sequenceNumber = [event objectForKey:kRecordSequenceNumberKey];
+        if ([acknowledged containsObject:sequenceNumber]) {
+            // Kept so the checkpoint can move past it later
+            [_acknowledgedSequenceNumbers addObject:sequenceNumber];
+        } else {
+            [_recoveredEvents addObject:event];
+        }
+        [_liveSequenceNumbers addObject:sequenceNumber];
+        [_liveEndOffsets addObject:[endOffsets objectAtIndex:i]];
+    }
+}
+
+// Empties the journal back to just its header
+- (void)reset {
+    [_liveSequenceNumbers removeAllObjects];
+    [_liveEndOffsets removeAllObjects];
+    [_acknowledgedSequenceNumbers removeAllObjects];
+    _checkpointOffset = kHeaderLength;
+    _endOffset = kHeaderLength;
+    if (_fd >= 0) {
+        ftruncate(_fd, (off_t)kHeaderLength);
+        [self writeHeader];
+    }
+}
+
+- (BOOL)writeHeader {
+    uint8_t header[kHeaderLength];
+    OSWriteLittleInt32(header, 0, kJournalMagic);
+    OSWriteLittleInt32(header, 4, _numSkipped);
+    OSWriteLittleInt64(header, 8, _checkpointOffset);
+    return _fd >= 0 && pwrite(_fd, header, sizeof(header), 0) == sizeof(header);
+}
+
+- (BOOL)appendRecord:(NSDictionary *)record {
+    if (_fd < 0) {
+        return NO;
+    }
+
+    NSData *json = FBAppEventsJournalEncodeRecord(record);
+    if (!json) {
+        return NO;
+    }
+
+    // One write, so the length and its record land together
+    NSMutableData *buffer = [NSMutableData dataWithLength:sizeof(uint32_t)];
+    OSWriteLittleInt32(buffer.mutableBytes, 0, (uint32_t)json.length);
+    [buffer appendData:json];
+    if (pwrite(_fd, buffer.bytes, buffer.length, (off_t)_endOffset) != (ssize_t)buffer.length) {
+        // Cut off whatever part made it out
+        ftruncate(_fd, (off_t)_endOffset);
+        return NO;
+    }
+    _endOffset += buffer.length;
+    return YES;
+}
+
+// Rewrites the journal without its acknowledged prefix.  The new file is
+// swapped in atomically, so a crash leaves either the old or the new one.
+- (void)compact {
+    NSUInteger length = (NSUInteger)(_endOffset - _checkpointOffset);
+    NSMutableData *data = [NSMutableData dataWithLength:kHeaderLength + length];
+    uint8_t *bytes = data.mutableBytes;
+    if (pread(_fd, bytes + kHeaderLength, length, (off_t)_checkpointOffset) != (ssize_t)length) {
+        return;
+    }
+    OSWriteLittleInt32(bytes, 0, kJournalMagic);
+    OSWriteLittleInt32(bytes, 4, _numSkipped);
+    OSWriteLittleInt64(bytes, 8, kHeaderLength);
+    if (![data writeToFile:_path atomically:YES]) {
+        return;
+    }
+
+    int fd = open([_path fileSystemRepresentation], O_RDWR);
+    if (fd < 0) {
+        return;
+    }
+    close(_fd);
+    _fd = fd;
+
+    unsigned long long shift = _checkpointOffset - kHeaderLength;
+    for (NSUInteger i = 0; i < _liveEndOffsets.count; i++) {
+        unsigned long long endOffset = [[_liveEndOffsets objectAtIndex:i] unsignedLongLongValue];
+        [_liveEndOffsets replaceObjectAtIndex:i withObject:[NSNumber numberWithUnsignedLongLong:endOffset - shift]];
+    }
+    _checkpointOffset = kHeaderLength;
+    _endOffset -= shift;
+}
+
+@end
@@ -53,6 +53,12 @@
  */
 @property (nonatomic, retain) NSMutableDictionary *params;
 
+/**
+ * Creates the web view the next dialog will use, once the main run loop is idle.
+ * Must be called on the main thread.
+ */
++ (void)prewarm;
+
 - (NSString *)getStringFromUrl:(NSString *)url needle:(NSString *)needle;
 
 - (id)      initWithURL:(NSString *)loadingURL
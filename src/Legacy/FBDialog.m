@@ -44,6 +44,57 @@ static BOOL FBIsDeviceIPad() {
     return NO;
 }
 
+// A single web view is kept between dialogs. Creating the first UIWebView in a process sets
+// up WebKit, which is most of the delay before a dialog starts loading, so dialogs take the
+// idle one when there is one and hand theirs back on dealloc. Main thread only.
+static UIWebView *g_idleWebView = nil;
+
+static void FBDialogObserveMemoryWarnings(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        [[NSNotificationCenter defaultCenter] addObserverForName:UIApplicationDidReceiveMemoryWarningNotification
+                                                          object:nil
+                                                           queue:[NSOperationQueue mainQueue]
+                                                      usingBlock:^(NSNotification *note) {
+                                                          [g_idleWebView release];
+                                                          g_idleWebView = nil;
+                                                      }];
+    });
+}
+
+static UIWebView *FBDialogCreateIdleWebView(void) {
+    UIWebView *webView = [[UIWebView alloc] initWithFrame:CGRectMake(kPadding, kPadding, 480, 480)];
+    [webView loadRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"about:blank"]]];
+    FBDialogObserveMemoryWarnings();
+    return webView;
+}
+
+// Returns a retained web view, reusing the idle one if present.
+static UIWebView *FBDialogDequeueWebView(void) {
+    UIWebView *webView = g_idleWebView;
+    g_idleWebView = nil;
+    if (!webView) {
+        webView = [[UIWebView alloc] initWithFrame:CGRectZero];
+    }
+    webView.frame = CGRectMake(kPadding, kPadding, 480, 480);
+    return webView;
+}
+
+// Takes ownership of webView, keeping it as the idle web view or releasing it.
+static void FBDialogRecycleWebView(UIWebView *webView) {
+    webView.delegate = nil;
+    [webView stopLoading];
+    [webView removeFromSuperview];
+    if (g_idleWebView || !webView) {
+        [webView release];
+        return;
+    }
+    // blank the page so nothing from the last dialog shows while the next one loads
+    [webView loadRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"about:blank"]]];
+    g_idleWebView = webView;
+    FBDialogObserveMemoryWarnings();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 @implementation FBDialog {
@@ -53,6 +104,12 @@ static BOOL FBIsDeviceIPad() {
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // private
 
++ (void)createIdleWebView {
+    if (!g_idleWebView) {
+        g_idleWebView = FBDialogCreateIdleWebView();
+    }
+}
+
 - (void)addRoundedRectToPath:(CGContextRef)context rect:(CGRect)rect radius:(float)radius {
     CGContextBeginPath(context);
     CGContextSaveGState(context);
@@ -329,7 +386,7 @@ static BOOL FBIsDeviceIPad() {
         self.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleHeight;
         self.contentMode = UIViewContentModeRedraw;
 
-        _webView = [[UIWebView alloc] initWithFrame:CGRectMake(kPadding, kPadding, 480, 480)];
+        _webView = FBDialogDequeueWebView();
         _webView.delegate = self;
         _webView.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleHeight;
         [self addSubview:_webView];
@@ -374,8 +431,7 @@ static BOOL FBIsDeviceIPad() {
 
 - (void)dealloc {
     [[NSNotificationCenter defaultCenter] removeObserver:self];
-    _webView.delegate = nil;
-    [_webView release];
+    FBDialogRecycleWebView(_webView);
     [_params release];
     [_serverURL release];
     [_spinner release];
@@ -560,6 +616,15 @@ static BOOL FBIsDeviceIPad() {
 //////////////////////////////////////////////////////////////////////////////////////////////////
 // public
 
++ (void)prewarm {
+    // wait for the run loop to settle into the default mode, so scrolling is never interrupted
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(createIdleWebView) object:nil];
+    [self performSelector:@selector(createIdleWebView)
+               withObject:nil
+               afterDelay:0
+                  inModes:@[NSDefaultRunLoopMode]];
+}
+
 /**
  * Find a specific parameter from the url
  */
@@ -28,6 +28,7 @@
 @interface FBFrictionlessRequestSettings : NSObject {
 @private
     NSArray *_allowedRecipients;
+    NSSet *_allowedRecipientSet;
     FBRequest *_activeRequest;
     BOOL _enabled;
 }
@@ -42,6 +43,12 @@
  */
 @property (nonatomic, readonly) NSArray *recipientIDs;
 
+/**
+ * Called on the main thread whenever the recipient cache is replaced, including
+ * by the recipient list returned from a completed request dialog
+ */
+@property (nonatomic, copy) void (^recipientCacheDidUpdateHandler)(void);
+
 /**
  * Enable frictionless request sending by the sdk; this means:
  *   1. query and cache the current set of frictionless recipients
@@ -43,6 +43,29 @@
     return self;
 }
 
+- (NSArray *)allowedRecipients {
+    @synchronized(self) {
+        return [[_allowedRecipients retain] autorelease];
+    }
+}
+
+- (void)setAllowedRecipients:(NSArray *)allowedRecipients {
+    // the set answers membership checks, the array keeps the order the server gave us
+    NSSet *allowedRecipientSet = allowedRecipients ? [[NSSet alloc] initWithArray:allowedRecipients] : nil;
+    @synchronized(self) {
+        [_allowedRecipients release];
+        _allowedRecipients = [allowedRecipients retain];
+        [_allowedRecipientSet release];
+        _allowedRecipientSet = allowedRecipientSet;
+    }
+}
+
+- (void)notifyRecipientCacheDidUpdate {
+    if (self.recipientCacheDidUpdateHandler) {
+        self.recipientCacheDidUpdateHandler();
+    }
+}
+
 - (void)setActiveRequest:(FBRequest *)activeRequest
 {
     if (_activeRequest != activeRequest) {
@@ -83,6 +106,7 @@
     } else {
         self.allowedRecipients = [[[NSArray alloc] initWithArray:ids] autorelease];
     }
+    [self notifyRecipientCacheDidUpdate];
 }
 
 - (BOOL)isFrictionlessEnabledForRecipient:(NSString *)fbid {
@@ -90,13 +114,9 @@
     fbid = [fbid stringByTrimmingCharactersInSet:
             [NSCharacterSet whitespaceCharacterSet]];
 
-    // linear search through cache for a match
-    for (NSString *entry in self.allowedRecipients) {
-        if ([entry isEqualToString:fbid]) {
-            return YES;
-        }
+    @synchronized(self) {
+        return [_allowedRecipientSet containsObject:fbid];
     }
-    return NO;
 }
 
 - (BOOL)isFrictionlessEnabledForRecipients:(NSArray *)fbids {
@@ -140,6 +160,7 @@
     }
 
     self.allowedRecipients = recipients;
+    [self notifyRecipientCacheDidUpdate];
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -165,6 +186,7 @@
 - (void)dealloc {
     self.activeRequest = nil;
     self.allowedRecipients = nil;
+    [_recipientCacheDidUpdateHandler release];
     [super dealloc];
 }
 
@@ -17,10 +17,12 @@
 #import "Facebook.h"
 
 #import "FBError.h"
+#import "FBErrorUtility.h"
 #import "FBFrictionlessRequestSettings.h"
 #import "FBLogger.h"
 #import "FBLoginDialog.h"
 #import "FBRequest.h"
+#import "FBRequestConnection.h"
 #import "FBSession+Internal.h"
 #import "FBSessionManualTokenCachingStrategy.h"
 #import "FBSessionUtility.h"
@@ -73,6 +75,8 @@ static NSString *const FBexpirationDatePropertyName = @"expirationDate";
     FBRequest *_requestExtendingAccessToken;
     NSDate *_lastAccessTokenUpdate;
     FBFrictionlessRequestSettings *_frictionlessRequestSettings;
+    // Graph API requests waiting for the end of the run loop pass to go out as one batch
+    NSMutableArray *_pendingBatchRequests;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -160,6 +164,7 @@ static NSString *const FBexpirationDatePropertyName = @"expirationDate";
     [_appId release];
     [_urlSchemeSuffix release];
     [_frictionlessRequestSettings release];
+    [_pendingBatchRequests release];
     [super dealloc];
 }
 
@@ -626,11 +631,81 @@ static NSString *const FBexpirationDatePropertyName = @"expirationDate";
                                                  parameters:params
                                                  HTTPMethod:httpMethod];
     [request setDelegate:delegate];
-    [request startWithCompletionHandler:nil];
+    if ([FBSettings isLegacyRequestBatchingEnabled]) {
+        [self enqueueBatchRequest:request];
+    } else {
+        [request startWithCompletionHandler:nil];
+    }
 
     return request;
 }
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+// Graph API requests made during one pass of the run loop are sent together.  The pending
+// requests are flushed by a zero delay perform, which also keeps this object alive until then.
+- (void)enqueueBatchRequest:(FBRequest *)request {
+    if (!_pendingBatchRequests) {
+        _pendingBatchRequests = [[NSMutableArray alloc] init];
+        [self performSelector:@selector(startPendingBatchRequests)
+                   withObject:nil
+                   afterDelay:0];
+    }
+    [_pendingBatchRequests addObject:request];
+}
+
+- (void)startPendingBatchRequests {
+    NSArray *requests = [_pendingBatchRequests autorelease];
+    _pendingBatchRequests = nil;
+
+    if (requests.count == 1) {
+        [[requests objectAtIndex:0] startWithCompletionHandler:nil];
+        return;
+    }
+
+    // A connection only makes the delegate callbacks itself when it has a single request, so for a
+    // batch each request's handler stands in for them.
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    for (FBRequest *request in requests) {
+        [connection addRequest:request
+             completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+                 id<FBRequestDelegate> delegate = [request delegate];
+                 if (!error) {
+                     if ([delegate respondsToSelector:@selector(request:didReceiveResponse:)]) {
+                         [delegate request:request didReceiveResponse:innerConnection.urlResponse];
+                     }
+                     if ([delegate respondsToSelector:@selector(request:didLoadRawResponse:)]) {
+                         [delegate request:request didLoadRawResponse:[FBUtility simpleJSONEncodeToData:result error:nil]];
+                     }
+                     if ([delegate respondsToSelector:@selector(request:didLoad:)]) {
+                         [delegate request:request didLoad:result];
+                     }
+                 } else {
+                     // the connection has already closed the session in this case
+                     if ([FBErrorUtility errorCategoryForError:error] == FBErrorCategoryAuthenticationReopenSession) {
+                         [request setSessionDidExpire:YES];
+                     }
+                     [request setError:error];
+                     if ([delegate respondsToSelector:@selector(request:didFailWithError:)]) {
+                         [delegate request:request didFailWithError:error];
+                     }
+                 }
+                 [request setState:kFBRequestStateComplete];
+             }];
+    }
+    for (FBRequest *request in requests) {
+        [request setState:kFBRequestStateLoading];
+        id<FBRequestDelegate> delegate = [request delegate];
+        if ([delegate respondsToSelector:@selector(requestLoading:)]) {
+            [delegate requestLoading:request];
+        }
+    }
+    [connection start];
+}
+
+#pragma GCC diagnostic pop
+
 /**
  * Generate a UI dialog for the request action.
  *
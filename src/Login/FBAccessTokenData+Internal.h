@@ -15,6 +15,11 @@
  */
 
 #import "FBAccessTokenData.h"
+#import "FBSDKMacros.h"
+
+// The last /me response for the token's user, kept with the rest of the token information as a
+// JSON string so that it survives the property list caching strategies
+FBSDK_EXTERN NSString *const FBTokenInformationCachedUserKey;
 
 /*
  @abstract Internal API to FBAccessTokenData
@@ -30,4 +35,18 @@
 @property (nonatomic, readwrite, copy) NSArray *permissions;
 @property (nonatomic, readwrite, copy) NSDate *permissionsRefreshDate;
 
+// the same permissions as `permissions`, kept as a set so that membership
+// checks do not have to scan the array
+@property (nonatomic, readonly, retain) NSSet *permissionsSet;
+
+// The ID of the user the token was issued to, if known; nil otherwise.  Login
+// doesn't set it.  It is read from FBTokenInformationUserFBIDKey, so it is only
+// set once -[FBSession cacheUser:] has recorded the user or a token cache supplied
+// the ID.  Carried over when the token is refreshed.
+@property (nonatomic, readwrite, copy) NSString *userID;
+
+// The ID and name from the last /me response for the token's user, or nil if there is none yet.  Carried over
+// when the token is refreshed, and dropped with the token information.
+@property (nonatomic, readwrite, copy) NSDictionary *cachedUser;
+
 @end
@@ -31,6 +31,12 @@
 
 @property (nonatomic, readwrite, copy) NSDate *permissionsRefreshDate;
 
+@property (nonatomic, readwrite, retain) NSSet *permissionsSet;
+
+@property (nonatomic, readwrite, copy) NSString *userID;
+
+@property (nonatomic, readwrite, copy) NSDictionary *cachedUser;
+
 @end
 
 @implementation FBAccessTokenData
@@ -44,6 +50,7 @@
     if ((self = [super init])) {
         _accessToken = [accessToken copy];
         _permissions = [permissions copy];
+        _permissionsSet = [[NSSet alloc] initWithArray:permissions ?: @[]];
         _expirationDate = [expirationDate copy];
         _refreshDate = [refreshDate copy];
         _loginType = loginType;
@@ -55,12 +62,23 @@
 - (void)dealloc {
     [_accessToken release];
     [_permissions release];
+    [_permissionsSet release];
     [_expirationDate release];
     [_refreshDate release];
     [_permissionsRefreshDate release];
+    [_userID release];
+    [_cachedUser release];
     [super dealloc];
 }
 
+- (void)setPermissions:(NSArray *)permissions {
+    if (_permissions != permissions) {
+        [_permissions release];
+        _permissions = [permissions copy];
+        self.permissionsSet = [NSSet setWithArray:permissions ?: @[]];
+    }
+}
+
 #pragma mark - Factory methods
 
 + (FBAccessTokenData *)createTokenFromFacebookURL:(NSURL *)url appID:(NSString *)appID urlSchemeSuffix:(NSString *)urlSchemeSuffix {
@@ -100,6 +118,17 @@
                                                      loginType:dictionaryLoginType
                                                    refreshDate:dictionaryRefreshDate
                                         permissionsRefreshDate:dictionaryPermissionsRefreshDate];
+    id dictionaryUserID = dictionary[FBTokenInformationUserFBIDKey];
+    if ([dictionaryUserID isKindOfClass:[NSString class]]) {
+        tokenData.userID = dictionaryUserID;
+    }
+    id dictionaryCachedUser = dictionary[FBTokenInformationCachedUserKey];
+    if ([dictionaryCachedUser isKindOfClass:[NSString class]]) {
+        id cachedUser = [FBUtility simpleJSONDecode:dictionaryCachedUser];
+        if ([cachedUser isKindOfClass:[NSDictionary class]]) {
+            tokenData.cachedUser = cachedUser;
+        }
+    }
     return tokenData;
 }
 
@@ -179,6 +208,8 @@
                                              loginType:self.loginType
                                            refreshDate:self.refreshDate
                                 permissionsRefreshDate:self.permissionsRefreshDate];
+    [copy setUserID:self.userID];
+    [copy setCachedUser:self.cachedUser];
     return copy;
 }
 
@@ -188,7 +219,7 @@
     }
 
     if ([self.accessToken isEqualToString:accessTokenData.accessToken]
-        && [[NSSet setWithArray:self.permissions] isEqualToSet:[NSSet setWithArray:accessTokenData.permissions]]
+        && [self.permissionsSet isEqualToSet:accessTokenData.permissionsSet]
         && [self.expirationDate isEqualToDate:accessTokenData.expirationDate]
         && self.loginType == accessTokenData.loginType
         && [self.refreshDate isEqualToDate:accessTokenData.refreshDate]
@@ -214,6 +245,15 @@
     if (self.permissionsRefreshDate) {
         dict[FBTokenInformationPermissionsRefreshDateKey] = self.permissionsRefreshDate;
     }
+    if (self.userID) {
+        dict[FBTokenInformationUserFBIDKey] = self.userID;
+    }
+    if (self.cachedUser) {
+        NSString *cachedUser = [FBUtility simpleJSONEncode:self.cachedUser];
+        if (cachedUser) {
+            dict[FBTokenInformationCachedUserKey] = cachedUser;
+        }
+    }
     return [dict autorelease];
 }
 
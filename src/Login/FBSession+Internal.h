@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#import "FBGraphUser.h"
 #import "FBSDKMacros.h"
 #import "FBSession.h"
 #import "FBSessionAppEventsState.h"
@@ -44,6 +45,14 @@ FBSDK_EXTERN NSString *const FacebookNativeApplicationLoginDomain;
 - (void)closeAndClearTokenInformation:(NSError *)error;
 - (void)clearAffinitizedThread;
 
+// The user last saved with the token by cacheUser:, wrapped as a graph object; nil if the
+// session is not open or nothing has been saved for its user yet
+- (NSMutableDictionary<FBGraphUser> *)cachedUser;
+// Saves the ID and name from a /me response with the token information, so the UI may have
+// something to show before the next /me returns; ignored unless the session is open and the
+// response is for the token's user
+- (void)cacheUser:(NSDictionary<FBGraphUser> *)user;
+
 + (FBSession *)activeSessionIfExists;
 
 + (FBSession *)activeSessionIfOpen;
@@ -28,20 +28,26 @@
 #import "FBAppEvents.h"
 #import "FBDataDiskCache.h"
 #import "FBDialogs+Internal.h"
+#import "FBDispatch.h"
 #import "FBError.h"
+#import "FBGraphObject.h"
 #import "FBLogger.h"
 #import "FBLoginDialog.h"
+#import "FBMainThreadWatchdog.h"
 #import "FBRequest+Internal.h"
+#import "FBRequestConnection+Internal.h"
 #import "FBSession+Protected.h"
 #import "FBSessionAppSwitchingLoginStategy.h"
 #import "FBSessionAuthLogger.h"
 #import "FBSessionInlineWebViewLoginStategy.h"
+#import "FBSessionPool.h"
 #import "FBSessionSystemLoginStategy.h"
 #import "FBSessionTokenCachingStrategy.h"
 #import "FBSessionUtility.h"
 #import "FBSettings+Internal.h"
 #import "FBSettings.h"
 #import "FBSystemAccountStoreAdapter.h"
+#import "FBURLConnection.h"
 #import "FBUtility.h"
 #import "Facebook.h"
 #import "FacebookSDK.h"
@@ -111,8 +117,14 @@ static FBSession *g_activeSession = nil;
     FBSessionLoginType _loginTypeOfPendingOpenUrlCallback;
     FBSessionDefaultAudience _defaultDefaultAudience;
     FBSessionLoginBehavior _loginBehavior;
-    NSMutableArray *_declinedPermissions;
+    NSMutableOrderedSet *_declinedPermissions;
     NSArray *_requestedReauthPermissions;
+
+    // token state is read from request-building threads, so it has its own locks rather
+    // than relying on thread affinity; declined permissions are guarded by the set itself
+    FBAccessTokenData *_accessTokenData;
+    NSObject *_accessTokenDataLock;
+    NSObject *_refreshAttemptLock;
 }
 
 // private setters
@@ -218,6 +230,8 @@ static FBSession *g_activeSession = nil;
 
         _attemptedRefreshDate = [[NSDate distantPast] copy];
         _attemptedPermissionsRefreshDate = [[NSDate distantPast] copy];
+        _accessTokenDataLock = [[NSObject alloc] init];
+        _refreshAttemptLock = [[NSObject alloc] init];
         _state = FBSessionStateCreated;
         _affinitizedThread = [[NSThread currentThread] retain];
 
@@ -232,7 +246,7 @@ static FBSession *g_activeSession = nil;
         };
 
         [FBSettings autoPublishInstall:self.appID];
-        _declinedPermissions = [[NSMutableArray alloc] init];
+        _declinedPermissions = [[NSMutableOrderedSet alloc] init];
     }
     return self;
 }
@@ -244,13 +258,14 @@ static FBSession *g_activeSession = nil;
 {
     if (cachedToken && self.state == FBSessionStateCreated) {
         BOOL isSubset = [FBSessionUtility areRequiredPermissions:permissions
-                                            aSubsetOfPermissions:cachedToken.permissions];
+                                         aSubsetOfPermissionsSet:cachedToken.permissionsSet];
 
         if (isSubset && (NSOrderedDescending == [cachedToken.expirationDate compare:[NSDate date]])) {
             _loginBehavior = [FBSessionUtility loginBehaviorForLoginType:self.accessTokenData.loginType];
             [self transitionToState:FBSessionStateCreatedTokenLoaded
                 withAccessTokenData:cachedToken
                         shouldCache:NO];
+            [FBURLConnection prewarmConnections];
             return YES;
         }
     }
@@ -273,15 +288,37 @@ static FBSession *g_activeSession = nil;
     [_authLogger release];
     [_declinedPermissions release];
     [_requestedReauthPermissions release];
+    [_accessTokenDataLock release];
+    [_refreshAttemptLock release];
 
     [super dealloc];
 }
 
 #pragma mark - Public Properties
 
+// The token data is swapped as a whole, so any thread can read a consistent snapshot without
+// hopping to the session's thread. FBAccessTokenData is immutable once it belongs to a session,
+// so the getter hands out the snapshot itself instead of copying it on every read.
+- (FBAccessTokenData *)accessTokenData {
+    @synchronized (_accessTokenDataLock) {
+        return [[_accessTokenData retain] autorelease];
+    }
+}
+
+- (void)setAccessTokenData:(FBAccessTokenData *)accessTokenData {
+    FBAccessTokenData *newTokenData = [accessTokenData copy];
+    FBAccessTokenData *oldTokenData = nil;
+    @synchronized (_accessTokenDataLock) {
+        oldTokenData = _accessTokenData;
+        _accessTokenData = newTokenData;
+    }
+    [oldTokenData release];
+}
+
 - (NSArray *)permissions {
-    if (self.accessTokenData) {
-        return self.accessTokenData.permissions;
+    FBAccessTokenData *tokenData = self.accessTokenData;
+    if (tokenData) {
+        return tokenData.permissions;
     } else {
         return self.initializedPermissions;
     }
@@ -300,15 +337,18 @@ static FBSession *g_activeSession = nil;
 }
 
 - (FBSessionLoginType) loginType {
-    if (self.accessTokenData) {
-        return self.accessTokenData.loginType;
+    FBAccessTokenData *tokenData = self.accessTokenData;
+    if (tokenData) {
+        return tokenData.loginType;
     } else {
         return FBSessionLoginTypeNone;
     }
 }
 
 - (NSArray *)declinedPermissions {
-    return [[_declinedPermissions copy] autorelease];
+    @synchronized (_declinedPermissions) {
+        return [[[_declinedPermissions array] copy] autorelease];
+    }
 }
 
 #pragma mark - Public Members
@@ -319,6 +359,8 @@ static FBSession *g_activeSession = nil;
 
 - (void)openWithBehavior:(FBSessionLoginBehavior)behavior
        completionHandler:(FBSessionStateHandler)handler {
+    FBMainThreadWatchdogMeasure();
+
     // is everything in good order?
     [FBSessionUtility validateRequestForPermissions:_initializedPermissions
                                     defaultAudience:_defaultDefaultAudience
@@ -450,6 +492,48 @@ static FBSession *g_activeSession = nil;
     [connection start];
 }
 
+- (void)refreshAccessTokenIfNeededWithCompletionHandler:(FBSessionRefreshAccessTokenHandler)handler {
+    [self checkThreadAffinity];
+
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    __block NSUInteger pendingCount = 0;
+    __block NSError *firstError = nil;
+    FBRequestHandler requestHandler = ^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        if (error && !firstError) {
+            firstError = [error retain];
+        }
+        if (--pendingCount == 0) {
+            if (handler) {
+                handler(self, YES, firstError);
+            }
+            [firstError release];
+        }
+    };
+
+    // both checks stamp their attempt dates, so a refresh made here keeps the
+    // next piggybacking request from sending the same calls again
+    if ([self shouldExtendAccessToken]) {
+        pendingCount++;
+        [FBRequestConnection addRequestToExtendTokenForSession:self
+                                                    connection:connection
+                                             completionHandler:requestHandler];
+    }
+    if ([self shouldRefreshPermissions]) {
+        pendingCount++;
+        [FBRequestConnection addRequestToRefreshPermissionsSession:self
+                                                        connection:connection
+                                                 completionHandler:requestHandler];
+    }
+
+    if (pendingCount == 0) {
+        if (handler) {
+            handler(self, NO, nil);
+        }
+        return;
+    }
+    [connection start];
+}
+
 - (void)close {
     [self checkThreadAffinity];
 
@@ -480,9 +564,13 @@ static FBSession *g_activeSession = nil;
         NSString *ID = clientState[FBSessionAuthLoggerParamIDKey];
         NSString *authMethod = clientState[FBSessionAuthLoggerParamAuthMethodKey];
         if (ID || authMethod) {
-            self.authLogger = [[[FBSessionAuthLogger alloc] initWithSession:self ID:ID authMethod:authMethod] autorelease];
+            self.authLogger = [[[FBSessionAuthLogger alloc] initWithSession:self
+                                                                         ID:ID
+                                                                 authMethod:authMethod
+                                                                  startTime:clientState[FBSessionAuthLoggerParamStartTimeKey]] autorelease];
         }
     }
+    [self.authLogger logPhase:FBSessionAuthLoggerPhaseCallbackReceived];
 
     switch (self.state) {
         case FBSessionStateCreatedOpening:
@@ -507,6 +595,7 @@ static FBSession *g_activeSession = nil;
 }
 
 - (BOOL)handleOpenURL:(NSURL *)url {
+    FBMainThreadWatchdogMeasure();
     [self checkThreadAffinity];
 
     NSDictionary *params = [FBSessionUtility queryParamsFromLoginURL:url
@@ -579,7 +668,7 @@ static FBSession *g_activeSession = nil;
 }
 
 - (BOOL)hasGranted:(NSString *)permission {
-    return [self.accessTokenData.permissions containsObject:permission];
+    return [self.accessTokenData.permissionsSet containsObject:permission];
 }
 
 #pragma mark -
@@ -673,8 +762,11 @@ static FBSession *g_activeSession = nil;
         // handlers to see the new active session
         FBSession *toRelease = g_activeSession;
 
-        // if we are being replaced, then we close you
-        [toRelease close];
+        // if we are being replaced, then we close you, unless you are pooled
+        // and the app expects to switch back to you
+        if (![[FBSessionPool sharedPool] containsSession:toRelease]) {
+            [toRelease close];
+        }
 
         // set the new session
         g_activeSession = [session retain];
@@ -724,6 +816,16 @@ static FBSession *g_activeSession = nil;
     [[FBSystemAccountStoreAdapter sharedInstance] renewSystemAuthorization:handler];
 }
 
++ (void)setLoginTimingHandler:(FBSessionLoginTimingHandler)handler {
+    [FBSessionAuthLogger setTimingHandler:handler];
+}
+
++ (void)prewarmSystemAccountStore {
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneBackground), ^{
+        [[FBSystemAccountStoreAdapter sharedInstance] prewarm];
+    });
+}
+
 #pragma mark -
 #pragma mark Private Members (core session members)
 
@@ -1551,6 +1653,7 @@ static FBSession *g_activeSession = nil;
 
     // now we are going to kick-off a batch request, where we confirm that the new token
     // refers to the same fbid as the old, and if so we will succeed the reauthorize call
+    [self.authLogger logPhase:FBSessionAuthLoggerPhaseTokenValidationStart];
     FBRequest *requestSessionMe = [FBRequest requestForGraphPath:@"me"];
     [requestSessionMe setSession:self];
     FBRequest *requestNewTokenMe = [[[FBRequest alloc] initWithSession:nil
@@ -1588,6 +1691,7 @@ static FBSession *g_activeSession = nil;
 
         // if this was our last call, then complete the operation
         if (!--callsPending) {
+            [self.authLogger logPhase:FBSessionAuthLoggerPhaseTokenValidationEnd];
             if ([fbid isEqual:fbid2]) {
                 NSMutableArray *allPermissions = [NSMutableArray array];
                 NSMutableArray *grantedPermissions = [NSMutableArray array];
@@ -1759,12 +1863,15 @@ static FBSession *g_activeSession = nil;
 - (void)refreshAccessToken:(NSString *)token
             expirationDate:(NSDate *)expireDate {
     // refresh token and date, state transition, and call the handler if there is one
-    FBAccessTokenData *tokenData = [FBAccessTokenData createTokenFromString:token ?: self.accessTokenData.accessToken
-                                                                permissions:self.accessTokenData.permissions
+    FBAccessTokenData *currentTokenData = self.accessTokenData;
+    FBAccessTokenData *tokenData = [FBAccessTokenData createTokenFromString:token ?: currentTokenData.accessToken
+                                                                permissions:currentTokenData.permissions
                                                              expirationDate:expireDate
                                                                   loginType:FBSessionLoginTypeNone
                                                                 refreshDate:[NSDate date]
-                                                     permissionsRefreshDate:self.accessTokenData.permissionsRefreshDate];
+                                                     permissionsRefreshDate:currentTokenData.permissionsRefreshDate];
+    tokenData.userID = currentTokenData.userID;
+    tokenData.cachedUser = currentTokenData.cachedUser;
     [self transitionAndCallHandlerWithState:FBSessionStateOpenTokenExtended
                                       error:nil
                                   tokenData:tokenData
@@ -1774,16 +1881,21 @@ static FBSession *g_activeSession = nil;
 - (BOOL)shouldExtendAccessToken {
     BOOL result = NO;
     NSDate *now = [NSDate date];
-    BOOL isFacebookLogin = self.accessTokenData.loginType == FBSessionLoginTypeFacebookApplication
-    || self.accessTokenData.loginType == FBSessionLoginTypeFacebookViaSafari
-    || self.accessTokenData.loginType == FBSessionLoginTypeSystemAccount;
-
-    if (self.isOpen &&
-        isFacebookLogin &&
-        [now timeIntervalSinceDate:self.attemptedRefreshDate] > FBTokenRetryExtendSeconds &&
-        [now timeIntervalSinceDate:self.accessTokenData.refreshDate] > FBTokenExtendThresholdSeconds) {
-        result = YES;
-        self.attemptedRefreshDate = now;
+    FBAccessTokenData *tokenData = self.accessTokenData;
+    BOOL isFacebookLogin = tokenData.loginType == FBSessionLoginTypeFacebookApplication
+    || tokenData.loginType == FBSessionLoginTypeFacebookViaSafari
+    || tokenData.loginType == FBSessionLoginTypeSystemAccount;
+
+    // the check and the stamp happen under one lock so that two request builders racing
+    // here do not both decide to extend
+    @synchronized (_refreshAttemptLock) {
+        if (self.isOpen &&
+            isFacebookLogin &&
+            [now timeIntervalSinceDate:self.attemptedRefreshDate] > FBTokenRetryExtendSeconds &&
+            [now timeIntervalSinceDate:tokenData.refreshDate] > FBTokenExtendThresholdSeconds) {
+            result = YES;
+            self.attemptedRefreshDate = now;
+        }
     }
     return result;
 }
@@ -1793,13 +1905,14 @@ static FBSession *g_activeSession = nil;
 // will return NO. Therefore, you should only call this method if you are also
 // prepared to actually `refreshPermissions`.
 - (BOOL)shouldRefreshPermissions {
-    @synchronized(self.attemptedPermissionsRefreshDate) {
+    FBAccessTokenData *tokenData = self.accessTokenData;
+    @synchronized (_refreshAttemptLock) {
         NSDate *now = [NSDate date];
 
         if (self.isOpen &&
             // Share the same thresholds as the access token string for convenience, we may change in the future.
             [now timeIntervalSinceDate:self.attemptedPermissionsRefreshDate] > FBTokenRetryExtendSeconds &&
-            [now timeIntervalSinceDate:self.accessTokenData.permissionsRefreshDate] > FBTokenExtendThresholdSeconds) {
+            [now timeIntervalSinceDate:tokenData.permissionsRefreshDate] > FBTokenExtendThresholdSeconds) {
             self.attemptedPermissionsRefreshDate = now;
             return YES;
         }
@@ -1817,17 +1930,22 @@ static FBSession *g_activeSession = nil;
 
             if ([allPermissions count] > 0) {
                 NSDate *now = [NSDate date];
-                FBAccessTokenData *tokenData = [FBAccessTokenData createTokenFromString:self.accessTokenData.accessToken
+                FBAccessTokenData *currentTokenData = self.accessTokenData;
+                FBAccessTokenData *tokenData = [FBAccessTokenData createTokenFromString:currentTokenData.accessToken
                                                                             permissions:grantedPermissions
-                                                                         expirationDate:self.accessTokenData.expirationDate
-                                                                              loginType:self.accessTokenData.loginType
-                                                                            refreshDate:self.accessTokenData.refreshDate
+                                                                         expirationDate:currentTokenData.expirationDate
+                                                                              loginType:currentTokenData.loginType
+                                                                            refreshDate:currentTokenData.refreshDate
                                                                  permissionsRefreshDate:now];
-                self.attemptedPermissionsRefreshDate = now;
+                tokenData.userID = currentTokenData.userID;
+                tokenData.cachedUser = currentTokenData.cachedUser;
+                @synchronized (_refreshAttemptLock) {
+                    self.attemptedPermissionsRefreshDate = now;
+                }
                 // Note we intentionally do not notify KVO that `accessTokenData `is changing since
                 // the implied contract is for that to only occur during state transitions.
                 self.accessTokenData = tokenData;
-                [self.tokenCachingStrategy cacheFBAccessTokenData:self.accessTokenData];
+                [self.tokenCachingStrategy cacheFBAccessTokenData:tokenData];
 
                 [self updateDeclinedPermissionsForRequestedPermissions:allPermissions grantedPermissions:grantedPermissions];
             }
@@ -1835,6 +1953,42 @@ static FBSession *g_activeSession = nil;
     }
 }
 
+- (NSMutableDictionary<FBGraphUser> *)cachedUser {
+    NSDictionary *cachedUser = self.isOpen ? self.accessTokenData.cachedUser : nil;
+    if (!cachedUser) {
+        return nil;
+    }
+    return (NSMutableDictionary<FBGraphUser> *)[FBGraphObject graphObjectWrappingDictionary:
+                                                 [[cachedUser mutableCopy] autorelease]];
+}
+
+- (void)cacheUser:(NSDictionary<FBGraphUser> *)user {
+    FBAccessTokenData *currentTokenData = self.accessTokenData;
+    NSString *userID = [user objectForKey:@"id"];
+    if (!self.isOpen ||
+        ![userID isKindOfClass:[NSString class]] ||
+        (currentTokenData.userID && ![currentTokenData.userID isEqualToString:userID])) {
+        return;
+    }
+
+    // only what the login view and user settings show; the rest of the profile isn't persisted
+    NSMutableDictionary *cachedUser = [NSMutableDictionary dictionaryWithObject:userID forKey:@"id"];
+    id name = [user objectForKey:@"name"];
+    if ([name isKindOfClass:[NSString class]]) {
+        cachedUser[@"name"] = name;
+    }
+    if ([currentTokenData.cachedUser isEqualToDictionary:cachedUser]) {
+        return;
+    }
+
+    FBAccessTokenData *tokenData = [[currentTokenData copy] autorelease];
+    tokenData.userID = userID;
+    tokenData.cachedUser = cachedUser;
+    // As with refreshed permissions this is not a state transition, so KVO is not notified.
+    self.accessTokenData = tokenData;
+    [self.tokenCachingStrategy cacheFBAccessTokenData:tokenData];
+}
+
 // Internally accessed, so we can bind the affinitized thread later.
 - (void)clearAffinitizedThread {
     self.affinitizedThread = nil;
@@ -2023,13 +2177,15 @@ static FBSession *g_activeSession = nil;
 }
 
 - (void)updateDeclinedPermissionsForRequestedPermissions:(NSArray *)requestedPermissions grantedPermissions:(NSArray *)grantedPermissions {
-    [_declinedPermissions removeObjectsInArray:grantedPermissions];
-    for (NSString* requested in requestedPermissions) {
-        if (![grantedPermissions containsObject:requested] &&
-            ![_declinedPermissions containsObject:requested] &&
-            ![requested isEqualToString:@"basic_info"] &&
-            ![requested isEqualToString:@"public_profile"]) {
-            [_declinedPermissions addObject:requested];
+    NSSet *granted = [NSSet setWithArray:grantedPermissions];
+    @synchronized (_declinedPermissions) {
+        [_declinedPermissions removeObjectsInArray:grantedPermissions];
+        for (NSString* requested in requestedPermissions) {
+            if (![granted containsObject:requested] &&
+                ![requested isEqualToString:@"basic_info"] &&
+                ![requested isEqualToString:@"public_profile"]) {
+                [_declinedPermissions addObject:requested];
+            }
         }
     }
 }
@@ -15,26 +15,75 @@
  */
 
 #import <Foundation/Foundation.h>
+#import <pthread.h>
 
 #import "FBSDKMacros.h"
 
 FBSDK_EXTERN NSString *const kFBAppEventIsImplicit;
 
+@class FBAppEventsJournal;
+
 /**
  Internal class that holds all the state associated with FBAppEvents for a particular FBSession.  An
  instance of this lives on FBSession.
+
+ Events may be added from any thread.  The lock guarding the buffers is never held while encoding
+ or writing to the journal, only for pointer swaps and counts, so loggers on different threads
+ don't queue up behind a flush or behind each other's journal writes.
  */
 @interface FBSessionAppEventsState : NSObject
+{
+@private
+    pthread_mutex_t _lock;
+    NSMutableArray *_accumulatedEvents;
+    // Replaced rather than mutated, so a flush can encode it outside the lock
+    NSArray *_inFlightEvents;
+    // accumulated plus in flight, plus any slots reserved for events being added
+    NSUInteger _bufferedEventCount;
+    NSUInteger _numSkippedEventsDueToFullBuffer;
+    // Journal sequence numbers of events that didn't fit in memory, plus a
+    // count that also covers spills still being written
+    NSMutableArray *_spilledSequenceNumbers;
+    NSUInteger _spilledEventCount;
+    // Events merged until the next flush, keyed by their dictionary minus
+    // log time and value to sum.  Each holds a buffer slot.
+    NSMutableDictionary *_aggregatedEvents;
+}
 
-@property (readonly, retain) NSMutableArray *accumulatedEvents;
-@property (readonly, retain) NSMutableArray *inFlightEvents;
-@property (readwrite) NSUInteger numSkippedEventsDueToFullBuffer;
 @property (readwrite) BOOL requestInFlight;
+// Where added events are recorded until they're cleared from flight
+@property (readwrite, retain) FBAppEventsJournal *journal;
+// Events kept in memory; past this they spill to the journal
+@property (readwrite) NSUInteger maxBufferedEventCount;
+// Events kept only in the journal; past this they're skipped
+@property (readwrite) NSUInteger maxSpilledEventCount;
 
 - (void)addEvent:(NSDictionary *)eventDictionary
       isImplicit:(BOOL)isImplicit;
-- (NSString *)jsonEncodeInFlightEvents:(BOOL)includeImplicitEvents;
+// Merges the event with any identical one added since the last flush, counting them and summing
+// their _valueToSum.  Merged events are only encoded and journaled when the flush takes them.
+- (void)addAggregatedEvent:(NSDictionary *)eventDictionary
+                isImplicit:(BOOL)isImplicit;
+// Adds events recovered from disk straight to the in-flight list
+- (void)addInFlightEvents:(NSArray *)eventsAndImplicitFlags
+               numSkipped:(NSUInteger)numSkipped;
+// Treats events already in the journal as spilled, so the next flush reads them back
+- (void)addSpilledSequenceNumbers:(NSArray *)sequenceNumbers;
+// Reads spilled events back into the accumulated ones, as far as memory allows
+- (void)restoreSpilledEvents;
+// Turns the merged events into ordinary accumulated ones, starting a new aggregation window
+- (void)closeAggregationWindow;
+// Swaps the accumulated events into flight, returning the in-flight count
+- (NSUInteger)moveAccumulatedEventsInFlight;
+// Snapshot of the in-flight events
+- (NSArray *)inFlightEvents;
+// Each event is held as the JSON it was encoded to when added
+- (NSData *)jsonDataForInFlightEvents:(BOOL)includeImplicitEvents;
+- (BOOL)areAllInFlightEventsImplicit;
 - (NSUInteger)getAccumulatedEventCount;
+- (NSUInteger)getInFlightEventCount;
+- (NSUInteger)getSpilledEventCount;
+- (NSUInteger)getNumSkippedEvents;
 - (void)clearInFlightAndStats;
 
 @end
@@ -15,32 +15,39 @@
  */
 
 #import "FBSessionAppEventsState.h"
+
+#import "FBAppEventsJournal.h"
 #import "FBUtility.h"
 
 NSString *const kFBAppEventIsImplicit = @"isImplicit";
 
-@interface FBSessionAppEventsState ()
-
-@property (readwrite, retain) NSMutableArray *accumulatedEvents;
-@property (readwrite, retain) NSMutableArray *inFlightEvents;
-
-@end
+static NSString *const kAggregateEventKey = @"event";
+static NSString *const kAggregateCountKey = @"count";
+static NSString *const kAggregateValueToSumKey = @"valueToSum";
+// Aggregates encoded per autorelease pool when an aggregation window closes
+static const NSUInteger kAggregateEncodingChunkSize = 100;
 
 @implementation FBSessionAppEventsState
 
-static const int MAX_ACCUMULATED_LOG_EVENTS = 1000;
-
 - (instancetype)init {
     if ((self = [super init])) {
+        pthread_mutex_init(&_lock, NULL);
         _accumulatedEvents = [[NSMutableArray alloc] init];
-        _inFlightEvents = [[NSMutableArray alloc] init];
+        _inFlightEvents = [[NSArray alloc] init];
+        _spilledSequenceNumbers = [[NSMutableArray alloc] init];
+        _aggregatedEvents = [[NSMutableDictionary alloc] init];
+        _maxBufferedEventCount = 1000;
     }
     return self;
 }
 
 - (void)dealloc {
-    self.accumulatedEvents = nil;
-    self.inFlightEvents = nil;
+    [_accumulatedEvents release];
+    [_inFlightEvents release];
+    [_spilledSequenceNumbers release];
+    [_aggregatedEvents release];
+    self.journal = nil;
+    pthread_mutex_destroy(&_lock);
 
     [super dealloc];
 }
@@ -48,54 +55,320 @@ static const int MAX_ACCUMULATED_LOG_EVENTS = 1000;
 - (void)addEvent:(NSDictionary *)eventDictionary
       isImplicit:(BOOL)isImplicit {
 
-    @synchronized (self) {
-        if (self.accumulatedEvents.count + self.inFlightEvents.count >= MAX_ACCUMULATED_LOG_EVENTS) {
-            // Skip, but record that we've done so.  This gets sent in the post when we do flush.
-            self.numSkippedEventsDueToFullBuffer++;
+    // Encoded once here, so neither the journal nor a flush has to touch the dictionary again
+    NSData *eventJSON = [FBUtility simpleJSONEncodeToData:eventDictionary error:nil];
+    if (!eventJSON) {
+        return;
+    }
+
+    FBAppEventsJournal *journal = self.journal;
+
+    // Reserve a slot first, so the journal write can happen unlocked
+    pthread_mutex_lock(&_lock);
+    BOOL buffer = _bufferedEventCount < self.maxBufferedEventCount;
+    BOOL spill = !buffer && journal && _spilledEventCount < self.maxSpilledEventCount;
+    if (buffer) {
+        _bufferedEventCount++;
+    } else if (spill) {
+        _spilledEventCount++;
+    } else {
+        // Skip, but record that we've done so.  This gets sent in the post when we do flush.
+        _numSkippedEventsDueToFullBuffer++;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (!buffer && !spill) {
+        [journal recordSkippedEvent];
+        return;
+    }
+
+    NSDictionary *eventAndImplicitFlag = @{@"event" : eventJSON,
+                                           kFBAppEventIsImplicit : [NSNumber numberWithBool:isImplicit],
+                                           };
+    if (spill) {
+        NSNumber *sequenceNumber = [journal spillEvent:eventAndImplicitFlag];
+        pthread_mutex_lock(&_lock);
+        if (sequenceNumber) {
+            [_spilledSequenceNumbers addObject:sequenceNumber];
         } else {
-            [self.accumulatedEvents addObject:@{@"event" : eventDictionary,
-                                                kFBAppEventIsImplicit : [NSNumber numberWithBool:isImplicit],
-                                                }];
+            _spilledEventCount--;
+            _numSkippedEventsDueToFullBuffer++;
         }
+        pthread_mutex_unlock(&_lock);
+
+        if (!sequenceNumber) {
+            [journal recordSkippedEvent];
+        }
+        return;
     }
+
+    if (journal) {
+        eventAndImplicitFlag = [journal appendEvent:eventAndImplicitFlag] ?: eventAndImplicitFlag;
+    }
+
+    pthread_mutex_lock(&_lock);
+    [_accumulatedEvents addObject:eventAndImplicitFlag];
+    pthread_mutex_unlock(&_lock);
 }
 
-- (NSUInteger)getAccumulatedEventCount {
-    @synchronized (self) {
-        return self.accumulatedEvents.count;
+- (void)addAggregatedEvent:(NSDictionary *)eventDictionary
+                isImplicit:(BOOL)isImplicit {
+
+    NSMutableDictionary *key = [[eventDictionary mutableCopy] autorelease];
+    [key removeObjectsForKeys:@[@"_logTime", @"_valueToSum"]];
+    NSNumber *valueToSum = [eventDictionary objectForKey:@"_valueToSum"];
+
+    pthread_mutex_lock(&_lock);
+    NSMutableDictionary *aggregate = [_aggregatedEvents objectForKey:key];
+    if (aggregate) {
+        NSUInteger count = [[aggregate objectForKey:kAggregateCountKey] unsignedIntegerValue] + 1;
+        [aggregate setObject:[NSNumber numberWithUnsignedInteger:count] forKey:kAggregateCountKey];
+        if (valueToSum) {
+            double sum = [[aggregate objectForKey:kAggregateValueToSumKey] doubleValue] + valueToSum.doubleValue;
+            [aggregate setObject:[NSNumber numberWithDouble:sum] forKey:kAggregateValueToSumKey];
+        }
+    } else if (_bufferedEventCount < self.maxBufferedEventCount) {
+        _bufferedEventCount++;
+        aggregate = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+                     eventDictionary, kAggregateEventKey,
+                     [NSNumber numberWithUnsignedInteger:1], kAggregateCountKey,
+                     [NSNumber numberWithBool:isImplicit], kFBAppEventIsImplicit,
+                     nil];
+        if (valueToSum) {
+            [aggregate setObject:valueToSum forKey:kAggregateValueToSumKey];
+        }
+        [_aggregatedEvents setObject:aggregate forKey:key];
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (!aggregate) {
+        // No room for another distinct event; spill or skip it like any other
+        [self addEvent:eventDictionary isImplicit:isImplicit];
     }
 }
 
+- (void)closeAggregationWindow {
+    NSMutableDictionary *emptyAggregates = [[NSMutableDictionary alloc] init];
+
+    pthread_mutex_lock(&_lock);
+    NSMutableDictionary *aggregatedEvents = _aggregatedEvents;
+    _aggregatedEvents = emptyAggregates;
+    pthread_mutex_unlock(&_lock);
+
+    FBAppEventsJournal *journal = self.journal;
+    NSArray *aggregates = [aggregatedEvents allValues];
+    NSUInteger count = aggregates.count;
+    NSMutableArray *events = [NSMutableArray arrayWithCapacity:count];
+    // The encoder's and journal's temporaries are dropped a chunk at a time;
+    // what's kept is retained by events
+    for (NSUInteger chunkStart = 0; chunkStart < count; chunkStart += kAggregateEncodingChunkSize) {
+        @autoreleasepool {
+            NSUInteger chunkEnd = MIN(count, chunkStart + kAggregateEncodingChunkSize);
+            for (NSUInteger i = chunkStart; i < chunkEnd; i++) {
+                NSDictionary *aggregate = [aggregates objectAtIndex:i];
+                // The first event's log time stands for the lot
+                NSMutableDictionary *eventDictionary = [[[aggregate objectForKey:kAggregateEventKey] mutableCopy] autorelease];
+                [eventDictionary setObject:[aggregate objectForKey:kAggregateCountKey] forKey:@"_eventCount"];
+                NSNumber *valueToSum = [aggregate objectForKey:kAggregateValueToSumKey];
+                if (valueToSum) {
+                    [eventDictionary setObject:valueToSum forKey:@"_valueToSum"];
+                }
+
+                NSData *eventJSON = [FBUtility simpleJSONEncodeToData:eventDictionary error:nil];
+                if (!eventJSON) {
+                    continue;
+                }
+                NSDictionary *eventAndImplicitFlag = @{@"event" : eventJSON,
+                                                       kFBAppEventIsImplicit : [aggregate objectForKey:kFBAppEventIsImplicit],
+                                                       };
+                if (journal) {
+                    eventAndImplicitFlag = [journal appendEvent:eventAndImplicitFlag] ?: eventAndImplicitFlag;
+                }
+                [events addObject:eventAndImplicitFlag];
+            }
+        }
+    }
+
+    // The slots were reserved when each aggregate was started
+    pthread_mutex_lock(&_lock);
+    [_accumulatedEvents addObjectsFromArray:events];
+    _bufferedEventCount -= aggregatedEvents.count - events.count;
+    pthread_mutex_unlock(&_lock);
+
+    [aggregatedEvents release];
+}
+
+- (void)addInFlightEvents:(NSArray *)eventsAndImplicitFlags
+               numSkipped:(NSUInteger)numSkipped {
+    pthread_mutex_lock(&_lock);
+    NSArray *inFlightEvents = [_inFlightEvents arrayByAddingObjectsFromArray:eventsAndImplicitFlags];
+    [_inFlightEvents release];
+    _inFlightEvents = [inFlightEvents retain];
+    _bufferedEventCount += eventsAndImplicitFlags.count;
+    _numSkippedEventsDueToFullBuffer += numSkipped;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)addSpilledSequenceNumbers:(NSArray *)sequenceNumbers {
+    pthread_mutex_lock(&_lock);
+    [_spilledSequenceNumbers addObjectsFromArray:sequenceNumbers];
+    _spilledEventCount += sequenceNumbers.count;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)restoreSpilledEvents {
+    pthread_mutex_lock(&_lock);
+    NSUInteger maxBufferedEventCount = self.maxBufferedEventCount;
+    NSUInteger room = _bufferedEventCount < maxBufferedEventCount ? maxBufferedEventCount - _bufferedEventCount : 0;
+    NSRange range = NSMakeRange(0, MIN(room, _spilledSequenceNumbers.count));
+    NSArray *sequenceNumbers = [_spilledSequenceNumbers subarrayWithRange:range];
+    [_spilledSequenceNumbers removeObjectsInRange:range];
+    _spilledEventCount -= range.length;
+    _bufferedEventCount += range.length;
+    pthread_mutex_unlock(&_lock);
+
+    if (!sequenceNumbers.count) {
+        return;
+    }
+
+    // Concurrent spills can finish out of order
+    sequenceNumbers = [sequenceNumbers sortedArrayUsingSelector:@selector(compare:)];
+    NSArray *events = [self.journal readEventsWithSequenceNumbers:sequenceNumbers];
+
+    pthread_mutex_lock(&_lock);
+    [_accumulatedEvents addObjectsFromArray:events];
+    // Anything that couldn't be read back is as good as skipped
+    NSUInteger numLost = sequenceNumbers.count - events.count;
+    _bufferedEventCount -= numLost;
+    _numSkippedEventsDueToFullBuffer += numLost;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (NSUInteger)moveAccumulatedEventsInFlight {
+    NSMutableArray *emptyEvents = [[NSMutableArray alloc] init];
+
+    pthread_mutex_lock(&_lock);
+    NSMutableArray *accumulatedEvents = _accumulatedEvents;
+    _accumulatedEvents = emptyEvents;
+    if (_inFlightEvents.count) {
+        // Left over from a flush that didn't get through
+        NSArray *inFlightEvents = [_inFlightEvents arrayByAddingObjectsFromArray:accumulatedEvents];
+        [_inFlightEvents release];
+        _inFlightEvents = [inFlightEvents retain];
+        [accumulatedEvents release];
+    } else {
+        // Nothing adds to it after the swap, so it can go into flight as is
+        [_inFlightEvents release];
+        _inFlightEvents = accumulatedEvents;
+    }
+    NSUInteger count = _inFlightEvents.count;
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+- (NSArray *)inFlightEvents {
+    pthread_mutex_lock(&_lock);
+    NSArray *inFlightEvents = [_inFlightEvents retain];
+    pthread_mutex_unlock(&_lock);
+
+    return [inFlightEvents autorelease];
+}
+
+- (NSUInteger)getAccumulatedEventCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _accumulatedEvents.count + _aggregatedEvents.count;
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+- (NSUInteger)getInFlightEventCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _inFlightEvents.count;
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+- (NSUInteger)getSpilledEventCount {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _spilledEventCount;
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+- (NSUInteger)getNumSkippedEvents {
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _numSkippedEventsDueToFullBuffer;
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
 - (void)clearInFlightAndStats {
-    @synchronized (self) {
-        [self.inFlightEvents removeAllObjects];
-        self.numSkippedEventsDueToFullBuffer = 0;
+    NSArray *inFlightEvents = [self inFlightEvents];
+    [self.journal acknowledgeEvents:inFlightEvents];
+
+    pthread_mutex_lock(&_lock);
+    // Only drop what was acknowledged; a recovery may have added more since
+    NSMutableArray *remainingEvents = [_inFlightEvents mutableCopy];
+    [remainingEvents removeObjectsInRange:NSMakeRange(0, inFlightEvents.count)];
+    [_inFlightEvents release];
+    _inFlightEvents = remainingEvents;
+    _bufferedEventCount -= inFlightEvents.count;
+    _numSkippedEventsDueToFullBuffer = 0;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (BOOL)areAllInFlightEventsImplicit {
+    for (NSDictionary *eventAndImplicitFlag in [self inFlightEvents]) {
+        if (![[eventAndImplicitFlag objectForKey:kFBAppEventIsImplicit] boolValue]) {
+            return NO;
+        }
     }
+    return YES;
 }
 
-// JSON representation of the in-flight events, potentially excluding those marked as implicit.  Return
+// UTF-8 JSON array of the in-flight events, potentially excluding those marked as implicit.  Return
 // nil if the resultant set of events is empty.
-- (NSString *)jsonEncodeInFlightEvents:(BOOL)includeImplicitEvents {
+- (NSData *)jsonDataForInFlightEvents:(BOOL)includeImplicitEvents {
 
-    NSMutableArray *eventArray = [[NSMutableArray alloc] initWithCapacity:self.inFlightEvents.count];
+    NSArray *inFlightEvents = [self inFlightEvents];
+    NSUInteger length = 0;
+    NSUInteger eventCount = 0;
 
-    for (NSDictionary *eventAndImplicitFlag in self.inFlightEvents) {
+    for (NSDictionary *eventAndImplicitFlag in inFlightEvents) {
         if (!includeImplicitEvents && [[eventAndImplicitFlag objectForKey:kFBAppEventIsImplicit] boolValue]) {
             continue;
         }
-        [eventArray addObject:[eventAndImplicitFlag objectForKey:@"event"]];
+        length += [[eventAndImplicitFlag objectForKey:@"event"] length] + 1;
+        eventCount++;
     }
 
-    NSString *jsonEncodedEvents = nil;
-    if (eventArray.count != 0) {
-        jsonEncodedEvents = [FBUtility simpleJSONEncode:eventArray];
+    // Each event was encoded when it was logged, so this is just joining the bytes
+    // up, in one buffer sized by the first pass and nothing else
+    if (eventCount == 0) {
+        return nil;
     }
-
-    [eventArray release];
+    NSMutableData *jsonEncodedEvents = [NSMutableData dataWithCapacity:length + 1];
+    [jsonEncodedEvents appendBytes:"[" length:1];
+    BOOL first = YES;
+    for (NSDictionary *eventAndImplicitFlag in inFlightEvents) {
+        if (!includeImplicitEvents && [[eventAndImplicitFlag objectForKey:kFBAppEventIsImplicit] boolValue]) {
+            continue;
+        }
+        if (!first) {
+            [jsonEncodedEvents appendBytes:"," length:1];
+        }
+        first = NO;
+        [jsonEncodedEvents appendData:[eventAndImplicitFlag objectForKey:@"event"]];
+    }
+    [jsonEncodedEvents appendBytes:"]" length:1];
 
     return jsonEncodedEvents;
 }
 
 
 @end
-
@@ -22,6 +22,7 @@
 // Keys to be used to serialize the logger (e.g. into JSON)
 FBSDK_EXTERN NSString *const FBSessionAuthLoggerParamAuthMethodKey;
 FBSDK_EXTERN NSString *const FBSessionAuthLoggerParamIDKey;
+FBSDK_EXTERN NSString *const FBSessionAuthLoggerParamStartTimeKey;
 
 // The names of the authentication methods that are supported
 FBSDK_EXTERN NSString *const FBSessionAuthLoggerAuthMethodIntegrated;
@@ -36,6 +37,13 @@ FBSDK_EXTERN NSString *const FBSessionAuthLoggerResultError;
 FBSDK_EXTERN NSString *const FBSessionAuthLoggerResultCancelled;
 FBSDK_EXTERN NSString *const FBSessionAuthLoggerResultSkipped;
 
+// Phases of an auth request whose timing is recorded, in the order they usually happen.
+FBSDK_EXTERN NSString *const FBSessionAuthLoggerPhaseMethodStart;
+FBSDK_EXTERN NSString *const FBSessionAuthLoggerPhaseCallbackReceived;
+FBSDK_EXTERN NSString *const FBSessionAuthLoggerPhaseTokenValidationStart;
+FBSDK_EXTERN NSString *const FBSessionAuthLoggerPhaseTokenValidationEnd;
+FBSDK_EXTERN NSString *const FBSessionAuthLoggerPhaseEnd;
+
 /*
  * This class is used specifically for logging events during auth/reauth cycles, for internal
  * debugging purposes.
@@ -61,6 +69,25 @@ FBSDK_EXTERN NSString *const FBSessionAuthLoggerResultSkipped;
  */
 - (instancetype)initWithSession:(FBSession *)session ID:(NSString *)ID authMethod:(NSString *)authMethod;
 
+/*!
+ @abstract
+ Same as `initWithSession:ID:authMethod:`, also restoring when the auth request started so phase
+ timings stay relative to the original start after a round trip through another app.
+ */
+- (instancetype)initWithSession:(FBSession *)session ID:(NSString *)ID authMethod:(NSString *)authMethod startTime:(NSNumber *)startTime;
+
+/*!
+ @abstract
+ Sets the handler that is given the phase timings of every auth request as it ends.
+ */
++ (void)setTimingHandler:(FBSessionLoginTimingHandler)handler;
+
+/*!
+ @abstract
+ Returns the logger's fields to round trip through the client state of an app switch or web dialog.
+ */
+- (NSDictionary *)clientStateForAuthMethod:(NSString *)authMethod;
+
 /*!
  @abstract
  Add JSON-serializable data to the 'extras' JSON blob that is attached to these auth events. The
@@ -70,6 +97,13 @@ FBSDK_EXTERN NSString *const FBSessionAuthLoggerResultSkipped;
  */
 - (void)addExtrasForNextEvent:(NSDictionary *)metadata;
 
+/*!
+ @abstract
+ Records the time the auth request reached the given phase, in milliseconds since `logStartAuth`.
+ The timings recorded so far are attached to every end event.
+ */
+- (void)logPhase:(NSString *)phase;
+
 /*!
  @abstract
  Logs the start of an auth request
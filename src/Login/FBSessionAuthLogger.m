@@ -31,6 +31,7 @@ NSString *const FBSessionAuthLoggerParamAuthMethodKey = @"3_method";
 NSString *const FBSessionAuthLoggerParamErrorCodeKey = @"4_error_code";
 NSString *const FBSessionAuthLoggerParamErrorMessageKey = @"5_error_message";
 NSString *const FBSessionAuthLoggerParamExtrasKey = @"6_extras";
+NSString *const FBSessionAuthLoggerParamStartTimeKey = @"auth_start_ms";
 
 NSString *const FBSessionAuthLoggerAuthMethodIntegrated = @"integrated_auth";
 NSString *const FBSessionAuthLoggerAuthMethodFBApplicationNative = @"fb_application_native_auth";
@@ -43,14 +44,33 @@ NSString *const FBSessionAuthLoggerResultError = @"error";
 NSString *const FBSessionAuthLoggerResultCancelled = @"cancelled";
 NSString *const FBSessionAuthLoggerResultSkipped = @"skipped";
 
+NSString *const FBSessionAuthLoggerPhaseMethodStart = @"method_start";
+NSString *const FBSessionAuthLoggerPhaseCallbackReceived = @"callback_received";
+NSString *const FBSessionAuthLoggerPhaseTokenValidationStart = @"token_validation_start";
+NSString *const FBSessionAuthLoggerPhaseTokenValidationEnd = @"token_validation_end";
+NSString *const FBSessionAuthLoggerPhaseEnd = @"end";
+
 NSString *const FBSessionAuthLoggerParamEmptyValue = @"";
 
+static NSString *const FBSessionAuthLoggerExtrasPhaseTimingsKey = @"phase_ms";
+
+static FBSessionLoginTimingHandler _timingHandler = nil;
+
+// Wall clock, since the start time may have to survive a relaunch while the user is in another app
+static double FBSessionAuthLoggerNowInMilliseconds(void)
+{
+    return 1000 * [[NSDate date] timeIntervalSince1970];
+}
+
 @interface FBSessionAuthLogger ()
 
 @property (nonatomic, readwrite, copy) NSString *ID;
 @property (nonatomic, retain) NSMutableDictionary *extras;
 @property (nonatomic, assign) FBSession *session;
 @property (nonatomic, copy) NSString *authMethod;
+@property (nonatomic, copy) NSString *lastAuthMethod;
+@property (nonatomic, retain) NSNumber *startTime;
+@property (nonatomic, retain) NSMutableDictionary *phaseTimings;
 
 @end
 
@@ -63,12 +83,22 @@ NSString *const FBSessionAuthLoggerParamEmptyValue = @"";
 }
 
 - (instancetype)initWithSession:(FBSession *)session ID:(NSString *)ID authMethod:(NSString *)authMethod {
+    return [self initWithSession:session
+                              ID:ID
+                      authMethod:authMethod
+                       startTime:nil];
+}
+
+- (instancetype)initWithSession:(FBSession *)session ID:(NSString *)ID authMethod:(NSString *)authMethod startTime:(NSNumber *)startTime {
     self = [super init];
     if (self) {
         self.ID = ID ?: [[FBUtility newUUIDString] autorelease];
         self.authMethod = authMethod;
+        self.lastAuthMethod = authMethod;
         self.extras = [NSMutableDictionary dictionary];
         self.session = session;
+        self.startTime = [startTime isKindOfClass:[NSNumber class]] ? startTime : nil;
+        self.phaseTimings = [NSMutableDictionary dictionary];
     }
     return self;
 }
@@ -77,10 +107,42 @@ NSString *const FBSessionAuthLoggerParamEmptyValue = @"";
     [_ID release];
     [_extras release];
     [_authMethod release];
+    [_lastAuthMethod release];
+    [_startTime release];
+    [_phaseTimings release];
 
     [super dealloc];
 }
 
++ (void)setTimingHandler:(FBSessionLoginTimingHandler)handler {
+    @synchronized (self) {
+        if (_timingHandler != handler) {
+            [_timingHandler release];
+            _timingHandler = [handler copy];
+        }
+    }
+}
+
+- (NSDictionary *)clientStateForAuthMethod:(NSString *)authMethod {
+    NSMutableDictionary *clientState = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+                                        authMethod ?: FBSessionAuthLoggerParamEmptyValue, FBSessionAuthLoggerParamAuthMethodKey,
+                                        self.ID ?: FBSessionAuthLoggerParamEmptyValue, FBSessionAuthLoggerParamIDKey,
+                                        nil];
+    if (self.startTime) {
+        clientState[FBSessionAuthLoggerParamStartTimeKey] = self.startTime;
+    }
+    return clientState;
+}
+
+- (void)logPhase:(NSString *)phase {
+    if (!self.startTime) {
+        return;
+    }
+    double elapsed = FBSessionAuthLoggerNowInMilliseconds() - [self.startTime doubleValue];
+    // a tenth of a millisecond is plenty, and keeps the extras JSON short
+    self.phaseTimings[phase] = [NSNumber numberWithDouble:round(10 * elapsed) / 10];
+}
+
 - (void)addExtrasForNextEvent:(NSDictionary *)extras {
     [self.extras addEntriesFromDictionary:extras];
 }
@@ -134,15 +196,24 @@ NSString *const FBSessionAuthLoggerParamEmptyValue = @"";
         params[FBSessionAuthLoggerParamErrorCodeKey] = [NSNumber numberWithInteger:error.code];
     }
 
+    if (self.phaseTimings.count > 0) {
+        [self addExtrasForNextEvent:@{FBSessionAuthLoggerExtrasPhaseTimingsKey: [[self.phaseTimings copy] autorelease]}];
+    }
+
     [self logEvent:eventName params:params];
 }
 
 - (void)logStartAuth {
+    if (!self.startTime) {
+        self.startTime = [NSNumber numberWithDouble:FBSessionAuthLoggerNowInMilliseconds()];
+    }
     [self logEvent:FBAppEventNameFBSessionAuthStart params:[[self newEventParameters] autorelease]];
 }
 
 - (void)logStartAuthMethod:(NSString *)authMethodName {
     self.authMethod = authMethodName;
+    self.lastAuthMethod = authMethodName;
+    [self logPhase:FBSessionAuthLoggerPhaseMethodStart];
     [self logEvent:FBAppEventNameFBSessionAuthMethodStart params:[[self newEventParameters] autorelease]];
 }
 
@@ -152,7 +223,20 @@ NSString *const FBSessionAuthLoggerParamEmptyValue = @"";
 }
 
 - (void)logEndAuthWithResult:(NSString *)result error:(NSError *)error {
+    [self logPhase:FBSessionAuthLoggerPhaseEnd];
     [self logEvent:FBAppEventNameFBSessionAuthEnd result:result error:error];
+
+    FBSessionLoginTimingHandler handler = nil;
+    @synchronized ([FBSessionAuthLogger class]) {
+        handler = [[_timingHandler retain] autorelease];
+    }
+    if (handler && self.phaseTimings.count > 0) {
+        NSString *authMethod = self.lastAuthMethod ?: FBSessionAuthLoggerParamEmptyValue;
+        NSDictionary *timings = [[self.phaseTimings copy] autorelease];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            handler(authMethod, result, timings);
+        });
+    }
 }
 
 - (NSMutableDictionary *)newEventParameters {
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBSessionPool.h"
+
+#import "FBSession.h"
+
+@interface FBSessionPool ()
+
+@property (nonatomic, retain) NSMutableDictionary *sessions;
+
+@end
+
+@implementation FBSessionPool
+
++ (FBSessionPool *)sharedPool {
+    static FBSessionPool *_instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBSessionPool alloc] init];
+    });
+    return _instance;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _sessions = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_sessions release];
+    [super dealloc];
+}
+
+- (NSArray *)keys {
+    @synchronized (self) {
+        return [self.sessions allKeys];
+    }
+}
+
+- (void)addSession:(FBSession *)session forKey:(NSString *)key {
+    FBSession *replaced = nil;
+    @synchronized (self) {
+        replaced = [[self.sessions[key] retain] autorelease];
+        self.sessions[key] = session;
+    }
+    if (replaced && replaced != session && ![self containsSession:replaced]) {
+        [self closeUnlessActive:replaced];
+    }
+}
+
+- (FBSession *)sessionForKey:(NSString *)key {
+    @synchronized (self) {
+        return [[self.sessions[key] retain] autorelease];
+    }
+}
+
+- (void)removeSessionForKey:(NSString *)key {
+    FBSession *removed = nil;
+    @synchronized (self) {
+        removed = [[self.sessions[key] retain] autorelease];
+        [self.sessions removeObjectForKey:key];
+    }
+    if (removed && ![self containsSession:removed]) {
+        [self closeUnlessActive:removed];
+    }
+}
+
+- (FBSession *)activateSessionForKey:(NSString *)key {
+    FBSession *session = [self sessionForKey:key];
+    if (session) {
+        [FBSession setActiveSession:session];
+    }
+    return session;
+}
+
+- (BOOL)containsSession:(FBSession *)session {
+    if (!session) {
+        return NO;
+    }
+    @synchronized (self) {
+        return [[self.sessions allValues] indexOfObjectIdenticalTo:session] != NSNotFound;
+    }
+}
+
+#pragma mark - Private
+
+- (void)closeUnlessActive:(FBSession *)session {
+    if (session != [FBSession activeSession]) {
+        [session close];
+    }
+}
+
+@end
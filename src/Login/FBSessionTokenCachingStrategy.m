@@ -16,7 +16,10 @@
 
 #import "FBSessionTokenCachingStrategy.h"
 
+#import <UIKit/UIKit.h>
+
 #import "FBAccessTokenData+Internal.h"
+#import "FBDispatch.h"
 
 // const strings
 static NSString *const FBAccessTokenInformationKeyName = @"FBAccessTokenInformationKey";
@@ -29,6 +32,13 @@ NSString *const FBTokenInformationIsFacebookLoginKey = @"com.facebook.sdk:TokenI
 NSString *const FBTokenInformationLoginTypeLoginKey = @"com.facebook.sdk:TokenInformationLoginTypeLoginKey";
 NSString *const FBTokenInformationPermissionsKey = @"com.facebook.sdk:TokenInformationPermissionsKey";
 NSString *const FBTokenInformationPermissionsRefreshDateKey = @"com.facebook.sdk:TokenInformationPermissionsRefreshDateKey";
+NSString *const FBTokenInformationCachedUserKey = @"com.facebook.sdk:TokenInformationCachedUserKey";
+
+@interface FBSessionTokenCachingStrategy ()
+
+- (NSString *)tokenInformationKeyName;
+
+@end
 
 #pragma mark - private FBSessionTokenCachingStrategyNoOpInstance class
 
@@ -49,9 +59,109 @@ NSString *const FBTokenInformationPermissionsRefreshDateKey = @"com.facebook.sdk
 
 @end
 
+#pragma mark - private FBSessionTokenCachingStrategyAsynchronousInstance class
+
+@interface FBSessionTokenCachingStrategyAsynchronousInstance : FBSessionTokenCachingStrategy
+
+- (void)saveTokenInformation;
+
+@end
+
+@implementation FBSessionTokenCachingStrategyAsynchronousInstance {
+    // Guarded by self.  _tokenInformation is what fetches return once _loaded is set,
+    // whether or not it has been saved yet.
+    NSDictionary *_tokenInformation;
+    BOOL _loaded;
+    BOOL _savePending;
+    dispatch_queue_t _saveQueue;
+}
+
+- (instancetype)initWithUserDefaultTokenInformationKeyName:(NSString *)tokenInformationKeyName {
+    self = [super initWithUserDefaultTokenInformationKeyName:tokenInformationKeyName];
+    if (self) {
+        _saveQueue = FBDispatchQueueCreateSerial("com.facebook.sdk.FBSessionTokenCachingStrategy", FBDispatchLaneUtility);
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(applicationDidEnterBackground:)
+                                                     name:UIApplicationDidEnterBackgroundNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    dispatch_release(_saveQueue);
+    [_tokenInformation release];
+    [super dealloc];
+}
+
+- (void)cacheTokenInformation:(NSDictionary *)tokenInformation {
+    NSDictionary *copy = [tokenInformation copy];
+    @synchronized(self) {
+        [_tokenInformation release];
+        _tokenInformation = copy;
+        _loaded = YES;
+        if (_savePending) {
+            // the save already scheduled will pick up this value
+            return;
+        }
+        _savePending = YES;
+    }
+    dispatch_async(_saveQueue, ^{
+        [self saveTokenInformation];
+    });
+}
+
+- (NSDictionary *)fetchTokenInformation {
+    @synchronized(self) {
+        if (!_loaded) {
+            _tokenInformation = [[super fetchTokenInformation] copy];
+            _loaded = YES;
+        }
+        return [[_tokenInformation retain] autorelease];
+    }
+}
+
+- (void)clearToken {
+    [self cacheTokenInformation:nil];
+}
+
+// Saves whatever the latest value is, so one save covers every write made while it waited
+- (void)saveTokenInformation {
+    NSDictionary *tokenInformation = nil;
+    @synchronized(self) {
+        if (!_savePending) {
+            return;
+        }
+        _savePending = NO;
+        tokenInformation = [[_tokenInformation retain] autorelease];
+    }
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    if (tokenInformation) {
+        [defaults setObject:tokenInformation forKey:[self tokenInformationKeyName]];
+    } else {
+        [defaults removeObjectForKey:[self tokenInformationKeyName]];
+    }
+    [defaults synchronize];
+}
+
+- (void)applicationDidEnterBackground:(NSNotification *)notification {
+    dispatch_sync(_saveQueue, ^{
+        [self saveTokenInformation];
+    });
+}
+
+@end
+
 
 @implementation FBSessionTokenCachingStrategy {
     NSString *_accessTokenInformationKeyName;
+    // The last token information fetched and the token built from it, guarded by self.
+    // User defaults hand back the same object until the value changes, so when a session
+    // is created again, as opening the active session at launch tends to do, the token
+    // comes from here instead of being validated and hydrated over again.
+    NSDictionary *_lastTokenInformation;
+    FBAccessTokenData *_lastTokenData;
 }
 
 #pragma mark - Lifecycle
@@ -75,9 +185,15 @@ NSString *const FBTokenInformationPermissionsRefreshDateKey = @"com.facebook.sdk
 - (void)dealloc {
     // let-em go
     [_accessTokenInformationKeyName release];
+    [_lastTokenInformation release];
+    [_lastTokenData release];
     [super dealloc];
 }
 
+- (NSString *)tokenInformationKeyName {
+    return _accessTokenInformationKeyName;
+}
+
 #pragma mark -
 #pragma mark Public Members
 
@@ -108,10 +224,22 @@ NSString *const FBTokenInformationPermissionsRefreshDateKey = @"com.facebook.sdk
 - (FBAccessTokenData *)fetchFBAccessTokenData {
     // For backwards compatibility, we must call into existing dictionary-based APIs.
     NSDictionary *dictionary = [self fetchTokenInformation];
+    @synchronized(self) {
+        if (dictionary && dictionary == _lastTokenInformation) {
+            // sessions update their token in place, so each gets its own copy
+            return [[_lastTokenData copy] autorelease];
+        }
+    }
     if (![FBSessionTokenCachingStrategy isValidTokenInformation:dictionary]) {
         return nil;
     }
     FBAccessTokenData *fbAccessToken = [FBAccessTokenData createTokenFromDictionary:dictionary];
+    @synchronized(self) {
+        [_lastTokenInformation release];
+        _lastTokenInformation = [dictionary retain];
+        [_lastTokenData release];
+        _lastTokenData = [fbAccessToken copy];
+    }
     return fbAccessToken;
 }
 
@@ -147,6 +275,12 @@ NSString *const FBTokenInformationPermissionsRefreshDateKey = @"com.facebook.sdk
     return noOpInstance;
 }
 
++ (FBSessionTokenCachingStrategy *)asynchronousCacheInstanceWithUserDefaultTokenInformationKeyName:(NSString *)tokenInformationKeyName {
+    return [[[FBSessionTokenCachingStrategyAsynchronousInstance alloc]
+             initWithUserDefaultTokenInformationKeyName:tokenInformationKeyName]
+            autorelease];
+}
+
 #pragma mark -
 
 @end
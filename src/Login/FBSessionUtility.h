@@ -30,6 +30,8 @@
 + (NSDate *)expirationDateFromResponseParams:(NSDictionary *)parameters;
 + (BOOL)areRequiredPermissions:(NSArray *)requiredPermissions
           aSubsetOfPermissions:(NSArray *)cachedPermissions;
++ (BOOL)areRequiredPermissions:(NSArray *)requiredPermissions
+       aSubsetOfPermissionsSet:(NSSet *)cachedPermissions;
 + (void)validateRequestForPermissions:(NSArray *)permissions
                       defaultAudience:(FBSessionDefaultAudience)defaultAudience
                    allowSystemAccount:(BOOL)allowSystemAccount
@@ -117,9 +117,22 @@
 
 + (BOOL)areRequiredPermissions:(NSArray *)requiredPermissions
           aSubsetOfPermissions:(NSArray *)cachedPermissions {
-    NSSet *required = [NSSet setWithArray:requiredPermissions];
-    NSSet *cached = [NSSet setWithArray:cachedPermissions];
-    return [required isSubsetOfSet:cached];
+    // sessions opened at launch usually ask for nothing beyond what was cached
+    if (requiredPermissions.count == 0) {
+        return YES;
+    }
+    return [self areRequiredPermissions:requiredPermissions
+                aSubsetOfPermissionsSet:[NSSet setWithArray:cachedPermissions]];
+}
+
++ (BOOL)areRequiredPermissions:(NSArray *)requiredPermissions
+       aSubsetOfPermissionsSet:(NSSet *)cachedPermissions {
+    for (NSString *permission in requiredPermissions) {
+        if (![cachedPermissions containsObject:permission]) {
+            return NO;
+        }
+    }
+    return YES;
 }
 
 
@@ -59,10 +59,20 @@ typedef void (^FBRequestAccessToAccountsHandler)(NSString *oauthToken, NSError *
 /*
  @abstract Sends a message to the device account store to renew the Facebook account credentials
 
+ @discussion Calls made while a renew is in flight wait for its result rather than starting
+ another, and calls made within a few seconds of one completing get its result right away.
+
  @param handler the handler that is invoked on completion (dispatched to the main thread).
  */
 - (void)renewSystemAuthorization:(void(^)(ACAccountCredentialRenewResult result, NSError *error))handler;
 
+/*
+ @abstract Does the slow parts of a system account login ahead of time: resolves the account
+ type and its access state and, if the next request would block on a renew, renews now.
+ Blocks on the account store, so call it off the main thread.
+ */
+- (void)prewarm;
+
 /*
  @abstract Gets the singleton instance.
  */
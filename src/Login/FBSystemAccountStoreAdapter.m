@@ -26,6 +26,11 @@
 
 @interface FBSystemAccountStoreAdapter () {
     BOOL _forceBlockingRenew;
+
+    // Handlers waiting on the renew call in flight, if there is one; guarded by @synchronized (self)
+    NSMutableArray *_pendingRenewHandlers;
+    // When a renew call last succeeded; cleared by one that doesn't
+    NSDate *_lastRenewDate;
 }
 
 @property (retain, nonatomic, readonly) ACAccountStore *accountStore;
@@ -34,6 +39,10 @@
 @end
 
 static NSString *const FBForceBlockingRenewKey = @"com.facebook.sdk:ForceBlockingRenewKey";
+// How long a successful renew is handed to later renew requests instead of asking the account
+// store again; a failed or rejected renew is never reused.  Token repair can ask many times in a burst, and each renew may be a
+// round trip to Facebook made by the system.
+static const NSTimeInterval FBRenewResultReuseSeconds = 10;
 static FBSystemAccountStoreAdapter *_singletonInstance = nil;
 
 @implementation FBSystemAccountStoreAdapter
@@ -51,6 +60,8 @@ static FBSystemAccountStoreAdapter *_singletonInstance = nil;
 - (void)dealloc {
     [_accountStore release];
     [_accountTypeFB release];
+    [_pendingRenewHandlers release];
+    [_lastRenewDate release];
     [super dealloc];
 }
 
@@ -63,8 +74,9 @@ static FBSystemAccountStoreAdapter *_singletonInstance = nil;
     if (_forceBlockingRenew!= forceBlockingRenew) {
         _forceBlockingRenew = forceBlockingRenew;
         NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
+        // no synchronize; the defaults are written out soon enough, and this is often set on
+        // the main thread from a renew completion
         [userDefaults setBool:forceBlockingRenew forKey:FBForceBlockingRenewKey];
-        [userDefaults synchronize];
     }
 }
 
@@ -254,6 +266,8 @@ static FBSystemAccountStoreAdapter *_singletonInstance = nil;
     }
 }
 
+// Concurrent renew requests share one renewCredentialsForAccount: call, and a request made
+// shortly after one completes gets its result; each handler is still called on the main thread.
 - (void)renewSystemAuthorization:(void(^)(ACAccountCredentialRenewResult, NSError *))handler {
     // if the slider has been set to off, renew calls to iOS simply hang, so we must
     // preemptively check for that condition.
@@ -263,6 +277,27 @@ static FBSystemAccountStoreAdapter *_singletonInstance = nil;
         if (fbAccounts && [fbAccounts count] > 0 &&
             (account = [fbAccounts objectAtIndex:0])) {
 
+            @synchronized (self) {
+                if (_lastRenewDate && -[_lastRenewDate timeIntervalSinceNow] < FBRenewResultReuseSeconds) {
+                    if (handler) {
+                        dispatch_async(dispatch_get_main_queue(), ^{
+                            handler(ACAccountCredentialRenewResultRenewed, nil);
+                        });
+                    }
+                    return;
+                }
+                if (_pendingRenewHandlers) {
+                    if (handler) {
+                        [_pendingRenewHandlers addObject:[[handler copy] autorelease]];
+                    }
+                    return;
+                }
+                _pendingRenewHandlers = [[NSMutableArray alloc] init];
+                if (handler) {
+                    [_pendingRenewHandlers addObject:[[handler copy] autorelease]];
+                }
+            }
+
             [self.accountStore renewCredentialsForAccount:account completion:^(ACAccountCredentialRenewResult renewResult, NSError *error) {
                 if (error) {
                     [FBLogger singleShotLogEntry:FBLoggingBehaviorAccessTokens
@@ -270,9 +305,18 @@ static FBSystemAccountStoreAdapter *_singletonInstance = nil;
                                                   (long)renewResult,
                                                   error]];
                 }
-                if (handler) {
+                NSArray *handlers = nil;
+                @synchronized (self) {
+                    handlers = [_pendingRenewHandlers autorelease];
+                    _pendingRenewHandlers = nil;
+                    [_lastRenewDate release];
+                    _lastRenewDate = (renewResult == ACAccountCredentialRenewResultRenewed && !error) ? [[NSDate alloc] init] : nil;
+                }
+                if (handlers.count > 0) {
                     dispatch_async(dispatch_get_main_queue(), ^{
-                        handler(renewResult, error);
+                        for (void(^pendingHandler)(ACAccountCredentialRenewResult, NSError *) in handlers) {
+                            pendingHandler(renewResult, error);
+                        }
                     });
                 }
             }];
@@ -303,6 +347,20 @@ static FBSystemAccountStoreAdapter *_singletonInstance = nil;
     }
 }
 
+- (void)prewarm {
+    if (![FBUtility isSystemAccountStoreAvailable] || !self.accountTypeFB.accessGranted) {
+        return;
+    }
+    if (self.forceBlockingRenew
+        && [self.accountStore accountsWithAccountType:self.accountTypeFB].count > 0) {
+        [self renewSystemAuthorization:^(ACAccountCredentialRenewResult result, NSError *error) {
+            if (result == ACAccountCredentialRenewResultRenewed) {
+                self.forceBlockingRenew = NO;
+            }
+        }];
+    }
+}
+
 - (FBTask *)renewSystemAuthorizationAsTask {
     FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
     [self renewSystemAuthorization:^(ACAccountCredentialRenewResult result, NSError *error) {
@@ -23,6 +23,8 @@
 #import "FBSession+Internal.h"
 #import "FBRequest.h"
 #import <pthread.h>
+#import <signal.h>
+#import <sys/errno.h>
 #import "FBGraphUser.h"
 #import "FBUtility.h"
 
@@ -43,6 +45,7 @@ static NSString *const FBPLISTTestAppIDKey = @"IOS_SDK_TEST_APP_ID";
 static NSString *const FBPLISTTestAppSecretKey = @"IOS_SDK_TEST_APP_SECRET";
 static NSString *const FBPLISTTestAppClientToken = @"IOS_SDK_TEST_CLIENT_TOKEN";
 static NSString *const FBPLISTUniqueUserTagKey = @"IOS_SDK_MACHINE_UNIQUE_USER_KEY";
+static NSString *const FBPLISTTestUserPoolDirectoryKey = @"IOS_SDK_TEST_USER_POOL_DIRECTORY";
 static NSString *const FBLoginAuthTestUserCreatePathFormat = @"%@/accounts/test-users";
 static NSString *const FBLoginTestUserAccessToken = @"access_token";
 static NSString *const FBLoginTestUserID = @"id";
@@ -53,11 +56,120 @@ NSString *kThirdTestUserTag = @"Third";
 
 NSString *const FBErrorLoginFailedReasonUnitTestResponseUnrecognized = @"com.facebook.sdk:UnitTestResponseUnrecognized";
 
+// The test users listed for the app are kept on disk, so later runs can skip listing them
+// again, for this long
+static const NSTimeInterval kTestUserPoolMaxAge = 24 * 60 * 60;
+static NSString *const kTestUserPoolFileName = @"users.plist";
+static NSString *const kTestUserPoolUsersKey = @"users";
+static NSString *const kTestUserPoolTimestampKey = @"timestamp";
+static NSString *const kTestUserLeaseExtension = @"lease";
+
 #pragma mark Module scoped global variables
 
+// Guarded by mutex
 static NSMutableDictionary *testUsers = nil;
+static NSDate *testUsersTimestamp = nil;
+static NSMutableSet *leasedTestUserIDs = nil;
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
+#pragma mark Test user pool
+
+// Where the pool and its leases live.  Simulators each have their own caches, so test
+// runs on several at once should point IOS_SDK_TEST_USER_POOL_DIRECTORY at a directory
+// they share.
+static NSString *FBTestUserPoolDirectory(NSString *appID) {
+    NSString *root = [[[NSProcessInfo processInfo] environment] objectForKey:FBPLISTTestUserPoolDirectoryKey];
+    if (!root.length) {
+        NSString *caches = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
+        root = [caches stringByAppendingPathComponent:@"com.facebook.sdk.FBTestSession"];
+    }
+    NSString *directory = [root stringByAppendingPathComponent:appID];
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:nil];
+    return directory;
+}
+
+// Called with mutex held.  Returns NO if there is no pool, or it is too old to trust.
+static BOOL FBTestUserPoolLoad(NSString *appID) {
+    NSString *path = [FBTestUserPoolDirectory(appID) stringByAppendingPathComponent:kTestUserPoolFileName];
+    NSDictionary *pool = [NSDictionary dictionaryWithContentsOfFile:path];
+    NSDate *timestamp = pool[kTestUserPoolTimestampKey];
+    NSDictionary *users = pool[kTestUserPoolUsersKey];
+    if (![timestamp isKindOfClass:[NSDate class]] ||
+        ![users isKindOfClass:[NSDictionary class]] ||
+        -[timestamp timeIntervalSinceNow] > kTestUserPoolMaxAge) {
+        return NO;
+    }
+
+    for (NSString *userID in users) {
+        testUsers[userID] = [NSMutableDictionary dictionaryWithDictionary:users[userID]];
+    }
+    [testUsersTimestamp release];
+    testUsersTimestamp = [timestamp retain];
+    return YES;
+}
+
+// Called with mutex held.  Users created since the app's test users were listed keep the
+// listing's timestamp, so the pool is still listed afresh once a day.
+static void FBTestUserPoolSave(NSString *appID) {
+    if (!testUsersTimestamp) {
+        testUsersTimestamp = [[NSDate date] retain];
+    }
+    NSString *path = [FBTestUserPoolDirectory(appID) stringByAppendingPathComponent:kTestUserPoolFileName];
+    [@{kTestUserPoolUsersKey : testUsers, kTestUserPoolTimestampKey : testUsersTimestamp} writeToFile:path
+                                                                                           atomically:YES];
+}
+
+// Called with mutex held.  A shared user is only handed to one session at a time, so test
+// classes can run concurrently, in one process or several, without stepping on each
+// other's users.  Leases left behind by a process that has gone away are taken over.
+static BOOL FBTestUserLeaseAcquire(NSString *appID, NSString *userID) {
+    if ([leasedTestUserIDs containsObject:userID]) {
+        return NO;
+    }
+
+    NSString *path = [[FBTestUserPoolDirectory(appID) stringByAppendingPathComponent:userID]
+                      stringByAppendingPathExtension:kTestUserLeaseExtension];
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int fd = open(path.fileSystemRepresentation, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0) {
+            char pid[16];
+            int length = snprintf(pid, sizeof(pid), "%d", (int)getpid());
+            write(fd, pid, length);
+            close(fd);
+            if (!leasedTestUserIDs) {
+                leasedTestUserIDs = [[NSMutableSet alloc] init];
+            }
+            [leasedTestUserIDs addObject:userID];
+            return YES;
+        }
+        if (errno != EEXIST) {
+            return NO;
+        }
+
+        NSString *owner = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:nil];
+        pid_t ownerPID = (pid_t)[owner intValue];
+        if (ownerPID > 0 && (kill(ownerPID, 0) == 0 || errno != ESRCH)) {
+            return NO;
+        }
+        unlink(path.fileSystemRepresentation);
+    }
+    return NO;
+}
+
+// Called with mutex held
+static void FBTestUserLeaseRelease(NSString *appID, NSString *userID) {
+    if (![leasedTestUserIDs containsObject:userID]) {
+        return;
+    }
+    [leasedTestUserIDs removeObject:userID];
+    NSString *path = [[FBTestUserPoolDirectory(appID) stringByAppendingPathComponent:userID]
+                      stringByAppendingPathExtension:kTestUserLeaseExtension];
+    unlink(path.fileSystemRepresentation);
+}
+
 #pragma mark -
 
 #pragma mark Private interface
@@ -77,6 +189,8 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 @property (readonly, copy) NSString *permissionsString;
 @property (readonly, copy) NSString *sharedTestUserIdentifier;
 @property (readwrite) FBTestSessionMode mode;
+// The shared user this session holds the lease on, if any
+@property (readwrite, copy) NSString *leasedTestUserID;
 
 @property (readwrite) BOOL forceAccessTokenRefresh;
 @property (readwrite, copy) NSString *testAppClientToken;
@@ -122,6 +236,8 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
     [_testAppSecret release];
     [_machineUniqueUserTag release];
     [_sessionUniqueUserTag release];
+    [self releaseLeasedTestUser];
+    [_leasedTestUserID release];
 
     [super dealloc];
 }
@@ -186,7 +302,11 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
                  pthread_mutex_lock(&mutex);
 
-                 [testUsers setObject:user forKey:userID];
+                 [testUsers setObject:[NSMutableDictionary dictionaryWithDictionary:user] forKey:userID];
+                 if (FBTestUserLeaseAcquire(self.appID, userID)) {
+                     self.leasedTestUserID = userID;
+                 }
+                 FBTestUserPoolSave(self.appID);
 
                  pthread_mutex_unlock(&mutex);
              }
@@ -257,6 +377,10 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
         testUser[FBLoginTestUserName] = users[uid][FBLoginTestUserName];
     }
 
+    [testUsersTimestamp release];
+    testUsersTimestamp = [[NSDate date] retain];
+    FBTestUserPoolSave(self.appID);
+
     pthread_mutex_unlock(&mutex);
 }
 
@@ -340,9 +464,12 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
     id matchingTestUser = nil;
     for (id testUser in [testUsers allValues]) {
         NSString *userName = [testUser objectForKey:FBLoginTestUserName];
+        NSString *userID = [[testUser objectForKey:FBLoginTestUserID] description];
         // Does this user have the right permissions and is it not in use?
-        if ([userName rangeOfString:userIdentifier].length > 0) {
-            matchingTestUser = testUser;
+        if ([userName rangeOfString:userIdentifier].length > 0 &&
+            FBTestUserLeaseAcquire(self.appID, userID)) {
+            matchingTestUser = [[testUser retain] autorelease];
+            self.leasedTestUserID = userID;
             break;
         }
     }
@@ -361,6 +488,17 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
     }
 }
 
+- (void)releaseLeasedTestUser
+{
+    if (!self.leasedTestUserID) {
+        return;
+    }
+    pthread_mutex_lock(&mutex);
+    FBTestUserLeaseRelease(self.appID, self.leasedTestUserID);
+    pthread_mutex_unlock(&mutex);
+    self.leasedTestUserID = nil;
+}
+
 - (void)setForceAccessTokenRefresh:(BOOL)forceAccessTokenRefresh {
     _forceAccessTokenRefresh = forceAccessTokenRefresh;
 }
@@ -385,6 +523,9 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
     if (didTransition && FB_ISSESSIONSTATETERMINAL(self.state)) {
         if (self.mode == FBTestSessionModePrivate) {
             [FBTestSession deleteUnitTestUser:userID accessToken:self.appAccessToken];
+        } else {
+            // Free for the next session that wants a user with these permissions
+            [self releaseLeasedTestUser];
         }
     }
 
@@ -411,7 +552,7 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
         } else {
             // We need to see if there are any test users that fit the bill.
 
-            // Did we already get the test users?
+            // Did we already get the test users, in this run or a recent one?
             pthread_mutex_lock(&mutex);
             if (testUsers) {
                 pthread_mutex_unlock(&mutex);
@@ -419,13 +560,18 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
                 // Yes, look for one that we can use.
                 [self findOrCreateSharedUser];
             } else {
-                // No, populate the list and then continue.
                 // We never release testUsers. We should only populate it once.
                 testUsers = [[NSMutableDictionary alloc] init];
+                BOOL loaded = FBTestUserPoolLoad(self.appID);
 
                 pthread_mutex_unlock(&mutex);
 
-                [self retrieveTestUsersForApp];
+                if (loaded) {
+                    [self findOrCreateSharedUser];
+                } else {
+                    // No, populate the list and then continue.
+                    [self retrieveTestUsersForApp];
+                }
             }
         }
     }
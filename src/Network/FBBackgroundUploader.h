@@ -0,0 +1,85 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+#import "FBSDKMacros.h"
+
+// What an upload carries, which decides how an earlier run's upload is reconciled
+FBSDK_EXTERN NSString *const FBBackgroundUploadKindAppEvents;
+FBSDK_EXTERN NSString *const FBBackgroundUploadKindMedia;
+
+typedef void (^FBBackgroundUploadHandler)(NSURLResponse *response, NSData *data, NSError *error);
+// Gets the result of an upload started by an earlier run of the app, along with
+// the context it was started with.  error is set for a non-2xx response too.
+typedef void (^FBBackgroundUploadReconciler)(NSDictionary *context, NSURLResponse *response, NSData *data, NSError *error);
+
+// Sends requests through a background NSURLSession, so that the system finishes
+// them while the app is suspended, or even after it has been terminated.
+//
+// The body is written to a file first, since that is all a background session
+// uploads from, and each upload is recorded in a manifest on disk along with its
+// kind and a property list context.  An upload that completes while the run that
+// started it is still alive goes to its handler.  One that outlives that run is
+// handed to the reconciler for its kind once the session is reconnected at the
+// next launch; results wait for a reconciler to be set.  Media uploads are
+// reconciled by posting FBRequestConnectionBackgroundUploadDidFinishNotification.
+//
+// Everything here is called, and calls back, on the main thread.
+@interface FBBackgroundUploader : NSObject <NSURLSessionDataDelegate>
+{
+@private
+    NSURLSession *_session;
+    NSString *_directory;
+    dispatch_queue_t _fileQueue;
+    // Every upload not yet completed, by upload identifier; mirrors the manifest file
+    NSMutableDictionary *_manifest;
+    // Handlers of uploads started by this run, by upload identifier
+    NSMutableDictionary *_handlers;
+    // Response bodies received so far, by upload identifier
+    NSMutableDictionary *_responseData;
+    NSMutableDictionary *_reconcilers;
+    // Results of earlier runs' uploads whose kind has no reconciler yet
+    NSMutableArray *_unreconciledResults;
+    void (^_backgroundEventsCompletionHandler)(void);
+}
+
+// NO before iOS 7, or unless enabled with [FBSettings enableBackgroundUploads:]
++ (BOOL)isAvailable;
++ (FBBackgroundUploader *)sharedUploader;
+
+// Starts uploading the request and returns an identifier to cancel it with.
+// context must be a property list.
+- (NSString *)uploadRequest:(NSURLRequest *)request
+                       kind:(NSString *)kind
+                    context:(NSDictionary *)context
+          completionHandler:(FBBackgroundUploadHandler)handler;
+
+// Stops the upload, calling its handler with an FBErrorOperationCancelled error.
+- (void)cancelUpload:(NSString *)uploadIdentifier;
+
+// Contexts of the uploads of kind that earlier runs started and that haven't
+// been reconciled yet.
+- (NSArray *)pendingContextsForKind:(NSString *)kind;
+
+- (void)setReconciler:(FBBackgroundUploadReconciler)reconciler forKind:(NSString *)kind;
+
+// Returns NO if the session isn't the SDK's.
+- (BOOL)handleEventsForBackgroundURLSession:(NSString *)identifier
+                          completionHandler:(void (^)(void))completionHandler;
+
+@end
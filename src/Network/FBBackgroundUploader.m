@@ -0,0 +1,459 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBBackgroundUploader.h"
+
+#import <UIKit/UIKit.h>
+
+#import "FBDispatch.h"
+#import "FBError.h"
+#import "FBRequestConnection.h"
+#import "FBSettings.h"
+#import "FBUtility.h"
+
+NSString *const FBBackgroundUploadKindAppEvents = @"appEvents";
+NSString *const FBBackgroundUploadKindMedia = @"media";
+
+static NSString *const kSessionIdentifier = @"com.facebook.sdk.FBBackgroundUploader";
+static NSString *const kDirectoryName = @"com.facebook.sdk.FBBackgroundUploader";
+static NSString *const kManifestFileName = @"manifest.plist";
+
+static NSString *const kEntryKindKey = @"kind";
+static NSString *const kEntryContextKey = @"context";
+static NSString *const kEntryFileNameKey = @"fileName";
+
+static NSString *const kResultEntryKey = @"entry";
+static NSString *const kResultResponseKey = @"response";
+static NSString *const kResultDataKey = @"data";
+static NSString *const kResultErrorKey = @"error";
+
+// Bodies are copied to their file this much at a time
+static const NSUInteger kBodyCopyChunkLength = 64 * 1024;
+
+// Writes the request's body, whether data or a stream, to path.  Bodies can hold what the
+// user posted, so they are protected, though only until first unlock: the upload daemon
+// has to read them while the device is locked, as it is once the app is suspended.
+static BOOL FBBackgroundUploaderWriteBody(NSURLRequest *request, NSString *path)
+{
+    if (request.HTTPBody) {
+        return [request.HTTPBody writeToFile:path options:NSDataWritingFileProtectionCompleteUntilFirstUserAuthentication error:nil];
+    }
+
+    NSInputStream *input = request.HTTPBodyStream;
+    if (!input ||
+        ![[NSFileManager defaultManager] createFileAtPath:path
+                                                 contents:nil
+                                               attributes:@{NSFileProtectionKey : NSFileProtectionCompleteUntilFirstUserAuthentication}]) {
+        return NO;
+    }
+    NSOutputStream *output = [NSOutputStream outputStreamToFileAtPath:path append:NO];
+    if (!output) {
+        return NO;
+    }
+
+    BOOL succeeded = YES;
+    uint8_t *buffer = malloc(kBodyCopyChunkLength);
+    [input open];
+    [output open];
+    while (succeeded) {
+        NSInteger length = [input read:buffer maxLength:kBodyCopyChunkLength];
+        if (length <= 0) {
+            succeeded = (length == 0);
+            break;
+        }
+        NSInteger offset = 0;
+        while (offset < length) {
+            NSInteger written = [output write:buffer + offset maxLength:(NSUInteger)(length - offset)];
+            if (written <= 0) {
+                succeeded = NO;
+                break;
+            }
+            offset += written;
+        }
+    }
+    [input close];
+    [output close];
+    free(buffer);
+    return succeeded;
+}
+
+// A non-2xx response is a failure too, as far as reconcilers are concerned
+static NSError *FBBackgroundUploaderResultError(NSURLResponse *response, NSError *error)
+{
+    if (error || ![response isKindOfClass:[NSHTTPURLResponse class]]) {
+        return error;
+    }
+
+    NSInteger statusCode = ((NSHTTPURLResponse *)response).statusCode;
+    if (statusCode >= 200 && statusCode < 300) {
+        return nil;
+    }
+    return [NSError errorWithDomain:FacebookSDKDomain
+                               code:FBErrorHTTPError
+                           userInfo:@{FBErrorHTTPStatusCodeKey : @(statusCode)}];
+}
+
+@implementation FBBackgroundUploader
+
+#pragma mark - Lifecycle
+
++ (BOOL)isAvailable
+{
+    return [FBSettings isBackgroundUploadsEnabled] && [NSURLSession class] != nil;
+}
+
++ (FBBackgroundUploader *)sharedUploader
+{
+    static FBBackgroundUploader *_instance;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBBackgroundUploader alloc] init];
+    });
+
+    return _instance;
+}
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        NSArray *libraryList = NSSearchPathForDirectoriesInDomains(NSLibraryDirectory, NSUserDomainMask, YES);
+        _directory = [[[libraryList objectAtIndex:0] stringByAppendingPathComponent:kDirectoryName] copy];
+        [[NSFileManager defaultManager] createDirectoryAtPath:_directory
+                                  withIntermediateDirectories:YES
+                                                   attributes:@{NSFileProtectionKey : NSFileProtectionCompleteUntilFirstUserAuthentication}
+                                                        error:nil];
+        _fileQueue = FBDispatchQueueCreateSerial("com.facebook.sdk.FBBackgroundUploader", FBDispatchLaneUtility);
+
+        // Small, and needed straight away to answer pendingContextsForKind:
+        NSDictionary *manifest = [NSDictionary dictionaryWithContentsOfFile:[self manifestPath]];
+        _manifest = manifest ? [manifest mutableCopy] : [[NSMutableDictionary alloc] init];
+        _handlers = [[NSMutableDictionary alloc] init];
+        _responseData = [[NSMutableDictionary alloc] init];
+        _reconcilers = [[NSMutableDictionary alloc] init];
+        _unreconciledResults = [[NSMutableArray alloc] init];
+
+        __block FBBackgroundUploader *uploader = self;
+        [self setReconciler:^(NSDictionary *context, NSURLResponse *response, NSData *data, NSError *error) {
+            [uploader postMediaUploadNotificationWithContext:context error:error];
+        } forKind:FBBackgroundUploadKindMedia];
+
+        NSURLSessionConfiguration *configuration;
+        if ([NSURLSessionConfiguration respondsToSelector:@selector(backgroundSessionConfigurationWithIdentifier:)]) {
+            configuration = [NSURLSessionConfiguration backgroundSessionConfigurationWithIdentifier:kSessionIdentifier];
+        } else {
+            configuration = [NSURLSessionConfiguration backgroundSessionConfiguration:kSessionIdentifier];
+        }
+
+        // Recreating the session reconnects to tasks an earlier run started.  The
+        // session keeps a strong reference to us, which is fine for a singleton.
+        _session = [[NSURLSession sessionWithConfiguration:configuration
+                                                  delegate:self
+                                             delegateQueue:[NSOperationQueue mainQueue]] retain];
+
+        // Completions of tasks that finished while the app wasn't running are
+        // queued ahead of this, so whatever is neither running nor completed by
+        // then was lost, for instance when the user force quit the app.
+        [_session getTasksWithCompletionHandler:^(NSArray *dataTasks, NSArray *uploadTasks, NSArray *downloadTasks) {
+            NSMutableSet *running = [NSMutableSet set];
+            for (NSURLSessionTask *task in uploadTasks) {
+                if (task.taskDescription) {
+                    [running addObject:task.taskDescription];
+                }
+            }
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self failLostUploadsExcept:running];
+            });
+        }];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_session invalidateAndCancel];
+    [_session release];
+    [_directory release];
+    dispatch_release(_fileQueue);
+    [_manifest release];
+    [_handlers release];
+    [_responseData release];
+    [_reconcilers release];
+    [_unreconciledResults release];
+    [_backgroundEventsCompletionHandler release];
+    [super dealloc];
+}
+
+#pragma mark - Public
+
+- (NSString *)uploadRequest:(NSURLRequest *)request
+                       kind:(NSString *)kind
+                    context:(NSDictionary *)context
+          completionHandler:(FBBackgroundUploadHandler)handler
+{
+    NSString *uploadIdentifier = [[FBUtility newUUIDString] autorelease];
+    NSString *fileName = [uploadIdentifier stringByAppendingPathExtension:@"body"];
+    NSString *path = [_directory stringByAppendingPathComponent:fileName];
+
+    [_manifest setObject:@{kEntryKindKey : kind,
+                           kEntryContextKey : context ?: @{},
+                           kEntryFileNameKey : fileName}
+                  forKey:uploadIdentifier];
+    [self saveManifest];
+    FBBackgroundUploadHandler handlerCopy = [handler copy];
+    [_handlers setObject:handlerCopy forKey:uploadIdentifier];
+    [handlerCopy release];
+
+    // The system takes over once the task exists; until then, the app is kept
+    // running long enough to write the body out
+    UIApplication *application = [UIApplication sharedApplication];
+    __block UIBackgroundTaskIdentifier backgroundTask = [application beginBackgroundTaskWithExpirationHandler:^{
+        [application endBackgroundTask:backgroundTask];
+        backgroundTask = UIBackgroundTaskInvalid;
+    }];
+
+    NSMutableURLRequest *uploadRequest = [[request mutableCopy] autorelease];
+    dispatch_async(_fileQueue, ^{
+        BOOL written = FBBackgroundUploaderWriteBody(uploadRequest, path);
+        uploadRequest.HTTPBody = nil;
+        uploadRequest.HTTPBodyStream = nil;
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (!written) {
+                [self finishUpload:uploadIdentifier
+                          response:nil
+                             error:[NSError errorWithDomain:NSCocoaErrorDomain
+                                                       code:NSFileWriteUnknownError
+                                                   userInfo:nil]];
+            } else if ([_manifest objectForKey:uploadIdentifier]) {
+                NSURLSessionUploadTask *task = [_session uploadTaskWithRequest:uploadRequest
+                                                                      fromFile:[NSURL fileURLWithPath:path]];
+                // Survives a relaunch, unlike the task identifier's meaning
+                task.taskDescription = uploadIdentifier;
+                [task resume];
+            }
+
+            if (backgroundTask != UIBackgroundTaskInvalid) {
+                [application endBackgroundTask:backgroundTask];
+                backgroundTask = UIBackgroundTaskInvalid;
+            }
+        });
+    });
+
+    return uploadIdentifier;
+}
+
+- (void)cancelUpload:(NSString *)uploadIdentifier
+{
+    if (![_manifest objectForKey:uploadIdentifier]) {
+        return;
+    }
+
+    [_session getTasksWithCompletionHandler:^(NSArray *dataTasks, NSArray *uploadTasks, NSArray *downloadTasks) {
+        for (NSURLSessionTask *task in uploadTasks) {
+            if ([task.taskDescription isEqualToString:uploadIdentifier]) {
+                [task cancel];
+            }
+        }
+    }];
+
+    [self finishUpload:uploadIdentifier
+              response:nil
+                 error:[NSError errorWithDomain:FacebookSDKDomain
+                                           code:FBErrorOperationCancelled
+                                       userInfo:nil]];
+}
+
+- (NSArray *)pendingContextsForKind:(NSString *)kind
+{
+    NSMutableArray *contexts = [NSMutableArray array];
+    [_manifest enumerateKeysAndObjectsUsingBlock:^(NSString *uploadIdentifier, NSDictionary *entry, BOOL *stop) {
+        if (![_handlers objectForKey:uploadIdentifier] &&
+            [[entry objectForKey:kEntryKindKey] isEqualToString:kind]) {
+            [contexts addObject:[entry objectForKey:kEntryContextKey]];
+        }
+    }];
+    for (NSDictionary *result in _unreconciledResults) {
+        NSDictionary *entry = [result objectForKey:kResultEntryKey];
+        if ([[entry objectForKey:kEntryKindKey] isEqualToString:kind]) {
+            [contexts addObject:[entry objectForKey:kEntryContextKey]];
+        }
+    }
+    return contexts;
+}
+
+- (void)setReconciler:(FBBackgroundUploadReconciler)reconciler forKind:(NSString *)kind
+{
+    FBBackgroundUploadReconciler reconcilerCopy = [reconciler copy];
+    [_reconcilers setObject:reconcilerCopy forKey:kind];
+    [reconcilerCopy release];
+
+    NSArray *results = [[_unreconciledResults copy] autorelease];
+    for (NSDictionary *result in results) {
+        NSDictionary *entry = [result objectForKey:kResultEntryKey];
+        if ([[entry objectForKey:kEntryKindKey] isEqualToString:kind]) {
+            [_unreconciledResults removeObjectIdenticalTo:result];
+            reconciler([entry objectForKey:kEntryContextKey],
+                       [result objectForKey:kResultResponseKey],
+                       [result objectForKey:kResultDataKey],
+                       [result objectForKey:kResultErrorKey]);
+        }
+    }
+}
+
+- (BOOL)handleEventsForBackgroundURLSession:(NSString *)identifier
+                          completionHandler:(void (^)(void))completionHandler
+{
+    if (![identifier isEqualToString:kSessionIdentifier]) {
+        return NO;
+    }
+
+    [_backgroundEventsCompletionHandler release];
+    _backgroundEventsCompletionHandler = [completionHandler copy];
+    return YES;
+}
+
+#pragma mark - Private
+
+- (NSString *)manifestPath
+{
+    return [_directory stringByAppendingPathComponent:kManifestFileName];
+}
+
+- (void)saveManifest
+{
+    NSDictionary *manifest = [[_manifest copy] autorelease];
+    NSString *path = [self manifestPath];
+    dispatch_async(_fileQueue, ^{
+        [manifest writeToFile:path atomically:YES];
+    });
+}
+
+// Removes the upload and its body, and hands its result to its handler, or
+// failing that to the reconciler for its kind.
+- (void)finishUpload:(NSString *)uploadIdentifier
+            response:(NSURLResponse *)response
+               error:(NSError *)error
+{
+    NSDictionary *entry = [[[_manifest objectForKey:uploadIdentifier] retain] autorelease];
+    if (!entry) {
+        return;
+    }
+    [_manifest removeObjectForKey:uploadIdentifier];
+    [self saveManifest];
+
+    NSString *path = [_directory stringByAppendingPathComponent:[entry objectForKey:kEntryFileNameKey]];
+    dispatch_async(_fileQueue, ^{
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    });
+
+    NSData *data = [[[_responseData objectForKey:uploadIdentifier] copy] autorelease];
+    [_responseData removeObjectForKey:uploadIdentifier];
+
+    FBBackgroundUploadHandler handler = [[[_handlers objectForKey:uploadIdentifier] retain] autorelease];
+    [_handlers removeObjectForKey:uploadIdentifier];
+    if (handler) {
+        handler(response, data, error);
+        return;
+    }
+
+    NSError *resultError = FBBackgroundUploaderResultError(response, error);
+    FBBackgroundUploadReconciler reconciler = [_reconcilers objectForKey:[entry objectForKey:kEntryKindKey]];
+    if (reconciler) {
+        reconciler([entry objectForKey:kEntryContextKey], response, data, resultError);
+        return;
+    }
+
+    NSMutableDictionary *result = [NSMutableDictionary dictionaryWithObject:entry forKey:kResultEntryKey];
+    if (response) {
+        [result setObject:response forKey:kResultResponseKey];
+    }
+    if (data) {
+        [result setObject:data forKey:kResultDataKey];
+    }
+    if (resultError) {
+        [result setObject:resultError forKey:kResultErrorKey];
+    }
+    [_unreconciledResults addObject:result];
+}
+
+- (void)failLostUploadsExcept:(NSSet *)runningUploadIdentifiers
+{
+    NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+    for (NSString *uploadIdentifier in [_manifest allKeys]) {
+        // This run's own uploads may just not have a task yet
+        if (![_handlers objectForKey:uploadIdentifier] &&
+            ![runningUploadIdentifiers containsObject:uploadIdentifier]) {
+            [self finishUpload:uploadIdentifier response:nil error:error];
+        }
+    }
+}
+
+- (void)postMediaUploadNotificationWithContext:(NSDictionary *)context error:(NSError *)error
+{
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
+    NSArray *graphPaths = [context objectForKey:FBRequestConnectionBackgroundUploadGraphPathsKey];
+    if (graphPaths) {
+        [userInfo setObject:graphPaths forKey:FBRequestConnectionBackgroundUploadGraphPathsKey];
+    }
+    if (error) {
+        [userInfo setObject:error forKey:FBRequestConnectionBackgroundUploadErrorKey];
+    }
+    [[NSNotificationCenter defaultCenter] postNotificationName:FBRequestConnectionBackgroundUploadDidFinishNotification
+                                                        object:nil
+                                                      userInfo:userInfo];
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+    didReceiveData:(NSData *)data
+{
+    NSString *uploadIdentifier = dataTask.taskDescription;
+    if (!uploadIdentifier || ![_manifest objectForKey:uploadIdentifier]) {
+        return;
+    }
+
+    NSMutableData *responseData = [_responseData objectForKey:uploadIdentifier];
+    if (!responseData) {
+        responseData = [NSMutableData data];
+        [_responseData setObject:responseData forKey:uploadIdentifier];
+    }
+    [responseData appendData:data];
+}
+
+- (void)URLSession:(NSURLSession *)session
+              task:(NSURLSessionTask *)task
+didCompleteWithError:(NSError *)error
+{
+    if (task.taskDescription) {
+        [self finishUpload:task.taskDescription response:task.response error:error];
+    }
+}
+
+- (void)URLSessionDidFinishEventsForBackgroundURLSession:(NSURLSession *)session
+{
+    void (^completionHandler)(void) = _backgroundEventsCompletionHandler;
+    _backgroundEventsCompletionHandler = nil;
+    if (completionHandler) {
+        completionHandler();
+        [completionHandler release];
+    }
+}
+
+@end
@@ -18,6 +18,7 @@
 
 #import <objc/runtime.h>
 
+#import "FBDispatch.h"
 #import "FBOpenGraphActionShareDialogParams.h"
 #import "FBOpenGraphObject.h"
 
@@ -41,6 +42,10 @@
 // * The system passes the invocation to forwardInvocation:
 // * We swap out selectors and invoke
 //
+// Before any of that, the runtime offers resolveInstanceMethod:, where we add a real
+// method for the selector, so each accessor only goes through inference once per class;
+// forwarding remains the fallback should adding the method fail.
+//
 // Additional details include, deferred wrapping of objects as they are fetched by callers,
 // implementations for common methods such as respondsToSelector and conformsToProtocol, as
 // suggested in the previously referenced documentation
@@ -52,13 +57,53 @@ typedef enum _SelectorInferredImplType {
     SelectorInferredImplTypeSet = 2
 } SelectorInferredImplType;
 
+// Inferability of each protocol asked about, keyed by the Protocol pointer with
+// the low bit set when FBGraphObject adoption was checked too.  Reads run
+// concurrently; writes go through as barriers.
+static CFMutableDictionaryRef g_protocolInferabilityCache = NULL;
+static dispatch_queue_t g_protocolInferabilityQueue = NULL;
+
+// Fields derived from each protocol asked about, keyed by protocol name
+static NSMutableDictionary *g_protocolFieldsCache = nil;
+
+// Adds the fields behind protocol's properties, and those of the protocols it
+// adopts, stopping at FBGraphObject and NSObject
+static void FBGraphObjectAddFieldsForProtocol(Protocol *protocol, NSMutableSet *fields)
+{
+    if (protocol_isEqual(protocol, @protocol(FBGraphObject)) ||
+        protocol_isEqual(protocol, @protocol(NSObject))) {
+        return;
+    }
+
+    unsigned int count = 0;
+    objc_property_t *properties = protocol_copyPropertyList(protocol, &count);
+    for (unsigned int i = 0; i < count; i++) {
+        NSString *name = [NSString stringWithUTF8String:property_getName(properties[i])];
+        if ([name isEqualToString:@"objectID"]) {
+            name = @"id";
+        } else if ([name isEqualToString:@"objectDescription"]) {
+            name = @"description";
+        }
+        [fields addObject:name];
+    }
+    free(properties);
+
+    Protocol **adopted = protocol_copyProtocolList(protocol, &count);
+    for (unsigned int i = 0; i < count; i++) {
+        FBGraphObjectAddFieldsForProtocol(adopted[i], fields);
+    }
+    free(adopted);
+}
+
 
 // internal-only wrapper
 @interface FBGraphObjectArray : NSMutableArray
 
 - (instancetype)initWrappingArray:(NSArray *)otherArray;
+- (instancetype)initWrappingArray:(NSArray *)otherArray readOnly:(BOOL)readOnly;
 - (id)graphObjectifyAtIndex:(NSUInteger)index;
 - (void)graphObjectifyAll;
+- (NSMutableArray *)mutableJSONArray;
 
 @end
 
@@ -66,25 +111,40 @@ typedef enum _SelectorInferredImplType {
 @interface FBGraphObject ()
 
 - (instancetype)initWrappingDictionary:(NSDictionary *)otherDictionary;
+- (instancetype)initWrappingDictionary:(NSDictionary *)otherDictionary readOnly:(BOOL)readOnly;
 - (void)graphObjectifyAll;
 - (id)graphObjectifyAtKey:(id)key;
+- (NSMutableDictionary *)mutableJSONObject;
 
 + (instancetype)graphObjectWrappingObject:(id)originalObject;
++ (id)graphObjectWrappingObject:(id)originalObject readOnly:(BOOL)readOnly;
++ (void)raiseReadOnlyMutation:(SEL)sel;
 + (SelectorInferredImplType)inferredImplTypeForSelector:(SEL)sel;
 + (BOOL)isProtocolImplementationInferable:(Protocol *)protocol checkFBGraphObjectAdoption:(BOOL)checkAdoption;
++ (BOOL)uncachedIsProtocolImplementationInferable:(Protocol *)protocol checkFBGraphObjectAdoption:(BOOL)checkAdoption;
 
 @end
 
 @implementation FBGraphObject {
+    // when _readOnly is set this is the caller's (possibly immutable) dictionary,
+    // retained rather than copied, and never mutated; when _sharesStorage is set it
+    // is an immutable copy (usually just a retain) until mutableJSONObject replaces it
     NSMutableDictionary *_jsonObject;
+    BOOL _readOnly;
+    BOOL _sharesStorage;
 }
 
 #pragma mark Lifecycle
 
 - (instancetype)initWrappingDictionary:(NSDictionary *)jsonObject {
+    return [self initWrappingDictionary:jsonObject readOnly:NO];
+}
+
+- (instancetype)initWrappingDictionary:(NSDictionary *)jsonObject readOnly:(BOOL)readOnly {
     self = [super init];
     if (self) {
-        if ([jsonObject isKindOfClass:[FBGraphObject class]]) {
+        if ([jsonObject isKindOfClass:[FBGraphObject class]] &&
+            (readOnly || !((FBGraphObject *)jsonObject)->_readOnly)) {
             // in this case, we prefer to return the original object,
             // rather than allocate a wrapper
 
@@ -96,8 +156,15 @@ typedef enum _SelectorInferredImplType {
 
             // no wrapper needed, returning the object that was provided
             return (FBGraphObject *)jsonObject;
+        } else if (readOnly) {
+            // a view over the parsed response; nested nodes are wrapped as they are read
+            _jsonObject = (NSMutableDictionary *)[jsonObject retain];
+            _readOnly = YES;
         } else {
-            _jsonObject = [[NSMutableDictionary dictionaryWithDictionary:jsonObject] retain];
+            // copying an immutable parsed response only retains it, so wrapping stays cheap
+            // until the first write
+            _jsonObject = (NSMutableDictionary *)[jsonObject copy];
+            _sharesStorage = YES;
         }
     }
     return self;
@@ -108,10 +175,13 @@ typedef enum _SelectorInferredImplType {
 }
 
 - (void)setProvisionedForPost:(BOOL)provisionedForPost {
+    if (_readOnly) {
+        [FBGraphObject raiseReadOnlyMutation:_cmd];
+    }
     if (provisionedForPost) {
-        _jsonObject[FBPostObject] = [NSNumber numberWithBool:YES];
+        [self mutableJSONObject][FBPostObject] = [NSNumber numberWithBool:YES];
     } else {
-        [_jsonObject removeObjectForKey:FBPostObject];
+        [[self mutableJSONObject] removeObjectForKey:FBPostObject];
     }
 }
 
@@ -120,7 +190,10 @@ typedef enum _SelectorInferredImplType {
 }
 
 - (void)setObjectID:(NSString *)objectID {
-    _jsonObject[@"id"] = objectID;
+    if (_readOnly) {
+        [FBGraphObject raiseReadOnlyMutation:_cmd];
+    }
+    [self mutableJSONObject][@"id"] = objectID;
 }
 
 - (id)objectDescription {
@@ -128,7 +201,10 @@ typedef enum _SelectorInferredImplType {
 }
 
 - (void)setObjectDescription:(id)objectDescription {
-    _jsonObject[@"description"] = objectDescription;
+    if (_readOnly) {
+        [FBGraphObject raiseReadOnlyMutation:_cmd];
+    }
+    [self mutableJSONObject][@"description"] = objectDescription;
 }
 
 - (void)dealloc {
@@ -147,6 +223,10 @@ typedef enum _SelectorInferredImplType {
     return [FBGraphObject graphObjectWrappingObject:jsonDictionary];
 }
 
++ (NSDictionary<FBGraphObject> *)readOnlyGraphObjectWrappingDictionary:(NSDictionary *)jsonDictionary {
+    return [FBGraphObject graphObjectWrappingObject:jsonDictionary readOnly:YES];
+}
+
 + (NSMutableDictionary<FBOpenGraphAction> *)openGraphActionForPost {
     return (NSMutableDictionary<FBOpenGraphAction> *)[FBGraphObject graphObject];
 }
@@ -199,9 +279,70 @@ typedef enum _SelectorInferredImplType {
     return NO;
 }
 
++ (NSSet *)fieldsForProtocol:(Protocol *)protocol {
+    NSString *name = NSStringFromProtocol(protocol);
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        g_protocolFieldsCache = [[NSMutableDictionary alloc] init];
+    });
+
+    @synchronized (g_protocolFieldsCache) {
+        NSSet *fields = g_protocolFieldsCache[name];
+        if (!fields) {
+            NSMutableSet *mutableFields = [NSMutableSet set];
+            FBGraphObjectAddFieldsForProtocol(protocol, mutableFields);
+            fields = [[mutableFields copy] autorelease];
+            g_protocolFieldsCache[name] = fields;
+        }
+        return fields;
+    }
+}
+
 #pragma mark -
 #pragma mark NSObject overrides
 
+// adds a real implementation for the getters and setters we infer, with the key worked out once
+// up front, so later calls are an ordinary message send plus the dictionary access
++ (BOOL)resolveInstanceMethod:(SEL)sel {
+    IMP implementation = NULL;
+    const char *types = NULL;
+
+    switch ([FBGraphObject inferredImplTypeForSelector:sel]) {
+        case SelectorInferredImplTypeGet: {
+            NSString *propertyName = NSStringFromSelector(sel);
+            implementation = imp_implementationWithBlock(^id(id graphObject) {
+                return [graphObject objectForKey:propertyName];
+            });
+            types = "@@:";
+            break;
+        }
+        case SelectorInferredImplTypeSet: {
+            NSMutableString *propertyName = [NSMutableString stringWithString:NSStringFromSelector(sel)];
+            // remove 'set' and trailing ':', and lowercase the new first character
+            [propertyName deleteCharactersInRange:NSMakeRange(0, 3)];                       // "set"
+            [propertyName deleteCharactersInRange:NSMakeRange(propertyName.length - 1, 1)]; // ":"
+
+            NSString *firstChar = [[propertyName substringWithRange:NSMakeRange(0,1)] lowercaseString];
+            [propertyName replaceCharactersInRange:NSMakeRange(0, 1) withString:firstChar];
+            NSString *key = [[propertyName copy] autorelease];
+            implementation = imp_implementationWithBlock(^(id graphObject, id object) {
+                [graphObject setObject:object forKey:key];
+            });
+            types = "v@:@";
+            break;
+        }
+        case SelectorInferredImplTypeNone:
+        default:
+            return [super resolveInstanceMethod:sel];
+    }
+
+    if (!class_addMethod(self, sel, implementation, types)) {
+        // Another thread got there first, or the method appeared some other way
+        imp_removeBlock(implementation);
+    }
+    return YES;
+}
+
 // make the respondsToSelector method do the right thing for the selectors we handle
 - (BOOL)respondsToSelector:(SEL)sel
 {
@@ -273,17 +414,24 @@ typedef enum _SelectorInferredImplType {
 
 - (id)graphObjectifyAtKey:(id)key {
     id object = [_jsonObject objectForKey:key];
+    if (_readOnly) {
+        // wrapped fresh on every read, leaving the parsed response untouched
+        return [FBGraphObject graphObjectWrappingObject:object readOnly:YES];
+    }
     // make certain it is FBObjectGraph-ified
     id possibleReplacement = [FBGraphObject graphObjectWrappingObject:object];
     if (object != possibleReplacement) {
         // and if not-yet, replace the original with the wrapped object
-        [_jsonObject setObject:possibleReplacement forKey:key];
+        [[self mutableJSONObject] setObject:possibleReplacement forKey:key];
         object = possibleReplacement;
     }
     return object;
 }
 
 - (void)graphObjectifyAll {
+    if (_readOnly) {
+        return;
+    }
     NSArray *keys = [_jsonObject allKeys];
     for (NSString *key in keys) {
         [self graphObjectifyAtKey:key];
@@ -309,11 +457,27 @@ typedef enum _SelectorInferredImplType {
 }
 
 - (void)setObject:(id)object forKey:(id)key {
-    return [_jsonObject setObject:object forKey:key];
+    if (_readOnly) {
+        [FBGraphObject raiseReadOnlyMutation:_cmd];
+    }
+    return [[self mutableJSONObject] setObject:object forKey:key];
 }
 
 - (void)removeObjectForKey:(id)key {
-    return [_jsonObject removeObjectForKey:key];
+    if (_readOnly) {
+        [FBGraphObject raiseReadOnlyMutation:_cmd];
+    }
+    return [[self mutableJSONObject] removeObjectForKey:key];
+}
+
+- (NSMutableDictionary *)mutableJSONObject {
+    if (_sharesStorage) {
+        NSMutableDictionary *jsonObject = [[NSMutableDictionary alloc] initWithDictionary:_jsonObject];
+        [_jsonObject release];
+        _jsonObject = jsonObject;
+        _sharesStorage = NO;
+    }
+    return _jsonObject;
 }
 
 #pragma mark -
@@ -337,21 +501,45 @@ typedef enum _SelectorInferredImplType {
     return result;
 }
 
++ (id)graphObjectWrappingObject:(id)originalObject readOnly:(BOOL)readOnly {
+    if (!readOnly) {
+        return [FBGraphObject graphObjectWrappingObject:originalObject];
+    }
+
+    id result = originalObject;
+    if ([originalObject isKindOfClass:[NSDictionary class]]) {
+        result = [[[FBGraphObject alloc] initWrappingDictionary:originalObject readOnly:YES] autorelease];
+    } else if ([originalObject isKindOfClass:[NSArray class]]) {
+        result = [[[FBGraphObjectArray alloc] initWrappingArray:originalObject readOnly:YES] autorelease];
+    }
+    return result;
+}
+
++ (void)raiseReadOnlyMutation:(SEL)sel {
+    [NSException raise:NSInternalInconsistencyException
+                format:@"%@ sent to a read-only graph object", NSStringFromSelector(sel)];
+}
+
 // helper method used by the catgory implementation to determine whether a selector should be handled
 + (SelectorInferredImplType)inferredImplTypeForSelector:(SEL)sel {
-    // the overhead in this impl is high relative to the cost of a normal property
-    // accessor; if needed we will optimize by caching results of the following
-    // processing, indexed by selector
-
-    NSString *selectorName = NSStringFromSelector(sel);
-    NSUInteger parameterCount = [[selectorName componentsSeparatedByString:@":"] count]-1;
+    // scans the selector's C string in place, which is cheaper than any lookup
+    // a cache could offer; resolveInstanceMethod: keeps it to once per selector
+    // for accessors anyway
+    const char *selectorName = sel_getName(sel);
+    size_t length = strlen(selectorName);
+    NSUInteger parameterCount = 0;
+    for (size_t index = 0; index < length; index++) {
+        if (selectorName[index] == ':') {
+            parameterCount++;
+        }
+    }
     // we will process a selector as a getter if paramCount == 0
     if (parameterCount == 0) {
         return SelectorInferredImplTypeGet;
         // otherwise we consider a setter if...
     } else if (parameterCount == 1 &&                   // ... we have the correct arity
-               [selectorName hasPrefix:@"set"] &&       // ... we have the proper prefix
-               selectorName.length > 4) {               // ... there are characters other than "set" & ":"
+               strncmp(selectorName, "set", 3) == 0 &&  // ... we have the proper prefix
+               length > 4) {                            // ... there are characters other than "set" & ":"
         return SelectorInferredImplTypeSet;
     }
 
@@ -359,6 +547,31 @@ typedef enum _SelectorInferredImplType {
 }
 
 + (BOOL)isProtocolImplementationInferable:(Protocol *)protocol checkFBGraphObjectAdoption:(BOOL)checkAdoption {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        g_protocolInferabilityCache = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, NULL, NULL);
+        g_protocolInferabilityQueue = FBDispatchQueueCreateConcurrent("com.facebook.sdk.FBGraphObject", FBDispatchLaneUtility);
+    });
+
+    // protocols are never unloaded, so their pointers make stable keys
+    const void *key = (const void *)((uintptr_t)protocol | (checkAdoption ? 1 : 0));
+    __block const void *cached = NULL;
+    dispatch_sync(g_protocolInferabilityQueue, ^{
+        cached = CFDictionaryGetValue(g_protocolInferabilityCache, key);
+    });
+    if (cached) {
+        return cached == kCFBooleanTrue;
+    }
+
+    BOOL inferable = [FBGraphObject uncachedIsProtocolImplementationInferable:protocol
+                                                   checkFBGraphObjectAdoption:checkAdoption];
+    dispatch_barrier_async(g_protocolInferabilityQueue, ^{
+        CFDictionarySetValue(g_protocolInferabilityCache, key, inferable ? kCFBooleanTrue : kCFBooleanFalse);
+    });
+    return inferable;
+}
+
++ (BOOL)uncachedIsProtocolImplementationInferable:(Protocol *)protocol checkFBGraphObjectAdoption:(BOOL)checkAdoption {
     // first handle base protocol questions
     if (checkAdoption && !protocol_conformsToProtocol(protocol, @protocol(FBGraphObject))) {
         return NO;
@@ -427,13 +640,21 @@ typedef enum _SelectorInferredImplType {
 #pragma mark internal classes
 
 @implementation FBGraphObjectArray {
+    // same contract as FBGraphObject's _jsonObject
     NSMutableArray *_jsonArray;
+    BOOL _readOnly;
+    BOOL _sharesStorage;
 }
 
 - (instancetype)initWrappingArray:(NSArray *)jsonArray {
+    return [self initWrappingArray:jsonArray readOnly:NO];
+}
+
+- (instancetype)initWrappingArray:(NSArray *)jsonArray readOnly:(BOOL)readOnly {
     self = [super init];
     if (self) {
-        if ([jsonArray isKindOfClass:[FBGraphObjectArray class]]) {
+        if ([jsonArray isKindOfClass:[FBGraphObjectArray class]] &&
+            (readOnly || !((FBGraphObjectArray *)jsonArray)->_readOnly)) {
             // in this case, we prefer to return the original object,
             // rather than allocate a wrapper
 
@@ -445,8 +666,12 @@ typedef enum _SelectorInferredImplType {
 
             // no wrapper needed, returning the object that was provided
             return (FBGraphObjectArray *)jsonArray;
+        } else if (readOnly) {
+            _jsonArray = (NSMutableArray *)[jsonArray retain];
+            _readOnly = YES;
         } else {
-            _jsonArray = [[NSMutableArray arrayWithArray:jsonArray] retain];
+            _jsonArray = (NSMutableArray *)[jsonArray copy];
+            _sharesStorage = YES;
         }
     }
     return self;
@@ -463,17 +688,23 @@ typedef enum _SelectorInferredImplType {
 
 - (id)graphObjectifyAtIndex:(NSUInteger)index {
     id object = [_jsonArray objectAtIndex:index];
+    if (_readOnly) {
+        return [FBGraphObject graphObjectWrappingObject:object readOnly:YES];
+    }
     // make certain it is FBObjectGraph-ified
     id possibleReplacement = [FBGraphObject graphObjectWrappingObject:object];
     if (object != possibleReplacement) {
         // and if not-yet, replace the original with the wrapped object
-        [_jsonArray replaceObjectAtIndex:index withObject:possibleReplacement];
+        [[self mutableJSONArray] replaceObjectAtIndex:index withObject:possibleReplacement];
         object = possibleReplacement;
     }
     return object;
 }
 
 - (void)graphObjectifyAll {
+    if (_readOnly) {
+        return;
+    }
     NSUInteger count = [_jsonArray count];
     for (NSUInteger i = 0; i < count; ++i) {
         [self graphObjectifyAtIndex:i];
@@ -485,33 +716,65 @@ typedef enum _SelectorInferredImplType {
 }
 
 - (NSEnumerator *)objectEnumerator {
+    if (_readOnly) {
+        // the inherited enumerator goes through objectAtIndex:, so nodes are wrapped one at a time
+        return [super objectEnumerator];
+    }
     [self graphObjectifyAll];
     return _jsonArray.objectEnumerator;
 }
 
 - (NSEnumerator *)reverseObjectEnumerator {
+    if (_readOnly) {
+        return [super reverseObjectEnumerator];
+    }
     [self graphObjectifyAll];
     return _jsonArray.reverseObjectEnumerator;
 }
 
 - (void)insertObject:(id)object atIndex:(NSUInteger)index {
-    [_jsonArray insertObject:object atIndex:index];
+    if (_readOnly) {
+        [FBGraphObject raiseReadOnlyMutation:_cmd];
+    }
+    [[self mutableJSONArray] insertObject:object atIndex:index];
 }
 
 - (void)removeObjectAtIndex:(NSUInteger)index {
-    [_jsonArray removeObjectAtIndex:index];
+    if (_readOnly) {
+        [FBGraphObject raiseReadOnlyMutation:_cmd];
+    }
+    [[self mutableJSONArray] removeObjectAtIndex:index];
 }
 
 - (void)addObject:(id)object {
-    [_jsonArray addObject:object];
+    if (_readOnly) {
+        [FBGraphObject raiseReadOnlyMutation:_cmd];
+    }
+    [[self mutableJSONArray] addObject:object];
 }
 
 - (void)removeLastObject {
-    [_jsonArray removeLastObject];
+    if (_readOnly) {
+        [FBGraphObject raiseReadOnlyMutation:_cmd];
+    }
+    [[self mutableJSONArray] removeLastObject];
 }
 
 - (void)replaceObjectAtIndex:(NSUInteger)index withObject:(id)object {
-    [_jsonArray replaceObjectAtIndex:index withObject:object];
+    if (_readOnly) {
+        [FBGraphObject raiseReadOnlyMutation:_cmd];
+    }
+    [[self mutableJSONArray] replaceObjectAtIndex:index withObject:object];
+}
+
+- (NSMutableArray *)mutableJSONArray {
+    if (_sharesStorage) {
+        NSMutableArray *jsonArray = [[NSMutableArray alloc] initWithArray:_jsonArray];
+        [_jsonArray release];
+        _jsonArray = jsonArray;
+        _sharesStorage = NO;
+    }
+    return _jsonArray;
 }
 
 @end
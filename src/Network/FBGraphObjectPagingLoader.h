@@ -18,14 +18,16 @@
 
 #import "FBGraphObjectTableDataSource.h"
 
+@class FBCancellationToken;
 @class FBRequest;
 @class FBSession;
 @protocol FBGraphObjectPagingLoaderDelegate;
 
 typedef enum {
-    // Paging links will be followed as soon as one set of results is loaded
+    // Paging links will be followed as soon as one set of results arrives, while it is
+    // still being added to the table
     FBGraphObjectPagingModeImmediate,
-    // Paging links will be followed as soon as one set of results is loaded, even without a view
+    // Paging links will be followed as soon as one set of results arrives, even without a view
     FBGraphObjectPagingModeImmediateViewless,
     // Paging links will be followed only when the user scrolls to the bottom of the table
     FBGraphObjectPagingModeAsNeeded
@@ -39,6 +41,11 @@ typedef enum {
 @property (nonatomic, assign) id<FBGraphObjectPagingLoaderDelegate> delegate;
 @property (nonatomic, readonly) FBGraphObjectPagingMode pagingMode;
 @property (nonatomic, readonly) BOOL isResultFromCache;
+// The FBNetworkFeature* that the loader's requests are accounted to.
+@property (nonatomic, copy) NSString *networkFeature;
+// Passed to the loader's connections, so cancelling it stops the load in flight and
+// any later pages.
+@property (nonatomic, retain) FBCancellationToken *cancellationToken;
 
 - (instancetype)initWithDataSource:(FBGraphObjectTableDataSource *)aDataSource
                         pagingMode:(FBGraphObjectPagingMode)pagingMode;
@@ -27,8 +27,12 @@
 @property (nonatomic, copy) NSString *cacheIdentity;
 @property (nonatomic, assign) BOOL skipRoundtripIfCached;
 @property (nonatomic) FBGraphObjectPagingMode pagingMode;
+// Set when the next page was requested as soon as the current one arrived, before the
+// current one was added to the data source
+@property (nonatomic, assign) BOOL nextPageRequested;
 
 - (void)followNextLink;
+- (BOOL)shouldFollowNextLinkImmediately;
 - (void)requestCompleted:(FBRequestConnection *)connection
                   result:(id)result
                    error:(NSError *)error;
@@ -58,6 +62,8 @@
     [_session release];
     [_connection release];
     [_cacheIdentity release];
+    [_networkFeature release];
+    [_cancellationToken release];
 
     [super dealloc];
 }
@@ -89,14 +95,26 @@
     }
 }
 
+- (BOOL)shouldFollowNextLinkImmediately
+{
+    // Unless we are viewless, if we have lost our tableView, take that as a sign to stop
+    // (probably because the view was unloaded). If tableView is re-set, we will start again.
+    return (self.pagingMode == FBGraphObjectPagingModeImmediate &&
+            self.tableView) ||
+           self.pagingMode == FBGraphObjectPagingModeImmediateViewless;
+}
+
 - (void)updateView
 {
-    [self.dataSource update];
-    [self.tableView reloadData];
+    [self.dataSource updateTableView:self.tableView];
 }
 
 // Adds new results to the table and attempts to preserve visual context in the table
 - (void)addResultsAndUpdateView:(NSDictionary *)results {
+    // The link in these results is already being loaded
+    BOOL nextPageRequested = self.nextPageRequested;
+    self.nextPageRequested = NO;
+
     NSArray *data = (NSArray *)[results objectForKey:@"data"];
     if (data.count == 0) {
         // If we got no data, stop following paging links.
@@ -110,7 +128,7 @@
             [self.delegate pagingLoaderDidFinishLoading:self];
         }
         return;
-    } else {
+    } else if (!nextPageRequested) {
         NSDictionary *paging = (NSDictionary *)[results objectForKey:@"paging"];
         NSString *next = (NSString *)[paging objectForKey:@"next"];
         self.nextLink = next;
@@ -144,7 +162,7 @@
             CGRect anchorRowRectBefore = [self.tableView rectForRowAtIndexPath:anchorIndexPath];
             CGPoint contentOffset = self.tableView.contentOffset;
 
-            // Update with new data and reload the table.
+            // Update with new data; only the new rows are added to the table.
             [self.dataSource appendGraphObjects:data];
             [self updateView];
 
@@ -163,12 +181,8 @@
         [self.delegate pagingLoader:self didLoadData:results];
     }
 
-    // If we are supposed to keep paging, do so. But unless we are viewless, if we have lost
-    // our tableView, take that as a sign to stop (probably because the view was unloaded).
-    // If tableView is re-set, we will start again.
-    if ((self.pagingMode == FBGraphObjectPagingModeImmediate &&
-         self.tableView) ||
-        self.pagingMode == FBGraphObjectPagingModeImmediateViewless) {
+    // If we are supposed to keep paging, do so.
+    if (!nextPageRequested && [self shouldFollowNextLinkImmediately]) {
         [self followNextLink];
     }
 }
@@ -187,6 +201,12 @@
                                                       graphPath:nil];
 
         FBRequestConnection *connection = [[FBRequestConnection alloc] init];
+        connection.networkFeature = self.networkFeature;
+        connection.cancellationToken = self.cancellationToken;
+        // Pages loaded ahead of the user scrolling to them can wait for anything on screen
+        if ([self shouldFollowNextLinkImmediately]) {
+            connection.priority = FBRequestPriorityPrefetch;
+        }
         [connection addRequest:request completionHandler:
          ^(FBRequestConnection *connection, id result, NSError *error) {
              _isResultFromCache = _isResultFromCache || connection.isResultFromCache;
@@ -222,6 +242,8 @@
     self.skipRoundtripIfCached = skipRoundtripIfCached;
 
     FBRequestConnection *connection = [[FBRequestConnection alloc] init];
+    connection.networkFeature = self.networkFeature;
+    connection.cancellationToken = self.cancellationToken;
     [connection addRequest:request
          completionHandler:^(FBRequestConnection *connection, id result, NSError *error) {
              _isResultFromCache = _isResultFromCache || connection.isResultFromCache;
@@ -248,6 +270,7 @@
     [self cancel];
     self.connection = nil;
     self.nextLink = nil;
+    self.nextPageRequested = NO;
 }
 
 - (void)requestCompleted:(FBRequestConnection *)connection
@@ -293,6 +316,16 @@
     }
 
     if (!cancelled) {
+        // Paging links are cursors, so there is never more than the one next page to ask
+        // for, but it can be on the wire while this page is merged and the table reloaded.
+        NSString *next = [[resultDictionary objectForKey:@"paging"] objectForKey:@"next"];
+        if (data.count > 0 &&
+            [next isKindOfClass:[NSString class]] &&
+            [self shouldFollowNextLinkImmediately]) {
+            self.nextLink = next;
+            [self followNextLink];
+            self.nextPageRequested = self.connection != nil;
+        }
         [self addResultsAndUpdateView:resultDictionary];
     }
 }
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+// Word-prefix index over one string field of a list of graph objects, folded for case
+// and diacritics.  Items are referred to by their position in the list they came from.
+// Not thread safe; the table data source only uses it from the main thread.
+@interface FBGraphObjectSearchIndex : NSObject
+
+@property (nonatomic, copy, readonly) NSString *field;
+// How many items have been added, which is also the position the next one will get
+@property (nonatomic, readonly) NSUInteger indexedCount;
+
+- (instancetype)initWithField:(NSString *)field;
+
+// Adds items to the end of the list, numbered on from indexedCount.
+- (void)addItems:(NSArray *)items;
+- (void)removeAllItems;
+
+// Positions of the items whose field has, for every word in searchText, a word starting
+// with it.  An empty index set when nothing matches; nil when searchText has no words.
+- (NSIndexSet *)indexesOfItemsMatchingSearchText:(NSString *)searchText;
+
+@end
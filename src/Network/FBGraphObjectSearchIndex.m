@@ -0,0 +1,184 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBGraphObjectSearchIndex.h"
+
+#import <stdlib.h>
+
+typedef struct {
+    NSString *word;
+    NSUInteger position;
+} FBGraphObjectSearchIndexEntry;
+
+static NSStringCompareOptions const kWordCompareOptions = NSLiteralSearch;
+
+// Lowercases, strips diacritics and splits on anything that isn't a letter or digit
+static NSArray *FBGraphObjectSearchIndexWords(NSString *string) {
+    static NSCharacterSet *separators = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        separators = [[[NSCharacterSet alphanumericCharacterSet] invertedSet] retain];
+    });
+
+    NSString *folded = [string stringByFoldingWithOptions:NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch
+                                                   locale:nil];
+    NSMutableArray *words = [NSMutableArray array];
+    for (NSString *word in [folded componentsSeparatedByCharactersInSet:separators]) {
+        if (word.length) {
+            [words addObject:word];
+        }
+    }
+    return words;
+}
+
+@implementation FBGraphObjectSearchIndex {
+    // sorted by word, then position
+    FBGraphObjectSearchIndexEntry *_entries;
+    NSUInteger _entryCount;
+}
+
+- (instancetype)initWithField:(NSString *)field
+{
+    if ((self = [super init])) {
+        _field = [field copy];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self removeAllItems];
+    [_field release];
+    [super dealloc];
+}
+
+- (void)removeAllItems
+{
+    for (NSUInteger i = 0; i < _entryCount; i++) {
+        [_entries[i].word release];
+    }
+    free(_entries);
+    _entries = NULL;
+    _entryCount = 0;
+    _indexedCount = 0;
+}
+
+- (void)addItems:(NSArray *)items
+{
+    NSMutableArray *words = [NSMutableArray array];
+    NSMutableArray *positions = [NSMutableArray array];
+    NSUInteger position = _indexedCount;
+    for (id item in items) {
+        id value = [item objectForKey:self.field];
+        if ([value isKindOfClass:[NSString class]]) {
+            for (NSString *word in [NSSet setWithArray:FBGraphObjectSearchIndexWords(value)]) {
+                [words addObject:word];
+                [positions addObject:[NSNumber numberWithUnsignedInteger:position]];
+            }
+        }
+        position++;
+    }
+    _indexedCount = position;
+
+    NSUInteger addedCount = words.count;
+    if (addedCount == 0) {
+        return;
+    }
+
+    FBGraphObjectSearchIndexEntry *added = malloc(sizeof(FBGraphObjectSearchIndexEntry) * addedCount);
+    for (NSUInteger i = 0; i < addedCount; i++) {
+        added[i].word = [[words objectAtIndex:i] retain];
+        added[i].position = [[positions objectAtIndex:i] unsignedIntegerValue];
+    }
+    int (^compare)(const void *, const void *) = ^int(const void *lhs, const void *rhs) {
+        const FBGraphObjectSearchIndexEntry *a = lhs;
+        const FBGraphObjectSearchIndexEntry *b = rhs;
+        NSComparisonResult result = [a->word compare:b->word options:kWordCompareOptions];
+        if (result == NSOrderedSame) {
+            return a->position < b->position ? -1 : (a->position > b->position ? 1 : 0);
+        }
+        return (int)result;
+    };
+    mergesort_b(added, addedCount, sizeof(FBGraphObjectSearchIndexEntry), compare);
+
+    // the new entries are merged into the sorted ones rather than everything being sorted again
+    FBGraphObjectSearchIndexEntry *merged = malloc(sizeof(FBGraphObjectSearchIndexEntry) * (_entryCount + addedCount));
+    NSUInteger i = 0, j = 0, k = 0;
+    while (i < _entryCount && j < addedCount) {
+        if (compare(&added[j], &_entries[i]) < 0) {
+            merged[k++] = added[j++];
+        } else {
+            merged[k++] = _entries[i++];
+        }
+    }
+    while (i < _entryCount) {
+        merged[k++] = _entries[i++];
+    }
+    while (j < addedCount) {
+        merged[k++] = added[j++];
+    }
+    free(added);
+    free(_entries);
+    _entries = merged;
+    _entryCount = k;
+}
+
+// Index of the first entry whose word is not ordered before prefix
+- (NSUInteger)lowerBoundForPrefix:(NSString *)prefix
+{
+    NSUInteger low = 0;
+    NSUInteger high = _entryCount;
+    while (low < high) {
+        NSUInteger mid = low + (high - low) / 2;
+        if ([_entries[mid].word compare:prefix options:kWordCompareOptions] == NSOrderedAscending) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+- (NSIndexSet *)indexesOfItemsMatchingSearchText:(NSString *)searchText
+{
+    NSArray *prefixes = FBGraphObjectSearchIndexWords(searchText ?: @"");
+    if (prefixes.count == 0) {
+        return nil;
+    }
+
+    // Each prefix is a binary search to where its words start, then a walk over just
+    // the words it matches, so nothing scales with the number of items that don't match
+    NSMutableIndexSet *result = nil;
+    for (NSString *prefix in prefixes) {
+        NSMutableIndexSet *matches = [NSMutableIndexSet indexSet];
+        for (NSUInteger i = [self lowerBoundForPrefix:prefix];
+             i < _entryCount && [_entries[i].word hasPrefix:prefix];
+             i++) {
+            NSUInteger position = _entries[i].position;
+            if (!result || [result containsIndex:position]) {
+                [matches addIndex:position];
+            }
+        }
+        result = matches;
+        if (result.count == 0) {
+            break;
+        }
+    }
+    return result;
+}
+
+@end
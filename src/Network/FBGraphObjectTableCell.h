@@ -28,7 +28,20 @@
 @property (copy, nonatomic) NSString *subtitle;
 @property (retain, nonatomic) UIImage *picture;
 
+// When set, the cell's contents are drawn from a single bitmap rendered on a
+// background queue, and kept for as long as memory allows for this item at
+// this size, rather than through the labels and picture view.  The text is
+// drawn with the labels' fonts and colors.  nil, the default, lays the cell
+// out as usual.
+@property (copy, nonatomic) NSString *prerenderedItemID;
+// Identifies picture, such as by its URL, so that rows showing the same picture
+// can share a bitmap.  A prerendered cell with a picture but no ID is laid out
+// as usual.
+@property (copy, nonatomic) NSString *prerenderedPictureID;
+
 + (CGFloat)rowHeight;
+// Size the picture is drawn at, in points; it is scaled to fill it
++ (CGSize)pictureSize;
 
 - (void)startAnimatingActivityIndicator;
 - (void)stopAnimatingActivityIndicator;
@@ -16,6 +16,10 @@
 
 #import "FBGraphObjectTableCell.h"
 
+#import <QuartzCore/QuartzCore.h>
+
+#import "FBDispatch.h"
+
 static const CGFloat titleFontHeight = 16;
 static const CGFloat subtitleFontHeight = 12;
 static const CGFloat pictureEdge = 40;
@@ -26,14 +30,73 @@ static const CGFloat titleTopWithSubtitle = 3;
 static const CGFloat subtitleTop = 23;
 static const CGFloat titleHeight = titleFontHeight * 1.25;
 static const CGFloat subtitleHeight = subtitleFontHeight * 1.25;
+// Bytes of rendered rows kept around; about 40 rows of an iPhone wide table at 2x
+static const NSUInteger kRenderedContentCacheSize = 8 * 1024 * 1024;
+
+#pragma mark - C Helpers
+
+// Bitmaps keyed by everything that goes into them, shared by all cells
+static NSCache *FBGraphObjectTableCellRenderedContents(void)
+{
+    static NSCache *renderedContents = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        renderedContents = [[NSCache alloc] init];
+        renderedContents.totalCostLimit = kRenderedContentCacheSize;
+    });
+    return renderedContents;
+}
+
+// Keys queued for rendering.  A cell reused before its row is rendered takes
+// its key back out, so a fling doesn't leave the queue rendering rows long gone.
+static NSMutableSet *FBGraphObjectTableCellPendingKeys(void)
+{
+    static NSMutableSet *pendingKeys = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pendingKeys = [[NSMutableSet alloc] init];
+    });
+    return pendingKeys;
+}
+
+static dispatch_queue_t FBGraphObjectTableCellRenderQueue(void)
+{
+    static dispatch_queue_t renderQueue = NULL;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        renderQueue = FBDispatchQueueCreateSerial("Table Cell Render queue", FBDispatchLaneUserInteractive);
+    });
+    return renderQueue;
+}
+
+// Draws text the way a UILabel of the given frame would, vertically centered
+// and truncated at the tail
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+static CGFloat FBGraphObjectTableCellDrawText(NSString *text, UIFont *font, UIColor *color, CGRect frame)
+{
+    if (text.length == 0 || frame.size.width <= 0) {
+        return 0;
+    }
+    [color set];
+    frame.origin.y += (frame.size.height - font.lineHeight) / 2;
+    frame.size.height = font.lineHeight;
+    return [text drawInRect:frame withFont:font lineBreakMode:NSLineBreakByTruncatingTail].width;
+}
+#pragma GCC diagnostic warning "-Wdeprecated-declarations"
 
 @interface FBGraphObjectTableCell ()
 
 @property (nonatomic, retain) UIImageView *pictureView;\
 @property (nonatomic, retain) UILabel *titleSuffixLabel;
 @property (nonatomic, retain) UIActivityIndicatorView *activityIndicator;
+@property (nonatomic, retain) CALayer *renderedContentLayer;
+// Key of the bitmap shown or on its way
+@property (nonatomic, copy) NSString *renderedContentKey;
 
 - (void)updateFonts;
+- (BOOL)layoutRenderedContent;
+- (void)showRenderedContentForKey:(NSString *)renderedContentKey image:(UIImage *)image;
+- (void)renderContentForKey:(NSString *)key;
 
 @end
 
@@ -73,6 +136,16 @@ static const CGFloat subtitleHeight = subtitleFontHeight * 1.25;
 
 - (void)dealloc
 {
+    if (_renderedContentKey) {
+        NSMutableSet *pendingKeys = FBGraphObjectTableCellPendingKeys();
+        @synchronized(pendingKeys) {
+            [pendingKeys removeObject:_renderedContentKey];
+        }
+    }
+    [_renderedContentKey release];
+    [_renderedContentLayer release];
+    [_prerenderedItemID release];
+    [_prerenderedPictureID release];
     [_titleSuffixLabel release];
     [_pictureView release];
 
@@ -88,6 +161,10 @@ static const CGFloat subtitleHeight = subtitleFontHeight * 1.25;
 
     [self updateFonts];
 
+    if ([self layoutRenderedContent]) {
+        return;
+    }
+
     BOOL hasPicture = (self.picture != nil);
     BOOL hasSubtitle = (self.subtitle != nil);
     BOOL hasTitleSuffix = (self.titleSuffix != nil);
@@ -119,11 +196,167 @@ static const CGFloat subtitleHeight = subtitleFontHeight * 1.25;
 }
 #pragma GCC diagnostic warning "-Wdeprecated-declarations"
 
+#pragma mark - Rendered content
+
+// Shows the bitmap for the cell's current contents, if there is one, and asks
+// for it if not.  Returns NO when the cell should be laid out as usual.
+- (BOOL)layoutRenderedContent
+{
+    CGRect bounds = self.contentView.bounds;
+    BOOL rendered = (self.prerenderedItemID != nil && !CGRectIsEmpty(bounds) &&
+                     (!self.picture || self.prerenderedPictureID));
+    self.textLabel.hidden = rendered;
+    self.detailTextLabel.hidden = rendered;
+    self.titleSuffixLabel.hidden = rendered;
+    self.pictureView.hidden = rendered;
+
+    if (!rendered) {
+        [self showRenderedContentForKey:nil image:nil];
+        return NO;
+    }
+
+    // Fonts are compared by name, since updateFonts asks for them again on
+    // every layout
+    NSString *key = [NSString stringWithFormat:@"%@\n%gx%g\n%@\n%@ %g %@\n%@ %g %@\n%@\n%@ %d\n%@",
+                     self.prerenderedItemID, bounds.size.width, bounds.size.height,
+                     self.picture ? self.prerenderedPictureID : @"",
+                     self.textLabel.font.fontName, self.textLabel.font.pointSize, self.textLabel.textColor,
+                     self.detailTextLabel.font.fontName, self.detailTextLabel.font.pointSize,
+                     self.detailTextLabel.textColor,
+                     self.title ?: @"", self.titleSuffix ?: @"", self.boldTitleSuffix, self.subtitle ?: @""];
+    UIImage *image = [FBGraphObjectTableCellRenderedContents() objectForKey:key];
+    [self showRenderedContentForKey:key image:image];
+    if (!image) {
+        [self renderContentForKey:key];
+    }
+    return YES;
+}
+
+- (void)showRenderedContentForKey:(NSString *)renderedContentKey image:(UIImage *)image
+{
+    if (self.renderedContentKey && ![self.renderedContentKey isEqualToString:renderedContentKey]) {
+        NSMutableSet *pendingKeys = FBGraphObjectTableCellPendingKeys();
+        @synchronized(pendingKeys) {
+            [pendingKeys removeObject:self.renderedContentKey];
+        }
+    }
+    self.renderedContentKey = renderedContentKey;
+
+    if (renderedContentKey && !self.renderedContentLayer) {
+        CALayer *layer = [CALayer layer];
+        layer.contentsScale = [UIScreen mainScreen].scale;
+        NSNull *noAction = [NSNull null];
+        layer.actions = [NSDictionary dictionaryWithObjectsAndKeys:
+                         noAction, @"contents",
+                         noAction, @"bounds",
+                         noAction, @"position",
+                         noAction, @"hidden",
+                         nil];
+        [self.contentView.layer addSublayer:layer];
+        self.renderedContentLayer = layer;
+    }
+    self.renderedContentLayer.frame = self.contentView.bounds;
+    self.renderedContentLayer.contents = (id)image.CGImage;
+    self.renderedContentLayer.hidden = (renderedContentKey == nil);
+}
+
+// Everything the bitmap needs is copied out here, on the main thread.  The
+// drawing itself only uses UIKit's thread-safe image context and string and
+// image drawing.
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+- (void)renderContentForKey:(NSString *)key
+{
+    NSMutableSet *pendingKeys = FBGraphObjectTableCellPendingKeys();
+    @synchronized(pendingKeys) {
+        if ([pendingKeys containsObject:key]) {
+            return;
+        }
+        [pendingKeys addObject:key];
+    }
+
+    NSString *title = [[self.title copy] autorelease];
+    NSString *titleSuffix = [[self.titleSuffix copy] autorelease];
+    NSString *subtitle = [[self.subtitle copy] autorelease];
+    UIImage *picture = self.picture;
+    UIFont *titleFont = self.textLabel.font;
+    UIColor *titleColor = self.textLabel.textColor;
+    UIFont *titleSuffixFont = self.titleSuffixLabel.font ?: titleFont;
+    UIColor *titleSuffixColor = self.titleSuffixLabel.textColor ?: titleColor;
+    UIFont *subtitleFont = self.detailTextLabel.font;
+    UIColor *subtitleColor = self.detailTextLabel.textColor;
+    CGSize size = self.contentView.bounds.size;
+    CGFloat scale = [UIScreen mainScreen].scale;
+
+    dispatch_async(FBGraphObjectTableCellRenderQueue(), ^{
+        @synchronized(pendingKeys) {
+            if (![pendingKeys containsObject:key]) {
+                return;
+            }
+        }
+
+        // Same geometry as layoutSubviews
+        CGFloat textLeft = (picture ? ((2 * pictureMargin) + pictureEdge) : 0) + horizontalMargin;
+        CGFloat textWidth = size.width - (textLeft + horizontalMargin);
+        CGFloat titleTop = subtitle ? titleTopWithSubtitle : titleTopNoSubtitle;
+
+        UIGraphicsBeginImageContextWithOptions(size, NO, scale);
+        if (picture) {
+            // Scaled to fill, as UIViewContentModeScaleAspectFill does
+            CGRect pictureFrame = CGRectMake(pictureMargin, pictureMargin, pictureEdge, pictureEdge);
+            CGFloat pictureScale = MAX(pictureEdge / MAX(picture.size.width, 1),
+                                       pictureEdge / MAX(picture.size.height, 1));
+            CGSize pictureSize = CGSizeMake(picture.size.width * pictureScale, picture.size.height * pictureScale);
+            CGContextSaveGState(UIGraphicsGetCurrentContext());
+            UIRectClip(pictureFrame);
+            [picture drawInRect:CGRectMake(CGRectGetMidX(pictureFrame) - pictureSize.width / 2,
+                                           CGRectGetMidY(pictureFrame) - pictureSize.height / 2,
+                                           pictureSize.width,
+                                           pictureSize.height)];
+            CGContextRestoreGState(UIGraphicsGetCurrentContext());
+        }
+        if (!titleSuffix) {
+            FBGraphObjectTableCellDrawText(title, titleFont, titleColor,
+                                           CGRectMake(textLeft, titleTop, textWidth, titleHeight));
+        } else {
+            CGFloat titleWidth = [title sizeWithFont:titleFont].width + [@" " sizeWithFont:titleFont].width;
+            FBGraphObjectTableCellDrawText(title, titleFont, titleColor,
+                                           CGRectMake(textLeft, titleTop, titleWidth, titleHeight));
+            FBGraphObjectTableCellDrawText(titleSuffix, titleSuffixFont, titleSuffixColor,
+                                           CGRectMake(textLeft + titleWidth, titleTop, textWidth - titleWidth, titleHeight));
+        }
+        FBGraphObjectTableCellDrawText(subtitle, subtitleFont, subtitleColor,
+                                       CGRectMake(textLeft, subtitleTop, textWidth, subtitleHeight));
+        UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+        UIGraphicsEndImageContext();
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            @synchronized(pendingKeys) {
+                [pendingKeys removeObject:key];
+            }
+            if (image) {
+                NSUInteger cost = (NSUInteger)(size.width * size.height * scale * scale * 4);
+                [FBGraphObjectTableCellRenderedContents() setObject:image forKey:key cost:cost];
+            }
+            if ([self.renderedContentKey isEqualToString:key]) {
+                [self setNeedsLayout];
+            }
+        });
+    });
+}
+#pragma GCC diagnostic warning "-Wdeprecated-declarations"
+
+#pragma mark -
+
 + (CGFloat)rowHeight
 {
     return pictureEdge + (2 * pictureMargin) + 1;
 }
 
++ (CGSize)pictureSize
+{
+    return CGSizeMake(pictureEdge, pictureEdge);
+}
+
 - (void)startAnimatingActivityIndicator {
     CGRect cellBounds = self.bounds;
     if (!self.activityIndicator) {
@@ -21,6 +21,7 @@
 @protocol FBGraphObjectViewControllerDelegate;
 @protocol FBGraphObjectSelectionQueryDelegate;
 @protocol FBGraphObjectDataSourceDataNeededDelegate;
+@class FBCancellationToken;
 @class FBGraphObjectTableCell;
 
 @interface FBGraphObjectTableDataSource : NSObject<UITableViewDataSource>
@@ -35,6 +36,14 @@
 @property (nonatomic, assign) id<FBGraphObjectSelectionQueryDelegate> selectionDelegate;
 @property (nonatomic, assign) id<FBGraphObjectDataSourceDataNeededDelegate> dataNeededDelegate;
 @property (nonatomic, copy) NSArray *sortDescriptors;
+// Only items with a word in their name starting with each word of searchText are shown,
+// ignoring case and diacritics.  Checked against a prefix index before the delegate's
+// filter is asked about an item.  Takes effect on the next update.
+@property (nonatomic, copy) NSString *searchText;
+// The FBNetworkFeature* that item picture downloads are accounted to.
+@property (nonatomic, copy) NSString *networkFeature;
+// Cancelling it cancels the picture downloads in flight and stops new ones.
+@property (nonatomic, retain) FBCancellationToken *cancellationToken;
 
 - (NSString *)fieldsForRequestIncluding:(NSSet *)customFields, ...;
 
@@ -47,6 +56,19 @@
 // Adds additional graph objects (pass nil to indicate all objects have been added).
 - (void)appendGraphObjects:(NSArray *)data;
 - (BOOL)hasGraphObjects;
+// The IDs of the graph objects added so far.
+- (NSSet *)graphObjectIDs;
+// Drops the graph objects with these IDs.  The next update regroups from scratch.
+- (void)removeGraphObjectsWithIDs:(NSSet *)objectIDs;
+
+// Saves the current sections, already grouped and sorted, to the disk cache.  Nothing is
+// saved while a search or an update is pending.
+- (void)writeSnapshotToCacheURL:(NSURL *)url;
+// Shows the sections saved at url, if they were grouped and sorted the way they would be
+// now and nothing has been appended since this was called.  The snapshot is replaced,
+// not added to, by the next appendGraphObjects:, and hasGraphObjects is NO until then.
+// completion is called on the main thread.
+- (void)restoreSnapshotFromCacheURL:(NSURL *)url completion:(void (^)(BOOL restored))completion;
 
 - (void)bindTableView:(UITableView *)tableView;
 
@@ -54,8 +76,20 @@
 
 // Call this when updating any property or if
 // delegate.filterIncludesItem would return a different answer now.
+// After appendGraphObjects: alone, only the appended items are indexed; a
+// filter change has to get an update of its own before more are appended.
 - (void)update;
 
+// Same as update, but any regrouping and sorting happens on a background queue and
+// the result is swapped in on the main thread before completion is called.  If another
+// update starts first, this one is dropped and its completion never called.
+- (void)updateWithCompletion:(void (^)(void))completion;
+
+// Same as update, followed by bringing tableView up to date.  When only appended items
+// needed indexing, the new rows and sections go in as batch insertions, so rows already
+// on screen keep their cells and pictures; otherwise tableView is reloaded.
+- (void)updateTableView:(UITableView *)tableView;
+
 // Returns the graph object at a given indexPath.
 - (FBGraphObject *)itemAtIndexPath:(NSIndexPath *)indexPath;
 
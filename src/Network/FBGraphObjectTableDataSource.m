@@ -16,8 +16,16 @@
 
 #import "FBGraphObjectTableDataSource.h"
 
+#import <objc/message.h>
+#import <stdlib.h>
+
+#import "FBCancellationToken.h"
+#import "FBDataDiskCache.h"
+#import "FBDispatch.h"
 #import "FBGraphObject.h"
+#import "FBGraphObjectSearchIndex.h"
 #import "FBGraphObjectTableCell.h"
+#import "FBImageDecoder.h"
 #import "FBSettings.h"
 #import "FBURLConnection.h"
 #import "FBUtility.h"
@@ -25,23 +33,354 @@
 // Magic number - iPhone address book doesn't show scrubber for less than 5 contacts
 static const NSInteger kMinimumCountToCollate = 6;
 
+static NSString *const kSearchField = @"name";
+
+// Picture downloads allowed at once to any one host; the rest wait for a free slot
+static const NSUInteger kMaximumImageConnectionsPerHost = 4;
+
+static NSString *const kImageRequestItemKey = @"item";
+static NSString *const kImageRequestURLKey = @"url";
+static NSString *const kImageRequestTableViewKey = @"tableView";
+static NSString *const kImageRequestConnectionKey = @"connection";
+// Picture ID given to cells showing the default picture
+static NSString *const kDefaultPictureID = @"default";
+
+static NSString *const kSnapshotSettingsKey = @"settings";
+static NSString *const kSnapshotSectionKeysKey = @"keys";
+static NSString *const kSnapshotSectionsKey = @"sections";
+
+static NSString *FBGraphObjectTableDataSourceImageHost(NSURL *url) {
+    return url.host ?: @"";
+}
+
+// Copies value all the way down into containers nothing else holds, so the copy can be
+// encoded on another thread while the graph objects it came from go on changing
+static id FBGraphObjectTableDataSourcePlainCopy(id value) {
+    if ([value isKindOfClass:[NSDictionary class]]) {
+        NSMutableDictionary *copy = [NSMutableDictionary dictionaryWithCapacity:[(NSDictionary *)value count]];
+        for (id key in (NSDictionary *)value) {
+            [copy setObject:FBGraphObjectTableDataSourcePlainCopy([(NSDictionary *)value objectForKey:key]) forKey:key];
+        }
+        return copy;
+    } else if ([value isKindOfClass:[NSArray class]]) {
+        NSMutableArray *copy = [NSMutableArray arrayWithCapacity:[(NSArray *)value count]];
+        for (id element in (NSArray *)value) {
+            [copy addObject:FBGraphObjectTableDataSourcePlainCopy(element)];
+        }
+        return copy;
+    }
+    return [[value copy] autorelease];
+}
+
+// Strings sorted with localizedCaseInsensitiveCompare: are first ordered by a copy folded for
+// case, width and diacritics; only names that fold the same go on to the localized comparison.
+static NSString *FBGraphObjectTableDataSourceFoldedSortKey(SEL selector, id value) {
+    if (selector != @selector(localizedCaseInsensitiveCompare:) || ![value isKindOfClass:[NSString class]]) {
+        return nil;
+    }
+    return [(NSString *)value stringByFoldingWithOptions:(NSCaseInsensitiveSearch |
+                                                          NSDiacriticInsensitiveSearch |
+                                                          NSWidthInsensitiveSearch)
+                                                  locale:[NSLocale currentLocale]];
+}
+
+static NSComparisonResult FBGraphObjectTableDataSourceCompareValues(id a,
+                                                                    id b,
+                                                                    NSString *foldedA,
+                                                                    NSString *foldedB,
+                                                                    SEL selector,
+                                                                    NSComparator comparator) {
+    if (a == b) {
+        return NSOrderedSame;
+    } else if (!a) {
+        return NSOrderedAscending;
+    } else if (!b) {
+        return NSOrderedDescending;
+    }
+    if (foldedA && foldedB) {
+        NSComparisonResult result = [foldedA compare:foldedB options:NSLiteralSearch];
+        if (result != NSOrderedSame) {
+            return result;
+        }
+    }
+    if (selector) {
+        return ((NSComparisonResult (*)(id, SEL, id))objc_msgSend)(a, selector, b);
+    }
+    return comparator(a, b);
+}
+
+// The IDs indexPathForItem: looks items up by, with NSNull for items without one
+static NSMutableArray *FBGraphObjectTableDataSourceItemIDs(NSArray *items) {
+    NSMutableArray *itemIDs = [NSMutableArray arrayWithCapacity:items.count];
+    for (id item in items) {
+        id itemID = [item objectForKey:@"id"];
+        [itemIDs addObject:[itemID isKindOfClass:[NSString class]] ? [[itemID copy] autorelease] : [NSNull null]];
+    }
+    return itemIDs;
+}
+
+// Reads what a section is sorted and looked up by out of its items: their IDs, then one
+// column for each sort field.  The values are copied, so the snapshot can be sorted off
+// the main thread while the items themselves go on changing.
+static NSMutableArray *FBGraphObjectTableDataSourceSnapshotColumns(NSArray *items, NSArray *sortDescriptors) {
+    NSMutableArray *columns = [NSMutableArray arrayWithCapacity:sortDescriptors.count + 1];
+    [columns addObject:FBGraphObjectTableDataSourceItemIDs(items)];
+    for (NSSortDescriptor *descriptor in sortDescriptors) {
+        NSString *keyPath = descriptor.key;
+        NSMutableArray *column = [NSMutableArray arrayWithCapacity:items.count];
+        for (id item in items) {
+            id value = keyPath ? [item valueForKeyPath:keyPath] : item;
+            if ([value conformsToProtocol:@protocol(NSCopying)]) {
+                value = [[value copy] autorelease];
+            }
+            [column addObject:value ?: [NSNull null]];
+        }
+        [columns addObject:column];
+    }
+    return columns;
+}
+
+// Sorts items by their snapshot columns, ordering row indexes by comparing column entries
+// and each string's folded sort key, and puts the ID column in the same order.
+static void FBGraphObjectTableDataSourceSortSnapshot(NSMutableArray *items, NSMutableArray *columns, NSArray *sortDescriptors) {
+    NSUInteger count = items.count;
+    NSUInteger columnCount = sortDescriptors.count;
+    if (count < 2 || columnCount == 0) {
+        return;
+    }
+
+    id *values = malloc(sizeof(id) * count * columnCount);
+    NSString **foldedValues = malloc(sizeof(NSString *) * count * columnCount);
+    SEL *selectors = malloc(sizeof(SEL) * columnCount);
+    NSComparator *comparators = malloc(sizeof(NSComparator) * columnCount);
+    BOOL *ascending = malloc(sizeof(BOOL) * columnCount);
+    NSUInteger *order = malloc(sizeof(NSUInteger) * count);
+    id *sorted = malloc(sizeof(id) * count);
+
+    for (NSUInteger c = 0; c < columnCount; c++) {
+        NSSortDescriptor *descriptor = [sortDescriptors objectAtIndex:c];
+        NSArray *column = [columns objectAtIndex:c + 1];
+        selectors[c] = descriptor.selector;
+        comparators[c] = descriptor.selector ? nil : descriptor.comparator;
+        ascending[c] = descriptor.ascending;
+        for (NSUInteger row = 0; row < count; row++) {
+            id value = [column objectAtIndex:row];
+            value = (value == [NSNull null]) ? nil : value;
+            values[c * count + row] = value;
+            foldedValues[c * count + row] = FBGraphObjectTableDataSourceFoldedSortKey(selectors[c], value);
+        }
+    }
+    for (NSUInteger row = 0; row < count; row++) {
+        order[row] = row;
+    }
+
+    // mergesort keeps equal rows in their original order, as sortUsingDescriptors: does
+    int (^compareRows)(const void *, const void *) = ^int(const void *lhs, const void *rhs) {
+        NSUInteger left = *(const NSUInteger *)lhs;
+        NSUInteger right = *(const NSUInteger *)rhs;
+        for (NSUInteger c = 0; c < columnCount; c++) {
+            NSComparisonResult result = FBGraphObjectTableDataSourceCompareValues(values[c * count + left],
+                                                                                  values[c * count + right],
+                                                                                  foldedValues[c * count + left],
+                                                                                  foldedValues[c * count + right],
+                                                                                  selectors[c],
+                                                                                  comparators[c]);
+            if (result != NSOrderedSame) {
+                return (int)(ascending[c] ? result : -result);
+            }
+        }
+        return 0;
+    };
+    if (mergesort_b(order, count, sizeof(NSUInteger), compareRows) != 0) {
+        // out of memory for mergesort's buffer; insertion sort is stable too
+        for (NSUInteger i = 1; i < count; i++) {
+            NSUInteger row = order[i];
+            NSUInteger j = i;
+            for (; j > 0 && compareRows(&order[j - 1], &row) > 0; j--) {
+                order[j] = order[j - 1];
+            }
+            order[j] = row;
+        }
+    }
+
+    for (NSUInteger row = 0; row < count; row++) {
+        sorted[row] = [items objectAtIndex:order[row]];
+    }
+    [items setArray:[NSArray arrayWithObjects:sorted count:count]];
+    NSMutableArray *itemIDs = [columns objectAtIndex:0];
+    for (NSUInteger row = 0; row < count; row++) {
+        sorted[row] = [itemIDs objectAtIndex:order[row]];
+    }
+    [itemIDs setArray:[NSArray arrayWithObjects:sorted count:count]];
+
+    free(sorted);
+    free(order);
+    free(ascending);
+    free(comparators);
+    free(selectors);
+    free(foldedValues);
+    free(values);
+}
+
+// Sorts items on the thread that owns them
+static void FBGraphObjectTableDataSourceSortItems(NSMutableArray *items, NSArray *sortDescriptors) {
+    FBGraphObjectTableDataSourceSortSnapshot(items,
+                                             FBGraphObjectTableDataSourceSnapshotColumns(items, sortDescriptors),
+                                             sortDescriptors);
+}
+
+// Orders two items the way FBGraphObjectTableDataSourceSortItems does
+static NSComparisonResult FBGraphObjectTableDataSourceCompareItems(id item, id otherItem, NSArray *sortDescriptors) {
+    for (NSSortDescriptor *descriptor in sortDescriptors) {
+        NSString *keyPath = descriptor.key;
+        id a = keyPath ? [item valueForKeyPath:keyPath] : item;
+        id b = keyPath ? [otherItem valueForKeyPath:keyPath] : otherItem;
+        NSComparisonResult result = FBGraphObjectTableDataSourceCompareValues(a,
+                                                                              b,
+                                                                              FBGraphObjectTableDataSourceFoldedSortKey(descriptor.selector, a),
+                                                                              FBGraphObjectTableDataSourceFoldedSortKey(descriptor.selector, b),
+                                                                              descriptor.selector,
+                                                                              descriptor.selector ? nil : descriptor.comparator);
+        if (result != NSOrderedSame) {
+            return descriptor.ascending ? result : (NSComparisonResult)-result;
+        }
+    }
+    return NSOrderedSame;
+}
+
+// Merges sorted added items into already sorted items.  Existing items win ties, which is
+// the order a stable sort over all of them would give, since they were appended first.
+static void FBGraphObjectTableDataSourceMergeSortedItems(NSMutableArray *items, NSArray *added, NSArray *sortDescriptors) {
+    NSUInteger count = items.count;
+    NSUInteger addedCount = added.count;
+    NSMutableArray *merged = [NSMutableArray arrayWithCapacity:count + addedCount];
+    NSUInteger i = 0;
+    NSUInteger j = 0;
+    while (i < count && j < addedCount) {
+        id existing = [items objectAtIndex:i];
+        id addition = [added objectAtIndex:j];
+        if (FBGraphObjectTableDataSourceCompareItems(addition, existing, sortDescriptors) == NSOrderedAscending) {
+            [merged addObject:addition];
+            j++;
+        } else {
+            [merged addObject:existing];
+            i++;
+        }
+    }
+    if (i < count) {
+        [merged addObjectsFromArray:[items subarrayWithRange:NSMakeRange(i, count - i)]];
+    }
+    if (j < addedCount) {
+        [merged addObjectsFromArray:[added subarrayWithRange:NSMakeRange(j, addedCount - j)]];
+    }
+    [items setArray:merged];
+}
+
+// Records where each item with an ID sits in a section, given the section's item IDs.  Goes
+// backwards, so that the first of any duplicates is the one recorded, as a forward scan would find.
+static void FBGraphObjectTableDataSourceIndexRows(NSArray *itemIDs,
+                                                  NSString *key,
+                                                  NSMutableDictionary *sectionKeysByID,
+                                                  NSMutableDictionary *rowsByIDForSectionKey) {
+    NSUInteger count = itemIDs.count;
+    NSMutableDictionary *rowsByID = [NSMutableDictionary dictionaryWithCapacity:count];
+    for (NSUInteger row = count; row-- > 0;) {
+        id itemID = [itemIDs objectAtIndex:row];
+        if (itemID != [NSNull null]) {
+            [rowsByID setObject:[NSNumber numberWithUnsignedInteger:row] forKey:itemID];
+            [sectionKeysByID setObject:key forKey:itemID];
+        }
+    }
+    [rowsByIDForSectionKey setObject:rowsByID forKey:key];
+}
+
+// Snapshots every section of indexMap, by section key
+static NSMutableDictionary *FBGraphObjectTableDataSourceSnapshotSections(NSDictionary *indexMap, NSArray *sortDescriptors) {
+    NSMutableDictionary *columnsByKey = [NSMutableDictionary dictionaryWithCapacity:indexMap.count];
+    for (NSString *key in indexMap) {
+        [columnsByKey setObject:FBGraphObjectTableDataSourceSnapshotColumns([indexMap objectForKey:key], sortDescriptors)
+                         forKey:key];
+    }
+    return columnsByKey;
+}
+
+// Sorts grouped sections and their keys and builds the reverse lookup.  Only reads the
+// snapshots in columnsByKey, never the items, so it can run off the main thread.
+static void FBGraphObjectTableDataSourceFinishIndex(NSMutableDictionary *indexMap,
+                                                    NSMutableArray *indexKeys,
+                                                    NSDictionary *columnsByKey,
+                                                    NSArray *sortDescriptors,
+                                                    BOOL useCollation,
+                                                    NSMutableDictionary *sectionKeysByID,
+                                                    NSMutableDictionary *rowsByIDForSectionKey) {
+    if (sortDescriptors) {
+        for (NSString *key in indexKeys) {
+            FBGraphObjectTableDataSourceSortSnapshot([indexMap objectForKey:key], [columnsByKey objectForKey:key], sortDescriptors);
+        }
+    }
+    if (!useCollation) {
+        [indexKeys sortUsingSelector:@selector(localizedCaseInsensitiveCompare:)];
+    }
+    for (NSString *key in indexKeys) {
+        FBGraphObjectTableDataSourceIndexRows([[columnsByKey objectForKey:key] objectAtIndex:0], key, sectionKeysByID, rowsByIDForSectionKey);
+    }
+}
+
 @interface FBGraphObjectTableDataSource ()
 
-@property (nonatomic, retain) NSArray *data;
-@property (nonatomic, retain) NSArray *indexKeys;
-@property (nonatomic, retain) NSDictionary *indexMap;
+@property (nonatomic, retain) NSMutableArray *data;
+// The section key of each item in data, by position, worked out as items are appended
+// so regrouping never goes back to the collation
+@property (nonatomic, retain) NSMutableArray *dataSectionKeys;
+@property (nonatomic, retain) NSMutableArray *indexKeys;
+@property (nonatomic, retain) NSMutableDictionary *indexMap;
+// How many of data's items indexMap already accounts for, how many it is showing, and
+// whether a property change means it has to be built again from scratch
+@property (nonatomic, assign) NSUInteger indexedCount;
+@property (nonatomic, assign) NSInteger objectsShown;
+@property (nonatomic, assign) BOOL indexIsStale;
+// Reverse lookup from graph object ID to the key of its section, and per section
+// key from ID to row, kept up to date with indexMap
+@property (nonatomic, retain) NSMutableDictionary *sectionKeysByID;
+@property (nonatomic, retain) NSMutableDictionary *rowsByIDForSectionKey;
+// Bumped by every update, so an asynchronous one can tell it has been superseded
+@property (nonatomic, assign) NSUInteger updateGeneration;
+@property (nonatomic, assign) BOOL asyncUpdatePending;
 @property (nonatomic, retain) NSMutableSet *pendingURLConnections;
+// Picture requests waiting for a connection, most recently asked for first, and the ones
+// with a connection running, along with how many are running per host
+@property (nonatomic, retain) NSMutableArray *queuedImageRequests;
+@property (nonatomic, retain) NSMutableArray *activeImageRequests;
+@property (nonatomic, retain) NSCountedSet *imageConnectionHosts;
 @property (nonatomic, assign) BOOL expectingMoreGraphObjects;
 @property (nonatomic, retain) UILocalizedIndexedCollation *collation;
 @property (nonatomic, assign) BOOL showSections;
+// Set while data and the index come from a snapshot rather than from appended objects
+@property (nonatomic, assign) BOOL showingSnapshot;
+// Built over data the first time searchText is used, and extended as data grows
+@property (nonatomic, retain) FBGraphObjectSearchIndex *searchIndex;
+@property (nonatomic, retain) id cancellationRegistration;
 
 - (BOOL)filterIncludesItem:(FBGraphObject *)item;
+- (NSString *)snapshotSettings;
+- (NSIndexSet *)indexesMatchingSearchText;
 - (FBGraphObjectTableCell *)cellWithTableView:(UITableView *)tableView;
 - (NSString *)indexKeyOfItem:(FBGraphObject *)item;
+- (NSString *)sectionKeyOfItemAtIndex:(NSUInteger)index;
 - (UIImage *)tableView:(UITableView *)tableView imageForItem:(FBGraphObject *)item;
 - (void)addOrRemovePendingConnection:(FBURLConnection *)connection;
+- (void)startImageRequest:(NSDictionary *)imageRequest;
+- (void)finishImageRequestWithConnection:(FBURLConnection *)connection host:(NSString *)host;
+- (void)startQueuedImageRequests;
+- (void)cancelOffscreenImageRequests;
+- (BOOL)isImageRequestVisible:(NSDictionary *)imageRequest;
 - (BOOL)isActivityIndicatorIndexPath:(NSIndexPath *)indexPath;
 - (BOOL)isLastSection:(NSInteger)section;
+- (void)rebuildIndex;
+- (NSInteger)groupItemsIntoIndexMap:(NSMutableDictionary *)indexMap indexKeys:(NSMutableArray *)indexKeys;
+- (void)indexAppendedItems;
+- (void)addSectionKey:(NSString *)key toIndexKeys:(NSMutableArray *)indexKeys;
+- (void)reindexRowsOfSectionKey:(NSString *)key;
 
 @end
 
@@ -52,6 +391,45 @@ static const NSInteger kMinimumCountToCollate = 6;
     if (_useCollation != useCollation) {
         _useCollation = useCollation;
         self.collation = _useCollation ? [UILocalizedIndexedCollation currentCollation] : nil;
+        self.dataSectionKeys = nil;
+        self.indexIsStale = YES;
+    }
+}
+
+- (void)setGroupByField:(NSString *)groupByField
+{
+    if (_groupByField != groupByField) {
+        [_groupByField release];
+        _groupByField = [groupByField copy];
+        self.dataSectionKeys = nil;
+        self.indexIsStale = YES;
+    }
+}
+
+- (void)setData:(NSMutableArray *)data
+{
+    if (_data != data) {
+        [_data release];
+        _data = [data retain];
+        self.dataSectionKeys = nil;
+    }
+}
+
+- (void)setSearchText:(NSString *)searchText
+{
+    if (_searchText != searchText) {
+        [_searchText release];
+        _searchText = [searchText copy];
+        self.indexIsStale = YES;
+    }
+}
+
+- (void)setSortDescriptors:(NSArray *)sortDescriptors
+{
+    if (_sortDescriptors != sortDescriptors) {
+        [_sortDescriptors release];
+        _sortDescriptors = [sortDescriptors copy];
+        self.indexIsStale = YES;
     }
 }
 
@@ -63,6 +441,9 @@ static const NSInteger kMinimumCountToCollate = 6;
         NSMutableSet *pendingURLConnections = [[NSMutableSet alloc] init];
         self.pendingURLConnections = pendingURLConnections;
         [pendingURLConnections release];
+        self.queuedImageRequests = [NSMutableArray array];
+        self.activeImageRequests = [NSMutableArray array];
+        self.imageConnectionHosts = [NSCountedSet set];
         self.expectingMoreGraphObjects = YES;
     }
 
@@ -75,13 +456,25 @@ static const NSInteger kMinimumCountToCollate = 6;
                      FBLoggingBehaviorDeveloperErrors,
                      @"FBGraphObjectTableDataSource pending connection did not retain self");
 
+    [_activeImageRequests release];
     [_collation release];
     [_data release];
+    [_dataSectionKeys release];
     [_defaultPicture release];
     [_groupByField release];
+    [_imageConnectionHosts release];
     [_indexKeys release];
     [_indexMap release];
     [_pendingURLConnections release];
+    [_queuedImageRequests release];
+    [_rowsByIDForSectionKey release];
+    [_searchIndex release];
+    [_searchText release];
+    [_networkFeature release];
+    [_cancellationToken unregisterCancellationObserver:_cancellationRegistration];
+    [_cancellationToken release];
+    [_cancellationRegistration release];
+    [_sectionKeysByID release];
     [_sortDescriptors release];
 
     [super dealloc];
@@ -130,21 +523,38 @@ static const NSInteger kMinimumCountToCollate = 6;
 
 - (void)prepareForNewRequest {
     self.data = nil;
+    self.showingSnapshot = NO;
+    self.searchIndex = nil;
+    self.indexedCount = 0;
+    self.indexIsStale = YES;
     self.expectingMoreGraphObjects = YES;
 }
 
 - (void)clearGraphObjects {
     self.indexKeys = nil;
     self.indexMap = nil;
+    self.sectionKeysByID = nil;
+    self.rowsByIDForSectionKey = nil;
     [self prepareForNewRequest];
 }
 
 - (void)appendGraphObjects:(NSArray *)data
 {
+    if (self.showingSnapshot) {
+        // what is loaded replaces the snapshot rather than adding to it
+        self.showingSnapshot = NO;
+        self.data = nil;
+        self.searchIndex = nil;
+        self.indexIsStale = YES;
+    }
     if (self.data) {
-        self.data = [self.data arrayByAddingObjectsFromArray:data];
-    } else {
-        self.data = data;
+        [self.data addObjectsFromArray:data];
+    } else if (data) {
+        self.data = [NSMutableArray arrayWithArray:data];
+    }
+    if (self.data.count) {
+        // collating now spares every later regroup from doing it
+        [self sectionKeyOfItemAtIndex:self.data.count - 1];
     }
     if (data == nil) {
         self.expectingMoreGraphObjects = NO;
@@ -152,7 +562,168 @@ static const NSInteger kMinimumCountToCollate = 6;
 }
 
 - (BOOL)hasGraphObjects {
-    return self.data && self.data.count > 0;
+    return !self.showingSnapshot && self.data && self.data.count > 0;
+}
+
+- (NSSet *)graphObjectIDs {
+    NSMutableSet *objectIDs = [NSMutableSet setWithCapacity:self.data.count];
+    for (FBGraphObject *item in self.data) {
+        id objectID = [item objectForKey:@"id"];
+        if ([objectID isKindOfClass:[NSString class]]) {
+            [objectIDs addObject:objectID];
+        }
+    }
+    return objectIDs;
+}
+
+- (void)removeGraphObjectsWithIDs:(NSSet *)objectIDs {
+    if (!objectIDs.count || !self.data) {
+        return;
+    }
+
+    // the section keys of the items kept stay good, so carry them over
+    NSUInteger keyCount = self.dataSectionKeys.count;
+    NSMutableArray *data = [NSMutableArray arrayWithCapacity:self.data.count];
+    NSMutableArray *dataSectionKeys = [NSMutableArray arrayWithCapacity:keyCount];
+    NSUInteger count = self.data.count;
+    for (NSUInteger i = 0; i < count; i++) {
+        FBGraphObject *item = [self.data objectAtIndex:i];
+        if ([objectIDs containsObject:[item objectForKey:@"id"] ?: [NSNull null]]) {
+            continue;
+        }
+        [data addObject:item];
+        if (i < keyCount && dataSectionKeys.count == data.count - 1) {
+            [dataSectionKeys addObject:[self.dataSectionKeys objectAtIndex:i]];
+        }
+    }
+
+    self.data = data;
+    self.dataSectionKeys = dataSectionKeys;
+    self.searchIndex = nil;
+    self.indexedCount = 0;
+    self.indexIsStale = YES;
+}
+
+// Sections are only worth restoring if they were grouped and sorted the way they would be now
+- (NSString *)snapshotSettings
+{
+    NSMutableArray *sortKeys = [NSMutableArray array];
+    for (NSSortDescriptor *descriptor in self.sortDescriptors) {
+        [sortKeys addObject:[NSString stringWithFormat:@"%@%@", descriptor.ascending ? @"+" : @"-", descriptor.key]];
+    }
+    return [NSString stringWithFormat:@"%@|%@|%d|%@",
+            self.groupByField ?: @"",
+            [sortKeys componentsJoinedByString:@","],
+            self.useCollation,
+            [[NSLocale currentLocale] localeIdentifier]];
+}
+
+- (void)writeSnapshotToCacheURL:(NSURL *)url
+{
+    if (!self.indexMap || self.indexIsStale || self.asyncUpdatePending || self.searchText.length) {
+        return;
+    }
+
+    // The items are copied here, on the main thread that changes them, and only the
+    // copies are encoded in the background
+    NSArray *indexKeys = [[self.indexKeys copy] autorelease];
+    NSMutableArray *sections = [NSMutableArray arrayWithCapacity:indexKeys.count];
+    for (NSString *key in indexKeys) {
+        [sections addObject:FBGraphObjectTableDataSourcePlainCopy([self.indexMap objectForKey:key])];
+    }
+    NSDictionary *snapshot = @{kSnapshotSettingsKey: [self snapshotSettings],
+                               kSnapshotSectionKeysKey: indexKeys,
+                               kSnapshotSectionsKey: sections};
+
+    // encoding thousands of items is best kept off the main thread
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneBackground), ^{
+        NSData *data = [NSJSONSerialization dataWithJSONObject:snapshot options:0 error:nil];
+        if (data) {
+            [[FBDataDiskCache sharedCache] setData:data forURL:url];
+        }
+    });
+}
+
+- (void)restoreSnapshotFromCacheURL:(NSURL *)url completion:(void (^)(BOOL restored))completion
+{
+    NSString *settings = [self snapshotSettings];
+    void (^completionCopy)(BOOL) = [[completion copy] autorelease];
+
+    [[FBDataDiskCache sharedCache] dataForURL:url completion:^(NSData *cachedData) {
+        if (!cachedData) {
+            if (completionCopy) {
+                completionCopy(NO);
+            }
+            return;
+        }
+
+        dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneUserInteractive), ^{
+            // Sections are stored already grouped and sorted, so restoring is parsing
+            // plus the reverse lookup; nothing is grouped or sorted again.
+            id snapshot = [NSJSONSerialization JSONObjectWithData:cachedData options:0 error:nil];
+            NSArray *indexKeys = nil;
+            NSArray *sections = nil;
+            if ([snapshot isKindOfClass:[NSDictionary class]] &&
+                [settings isEqual:[snapshot objectForKey:kSnapshotSettingsKey]]) {
+                indexKeys = [snapshot objectForKey:kSnapshotSectionKeysKey];
+                sections = [snapshot objectForKey:kSnapshotSectionsKey];
+            }
+
+            NSMutableArray *data = [NSMutableArray array];
+            NSMutableArray *dataSectionKeys = [NSMutableArray array];
+            NSMutableDictionary *indexMap = [NSMutableDictionary dictionary];
+            NSMutableDictionary *sectionKeysByID = [NSMutableDictionary dictionary];
+            NSMutableDictionary *rowsByIDForSectionKey = [NSMutableDictionary dictionary];
+            BOOL valid = [indexKeys isKindOfClass:[NSArray class]] &&
+                         [sections isKindOfClass:[NSArray class]] &&
+                         indexKeys.count == sections.count;
+            for (NSUInteger i = 0; valid && i < indexKeys.count; i++) {
+                NSString *key = [indexKeys objectAtIndex:i];
+                NSArray *rawSection = [sections objectAtIndex:i];
+                if (![key isKindOfClass:[NSString class]] || ![rawSection isKindOfClass:[NSArray class]]) {
+                    valid = NO;
+                    break;
+                }
+                NSMutableArray *section = [NSMutableArray arrayWithCapacity:rawSection.count];
+                for (id rawItem in rawSection) {
+                    if (![rawItem isKindOfClass:[NSDictionary class]]) {
+                        valid = NO;
+                        break;
+                    }
+                    [section addObject:[FBGraphObject graphObjectWrappingDictionary:rawItem]];
+                    [dataSectionKeys addObject:key];
+                }
+                [indexMap setObject:section forKey:key];
+                [data addObjectsFromArray:section];
+                FBGraphObjectTableDataSourceIndexRows(FBGraphObjectTableDataSourceItemIDs(section), key,
+                                                      sectionKeysByID, rowsByIDForSectionKey);
+            }
+
+            dispatch_async(dispatch_get_main_queue(), ^{
+                // anything loaded in the meantime is newer than the snapshot
+                BOOL restore = valid && !self.data && [settings isEqualToString:[self snapshotSettings]];
+                if (restore) {
+                    self.updateGeneration++;
+                    self.asyncUpdatePending = NO;
+                    self.data = data;
+                    self.dataSectionKeys = dataSectionKeys;
+                    self.showingSnapshot = YES;
+                    self.searchIndex = nil;
+                    self.indexKeys = [[indexKeys mutableCopy] autorelease];
+                    self.indexMap = indexMap;
+                    self.objectsShown = data.count;
+                    self.indexedCount = data.count;
+                    self.indexIsStale = NO;
+                    self.sectionKeysByID = sectionKeysByID;
+                    self.rowsByIDForSectionKey = rowsByIDForSectionKey;
+                    self.showSections = self.objectsShown >= kMinimumCountToCollate;
+                }
+                if (completionCopy) {
+                    completionCopy(restore);
+                }
+            });
+        });
+    }];
 }
 
 - (void)bindTableView:(UITableView *)tableView
@@ -161,10 +732,31 @@ static const NSInteger kMinimumCountToCollate = 6;
     tableView.rowHeight = [FBGraphObjectTableCell rowHeight];
 }
 
+- (void)setCancellationToken:(FBCancellationToken *)cancellationToken
+{
+    if (cancellationToken == _cancellationToken) {
+        return;
+    }
+    [_cancellationToken unregisterCancellationObserver:self.cancellationRegistration];
+    self.cancellationRegistration = nil;
+    [_cancellationToken release];
+    _cancellationToken = [cancellationToken retain];
+
+    // Unretained; replacing the token or dealloc unregisters the block first
+    __block FBGraphObjectTableDataSource *dataSource = self;
+    self.cancellationRegistration = [cancellationToken registerCancellationObserverWithBlock:^{
+        [dataSource cancelPendingRequests];
+    }];
+}
+
 - (void)cancelPendingRequests
 {
-    // Cancel all active connections.
-    for (FBURLConnection *connection in _pendingURLConnections) {
+    // Drop the queued picture requests first so cancelling doesn't start them
+    [self.queuedImageRequests removeAllObjects];
+
+    // Cancel all active connections.  Cancelling calls the handler, which removes the
+    // connection from the set, so go through a copy.
+    for (FBURLConnection *connection in [[_pendingURLConnections copy] autorelease]) {
         [connection cancel];
     }
 }
@@ -180,20 +772,171 @@ static const NSInteger kMinimumCountToCollate = 6;
 // to do reverse mapping from item to table location.
 //
 // To facilitate both of these, we build an array of section titles,
-// and a dictionary mapping title -> item array.  We could consider
-// building a reverse-lookup map too, but this seems unnecessary.
+// and a dictionary mapping title -> item array.  Alongside those we keep
+// a reverse-lookup map from graph object ID to section and row.
+//
+// When the only change since the last update is newly appended items,
+// as with each page the paging loader adds, those items are merged into
+// the sections they belong to instead of everything being regrouped and
+// re-sorted.  An update with nothing appended rebuilds from scratch, since
+// that is how a change in the filter is picked up.
 - (void)update
 {
-    NSInteger objectsShown = 0;
-    NSMutableDictionary *indexMap = [[[NSMutableDictionary alloc] init] autorelease];
-    NSMutableArray *indexKeys = [[[NSMutableArray alloc] init] autorelease];
+    self.updateGeneration++;
+    if (self.asyncUpdatePending || self.indexIsStale || !self.indexMap || self.indexedCount >= self.data.count) {
+        self.asyncUpdatePending = NO;
+        [self rebuildIndex];
+    } else {
+        [self indexAppendedItems];
+    }
+}
 
-    for (FBGraphObject *item in self.data) {
-        if (![self filterIncludesItem:item]) {
+// The filter and section keys come from the delegate and UIKit, so they are still
+// worked out here on the main thread; the sorting and reverse lookup happen in the
+// background.
+- (void)updateWithCompletion:(void (^)(void))completion
+{
+    if (!self.asyncUpdatePending && !self.indexIsStale && self.indexMap && self.indexedCount < self.data.count) {
+        // merging appended items is cheap enough to just do
+        [self update];
+        if (completion) {
+            dispatch_async(dispatch_get_main_queue(), completion);
+        }
+        return;
+    }
+
+    NSUInteger generation = ++self.updateGeneration;
+    self.asyncUpdatePending = YES;
+    // a property change from here on leaves the snapshot stale again once it lands
+    self.indexIsStale = NO;
+
+    NSMutableDictionary *indexMap = [NSMutableDictionary dictionary];
+    NSMutableArray *indexKeys = [NSMutableArray array];
+    NSInteger objectsShown = [self groupItemsIntoIndexMap:indexMap indexKeys:indexKeys];
+    NSUInteger indexedCount = self.data.count;
+    NSArray *sortDescriptors = self.sortDescriptors;
+    BOOL useCollation = self.useCollation;
+    // the items may change while the sort runs, so it only gets to see copies of the values
+    NSDictionary *columnsByKey = FBGraphObjectTableDataSourceSnapshotSections(indexMap, sortDescriptors);
+    void (^completionCopy)(void) = [[completion copy] autorelease];
+
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneUserInteractive), ^{
+        NSMutableDictionary *sectionKeysByID = [NSMutableDictionary dictionaryWithCapacity:objectsShown];
+        NSMutableDictionary *rowsByIDForSectionKey = [NSMutableDictionary dictionaryWithCapacity:indexKeys.count];
+        FBGraphObjectTableDataSourceFinishIndex(indexMap, indexKeys, columnsByKey, sortDescriptors, useCollation,
+                                                sectionKeysByID, rowsByIDForSectionKey);
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (self.updateGeneration != generation) {
+                // a later update has already replaced this one
+                return;
+            }
+            self.asyncUpdatePending = NO;
+            self.showSections = objectsShown >= kMinimumCountToCollate;
+            self.indexKeys = indexKeys;
+            self.indexMap = indexMap;
+            self.objectsShown = objectsShown;
+            self.indexedCount = indexedCount;
+            self.sectionKeysByID = sectionKeysByID;
+            self.rowsByIDForSectionKey = rowsByIDForSectionKey;
+            if (completionCopy) {
+                completionCopy();
+            }
+        });
+    });
+}
+
+- (void)updateTableView:(UITableView *)tableView
+{
+    NSUInteger indexedCount = self.indexedCount;
+    if (!tableView || self.asyncUpdatePending || self.indexIsStale || !self.indexMap || indexedCount >= self.data.count) {
+        [self update];
+        [tableView reloadData];
+        return;
+    }
+
+    // What the table is showing now, by section key
+    NSArray *oldKeys = self.useCollation ? self.collation.sectionTitles : [[self.indexKeys copy] autorelease];
+    NSMutableDictionary *oldCounts = [NSMutableDictionary dictionaryWithCapacity:oldKeys.count];
+    for (NSString *key in oldKeys) {
+        [oldCounts setObject:[NSNumber numberWithUnsignedInteger:[[self.indexMap objectForKey:key] count]]
+                      forKey:key];
+    }
+    BOOL oldShowSections = self.showSections;
+    BOOL showsActivityIndicator = self.expectingMoreGraphObjects && self.dataNeededDelegate;
+
+    // The appended items are matched by identity, since they may share IDs with others
+    NSArray *appended = [self.data subarrayWithRange:NSMakeRange(indexedCount, self.data.count - indexedCount)];
+    CFMutableSetRef appendedItems = CFSetCreateMutable(kCFAllocatorDefault, appended.count, NULL);
+    for (id item in appended) {
+        CFSetAddValue(appendedItems, item);
+    }
+
+    [self update];
+
+    // Headers and index titles come and go with showSections, so those changes reload
+    if (oldKeys.count == 0 || self.showSections != oldShowSections) {
+        CFRelease(appendedItems);
+        [tableView reloadData];
+        return;
+    }
+
+    NSArray *newKeys = self.useCollation ? self.collation.sectionTitles : self.indexKeys;
+    NSMutableIndexSet *insertedSections = [NSMutableIndexSet indexSet];
+    NSMutableIndexSet *reloadedSections = [NSMutableIndexSet indexSet];
+    NSMutableArray *insertedRows = [NSMutableArray array];
+    for (NSUInteger sectionIndex = 0; sectionIndex < newKeys.count; sectionIndex++) {
+        NSString *key = [newKeys objectAtIndex:sectionIndex];
+        NSArray *section = [self.indexMap objectForKey:key];
+        NSNumber *oldCount = [oldCounts objectForKey:key];
+        if (!oldCount) {
+            [insertedSections addIndex:sectionIndex];
+        } else if (section.count == oldCount.unsignedIntegerValue) {
+            continue;
+        } else if (oldCount.unsignedIntegerValue == 0) {
+            // An empty collation section gains its header along with its first rows.
+            // Collation sections never move, so the index is the same before and after.
+            [reloadedSections addIndex:sectionIndex];
+        } else {
+            for (NSUInteger row = 0; row < section.count; row++) {
+                if (CFSetContainsValue(appendedItems, [section objectAtIndex:row])) {
+                    [insertedRows addObject:[NSIndexPath indexPathForRow:row inSection:sectionIndex]];
+                }
+            }
+        }
+    }
+    CFRelease(appendedItems);
+
+    // A new last section takes the activity indicator row with it
+    NSArray *deletedRows = nil;
+    if (showsActivityIndicator && ![[newKeys lastObject] isEqual:[oldKeys lastObject]]) {
+        NSUInteger oldLastSection = oldKeys.count - 1;
+        NSUInteger oldLastCount = [[oldCounts objectForKey:[oldKeys lastObject]] unsignedIntegerValue];
+        deletedRows = @[[NSIndexPath indexPathForRow:oldLastCount inSection:oldLastSection]];
+    }
+
+    [tableView beginUpdates];
+    if (deletedRows) {
+        [tableView deleteRowsAtIndexPaths:deletedRows withRowAnimation:UITableViewRowAnimationFade];
+    }
+    [tableView insertSections:insertedSections withRowAnimation:UITableViewRowAnimationFade];
+    [tableView reloadSections:reloadedSections withRowAnimation:UITableViewRowAnimationFade];
+    [tableView insertRowsAtIndexPaths:insertedRows withRowAnimation:UITableViewRowAnimationFade];
+    [tableView endUpdates];
+}
+
+- (NSInteger)groupItemsIntoIndexMap:(NSMutableDictionary *)indexMap indexKeys:(NSMutableArray *)indexKeys
+{
+    NSInteger objectsShown = 0;
+    NSIndexSet *matches = [self indexesMatchingSearchText];
+    NSUInteger count = self.data.count;
+    for (NSUInteger i = 0; i < count; i++) {
+        FBGraphObject *item = [self.data objectAtIndex:i];
+        if ((matches && ![matches containsIndex:i]) || ![self filterIncludesItem:item]) {
             continue;
         }
 
-        NSString *key = [self indexKeyOfItem:item];
+        NSString *key = [self sectionKeyOfItemAtIndex:i];
         NSMutableArray *existingSection = [indexMap objectForKey:key];
         NSMutableArray *section = existingSection;
 
@@ -208,23 +951,123 @@ static const NSInteger kMinimumCountToCollate = 6;
         }
         objectsShown++;
     }
+    return objectsShown;
+}
 
-    if (self.sortDescriptors) {
-        for (NSString *key in indexKeys) {
-            [[indexMap objectForKey:key] sortUsingDescriptors:self.sortDescriptors];
-        }
-    }
-    if (!self.useCollation) {
-        [indexKeys sortUsingSelector:@selector(localizedCaseInsensitiveCompare:)];
-    }
+- (void)rebuildIndex
+{
+    NSMutableDictionary *indexMap = [[[NSMutableDictionary alloc] init] autorelease];
+    NSMutableArray *indexKeys = [[[NSMutableArray alloc] init] autorelease];
+    NSInteger objectsShown = [self groupItemsIntoIndexMap:indexMap indexKeys:indexKeys];
+
+    NSMutableDictionary *sectionKeysByID = [NSMutableDictionary dictionaryWithCapacity:objectsShown];
+    NSMutableDictionary *rowsByIDForSectionKey = [NSMutableDictionary dictionaryWithCapacity:indexKeys.count];
+    FBGraphObjectTableDataSourceFinishIndex(indexMap, indexKeys,
+                                            FBGraphObjectTableDataSourceSnapshotSections(indexMap, self.sortDescriptors),
+                                            self.sortDescriptors, self.useCollation,
+                                            sectionKeysByID, rowsByIDForSectionKey);
 
     self.showSections = objectsShown >= kMinimumCountToCollate;
     self.indexKeys = indexKeys;
     self.indexMap = indexMap;
+    self.objectsShown = objectsShown;
+    self.indexedCount = self.data.count;
+    self.indexIsStale = NO;
+    self.sectionKeysByID = sectionKeysByID;
+    self.rowsByIDForSectionKey = rowsByIDForSectionKey;
+}
+
+- (void)indexAppendedItems
+{
+    NSUInteger count = self.data.count;
+    NSMutableDictionary *addedByKey = [NSMutableDictionary dictionary];
+    NSMutableArray *addedKeys = [NSMutableArray array];
+    NSIndexSet *matches = [self indexesMatchingSearchText];
+
+    for (NSUInteger i = self.indexedCount; i < count; i++) {
+        FBGraphObject *item = [self.data objectAtIndex:i];
+        if ((matches && ![matches containsIndex:i]) || ![self filterIncludesItem:item]) {
+            continue;
+        }
+
+        NSString *key = [self sectionKeyOfItemAtIndex:i];
+        NSMutableArray *added = [addedByKey objectForKey:key];
+        if (!added) {
+            added = [NSMutableArray array];
+            [addedByKey setObject:added forKey:key];
+            [addedKeys addObject:key];
+        }
+        [added addObject:item];
+        self.objectsShown++;
+    }
+
+    // only the sections that gained items are touched
+    for (NSString *key in addedKeys) {
+        NSMutableArray *added = [addedByKey objectForKey:key];
+        if (self.sortDescriptors) {
+            FBGraphObjectTableDataSourceSortItems(added, self.sortDescriptors);
+        }
+
+        NSMutableArray *section = [self.indexMap objectForKey:key];
+        if (!section) {
+            [self.indexMap setObject:added forKey:key];
+            [self addSectionKey:key toIndexKeys:self.indexKeys];
+        } else if (self.sortDescriptors) {
+            FBGraphObjectTableDataSourceMergeSortedItems(section, added, self.sortDescriptors);
+        } else {
+            [section addObjectsFromArray:added];
+        }
+        // rows after any insertion point have moved
+        [self reindexRowsOfSectionKey:key];
+    }
+
+    self.showSections = self.objectsShown >= kMinimumCountToCollate;
+    self.indexedCount = count;
+}
+
+- (void)reindexRowsOfSectionKey:(NSString *)key
+{
+    FBGraphObjectTableDataSourceIndexRows(FBGraphObjectTableDataSourceItemIDs([self.indexMap objectForKey:key]),
+                                          key,
+                                          self.sectionKeysByID,
+                                          self.rowsByIDForSectionKey);
+}
+
+- (void)addSectionKey:(NSString *)key toIndexKeys:(NSMutableArray *)indexKeys
+{
+    if (self.useCollation) {
+        [indexKeys addObject:key];
+        return;
+    }
+    NSUInteger index = [indexKeys indexOfObject:key
+                                  inSortedRange:NSMakeRange(0, indexKeys.count)
+                                        options:NSBinarySearchingInsertionIndex
+                                usingComparator:^NSComparisonResult(id obj1, id obj2) {
+                                    return [obj1 localizedCaseInsensitiveCompare:obj2];
+                                }];
+    [indexKeys insertObject:key atIndex:index];
 }
 
 #pragma mark - Private Methods
 
+// Positions in data of the items matching searchText, or nil when there is no search
+- (NSIndexSet *)indexesMatchingSearchText
+{
+    if (!self.searchText.length) {
+        return nil;
+    }
+    if (!self.searchIndex) {
+        FBGraphObjectSearchIndex *searchIndex = [[FBGraphObjectSearchIndex alloc] initWithField:kSearchField];
+        self.searchIndex = searchIndex;
+        [searchIndex release];
+    }
+    NSUInteger indexedCount = self.searchIndex.indexedCount;
+    if (indexedCount < self.data.count) {
+        [self.searchIndex addItems:[self.data subarrayWithRange:NSMakeRange(indexedCount, self.data.count - indexedCount)]];
+    }
+    return [self.searchIndex indexesOfItemsMatchingSearchText:self.searchText];
+}
+
 - (BOOL)filterIncludesItem:(FBGraphObject *)item
 {
     if (![self.controllerDelegate respondsToSelector:
@@ -292,6 +1135,20 @@ static const NSInteger kMinimumCountToCollate = 6;
     return text;
 }
 
+// Works out the section keys of data's items up to and including index, if that
+// hasn't been done yet, and returns the one at index when there is one.
+- (NSString *)sectionKeyOfItemAtIndex:(NSUInteger)index
+{
+    if (!self.dataSectionKeys) {
+        self.dataSectionKeys = [NSMutableArray arrayWithCapacity:self.data.count];
+    }
+    NSUInteger count = MIN(index + 1, self.data.count);
+    for (NSUInteger i = self.dataSectionKeys.count; i < count; i++) {
+        [self.dataSectionKeys addObject:[self indexKeyOfItem:[self.data objectAtIndex:i]]];
+    }
+    return (index < self.dataSectionKeys.count) ? [self.dataSectionKeys objectAtIndex:index] : nil;
+}
+
 - (FBGraphObject *)itemAtIndexPath:(NSIndexPath *)indexPath
 {
     id key = nil;
@@ -310,6 +1167,23 @@ static const NSInteger kMinimumCountToCollate = 6;
 
 - (NSIndexPath *)indexPathForItem:(FBGraphObject *)item
 {
+    id itemID = [item objectForKey:@"id"];
+    if ([itemID isKindOfClass:[NSString class]] && self.sectionKeysByID) {
+        NSString *key = [self.sectionKeysByID objectForKey:itemID];
+        NSNumber *row = [[self.rowsByIDForSectionKey objectForKey:key] objectForKey:itemID];
+        if (!row) {
+            return nil;
+        }
+        NSUInteger sectionIndex = self.useCollation ?
+            [self.collation.sectionTitles indexOfObject:key] :
+            [self.indexKeys indexOfObject:key];
+        if (sectionIndex == NSNotFound) {
+            return nil;
+        }
+        return [NSIndexPath indexPathForRow:row.unsignedIntegerValue inSection:sectionIndex];
+    }
+
+    // objects without an ID can only match themselves, so look for them the long way
     NSString *key = [self indexKeyOfItem:item];
     NSMutableArray *sectionItems = [self.indexMap objectForKey:key];
     if (!sectionItems) {
@@ -378,47 +1252,140 @@ static const NSInteger kMinimumCountToCollate = 6;
     NSArray *sectionItems = [self.indexMap objectForKey:key];
     return sectionItems;
 }
+// Pictures are only downloaded a few at a time per host.  Requests beyond that wait,
+// newest first, and are dropped if their row is off screen by the time a slot frees up;
+// a new request that has to wait also cancels downloads for rows that have scrolled away.
+// A row that comes back on screen asks again from tableView:cellForRowAtIndexPath:.
 - (UIImage *)tableView:(UITableView *)tableView imageForItem:(FBGraphObject *)item
 {
-    __block UIImage *image = nil;
     NSString *urlString = [self.controllerDelegate graphObjectTableDataSource:self
                                                              pictureUrlOfItem:item];
-    if (urlString) {
-        FBURLConnectionHandler handler =
-        ^(FBURLConnection *connection, NSError *error, NSURLResponse *response, NSData *data) {
-            [self addOrRemovePendingConnection:connection];
-            if (!error) {
-                image = [UIImage imageWithData:data];
+    NSURL *url = urlString ? [NSURL URLWithString:urlString] : nil;
+
+    // A picture this object has already decoded for a cell can be returned right away.
+    UIImage *image = [[FBImageDecoder sharedDecoder] cachedImageForKey:url.absoluteString
+                                                                  size:[FBGraphObjectTableCell pictureSize]
+                                                               filling:YES];
+    if (url && !image && !self.cancellationToken.isCancellationRequested) {
+        NSDictionary *imageRequest = [NSDictionary dictionaryWithObjectsAndKeys:
+                                      item, kImageRequestItemKey,
+                                      url, kImageRequestURLKey,
+                                      tableView, kImageRequestTableViewKey,
+                                      nil];
+        if ([self.imageConnectionHosts countForObject:FBGraphObjectTableDataSourceImageHost(url)] < kMaximumImageConnectionsPerHost) {
+            [self startImageRequest:imageRequest];
+        } else {
+            // a cell being reused may already have asked for this item
+            for (NSUInteger i = self.queuedImageRequests.count; i-- > 0;) {
+                if ([[self.queuedImageRequests objectAtIndex:i] objectForKey:kImageRequestItemKey] == item) {
+                    [self.queuedImageRequests removeObjectAtIndex:i];
+                }
+            }
+            [self.queuedImageRequests insertObject:imageRequest atIndex:0];
+            [self cancelOffscreenImageRequests];
+        }
+    }
 
+    if (image) {
+        return image;
+    }
+
+    return self.defaultPicture;
+}
+
+- (void)startImageRequest:(NSDictionary *)imageRequest
+{
+    FBGraphObject *item = [imageRequest objectForKey:kImageRequestItemKey];
+    NSURL *url = [imageRequest objectForKey:kImageRequestURLKey];
+    UITableView *tableView = [imageRequest objectForKey:kImageRequestTableViewKey];
+    NSString *host = FBGraphObjectTableDataSourceImageHost(url);
+
+    FBURLConnectionHandler handler =
+    ^(FBURLConnection *connection, NSError *error, NSURLResponse *response, NSData *data) {
+        [self addOrRemovePendingConnection:connection];
+        if (!error) {
+            // the decoder calls back on the main thread, by when the row may have moved
+            [[FBImageDecoder sharedDecoder] decodeImageData:data
+                                                     forKey:url.absoluteString
+                                                       size:[FBGraphObjectTableCell pictureSize]
+                                                    filling:YES
+                                                 completion:^(UIImage *image) {
                 NSIndexPath *indexPath = [self indexPathForItem:item];
-                if (indexPath) {
+                if (image && indexPath) {
                     FBGraphObjectTableCell *cell =
                     (FBGraphObjectTableCell *)[tableView cellForRowAtIndexPath:indexPath];
 
                     if (cell) {
                         cell.picture = image;
+                        cell.prerenderedPictureID = url.absoluteString;
                     }
                 }
-            }
-        };
+            }];
+        }
+        [self finishImageRequestWithConnection:connection host:host];
+    };
+
+    [self.imageConnectionHosts addObject:host];
+    FBURLConnection *connection = [[[FBURLConnection alloc]
+                                    initWithURL:url
+                                    completionHandler:handler]
+                                   autorelease];
+    connection.networkFeature = self.networkFeature;
+    connection.priority = FBRequestPriorityVisibleImage;
+
+    [self addOrRemovePendingConnection:connection];
+    if ([self.pendingURLConnections containsObject:connection]) {
+        // still running, so it can be cancelled if its row scrolls away
+        NSMutableDictionary *activeRequest = [[imageRequest mutableCopy] autorelease];
+        [activeRequest setObject:connection forKey:kImageRequestConnectionKey];
+        [self.activeImageRequests addObject:activeRequest];
+    }
+}
 
-        FBURLConnection *connection = [[[FBURLConnection alloc]
-                                        initWithURL:[NSURL URLWithString:urlString]
-                                        completionHandler:handler]
-                                       autorelease];
+- (void)finishImageRequestWithConnection:(FBURLConnection *)connection host:(NSString *)host
+{
+    for (NSUInteger i = 0; i < self.activeImageRequests.count; i++) {
+        if ([[self.activeImageRequests objectAtIndex:i] objectForKey:kImageRequestConnectionKey] == connection) {
+            [self.activeImageRequests removeObjectAtIndex:i];
+            break;
+        }
+    }
+    [self.imageConnectionHosts removeObject:host];
+    [self startQueuedImageRequests];
+}
 
-        [self addOrRemovePendingConnection:connection];
+- (void)startQueuedImageRequests
+{
+    for (NSDictionary *imageRequest in [[self.queuedImageRequests copy] autorelease]) {
+        NSURL *url = [imageRequest objectForKey:kImageRequestURLKey];
+        if ([self.queuedImageRequests indexOfObjectIdenticalTo:imageRequest] == NSNotFound ||
+            [self.imageConnectionHosts countForObject:FBGraphObjectTableDataSourceImageHost(url)] >= kMaximumImageConnectionsPerHost) {
+            // already started by a handler that ran inside this loop, or no room yet
+            continue;
+        }
+        [[imageRequest retain] autorelease];
+        [self.queuedImageRequests removeObjectIdenticalTo:imageRequest];
+        if ([self isImageRequestVisible:imageRequest]) {
+            [self startImageRequest:imageRequest];
+        }
     }
+}
 
-    // If the picture had not been fetched yet by this object, but is cached in the
-    // URL cache, we can complete synchronously above.  In this case, we will not
-    // find the cell in the table because we are in the process of creating it. We can
-    // just return the object here.
-    if (image) {
-        return image;
+- (void)cancelOffscreenImageRequests
+{
+    // cancelling calls the handler, which frees the slot and starts queued requests
+    for (NSDictionary *activeRequest in [[self.activeImageRequests copy] autorelease]) {
+        if (![self isImageRequestVisible:activeRequest]) {
+            [[activeRequest objectForKey:kImageRequestConnectionKey] cancel];
+        }
     }
+}
 
-    return self.defaultPicture;
+- (BOOL)isImageRequestVisible:(NSDictionary *)imageRequest
+{
+    NSIndexPath *indexPath = [self indexPathForItem:[imageRequest objectForKey:kImageRequestItemKey]];
+    UITableView *tableView = [imageRequest objectForKey:kImageRequestTableViewKey];
+    return indexPath && [[tableView indexPathsForVisibleRows] containsObject:indexPath];
 }
 
 // In tableView:imageForItem:, there are two code-paths, and both always run.
@@ -503,7 +1470,9 @@ static const NSInteger kMinimumCountToCollate = 6;
     FBGraphObjectTableCell *cell = [self cellWithTableView:tableView];
 
     if ([self isActivityIndicatorIndexPath:indexPath]) {
+        cell.prerenderedItemID = nil;
         cell.picture = nil;
+        cell.prerenderedPictureID = nil;
         cell.subtitle = nil;
         cell.title = nil;
         cell.accessoryType = UITableViewCellAccessoryNone;
@@ -519,10 +1488,18 @@ static const NSInteger kMinimumCountToCollate = 6;
         // This is a no-op if it doesn't have an activity indicator.
         [cell stopAnimatingActivityIndicator];
         if (item) {
+            id itemID = [item objectForKey:@"id"];
+            cell.prerenderedItemID = ([FBSettings isPrerenderedPickerRowsEnabled] &&
+                                      [itemID isKindOfClass:[NSString class]]) ? itemID : nil;
+
             if (self.itemPicturesEnabled) {
-                cell.picture = [self tableView:tableView imageForItem:item];
+                UIImage *picture = [self tableView:tableView imageForItem:item];
+                cell.picture = picture;
+                cell.prerenderedPictureID = (picture == self.defaultPicture) ? kDefaultPictureID :
+                [self.controllerDelegate graphObjectTableDataSource:self pictureUrlOfItem:item];
             } else {
                 cell.picture = nil;
+                cell.prerenderedPictureID = nil;
             }
 
             if (self.itemTitleSuffixEnabled) {
@@ -556,7 +1533,9 @@ static const NSInteger kMinimumCountToCollate = 6;
                                                  customizeTableCell:cell];
             }
         } else {
+            cell.prerenderedItemID = nil;
             cell.picture = nil;
+            cell.prerenderedPictureID = nil;
             cell.subtitle = nil;
             cell.title = nil;
             cell.accessoryType = UITableViewCellAccessoryNone;
@@ -16,12 +16,23 @@
 
 #import "FBGraphObjectTableSelection.h"
 
-#import "FBUtility.h"
+// Selected items are looked up by their Graph ID, matching isGraphObjectID:sameAs:;
+// items without one only match themselves.
+static NSString *FBGraphObjectTableSelectionKey(id<FBGraphObject> item)
+{
+    id objectID = [item objectForKey:@"id"];
+    return [objectID isKindOfClass:[NSString class]] ? objectID : nil;
+}
 
-@interface FBGraphObjectTableSelection () <UITableViewDelegate, FBGraphObjectSelectionQueryDelegate>
+@interface FBGraphObjectTableSelection () <UITableViewDelegate, FBGraphObjectSelectionQueryDelegate> {
+    // In the order selected
+    NSMutableArray *_selectedItems;
+    NSMutableDictionary *_selectedItemsByID;
+    // Immutable copy of _selectedItems handed out by -selection, until it changes
+    NSArray *_selection;
+}
 
 @property (nonatomic, retain) FBGraphObjectTableDataSource *dataSource;
-@property (nonatomic, retain) NSArray *selection;
 
 @end
 
@@ -37,9 +48,8 @@
         self.dataSource = dataSource;
         self.allowsMultipleSelection = YES;
 
-        NSArray *selection = [[NSArray alloc] init];
-        self.selection = selection;
-        [selection release];
+        _selectedItems = [[NSMutableArray alloc] init];
+        _selectedItemsByID = [[NSMutableDictionary alloc] init];
     }
 
     return self;
@@ -48,16 +58,52 @@
 - (void)dealloc
 {
     _dataSource.selectionDelegate = nil;
+    [NSObject cancelPreviousPerformRequestsWithTarget:_delegate
+                                             selector:@selector(graphObjectTableSelectionDidChange:)
+                                               object:self];
 
     [_dataSource release];
+    [_selectedItems release];
+    [_selectedItemsByID release];
     [_selection release];
 
     [super dealloc];
 }
 
+- (NSArray *)selection
+{
+    if (!_selection) {
+        _selection = [_selectedItems copy];
+    }
+    return _selection;
+}
+
+- (id<FBGraphObject>)selectedItemWithSameIDAs:(id<FBGraphObject>)item
+{
+    NSString *key = FBGraphObjectTableSelectionKey(item);
+    if (key) {
+        return [_selectedItemsByID objectForKey:key];
+    }
+    return ([_selectedItems indexOfObjectIdenticalTo:item] != NSNotFound) ? item : nil;
+}
+
+- (void)selectionDidMutate
+{
+    [_selection release];
+    _selection = nil;
+}
+
 - (void)clearSelectionInTableView:(UITableView *)tableView {
-    if (self.selection.count > 0) {
-        [self deselectItems:self.selection tableView:tableView];
+    if (_selectedItems.count > 0) {
+        for (FBGraphObject *item in _selectedItems) {
+            NSIndexPath *indexPath = [self.dataSource indexPathForItem:item];
+            if (indexPath != nil) {
+                [tableView cellForRowAtIndexPath:indexPath].accessoryType = UITableViewCellAccessoryNone;
+            }
+        }
+        [_selectedItems removeAllObjects];
+        [_selectedItemsByID removeAllObjects];
+        [self selectionDidMutate];
         [self selectionChanged];
     }
 }
@@ -66,11 +112,13 @@
                     cell:(UITableViewCell *)cell
    raiseSelectionChanged:(BOOL)raiseSelectionChanged
 {
-    if ([FBUtility graphObjectInArray:self.selection withSameIDAs:item] == nil) {
-        NSMutableArray *selection = [[NSMutableArray alloc] initWithArray:self.selection];
-        [selection addObject:item];
-        self.selection = selection;
-        [selection release];
+    if ([self selectedItemWithSameIDAs:item] == nil) {
+        [_selectedItems addObject:item];
+        NSString *key = FBGraphObjectTableSelectionKey(item);
+        if (key) {
+            [_selectedItemsByID setObject:item forKey:key];
+        }
+        [self selectionDidMutate];
     }
     cell.accessoryType = UITableViewCellAccessoryCheckmark;
     if (raiseSelectionChanged) {
@@ -100,12 +148,14 @@
                     cell:(UITableViewCell *)cell
    raiseSelectionChanged:(BOOL)raiseSelectionChanged
 {
-    id<FBGraphObject> selectedItem = [FBUtility graphObjectInArray:self.selection withSameIDAs:item];
+    id<FBGraphObject> selectedItem = [self selectedItemWithSameIDAs:item];
     if (selectedItem) {
-        NSMutableArray *selection = [[NSMutableArray alloc] initWithArray:self.selection];
-        [selection removeObject:selectedItem];
-        self.selection = selection;
-        [selection release];
+        NSString *key = FBGraphObjectTableSelectionKey(selectedItem);
+        if (key) {
+            [_selectedItemsByID removeObjectForKey:key];
+        }
+        [_selectedItems removeObjectIdenticalTo:selectedItem];
+        [self selectionDidMutate];
     }
     cell.accessoryType = UITableViewCellAccessoryNone;
     if (raiseSelectionChanged) {
@@ -135,14 +185,18 @@
 {
     if ([self.delegate respondsToSelector:
          @selector(graphObjectTableSelectionDidChange:)]) {
-        // Let the table view finish updating its UI before notifying the delegate.
+        // Let the table view finish updating its UI before notifying the delegate,
+        // and fold changes made in the meantime into the same notification.
+        [NSObject cancelPreviousPerformRequestsWithTarget:self.delegate
+                                                 selector:@selector(graphObjectTableSelectionDidChange:)
+                                                   object:self];
         [self.delegate performSelector:@selector(graphObjectTableSelectionDidChange:) withObject:self afterDelay:.1];
     }
 }
 
 - (BOOL)selectionIncludesItem:(id<FBGraphObject>)item
 {
-    return [FBUtility graphObjectInArray:self.selection withSameIDAs:item] != nil;
+    return [self selectedItemWithSameIDAs:item] != nil;
 }
 
 #pragma mark - FBGraphObjectSelectionDelegate
@@ -200,7 +254,7 @@
                                self.delegate];
 
     bool firstItem = YES;
-    for (FBGraphObject *item in self.selection) {
+    for (FBGraphObject *item in _selectedItems) {
         id objectId = [item objectForKey:@"id"];
         if (!firstItem) {
             [result appendFormat:@", "];
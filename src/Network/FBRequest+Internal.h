@@ -16,6 +16,8 @@
 
 #import "FBRequest.h"
 
+@class FBRequestTemplate;
+
 @interface FBRequest ()
 
 /*!
@@ -33,4 +35,24 @@
 
 @property (readonly) NSString *versionPart;
 
+// The template the request was made from, if any; see FBRequestTemplate
+@property (retain, nonatomic) FBRequestTemplate *preparedTemplate;
+
+// Builds prefix, a "/" and path (or just path when prefix is nil), followed by
+// the query for params, in a single buffer.  Images and data are left out, as
+// by serializeURL:params:httpMethod:.
++ (NSString *)serializeURLWithPrefix:(NSString *)prefix
+                                path:(NSString *)path
+                              params:(NSDictionary *)params
+                          httpMethod:(NSString *)httpMethod;
+
+// As above, except that the query starts with encodedParams, already URL encoded, and the
+// keys of omittedParams are left out of params since encodedParams stands for them.
++ (NSString *)serializeURLWithPrefix:(NSString *)prefix
+                                path:(NSString *)path
+                              params:(NSDictionary *)params
+                          httpMethod:(NSString *)httpMethod
+                       encodedParams:(NSString *)encodedParams
+                       omittedParams:(NSDictionary *)omittedParams;
+
 @end
@@ -21,7 +21,9 @@
 #import "FBAppEvents+Internal.h"
 #import "FBGraphObject.h"
 #import "FBLogger.h"
+#import "FBMainThreadWatchdog.h"
 #import "FBSession+Internal.h"
+#import "FBTrace.h"
 #import "FBUtility.h"
 #import "Facebook.h"
 
@@ -30,6 +32,7 @@ NSString *const FBGraphBasePath = @"https://graph." FB_BASE_URL;
 
 static NSString *const kGetHTTPMethod = @"GET";
 static NSString *const kPostHTTPMethod = @"POST";
+static const NSTimeInterval kDefaultCacheMaxAge = 300.0;
 
 // ----------------------------------------------------------------------------
 // FBRequest
@@ -88,6 +91,8 @@ static NSString *const kPostHTTPMethod = @"POST";
                      HTTPMethod:(NSString *)HTTPMethod
 {
     if ((self = [super init])) {
+        FBTraceBegin(FBTracePointRequestCreate, self);
+
         // set default for nil
         if (!HTTPMethod) {
             HTTPMethod = kGetHTTPMethod;
@@ -97,6 +102,7 @@ static NSString *const kPostHTTPMethod = @"POST";
         self.graphPath = graphPath;
         self.HTTPMethod = HTTPMethod;
         self.canCloseSessionOnError = YES;
+        self.cacheMaxAge = kDefaultCacheMaxAge;
 
         // all request objects start life with a migration bundle set for the SDK
         _parameters = [[NSMutableDictionary alloc] init];
@@ -104,6 +110,8 @@ static NSString *const kPostHTTPMethod = @"POST";
             // but the incoming dictionary's migration bundle trumps the default one, if present
             [self.parameters addEntriesFromDictionary:parameters];
         }
+
+        FBTraceEnd(FBTracePointRequestCreate, self);
     }
     return self;
 }
@@ -118,6 +126,7 @@ static NSString *const kPostHTTPMethod = @"POST";
     [_parameters release];
     [_url release];
     [_versionPart release];
+    [_preparedTemplate release];
     [_connection release];
     [_responseText release];
     [_error release];
@@ -142,6 +151,7 @@ static NSString *const kPostHTTPMethod = @"POST";
 
 - (FBRequestConnection *)startWithCompletionHandler:(FBRequestHandler)handler
 {
+    FBMainThreadWatchdogMeasure();
     FBRequestConnection *connection = [self createRequestConnection];
     [connection addRequest:self completionHandler:handler];
     [connection start];
@@ -206,6 +216,25 @@ static NSString *const kPostHTTPMethod = @"POST";
     return request;
 }
 
++ (FBRequest *)requestForGraphPath:(NSString *)graphPath
+                            fields:(NSSet *)fields
+{
+    NSArray *sortedFields = [[fields allObjects] sortedArrayUsingSelector:@selector(caseInsensitiveCompare:)];
+    FBRequest *request = [[[FBRequest alloc] initWithSession:[FBSession activeSessionIfOpen]
+                                                   graphPath:graphPath
+                                                  parameters:@{ @"fields": [sortedFields componentsJoinedByString:@","] }
+                                                  HTTPMethod:nil]
+                          autorelease];
+    return request;
+}
+
++ (FBRequest *)requestForGraphPath:(NSString *)graphPath
+               projectedToProtocol:(Protocol *)protocol
+{
+    return [FBRequest requestForGraphPath:graphPath
+                                   fields:[FBGraphObject fieldsForProtocol:protocol]];
+}
+
 + (FBRequest *)requestForDeleteObject:(id)object
 {
     FBRequest *request = [[[FBRequest alloc] initWithSession:[FBSession activeSessionIfOpen]
@@ -502,27 +531,77 @@ static NSString *const kPostHTTPMethod = @"POST";
 + (NSString *)serializeURL:(NSString *)baseUrl
                     params:(NSDictionary *)params
                 httpMethod:(NSString *)httpMethod {
-
-    NSURL *parsedURL = [NSURL URLWithString:[baseUrl stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding]];
-    NSString *queryPrefix = parsedURL.query ? @"&" : @"?";
-
-    NSMutableArray *pairs = [NSMutableArray array];
-    for (NSString *key in [params keyEnumerator]) {
+    return [self serializeURLWithPrefix:nil path:baseUrl params:params httpMethod:httpMethod];
+}
+
++ (NSString *)serializeURLWithPrefix:(NSString *)prefix
+                                path:(NSString *)path
+                              params:(NSDictionary *)params
+                          httpMethod:(NSString *)httpMethod {
+    return [self serializeURLWithPrefix:prefix
+                                   path:path
+                                 params:params
+                             httpMethod:httpMethod
+                          encodedParams:nil
+                          omittedParams:nil];
+}
+
++ (NSString *)serializeURLWithPrefix:(NSString *)prefix
+                                path:(NSString *)path
+                              params:(NSDictionary *)params
+                          httpMethod:(NSString *)httpMethod
+                       encodedParams:(NSString *)encodedParams
+                       omittedParams:(NSDictionary *)omittedParams {
+    const char *prefixBytes = prefix.UTF8String;
+    const char *pathBytes = path.UTF8String;
+    size_t prefixLength = prefixBytes ? strlen(prefixBytes) : 0;
+    size_t pathLength = pathBytes ? strlen(pathBytes) : 0;
+
+    // sized for the common case of a token and a few short parameters
+    NSMutableData *url = [NSMutableData dataWithCapacity:prefixLength + pathLength + 256 + params.count * 32];
+    if (prefixBytes) {
+        [url appendBytes:prefixBytes length:prefixLength];
+        [url appendBytes:"/" length:1];
+    }
+    if (pathBytes) {
+        [url appendBytes:pathBytes length:pathLength];
+    }
+    // the prefix is only ever scheme, host and version, so any query is in the path
+    BOOL hasQuery = pathBytes && memchr(pathBytes, '?', pathLength) != NULL;
+    [url appendBytes:(hasQuery ? "&" : "?") length:1];
+
+    BOOL first = YES;
+    if (encodedParams.length) {
+        const char *encodedBytes = encodedParams.UTF8String;
+        [url appendBytes:encodedBytes length:strlen(encodedBytes)];
+        first = NO;
+    }
+    for (NSString *key in params) {
+        if (omittedParams && [omittedParams objectForKey:key]) {
+            continue;
+        }
         id value = [params objectForKey:key];
         if ([value isKindOfClass:[UIImage class]]
-            || [value isKindOfClass:[NSData class]]) {
+            || [value isKindOfClass:[NSData class]]
+            || ([value isKindOfClass:[NSURL class]] && [value isFileURL])) {
             if ([httpMethod isEqualToString:kGetHTTPMethod]) {
                 [FBLogger singleShotLogEntry:FBLoggingBehaviorDeveloperErrors logEntry:@"can not use GET to upload a file"];
             }
             continue;
         }
 
-        NSString *escaped_value = [FBUtility stringByURLEncodingString:value];
-        [pairs addObject:[NSString stringWithFormat:@"%@=%@", key, escaped_value]];
+        if (!first) {
+            [url appendBytes:"&" length:1];
+        }
+        first = NO;
+        const char *keyBytes = [key description].UTF8String;
+        [url appendBytes:keyBytes length:strlen(keyBytes)];
+        [url appendBytes:"=" length:1];
+        [FBUtility appendURLEncodedString:([value isKindOfClass:[NSString class]] ? value : [value description])
+                                   toData:url];
     }
-    NSString *query = [pairs componentsJoinedByString:@"&"];
 
-    return [NSString stringWithFormat:@"%@%@%@", baseUrl, queryPrefix, query];
+    return [[[NSString alloc] initWithData:url encoding:NSUTF8StringEncoding] autorelease];
 }
 
 #pragma mark Debugging helpers
@@ -21,20 +21,52 @@
 
 @interface FBRequestBody : NSObject
 
+// The whole body in one contiguous buffer.  Prefer newInputStream for bodies
+// with large attachments, since this has to copy all of them.
 @property (nonatomic, retain, readonly) NSData *data;
+@property (nonatomic, readonly) NSUInteger length;
+// Why the first file attachment that couldn't be read failed, if one couldn't.
+// Such a body is missing a part and shouldn't be sent.
+@property (nonatomic, retain, readonly) NSError *error;
 
 - (void)appendWithKey:(NSString *)key
             formValue:(NSString *)value
                logger:(FBLogger *)logger;
 
+// Same as appendWithKey:formValue:logger: for a value that is already UTF-8,
+// such as encoded JSON, which is appended without being transcoded.
+- (void)appendWithKey:(NSString *)key
+        formValueData:(NSData *)value
+               logger:(FBLogger *)logger;
+
 - (void)appendWithKey:(NSString *)key
            imageValue:(UIImage *)image
                logger:(FBLogger *)logger;
 
+// Same as appendWithKey:imageValue:logger: for an image that has already
+// been JPEG encoded
+- (void)appendWithKey:(NSString *)key
+        imageJPEGData:(NSData *)data
+               logger:(FBLogger *)logger;
+
 - (void)appendWithKey:(NSString *)key
             dataValue:(NSData *)data
                logger:(FBLogger *)logger;
 
+// Attaches the contents of a file URL as they are on disk, so a JPEG is sent
+// with its original bytes rather than decoded and re-encoded.  The file is
+// memory mapped and only read as the body is streamed.  A file that can't be
+// read is left out, and sets error.
+- (void)appendWithKey:(NSString *)key
+              fileURL:(NSURL *)fileURL
+               logger:(FBLogger *)logger;
+
+// Returns a new, unopened stream over the body, suitable for
+// -[NSMutableURLRequest setHTTPBodyStream:].  Attachments are read as the
+// stream is consumed rather than copied up front.  Should only be called once
+// all the parts have been appended.
+- (NSInputStream *)newInputStream;
+
 + (NSString *)mimeContentType;
 
 @end
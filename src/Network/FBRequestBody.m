@@ -16,13 +16,58 @@
 
 #import "FBRequestBody.h"
 
-#import "FBSettings+Internal.h"
+#import "FBDispatch.h"
+#import "FBUtility.h"
 
-static NSString *kStringBoundary = @"3i2ndDfv2rTHiSisAbouNdArYfORhtTPEefj3q2f";
+#define FB_REQUEST_BODY_BOUNDARY "3i2ndDfv2rTHiSisAbouNdArYfORhtTPEefj3q2f"
+
+static NSString *const kMimeContentType = @"multipart/form-data; boundary=" FB_REQUEST_BODY_BOUNDARY;
+
+// Fixed fragments of the multipart encoding, appended as raw bytes so that
+// building a body with many fields doesn't format and re-encode them each time
+static const char kBodyStart[] = "--" FB_REQUEST_BODY_BOUNDARY "\r\n";
+static const char kRecordBoundary[] = "\r\n--" FB_REQUEST_BODY_BOUNDARY "\r\n";
+static const char kDispositionPrefix[] = "Content-Disposition: form-data; name=\"";
+static const char kFormValueDispositionSuffix[] = "\"\r\n\r\n";
+static const char kFileNameDisposition[] = "\"; filename=\"";
+static const char kFileDispositionSuffix[] = "\"\r\n";
+static const char kImageContentType[] = "Content-Type: image/jpeg\r\n\r\n";
+static const char kDataContentType[] = "Content-Type: content/unknown\r\n\r\n";
+static const char kContentTypePrefix[] = "Content-Type: ";
+static const char kContentTypeSuffix[] = "\r\n\r\n";
+
+// The content type of a file attachment, from its extension: the server
+// sniffs most formats anyway, so only the common media types are named.
+static const char *FBRequestBodyContentTypeForFileURL(NSURL *fileURL)
+{
+    NSString *extension = fileURL.pathExtension.lowercaseString;
+    if ([extension isEqualToString:@"jpg"] || [extension isEqualToString:@"jpeg"]) {
+        return "image/jpeg";
+    } else if ([extension isEqualToString:@"png"]) {
+        return "image/png";
+    } else if ([extension isEqualToString:@"gif"]) {
+        return "image/gif";
+    } else if ([extension isEqualToString:@"mp4"]) {
+        return "video/mp4";
+    } else if ([extension isEqualToString:@"mov"]) {
+        return "video/quicktime";
+    }
+    return "content/unknown";
+}
+
+// Size of the buffer between the body writer and the connection reading it
+static const CFIndex kStreamBufferSize = 64 * 1024;
 
 @interface FBRequestBody ()
-@property (nonatomic, retain, readonly) NSMutableData *mutableData;
+// Form fields and headers accumulate in the last part, attachments are kept
+// as parts of their own so they never get copied into the body.
+@property (nonatomic, retain, readonly) NSMutableArray *parts;
+@property (nonatomic, retain) NSMutableData *currentPart;
+@property (nonatomic, retain, readwrite) NSError *error;
 - (void)appendUTF8:(NSString *)utf8;
+- (void)appendCString:(const char *)string;
+- (void)appendBytes:(const void *)bytes length:(NSUInteger)length;
+- (void)appendAttachmentData:(NSData *)data;
 @end
 
 @implementation FBRequestBody
@@ -30,7 +75,7 @@ static NSString *kStringBoundary = @"3i2ndDfv2rTHiSisAbouNdArYfORhtTPEefj3q2f";
 - (instancetype)init
 {
     if ((self = [super init])) {
-        _mutableData = [[NSMutableData alloc] init];
+        _parts = [[NSMutableArray alloc] init];
     }
 
     return self;
@@ -38,76 +83,209 @@ static NSString *kStringBoundary = @"3i2ndDfv2rTHiSisAbouNdArYfORhtTPEefj3q2f";
 
 - (void)dealloc
 {
-    [_mutableData release];
+    [_parts release];
+    [_currentPart release];
+    [_error release];
     [super dealloc];
 }
 
 + (NSString *)mimeContentType
 {
-    return [NSString stringWithFormat:@"multipart/form-data; boundary=%@", kStringBoundary];
+    return kMimeContentType;
 }
 
 - (void)appendUTF8:(NSString *)utf8
 {
-    if (![self.mutableData length]) {
-        NSString *headerUTF8 = [NSString stringWithFormat:@"--%@\r\n", kStringBoundary];
-        NSData *headerData = [headerUTF8 dataUsingEncoding:NSUTF8StringEncoding];
-        [self.mutableData appendData:headerData];
+    const char *bytes = utf8.UTF8String;
+    if (bytes) {
+        [self appendBytes:bytes length:strlen(bytes)];
     }
-    NSData *data = [utf8 dataUsingEncoding:NSUTF8StringEncoding];
-    [self.mutableData appendData:data];
+}
+
+- (void)appendCString:(const char *)string
+{
+    [self appendBytes:string length:strlen(string)];
+}
+
+- (void)appendBytes:(const void *)bytes length:(NSUInteger)length
+{
+    if (self.currentPart == nil) {
+        self.currentPart = [NSMutableData data];
+        [self.parts addObject:self.currentPart];
+    }
+    if (!_length) {
+        [self.currentPart appendBytes:kBodyStart length:sizeof(kBodyStart) - 1];
+        _length += sizeof(kBodyStart) - 1;
+    }
+    [self.currentPart appendBytes:bytes length:length];
+    _length += length;
+}
+
+- (void)appendAttachmentData:(NSData *)data
+{
+    if (data.length == 0) {
+        return;
+    }
+
+    [self.parts addObject:[[data copy] autorelease]];
+    self.currentPart = nil;
+    _length += data.length;
 }
 
 - (void)appendRecordBoundary
 {
-    NSString *boundary = [NSString stringWithFormat:@"\r\n--%@\r\n", kStringBoundary];
-    [self appendUTF8:boundary];
+    [self appendCString:kRecordBoundary];
+}
+
+- (void)appendFileDispositionWithKey:(NSString *)key
+{
+    [self appendFileDispositionWithKey:key fileName:key];
+}
+
+- (void)appendFileDispositionWithKey:(NSString *)key fileName:(NSString *)fileName
+{
+    [self appendCString:kDispositionPrefix];
+    [self appendUTF8:key];
+    [self appendCString:kFileNameDisposition];
+    [self appendUTF8:fileName];
+    [self appendCString:kFileDispositionSuffix];
 }
 
 - (void)appendWithKey:(NSString *)key
             formValue:(NSString *)value
                logger:(FBLogger *)logger
 {
-    NSString *disposition =
-        [NSString stringWithFormat:@"Content-Disposition: form-data; name=\"%@\"\r\n\r\n", key];
-    [self appendUTF8:disposition];
+    [self appendCString:kDispositionPrefix];
+    [self appendUTF8:key];
+    [self appendCString:kFormValueDispositionSuffix];
     [self appendUTF8:value];
     [self appendRecordBoundary];
-    [logger appendFormat:@"\n    %@:\t%@", key, (NSString *)value];
+    FBLoggerAppendFormat(logger, @"\n    %@:\t%@", key, (NSString *)value);
+}
+
+- (void)appendWithKey:(NSString *)key
+        formValueData:(NSData *)value
+               logger:(FBLogger *)logger
+{
+    [self appendCString:kDispositionPrefix];
+    [self appendUTF8:key];
+    [self appendCString:kFormValueDispositionSuffix];
+    [self appendBytes:value.bytes length:value.length];
+    [self appendRecordBoundary];
+    // Only decoded when the logger is active
+    FBLoggerAppendFormat(logger, @"\n    %@:\t%@", key,
+                         [[[NSString alloc] initWithData:value encoding:NSUTF8StringEncoding] autorelease]);
 }
 
 - (void)appendWithKey:(NSString *)key
            imageValue:(UIImage *)image
                logger:(FBLogger *)logger
 {
-    NSString *disposition =
-        [NSString stringWithFormat:@"Content-Disposition: form-data; name=\"%@\"; filename=\"%@\"\r\n", key, key];
-    [self appendUTF8:disposition];
-    [self appendUTF8:@"Content-Type: image/jpeg\r\n\r\n"];
-    NSData *data = UIImageJPEGRepresentation(image, [FBSettings defaultJPEGCompressionQuality]);
-    [self.mutableData appendData:data];
+    NSData *data = [FBUtility JPEGDataForUploadImage:image];
+    [self appendWithKey:key imageJPEGData:data logger:logger];
+}
+
+- (void)appendWithKey:(NSString *)key
+        imageJPEGData:(NSData *)data
+               logger:(FBLogger *)logger
+{
+    [self appendFileDispositionWithKey:key];
+    [self appendCString:kImageContentType];
+    [self appendAttachmentData:data];
     [self appendRecordBoundary];
-    [logger appendFormat:@"\n    %@:\t<Image - %lu kB>", key, (unsigned long)([data length] / 1024)];
+    FBLoggerAppendFormat(logger, @"\n    %@:\t<Image - %lu kB>", key, (unsigned long)([data length] / 1024));
 }
 
 - (void)appendWithKey:(NSString *)key
             dataValue:(NSData *)data
                logger:(FBLogger *)logger
 {
-    NSString *disposition =
-        [NSString stringWithFormat:@"Content-Disposition: form-data; name=\"%@\"; filename=\"%@\"\r\n", key, key];
-    [self appendUTF8:disposition];
-    [self appendUTF8:@"Content-Type: content/unknown\r\n\r\n"];
-    [self.mutableData appendData:data];
+    [self appendFileDispositionWithKey:key];
+    [self appendCString:kDataContentType];
+    [self appendAttachmentData:data];
     [self appendRecordBoundary];
-    [logger appendFormat:@"\n    %@:\t<Data - %lu kB>", key, (unsigned long)([data length] / 1024)];
+    FBLoggerAppendFormat(logger, @"\n    %@:\t<Data - %lu kB>", key, (unsigned long)([data length] / 1024));
+}
+
+- (void)appendWithKey:(NSString *)key
+              fileURL:(NSURL *)fileURL
+               logger:(FBLogger *)logger
+{
+    // Mapped rather than read, so the file's pages are only faulted in as the
+    // body stream consumes them and can be dropped again under memory pressure
+    NSError *error = nil;
+    NSData *data = [NSData dataWithContentsOfURL:fileURL
+                                         options:NSDataReadingMappedIfSafe
+                                           error:&error];
+    if (!data) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorDeveloperErrors
+                        formatString:@"Unable to read attachment %@ from %@: %@", key, fileURL.path, error];
+        if (!self.error) {
+            self.error = error;
+        }
+        return;
+    }
+
+    NSString *fileName = fileURL.lastPathComponent.length ? fileURL.lastPathComponent : key;
+    [self appendFileDispositionWithKey:key fileName:fileName];
+    [self appendCString:kContentTypePrefix];
+    [self appendCString:FBRequestBodyContentTypeForFileURL(fileURL)];
+    [self appendCString:kContentTypeSuffix];
+    [self appendAttachmentData:data];
+    [self appendRecordBoundary];
+    FBLoggerAppendFormat(logger, @"\n    %@:\t<File %@ - %lu kB>", key, fileName, (unsigned long)([data length] / 1024));
 }
 
 - (NSData *)data
 {
-    // No need to enforce immutability since this is internal-only and sdk will
-    // never cast/modify.
-    return self.mutableData;
+    if (self.parts.count == 1) {
+        // No need to enforce immutability since this is internal-only and sdk will
+        // never cast/modify.
+        return [self.parts objectAtIndex:0];
+    }
+
+    NSMutableData *data = [NSMutableData dataWithCapacity:_length];
+    for (NSData *part in self.parts) {
+        [data appendData:part];
+    }
+    return data;
+}
+
+- (NSInputStream *)newInputStream
+{
+    CFReadStreamRef readStream = NULL;
+    CFWriteStreamRef writeStream = NULL;
+    CFStreamCreateBoundPair(kCFAllocatorDefault, &readStream, &writeStream, kStreamBufferSize);
+
+    // Attachment parts are immutable, so this only copies the small header parts
+    NSArray *parts = [[NSArray alloc] initWithArray:self.parts copyItems:YES];
+    NSOutputStream *outputStream = (NSOutputStream *)writeStream;
+
+    // Writes to a bound pair block until the reader has made room, so this
+    // only ever holds kStreamBufferSize bytes beyond the parts themselves.
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneUtility), ^{
+        [outputStream open];
+        BOOL readerGone = NO;
+        for (NSData *part in parts) {
+            const uint8_t *bytes = part.bytes;
+            NSUInteger offset = 0;
+            while (!readerGone && offset < part.length) {
+                NSInteger written = [outputStream write:bytes + offset
+                                              maxLength:MIN(part.length - offset, (NSUInteger)kStreamBufferSize)];
+                // The reader may have gone away, e.g. the connection was cancelled
+                readerGone = (written <= 0);
+                offset += MAX(written, 0);
+            }
+            if (readerGone) {
+                break;
+            }
+        }
+        [outputStream close];
+        [outputStream release];
+        [parts release];
+    });
+
+    return (NSInputStream *)readStream;
 }
 
 @end
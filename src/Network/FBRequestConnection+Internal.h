@@ -21,12 +21,20 @@
 @class FBRequestConnectionRetryManager;
 
 FBSDK_EXTERN NSString *const kApiURLPrefix;
+FBSDK_EXTERN NSString *const kBatchEntryName;
 
 @interface FBRequestConnection (Internal)
 
 @property (nonatomic, readonly) BOOL isResultFromCache;
 @property (nonatomic, readonly) NSMutableArray *requests;
 @property (nonatomic, readonly) FBRequestConnectionRetryManager *retryManager;
+// The FBNetworkFeature* the connection's traffic is accounted to; set before starting it.
+@property (nonatomic, copy) NSString *networkFeature;
+// When background uploads are available, sends the connection through FBBackgroundUploader
+// as an upload of this kind, with the context it is reconciled with should the app be
+// terminated first.  Connections with streamed bodies go that way as media uploads anyway.
+@property (nonatomic, copy) NSString *backgroundUploadKind;
+@property (nonatomic, copy) NSDictionary *backgroundUploadContext;
 
 - (instancetype)initWithMetadata:(NSArray *)metadataArray;
 
@@ -40,4 +48,16 @@ FBSDK_EXTERN NSString *const kApiURLPrefix;
 
 - (NSString *)accessTokenWithRequest:(FBRequest *)request;
 
+// The key a response to requests is cached under within a cache identity.
+// Sorts the parameters and leaves out access_token, sdk, format and other
+// parameters that don't change the response.
++ (NSString *)canonicalCacheKeyForRequests:(NSArray *)requests;
+
++ (void)addRequestToExtendTokenForSession:(FBSession *)session
+                               connection:(FBRequestConnection *)connection
+                        completionHandler:(FBRequestHandler)handler;
++ (void)addRequestToRefreshPermissionsSession:(FBSession *)session
+                                   connection:(FBRequestConnection *)connection
+                            completionHandler:(FBRequestHandler)handler;
+
 @end
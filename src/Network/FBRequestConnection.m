@@ -17,21 +17,37 @@
 #import "FBRequestConnection.h"
 #import "FBRequestConnection+Internal.h"
 
+#import <CommonCrypto/CommonDigest.h>
 #import <UIKit/UIImage.h>
 
+#import "FBAccessTokenData+Internal.h"
+#import "FBAppEvents+Internal.h"
+#import "FBBackgroundUploader.h"
+#import "FBCancellationToken.h"
 #import "FBDataDiskCache.h"
+#import "FBDispatch.h"
 #import "FBError.h"
 #import "FBErrorUtility+Internal.h"
 #import "FBGraphObject.h"
 #import "FBLogger.h"
+#import "FBMainThreadWatchdog.h"
+#import "FBMetrics.h"
 #import "FBRequest+Internal.h"
 #import "FBRequestBody.h"
 #import "FBRequestConnectionRetryManager.h"
 #import "FBRequestHandlerFactory.h"
+#import "FBRequestOutbox.h"
+#import "FBRequestRetryPolicy.h"
+#import "FBRequestTemplate.h"
+#import "FBRequestTimings+Internal.h"
 #import "FBSession+Internal.h"
 #import "FBSession.h"
 #import "FBSettings+Internal.h"
 #import "FBSystemAccountStoreAdapter.h"
+#import "FBTask.h"
+#import "FBTaskCompletionSource.h"
+#import "FBTaskExecutor.h"
+#import "FBTrace.h"
 #import "FBURLConnection.h"
 #import "FBUtility.h"
 #import "Facebook.h"
@@ -46,6 +62,8 @@ NSString *const kBatchRelativeURLKey = @"relative_url";
 NSString *const kBatchAttachmentKey = @"attached_files";
 NSString *const kBatchFileNamePrefix = @"file";
 NSString *const kBatchEntryName = @"name";
+NSString *const kBatchDependsOnKey = @"depends_on";
+NSString *const kBatchOmitResponseOnSuccessKey = @"omit_response_on_success";
 
 NSString *const kAccessTokenKey = @"access_token";
 NSString *const kSDK = @"ios";
@@ -56,15 +74,244 @@ NSString *const kBatchRestMethodBaseURL = @"method/";
 
 // response object property/key
 NSString *const FBNonJSONResponseProperty = @"FACEBOOK_NON_JSON_RESULT";
+NSString *const FBRequestConnectionBackgroundUploadDidFinishNotification = @"FBRequestConnectionBackgroundUploadDidFinishNotification";
+NSString *const FBRequestConnectionBackgroundUploadGraphPathsKey = @"graphPaths";
+NSString *const FBRequestConnectionBackgroundUploadErrorKey = @"error";
 
 //static const int kRESTAPIAccessTokenErrorCode = 190;
 static const int kRESTAPIPermissionErrorCode = 200;
 //static const int kAPISessionNoLongerActiveErrorCode = 2500;
 static const NSTimeInterval kDefaultTimeout = 180.0;
 static const int kMaximumBatchSize = 50;
+// Request bodies larger than this are streamed rather than set as HTTPBody
+static const NSUInteger kStreamedBodyThreshold = 256 * 1024;
+
+// Latency percentiles aren't trusted until this many requests have completed
+static const NSUInteger kMinimumLatencySamples = 20;
+// Adaptive timeouts allow this multiple of the 99th percentile latency
+static const double kAdaptiveTimeoutLatencyMultiple = 4.0;
+static const NSTimeInterval kMinimumAdaptiveTimeout = 15.0;
+// Hedges are never sent sooner than this, however fast requests usually are
+static const NSTimeInterval kMinimumHedgeDelay = 0.5;
+// Smaller bodies fit in a packet or two, and aren't worth compressing
+static const NSUInteger kCompressedBodyThreshold = 4 * 1024;
+// Requests handled per autorelease pool when encoding a batch or handling its
+// response, so the temporaries stay bounded however large the batch is
+static const NSUInteger kRequestProcessingChunkSize = 10;
+
+// HTTP validators kept alongside cache identity entries
+static NSString *const kCacheValidatorsFragment = @"validators";
+static NSString *const kETagKey = @"etag";
+static NSString *const kLastModifiedKey = @"last_modified";
+
+// Cache identity used for requests whose FBRequestCachePolicy allows caching,
+// and the entry kept alongside each of their responses saying when it expires
+static NSString *const kResponseCacheIdentity = @"FBResponseCache";
+static NSString *const kCacheExpiryFragment = @"expires";
+// Returned for responses the server doesn't allow to be stored at all
+static const NSTimeInterval kResponseNotStorable = -1.0;
 
 typedef void (^KeyValueActionHandler)(NSString *key, id value);
 
+// Parameters added to every request, or that identify the caller rather than
+// what it asked for, which are left out of cache keys
+static NSSet *FBRequestCacheVolatileParameters(void)
+{
+    static NSSet *parameters;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        parameters = [[NSSet alloc] initWithObjects:kAccessTokenKey, @"sdk", @"format", @"migration_bundle", nil];
+    });
+    return parameters;
+}
+
+// Attachments and structured values go into cache keys as a digest of their contents, so
+// requests that differ only in them don't share an entry.  Dictionaries describe themselves
+// with their keys sorted.
+static NSString *FBRequestCacheParameterDigest(id value)
+{
+    NSData *data = nil;
+    if ([value isKindOfClass:[NSData class]]) {
+        data = value;
+    } else if ([value isKindOfClass:[UIImage class]]) {
+        data = UIImagePNGRepresentation(value);
+    } else {
+        data = [[value description] dataUsingEncoding:NSUTF8StringEncoding];
+    }
+    unsigned char digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(data.bytes, (CC_LONG)data.length, digest);
+    NSMutableString *string = [NSMutableString stringWithCapacity:sizeof(digest) * 2 + 5];
+    [string appendString:@"sha1:"];
+    for (size_t i = 0; i < sizeof(digest); i++) {
+        [string appendFormat:@"%02x", digest[i]];
+    }
+    return string;
+}
+
+// Validators live in their own entry, keyed off the identity URL so that they
+// land in the same cache namespace and get purged along with the data.
+static NSURL *FBRequestCacheEntryURL(NSURL *cacheIdentityURL, NSString *fragment)
+{
+    return [NSURL URLWithString:[NSString stringWithFormat:@"%@#%@",
+                                 cacheIdentityURL.absoluteString,
+                                 fragment]];
+}
+
+static NSURL *FBRequestCacheValidatorsURL(NSURL *cacheIdentityURL)
+{
+    return FBRequestCacheEntryURL(cacheIdentityURL, kCacheValidatorsFragment);
+}
+
+static NSDictionary *FBRequestCacheLoadValidators(NSURL *cacheIdentityURL)
+{
+    NSData *data = [[FBDataDiskCache sharedCache] dataForURL:FBRequestCacheValidatorsURL(cacheIdentityURL)];
+    if (data == nil) {
+        return nil;
+    }
+
+    id validators = [FBUtility simpleJSONDecodeData:data error:nil];
+    return [validators isKindOfClass:[NSDictionary class]] ? validators : nil;
+}
+
+static void FBRequestCacheStoreValidators(NSURL *cacheIdentityURL, NSHTTPURLResponse *response)
+{
+    NSURL *validatorsURL = FBRequestCacheValidatorsURL(cacheIdentityURL);
+    NSMutableDictionary *validators = [NSMutableDictionary dictionary];
+    NSString *etag = [response.allHeaderFields objectForKey:@"ETag"];
+    if (etag) {
+        [validators setObject:etag forKey:kETagKey];
+    }
+    NSString *lastModified = [response.allHeaderFields objectForKey:@"Last-Modified"];
+    if (lastModified) {
+        [validators setObject:lastModified forKey:kLastModifiedKey];
+    }
+
+    if (validators.count == 0) {
+        [[FBDataDiskCache sharedCache] removeDataForUrl:validatorsURL];
+    } else {
+        [[FBDataDiskCache sharedCache] setData:[FBUtility simpleJSONEncodeToData:validators error:nil]
+                                        forURL:validatorsURL];
+    }
+}
+
+static NSDate *FBRequestCacheParseHTTPDate(NSString *string)
+{
+    static NSDateFormatter *formatter;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        formatter = [[NSDateFormatter alloc] init];
+        formatter.locale = [[[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"] autorelease];
+        formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+        formatter.dateFormat = @"EEE',' dd MMM yyyy HH':'mm':'ss zzz";
+    });
+    if (!string) {
+        return nil;
+    }
+    @synchronized (formatter) {
+        return [formatter dateFromString:string];
+    }
+}
+
+// How long the server lets a response be reused for, from its Cache-Control
+// header or else its Expires header, falling back to defaultMaxAge when it
+// has neither.
+static NSTimeInterval FBRequestCacheMaxAgeForResponse(NSHTTPURLResponse *response, NSTimeInterval defaultMaxAge)
+{
+    NSDictionary *headers = response.allHeaderFields;
+    NSString *cacheControl = [headers objectForKey:@"Cache-Control"];
+    if (cacheControl) {
+        BOOL mustRevalidate = NO;
+        NSTimeInterval maxAge = -1.0;
+        NSCharacterSet *whitespace = [NSCharacterSet whitespaceCharacterSet];
+        for (NSString *directive in [[cacheControl lowercaseString] componentsSeparatedByString:@","]) {
+            NSString *trimmed = [directive stringByTrimmingCharactersInSet:whitespace];
+            if ([trimmed isEqualToString:@"no-store"]) {
+                return kResponseNotStorable;
+            } else if ([trimmed isEqualToString:@"no-cache"]) {
+                mustRevalidate = YES;
+            } else if ([trimmed hasPrefix:@"max-age="]) {
+                maxAge = MAX(0, [[trimmed substringFromIndex:@"max-age=".length] doubleValue]);
+            }
+        }
+        if (mustRevalidate) {
+            return 0;
+        }
+        if (maxAge >= 0) {
+            return maxAge;
+        }
+    }
+
+    NSString *expires = [headers objectForKey:@"Expires"];
+    if (expires) {
+        // An Expires header that can't be read means the response has already expired
+        NSDate *expiresDate = FBRequestCacheParseHTTPDate(expires);
+        NSDate *date = FBRequestCacheParseHTTPDate([headers objectForKey:@"Date"]) ?: [NSDate date];
+        return expiresDate ? MAX(0, [expiresDate timeIntervalSinceDate:date]) : 0;
+    }
+    return defaultMaxAge;
+}
+
+// Expiry dates are wall clock times, since they outlive the process
+static BOOL FBRequestCacheIsFresh(NSURL *cacheIdentityURL)
+{
+    NSData *data = [[FBDataDiskCache sharedCache] dataForURL:FBRequestCacheEntryURL(cacheIdentityURL, kCacheExpiryFragment)];
+    if (data == nil) {
+        return NO;
+    }
+
+    NSString *expiry = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+    return [expiry doubleValue] > [[NSDate date] timeIntervalSince1970];
+}
+
+// Stores the response, or drops any cached copy if the server doesn't allow
+// it to be kept
+static void FBRequestCacheStoreResponse(NSURL *cacheIdentityURL,
+                                        NSHTTPURLResponse *response,
+                                        NSData *data,
+                                        NSTimeInterval defaultMaxAge)
+{
+    FBDataDiskCache *cache = [FBDataDiskCache sharedCache];
+    NSURL *expiryURL = FBRequestCacheEntryURL(cacheIdentityURL, kCacheExpiryFragment);
+    NSTimeInterval maxAge = FBRequestCacheMaxAgeForResponse(response, defaultMaxAge);
+    if (maxAge == kResponseNotStorable) {
+        [cache removeDataForUrl:cacheIdentityURL];
+        [cache removeDataForUrl:FBRequestCacheValidatorsURL(cacheIdentityURL)];
+        [cache removeDataForUrl:expiryURL];
+        return;
+    }
+
+    if (data) {
+        [cache setData:data forURL:cacheIdentityURL MIMEType:response.MIMEType];
+        FBRequestCacheStoreValidators(cacheIdentityURL, response);
+    }
+    NSString *expiry = [NSString stringWithFormat:@"%f", [[NSDate date] timeIntervalSince1970] + maxAge];
+    [cache setData:[expiry dataUsingEncoding:NSUTF8StringEncoding] forURL:expiryURL];
+}
+
+static void FBRequestConnectionRecordBytesSent(NSURLRequest *request)
+{
+    // Streamed bodies have no HTTPBody, but always carry a Content-Length
+    NSUInteger length = request.HTTPBody.length;
+    if (!length) {
+        length = (NSUInteger)[[request valueForHTTPHeaderField:@"Content-Length"] integerValue];
+    }
+    [[FBMetrics sharedMetrics] recordValue:length forMetric:FBMetricBytesSent];
+}
+
+// Returns the estimated request latency percentile in seconds, or 0 if too
+// few requests have completed to tell.
+static NSTimeInterval FBRequestConnectionLatencyPercentile(double percentile)
+{
+    NSUInteger sampleCount = 0;
+    double milliseconds = [[FBMetrics sharedMetrics] estimatedPercentile:percentile
+                                                               forMetric:FBMetricRequestLatency
+                                                             sampleCount:&sampleCount];
+    if (sampleCount < kMinimumLatencySamples) {
+        return 0;
+    }
+    return milliseconds / 1000;
+}
+
 // ----------------------------------------------------------------------------
 // FBRequestConnectionState
 
@@ -76,14 +323,142 @@ typedef enum FBRequestConnectionState {
     kStateCancelled,
 } FBRequestConnectionState;
 
+// ----------------------------------------------------------------------------
+// FBRequestConnectionSharedCall
+
+// A single network call whose response is delivered to every connection that
+// started an identical GET while it was in flight.  Only used on the main
+// thread.
+@interface FBRequestConnectionSharedCall : NSObject
+
+@property (nonatomic, copy) NSString *key;
+@property (nonatomic, retain) FBURLConnection *urlConnection;
+// A duplicate of urlConnection, sent when the call is slow to complete
+@property (nonatomic, retain) FBURLConnection *hedgeConnection;
+@property (nonatomic) BOOL completed;
+@property (nonatomic, retain, readonly) NSMutableArray *connections;
+
+@end
+
+@implementation FBRequestConnectionSharedCall
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        _connections = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_key release];
+    [_urlConnection release];
+    [_hedgeConnection release];
+    [_connections release];
+    [super dealloc];
+}
+
+@end
+
+// In-flight shared calls, keyed by FBRequestConnectionSharedCallKey
+static NSMutableDictionary *g_sharedCalls;
+
+// The URL already carries the graph path, parameters and access token; the
+// query is sorted since parameter order depends on dictionary enumeration.
+static NSString *FBRequestConnectionSharedCallKey(NSURLRequest *request)
+{
+    NSURL *url = request.URL;
+    NSArray *queryItems = [[url.query componentsSeparatedByString:@"&"]
+                           sortedArrayUsingSelector:@selector(compare:)];
+    return [NSString stringWithFormat:@"%@://%@%@?%@",
+            url.scheme,
+            url.host,
+            url.path,
+            [queryItems componentsJoinedByString:@"&"]];
+}
+
+// Whether the data opens with a JSON object or array, the only top-level
+// values NSJSONSerialization accepts without fragments allowed
+// The batch entry name in the first "{result=name:$.path}" reference in string, if any
+static NSString *FBRequestConnectionReferencedBatchNameInString(NSString *string)
+{
+    NSRange start = [string rangeOfString:@"{result="];
+    if (start.location == NSNotFound) {
+        return nil;
+    }
+    NSUInteger nameStart = NSMaxRange(start);
+    NSRange end = [string rangeOfCharacterFromSet:[NSCharacterSet characterSetWithCharactersInString:@":}"]
+                                          options:0
+                                            range:NSMakeRange(nameStart, string.length - nameStart)];
+    if (end.location == NSNotFound || end.location == nameStart) {
+        return nil;
+    }
+    return [string substringWithRange:NSMakeRange(nameStart, end.location - nameStart)];
+}
+
+// The earlier batch entry a request consumes a result of, from its path, parameters or post object
+static NSString *FBRequestConnectionReferencedBatchName(FBRequest *request)
+{
+    NSString *name = FBRequestConnectionReferencedBatchNameInString(request.graphPath);
+    if (name) {
+        return name;
+    }
+    for (NSDictionary *values in @[request.parameters, (id)request.graphObject ?: @{}]) {
+        for (id value in [values objectEnumerator]) {
+            if ([value isKindOfClass:[NSString class]] &&
+                (name = FBRequestConnectionReferencedBatchNameInString(value))) {
+                return name;
+            }
+        }
+    }
+    return nil;
+}
+
+static BOOL FBRequestConnectionDataStartsJSONContainer(NSData *data)
+{
+    const unsigned char *bytes = data.bytes;
+    NSUInteger length = data.length;
+    NSUInteger i = 0;
+    if (length >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+        i = 3; // UTF-8 byte order mark
+    }
+    while (i < length && (bytes[i] == ' ' || bytes[i] == '\t' || bytes[i] == '\r' || bytes[i] == '\n')) {
+        i++;
+    }
+    return i < length && (bytes[i] == '{' || bytes[i] == '[');
+}
+
+// The response to an unbatched request is the entry itself, so it is put in a
+// dictionary under "body", the way a batch returns it
+static NSArray *FBRequestConnectionResultsForSingleResponse(id response, NSInteger statusCode)
+{
+    NSMutableDictionary *result = [[[NSMutableDictionary alloc] init] autorelease];
+    [result setObject:[NSNumber numberWithInteger:statusCode] forKey:@"code"];
+    [result setObject:response forKey:@"body"];
+    return [NSMutableArray arrayWithObject:result];
+}
+
 // ----------------------------------------------------------------------------
 // Private properties and methods
 
 @interface FBRequestConnection () {
     BOOL _errorBehavior;
+    // Set when no timeout was given, so it can be adapted to observed latency
+    BOOL _usesDefaultTimeout;
+    // Set on the connection that refreshes a stale response cache entry
+    BOOL _refreshesResponseCache;
+    // JPEG data for image attachments encoded ahead of serialization, keyed by
+    // the (non-retained) image
+    NSMutableDictionary *_encodedImages;
+    dispatch_queue_t _completionQueue;
 }
 
 @property (nonatomic, retain) FBURLConnection *connection;
+// One connection per batch when the requests don't fit in a single batch
+@property (nonatomic, retain) NSArray *shardConnections;
+// Set instead of connection when attached to another connection's identical call
+@property (nonatomic, retain) FBRequestConnectionSharedCall *sharedCall;
 @property (nonatomic, retain) NSMutableArray *requests;
 @property (nonatomic) FBRequestConnectionState state;
 @property (nonatomic) NSTimeInterval timeout;
@@ -94,6 +469,18 @@ typedef enum FBRequestConnectionState {
 @property (nonatomic) unsigned long requestStartTime;
 @property (nonatomic, readonly) BOOL isResultFromCache;
 @property (nonatomic, retain) FBRequestConnectionRetryManager *retryManager;
+@property (nonatomic, retain, readwrite) FBRequestTimings *timings;
+@property (nonatomic, copy) NSString *networkFeature;
+@property (nonatomic, retain) id cancellationRegistration;
+@property (nonatomic, copy) NSString *backgroundUploadKind;
+@property (nonatomic, copy) NSDictionary *backgroundUploadContext;
+// Set instead of connection while the request is with FBBackgroundUploader
+@property (nonatomic, copy) NSString *backgroundUploadIdentifier;
+// Why an attachment of the request last built by requestWithBatch:timeout: couldn't be read
+@property (nonatomic, retain) NSError *bodyError;
+// While a request is built for FBBackgroundUploader, the token that goes in its
+// Authorization header rather than in the body the uploader writes to disk
+@property (nonatomic, copy) NSString *headerAccessToken;
 
 @end
 
@@ -118,7 +505,7 @@ typedef enum FBRequestConnectionState {
     } else {
         // CONSIDER: Could move to kStateSerialized here by caching result, but
         // it seems bad for a get accessor to modify state in observable manner.
-        return [self requestWithBatch:self.requests timeout:_timeout];
+        return [self requestWithBatch:self.requests timeout:[self timeoutForRequests:self.requests]];
     }
 }
 
@@ -142,12 +529,33 @@ typedef enum FBRequestConnectionState {
     _errorBehavior = errorBehavior;
 }
 
+- (dispatch_queue_t)completionQueue
+{
+    return _completionQueue;
+}
+
+- (void)setCompletionQueue:(dispatch_queue_t)completionQueue
+{
+    NSAssert((self.state == kStateCreated) || (self.state == kStateSerialized),
+             @"Cannot set completionQueue after starting or cancelling.");
+    if (completionQueue) {
+        dispatch_retain(completionQueue);
+    }
+    if (_completionQueue) {
+        dispatch_release(_completionQueue);
+    }
+    _completionQueue = completionQueue;
+}
+
 // ----------------------------------------------------------------------------
 // Lifetime
 
 - (instancetype)init
 {
-    return [self initWithTimeout:kDefaultTimeout];
+    if ((self = [self initWithTimeout:kDefaultTimeout])) {
+        _usesDefaultTimeout = YES;
+    }
+    return self;
 }
 
 // designated initializer
@@ -168,6 +576,7 @@ typedef enum FBRequestConnectionState {
 - (instancetype)initWithMetadata:(NSArray *)metadataArray
 {
     if (self = [self initWithTimeout:kDefaultTimeout]) {
+        _usesDefaultTimeout = YES;
         self.requests = [[metadataArray mutableCopy] autorelease];
     }
     return self;
@@ -175,14 +584,34 @@ typedef enum FBRequestConnectionState {
 
 - (void)dealloc
 {
+    [[FBMetrics sharedMetrics] cancelSpanForTag:self];
     [_connection cancel];
     [_connection release];
+    for (FBURLConnection *connection in _shardConnections) {
+        [connection cancel];
+    }
+    [_shardConnections release];
+    [_sharedCall release];
     [_requests release];
     [_internalUrlRequest release];
     [_urlResponse release];
     [_deprecatedRequest release];
     [_logger release];
     [_retryManager release];
+    [_timings release];
+    [_networkFeature release];
+    [_backgroundUploadKind release];
+    [_backgroundUploadContext release];
+    [_backgroundUploadIdentifier release];
+    [_headerAccessToken release];
+    [_bodyError release];
+    [_cancellationToken unregisterCancellationObserver:_cancellationRegistration];
+    [_cancellationToken release];
+    [_cancellationRegistration release];
+    [_encodedImages release];
+    if (_completionQueue) {
+        dispatch_release(_completionQueue);
+    }
 
     [super dealloc];
 }
@@ -199,6 +628,7 @@ typedef enum FBRequestConnectionState {
  completionHandler:(FBRequestHandler)handler
     batchEntryName:(NSString *)name
 {
+    FBMainThreadWatchdogMeasure();
     NSDictionary *batchParams = (name)? @{kBatchEntryName : name } : nil;
     [self addRequest:request completionHandler:handler batchParameters:batchParams behavior:self.errorBehavior];
 }
@@ -226,10 +656,130 @@ typedef enum FBRequestConnectionState {
     [metadata release];
 }
 
+- (NSString *)resultReferenceForRequest:(FBRequest *)request
+                               JSONPath:(NSString *)JSONPath
+{
+    NSAssert(self.state == kStateCreated,
+             @"Results must be referred to before starting or cancelling.");
+
+    FBRequestMetadata *metadata = [self getRequestMetadata:request];
+    if (!metadata) {
+        [[NSException exceptionWithName:FBInvalidOperationException
+                                 reason:@"FBRequestConnection: The request must be added to the connection before its result can be referred to."
+                               userInfo:nil]
+         raise];
+    }
+
+    NSMutableDictionary *batchParameters = [NSMutableDictionary dictionaryWithDictionary:metadata.batchParameters];
+    NSString *name = batchParameters[kBatchEntryName];
+    if (!name) {
+        name = [NSString stringWithFormat:@"fbsdk_result_%lu", (unsigned long)[self.requests indexOfObjectIdenticalTo:metadata]];
+        batchParameters[kBatchEntryName] = name;
+    }
+    // The server leaves out the response of a request others refer to unless told
+    // otherwise, and its handler expects one
+    if (!batchParameters[kBatchOmitResponseOnSuccessKey]) {
+        batchParameters[kBatchOmitResponseOnSuccessKey] = @NO;
+    }
+    metadata.batchParameters = batchParameters;
+
+    return [NSString stringWithFormat:@"{result=%@:%@}", name, JSONPath];
+}
+
+- (void)startWithCancellationToken:(FBCancellationToken *)cancellationToken
+{
+    self.cancellationToken = cancellationToken;
+    [self start];
+}
+
 - (void)start
 {
-    [self startWithCacheIdentity:nil
-           skipRoundtripIfCached:NO];
+    FBMainThreadWatchdogMeasure();
+    if (![self observeCancellationToken]) {
+        return;
+    }
+    NSArray *images = [self unencodedImageAttachments];
+    if (images.count == 0) {
+        [self startWithCacheIdentity:nil
+               skipRoundtripIfCached:NO];
+    } else if ([NSThread isMainThread]) {
+        NSAssert((self.state == kStateCreated) || (self.state == kStateSerialized),
+                 @"Cannot call start again after calling start or cancel.");
+
+        // Started once the images are encoded in the background
+        [FBUtility JPEGDataForImages:images completion:^(NSArray *imageData) {
+            [self addEncodedImages:images data:imageData];
+            if (self.state == kStateCancelled) {
+                // Report it the same way a cancelled FBURLConnection would
+                [self completeWithResponse:nil
+                                      data:nil
+                                   orError:[NSError errorWithDomain:FacebookSDKDomain
+                                                               code:FBErrorOperationCancelled
+                                                           userInfo:nil]];
+            } else {
+                [self startWithCacheIdentity:nil
+                       skipRoundtripIfCached:NO];
+            }
+        }];
+    } else {
+        [self addEncodedImages:images data:[FBUtility JPEGDataForImages:images]];
+        [self startWithCacheIdentity:nil
+               skipRoundtripIfCached:NO];
+    }
+}
+
+- (void)setCancellationToken:(FBCancellationToken *)cancellationToken
+{
+    NSAssert((self.state == kStateCreated) || (self.state == kStateSerialized),
+             @"Cannot set cancellationToken after starting or cancelling.");
+    if (cancellationToken != _cancellationToken) {
+        [_cancellationToken release];
+        _cancellationToken = [cancellationToken retain];
+    }
+}
+
+// Promotes or demotes connections already on their way.  A call shared with
+// other connections keeps the priority it was made with.
+- (void)setPriority:(FBRequestPriority)priority
+{
+    _priority = priority;
+    self.connection.priority = priority;
+    for (FBURLConnection *connection in self.shardConnections) {
+        connection.priority = priority;
+    }
+}
+
+// Returns NO, having reported the cancellation to the handlers, if the token was
+// cancelled before we could start.
+- (BOOL)observeCancellationToken
+{
+    FBCancellationToken *token = self.cancellationToken;
+    if (!token || self.cancellationRegistration) {
+        return YES;
+    }
+    if (token.isCancellationRequested) {
+        NSAssert((self.state == kStateCreated) || (self.state == kStateSerialized),
+                 @"Cannot call start again after calling start or cancel.");
+        self.state = kStateCancelled;
+        [self completeWithResponse:nil
+                              data:nil
+                           orError:[NSError errorWithDomain:FacebookSDKDomain
+                                                       code:FBErrorOperationCancelled
+                                                   userInfo:nil]];
+        return NO;
+    }
+    // Unretained; the block is unregistered once the connection completes
+    __block FBRequestConnection *connection = self;
+    self.cancellationRegistration = [token registerCancellationObserverWithBlock:^{
+        [connection cancel];
+    }];
+    return YES;
+}
+
+- (void)stopObservingCancellationToken
+{
+    [self.cancellationToken unregisterCancellationObserver:self.cancellationRegistration];
+    self.cancellationRegistration = nil;
 }
 
 - (void)cancel {
@@ -241,6 +791,24 @@ typedef enum FBRequestConnectionState {
     self.state = kStateCancelled;
     [self.connection cancel];
     self.connection = nil;
+    if (self.backgroundUploadIdentifier) {
+        [[FBBackgroundUploader sharedUploader] cancelUpload:self.backgroundUploadIdentifier];
+    }
+
+    // The handlers clear shardConnections once the last one completes
+    NSArray *shardConnections = [[self.shardConnections retain] autorelease];
+    for (FBURLConnection *connection in shardConnections) {
+        [connection cancel];
+    }
+
+    if (self.sharedCall) {
+        [self detachFromSharedCall];
+        [self completeWithResponse:nil
+                              data:nil
+                           orError:[NSError errorWithDomain:FacebookSDKDomain
+                                                       code:FBErrorOperationCancelled
+                                                   userInfo:nil]];
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -307,6 +875,15 @@ typedef enum FBRequestConnectionState {
                                  completionHandler:handler];
 }
 
++ (FBRequestConnection *)startWithGraphPath:(NSString *)graphPath
+                        projectedToProtocol:(Protocol *)protocol
+                          completionHandler:(FBRequestHandler)handler
+{
+    FBRequest *request = [FBRequest requestForGraphPath:graphPath
+                                    projectedToProtocol:protocol];
+    return [request startWithCompletionHandler:handler];
+}
+
 + (FBRequestConnection *)startForDeleteObject:(id)object
                             completionHandler:(FBRequestHandler)handler
 {
@@ -392,7 +969,19 @@ typedef enum FBRequestConnectionState {
 - (void)startWithCacheIdentity:(NSString *)cacheIdentity
          skipRoundtripIfCached:(BOOL)skipRoundtripIfCached
 {
-    if ([self.requests count] == 1) {
+    if (![self observeCancellationToken]) {
+        return;
+    }
+
+    FBRequest *responseCacheRequest = nil;
+    if (!cacheIdentity || [cacheIdentity isEqualToString:kResponseCacheIdentity]) {
+        responseCacheRequest = [self responseCacheRequest];
+        if (responseCacheRequest) {
+            cacheIdentity = kResponseCacheIdentity;
+        }
+    }
+
+    if ([self.requests count] == 1 && !_refreshesResponseCache) {
         FBRequestMetadata *firstMetadata = [self.requests objectAtIndex:0];
         if ([firstMetadata.request delegate]) {
             self.deprecatedRequest = firstMetadata.request;
@@ -406,22 +995,33 @@ typedef enum FBRequestConnectionState {
     NSMutableURLRequest *request = nil;
     NSData *cachedData = nil;
     NSURL *cacheIdentityURL = nil;
+    BOOL refreshesCachedData = NO;
     if (cacheIdentity) {
         // warning! this property has significant side-effects, and should be executed at the right moment
         // depending on whether there may be batching or whether we are certain there is no batching
         request = self.urlRequest;
 
-        // when we generalize this for consumers of FBRequest, then we will use a more
-        // normalized form for our identification scheme than this URL construction; given the only
-        // clients are the two pickers -- this scheme achieves stability via being a closed system,
-        // and provides a simple first step to the more general solution
+        NSMutableArray *fbRequests = [NSMutableArray arrayWithCapacity:self.requests.count];
+        for (FBRequestMetadata *metadata in self.requests) {
+            [fbRequests addObject:metadata.request];
+        }
         cacheIdentityURL = [[[NSURL alloc] initWithScheme:@"FBRequestCache"
                                                      host:cacheIdentity
-                                                     path:[NSString stringWithFormat:@"/%@", request.URL]]
+                                                     path:[NSString stringWithFormat:@"/%@/%@",
+                                                           [self cachePartitionForRequests:fbRequests],
+                                                           [FBRequestConnection canonicalCacheKeyForRequests:fbRequests]]]
                             autorelease];
 
+        if (responseCacheRequest && !_refreshesResponseCache) {
+            BOOL fresh = FBRequestCacheIsFresh(cacheIdentityURL);
+            refreshesCachedData = !fresh &&
+                responseCacheRequest.cachePolicy == FBRequestCachePolicyStaleWhileRevalidate;
+            skipRoundtripIfCached = fresh || refreshesCachedData;
+        }
+
         if (skipRoundtripIfCached) {
             cachedData = [[FBDataDiskCache sharedCache] dataForURL:cacheIdentityURL];
+            [[FBMetrics sharedMetrics] incrementCounter:(cachedData ? FBMetricCacheHits : FBMetricCacheMisses) by:1];
         }
     }
 
@@ -444,10 +1044,17 @@ typedef enum FBRequestConnectionState {
         safeForPiggyback &= (batchAppID != nil) && (batchAppID.length > 0);
 
         if (safeForPiggyback) {
+            FBTraceBegin(FBTracePointPiggybackRequests, self);
             [self addPiggybackRequests];
+            FBTraceEnd(FBTracePointPiggybackRequests, self);
         }
     }
 
+    if (!request && self.internalUrlRequest == nil && self.requests.count > kMaximumBatchSize) {
+        [self startShardedBatches];
+        return;
+    }
+
     // warning! this property is side-effecting (and should probably be refactored at some point...)
     // still, if we have made it this far and still don't have a request object, we need one now
     if (!request) {
@@ -459,19 +1066,69 @@ typedef enum FBRequestConnectionState {
     self.state = kStateStarted;
 
     _requestStartTime = [FBUtility currentTimeInMilliseconds];
+    [[FBMetrics sharedMetrics] beginSpanForTag:self];
+    self.timings = [[[FBRequestTimings alloc] init] autorelease];
+    [self.timings markStart];
+
+    if (!cachedData && self.bodyError) {
+        // Without the attachment the request would post something else
+        [self completeWithResponse:nil data:nil orError:[self attachmentError]];
+        return;
+    }
 
     if (!cachedData) {
+        // If we are going to the server anyway, let it tell us the cached
+        // copy is still good rather than send it all over again
+        NSData *revalidatedData = nil;
+        if (cacheIdentityURL && [request.HTTPMethod isEqualToString:@"GET"]) {
+            NSDictionary *validators = FBRequestCacheLoadValidators(cacheIdentityURL);
+            if (validators) {
+                revalidatedData = [[FBDataDiskCache sharedCache] dataForURL:cacheIdentityURL];
+            }
+            if (revalidatedData) {
+                [request setValue:[validators objectForKey:kETagKey] forHTTPHeaderField:@"If-None-Match"];
+                [request setValue:[validators objectForKey:kLastModifiedKey] forHTTPHeaderField:@"If-Modified-Since"];
+            }
+        }
+
         FBURLConnectionHandler handler =
         ^(FBURLConnection *connection,
           NSError *error,
           NSURLResponse *response,
           NSData *responseData) {
-            // cache this data if we have successful response and a cache identity to work with
+            [self.timings mergeNetworkTimings:connection.timings];
+            if (response) {
+                [[FBMetrics sharedMetrics] recordValue:responseData.length forMetric:FBMetricBytesReceived];
+            }
             if (cacheIdentityURL &&
-                [response isKindOfClass:[NSHTTPURLResponse class]] &&
-                ((NSHTTPURLResponse *)response).statusCode == 200) {
-                [[FBDataDiskCache sharedCache] setData:responseData
-                                                forURL:cacheIdentityURL];
+                [response isKindOfClass:[NSHTTPURLResponse class]]) {
+                NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
+                if (httpResponse.statusCode == 304 && revalidatedData) {
+                    if (responseCacheRequest) {
+                        FBRequestCacheStoreResponse(cacheIdentityURL, httpResponse, nil,
+                                                    responseCacheRequest.cacheMaxAge);
+                    }
+                    // Not modified, so the cached copy is as fresh as a new
+                    // response would be; deliberately not flagged as a cache
+                    // result, or the pickers would refresh again.
+                    [self completeWithResponse:nil
+                                          data:revalidatedData
+                                       orError:nil];
+                    return;
+                }
+
+                // cache this data if we have successful response and a cache identity to work with
+                if (httpResponse.statusCode == 200) {
+                    if (responseCacheRequest) {
+                        FBRequestCacheStoreResponse(cacheIdentityURL, httpResponse, responseData,
+                                                    responseCacheRequest.cacheMaxAge);
+                    } else {
+                        [[FBDataDiskCache sharedCache] setData:responseData
+                                                        forURL:cacheIdentityURL
+                                                      MIMEType:httpResponse.MIMEType];
+                        FBRequestCacheStoreValidators(cacheIdentityURL, httpResponse);
+                    }
+                }
             }
             // complete on result from round-trip to server
             [self completeWithResponse:response
@@ -484,15 +1141,293 @@ typedef enum FBRequestConnectionState {
             [deprecatedDelegate requestLoading:self.deprecatedRequest];
         }
 
-        [self startURLConnectionWithRequest:request skipRoundTripIfCached:NO completionHandler:handler];
+        NSString *backgroundUploadKind = nil;
+        if (!cacheIdentityURL && !self.deprecatedRequest && [FBBackgroundUploader isAvailable]) {
+            backgroundUploadKind = self.backgroundUploadKind ?: (request.HTTPBodyStream ? FBBackgroundUploadKindMedia : nil);
+        }
+
+        NSMutableURLRequest *backgroundUploadRequest = backgroundUploadKind ? [self backgroundUploadRequest] : nil;
+        if (backgroundUploadRequest) {
+            FBRequestConnectionRecordBytesSent(backgroundUploadRequest);
+            [self startBackgroundUploadWithRequest:backgroundUploadRequest kind:backgroundUploadKind];
+        } else if (!cacheIdentityURL &&
+            !self.deprecatedRequest &&
+            self.requests.count == 1 &&
+            [request.HTTPMethod isEqualToString:@"GET"] &&
+            [NSThread isMainThread]) {
+            [self startSharedURLConnectionWithRequest:request];
+        } else {
+            FBRequestConnectionRecordBytesSent(request);
+            [self startURLConnectionWithRequest:request skipRoundTripIfCached:NO completionHandler:handler];
+        }
     } else {
         _isResultFromCache = YES;
 
-        // complete on result from cache
-        [self completeWithResponse:nil
-                              data:cachedData
-                           orError:nil];
+        // Decode the cached data off the caller's thread, then complete on the main thread
+        FBDispatchAsync(FBDispatchGetGlobalQueue(FBDispatchLaneUserInteractive), FBDispatchLaneUserInteractive, ^{
+            NSError *parseError = nil;
+            NSArray *results = [[self parseJSONResponse:cachedData
+                                                  error:&parseError
+                                             statusCode:200] retain];
+            [parseError retain];
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self completeWithResponse:nil
+                                      data:cachedData
+                             parsedResults:results
+                                   orError:parseError];
+                [results release];
+                [parseError release];
+
+                if (refreshesCachedData) {
+                    [self refreshResponseCacheForRequest:responseCacheRequest];
+                }
+            });
+        });
+    }
+}
 
+// The request to look up in the response cache, if this connection is for a
+// single GET whose cache policy allows it
+- (FBRequest *)responseCacheRequest
+{
+    if (self.internalUrlRequest ||
+        self.requests.count != 1 ||
+        ![self requestsAreReadOnly:self.requests]) {
+        return nil;
+    }
+    FBRequest *request = [[self.requests objectAtIndex:0] request];
+    return (request.cachePolicy == FBRequestCachePolicyNetworkOnly) ? nil : request;
+}
+
+// Sends the request again on a connection of its own, with no handler, so the
+// stale copy just served is replaced for next time
+- (void)refreshResponseCacheForRequest:(FBRequest *)request
+{
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:request completionHandler:nil];
+    connection->_refreshesResponseCache = YES;
+    [connection startWithCacheIdentity:kResponseCacheIdentity
+                 skipRoundtripIfCached:NO];
+}
+
+// Graph API batches are limited to kMaximumBatchSize requests, so longer
+// request lists go out as several batches in parallel.  Their results are put
+// back together in the original order before any handler gets called, unless
+// there is a completionQueue, in which case each batch completes on its own.
+- (void)startShardedBatches
+{
+    NSAssert((self.state == kStateCreated) || (self.state == kStateSerialized),
+             @"Cannot call start again after calling start or cancel.");
+    self.state = kStateStarted;
+
+    _requestStartTime = [FBUtility currentTimeInMilliseconds];
+    [[FBMetrics sharedMetrics] beginSpanForTag:self];
+    self.timings = [[[FBRequestTimings alloc] init] autorelease];
+    [self.timings markStart];
+
+    NSUInteger count = self.requests.count;
+    NSArray *shardRanges = [self shardRanges];
+    NSUInteger shardCount = shardRanges.count;
+
+    NSMutableArray *results = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        [results addObject:[NSNull null]];
+    }
+
+    // Only used when each batch completes on its own, in which case retries
+    // wait for the handlers of every batch
+    NSMutableArray *completionTasks = nil;
+    if (self.completionQueue) {
+        self.retryManager = [[[FBRequestConnectionRetryManager alloc] initWithFBRequestConnection:self] autorelease];
+        completionTasks = [NSMutableArray array];
+    }
+
+    __block NSUInteger pendingShards = shardCount;
+    NSMutableArray *shardConnections = [NSMutableArray arrayWithCapacity:shardCount];
+    for (NSValue *shardRangeValue in shardRanges) {
+        NSRange shardRange = shardRangeValue.rangeValue;
+        NSArray *shard = [self.requests subarrayWithRange:shardRange];
+        NSMutableURLRequest *request = [self requestWithBatch:shard timeout:[self timeoutForRequests:shard]];
+        NSError *attachmentError = self.bodyError ? [self attachmentError] : nil;
+
+        FBURLConnectionHandler handler =
+        ^(FBURLConnection *connection,
+          NSError *error,
+          NSURLResponse *response,
+          NSData *responseData) {
+            [self.timings mergeNetworkTimings:connection.timings];
+            if (response) {
+                [[FBMetrics sharedMetrics] recordValue:responseData.length forMetric:FBMetricBytesReceived];
+            }
+            NSArray *shardResults = [self resultsForShard:shard
+                                                 response:response
+                                                     data:responseData
+                                                    error:error];
+            [results replaceObjectsInRange:shardRange withObjectsFromArray:shardResults];
+            if (completionTasks) {
+                [completionTasks addObjectsFromArray:[self completionTasksForRequests:shard
+                                                                              results:shardResults
+                                                                              orError:nil]];
+            }
+            if (--pendingShards == 0) {
+                [self completeWithShardResults:results completionTasks:completionTasks];
+            }
+        };
+
+        if (attachmentError) {
+            // Just this batch fails, and like the others it reports back later
+            FBURLConnectionHandler handlerCopy = [[handler copy] autorelease];
+            dispatch_async(dispatch_get_main_queue(), ^{
+                handlerCopy(nil, attachmentError, nil, nil);
+            });
+            continue;
+        }
+
+        FBRequestConnectionRecordBytesSent(request);
+        FBURLConnection *connection = [[self newFBURLConnection] initWithRequest:request
+                                                           skipRoundTripIfCached:NO
+                                                                     retryPolicy:[self retryPolicyForRequests:shard]
+                                                                        priority:self.priority
+                                                               completionHandler:handler];
+        connection.networkFeature = self.networkFeature;
+        [shardConnections addObject:connection];
+        [connection release];
+    }
+    self.shardConnections = shardConnections;
+}
+
+// Splits the requests into batches of at most kMaximumBatchSize.  Without
+// references between them the split is even.  A request that consumes another's
+// result has to go in the same batch as it, so then whole runs of dependent
+// requests are packed into batches instead; a run longer than a batch is cut,
+// and the references across the cut fail on the server.
+- (NSArray *)shardRanges
+{
+    NSUInteger count = self.requests.count;
+
+    NSMutableDictionary *indexesByName = [NSMutableDictionary dictionary];
+    BOOL *joinedToPrevious = calloc(count, sizeof(BOOL));
+    BOOL hasReferences = NO;
+    for (NSUInteger i = 0; i < count; i++) {
+        FBRequestMetadata *metadata = self.requests[i];
+        NSString *parentName = metadata.batchParameters[kBatchDependsOnKey] ?: FBRequestConnectionReferencedBatchName(metadata.request);
+        NSNumber *parentIndex = parentName ? indexesByName[parentName] : nil;
+        if (parentIndex) {
+            for (NSUInteger j = parentIndex.unsignedIntegerValue + 1; j <= i; j++) {
+                joinedToPrevious[j] = YES;
+            }
+            hasReferences = YES;
+        }
+        NSString *name = metadata.batchParameters[kBatchEntryName];
+        if (name) {
+            indexesByName[name] = @(i);
+        }
+    }
+
+    NSMutableArray *ranges = [NSMutableArray array];
+    if (!hasReferences) {
+        NSUInteger shardCount = (count + kMaximumBatchSize - 1) / kMaximumBatchSize;
+        NSUInteger shardSize = (count + shardCount - 1) / shardCount;
+        for (NSUInteger offset = 0; offset < count; offset += shardSize) {
+            [ranges addObject:[NSValue valueWithRange:NSMakeRange(offset, MIN(shardSize, count - offset))]];
+        }
+    } else {
+        NSRange shard = NSMakeRange(0, 0);
+        NSUInteger runStart = 0;
+        for (NSUInteger i = 1; i <= count; i++) {
+            if (i < count && joinedToPrevious[i] && i - runStart < kMaximumBatchSize) {
+                continue;
+            }
+            // requests runStart..i-1 have to travel together
+            NSUInteger runLength = i - runStart;
+            if (shard.length > 0 && shard.length + runLength > kMaximumBatchSize) {
+                [ranges addObject:[NSValue valueWithRange:shard]];
+                shard = NSMakeRange(runStart, 0);
+            }
+            shard.length += runLength;
+            runStart = i;
+        }
+        [ranges addObject:[NSValue valueWithRange:shard]];
+    }
+    free(joinedToPrevious);
+    return ranges;
+}
+
+// Returns one entry per request in the shard: the parsed result, or the error
+// that failed the shard as a whole.
+- (NSArray *)resultsForShard:(NSArray *)shard
+                    response:(NSURLResponse *)response
+                        data:(NSData *)data
+                       error:(NSError *)error
+{
+    NSInteger statusCode = 200;
+    if ([response isKindOfClass:[NSHTTPURLResponse class]]) {
+        statusCode = ((NSHTTPURLResponse *)response).statusCode;
+    }
+
+    NSArray *results = nil;
+    if (!error && shard.count == 1) {
+        // requestWithBatch: sends a shard of one as a plain request
+        id body = [self parseJSONOrOtherwise:data error:&error];
+        if (!error) {
+            results = FBRequestConnectionResultsForSingleResponse(body, statusCode);
+        }
+    } else if (!error) {
+        results = [self parseJSONResponse:data
+                                    error:&error
+                               statusCode:statusCode];
+    }
+    error = [self checkConnectionError:error
+                            statusCode:statusCode
+                    parsedJSONResponse:results];
+    if (!error && results.count != shard.count) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorFBRequests formatString:@"Expected %lu results, got %lu",
+         (unsigned long)shard.count, (unsigned long)results.count];
+        error = [self errorWithCode:FBErrorProtocolMismatch
+                         statusCode:statusCode
+                 parsedJSONResponse:results
+                         innerError:nil
+                            message:nil];
+    }
+
+    if (!error) {
+        return results;
+    }
+
+    NSMutableArray *errors = [NSMutableArray arrayWithCapacity:shard.count];
+    for (NSUInteger i = 0; i < shard.count; i++) {
+        [errors addObject:error];
+    }
+    return errors;
+}
+
+- (void)completeWithShardResults:(NSArray *)results
+                completionTasks:(NSArray *)completionTasks
+{
+    if (self.state != kStateCancelled) {
+        NSAssert(self.state == kStateStarted,
+                 @"Unexpected state %d in completeWithShardResults",
+                 self.state);
+        self.state = kStateCompleted;
+        [[FBMetrics sharedMetrics] endSpanForTag:self metric:FBMetricRequestLatency elapsedMilliseconds:NULL];
+    } else {
+        [[FBMetrics sharedMetrics] cancelSpanForTag:self];
+    }
+    [self stopObservingCancellationToken];
+    [self.timings markResponseReceived];
+
+    FBLoggerAppendFormat(_logger, @"Response <#%lu>\nDuration: %lu msec\nBatches: %lu\nResponse Body:\n%@\n\n",
+     (unsigned long)[_logger loggerSerialNumber],
+     [FBUtility currentTimeInMilliseconds] - _requestStartTime,
+     (unsigned long)self.shardConnections.count,
+     results);
+    [_logger emitToNSLog];
+
+    self.shardConnections = nil;
+    if (completionTasks) {
+        [self performRetriesAfterTasks:completionTasks];
+    } else {
+        [self completeWithResults:results orError:nil];
     }
 }
 
@@ -501,11 +1436,250 @@ typedef enum FBRequestConnectionState {
                     completionHandler:(FBURLConnectionHandler)handler {
     FBURLConnection *connection = [[self newFBURLConnection] initWithRequest:request
                                                        skipRoundTripIfCached:skipRoundTripIfCached
+                                                                 retryPolicy:[self retryPolicyForRequests:self.requests]
+                                                                    priority:self.priority
                                                            completionHandler:handler];
+    connection.networkFeature = self.networkFeature;
     self.connection = connection;
     [connection release];
 }
 
+// Hands the request to the system, so it completes even if the app is
+// suspended.  Media uploads record where they posted to, for the notification
+// sent if they finish after the app was terminated.
+// The request built again with the access token moved to a header, since the uploader
+// keeps the body on disk.  nil, to send the request as usual, when the requests don't
+// share one token or the app supplied the request itself.
+- (NSMutableURLRequest *)backgroundUploadRequest
+{
+    if (self.internalUrlRequest) {
+        return nil;
+    }
+    NSString *sharedToken = nil;
+    for (NSUInteger i = 0; i < self.requests.count; i++) {
+        FBRequest *request = ((FBRequestMetadata *)[self.requests objectAtIndex:i]).request;
+        NSString *token = [self accessTokenWithRequest:request];
+        if (i == 0) {
+            sharedToken = token;
+        } else if (sharedToken != token && ![sharedToken isEqualToString:token]) {
+            return nil;
+        }
+    }
+
+    self.headerAccessToken = sharedToken;
+    NSMutableURLRequest *request = [self requestWithBatch:self.requests timeout:[self timeoutForRequests:self.requests]];
+    self.headerAccessToken = nil;
+    if (self.bodyError) {
+        return nil;
+    }
+    if (sharedToken) {
+        [request setValue:[@"OAuth " stringByAppendingString:sharedToken] forHTTPHeaderField:@"Authorization"];
+    }
+    return request;
+}
+
+- (NSError *)attachmentError
+{
+    return [self errorWithCode:FBErrorRequestConnectionApi
+                    statusCode:0
+            parsedJSONResponse:nil
+                    innerError:self.bodyError
+                       message:@"A file attachment could not be read"];
+}
+
+- (void)startBackgroundUploadWithRequest:(NSURLRequest *)request kind:(NSString *)kind
+{
+    NSDictionary *context = self.backgroundUploadContext;
+    if (!context && [kind isEqualToString:FBBackgroundUploadKindMedia]) {
+        NSMutableArray *graphPaths = [NSMutableArray arrayWithCapacity:self.requests.count];
+        for (FBRequestMetadata *metadata in self.requests) {
+            [graphPaths addObject:metadata.request.graphPath ?: metadata.request.restMethod ?: @""];
+        }
+        context = @{FBRequestConnectionBackgroundUploadGraphPathsKey : graphPaths};
+    }
+
+    self.backgroundUploadIdentifier =
+        [[FBBackgroundUploader sharedUploader] uploadRequest:request
+                                                        kind:kind
+                                                     context:context
+                                           completionHandler:^(NSURLResponse *response, NSData *data, NSError *error) {
+                                               self.backgroundUploadIdentifier = nil;
+                                               if (response) {
+                                                   [[FBMetrics sharedMetrics] recordValue:data.length forMetric:FBMetricBytesReceived];
+                                               }
+                                               [self completeWithResponse:response
+                                                                     data:data
+                                                                  orError:error];
+                                           }];
+}
+
+// Attaches to an identical request already in flight, if there is one, and
+// otherwise starts a call that later identical requests can attach to.
+- (void)startSharedURLConnectionWithRequest:(NSURLRequest *)request
+{
+    NSString *key = FBRequestConnectionSharedCallKey(request);
+    FBRequestConnectionSharedCall *sharedCall = [g_sharedCalls objectForKey:key];
+    if (sharedCall) {
+        FBLoggerAppendFormat(_logger, @"Request <#%lu> shares the in-flight call for an identical request\n",
+         (unsigned long)_logger.loggerSerialNumber);
+        [sharedCall.connections addObject:self];
+        self.sharedCall = sharedCall;
+        return;
+    }
+
+    sharedCall = [[[FBRequestConnectionSharedCall alloc] init] autorelease];
+    sharedCall.key = key;
+    [sharedCall.connections addObject:self];
+    self.sharedCall = sharedCall;
+    if (!g_sharedCalls) {
+        g_sharedCalls = [[NSMutableDictionary alloc] init];
+    }
+    [g_sharedCalls setObject:sharedCall forKey:key];
+
+    FBRequestConnectionRecordBytesSent(request);
+    FBURLConnectionHandler handler =
+    ^(FBURLConnection *connection,
+      NSError *error,
+      NSURLResponse *response,
+      NSData *responseData) {
+        if (sharedCall.completed) {
+            // The other of a hedged pair already completed the call
+            return;
+        }
+        sharedCall.completed = YES;
+        if (response) {
+            [[FBMetrics sharedMetrics] recordValue:responseData.length forMetric:FBMetricBytesReceived];
+        }
+        // Requests from here on need a call of their own
+        if ([g_sharedCalls objectForKey:sharedCall.key] == sharedCall) {
+            [g_sharedCalls removeObjectForKey:sharedCall.key];
+        }
+        FBURLConnection *loser = [[(connection == sharedCall.hedgeConnection ?
+                                    sharedCall.urlConnection :
+                                    sharedCall.hedgeConnection) retain] autorelease];
+        sharedCall.urlConnection = nil;
+        sharedCall.hedgeConnection = nil;
+        [loser cancel];
+
+        NSArray *connections = [[sharedCall.connections copy] autorelease];
+        [sharedCall.connections removeAllObjects];
+        for (FBRequestConnection *requestConnection in connections) {
+            requestConnection.sharedCall = nil;
+            [requestConnection.timings mergeNetworkTimings:connection.timings];
+            [requestConnection completeWithResponse:response
+                                               data:responseData
+                                            orError:error];
+        }
+    };
+
+    FBRequestRetryPolicy *retryPolicy = [self retryPolicyForRequests:self.requests];
+    FBURLConnection *connection = [[self newFBURLConnection] initWithRequest:request
+                                                       skipRoundTripIfCached:NO
+                                                                 retryPolicy:retryPolicy
+                                                                    priority:self.priority
+                                                           completionHandler:handler];
+    connection.networkFeature = self.networkFeature;
+    sharedCall.urlConnection = connection;
+    [connection release];
+
+    [self scheduleHedgeForSharedCall:sharedCall
+                             request:request
+                         retryPolicy:retryPolicy
+                             handler:handler];
+}
+
+- (void)detachFromSharedCall
+{
+    FBRequestConnectionSharedCall *sharedCall = [[self.sharedCall retain] autorelease];
+    self.sharedCall = nil;
+    [sharedCall.connections removeObject:self];
+
+    if (sharedCall.connections.count == 0) {
+        // Nobody is waiting for the response any more
+        if ([g_sharedCalls objectForKey:sharedCall.key] == sharedCall) {
+            [g_sharedCalls removeObjectForKey:sharedCall.key];
+        }
+        FBURLConnection *urlConnection = [[sharedCall.urlConnection retain] autorelease];
+        FBURLConnection *hedgeConnection = [[sharedCall.hedgeConnection retain] autorelease];
+        sharedCall.urlConnection = nil;
+        sharedCall.hedgeConnection = nil;
+        [urlConnection cancel];
+        [hedgeConnection cancel];
+    }
+}
+
+- (BOOL)requestsAreReadOnly:(NSArray *)requests
+{
+    for (FBRequestMetadata *metadata in requests) {
+        if (![[metadata.request.HTTPMethod uppercaseString] isEqualToString:@"GET"]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+// Only reads are retried, since a write may have taken effect before failing.
+// A urlRequest set from outside may not match the requests, so isn't retried.
+- (FBRequestRetryPolicy *)retryPolicyForRequests:(NSArray *)requests
+{
+    if (self.internalUrlRequest || ![self requestsAreReadOnly:requests]) {
+        return nil;
+    }
+    return [FBSettings requestRetryPolicy];
+}
+
+// A connection that only reads can safely give up on a server that is much
+// slower than usual, since the request can simply be made again.
+- (NSTimeInterval)timeoutForRequests:(NSArray *)requests
+{
+    if (!_usesDefaultTimeout ||
+        ![FBSettings isAdaptiveRequestTimeoutsEnabled] ||
+        ![self requestsAreReadOnly:requests]) {
+        return _timeout;
+    }
+    NSTimeInterval p99 = FBRequestConnectionLatencyPercentile(99);
+    if (p99 <= 0) {
+        return _timeout;
+    }
+    return MAX(kMinimumAdaptiveTimeout, MIN(p99 * kAdaptiveTimeoutLatencyMultiple, _timeout));
+}
+
+// Sends a duplicate of the shared call if it hasn't completed after the 95th
+// percentile latency; whichever of the two completes first is used.
+- (void)scheduleHedgeForSharedCall:(FBRequestConnectionSharedCall *)sharedCall
+                           request:(NSURLRequest *)request
+                       retryPolicy:(FBRequestRetryPolicy *)retryPolicy
+                           handler:(FBURLConnectionHandler)handler
+{
+    NSTimeInterval p95 = FBRequestConnectionLatencyPercentile(95);
+    if (![FBSettings isRequestHedgingEnabled] || p95 <= 0) {
+        return;
+    }
+    NSString *networkFeature = self.networkFeature;
+    FBRequestPriority priority = self.priority;
+    FBURLConnection *original = sharedCall.urlConnection;
+    dispatch_time_t when = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(MAX(p95, kMinimumHedgeDelay) * NSEC_PER_SEC));
+    dispatch_after(when, dispatch_get_main_queue(), ^{
+        if (sharedCall.completed || sharedCall.urlConnection != original || sharedCall.connections.count == 0) {
+            // Already completed or abandoned
+            return;
+        }
+        // the query carries the access token
+        NSString *urlWithoutQuery = [[request.URL.absoluteString componentsSeparatedByString:@"?"] objectAtIndex:0];
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorFBRequests
+                        formatString:@"Hedging request slower than %.0f msec: %@", p95 * 1000, urlWithoutQuery];
+        FBRequestConnectionRecordBytesSent(request);
+        FBURLConnection *hedge = [[FBURLConnection alloc] initWithRequest:request
+                                                    skipRoundTripIfCached:NO
+                                                              retryPolicy:retryPolicy
+                                                                 priority:priority
+                                                        completionHandler:handler];
+        hedge.networkFeature = networkFeature;
+        sharedCall.hedgeConnection = hedge;
+        [hedge release];
+    });
+}
+
 - (FBURLConnection *)newFBURLConnection {
     return [FBURLConnection alloc];
 }
@@ -518,9 +1692,17 @@ typedef enum FBRequestConnectionState {
 - (NSMutableURLRequest *)requestWithBatch:(NSArray *)requests
                                   timeout:(NSTimeInterval)timeout
 {
+    FBTraceBegin(FBTracePointBuildRequestBody, requests);
+
     FBRequestBody *body = [[FBRequestBody alloc] init];
-    FBLogger *bodyLogger = [[FBLogger alloc] initWithLoggingBehavior:_logger.loggingBehavior];
-    FBLogger *attachmentLogger = [[FBLogger alloc] initWithLoggingBehavior:_logger.loggingBehavior];
+    // Only pay for the body and attachment loggers when request logging is on; the
+    // body helpers treat a nil logger as a no-op.
+    FBLogger *bodyLogger = nil;
+    FBLogger *attachmentLogger = nil;
+    if (_logger.isActive) {
+        bodyLogger = [[FBLogger alloc] initWithLoggingBehavior:_logger.loggingBehavior];
+        attachmentLogger = [[FBLogger alloc] initWithLoggingBehavior:_logger.loggingBehavior];
+    }
 
     NSMutableURLRequest *request;
 
@@ -592,8 +1774,27 @@ typedef enum FBRequestConnectionState {
         [request setHTTPMethod:@"POST"];
     }
 
-    [request setHTTPBody:[body data]];
-    NSUInteger bodyLength = [[body data] length] / 1024;
+    if (body.length > kStreamedBodyThreshold) {
+        // Stream large uploads so the attachments aren't copied into one
+        // buffer, and then again by the connection
+        NSInputStream *bodyStream = [body newInputStream];
+        [request setHTTPBodyStream:bodyStream];
+        [bodyStream release];
+        [request setValue:[NSString stringWithFormat:@"%lu", (unsigned long)body.length]
+       forHTTPHeaderField:@"Content-Length"];
+    } else {
+        NSData *bodyData = [body data];
+        if ([FBSettings isRequestCompressionEnabled] && bodyData.length > kCompressedBodyThreshold) {
+            NSData *compressedData = [FBUtility gzipData:bodyData];
+            if (compressedData && compressedData.length < bodyData.length) {
+                bodyData = compressedData;
+                [request setValue:@"gzip" forHTTPHeaderField:@"Content-Encoding"];
+            }
+        }
+        [request setHTTPBody:bodyData];
+    }
+    NSUInteger bodyLength = body.length / 1024;
+    self.bodyError = body.error;
     [body release];
 
     [request setValue:[FBRequestConnection userAgent] forHTTPHeaderField:@"User-Agent"];
@@ -605,6 +1806,7 @@ typedef enum FBRequestConnectionState {
     [bodyLogger release];
     [attachmentLogger release];
 
+    FBTraceEnd(FBTracePointBuildRequestBody, requests);
     return request;
 }
 
@@ -656,40 +1858,56 @@ typedef enum FBRequestConnectionState {
         request.parameters[@"restricted_treatment"] = [@([FBSettings restrictedTreatment]) stringValue];
     }
     NSString *token = [self accessTokenWithRequest:request];
-    if (token) {
+    if (token && [token isEqualToString:self.headerAccessToken]) {
+        [request.parameters removeObjectForKey:kAccessTokenKey];
+        [self registerTokenToOmitFromLog:token];
+    } else if (token) {
         [request.parameters setValue:token forKey:kAccessTokenKey];
         [self registerTokenToOmitFromLog:token];
     }
 
-    NSString *baseURL;
+    // The host and version part of the URL comes from a cache, and the rest is
+    // written after it in one buffer
+    NSString *prefix = nil;
+    NSString *path;
     if (request.restMethod) {
-        if (forBatch) {
-            baseURL = [kBatchRestMethodBaseURL stringByAppendingString:request.restMethod];
-        } else {
-            baseURL = [[FBUtility buildFacebookUrlWithPre:kApiURLPrefix post:@"/method/" version:request.versionPart] stringByAppendingString:request.restMethod];
+        path = [kBatchRestMethodBaseURL stringByAppendingString:request.restMethod];
+        if (!forBatch) {
+            prefix = [FBUtility facebookURLPrefixWithPre:kApiURLPrefix version:request.versionPart];
         }
     } else {
-        if (forBatch) {
-            baseURL = request.graphPath;
-        } else {
-            NSString *prefix = kGraphURLPrefix;
+        path = request.graphPath;
+        if (!forBatch) {
+            NSString *pre = kGraphURLPrefix;
             // We special case a graph post to <id>/videos and send it to graph-video.facebook.com
             // We only do this for non batch post requests
-            if ([[request.HTTPMethod uppercaseString] isEqualToString:@"POST"] &&
-                [[request.graphPath lowercaseString] hasSuffix:@"/videos"]) {
-                NSArray *components = [request.graphPath componentsSeparatedByString:@"/"];
+            if ([request.HTTPMethod caseInsensitiveCompare:@"POST"] == NSOrderedSame &&
+                [path rangeOfString:@"/videos"
+                            options:NSCaseInsensitiveSearch | NSBackwardsSearch | NSAnchoredSearch].location != NSNotFound) {
+                NSArray *components = [path componentsSeparatedByString:@"/"];
                 if ([components count] == 2) {
-                    prefix = kGraphVideoURLPrefix;
+                    pre = kGraphVideoURLPrefix;
                 }
             }
-            baseURL = [[FBUtility buildFacebookUrlWithPre:prefix post:@"/" version:request.versionPart] stringByAppendingString:request.graphPath];
+            prefix = [FBUtility facebookURLPrefixWithPre:pre version:request.versionPart];
         }
     }
 
-    NSString *url = [FBRequest serializeURL:baseURL
-                                     params:request.parameters
-                                 httpMethod:request.HTTPMethod];
-    return url;
+    // A request made from a template starts its query with the template's encoded parameters,
+    // unless they have been changed since
+    FBRequestTemplate *requestTemplate = request.preparedTemplate;
+    if (requestTemplate && [requestTemplate matchesParametersOfRequest:request]) {
+        return [FBRequest serializeURLWithPrefix:prefix
+                                            path:path
+                                          params:request.parameters
+                                      httpMethod:request.HTTPMethod
+                                   encodedParams:requestTemplate.encodedParameters
+                                   omittedParams:requestTemplate.parameters];
+    }
+    return [FBRequest serializeURLWithPrefix:prefix
+                                        path:path
+                                      params:request.parameters
+                                  httpMethod:request.HTTPMethod];
 }
 
 // Find the first session with an app ID and use that as the batch_app_id. If we can't
@@ -705,6 +1923,56 @@ typedef enum FBRequestConnectionState {
     return [FBSettings defaultAppID];
 }
 
+// Requests that ask for the same thing get the same key, whatever order their
+// parameters were added in and whichever token they carry.
++ (NSString *)canonicalCacheKeyForRequests:(NSArray *)requests
+{
+    NSSet *volatileParameters = FBRequestCacheVolatileParameters();
+    NSMutableArray *requestKeys = [NSMutableArray arrayWithCapacity:requests.count];
+    for (FBRequest *request in requests) {
+        NSMutableArray *parameters = [NSMutableArray array];
+        for (NSString *name in request.parameters) {
+            id value = request.parameters[name];
+            if ([volatileParameters containsObject:name]) {
+                continue;
+            }
+            BOOL scalar = [value isKindOfClass:[NSString class]] || [value isKindOfClass:[NSNumber class]];
+            NSString *valueString = scalar ? [value description] : FBRequestCacheParameterDigest(value);
+            [parameters addObject:[NSString stringWithFormat:@"%@=%@",
+                                   [FBUtility stringByURLEncodingString:name],
+                                   [FBUtility stringByURLEncodingString:valueString]]];
+        }
+        [parameters sortUsingSelector:@selector(compare:)];
+
+        NSString *path = request.restMethod ? [@"method/" stringByAppendingString:request.restMethod] : request.graphPath;
+        NSString *method = [request.HTTPMethod uppercaseString] ?: @"GET";
+        [requestKeys addObject:[NSString stringWithFormat:@"%@%@/%@?%@",
+                                [method isEqualToString:@"GET"] ? @"" : [method stringByAppendingString:@":"],
+                                request.versionPart ?: FB_IOS_SDK_TARGET_PLATFORM_VERSION,
+                                path,
+                                [parameters componentsJoinedByString:@"&"]]];
+    }
+    return [requestKeys componentsJoinedByString:@","];
+}
+
+// Cached responses are scoped to the user they were fetched for, once the session
+// knows it; a token only learns its user when -[FBSession cacheUser:] is given the
+// /me result.  Until then entries are scoped to the access token itself, so they
+// don't outlive a token refresh.
+- (NSString *)cachePartitionForRequests:(NSArray *)requests
+{
+    FBRequest *firstRequest = requests.count ? [requests objectAtIndex:0] : nil;
+    NSString *userID = firstRequest.session.accessTokenData.userID;
+    if (userID.length) {
+        return [@"user/" stringByAppendingString:[FBUtility stringByURLEncodingString:userID]];
+    }
+    NSString *token = firstRequest ? [self accessTokenWithRequest:firstRequest] : nil;
+    if (token.length) {
+        return [@"token/" stringByAppendingString:[FBUtility stringByURLEncodingString:token]];
+    }
+    return @"anonymous";
+}
+
 - (NSString *)accessTokenWithRequest:(FBRequest *)request
 {
     NSString *token = request.session.accessTokenData.accessToken;
@@ -734,18 +2002,31 @@ typedef enum FBRequestConnectionState {
         andNameAttachments:(NSMutableDictionary *)attachments
                     logger:(FBLogger *)logger
 {
-    NSMutableArray *batch = [[NSMutableArray alloc] init];
-    for (FBRequestMetadata *metadata in requests) {
-        [self addRequest:metadata
-                 toBatch:batch
-             attachments:attachments];
+    FBMetrics *metrics = [FBMetrics sharedMetrics];
+    FBMetricsAllocationSample allocationSample;
+    [metrics beginAllocationSample:&allocationSample];
+
+    NSMutableArray *batch = [[NSMutableArray alloc] initWithCapacity:requests.count];
+    NSUInteger count = requests.count;
+    for (NSUInteger chunkStart = 0; chunkStart < count; chunkStart += kRequestProcessingChunkSize) {
+        @autoreleasepool {
+            NSUInteger chunkEnd = MIN(count, chunkStart + kRequestProcessingChunkSize);
+            for (NSUInteger i = chunkStart; i < chunkEnd; i++) {
+                [self addRequest:[requests objectAtIndex:i]
+                         toBatch:batch
+                     attachments:attachments];
+            }
+            [metrics updateAllocationSample:&allocationSample];
+        }
     }
 
-    NSString *jsonBatch = [FBUtility simpleJSONEncode:batch];
-
-    [batch release];
+    @autoreleasepool {
+        NSData *jsonBatch = [FBUtility simpleJSONEncodeToData:batch error:nil];
+        [batch release];
 
-    [body appendWithKey:kBatchKey formValue:jsonBatch logger:logger];
+        [body appendWithKey:kBatchKey formValueData:jsonBatch logger:logger];
+        [metrics endAllocationSample:&allocationSample metric:FBMetricBatchEncodingPeakBytes];
+    }
 }
 
 //
@@ -762,9 +2043,15 @@ typedef enum FBRequestConnectionState {
     if (metadata.batchParameters) {
         [requestElement addEntriesFromDictionary:metadata.batchParameters];
     }
+    if (!requestElement[kBatchDependsOnKey]) {
+        NSString *parentName = FBRequestConnectionReferencedBatchName(metadata.request);
+        if (parentName) {
+            requestElement[kBatchDependsOnKey] = parentName;
+        }
+    }
 
     NSString *token = [self accessTokenWithRequest:metadata.request];
-    if (token) {
+    if (token && ![token isEqualToString:self.headerAccessToken]) {
         [metadata.request.parameters setObject:token forKey:kAccessTokenKey];
         [self registerTokenToOmitFromLog:token];
     }
@@ -791,21 +2078,23 @@ typedef enum FBRequestConnectionState {
 
     // if we have a post object, also roll that into the body
     if (metadata.request.graphObject) {
-        NSMutableString *bodyValue = [[[NSMutableString alloc] init] autorelease];
-        __block NSString *delimiter = @"";
+        // the pairs are written as bytes into one buffer, and only turned into a string once
+        NSMutableData *bodyValue = [NSMutableData data];
         [FBRequestConnection
          processGraphObject:metadata.request.graphObject
          forPath:urlString
          withAction:^(NSString *key, id value) {
-             // escape the value
-             value = [FBUtility stringByURLEncodingString:[value description]];
-             [bodyValue appendFormat:@"%@%@=%@",
-              delimiter,
-              key,
-              value];
-             delimiter = @"&";
+             if (bodyValue.length) {
+                 [bodyValue appendBytes:"&" length:1];
+             }
+             const char *keyBytes = key.UTF8String;
+             [bodyValue appendBytes:keyBytes length:strlen(keyBytes)];
+             [bodyValue appendBytes:"=" length:1];
+             [FBUtility appendURLEncodedString:[value description] toData:bodyValue];
          }];
-        [requestElement setObject:bodyValue forKey:@"body"];
+        NSString *body = [[NSString alloc] initWithData:bodyValue encoding:NSUTF8StringEncoding];
+        [requestElement setObject:body forKey:@"body"];
+        [body release];
     }
 
     if ([attachmentNames length]) {
@@ -815,11 +2104,40 @@ typedef enum FBRequestConnectionState {
     [batch addObject:requestElement];
 }
 
+- (NSArray *)unencodedImageAttachments
+{
+    NSMutableArray *images = [NSMutableArray array];
+    for (FBRequestMetadata *metadata in self.requests) {
+        for (id value in [metadata.request.parameters objectEnumerator]) {
+            if ([value isKindOfClass:[UIImage class]] &&
+                ![_encodedImages objectForKey:[NSValue valueWithNonretainedObject:value]]) {
+                [images addObject:value];
+            }
+        }
+    }
+    return images;
+}
+
+- (void)addEncodedImages:(NSArray *)images data:(NSArray *)imageData
+{
+    if (!_encodedImages) {
+        _encodedImages = [[NSMutableDictionary alloc] init];
+    }
+    for (NSUInteger i = 0; i < images.count; i++) {
+        id data = [imageData objectAtIndex:i];
+        if ([data isKindOfClass:[NSData class]]) {
+            [_encodedImages setObject:data
+                               forKey:[NSValue valueWithNonretainedObject:[images objectAtIndex:i]]];
+        }
+    }
+}
+
 - (BOOL)isAttachment:(id)item
 {
     return
     [item isKindOfClass:[UIImage class]] ||
-    [item isKindOfClass:[NSData class]];
+    [item isKindOfClass:[NSData class]] ||
+    ([item isKindOfClass:[NSURL class]] && [(NSURL *)item isFileURL]);
 }
 
 - (void)appendAttachments:(NSDictionary *)attachments
@@ -840,9 +2158,16 @@ typedef enum FBRequestConnectionState {
     for (NSString *key in [attachments keyEnumerator]) {
         NSObject *value = [attachments objectForKey:key];
         if ([value isKindOfClass:[UIImage class]]) {
-            [body appendWithKey:key imageValue:(UIImage *)value logger:logger];
+            NSData *imageData = [_encodedImages objectForKey:[NSValue valueWithNonretainedObject:value]];
+            if (imageData) {
+                [body appendWithKey:key imageJPEGData:imageData logger:logger];
+            } else {
+                [body appendWithKey:key imageValue:(UIImage *)value logger:logger];
+            }
         } else if ([value isKindOfClass:[NSData class]]) {
             [body appendWithKey:key dataValue:(NSData *)value logger:logger];
+        } else if ([value isKindOfClass:[NSURL class]] && [(NSURL *)value isFileURL]) {
+            [body appendWithKey:key fileURL:(NSURL *)value logger:logger];
         }
     }
 }
@@ -934,13 +2259,31 @@ typedef enum FBRequestConnectionState {
 - (void)completeWithResponse:(NSURLResponse *)response
                         data:(NSData *)data
                      orError:(NSError *)error
+{
+    [self completeWithResponse:response
+                          data:data
+                 parsedResults:nil
+                       orError:error];
+}
+
+// As above, for callers that have already parsed data with parseJSONResponse:;
+// results and error are then what that returned.
+- (void)completeWithResponse:(NSURLResponse *)response
+                        data:(NSData *)data
+               parsedResults:(NSArray *)parsedResults
+                     orError:(NSError *)error
 {
     if (self.state != kStateCancelled) {
         NSAssert(self.state == kStateStarted,
                  @"Unexpected state %d in completeWithResponse",
                  self.state);
         self.state = kStateCompleted;
+        [[FBMetrics sharedMetrics] endSpanForTag:self metric:FBMetricRequestLatency elapsedMilliseconds:NULL];
+    } else {
+        [[FBMetrics sharedMetrics] cancelSpanForTag:self];
     }
+    [self stopObservingCancellationToken];
+    [self.timings markResponseReceived];
 
     NSInteger statusCode;
     if (response) {
@@ -965,8 +2308,8 @@ typedef enum FBRequestConnectionState {
 
 
 
-    NSArray *results = nil;
-    if (!error) {
+    NSArray *results = parsedResults;
+    if (!results && !error) {
         results = [self parseJSONResponse:data
                                     error:&error
                                statusCode:statusCode];
@@ -994,18 +2337,18 @@ typedef enum FBRequestConnectionState {
 
     if (!error) {
 
-        [_logger appendFormat:@"Response <#%lu>\nDuration: %lu msec\nSize: %lu kB\nResponse Body:\n%@\n\n",
+        FBLoggerAppendFormat(_logger, @"Response <#%lu>\nDuration: %lu msec\nSize: %lu kB\nResponse Body:\n%@\n\n",
          (unsigned long)[_logger loggerSerialNumber],
          [FBUtility currentTimeInMilliseconds] - _requestStartTime,
          (unsigned long)[data length],
-         results];
+         results);
 
     } else {
 
-        [_logger appendFormat:@"Response <#%lu> <Error>:\n%@\n%@\n",
+        FBLoggerAppendFormat(_logger, @"Response <#%lu> <Error>:\n%@\n%@\n",
          (unsigned long)[_logger loggerSerialNumber],
          [error localizedDescription],
-         [error userInfo]];
+         [error userInfo]);
 
     }
     [_logger emitToNSLog];
@@ -1037,56 +2380,94 @@ typedef enum FBRequestConnectionState {
                          error:(NSError **)error
                     statusCode:(NSInteger)statusCode;
 {
-    // Graph API can return "true" or "false", which is not valid JSON.
-    // Translate that before asking JSON parser to look at it.
-    NSString *responseUTF8 = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    FBTraceBegin(FBTracePointParseResponse, data);
+    NSTimeInterval parseStartTime = [FBRequestTimings currentTime];
+    FBMetrics *metrics = [FBMetrics sharedMetrics];
+    FBMetricsAllocationSample allocationSample;
+    [metrics beginAllocationSample:&allocationSample];
+
+    // Parse straight from the response bytes; only responses that turn out not
+    // to be JSON get converted to a string.
     NSArray *results = nil;
-    id response = [self parseJSONOrOtherwise:responseUTF8 error:error];
+    id response = [self parseJSONOrOtherwise:data error:error];
 
     if (*error) {
         // no-op
     } else if ([self.requests count] == 1) {
-        // response is the entry, so put it in a dictionary under "body" and add
-        // that to array of responses.
-        NSMutableDictionary *result = [[[NSMutableDictionary alloc] init] autorelease];
-        [result setObject:[NSNumber numberWithInteger:statusCode] forKey:@"code"];
-        [result setObject:response forKey:@"body"];
-
-        NSMutableArray *mutableResults = [[[NSMutableArray alloc] init] autorelease];
-        [mutableResults addObject:result];
-        results = mutableResults;
+        results = FBRequestConnectionResultsForSingleResponse(response, statusCode);
     } else if ([response isKindOfClass:[NSArray class]]) {
         // response is the array of responses, but the body element of each needs
         // to be decoded from JSON.
-        NSMutableArray *mutableResults = [[[NSMutableArray alloc] init] autorelease];
-        for (id item in response) {
-            // Don't let errors parsing one response stop us from parsing another.
-            NSError *batchResultError = nil;
+        NSArray *items = (NSArray *)response;
+        NSUInteger count = items.count;
+        id *bodies = calloc(count, sizeof(id));
+        NSError **bodyErrors = calloc(count, sizeof(NSError *));
+
+        // The bodies are independent, and for big batches (friend lists and
+        // the like) are most of the work, so decode them across all cores.
+        // Each iteration only writes its own slot.
+        dispatch_apply(count, FBDispatchGetGlobalQueue(FBDispatchLaneUtility), ^(size_t i) {
+            id item = [items objectAtIndex:i];
             if (![item isKindOfClass:[NSDictionary class]]) {
-                [mutableResults addObject:item];
-            } else {
-                NSDictionary *itemDictionary = (NSDictionary *)item;
-                NSMutableDictionary *result = [[[NSMutableDictionary alloc] init] autorelease];
-                for (NSString *key in [itemDictionary keyEnumerator]) {
-                    id value = [itemDictionary objectForKey:key];
-                    if ([value isKindOfClass:[NSNull class]]) {
-                        continue;
-                    }
+                return;
+            }
+            id value = [(NSDictionary *)item objectForKey:@"body"];
+            if (![value isKindOfClass:[NSString class]]) {
+                return;
+            }
 
-                    if ([key isEqualToString:@"body"]) {
-                        id body = [self parseJSONOrOtherwise:value error:&batchResultError];
-                        [result setObject:body forKey:key];
+            @autoreleasepool {
+                NSError *bodyError = nil;
+                bodies[i] = [[self parseJSONOrOtherwise:[value dataUsingEncoding:NSUTF8StringEncoding]
+                                                  error:&bodyError] retain];
+                bodyErrors[i] = [bodyError retain];
+            }
+        });
+
+        // Each result is retained by mutableResults, so only temporaries go with the pool
+        NSMutableArray *mutableResults = [[[NSMutableArray alloc] initWithCapacity:count] autorelease];
+        NSError *lastBodyError = nil;
+        for (NSUInteger chunkStart = 0; chunkStart < count; chunkStart += kRequestProcessingChunkSize) {
+            @autoreleasepool {
+                NSUInteger chunkEnd = MIN(count, chunkStart + kRequestProcessingChunkSize);
+                for (NSUInteger i = chunkStart; i < chunkEnd; i++) {
+                    id item = [items objectAtIndex:i];
+                    // Don't let errors parsing one response stop us from parsing another.
+                    if (![item isKindOfClass:[NSDictionary class]]) {
+                        [mutableResults addObject:item];
                     } else {
-                        [result setObject:value forKey:key];
+                        NSDictionary *itemDictionary = (NSDictionary *)item;
+                        NSMutableDictionary *result = [[[NSMutableDictionary alloc] init] autorelease];
+                        for (NSString *key in [itemDictionary keyEnumerator]) {
+                            id value = [itemDictionary objectForKey:key];
+                            if ([value isKindOfClass:[NSNull class]]) {
+                                continue;
+                            }
+
+                            if ([key isEqualToString:@"body"] && bodies[i]) {
+                                [result setObject:bodies[i] forKey:key];
+                            } else if (![key isEqualToString:@"body"] || !bodyErrors[i]) {
+                                [result setObject:value forKey:key];
+                            }
+                        }
+                        [mutableResults addObject:result];
                     }
+                    if (bodyErrors[i]) {
+                        // We'll report back the last error we saw.
+                        [lastBodyError release];
+                        lastBodyError = [bodyErrors[i] retain];
+                    }
+                    [bodies[i] release];
+                    [bodyErrors[i] release];
                 }
-                [mutableResults addObject:result];
-            }
-            if (batchResultError) {
-                // We'll report back the last error we saw.
-                *error = batchResultError;
+                [metrics updateAllocationSample:&allocationSample];
             }
         }
+        if (lastBodyError) {
+            *error = [lastBodyError autorelease];
+        }
+        free(bodies);
+        free(bodyErrors);
         results = mutableResults;
     } else {
         *error = [self errorWithCode:FBErrorProtocolMismatch
@@ -1096,30 +2477,27 @@ typedef enum FBRequestConnectionState {
                              message:nil];
     }
 
-    [responseUTF8 release];
+    [metrics endAllocationSample:&allocationSample metric:FBMetricResponseParsingPeakBytes];
+    [self.timings addParseDuration:[FBRequestTimings currentTime] - parseStartTime];
+    FBTraceEnd(FBTracePointParseResponse, data);
     return results;
 }
 
-- (id)parseJSONOrOtherwise:(NSString *)utf8
+- (id)parseJSONOrOtherwise:(NSData *)data
                      error:(NSError **)error
 {
     id parsed = nil;
     if (!(*error)) {
-        parsed = [FBUtility simpleJSONDecode:utf8 error:error];
-        // if we fail parse we attemp a reparse of a modified input to support results in the form "foo=bar", "true", etc.
-        if (*error) {
-            // we round-trip our hand-wired response through the parser in order to remain
-            // consistent with the rest of the output of this function (note, if perf turns out
-            // to be a problem -- unlikely -- we can return the following dictionary outright)
-            NSDictionary *original = [NSDictionary dictionaryWithObjectsAndKeys:
-                                      utf8, FBNonJSONResponseProperty,
-                                      nil];
-            NSString *jsonrep = [FBUtility simpleJSONEncode:original];
-            NSError *reparseError = nil;
-            parsed = [FBUtility simpleJSONDecode:jsonrep error:&reparseError];
-            if (!reparseError) {
-                *error = nil;
-            }
+        BOOL isJSONContainer = FBRequestConnectionDataStartsJSONContainer(data);
+        if (isJSONContainer) {
+            parsed = [FBUtility simpleJSONDecodeData:data error:error];
+        }
+        // if we fail parse we support results in the form "foo=bar", "true", etc.
+        // by handing back the raw response, as though it had been parsed
+        if ((data && !isJSONContainer) || *error) {
+            NSString *utf8 = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+            parsed = utf8 ? [NSDictionary dictionaryWithObject:utf8 forKey:FBNonJSONResponseProperty] : [NSDictionary dictionary];
+            *error = nil;
         }
     }
     return parsed;
@@ -1211,120 +2589,194 @@ typedef enum FBRequestConnectionState {
     // set up a new retry manager for this flow.
     self.retryManager = [[[FBRequestConnectionRetryManager alloc] initWithFBRequestConnection:self] autorelease];
 
-    NSUInteger count = [self.requests count];
-    NSMutableArray *tasks = [[NSMutableArray alloc] init];
-    for (NSUInteger i = 0; i < count; i++) {
-        FBRequestMetadata *metadata = [self.requests objectAtIndex:i];
-        id result = error ? nil : [results objectAtIndex:i];
-        NSError *itemError = error ? error : [self errorFromResult:result];
-
-        // Describes the cleaned up NSError to return back to callbacks.
-        NSError *unpackedError = [self unpackIndividualJSONResponseError:itemError];
-
-        id body = nil;
-        if (!itemError && [result isKindOfClass:[NSDictionary class]]) {
-            NSDictionary *resultDictionary = (NSDictionary *)result;
-            body = [FBGraphObject graphObjectWrappingDictionary:[resultDictionary objectForKey:@"body"]];
-        }
-
-        NSUInteger resultIndex = error == itemError ? i : 0;
-        FBTask *taskWork = [FBTask taskWithResult:nil];
-        FBSystemAccountStoreAdapter *systemAccountStoreAdapter = [FBSystemAccountStoreAdapter sharedInstance];
-
-        if ((metadata.request.session.accessTokenData.loginType == FBSessionLoginTypeSystemAccount) &&
-            [self isInsufficientPermissionError:error resultIndex:resultIndex]) {
-            // if we lack permissions, use this as a cue to refresh the
-            // OS's understanding of current permissions
-            taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
-                return [systemAccountStoreAdapter renewSystemAuthorizationAsTask];
-            } queue:dispatch_get_main_queue()];
-        } else if ([self isInvalidSessionError:itemError resultIndex:resultIndex]) {
-            if (metadata.request.session.accessTokenData.loginType == FBSessionLoginTypeSystemAccount) {
-                // For system auth, there are a number of edge cases we pre-process before
-                // closing the session.
-
-                if ([self isExpiredTokenError:itemError resultIndex:resultIndex]
-                    && systemAccountStoreAdapter.canRequestAccessWithoutUI) {
-                    // If token is expired and iOS says user has granted permissions
-                    // we can simply renew the token and flip the error to a retry.
-
-                    taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
-                        return [systemAccountStoreAdapter renewSystemAuthorizationAsTask];
-                    } queue:dispatch_get_main_queue()];
-
-                    taskWork = [taskWork completionTaskWithQueue:dispatch_get_main_queue() block:^id(FBTask *task) {
-                        if ([@(ACAccountCredentialRenewResultRenewed) isEqual:task.result]) {
-                            FBTask *requestAccessTask = [systemAccountStoreAdapter requestAccessToFacebookAccountStoreAsTask:metadata.request.session];
-                            return [requestAccessTask completionTaskWithQueue:dispatch_get_main_queue() block:^id(FBTask *task) {
-                                if (task.result && [task.result isKindOfClass:[NSString class]]) { // aka success means task.result ==  (oauthToken)
-                                    [metadata.request.session refreshAccessToken:(NSString *)task.result expirationDate:[NSDate distantFuture]];
-                                    [metadata invokeCompletionHandlerForConnection:self
-                                                                       withResults:body
-                                                                             error:[FBErrorUtility fberrorForRetry:unpackedError]];
-                                    return [FBTask cancelledTask];
-                                }
-                                return [FBTask taskWithError:nil];
-                            }];
-                        }
-                        return [FBTask taskWithError:nil];
-                    }];
-                } else if ([self isPasswordChangeError:itemError resultIndex:resultIndex]) {
-                    // For iOS6, when the password is changed on the server, the system account store
-                    // will continue to issue the old token until the user has changed the
-                    // password AND _THEN_ a renew call is made. To prevent opening
-                    // with an old token which would immediately be closed, we tell our adapter
-                    // that we want to force a blocking renew until success.
-                    [FBSystemAccountStoreAdapter sharedInstance].forceBlockingRenew = YES;
-                } else {
-                    // For other invalid session cases, we can simply issue the renew now
-                    // to update the system account's world view.
-                    taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
-                        return [systemAccountStoreAdapter renewSystemAuthorizationAsTask];
-                    } queue:dispatch_get_main_queue()];
-                }
+    if (!error) {
+        [FBRequestOutbox connectionDidSucceed];
+    }
+
+    [self performRetriesAfterTasks:[self completionTasksForRequests:self.requests
+                                                            results:results
+                                                            orError:error]];
+}
+
+// Returns a task per request that does any session follow-up work for its
+// result and then calls its handler.
+- (NSArray *)completionTasksForRequests:(NSArray *)requests
+                                results:(NSArray *)results
+                                orError:(NSError *)error
+{
+    // Handlers on a caller's queue don't wait behind the session work of other
+    // requests on the main queue
+    dispatch_queue_t handlerQueue = self.completionQueue ?: dispatch_get_main_queue();
+
+    // Every chain starts from the same task, completed by a single dispatch to the
+    // handler queue; after that each step runs inline when its antecedent finishes
+    // on the queue it needs, so a chain costs one runloop turn instead of one per step.
+    FBTaskExecutor *mainExecutor = [FBTaskExecutor mainThreadExecutor];
+    FBTaskExecutor *handlerExecutor = [FBTaskExecutor executorWithDispatchQueue:handlerQueue];
+    FBTaskCompletionSource *chainStart = [FBTaskCompletionSource taskCompletionSource];
+
+    FBMetrics *metrics = [FBMetrics sharedMetrics];
+    FBMetricsAllocationSample allocationSample;
+    [metrics beginAllocationSample:&allocationSample];
+
+    NSUInteger count = [requests count];
+    NSMutableArray *tasks = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger chunkStart = 0; chunkStart < count; chunkStart += kRequestProcessingChunkSize) {
+        // What outlives a chunk is retained by its tasks' blocks, and the tasks by tasks
+        @autoreleasepool {
+            NSUInteger chunkEnd = MIN(count, chunkStart + kRequestProcessingChunkSize);
+            for (NSUInteger i = chunkStart; i < chunkEnd; i++) {
+                [tasks addObject:[self completionTaskForRequest:[requests objectAtIndex:i]
+                                                        atIndex:i
+                                                        results:results
+                                                        orError:error
+                                                      afterTask:chainStart.task
+                                                   mainExecutor:mainExecutor
+                                                handlerExecutor:handlerExecutor]];
             }
-            // Invalid session case, should close the session at end of this if block
-            // unless we signified not to earlier via a task cancellation.
-            taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
-                if (task.isCancelled) {
-                    return task;
-                }
-                if ([self shouldCloseRequestSession:metadata.request]) {
-                    [metadata.request.session closeAndClearTokenInformation:unpackedError];
-                }
-                return [FBTask taskWithResult:nil];
-            } queue:dispatch_get_main_queue()];
-        } else if ([metadata.request.session shouldExtendAccessToken]) {
-            // If we have not had the opportunity to piggyback a token-extension request,
-            // but we need to, do so now as a separate request.
-            taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
-                FBRequestConnection *connection = [[FBRequestConnection alloc] init];
-                [FBRequestConnection addRequestToExtendTokenForSession:metadata.request.session
-                                                            connection:connection];
-                [connection start];
-                [connection release];
-                return [FBTask taskWithResult:nil];
-            } queue:dispatch_get_main_queue()];
-        }
-
-        // Always invoke handler at the end.
+            [metrics updateAllocationSample:&allocationSample];
+        }
+    }
+
+    [metrics endAllocationSample:&allocationSample metric:FBMetricRequestCompletionPeakBytes];
+
+    dispatch_async(handlerQueue, ^{
+        chainStart.result = nil;
+    });
+
+    return tasks;
+}
+
+// The task for one request of completionTasksForRequests:results:orError:
+- (FBTask *)completionTaskForRequest:(FBRequestMetadata *)metadata
+                             atIndex:(NSUInteger)i
+                             results:(NSArray *)results
+                             orError:(NSError *)error
+                           afterTask:(FBTask *)chainStartTask
+                        mainExecutor:(FBTaskExecutor *)mainExecutor
+                     handlerExecutor:(FBTaskExecutor *)handlerExecutor
+{
+    id result = error ? nil : [results objectAtIndex:i];
+    NSError *itemError = error ? error : [self errorFromResult:result];
+    if ([result isKindOfClass:[NSError class]]) {
+        // The whole batch this request went out in failed
+        itemError = result;
+        result = nil;
+    }
+
+    // Describes the cleaned up NSError to return back to callbacks.
+    NSError *unpackedError = [self unpackIndividualJSONResponseError:itemError];
+    if (itemError && metadata.request.queuesWhenOffline) {
+        // Kept to be sent again once the network is back; the handler still hears about this failure
+        unpackedError = [[FBRequestOutbox sharedOutbox] queueRequest:metadata.request afterError:unpackedError];
+    }
+
+    id body = nil;
+    if (!itemError && [result isKindOfClass:[NSDictionary class]]) {
+        NSDictionary *resultDictionary = (NSDictionary *)result;
+        body = [FBGraphObject graphObjectWrappingDictionary:[resultDictionary objectForKey:@"body"]];
+    }
+
+    NSUInteger resultIndex = error == itemError ? i : 0;
+    FBTask *taskWork = chainStartTask;
+    FBSystemAccountStoreAdapter *systemAccountStoreAdapter = [FBSystemAccountStoreAdapter sharedInstance];
+
+    if ((metadata.request.session.accessTokenData.loginType == FBSessionLoginTypeSystemAccount) &&
+        [self isInsufficientPermissionError:error resultIndex:resultIndex]) {
+        // if we lack permissions, use this as a cue to refresh the
+        // OS's understanding of current permissions
+        taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
+            return [systemAccountStoreAdapter renewSystemAuthorizationAsTask];
+        } executor:mainExecutor];
+    } else if ([self isInvalidSessionError:itemError resultIndex:resultIndex]) {
+        if (metadata.request.session.accessTokenData.loginType == FBSessionLoginTypeSystemAccount) {
+            // For system auth, there are a number of edge cases we pre-process before
+            // closing the session.
+
+            if ([self isExpiredTokenError:itemError resultIndex:resultIndex]
+                && systemAccountStoreAdapter.canRequestAccessWithoutUI) {
+                // If token is expired and iOS says user has granted permissions
+                // we can simply renew the token and flip the error to a retry.
+
+                taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
+                    return [systemAccountStoreAdapter renewSystemAuthorizationAsTask];
+                } executor:mainExecutor];
+
+                taskWork = [taskWork completionTaskWithExecutor:mainExecutor block:^id(FBTask *task) {
+                    if ([@(ACAccountCredentialRenewResultRenewed) isEqual:task.result]) {
+                        FBTask *requestAccessTask = [systemAccountStoreAdapter requestAccessToFacebookAccountStoreAsTask:metadata.request.session];
+                        return [requestAccessTask completionTaskWithExecutor:mainExecutor block:^id(FBTask *task) {
+                            if (task.result && [task.result isKindOfClass:[NSString class]]) { // aka success means task.result ==  (oauthToken)
+                                [metadata.request.session refreshAccessToken:(NSString *)task.result expirationDate:[NSDate distantFuture]];
+                                [metadata invokeCompletionHandlerForConnection:self
+                                                                   withResults:body
+                                                                         error:[FBErrorUtility fberrorForRetry:unpackedError]];
+                                return [FBTask cancelledTask];
+                            }
+                            return [FBTask taskWithError:nil];
+                        }];
+                    }
+                    return [FBTask taskWithError:nil];
+                }];
+            } else if ([self isPasswordChangeError:itemError resultIndex:resultIndex]) {
+                // For iOS6, when the password is changed on the server, the system account store
+                // will continue to issue the old token until the user has changed the
+                // password AND _THEN_ a renew call is made. To prevent opening
+                // with an old token which would immediately be closed, we tell our adapter
+                // that we want to force a blocking renew until success.
+                [FBSystemAccountStoreAdapter sharedInstance].forceBlockingRenew = YES;
+            } else {
+                // For other invalid session cases, we can simply issue the renew now
+                // to update the system account's world view.
+                taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
+                    return [systemAccountStoreAdapter renewSystemAuthorizationAsTask];
+                } executor:mainExecutor];
+            }
+        }
+        // Invalid session case, should close the session at end of this if block
+        // unless we signified not to earlier via a task cancellation.
         taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
             if (task.isCancelled) {
                 return task;
             }
-            [metadata invokeCompletionHandlerForConnection:self withResults:body error:unpackedError];
+            if ([self shouldCloseRequestSession:metadata.request]) {
+                [metadata.request.session closeAndClearTokenInformation:unpackedError];
+            }
+            return [FBTask taskWithResult:nil];
+        } executor:mainExecutor];
+    } else if ([metadata.request.session shouldExtendAccessToken]) {
+        // If we have not had the opportunity to piggyback a token-extension request,
+        // but we need to, do so now as a separate request.
+        taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
+            FBRequestConnection *connection = [[FBRequestConnection alloc] init];
+            [FBRequestConnection addRequestToExtendTokenForSession:metadata.request.session
+                                                        connection:connection];
+            [connection start];
+            [connection release];
             return [FBTask taskWithResult:nil];
-        } queue:dispatch_get_main_queue()];
-        [tasks addObject:taskWork];
-    } //end for loop
+        } executor:mainExecutor];
+    }
 
+    // Always invoke handler at the end.
+    taskWork = [taskWork dependentTaskWithBlock:^id(FBTask *task) {
+        if (task.isCancelled) {
+            return task;
+        }
+        [metadata invokeCompletionHandlerForConnection:self withResults:body error:unpackedError];
+        return [FBTask taskWithResult:nil];
+    } executor:handlerExecutor];
+    return taskWork;
+}
 
+- (void)performRetriesAfterTasks:(NSArray *)tasks
+{
+    FBTraceBegin(FBTracePointCompletion, self);
     FBTask *finalTask = [FBTask taskDependentOnTasks:tasks];
     [finalTask dependentTaskWithBlock:^id(FBTask *task) {
+        FBTraceEnd(FBTracePointCompletion, self);
         [self.retryManager performRetries];
         return [FBTask taskWithResult:nil];
     } queue:dispatch_get_main_queue()];
-    [tasks release];
 }
 
 - (NSError *)errorFromResult:(id)idResult
@@ -1488,7 +2940,7 @@ typedef enum FBRequestConnectionState {
 
 - (void)registerTokenToOmitFromLog:(NSString *)token
 {
-    if (![[FBSettings loggingBehavior] containsObject:FBLoggingBehaviorAccessTokens]) {
+    if (!FBLoggerIsEnabled(FBLoggingBehaviorAccessTokens)) {
         [FBLogger registerStringToReplace:token replaceWith:@"ACCESS_TOKEN_REMOVED"];
     }
 }
@@ -1538,9 +2990,25 @@ typedef enum FBRequestConnectionState {
     }
 
     [sessions release];
+
+    // Pending App Events go out with this batch rather than waking the radio on their own later
+    if (self.requests.count < kMaximumBatchSize &&
+        [NSThread isMainThread] &&
+        ![self.networkFeature isEqualToString:FBNetworkFeatureAppEvents]) {
+        [FBAppEvents addPiggybackRequestsToConnection:self
+                                             forAppID:[self getBatchAppID:self.requests]
+                                         maximumCount:kMaximumBatchSize - self.requests.count];
+    }
 }
 
 + (void)addRequestToExtendTokenForSession:(FBSession *)session connection:(FBRequestConnection *)connection
+{
+    [self addRequestToExtendTokenForSession:session connection:connection completionHandler:nil];
+}
+
++ (void)addRequestToExtendTokenForSession:(FBSession *)session
+                               connection:(FBRequestConnection *)connection
+                        completionHandler:(FBRequestHandler)handler
 {
     FBRequest *request = [[FBRequest alloc] initWithSession:session
                                                  restMethod:kExtendTokenRestMethod
@@ -1573,11 +3041,20 @@ typedef enum FBRequestConnectionState {
                                   expirationDate:expirationDate];
                  }
              }
+             if (handler) {
+                 handler(connection, result, error);
+             }
          }];
     [request release];
 }
 
 + (void)addRequestToRefreshPermissionsSession:(FBSession *)session connection:(FBRequestConnection *)connection {
+    [self addRequestToRefreshPermissionsSession:session connection:connection completionHandler:nil];
+}
+
++ (void)addRequestToRefreshPermissionsSession:(FBSession *)session
+                                   connection:(FBRequestConnection *)connection
+                            completionHandler:(FBRequestHandler)handler {
     FBRequest *request = [[FBRequest alloc] initWithSession:session graphPath:@"me/permissions"];
     request.canCloseSessionOnError = NO;
 
@@ -1586,6 +3063,9 @@ typedef enum FBRequestConnectionState {
              if (!error) {
                  [session handleRefreshPermissions:result];
              }
+             if (handler) {
+                 handler(connection, result, error);
+             }
          }];
     [request release];
 }
@@ -42,6 +42,9 @@ typedef enum {
 //   attempt to repair the session) invoke the queued handlers.
 // Thus, this class has the unfortunate responsibility of keeping state
 //   between handlers.
+// Session repairs and alerts are coordinated across all managers, so concurrent
+//   connections failing on the same session wait on one repair and are replayed
+//   together after it succeeds.
 @interface FBRequestConnectionRetryManager : NSObject
 
 // This is like a delegate pattern in that this is a weak reference to the
@@ -23,6 +23,25 @@
 #import "FBSession+Internal.h"
 #import "FBUtility.h"
 
+// Batch entry names are only unique within the connection that gave them out, so two
+// managers' requests can't share a replay if any of their names are the same.
+static BOOL FBRequestConnectionBatchEntryNamesCollide(FBRequestConnection *connection, NSArray *metadatas) {
+    NSMutableSet *names = [NSMutableSet set];
+    for (FBRequestMetadata *metadata in connection.requests) {
+        NSString *name = metadata.batchParameters[kBatchEntryName];
+        if (name) {
+            [names addObject:name];
+        }
+    }
+    for (FBRequestMetadata *metadata in metadatas) {
+        NSString *name = metadata.batchParameters[kBatchEntryName];
+        if (name && [names containsObject:name]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
 // An INTERNAL "light-weight" structure for presenting an alertview and assigning a completion block to call after
 // the alert has been dismissed. The alert will be dispatched to the main queue. The callback will also be dispatched
 // to the the main thread after the alert has been dismissed.
@@ -63,7 +82,143 @@
 @interface FBRequestConnectionRetryManager ()
 
 @property (nonatomic, retain) NSMutableArray *requestMetadatas;
+
+- (void)repairSuccessAddingToConnections:(NSMutableDictionary *)connections;
+- (void)repairFailed;
+- (void)repairFinished;
+
+@end
+
+// An INTERNAL process-wide coordinator shared by all retry managers. When a token goes bad under load,
+// every connection in flight fails at about the same time; rather than have each one show the same alert
+// and start its own repair (all but the first of which would fail with FBErrorSessionReconnectInProgess),
+// managers for the same session are parked behind a single repair and replayed together once it succeeds.
+@interface FBRequestConnectionRepairCoordinator : NSObject
+
++ (instancetype)sharedCoordinator;
+
+- (void)showAlertMessage:(NSString *)message handler:(void(^)(void))handler;
+- (void)repairSession:(FBSession *)session forRetryManager:(FBRequestConnectionRetryManager *)retryManager;
+
+@end
+
+@interface FBRequestConnectionRepairCoordinator ()
+
 @property (nonatomic, retain) FBRequestConnectionRetryManagerAlertViewHelper *alertViewHelper;
+@property (nonatomic, copy) NSString *visibleAlertMessage;
+@property (nonatomic, retain) NSMutableArray *alertHandlers;
+@property (nonatomic, retain) NSMutableDictionary *parkedRetryManagers;
+
+@end
+
+@implementation FBRequestConnectionRepairCoordinator
+
++ (instancetype)sharedCoordinator {
+    static FBRequestConnectionRepairCoordinator *_instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBRequestConnectionRepairCoordinator alloc] init];
+    });
+    return _instance;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _alertViewHelper = [[FBRequestConnectionRetryManagerAlertViewHelper alloc] init];
+        _alertHandlers = [[NSMutableArray alloc] init];
+        _parkedRetryManagers = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_alertViewHelper release];
+    [_visibleAlertMessage release];
+    [_alertHandlers release];
+    [_parkedRetryManagers release];
+
+    [super dealloc];
+}
+
+// Called on the main thread. A message identical to the one already on screen is not shown
+// again; its handler runs when the visible alert is dismissed.
+- (void)showAlertMessage:(NSString *)message handler:(void(^)(void))handler {
+    if (self.visibleAlertMessage) {
+        if ([self.visibleAlertMessage isEqualToString:message]) {
+            [self.alertHandlers addObject:[[handler copy] autorelease]];
+        } else {
+            // a different message is up; show this one once the current alert goes away
+            NSString *nextMessage = [[message copy] autorelease];
+            void(^nextHandler)(void) = [[handler copy] autorelease];
+            [self.alertHandlers addObject:[[^{
+                [self showAlertMessage:nextMessage handler:nextHandler];
+            } copy] autorelease]];
+        }
+        return;
+    }
+
+    [self.alertHandlers addObject:[[handler copy] autorelease]];
+
+    self.visibleAlertMessage = message;
+    NSString *buttonText = [FBUtility localizedStringForKey:@"FBE:AlertMessageButton" withDefault:@"OK"];
+    [self.alertViewHelper show:nil message:message cancelButtonTitle:buttonText
+                       handler:^{
+                           NSArray *handlers = [[self.alertHandlers copy] autorelease];
+                           [self.alertHandlers removeAllObjects];
+                           self.visibleAlertMessage = nil;
+                           for (void(^alertHandler)(void) in handlers) {
+                               alertHandler();
+                           }
+                       }];
+}
+
+- (void)repairSession:(FBSession *)session forRetryManager:(FBRequestConnectionRetryManager *)retryManager {
+    NSValue *key = [NSValue valueWithNonretainedObject:session];
+    @synchronized (self) {
+        NSMutableArray *parked = self.parkedRetryManagers[key];
+        if (parked) {
+            [parked addObject:retryManager];
+            return;
+        }
+        self.parkedRetryManagers[key] = [NSMutableArray arrayWithObject:retryManager];
+    }
+
+    NSThread *thread = session.affinitizedThread ?: [NSThread mainThread];
+    FBSessionRequestPermissionResultHandler handler = [[^(FBSession *innerSession, NSError *sessionError) {
+        BOOL success = innerSession.isOpen && !sessionError;
+        NSArray *managers = nil;
+        @synchronized (self) {
+            managers = [[self.parkedRetryManagers[key] retain] autorelease];
+            [self.parkedRetryManagers removeObjectForKey:key];
+        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self finishRepair:success forRetryManagers:managers];
+        });
+    } copy] autorelease];
+
+    [session performSelector:@selector(repairWithHandler:) onThread:thread withObject:handler waitUntilDone:NO];
+}
+
+- (void)finishRepair:(BOOL)success forRetryManagers:(NSArray *)managers {
+    if (success) {
+        // one connection per distinct error behavior; requests beyond the batch limit are
+        // sharded by the connection itself
+        NSMutableDictionary *connections = [NSMutableDictionary dictionary];
+        for (FBRequestConnectionRetryManager *manager in managers) {
+            [manager repairSuccessAddingToConnections:connections];
+        }
+        for (FBRequestConnection *connection in connections.allValues) {
+            [connection start];
+        }
+    } else {
+        for (FBRequestConnectionRetryManager *manager in managers) {
+            [manager repairFailed];
+        }
+    }
+    for (FBRequestConnectionRetryManager *manager in managers) {
+        [manager repairFinished];
+    }
+}
 
 @end
 
@@ -74,7 +229,6 @@
     if ((self = [self init])) {
         self.requestConnection = requestConnection;
         _requestMetadatas = [[NSMutableArray alloc] init];
-        _alertViewHelper = [[FBRequestConnectionRetryManagerAlertViewHelper alloc] init];
     }
     return self;
 }
@@ -86,13 +240,12 @@
 - (void)performRetries {
     if (self.alertMessage.length > 0) {
         [_requestConnection retain];
-        NSString *buttonText = [FBUtility localizedStringForKey:@"FBE:AlertMessageButton" withDefault:@"OK"];
-        [self.alertViewHelper show:nil message:self.alertMessage cancelButtonTitle:buttonText
-                      handler:^{
-                                  self.alertMessage = nil;
-                                  [self performRetries];
-                                  [_requestConnection release];
-                             }];
+        [[FBRequestConnectionRepairCoordinator sharedCoordinator] showAlertMessage:self.alertMessage
+                                                                           handler:^{
+                                                                               self.alertMessage = nil;
+                                                                               [self performRetries];
+                                                                               [_requestConnection release];
+                                                                           }];
         return;
     }
 
@@ -100,6 +253,9 @@
         switch (self.state) {
             case FBRequestConnectionRetryManagerStateNormal : {
                 FBRequestConnection *connectionToRetry = [[[FBRequestConnection alloc] initWithMetadata:self.requestMetadatas] autorelease];
+                connectionToRetry.networkFeature = self.requestConnection.networkFeature;
+                connectionToRetry.priority = self.requestConnection.priority;
+                connectionToRetry.cancellationToken = self.requestConnection.cancellationToken;
                 [connectionToRetry start];
                 break;
             }
@@ -110,41 +266,54 @@
                 break;
             }
             case FBRequestConnectionRetryManagerStateRepairSession : {
+                // balanced in repairFinished
+                [self retain];
                 [_requestConnection retain];
-                NSThread *thread = self.sessionToReconnect.affinitizedThread ?: [NSThread mainThread];
-                FBSessionRequestPermissionResultHandler handler = [[^(FBSession *session, NSError *sessionError) {
-                    if (session.isOpen && !sessionError) {
-                        [self repairSuccess];
-                    } else {
-                        [self repairFailed];
-                    }
-                    [_requestConnection release];
-                } copy] autorelease];
-
-                [self.sessionToReconnect performSelector:@selector(repairWithHandler:) onThread:thread withObject:handler waitUntilDone:NO];
-
+                [[FBRequestConnectionRepairCoordinator sharedCoordinator] repairSession:self.sessionToReconnect
+                                                                        forRetryManager:self];
                 break;
             }
         }
     }
 }
 
-- (void)repairSuccess {
+- (void)repairSuccessAddingToConnections:(NSMutableDictionary *)connections {
     if (self.requestMetadatas.count > 0) {
-        // Construct new request connection and re-add the requests, but removing
-        // the "autoreconnect" behavior (though we still allow the simpler retry)
-        // and alerts (since those would have already been surfaced prior to the repair attempt).
-        FBRequestConnection *connectionToRetry = [[[FBRequestConnection alloc] init] autorelease];
-        connectionToRetry.errorBehavior = self.requestConnection.errorBehavior
+        // Re-add the requests to a connection without the "autoreconnect" behavior
+        // (though we still allow the simpler retry) and alerts (since those would have
+        // already been surfaced prior to the repair attempt). Connections are shared with
+        // other managers parked on the same repair so the replay goes out batched, as long
+        // as everything the original connection was set up with is the same.
+        FBRequestConnection *original = self.requestConnection;
+        FBRequestConnectionErrorBehavior errorBehavior = original.errorBehavior
             & ~FBRequestConnectionErrorBehaviorReconnectSession
             & ~FBRequestConnectionErrorBehaviorAlertUser;
+        NSString *key = [NSString stringWithFormat:@"%lu|%d|%@|%p|%p",
+                         (unsigned long)errorBehavior,
+                         (int)original.priority,
+                         original.networkFeature,
+                         original.cancellationToken,
+                         original.completionQueue];
+        FBRequestConnection *connectionToRetry = connections[key];
+        if (connectionToRetry && FBRequestConnectionBatchEntryNamesCollide(connectionToRetry, self.requestMetadatas)) {
+            key = [key stringByAppendingFormat:@"|%p", self];
+            connectionToRetry = nil;
+        }
+        if (!connectionToRetry) {
+            connectionToRetry = [[[FBRequestConnection alloc] init] autorelease];
+            connectionToRetry.errorBehavior = errorBehavior;
+            connectionToRetry.priority = original.priority;
+            connectionToRetry.networkFeature = original.networkFeature;
+            connectionToRetry.cancellationToken = original.cancellationToken;
+            connectionToRetry.completionQueue = original.completionQueue;
+            connections[key] = connectionToRetry;
+        }
         for (FBRequestMetadata *metadata in self.requestMetadatas) {
             metadata.request.canCloseSessionOnError = YES;
             [connectionToRetry addRequest:metadata.request
                         completionHandler:metadata.originalCompletionHandler
                           batchParameters:metadata.batchParameters];
         }
-        [connectionToRetry start];
     }
 }
 
@@ -161,11 +330,15 @@
     }
 }
 
+- (void)repairFinished {
+    [_requestConnection release];
+    [self release];
+}
+
 - (void)dealloc {
     [_sessionToReconnect release];
     [_alertMessage release];
     [_requestMetadatas release];
-    [_alertViewHelper release];
 
     [super dealloc];
 }
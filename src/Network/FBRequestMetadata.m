@@ -18,6 +18,7 @@
 
 #import "FBRequest+Internal.h"
 #import "FBRequestHandlerFactory.h"
+#import "FBRequestTimings+Internal.h"
 
 const int FBREQUEST_DEFAULT_MAX_RETRY_LIMIT = 1;
 
@@ -72,6 +73,7 @@ const int FBREQUEST_DEFAULT_MAX_RETRY_LIMIT = 1;
                                  withResults:(id)results
                                        error:(NSError *)error {
     if (self.completionHandler) {
+        [connection.timings markHandlerInvoked];
         self.completionHandler(connection, results, error);
     }
 }
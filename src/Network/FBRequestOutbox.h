@@ -0,0 +1,52 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+@class FBRequest;
+
+// Requests that opted in with queuesWhenOffline and failed because the device was
+// offline.  They are journaled to a file in the library directory and sent again
+// once the network is reachable, the app becomes active, or another connection
+// gets through, grouped into one connection per access token so they go out as
+// Graph batches rather than one POST each.  Requests the server answers, with
+// success or an API error, are dropped from the journal; ones that fail offline
+// again wait for the next chance.
+@interface FBRequestOutbox : NSObject
+
++ (FBRequestOutbox *)sharedOutbox;
+
+// For tests; the shared outbox uses a file in the library directory.
+- (instancetype)initWithPath:(NSString *)path;
+
+// Journals request if error shows it never got through and the request can be
+// written down, returning the error to report with FBErrorRequestQueuedOfflineKey
+// set.  Otherwise returns error unchanged.
+- (NSError *)queueRequest:(FBRequest *)request afterError:(NSError *)error;
+
+// Sends whatever is journaled, unless a send is already under way or the network
+// is known to be unreachable.
+- (void)sendPendingRequests;
+
+// Requests journaled and not yet answered by the server.
+@property (nonatomic, readonly) NSUInteger pendingRequestCount;
+
+// Called as connections succeed, which is the surest sign the network is back.
+// Also picks up requests a previous launch left journaled.
++ (void)connectionDidSucceed;
+
+@end
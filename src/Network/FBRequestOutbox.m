@@ -0,0 +1,389 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBRequestOutbox.h"
+
+#import <netinet/in.h>
+#import <SystemConfiguration/SystemConfiguration.h>
+#import <UIKit/UIKit.h>
+
+#import "FBDispatch.h"
+#import "FBDynamicFrameworkLoader.h"
+#import "FBError.h"
+#import "FBGraphObject.h"
+#import "FBLogger.h"
+#import "FBRequest+Internal.h"
+#import "FBRequestConnection.h"
+#import "FBSession.h"
+#import "FBSettings.h"
+#import "FBUtility.h"
+
+static NSString *const kOutboxFileName = @"com-facebook-sdk-RequestOutbox.plist";
+// Beyond these the oldest requests are dropped; nobody wants a week old status update
+static const NSUInteger kMaximumEntryCount = 200;
+static const NSTimeInterval kEntryTimeToLive = 3 * 24 * 60 * 60;
+
+static NSString *const kEntryGraphPathKey = @"graph_path";
+static NSString *const kEntryHTTPMethodKey = @"method";
+static NSString *const kEntryParametersKey = @"parameters";
+static NSString *const kEntryGraphObjectKey = @"graph_object";
+static NSString *const kEntryAccessTokenKey = @"access_token";
+static NSString *const kEntryQueuedTimeKey = @"queued";
+
+static FBRequestOutbox *g_sharedOutbox;
+
+// Failures where the request can't have been answered, or (for a timeout or a dropped
+// connection) may not have been; which is why callers have to opt in to repeats.
+static BOOL FBRequestOutboxIsOfflineError(NSError *error) {
+    if ([error.domain isEqualToString:FacebookSDKDomain]) {
+        if (error.code != FBErrorHTTPError) {
+            return NO;
+        }
+        error = error.userInfo[FBErrorInnerErrorKey];
+    }
+    if (![error.domain isEqualToString:NSURLErrorDomain]) {
+        return NO;
+    }
+    switch (error.code) {
+        case NSURLErrorNotConnectedToInternet:
+        case NSURLErrorNetworkConnectionLost:
+        case NSURLErrorTimedOut:
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorDNSLookupFailed:
+        case NSURLErrorInternationalRoamingOff:
+        case NSURLErrorDataNotAllowed:
+        case NSURLErrorCallIsActive:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+static NSString *FBRequestOutboxPath(void) {
+    NSArray *libraryList = NSSearchPathForDirectoriesInDomains(NSLibraryDirectory, NSUserDomainMask, YES);
+    return [[libraryList objectAtIndex:0] stringByAppendingPathComponent:kOutboxFileName];
+}
+
+static void FBRequestOutboxReachabilityChanged(SCNetworkReachabilityRef target, SCNetworkReachabilityFlags flags, void *info) {
+    if (flags & kSCNetworkReachabilityFlagsReachable) {
+        [(FBRequestOutbox *)info sendPendingRequests];
+    }
+}
+
+@implementation FBRequestOutbox {
+    NSString *_path;
+    // Only touched on _queue
+    NSMutableArray *_entries;
+    NSUInteger _outstandingRequestCount;
+    dispatch_queue_t _queue;
+    SCNetworkReachabilityRef _reachability;
+}
+
++ (FBRequestOutbox *)sharedOutbox
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        g_sharedOutbox = [[FBRequestOutbox alloc] initWithPath:FBRequestOutboxPath()];
+    });
+    return g_sharedOutbox;
+}
+
++ (void)connectionDidSucceed
+{
+    if (g_sharedOutbox) {
+        [g_sharedOutbox sendPendingRequests];
+        return;
+    }
+
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        // Apps that never opt in shouldn't pay for an outbox, so only bring it up
+        // if an earlier launch left one behind
+        dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneBackground), ^{
+            if ([[NSFileManager defaultManager] fileExistsAtPath:FBRequestOutboxPath()]) {
+                [[FBRequestOutbox sharedOutbox] sendPendingRequests];
+            }
+        });
+    });
+}
+
+- (instancetype)init
+{
+    return [self initWithPath:FBRequestOutboxPath()];
+}
+
+- (instancetype)initWithPath:(NSString *)path
+{
+    if ((self = [super init])) {
+        _path = [path copy];
+        _queue = FBDispatchQueueCreateSerial("com.facebook.sdk.FBRequestOutbox", FBDispatchLaneBackground);
+        dispatch_async(_queue, ^{
+            [self load];
+        });
+
+        struct sockaddr_in zeroAddress;
+        memset(&zeroAddress, 0, sizeof(zeroAddress));
+        zeroAddress.sin_len = sizeof(zeroAddress);
+        zeroAddress.sin_family = AF_INET;
+        _reachability = fbdfl_SCNetworkReachabilityCreateWithAddress(kCFAllocatorDefault, (const struct sockaddr *)&zeroAddress);
+        if (_reachability) {
+            SCNetworkReachabilityContext context = {0, self, NULL, NULL, NULL};
+            if (fbdfl_SCNetworkReachabilitySetCallback(_reachability, FBRequestOutboxReachabilityChanged, &context)) {
+                fbdfl_SCNetworkReachabilitySetDispatchQueue(_reachability, _queue);
+            }
+        }
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(sendPendingRequests)
+                                                     name:UIApplicationDidBecomeActiveNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    if (_reachability) {
+        fbdfl_SCNetworkReachabilitySetDispatchQueue(_reachability, NULL);
+        fbdfl_SCNetworkReachabilitySetCallback(_reachability, NULL, NULL);
+        CFRelease(_reachability);
+    }
+    dispatch_release(_queue);
+    [_entries release];
+    [_path release];
+    [super dealloc];
+}
+
+#pragma mark - Journal
+
+// Runs on _queue
+- (void)load
+{
+    NSData *data = [NSData dataWithContentsOfFile:_path];
+    id entries = data ? [NSPropertyListSerialization propertyListWithData:data
+                                                                  options:NSPropertyListMutableContainers
+                                                                   format:NULL
+                                                                    error:NULL] : nil;
+    _entries = [entries isKindOfClass:[NSMutableArray class]] ? [entries retain] : [[NSMutableArray alloc] init];
+}
+
+// Runs on _queue
+- (void)save
+{
+    if (_entries.count == 0) {
+        [[NSFileManager defaultManager] removeItemAtPath:_path error:NULL];
+        return;
+    }
+
+    NSError *error = nil;
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:_entries
+                                                              format:NSPropertyListBinaryFormat_v1_0
+                                                             options:0
+                                                               error:&error];
+    // The journal holds access tokens, so keep it locked along with the keychain
+    if (!data || ![data writeToFile:_path
+                            options:NSDataWritingAtomic | NSDataWritingFileProtectionCompleteUntilFirstUserAuthentication
+                              error:&error]) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorFBRequests
+                        formatString:@"FBRequestOutbox: Unable to save pending requests: %@", error];
+    }
+}
+
+// Runs on _queue
+- (void)dropExpiredEntries
+{
+    NSTimeInterval oldest = [NSDate timeIntervalSinceReferenceDate] - kEntryTimeToLive;
+    NSIndexSet *expired = [_entries indexesOfObjectsPassingTest:^BOOL(NSDictionary *entry, NSUInteger idx, BOOL *stop) {
+        return [entry[kEntryQueuedTimeKey] doubleValue] < oldest;
+    }];
+    [_entries removeObjectsAtIndexes:expired];
+    if (_entries.count > kMaximumEntryCount) {
+        [_entries removeObjectsInRange:NSMakeRange(0, _entries.count - kMaximumEntryCount)];
+    }
+}
+
+// A property list entry that replays request, or nil if any of it can't be written down
+- (NSDictionary *)entryForRequest:(FBRequest *)request
+{
+    if (!request.graphPath || request.restMethod ||
+        [[request.HTTPMethod uppercaseString] isEqualToString:@"GET"]) {
+        return nil;
+    }
+
+    NSMutableDictionary *parameters = [NSMutableDictionary dictionaryWithCapacity:request.parameters.count];
+    for (NSString *key in request.parameters) {
+        id value = request.parameters[key];
+        if (![value isKindOfClass:[NSString class]] && ![value isKindOfClass:[NSNumber class]]) {
+            // attachments would make the journal huge
+            return nil;
+        }
+        parameters[key] = value;
+    }
+
+    // a session's token may have been refreshed since the request went out, so go by
+    // what the request itself carried
+    NSString *accessToken = parameters[kEntryAccessTokenKey] ?: request.session.accessTokenData.accessToken;
+    [parameters removeObjectForKey:kEntryAccessTokenKey];
+
+    NSMutableDictionary *entry = [NSMutableDictionary dictionary];
+    entry[kEntryGraphPathKey] = request.graphPath;
+    entry[kEntryHTTPMethodKey] = request.HTTPMethod;
+    entry[kEntryParametersKey] = parameters;
+    entry[kEntryQueuedTimeKey] = @([NSDate timeIntervalSinceReferenceDate]);
+    if (accessToken) {
+        entry[kEntryAccessTokenKey] = accessToken;
+    }
+    if (request.graphObject) {
+        if (![NSJSONSerialization isValidJSONObject:request.graphObject]) {
+            return nil;
+        }
+        entry[kEntryGraphObjectKey] = [FBUtility simpleJSONEncode:request.graphObject];
+    }
+    return entry;
+}
+
+- (NSError *)queueRequest:(FBRequest *)request afterError:(NSError *)error
+{
+    if (!FBRequestOutboxIsOfflineError(error)) {
+        return error;
+    }
+    NSDictionary *entry = [self entryForRequest:request];
+    if (!entry) {
+        return error;
+    }
+
+    dispatch_async(_queue, ^{
+        [_entries addObject:entry];
+        [self dropExpiredEntries];
+        [self save];
+    });
+
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithDictionary:error.userInfo];
+    userInfo[FBErrorRequestQueuedOfflineKey] = @YES;
+    return [NSError errorWithDomain:error.domain code:error.code userInfo:userInfo];
+}
+
+- (NSUInteger)pendingRequestCount
+{
+    __block NSUInteger count = 0;
+    dispatch_sync(_queue, ^{
+        count = _entries.count;
+    });
+    return count;
+}
+
+#pragma mark - Sending
+
+- (BOOL)isNetworkUnreachable
+{
+    SCNetworkReachabilityFlags flags = 0;
+    if (!_reachability || !fbdfl_SCNetworkReachabilityGetFlags(_reachability, &flags)) {
+        // Can't tell, so let the connection find out
+        return NO;
+    }
+    return (flags & kSCNetworkReachabilityFlagsReachable) == 0;
+}
+
+- (void)sendPendingRequests
+{
+    dispatch_async(_queue, ^{
+        if (_outstandingRequestCount || _entries.count == 0 || [self isNetworkUnreachable]) {
+            return;
+        }
+
+        NSUInteger entryCount = _entries.count;
+        [self dropExpiredEntries];
+        if (_entries.count != entryCount) {
+            [self save];
+        }
+
+        // Requests for the same token share a connection, which sends them as
+        // batches of up to the Graph API's batch size
+        NSMutableDictionary *entriesByToken = [NSMutableDictionary dictionary];
+        for (NSDictionary *entry in _entries) {
+            NSString *accessToken = entry[kEntryAccessTokenKey] ?: @"";
+            NSMutableArray *group = entriesByToken[accessToken];
+            if (!group) {
+                group = [NSMutableArray array];
+                entriesByToken[accessToken] = group;
+            }
+            [group addObject:entry];
+        }
+        _outstandingRequestCount = _entries.count;
+
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorFBRequests
+                        formatString:@"FBRequestOutbox: Sending %lu pending requests in %lu connections",
+         (unsigned long)_entries.count, (unsigned long)entriesByToken.count];
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            for (NSArray *group in entriesByToken.allValues) {
+                [self startConnectionForEntries:group];
+            }
+        });
+    });
+}
+
+- (void)startConnectionForEntries:(NSArray *)entries
+{
+    FBRequestConnection *connection = [[FBRequestConnection alloc] init];
+    for (NSDictionary *entry in entries) {
+        FBRequest *request = [[FBRequest alloc] initWithSession:nil
+                                                      graphPath:entry[kEntryGraphPathKey]
+                                                     parameters:entry[kEntryParametersKey]
+                                                     HTTPMethod:entry[kEntryHTTPMethodKey]];
+        NSString *accessToken = entry[kEntryAccessTokenKey];
+        if (accessToken) {
+            request.parameters[kEntryAccessTokenKey] = accessToken;
+            request.skipClientToken = YES;
+        }
+        NSString *graphObjectJSON = entry[kEntryGraphObjectKey];
+        if (graphObjectJSON) {
+            request.graphObject = [FBGraphObject graphObjectWrappingDictionary:[FBUtility simpleJSONDecode:graphObjectJSON]];
+        }
+        // The session the request was made with may be gone; a stale token must not close whatever is open now
+        request.canCloseSessionOnError = NO;
+
+        [connection addRequest:request completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+            dispatch_async(_queue, ^{
+                [self finishEntry:entry error:error];
+            });
+        }];
+        [request release];
+    }
+    [connection start];
+    [connection release];
+}
+
+// Runs on _queue
+- (void)finishEntry:(NSDictionary *)entry error:(NSError *)error
+{
+    if (!error || !FBRequestOutboxIsOfflineError(error)) {
+        if (error) {
+            [FBLogger singleShotLogEntry:FBLoggingBehaviorFBRequests
+                            formatString:@"FBRequestOutbox: Dropping %@ to %@ after error: %@",
+             entry[kEntryHTTPMethodKey], entry[kEntryGraphPathKey], error];
+        }
+        [_entries removeObjectIdenticalTo:entry];
+    }
+    if (_outstandingRequestCount > 0 && --_outstandingRequestCount == 0) {
+        [self save];
+    }
+}
+
+@end
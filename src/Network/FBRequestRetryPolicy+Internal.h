@@ -0,0 +1,32 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBRequestRetryPolicy.h"
+
+@interface FBRequestRetryPolicy (Internal)
+
+// Returns NO, counting a rejection, if a request to host should fail fast.
+// Lets one trial request through once an open circuit has waited long enough.
+- (BOOL)shouldAllowRequestToHost:(NSString *)host;
+
+// An attempt got an answer from host, even an error that isn't transient
+- (void)recordSuccessForHost:(NSString *)host;
+
+// An attempt failed transiently; may open the host's circuit
+- (void)recordFailureForHost:(NSString *)host;
+
+@end
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBRequestRetryPolicy.h"
+#import "FBRequestRetryPolicy+Internal.h"
+
+#import "FBLogger.h"
+#import "FBMetrics.h"
+
+// The breaker's view of one host
+@interface FBRequestRetryPolicyCircuit : NSObject {
+@public
+    NSUInteger _consecutiveFailures;
+    // System uptime when the circuit opened, or 0 while it is closed
+    NSTimeInterval _openedAt;
+    // System uptime when the latest trial request was let through, or 0.  A
+    // trial that never reports back, because it was cancelled, stops counting
+    // after a reset interval.
+    NSTimeInterval _trialStartedAt;
+}
+@end
+
+@implementation FBRequestRetryPolicyCircuit
+@end
+
+@interface FBRequestRetryPolicy () {
+    // FBRequestRetryPolicyCircuit per host that has failed since it last succeeded.
+    // Guarded by @synchronized (self).
+    NSMutableDictionary *_circuits;
+}
+
+@end
+
+@implementation FBRequestRetryPolicy
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _maximumRetryCount = 2;
+        _initialBackoff = 0.5;
+        _maximumBackoff = 8;
+        _circuitBreakerFailureThreshold = 5;
+        _circuitBreakerResetInterval = 30;
+        _circuits = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_circuits release];
+    [super dealloc];
+}
+
+#pragma mark - Retries
+
+- (BOOL)shouldRetryAfterError:(NSError *)error response:(NSHTTPURLResponse *)response {
+    if (response) {
+        NSInteger statusCode = response.statusCode;
+        return statusCode >= 500 && statusCode <= 599 && statusCode != 501;
+    }
+    if (![error.domain isEqualToString:NSURLErrorDomain]) {
+        return NO;
+    }
+    // Being offline isn't the host's fault, and retrying won't help
+    switch (error.code) {
+        case NSURLErrorTimedOut:
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorNetworkConnectionLost:
+        case NSURLErrorDNSLookupFailed:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+- (NSTimeInterval)backoffBeforeRetry:(NSUInteger)retryNumber {
+    int exponent = (int)MIN(MAX(retryNumber, 1), 31) - 1;
+    NSTimeInterval ceiling = MIN(self.maximumBackoff, ldexp(self.initialBackoff, exponent));
+    // Full jitter
+    return ceiling * arc4random_uniform(1001) / 1000;
+}
+
+#pragma mark - Circuit breaker
+
+- (NSSet *)hostsWithOpenCircuits {
+    @synchronized (self) {
+        NSMutableSet *hosts = [NSMutableSet set];
+        for (NSString *host in _circuits) {
+            FBRequestRetryPolicyCircuit *circuit = [_circuits objectForKey:host];
+            if (circuit->_openedAt != 0) {
+                [hosts addObject:host];
+            }
+        }
+        return hosts;
+    }
+}
+
+- (BOOL)isCircuitOpenForHost:(NSString *)host {
+    if (!host) {
+        return NO;
+    }
+    @synchronized (self) {
+        FBRequestRetryPolicyCircuit *circuit = [_circuits objectForKey:host];
+        return circuit && circuit->_openedAt != 0;
+    }
+}
+
+- (BOOL)shouldAllowRequestToHost:(NSString *)host {
+    if (!host) {
+        return YES;
+    }
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+    @synchronized (self) {
+        FBRequestRetryPolicyCircuit *circuit = [_circuits objectForKey:host];
+        if (!circuit || circuit->_openedAt == 0) {
+            return YES;
+        }
+        NSTimeInterval resetInterval = self.circuitBreakerResetInterval;
+        if (now - circuit->_openedAt >= resetInterval &&
+            (circuit->_trialStartedAt == 0 || now - circuit->_trialStartedAt >= resetInterval)) {
+            circuit->_trialStartedAt = now;
+            return YES;
+        }
+    }
+    [[FBMetrics sharedMetrics] incrementCounter:FBMetricCircuitBreakerRejections by:1];
+    return NO;
+}
+
+- (void)recordSuccessForHost:(NSString *)host {
+    if (!host) {
+        return;
+    }
+    BOOL closed = NO;
+    @synchronized (self) {
+        FBRequestRetryPolicyCircuit *circuit = [_circuits objectForKey:host];
+        closed = circuit && circuit->_openedAt != 0;
+        [_circuits removeObjectForKey:host];
+    }
+    if (closed) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorFBRequests
+                        formatString:@"Closed the circuit breaker for %@", host];
+    }
+}
+
+- (void)recordFailureForHost:(NSString *)host {
+    NSUInteger threshold = self.circuitBreakerFailureThreshold;
+    if (!host || threshold == 0) {
+        return;
+    }
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+    BOOL tripped = NO;
+    @synchronized (self) {
+        FBRequestRetryPolicyCircuit *circuit = [_circuits objectForKey:host];
+        if (!circuit) {
+            circuit = [[[FBRequestRetryPolicyCircuit alloc] init] autorelease];
+            [_circuits setObject:circuit forKey:host];
+        }
+        circuit->_consecutiveFailures++;
+        if (circuit->_openedAt != 0) {
+            // Requests already in flight when the circuit opened change nothing,
+            // but a failed trial waits out a full interval again
+            if (circuit->_trialStartedAt != 0) {
+                tripped = YES;
+                circuit->_openedAt = now;
+                circuit->_trialStartedAt = 0;
+            }
+        } else if (circuit->_consecutiveFailures >= threshold) {
+            tripped = YES;
+            circuit->_openedAt = now;
+        }
+    }
+    if (tripped) {
+        [[FBMetrics sharedMetrics] incrementCounter:FBMetricCircuitBreakerTrips by:1];
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorFBRequests
+                        formatString:@"Opened the circuit breaker for %@ after repeated failures", host];
+    }
+}
+
+@end
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+#import "FBRequestConnection.h"
+
+// Admits the SDK's network requests by priority, so a burst of image loads or an
+// App Events flush doesn't hold up a request the user is waiting on.  Each
+// priority has its own limit on requests in flight, and all of them share an
+// overall one; when a slot frees up the highest priority waiting request goes
+// next.  Only used when FBSettings has request scheduling enabled.  Slots are
+// released from whichever thread a connection completes on.
+@interface FBRequestScheduler : NSObject
+{
+@private
+    NSMutableArray *_pending[FBRequestPriorityCount];
+    NSUInteger _running[FBRequestPriorityCount];
+    NSUInteger _limits[FBRequestPriorityCount];
+    NSUInteger _totalRunning;
+    NSUInteger _totalLimit;
+}
+
++ (FBRequestScheduler *)sharedScheduler;
+
+// Runs start once the request may go to the network: right away, on the calling
+// thread, if there is a slot for it, otherwise later on the main thread.  Returns
+// a handle for the other methods, or nil if scheduling is disabled and start has
+// already run.  The slot is held until finishRequest: is called.
+- (id)scheduleRequestWithPriority:(FBRequestPriority)priority start:(dispatch_block_t)start;
+
+// Moves the request to another priority, whether it is still waiting or running.
+- (void)setPriority:(FBRequestPriority)priority forRequest:(id)request;
+
+// Gives up the request's slot, or its place in line if it hasn't started yet.
+- (void)finishRequest:(id)request;
+
+// How many requests of the priority may be in flight at once.
+- (void)setLimit:(NSUInteger)limit forPriority:(FBRequestPriority)priority;
+
+@end
@@ -0,0 +1,220 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBRequestScheduler.h"
+
+#import "FBSettings.h"
+
+// The defaults leave room for user initiated requests even with every other
+// priority at its limit
+static const NSUInteger kDefaultLimits[FBRequestPriorityCount] = {
+    6, // FBRequestPriorityUserInitiated
+    4, // FBRequestPriorityVisibleImage
+    2, // FBRequestPriorityPrefetch
+    1, // FBRequestPriorityBackground
+};
+static const NSUInteger kDefaultTotalLimit = 8;
+
+@interface FBScheduledRequest : NSObject
+{
+@public
+    dispatch_block_t _start;
+    FBRequestPriority _priority;
+    BOOL _running;
+    BOOL _finished;
+}
+@end
+
+@implementation FBScheduledRequest
+
+- (void)dealloc
+{
+    [_start release];
+    [super dealloc];
+}
+
+@end
+
+@implementation FBRequestScheduler
+
+#pragma mark - Lifecycle
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        for (NSUInteger i = 0; i < FBRequestPriorityCount; i++) {
+            _pending[i] = [[NSMutableArray alloc] init];
+            _limits[i] = kDefaultLimits[i];
+        }
+        _totalLimit = kDefaultTotalLimit;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < FBRequestPriorityCount; i++) {
+        [_pending[i] release];
+    }
+    [super dealloc];
+}
+
++ (FBRequestScheduler *)sharedScheduler
+{
+    static FBRequestScheduler *_instance;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBRequestScheduler alloc] init];
+    });
+
+    return _instance;
+}
+
+#pragma mark - Public
+
+- (id)scheduleRequestWithPriority:(FBRequestPriority)priority start:(dispatch_block_t)start
+{
+    if (![FBSettings isRequestSchedulingEnabled]) {
+        start();
+        return nil;
+    }
+
+    FBScheduledRequest *request = [[[FBScheduledRequest alloc] init] autorelease];
+    request->_start = [start copy];
+    request->_priority = MIN(priority, FBRequestPriorityCount - 1);
+
+    BOOL admitted = NO;
+    NSArray *admittedRequests = nil;
+    @synchronized (self) {
+        [_pending[request->_priority] addObject:request];
+        admittedRequests = [self admitPendingRequests];
+        admitted = [admittedRequests containsObject:request];
+    }
+
+    if (admitted) {
+        dispatch_block_t requestStart = request->_start;
+        request->_start = nil;
+        requestStart();
+        [requestStart release];
+    }
+    [self startRequests:admittedRequests except:request];
+    return request;
+}
+
+- (void)setPriority:(FBRequestPriority)priority forRequest:(id)request
+{
+    FBScheduledRequest *scheduled = request;
+    if (!scheduled) {
+        return;
+    }
+    priority = MIN(priority, FBRequestPriorityCount - 1);
+
+    NSArray *admittedRequests = nil;
+    @synchronized (self) {
+        if (scheduled->_finished || scheduled->_priority == priority) {
+            return;
+        }
+        if (scheduled->_running) {
+            _running[scheduled->_priority]--;
+            _running[priority]++;
+        } else {
+            [[scheduled retain] autorelease];
+            [_pending[scheduled->_priority] removeObjectIdenticalTo:scheduled];
+            [_pending[priority] addObject:scheduled];
+        }
+        scheduled->_priority = priority;
+        admittedRequests = [self admitPendingRequests];
+    }
+    [self startRequests:admittedRequests except:nil];
+}
+
+- (void)finishRequest:(id)request
+{
+    FBScheduledRequest *scheduled = request;
+    if (!scheduled) {
+        return;
+    }
+
+    NSArray *admittedRequests = nil;
+    @synchronized (self) {
+        if (scheduled->_finished) {
+            return;
+        }
+        scheduled->_finished = YES;
+        if (scheduled->_running) {
+            _running[scheduled->_priority]--;
+            _totalRunning--;
+        } else {
+            [_pending[scheduled->_priority] removeObjectIdenticalTo:scheduled];
+        }
+        admittedRequests = [self admitPendingRequests];
+    }
+    [self startRequests:admittedRequests except:nil];
+}
+
+- (void)setLimit:(NSUInteger)limit forPriority:(FBRequestPriority)priority
+{
+    NSArray *admittedRequests = nil;
+    @synchronized (self) {
+        _limits[MIN(priority, FBRequestPriorityCount - 1)] = limit;
+        admittedRequests = [self admitPendingRequests];
+    }
+    [self startRequests:admittedRequests except:nil];
+}
+
+#pragma mark - Private
+
+// Called with the lock held.  Takes waiting requests in priority order while
+// there is room, so a lower priority only goes ahead of a higher one that is at
+// its own limit.
+- (NSArray *)admitPendingRequests
+{
+    NSMutableArray *admitted = nil;
+    for (NSUInteger priority = 0; priority < FBRequestPriorityCount && _totalRunning < _totalLimit; priority++) {
+        NSMutableArray *pending = _pending[priority];
+        while (pending.count > 0 && _running[priority] < _limits[priority] && _totalRunning < _totalLimit) {
+            FBScheduledRequest *request = [pending objectAtIndex:0];
+            if (!admitted) {
+                admitted = [NSMutableArray array];
+            }
+            [admitted addObject:request];
+            [pending removeObjectAtIndex:0];
+            request->_running = YES;
+            _running[priority]++;
+            _totalRunning++;
+        }
+    }
+    return admitted;
+}
+
+// Requests that waited for their slot start on the main thread, which is where
+// the connections they start deliver their callbacks
+- (void)startRequests:(NSArray *)requests except:(FBScheduledRequest *)startedRequest
+{
+    for (FBScheduledRequest *request in requests) {
+        if (request == startedRequest) {
+            continue;
+        }
+        dispatch_block_t start = request->_start;
+        request->_start = nil;
+        dispatch_async(dispatch_get_main_queue(), start);
+        [start release];
+    }
+}
+
+@end
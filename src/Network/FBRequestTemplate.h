@@ -0,0 +1,49 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+@class FBRequest;
+@class FBSession;
+
+// The constant part of a Graph API request that is built over and over with only an ID or a
+// parameter or two changing: a path with at most one "%@" for the ID, the HTTP method, and
+// parameters whose URL encoding is worked out once, here.  Requests made from a template are
+// ordinary FBRequests holding all of their parameters, so caching, logging and retries see
+// nothing different; only URL serialization skips re-encoding the constant parameters, and
+// only while the request still has them unchanged.  Immutable, so safe to share between threads.
+@interface FBRequestTemplate : NSObject
+
+- (instancetype)initWithGraphPath:(NSString *)graphPath
+                       parameters:(NSDictionary *)parameters
+                       HTTPMethod:(NSString *)HTTPMethod;
+
+// An autoreleased request for the template, with pathArgument in place of the path's "%@" and
+// parameters added to the template's own.
+- (FBRequest *)requestWithSession:(FBSession *)session
+                     pathArgument:(NSString *)pathArgument
+                       parameters:(NSDictionary *)parameters;
+
+@property (nonatomic, readonly, copy) NSDictionary *parameters;
+
+// The parameters, URL encoded as "key=value" pairs joined by "&"
+@property (nonatomic, readonly, copy) NSString *encodedParameters;
+
+// Whether the request still has every one of the template's parameters, with the same values
+- (BOOL)matchesParametersOfRequest:(FBRequest *)request;
+
+@end
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBRequestTemplate.h"
+
+#import <UIKit/UIKit.h>
+
+#import "FBRequest+Internal.h"
+#import "FBRequest.h"
+#import "FBUtility.h"
+
+static NSString *const kFBRequestTemplatePathPlaceholder = @"%@";
+
+@interface FBRequestTemplate ()
+
+@property (nonatomic, readwrite, copy) NSDictionary *parameters;
+@property (nonatomic, readwrite, copy) NSString *encodedParameters;
+@property (nonatomic, copy) NSString *graphPathPrefix;
+@property (nonatomic, copy) NSString *graphPathSuffix;
+@property (nonatomic, copy) NSString *HTTPMethod;
+
+@end
+
+@implementation FBRequestTemplate
+
+- (instancetype)initWithGraphPath:(NSString *)graphPath
+                       parameters:(NSDictionary *)parameters
+                       HTTPMethod:(NSString *)HTTPMethod
+{
+    if ((self = [super init])) {
+        NSRange placeholder = [graphPath rangeOfString:kFBRequestTemplatePathPlaceholder];
+        if (placeholder.location == NSNotFound) {
+            self.graphPathPrefix = graphPath;
+        } else {
+            self.graphPathPrefix = [graphPath substringToIndex:placeholder.location];
+            self.graphPathSuffix = [graphPath substringFromIndex:NSMaxRange(placeholder)];
+        }
+        self.HTTPMethod = HTTPMethod;
+        self.parameters = parameters ?: @{};
+
+        NSMutableString *encoded = [NSMutableString string];
+        for (NSString *key in self.parameters) {
+            id value = self.parameters[key];
+            NSAssert(![value isKindOfClass:[NSData class]] &&
+                     ![value isKindOfClass:[UIImage class]] &&
+                     ![value isKindOfClass:[NSURL class]],
+                     @"Attachments can not be template parameters");
+            [encoded appendFormat:@"%@%@=%@",
+             (encoded.length ? @"&" : @""),
+             key,
+             [FBUtility stringByURLEncodingString:([value isKindOfClass:[NSString class]] ? value : [value description])]];
+        }
+        self.encodedParameters = encoded;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_parameters release];
+    [_encodedParameters release];
+    [_graphPathPrefix release];
+    [_graphPathSuffix release];
+    [_HTTPMethod release];
+    [super dealloc];
+}
+
+- (FBRequest *)requestWithSession:(FBSession *)session
+                     pathArgument:(NSString *)pathArgument
+                       parameters:(NSDictionary *)parameters
+{
+    NSString *graphPath = self.graphPathPrefix;
+    if (self.graphPathSuffix) {
+        graphPath = [NSString stringWithFormat:@"%@%@%@", self.graphPathPrefix, pathArgument ?: @"", self.graphPathSuffix];
+    }
+
+    FBRequest *request = [[[FBRequest alloc] initWithSession:session
+                                                   graphPath:graphPath
+                                                  parameters:self.parameters
+                                                  HTTPMethod:self.HTTPMethod] autorelease];
+    if (parameters) {
+        [request.parameters addEntriesFromDictionary:parameters];
+    }
+    request.preparedTemplate = self;
+    return request;
+}
+
+- (BOOL)matchesParametersOfRequest:(FBRequest *)request
+{
+    NSDictionary *requestParameters = request.parameters;
+    for (NSString *key in self.parameters) {
+        if (![self.parameters[key] isEqual:requestParameters[key]]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+@end
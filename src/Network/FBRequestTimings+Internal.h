@@ -0,0 +1,38 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBRequestTimings.h"
+
+@interface FBRequestTimings (Internal)
+
+// Seconds on the monotonic clock the timings are measured with
++ (NSTimeInterval)currentTime;
+
+- (void)markStart;
+// The first response wins, since sharded connections get several
+- (void)markResponseStart;
+// The last response wins
+- (void)markResponseEnd;
+// Folds in the network phases recorded by an FBURLConnection's timings
+- (void)mergeNetworkTimings:(FBRequestTimings *)timings;
+// The response reached FBRequestConnection and handler work begins
+- (void)markResponseReceived;
+- (void)addParseDuration:(NSTimeInterval)duration;
+// Only the first handler counts
+- (void)markHandlerInvoked;
+
+@end
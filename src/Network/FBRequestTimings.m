@@ -0,0 +1,148 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBRequestTimings.h"
+#import "FBRequestTimings+Internal.h"
+
+#import "FBUtility.h"
+
+static NSTimeInterval FBRequestTimingsInterval(NSTimeInterval from, NSTimeInterval to) {
+    return (from > 0 && to > from) ? to - from : 0;
+}
+
+@interface FBRequestTimings () {
+    NSTimeInterval _startTime;
+    NSTimeInterval _responseStartTime;
+    NSTimeInterval _responseEndTime;
+    NSTimeInterval _responseReceivedTime;
+    NSTimeInterval _handlerInvokedTime;
+    NSTimeInterval _parseDuration;
+}
+
+@end
+
+@implementation FBRequestTimings
+
++ (NSTimeInterval)currentTime {
+    return [FBUtility monotonicTime];
+}
+
+#pragma mark - Public Properties
+
+- (NSTimeInterval)timeToFirstByte {
+    @synchronized (self) {
+        return FBRequestTimingsInterval(_startTime, _responseStartTime);
+    }
+}
+
+- (NSTimeInterval)downloadDuration {
+    @synchronized (self) {
+        return FBRequestTimingsInterval(_responseStartTime, _responseEndTime);
+    }
+}
+
+- (NSTimeInterval)parseDuration {
+    @synchronized (self) {
+        return _parseDuration;
+    }
+}
+
+- (NSTimeInterval)handlerDispatchLatency {
+    @synchronized (self) {
+        return FBRequestTimingsInterval(_responseReceivedTime, _handlerInvokedTime);
+    }
+}
+
+- (NSTimeInterval)totalDuration {
+    @synchronized (self) {
+        return FBRequestTimingsInterval(_startTime, _handlerInvokedTime);
+    }
+}
+
+#pragma mark - Internal Methods
+
+- (void)markStart {
+    @synchronized (self) {
+        _startTime = [FBRequestTimings currentTime];
+    }
+}
+
+- (void)markResponseStart {
+    @synchronized (self) {
+        if (!_responseStartTime) {
+            _responseStartTime = [FBRequestTimings currentTime];
+        }
+    }
+}
+
+- (void)markResponseEnd {
+    @synchronized (self) {
+        _responseEndTime = [FBRequestTimings currentTime];
+    }
+}
+
+- (void)mergeNetworkTimings:(FBRequestTimings *)timings {
+    if (!timings || timings == self) {
+        return;
+    }
+    NSTimeInterval responseStartTime, responseEndTime;
+    @synchronized (timings) {
+        responseStartTime = timings->_responseStartTime;
+        responseEndTime = timings->_responseEndTime;
+    }
+    @synchronized (self) {
+        if (responseStartTime && (!_responseStartTime || responseStartTime < _responseStartTime)) {
+            _responseStartTime = responseStartTime;
+        }
+        if (responseEndTime > _responseEndTime) {
+            _responseEndTime = responseEndTime;
+        }
+    }
+}
+
+- (void)markResponseReceived {
+    @synchronized (self) {
+        _responseReceivedTime = [FBRequestTimings currentTime];
+    }
+}
+
+- (void)addParseDuration:(NSTimeInterval)duration {
+    @synchronized (self) {
+        _parseDuration += duration;
+    }
+}
+
+- (void)markHandlerInvoked {
+    @synchronized (self) {
+        if (!_handlerInvokedTime) {
+            _handlerInvokedTime = [FBRequestTimings currentTime];
+        }
+    }
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p, timeToFirstByte: %.3f, downloadDuration: %.3f, parseDuration: %.3f, handlerDispatchLatency: %.3f, totalDuration: %.3f>",
+            NSStringFromClass([self class]),
+            self,
+            self.timeToFirstByte,
+            self.downloadDuration,
+            self.parseDuration,
+            self.handlerDispatchLatency,
+            self.totalDuration];
+}
+
+@end
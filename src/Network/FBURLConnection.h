@@ -16,6 +16,11 @@
 
 #include <Foundation/Foundation.h>
 
+#import "FBRequestConnection.h"
+
+@class FBCancellationToken;
+@class FBRequestRetryPolicy;
+@class FBRequestTimings;
 @class FBURLConnection;
 typedef void (^FBURLConnectionHandler)(FBURLConnection *connection,
                                        NSError *error,
@@ -24,6 +29,23 @@ typedef void (^FBURLConnectionHandler)(FBURLConnection *connection,
 
 @interface FBURLConnection : NSObject
 
+// The network phases of the request, recorded from the connection delegate callbacks.
+// Nil for responses served from the cache.
+@property (nonatomic, retain, readonly) FBRequestTimings *timings;
+
+// The FBNetworkFeature* the connection's bytes are accounted to in FBMetrics; nil for
+// FBNetworkFeatureOther. Can be set any time before the connection completes.
+@property (nonatomic, copy) NSString *networkFeature;
+
+// Where the connection goes in FBRequestScheduler's line when request scheduling is
+// enabled; defaults to FBRequestPriorityUserInitiated. Changing it while the
+// connection waits for its turn, or runs, promotes or demotes it.
+@property (nonatomic) FBRequestPriority priority;
+
+// Cancels the connection when cancelled. Can be set any time before the connection
+// completes; setting an already cancelled token cancels the connection right away.
+@property (nonatomic, retain) FBCancellationToken *cancellationToken;
+
 - (FBURLConnection *)initWithURL:(NSURL *)url
                completionHandler:(FBURLConnectionHandler)handler;
 
@@ -31,6 +53,29 @@ typedef void (^FBURLConnectionHandler)(FBURLConnection *connection,
                skipRoundTripIfCached:(BOOL)skipRoundtripIfCached
                    completionHandler:(FBURLConnectionHandler)handler;
 
+// Transient failures are retried, and requests to a host whose circuit is open
+// fail with FBErrorServiceUnavailable, as retryPolicy directs.  The handler is
+// only called once, with the last attempt's outcome.  Only pass a policy for
+// requests that are safe to send more than once.
+- (FBURLConnection *)initWithRequest:(NSURLRequest *)request
+               skipRoundTripIfCached:(BOOL)skipRoundtripIfCached
+                         retryPolicy:(FBRequestRetryPolicy *)retryPolicy
+                   completionHandler:(FBURLConnectionHandler)handler;
+
+// Same as above, for a connection that waits its turn at priority rather than as
+// a user initiated request.  The priority has to be given here for connections
+// that skip the cache, since they ask to go to the network before returning.
+- (FBURLConnection *)initWithRequest:(NSURLRequest *)request
+               skipRoundTripIfCached:(BOOL)skipRoundtripIfCached
+                         retryPolicy:(FBRequestRetryPolicy *)retryPolicy
+                            priority:(FBRequestPriority)priority
+                   completionHandler:(FBURLConnectionHandler)handler;
+
 - (void)cancel;
 
+// Opens connections to the Graph API host and to the CDN host content was last
+// served from, when FBSettings has connection prewarming enabled and requests
+// run on the shared session transport.  May be called from any thread.
++ (void)prewarmConnections;
+
 @end
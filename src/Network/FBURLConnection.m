@@ -16,27 +16,64 @@
 
 #import "FBURLConnection.h"
 
+#import "FBCancellationToken.h"
 #import "FBDataDiskCache.h"
 #import "FBError.h"
 #import "FBLogger.h"
+#import "FBMetrics.h"
+#import "FBRequestRetryPolicy+Internal.h"
+#import "FBRequestScheduler.h"
+#import "FBRequestTimings+Internal.h"
 #import "FBSession.h"
-#import "FBSettings+Internal.h"
 #import "FBSettings.h"
+#import "FBStartupProfiler.h"
+#import "FBTrace.h"
+#import "FBURLRedirectCache.h"
+#import "FBURLReplayTransport.h"
+#import "FBURLSessionTransport.h"
 #import "FBUtility.h"
 
 static NSArray *_cdnHosts;
 
+// The CDN host content last came from, remembered across launches so the next
+// launch can prewarm a connection to it.  Guarded by @synchronized(_cdnHosts).
+static NSString *g_lastCDNHost;
+static NSString *const kLastCDNHostKey = @"com.facebook.sdk:FBURLConnectionLastCDNHost";
+
+// CDN responses larger than this are streamed to the disk cache rather than
+// buffered in memory
+static const long long kStreamToDiskCacheThreshold = 256 * 1024;
+
 @interface FBURLConnection ()
 
 @property (nonatomic, retain) NSURLConnection *connection;
+// Set instead of connection when running on the shared session transport
+@property (nonatomic, retain) NSURLSessionDataTask *task;
+// Set instead of connection while an FBURLReplayTransport is active
+@property (nonatomic, retain) id replayCall;
 @property (nonatomic, retain) NSMutableData *data;
+@property (nonatomic, retain) FBDataDiskCacheWriter *cacheWriter;
 @property (nonatomic, copy) FBURLConnectionHandler handler;
 @property (nonatomic, retain) NSURLResponse *response;
 @property (nonatomic) unsigned long requestStartTime;
 @property (nonatomic, readonly) NSUInteger loggerSerialNumber;
 @property (nonatomic) BOOL skipRoundtripIfCached;
+@property (nonatomic) BOOL cancelled;
+@property (nonatomic, retain, readwrite) FBRequestTimings *timings;
+@property (nonatomic) unsigned long long bytesSent;
+@property (nonatomic) unsigned long long bytesReceived;
+@property (nonatomic, retain) id cancellationRegistration;
+@property (nonatomic, copy) NSURLRequest *request;
+@property (nonatomic, retain) FBRequestRetryPolicy *retryPolicy;
+@property (nonatomic) NSUInteger retryCount;
+// The connection's turn with FBRequestScheduler, held from when it asks to go to
+// the network until the attempt completes
+@property (nonatomic, retain) id scheduledRequest;
+@property (nonatomic) BOOL attemptFinished;
 
 - (BOOL)isCDNURL:(NSURL *)url;
+- (void)startOrServeRedirectTargetOfRequest:(NSURLRequest *)request;
+- (void)startWithRequest:(NSURLRequest *)request;
 
 - (void)invokeHandler:(FBURLConnectionHandler)handler
                 error:(NSError *)error
@@ -50,6 +87,7 @@ static NSArray *_cdnHosts;
 #pragma mark - Lifecycle
 
 + (void)initialize {
+    FBStartupProfilerMeasure("FBURLConnection +initialize");
     if (_cdnHosts == nil) {
         _cdnHosts = [[NSArray arrayWithObjects:
                       @"akamaihd.net",
@@ -58,6 +96,40 @@ static NSArray *_cdnHosts;
     }
 }
 
++ (void)noteCDNHost:(NSString *)host {
+    if (!host) {
+        return;
+    }
+    @synchronized(_cdnHosts) {
+        if (g_lastCDNHost && [g_lastCDNHost isEqualToString:host]) {
+            return;
+        }
+        [g_lastCDNHost release];
+        g_lastCDNHost = [host copy];
+    }
+    [[NSUserDefaults standardUserDefaults] setObject:host forKey:kLastCDNHostKey];
+}
+
++ (void)prewarmConnections {
+    if (![FBSettings isConnectionPrewarmingEnabled] || ![FBURLSessionTransport isEnabled]) {
+        return;
+    }
+
+    NSString *cdnHost;
+    @synchronized(_cdnHosts) {
+        if (!g_lastCDNHost) {
+            g_lastCDNHost = [[[NSUserDefaults standardUserDefaults] stringForKey:kLastCDNHostKey] copy];
+        }
+        cdnHost = [[g_lastCDNHost retain] autorelease];
+    }
+
+    NSMutableArray *hosts = [NSMutableArray arrayWithObject:[NSURL URLWithString:[FBUtility buildFacebookUrlWithPre:@"https://graph."]].host];
+    if (cdnHost) {
+        [hosts addObject:cdnHost];
+    }
+    [[FBURLSessionTransport sharedTransport] prewarmConnectionsToHosts:hosts];
+}
+
 - (FBURLConnection *)initWithURL:(NSURL *)url
                completionHandler:(FBURLConnectionHandler)handler {
     NSURLRequest *request = [[[NSURLRequest alloc] initWithURL:url] autorelease];
@@ -70,39 +142,203 @@ static NSArray *_cdnHosts;
 - (FBURLConnection *)initWithRequest:(NSURLRequest *)request
                skipRoundTripIfCached:(BOOL)skipRoundtripIfCached
                    completionHandler:(FBURLConnectionHandler)handler {
+    return [self initWithRequest:request
+           skipRoundTripIfCached:skipRoundtripIfCached
+                     retryPolicy:nil
+               completionHandler:handler];
+}
+
+- (FBURLConnection *)initWithRequest:(NSURLRequest *)request
+               skipRoundTripIfCached:(BOOL)skipRoundtripIfCached
+                         retryPolicy:(FBRequestRetryPolicy *)retryPolicy
+                   completionHandler:(FBURLConnectionHandler)handler {
+    return [self initWithRequest:request
+           skipRoundTripIfCached:skipRoundtripIfCached
+                     retryPolicy:retryPolicy
+                        priority:FBRequestPriorityUserInitiated
+               completionHandler:handler];
+}
+
+- (FBURLConnection *)initWithRequest:(NSURLRequest *)request
+               skipRoundTripIfCached:(BOOL)skipRoundtripIfCached
+                         retryPolicy:(FBRequestRetryPolicy *)retryPolicy
+                            priority:(FBRequestPriority)priority
+                   completionHandler:(FBURLConnectionHandler)handler {
     if ((self = [super init])) {
+        _priority = priority;
         self.skipRoundtripIfCached = skipRoundtripIfCached;
+        self.handler = handler;
+        self.retryPolicy = retryPolicy;
+
+        if (retryPolicy && ![retryPolicy shouldAllowRequestToHost:request.URL.host]) {
+            // Fail on a later turn of the run loop, as a real failure would
+            [self performSelector:@selector(failWithOpenCircuit) withObject:nil afterDelay:0];
+        } else if (skipRoundtripIfCached) {
+            // Check if this url is cached.  The lookup happens off the calling
+            // thread so that a cold cache never hits the disk on the UI thread;
+            // the block keeps us alive until it completes.
+            NSURL *url = request.URL;
+            [[self getCache] dataForURL:url completion:^(NSData *cachedData) {
+                if (self.cancelled) {
+                    return;
+                }
+
+                if (cachedData) {
+                    FBURLConnectionHandler cachedHandler = [self.handler retain];
+                    self.handler = nil;
+                    @try {
+                        [self logAndInvokeHandler:cachedHandler cachedData:cachedData forURL:url];
+                    } @finally {
+                        [cachedHandler release];
+                    }
+                } else {
+                    [self startOrServeRedirectTargetOfRequest:request];
+                }
+            }];
+        } else {
+            [self startWithRequest:request];
+        }
+    }
+    return self;
+}
 
-        // Check if this url is cached
-        NSURL *url = request.URL;
-        FBDataDiskCache *cache = [self getCache];
-        NSData *cachedData = skipRoundtripIfCached ? [cache dataForURL:url] : nil;
+// If request is known to redirect to something already in the cache, as profile
+// pictures do, the cached copy is served without asking for the redirect again.
+- (void)startOrServeRedirectTargetOfRequest:(NSURLRequest *)request {
+    NSURL *redirectURL = [[FBURLRedirectCache sharedCache] redirectURLForURL:request.URL];
+    if (!redirectURL) {
+        [self startWithRequest:request];
+        return;
+    }
+
+    [[self getCache] dataForURL:redirectURL completion:^(NSData *cachedData) {
+        if (self.cancelled) {
+            return;
+        }
 
         if (cachedData) {
-            // TODO: It seems wrong to call this within init.  There are cases
-            // with UI where this is not ideal.  We should talk about this.
-            [self logAndInvokeHandler:handler cachedData:cachedData forURL:url];
+            FBURLConnectionHandler cachedHandler = [self.handler retain];
+            self.handler = nil;
+            @try {
+                [self logAndInvokeHandler:cachedHandler cachedData:cachedData forURL:redirectURL];
+            } @finally {
+                [cachedHandler release];
+            }
         } else {
+            [self startWithRequest:request];
+        }
+    }];
+}
 
-            _requestStartTime = [FBUtility currentTimeInMilliseconds];
-            _loggerSerialNumber = [FBLogger newSerialNumber];
-            _connection = [[NSURLConnection alloc]
-                           initWithRequest:request
-                           delegate:self];
-            _data = [[NSMutableData alloc] init];
+- (void)startWithRequest:(NSURLRequest *)request {
+    self.request = request;
+    self.attemptFinished = NO;
+    // The scheduler holds on to the block, and so to us, until it is our turn
+    id scheduledRequest = [[FBRequestScheduler sharedScheduler] scheduleRequestWithPriority:self.priority start:^{
+        if (!self.cancelled) {
+            [self sendRequest:request];
+        }
+    }];
+    if (self.attemptFinished) {
+        // Completed, or was cancelled, before the scheduler even returned
+        [[FBRequestScheduler sharedScheduler] finishRequest:scheduledRequest];
+    } else {
+        self.scheduledRequest = scheduledRequest;
+    }
+}
 
-            [self logMessage:[NSString stringWithFormat:@"FBURLConnection <#%lu>:\n  URL: '%@'\n\n",
-                              (unsigned long)self.loggerSerialNumber,
-                              url.absoluteString]];
+- (void)finishScheduledRequest {
+    self.attemptFinished = YES;
+    [[FBRequestScheduler sharedScheduler] finishRequest:self.scheduledRequest];
+    self.scheduledRequest = nil;
+}
 
-            self.handler = handler;
-        }
+- (void)sendRequest:(NSURLRequest *)request {
+    _requestStartTime = [FBUtility currentTimeInMilliseconds];
+    self.timings = [[[FBRequestTimings alloc] init] autorelease];
+    [self.timings markStart];
+    FBTraceBegin(FBTracePointNetwork, self);
+    // Streamed bodies have no HTTPBody, but always carry a Content-Length
+    self.bytesSent += request.HTTPBody.length ?: [[request valueForHTTPHeaderField:@"Content-Length"] longLongValue];
+    _loggerSerialNumber = [FBLogger newSerialNumber];
+    FBURLReplayTransport *replayTransport = [FBURLReplayTransport activeTransport];
+    if (replayTransport) {
+        self.replayCall = [replayTransport startWithRequest:request delegate:self];
+    } else if ([FBURLSessionTransport isEnabled]) {
+        // Reuses a kept-alive connection to the host when there is one
+        self.task = [[FBURLSessionTransport sharedTransport] startTaskWithRequest:request
+                                                                         delegate:self];
+    } else {
+        _connection = [[NSURLConnection alloc]
+                       initWithRequest:request
+                       delegate:self];
+    }
 
-        // always attempt to autoPublish.  this function internally
-        // handles only executing once.
-        [FBSettings autoPublishInstall:nil];
+    [self logMessage:[NSString stringWithFormat:@"FBURLConnection <#%lu>:\n  URL: '%@'\n\n",
+                      (unsigned long)self.loggerSerialNumber,
+                      request.URL.absoluteString]];
+}
+
+- (void)failWithOpenCircuit {
+    NSError *error = [[[NSError alloc] initWithDomain:FacebookSDKDomain
+                                                 code:FBErrorServiceUnavailable
+                                             userInfo:nil] autorelease];
+    @try {
+        [self logAndInvokeHandler:self.handler error:error];
+    } @finally {
+        self.handler = nil;
     }
-    return self;
+}
+
+// Tells the retry policy how the attempt went and, if it failed transiently and
+// may be retried, schedules another attempt instead of completing.
+- (BOOL)retryAfterError:(NSError *)error response:(NSURLResponse *)response {
+    FBRequestRetryPolicy *policy = self.retryPolicy;
+    if (!policy || self.cancelled) {
+        return NO;
+    }
+
+    NSHTTPURLResponse *httpResponse = nil;
+    if ([response isKindOfClass:[NSHTTPURLResponse class]]) {
+        httpResponse = (NSHTTPURLResponse *)response;
+    }
+    NSString *host = self.request.URL.host;
+    if (![policy shouldRetryAfterError:error response:httpResponse]) {
+        [policy recordSuccessForHost:host];
+        return NO;
+    }
+    [policy recordFailureForHost:host];
+    if (self.retryCount >= policy.maximumRetryCount || [policy isCircuitOpenForHost:host]) {
+        return NO;
+    }
+
+    self.retryCount++;
+    NSTimeInterval backoff = [policy backoffBeforeRetry:self.retryCount];
+    [self logMessage:[NSString stringWithFormat:@"FBURLConnection <#%lu>:\n  Retry %lu in %.0f msec\n\n",
+                      (unsigned long)self.loggerSerialNumber,
+                      (unsigned long)self.retryCount,
+                      backoff * 1000]];
+    [[FBMetrics sharedMetrics] incrementCounter:FBMetricRequestRetries by:1];
+
+    // The retry begins its own trace point and timings. Until then there are none,
+    // so a cancel during the backoff doesn't end this trace point a second time.
+    FBTraceEnd(FBTracePointNetwork, self);
+    self.timings = nil;
+    // Give up the slot for the backoff; the retry waits its turn again
+    [self finishScheduledRequest];
+    [self.cacheWriter discard];
+    self.cacheWriter = nil;
+    self.data = nil;
+    self.response = nil;
+    [self performSelector:@selector(retry) withObject:nil afterDelay:backoff];
+    return YES;
+}
+
+- (void)retry {
+    self.connection = nil;
+    self.task = nil;
+    self.replayCall = nil;
+    [self startWithRequest:self.request];
 }
 
 - (void)logAndInvokeHandler:(FBURLConnectionHandler)handler
@@ -125,9 +361,10 @@ static NSArray *_cdnHosts;
                responseData:(NSData *)responseData {
     // Basic FBURLConnection logging just prints out the URL.  FBRequest logging provides more details.
     NSString *mimeType = [response MIMEType];
-    NSMutableString *mutableLogEntry = [NSMutableString stringWithFormat:@"FBURLConnection <#%lu>:\n  Duration: %lu msec\nResponse Size: %lu kB\n  MIME type: %@\n",
+    NSMutableString *mutableLogEntry = [NSMutableString stringWithFormat:@"FBURLConnection <#%lu>:\n  Duration: %lu msec\n  Time to first byte: %lu msec\nResponse Size: %lu kB\n  MIME type: %@\n",
                                         (unsigned long)self.loggerSerialNumber,
                                         [FBUtility currentTimeInMilliseconds] - self.requestStartTime,
+                                        (unsigned long)(self.timings.timeToFirstByte * 1000),
                                         (unsigned long)[responseData length] / 1024,
                                         mimeType];
 
@@ -156,25 +393,78 @@ static NSArray *_cdnHosts;
                 error:(NSError *)error
              response:(NSURLResponse *)response
          responseData:(NSData *)responseData {
+    // Nothing left to cancel
+    self.cancellationToken = nil;
+    [self finishScheduledRequest];
+    if (self.timings) {
+        // Only an attempt still on the network has a trace point open
+        FBTraceEnd(FBTracePointNetwork, self);
+    }
+    if (self.bytesSent || self.bytesReceived) {
+        // Counts earlier attempts too, even when cancelled while waiting to retry
+        [[FBMetrics sharedMetrics] recordBytesSent:self.bytesSent
+                                     bytesReceived:self.bytesReceived
+                                        forFeature:self.networkFeature];
+    }
     if (handler != nil) {
         handler(self, error, response, responseData);
     }
 }
 
+- (void)setPriority:(FBRequestPriority)priority {
+    _priority = priority;
+    [[FBRequestScheduler sharedScheduler] setPriority:priority forRequest:self.scheduledRequest];
+}
+
 - (void)logMessage:(NSString *)message {
     [FBLogger singleShotLogEntry:FBLoggingBehaviorFBURLConnections formatString:@"%@", message];
 }
 
+- (void)setCancellationToken:(FBCancellationToken *)cancellationToken {
+    if (cancellationToken == _cancellationToken) {
+        return;
+    }
+    [_cancellationToken unregisterCancellationObserver:self.cancellationRegistration];
+    self.cancellationRegistration = nil;
+    [_cancellationToken release];
+    _cancellationToken = [cancellationToken retain];
+
+    // Unretained; dealloc unregisters the block before it could outlive us
+    __block FBURLConnection *connection = self;
+    self.cancellationRegistration = [cancellationToken registerCancellationObserverWithBlock:^{
+        [connection cancel];
+    }];
+}
+
 - (void)dealloc {
+    [_cancellationToken unregisterCancellationObserver:_cancellationRegistration];
+    [_cancellationToken release];
+    [_cancellationRegistration release];
     [_response release];
     [_connection release];
+    [_task release];
     [_data release];
+    [_cacheWriter discard];
+    [_cacheWriter release];
     [_handler release];
+    [_timings release];
+    [_networkFeature release];
+    [_replayCall release];
+    [_request release];
+    [_retryPolicy release];
+    [[FBRequestScheduler sharedScheduler] finishRequest:_scheduledRequest];
+    [_scheduledRequest release];
     [super dealloc];
 }
 
 - (void)cancel {
+    self.cancelled = YES;
+    // A retry or circuit breaker failure may be waiting
+    [NSObject cancelPreviousPerformRequestsWithTarget:self];
     [self.connection cancel];
+    [self.task cancel];
+    [self.replayCall cancel];
+    [self finishScheduledRequest];
     if (self.handler == nil) {
         return;
     }
@@ -201,16 +491,47 @@ static NSArray *_cdnHosts;
 - (void)connection:(NSURLConnection *)connection
 didReceiveResponse:(NSURLResponse *)response {
     self.response = response;
-    [self.data setLength:0];
+    [self.timings markResponseStart];
+
+    // May be called more than once, in which case we start over
+    [self.cacheWriter discard];
+    self.cacheWriter = nil;
+    self.data = nil;
+
+    long long expectedLength = response.expectedContentLength;
+    if (expectedLength > kStreamToDiskCacheThreshold &&
+        [self isCDNURL:response.URL] &&
+        [[self getCache] shouldAdmitDataOfLength:(NSUInteger)expectedLength forURL:response.URL]) {
+        self.cacheWriter = [[self getCache] writerForURL:response.URL];
+    }
+
+    if (self.cacheWriter == nil) {
+        NSUInteger capacity = 0;
+        if (expectedLength != NSURLResponseUnknownLength && expectedLength <= NSUIntegerMax) {
+            capacity = (NSUInteger)expectedLength;
+        }
+        self.data = [NSMutableData dataWithCapacity:capacity];
+    }
 }
 
 - (void)connection:(NSURLResponse *)connection
     didReceiveData:(NSData *)data {
-    [self.data appendData:data];
+    self.bytesReceived += data.length;
+    if (self.cacheWriter) {
+        [self.cacheWriter appendData:data];
+    } else {
+        [self.data appendData:data];
+    }
 }
 
 - (void)connection:(NSURLConnection *)connection
   didFailWithError:(NSError *)error {
+    [self.cacheWriter discard];
+    self.cacheWriter = nil;
+    if ([self retryAfterError:error response:nil]) {
+        return;
+    }
+
     @try {
         [self logAndInvokeHandler:self.handler error:error];
     } @finally {
@@ -219,15 +540,39 @@ didReceiveResponse:(NSURLResponse *)response {
 }
 
 - (void)connectionDidFinishLoading:(NSURLConnection *)connection {
-    NSURL *dataURL = self.response.URL;
-    if ([self isCDNURL:dataURL]) {
-        // Cache this data
-        FBDataDiskCache *cache = [self getCache];
-        [cache setData:self.data forURL:dataURL];
+    [self.timings markResponseEnd];
+    if ([self retryAfterError:nil response:self.response]) {
+        return;
+    }
+    NSData *responseData = self.data;
+    if (self.cacheWriter) {
+        // Already in the cache, hand back the mapped file
+        responseData = [self.cacheWriter commit];
+        self.cacheWriter = nil;
+
+        if (responseData == nil) {
+            NSError *error = [[[NSError alloc] initWithDomain:FacebookSDKDomain
+                                                         code:FBErrorSystemAPI
+                                                     userInfo:nil] autorelease];
+            @try {
+                [self logAndInvokeHandler:self.handler error:error];
+            } @finally {
+                self.handler = nil;
+            }
+            return;
+        }
+    } else {
+        NSURL *dataURL = self.response.URL;
+        if ([self isCDNURL:dataURL]) {
+            // Cache this data, on disk only if it's likely to be asked for again
+            FBDataDiskCache *cache = [self getCache];
+            [cache offerData:responseData forURL:dataURL];
+            [FBURLConnection noteCDNHost:dataURL.host];
+        }
     }
 
     @try {
-        [self logAndInvokeHandler:self.handler response:self.response responseData:self.data];
+        [self logAndInvokeHandler:self.handler response:self.response responseData:responseData];
     } @finally {
         self.handler = nil;
     }
@@ -236,6 +581,10 @@ didReceiveResponse:(NSURLResponse *)response {
 - (NSURLRequest *)connection:(NSURLConnection *)connection
              willSendRequest:(NSURLRequest *)request
             redirectResponse:(NSURLResponse *)redirectResponse {
+    if (redirectResponse && redirectResponse.URL && [self isCDNURL:request.URL]) {
+        [[FBURLRedirectCache sharedCache] setRedirectURL:request.URL forURL:redirectResponse.URL];
+    }
+
     if ([self shouldShortCircuitRedirectResponse:redirectResponse]) {
         NSURL *redirectURL = request.URL;
 
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+// Remembers where URLs that redirect to the CDN, like graph.facebook.com/<id>/picture,
+// ended up, so the content can be found in the disk cache without asking the server
+// for the redirect again.  URLs are matched with any access_token parameter left out,
+// and entries expire after timeToLive.  Saved to the caches directory, so it survives
+// relaunches.  Lookups may come from any connection's thread.
+@interface FBURLRedirectCache : NSObject
+
++ (FBURLRedirectCache *)sharedCache;
+
+// Seconds an entry is trusted for; CDN URLs are signed and eventually stop working.
+@property (nonatomic, assign) NSTimeInterval timeToLive;
+
+// Where url last redirected to, or nil if that isn't known or has expired.
+- (NSURL *)redirectURLForURL:(NSURL *)url;
+- (void)setRedirectURL:(NSURL *)redirectURL forURL:(NSURL *)url;
+- (void)removeRedirectForURL:(NSURL *)url;
+
+@end
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBURLRedirectCache.h"
+
+#import "FBDispatch.h"
+
+static NSString *const kRedirectCacheFileName = @"FBURLRedirectCache.plist";
+static const NSTimeInterval kDefaultTimeToLive = 24 * 60 * 60;
+static const NSUInteger kMaximumEntryCount = 2000;
+// Changes are written out at most this often
+static const int64_t kSaveDelay = 2 * NSEC_PER_SEC;
+
+static NSString *const kEntryURLKey = @"url";
+static NSString *const kEntryExpiryKey = @"expires";
+
+// The URL without any access_token parameter, so the entry outlives the session
+static NSString *FBURLRedirectCacheKey(NSURL *url) {
+    NSString *query = url.query;
+    NSString *string = url.absoluteString;
+    if (!query || [query rangeOfString:@"access_token="].location == NSNotFound) {
+        return string;
+    }
+
+    NSMutableArray *parameters = [NSMutableArray array];
+    for (NSString *parameter in [query componentsSeparatedByString:@"&"]) {
+        if (![parameter hasPrefix:@"access_token="]) {
+            [parameters addObject:parameter];
+        }
+    }
+    NSRange queryRange = [string rangeOfString:query options:NSBackwardsSearch];
+    return [string stringByReplacingCharactersInRange:queryRange
+                                           withString:[parameters componentsJoinedByString:@"&"]];
+}
+
+@implementation FBURLRedirectCache {
+    NSMutableDictionary *_entries;
+    NSString *_path;
+    dispatch_queue_t _saveQueue;
+    BOOL _savePending;
+}
+
++ (FBURLRedirectCache *)sharedCache
+{
+    static FBURLRedirectCache *_instance;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBURLRedirectCache alloc] init];
+    });
+
+    return _instance;
+}
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        NSArray *cacheList = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+        _path = [[[cacheList objectAtIndex:0] stringByAppendingPathComponent:kRedirectCacheFileName] copy];
+        _entries = [[NSMutableDictionary alloc] initWithContentsOfFile:_path] ?: [[NSMutableDictionary alloc] init];
+        _saveQueue = FBDispatchQueueCreateSerial("com.facebook.sdk.FBURLRedirectCache", FBDispatchLaneBackground);
+        _timeToLive = kDefaultTimeToLive;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_entries release];
+    [_path release];
+    dispatch_release(_saveQueue);
+    [super dealloc];
+}
+
+- (NSURL *)redirectURLForURL:(NSURL *)url
+{
+    NSString *key = FBURLRedirectCacheKey(url);
+    @synchronized(self) {
+        NSDictionary *entry = [_entries objectForKey:key];
+        if (!entry) {
+            return nil;
+        }
+        if ([[entry objectForKey:kEntryExpiryKey] doubleValue] < [NSDate timeIntervalSinceReferenceDate]) {
+            [_entries removeObjectForKey:key];
+            [self scheduleSave];
+            return nil;
+        }
+        return [NSURL URLWithString:[entry objectForKey:kEntryURLKey]];
+    }
+}
+
+- (void)setRedirectURL:(NSURL *)redirectURL forURL:(NSURL *)url
+{
+    NSString *key = FBURLRedirectCacheKey(url);
+    NSString *redirectString = redirectURL.absoluteString;
+    if (!key || !redirectString) {
+        return;
+    }
+
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    NSDictionary *entry = @{kEntryURLKey: redirectString,
+                            kEntryExpiryKey: @(now + self.timeToLive)};
+    @synchronized(self) {
+        [_entries setObject:entry forKey:key];
+        if (_entries.count > kMaximumEntryCount) {
+            // drop whatever is closest to expiring, which is also what was added longest ago
+            NSArray *keys = [_entries keysSortedByValueUsingComparator:^NSComparisonResult(NSDictionary *a, NSDictionary *b) {
+                return [[a objectForKey:kEntryExpiryKey] compare:[b objectForKey:kEntryExpiryKey]];
+            }];
+            [_entries removeObjectsForKeys:[keys subarrayWithRange:NSMakeRange(0, keys.count - kMaximumEntryCount * 3 / 4)]];
+        }
+        [self scheduleSave];
+    }
+}
+
+- (void)removeRedirectForURL:(NSURL *)url
+{
+    NSString *key = FBURLRedirectCacheKey(url);
+    @synchronized(self) {
+        if ([_entries objectForKey:key]) {
+            [_entries removeObjectForKey:key];
+            [self scheduleSave];
+        }
+    }
+}
+
+// Called while synchronized on self
+- (void)scheduleSave
+{
+    if (_savePending) {
+        return;
+    }
+    _savePending = YES;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, kSaveDelay), _saveQueue, ^{
+        NSDictionary *entries = nil;
+        @synchronized(self) {
+            _savePending = NO;
+            entries = [[_entries copy] autorelease];
+        }
+        [entries writeToFile:_path atomically:YES];
+    });
+}
+
+@end
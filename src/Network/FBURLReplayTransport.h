@@ -0,0 +1,73 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+
+typedef enum {
+    // Requests go to the network, and each response is saved to the directory
+    FBURLReplayTransportModeRecord,
+    // Requests are answered from the directory and never reach the network
+    FBURLReplayTransportModeReplay,
+} FBURLReplayTransportMode;
+
+// Records Graph responses to a directory and plays them back, so request
+// handling can be benchmarked without the network.  While a transport is
+// active every FBURLConnection runs through it, and so does the rest of the
+// FBRequestConnection pipeline above it: batching, parsing, caching and
+// completion all run exactly as they do against the server.
+//
+// Requests are matched on their method and URL, ignoring the access token
+// and the order of the query parameters.  Responses recorded for the same
+// match are replayed in the order they were recorded, with the last one
+// repeating; POST batches all share a URL, so a benchmark should make its
+// requests in the same order it recorded them.  A request with no recording
+// fails with NSURLErrorNotConnectedToInternet.
+//
+// Delegate callbacks are made on the main queue with a nil connection, as for
+// FBURLSessionTransport.
+@interface FBURLReplayTransport : NSObject
+
+@property (nonatomic, readonly) FBURLReplayTransportMode mode;
+@property (nonatomic, copy, readonly) NSString *directory;
+// Delay before a replayed response starts; 0 by default
+@property (nonatomic) NSTimeInterval latency;
+// Rate replayed bodies are delivered at, or 0, the default, for all at once
+@property (nonatomic) NSUInteger bytesPerSecond;
+// Requests answered from recordings, and requests with no recording to answer them
+@property (nonatomic, readonly) NSUInteger replayedCount;
+@property (nonatomic, readonly) NSUInteger missedCount;
+
+// The transport FBURLConnection sends requests through, or nil for the network
++ (FBURLReplayTransport *)activeTransport;
++ (void)setActiveTransport:(FBURLReplayTransport *)transport;
+
+- (instancetype)initWithDirectory:(NSString *)directory
+                             mode:(FBURLReplayTransportMode)mode;
+
+// Saves a response as if it had been recorded, so replays can be set up
+// without a network
+- (void)recordResponse:(NSHTTPURLResponse *)response
+                  data:(NSData *)data
+            forRequest:(NSURLRequest *)request;
+
+// Starts the request, returning an object that responds to -cancel.  The
+// delegate gets NSURLConnectionDataDelegate callbacks and is retained
+// until the request completes or is cancelled.
+- (id)startWithRequest:(NSURLRequest *)request
+              delegate:(id)delegate;
+
+@end
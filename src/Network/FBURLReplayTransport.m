@@ -0,0 +1,331 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBURLReplayTransport.h"
+
+#import "FBURLSessionTransport.h"
+
+static NSString *const kIndexFileName = @"FBURLReplayIndex.plist";
+static NSString *const kURLKey = @"url";
+static NSString *const kStatusCodeKey = @"statusCode";
+static NSString *const kHeadersKey = @"headers";
+static NSString *const kBodyKey = @"body";
+
+// Replayed bodies are delivered in slices this often when the bandwidth is limited
+static const NSTimeInterval kDeliveryInterval = 0.01;
+
+static FBURLReplayTransport *g_activeTransport = nil;
+
+// The token is different every run and the query order follows dictionary
+// enumeration, so neither may tell two recordings apart.
+static NSString *FBURLReplayTransportKeyForRequest(NSURLRequest *request) {
+    NSURL *url = request.URL;
+    NSMutableArray *queryItems = [NSMutableArray array];
+    for (NSString *item in [url.query componentsSeparatedByString:@"&"]) {
+        if (![item hasPrefix:@"access_token="]) {
+            [queryItems addObject:item];
+        }
+    }
+    [queryItems sortUsingSelector:@selector(compare:)];
+    return [NSString stringWithFormat:@"%@ %@://%@%@?%@",
+            request.HTTPMethod ?: @"GET",
+            url.scheme,
+            url.host,
+            url.path,
+            [queryItems componentsJoinedByString:@"&"]];
+}
+
+@interface FBURLReplayTransport ()
+
+@property (nonatomic, copy, readwrite) NSString *directory;
+@property (nonatomic, retain) NSMutableDictionary *index;
+@property (nonatomic, retain) NSMutableDictionary *replayPositions;
+
+- (NSDictionary *)nextRecordingForRequest:(NSURLRequest *)request;
+
+@end
+
+#pragma mark - Recording
+
+// Sits between a real connection and its delegate, saving the response as it
+// passes through.
+@interface FBURLReplayRecorder : NSObject
+
+@property (nonatomic, retain) FBURLReplayTransport *transport;
+@property (nonatomic, retain) NSURLRequest *request;
+@property (nonatomic, retain) id delegate;
+@property (nonatomic, retain) NSHTTPURLResponse *response;
+@property (nonatomic, retain) NSMutableData *data;
+
+@end
+
+@implementation FBURLReplayRecorder
+
+- (void)dealloc {
+    [_transport release];
+    [_request release];
+    [_delegate release];
+    [_response release];
+    [_data release];
+    [super dealloc];
+}
+
+- (BOOL)respondsToSelector:(SEL)selector {
+    return [super respondsToSelector:selector] || [self.delegate respondsToSelector:selector];
+}
+
+- (id)forwardingTargetForSelector:(SEL)selector {
+    return self.delegate;
+}
+
+- (void)connection:(NSURLConnection *)connection
+didReceiveResponse:(NSURLResponse *)response {
+    self.response = [response isKindOfClass:[NSHTTPURLResponse class]] ? (NSHTTPURLResponse *)response : nil;
+    self.data = [NSMutableData data];
+    [self.delegate connection:connection didReceiveResponse:response];
+}
+
+- (void)connection:(NSURLConnection *)connection
+    didReceiveData:(NSData *)data {
+    [self.data appendData:data];
+    [self.delegate connection:connection didReceiveData:data];
+}
+
+- (void)connection:(NSURLConnection *)connection
+  didFailWithError:(NSError *)error {
+    [self.delegate connection:connection didFailWithError:error];
+    self.delegate = nil;
+}
+
+- (void)connectionDidFinishLoading:(NSURLConnection *)connection {
+    if (self.response) {
+        [self.transport recordResponse:self.response data:self.data forRequest:self.request];
+    }
+    [self.delegate connectionDidFinishLoading:connection];
+    self.delegate = nil;
+}
+
+@end
+
+#pragma mark - Replay
+
+@interface FBURLReplayCall : NSObject
+
+@property (nonatomic, retain) id delegate;
+@property (nonatomic, retain) NSURLResponse *response;
+@property (nonatomic, retain) NSData *data;
+@property (nonatomic) NSUInteger bytesPerSecond;
+@property (nonatomic) NSUInteger offset;
+
+- (void)startAfterDelay:(NSTimeInterval)delay;
+- (void)deliverData;
+- (void)finishWithError:(NSError *)error;
+- (void)cancel;
+
+@end
+
+@implementation FBURLReplayCall
+
+- (void)dealloc {
+    [_delegate release];
+    [_response release];
+    [_data release];
+    [super dealloc];
+}
+
+- (void)startAfterDelay:(NSTimeInterval)delay {
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        if (!self.delegate) {
+            return;
+        }
+        if (!self.response) {
+            NSError *error = [NSError errorWithDomain:NSURLErrorDomain
+                                                 code:NSURLErrorNotConnectedToInternet
+                                             userInfo:nil];
+            [self finishWithError:error];
+            return;
+        }
+        if ([self.delegate respondsToSelector:@selector(connection:didReceiveResponse:)]) {
+            [self.delegate connection:nil didReceiveResponse:self.response];
+        }
+        [self deliverData];
+    });
+}
+
+- (void)deliverData {
+    if (!self.delegate) {
+        return;
+    }
+
+    NSUInteger remaining = self.data.length - self.offset;
+    NSUInteger sliceLength = remaining;
+    if (self.bytesPerSecond > 0) {
+        sliceLength = MIN(remaining, MAX((NSUInteger)(self.bytesPerSecond * kDeliveryInterval), 1));
+    }
+    if (sliceLength > 0 && [self.delegate respondsToSelector:@selector(connection:didReceiveData:)]) {
+        [self.delegate connection:nil didReceiveData:[self.data subdataWithRange:NSMakeRange(self.offset, sliceLength)]];
+    }
+    self.offset += sliceLength;
+
+    if (self.offset < self.data.length) {
+        NSTimeInterval delay = (NSTimeInterval)sliceLength / self.bytesPerSecond;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            [self deliverData];
+        });
+    } else {
+        [self finishWithError:nil];
+    }
+}
+
+- (void)finishWithError:(NSError *)error {
+    id delegate = [[self.delegate retain] autorelease];
+    self.delegate = nil;
+    if (error) {
+        if ([delegate respondsToSelector:@selector(connection:didFailWithError:)]) {
+            [delegate connection:nil didFailWithError:error];
+        }
+    } else if ([delegate respondsToSelector:@selector(connectionDidFinishLoading:)]) {
+        [delegate connectionDidFinishLoading:nil];
+    }
+}
+
+- (void)cancel {
+    self.delegate = nil;
+}
+
+@end
+
+#pragma mark -
+
+@implementation FBURLReplayTransport
+
++ (FBURLReplayTransport *)activeTransport {
+    @synchronized (self) {
+        return [[g_activeTransport retain] autorelease];
+    }
+}
+
++ (void)setActiveTransport:(FBURLReplayTransport *)transport {
+    @synchronized (self) {
+        if (transport != g_activeTransport) {
+            [g_activeTransport release];
+            g_activeTransport = [transport retain];
+        }
+    }
+}
+
+- (instancetype)initWithDirectory:(NSString *)directory
+                             mode:(FBURLReplayTransportMode)mode {
+    if ((self = [super init])) {
+        _mode = mode;
+        _directory = [directory copy];
+        _replayPositions = [[NSMutableDictionary alloc] init];
+
+        [[NSFileManager defaultManager] createDirectoryAtPath:directory
+                                  withIntermediateDirectories:YES
+                                                   attributes:nil
+                                                        error:NULL];
+        NSDictionary *index = [NSDictionary dictionaryWithContentsOfFile:[directory stringByAppendingPathComponent:kIndexFileName]];
+        _index = [[NSMutableDictionary alloc] init];
+        for (NSString *key in index) {
+            [_index setObject:[[[index objectForKey:key] mutableCopy] autorelease] forKey:key];
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_directory release];
+    [_index release];
+    [_replayPositions release];
+    [super dealloc];
+}
+
+- (void)recordResponse:(NSHTTPURLResponse *)response
+                  data:(NSData *)data
+            forRequest:(NSURLRequest *)request {
+    NSDictionary *recording = @{ kURLKey : response.URL.absoluteString ?: request.URL.absoluteString,
+                                 kStatusCodeKey : [NSNumber numberWithInteger:response.statusCode],
+                                 kHeadersKey : response.allHeaderFields ?: @{},
+                                 kBodyKey : data ?: [NSData data] };
+    NSString *key = FBURLReplayTransportKeyForRequest(request);
+
+    @synchronized (self) {
+        NSUInteger recordingCount = 0;
+        for (NSArray *fileNames in [self.index objectEnumerator]) {
+            recordingCount += fileNames.count;
+        }
+        NSString *fileName = [NSString stringWithFormat:@"response-%05lu.plist", (unsigned long)recordingCount];
+        [recording writeToFile:[self.directory stringByAppendingPathComponent:fileName] atomically:YES];
+
+        NSMutableArray *fileNames = [self.index objectForKey:key];
+        if (!fileNames) {
+            fileNames = [NSMutableArray array];
+            [self.index setObject:fileNames forKey:key];
+        }
+        [fileNames addObject:fileName];
+        [self.index writeToFile:[self.directory stringByAppendingPathComponent:kIndexFileName] atomically:YES];
+    }
+}
+
+- (NSDictionary *)nextRecordingForRequest:(NSURLRequest *)request {
+    NSString *key = FBURLReplayTransportKeyForRequest(request);
+    NSString *fileName = nil;
+    @synchronized (self) {
+        NSArray *fileNames = [self.index objectForKey:key];
+        if (fileNames.count == 0) {
+            _missedCount++;
+            return nil;
+        }
+        NSUInteger position = [[self.replayPositions objectForKey:key] unsignedIntegerValue];
+        fileName = [fileNames objectAtIndex:MIN(position, fileNames.count - 1)];
+        [self.replayPositions setObject:[NSNumber numberWithUnsignedInteger:position + 1] forKey:key];
+        _replayedCount++;
+    }
+    return [NSDictionary dictionaryWithContentsOfFile:[self.directory stringByAppendingPathComponent:fileName]];
+}
+
+- (id)startWithRequest:(NSURLRequest *)request
+              delegate:(id)delegate {
+    if (self.mode == FBURLReplayTransportModeRecord) {
+        FBURLReplayRecorder *recorder = [[[FBURLReplayRecorder alloc] init] autorelease];
+        recorder.transport = self;
+        recorder.request = request;
+        recorder.delegate = delegate;
+        if ([FBURLSessionTransport isEnabled]) {
+            return [[FBURLSessionTransport sharedTransport] startTaskWithRequest:request delegate:recorder];
+        }
+        return [[[NSURLConnection alloc] initWithRequest:request delegate:recorder] autorelease];
+    }
+
+    FBURLReplayCall *call = [[[FBURLReplayCall alloc] init] autorelease];
+    call.delegate = delegate;
+    call.bytesPerSecond = self.bytesPerSecond;
+
+    NSDictionary *recording = [self nextRecordingForRequest:request];
+    if (recording) {
+        call.response = [[[NSHTTPURLResponse alloc] initWithURL:[NSURL URLWithString:[recording objectForKey:kURLKey]]
+                                                     statusCode:[[recording objectForKey:kStatusCodeKey] integerValue]
+                                                    HTTPVersion:@"HTTP/1.1"
+                                                   headerFields:[recording objectForKey:kHeadersKey]] autorelease];
+        call.data = [recording objectForKey:kBodyKey];
+    }
+    [call startAfterDelay:self.latency];
+    return call;
+}
+
+@end
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+// Runs requests through one shared NSURLSession, so that connections to
+// the same host are kept alive and reused across requests, along with their
+// TLS sessions, rather than each request paying for its own handshake.
+//
+// Task callbacks are forwarded on the main queue to the delegate's
+// NSURLConnectionDataDelegate methods, with a nil connection, so the delegate
+// can be written against NSURLConnection alone.  The delegate is retained
+// until the task completes.
+@interface FBURLSessionTransport : NSObject <NSURLSessionDataDelegate>
+{
+@private
+    NSURLSession *_session;
+    // Delegates of running tasks, keyed by task identifier
+    NSMutableDictionary *_delegates;
+    // When each host was last prewarmed; guarded by @synchronized(_delegates)
+    NSMutableDictionary *_prewarmTimes;
+}
+
+// NO before iOS 7, or when disabled
++ (BOOL)isEnabled;
+// NSURLProtocol based stubs don't see session traffic, so tests turn this off
++ (void)setEnabled:(BOOL)enabled;
++ (FBURLSessionTransport *)sharedTransport;
+
+- (NSURLSessionDataTask *)startTaskWithRequest:(NSURLRequest *)request
+                                      delegate:(id)delegate;
+
+// Sends a HEAD request to the root of each host, so that the session has a
+// connection open to it, TLS and all, by the time the first real request goes
+// out.  Hosts prewarmed within the last minute are skipped.
+- (void)prewarmConnectionsToHosts:(NSArray *)hosts;
+
+@end
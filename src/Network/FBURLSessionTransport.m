@@ -0,0 +1,199 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "FBURLSessionTransport.h"
+
+// Keeps a handful of connections per host open; Graph calls are small, so
+// these get reused far more often than they need to be opened.
+static const NSInteger kMaximumConnectionsPerHost = 4;
+
+// Idle connections are closed after a while, so prewarming again after this
+// does open a new one; more often than this it only adds requests
+static const NSTimeInterval kPrewarmInterval = 60;
+static const NSTimeInterval kPrewarmTimeout = 10;
+
+static BOOL g_enabled = YES;
+
+@implementation FBURLSessionTransport
+
+#pragma mark - Lifecycle
+
++ (BOOL)isEnabled
+{
+    return g_enabled && [NSURLSession class] != nil;
+}
+
++ (void)setEnabled:(BOOL)enabled
+{
+    g_enabled = enabled;
+}
+
++ (FBURLSessionTransport *)sharedTransport
+{
+    static FBURLSessionTransport *_instance;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBURLSessionTransport alloc] init];
+    });
+
+    return _instance;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+        configuration.HTTPMaximumConnectionsPerHost = kMaximumConnectionsPerHost;
+        configuration.HTTPShouldUsePipelining = NO; // poorly supported by proxies
+
+        _delegates = [[NSMutableDictionary alloc] init];
+        _prewarmTimes = [[NSMutableDictionary alloc] init];
+
+        // The session keeps a strong reference to us, which is fine for a
+        // singleton
+        _session = [[NSURLSession sessionWithConfiguration:configuration
+                                                  delegate:self
+                                             delegateQueue:[NSOperationQueue mainQueue]] retain];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_session invalidateAndCancel];
+    [_session release];
+    [_delegates release];
+    [_prewarmTimes release];
+    [super dealloc];
+}
+
+#pragma mark - Public
+
+- (NSURLSessionDataTask *)startTaskWithRequest:(NSURLRequest *)request
+                                      delegate:(id)delegate
+{
+    NSURLSessionDataTask *task = [_session dataTaskWithRequest:request];
+    @synchronized(_delegates) {
+        [_delegates setObject:delegate forKey:@(task.taskIdentifier)];
+    }
+    [task resume];
+
+    return task;
+}
+
+- (void)prewarmConnectionsToHosts:(NSArray *)hosts
+{
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    for (NSString *host in hosts) {
+        @synchronized(_delegates) {
+            NSNumber *lastPrewarmed = [_prewarmTimes objectForKey:host];
+            if (lastPrewarmed && now - lastPrewarmed.doubleValue < kPrewarmInterval) {
+                continue;
+            }
+            [_prewarmTimes setObject:@(now) forKey:host];
+        }
+
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"https://%@/", host]];
+        NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url
+                                                               cachePolicy:NSURLRequestReloadIgnoringLocalCacheData
+                                                           timeoutInterval:kPrewarmTimeout];
+        request.HTTPMethod = @"HEAD";
+        // No delegate; all that's wanted is the connection the task leaves behind
+        [[_session dataTaskWithRequest:request] resume];
+    }
+}
+
+#pragma mark - Private
+
+- (id)delegateForTask:(NSURLSessionTask *)task
+{
+    @synchronized(_delegates) {
+        return [[[_delegates objectForKey:@(task.taskIdentifier)] retain] autorelease];
+    }
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition disposition))completionHandler
+{
+    id delegate = [self delegateForTask:dataTask];
+    if ([delegate respondsToSelector:@selector(connection:didReceiveResponse:)]) {
+        [delegate connection:nil didReceiveResponse:response];
+    }
+    completionHandler(NSURLSessionResponseAllow);
+}
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+    didReceiveData:(NSData *)data
+{
+    id delegate = [self delegateForTask:dataTask];
+    if ([delegate respondsToSelector:@selector(connection:didReceiveData:)]) {
+        [delegate connection:nil didReceiveData:data];
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session
+              task:(NSURLSessionTask *)task
+willPerformHTTPRedirection:(NSHTTPURLResponse *)response
+        newRequest:(NSURLRequest *)request
+ completionHandler:(void (^)(NSURLRequest *))completionHandler
+{
+    NSURLRequest *redirectRequest = request;
+    id delegate = [self delegateForTask:task];
+    if ([delegate respondsToSelector:@selector(connection:willSendRequest:redirectResponse:)]) {
+        redirectRequest = [delegate connection:nil willSendRequest:request redirectResponse:response];
+    }
+
+    if (redirectRequest) {
+        completionHandler(redirectRequest);
+    } else {
+        // NSURLConnection stops on a nil request, whereas a session would
+        // deliver the redirect response itself. The delegate has already
+        // finished, so it hears nothing of the cancellation.
+        @synchronized(_delegates) {
+            [_delegates removeObjectForKey:@(task.taskIdentifier)];
+        }
+        [task cancel];
+        completionHandler(nil);
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session
+              task:(NSURLSessionTask *)task
+didCompleteWithError:(NSError *)error
+{
+    id delegate = [self delegateForTask:task];
+    @synchronized(_delegates) {
+        [_delegates removeObjectForKey:@(task.taskIdentifier)];
+    }
+
+    if (error) {
+        if ([delegate respondsToSelector:@selector(connection:didFailWithError:)]) {
+            [delegate connection:nil didFailWithError:error];
+        }
+    } else if ([delegate respondsToSelector:@selector(connectionDidFinishLoading:)]) {
+        [delegate connectionDidFinishLoading:nil];
+    }
+}
+
+@end
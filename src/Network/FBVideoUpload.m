@@ -0,0 +1,279 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBVideoUpload.h"
+
+#import "FBDispatch.h"
+#import "FBError.h"
+#import "FBRequest.h"
+#import "FBRequestConnection.h"
+#import "FBRequestRetryPolicy.h"
+#import "FBSession.h"
+
+static const NSUInteger kDefaultMaximumRetryCount = 5;
+
+// Offsets come back as strings
+static unsigned long long FBVideoUploadOffset(id value)
+{
+    return [value respondsToSelector:@selector(longLongValue)] ? (unsigned long long)[value longLongValue] : 0;
+}
+
+@interface FBVideoUpload ()
+
+@property (nonatomic, readwrite, retain) NSURL *fileURL;
+@property (nonatomic, readwrite, copy) NSString *uploadSessionID;
+@property (nonatomic, readwrite, copy) NSString *videoID;
+@property (nonatomic, readwrite) unsigned long long bytesUploaded;
+@property (nonatomic, readwrite) unsigned long long fileSize;
+@property (nonatomic, retain) FBSession *session;
+@property (nonatomic, copy) NSString *graphPath;
+@property (nonatomic, copy) NSDictionary *parameters;
+@property (nonatomic, retain) FBRequestConnection *connection;
+@property (nonatomic, copy) FBVideoUploadHandler handler;
+
+@end
+
+@implementation FBVideoUpload
+{
+    // The range the server asked for next
+    unsigned long long _startOffset;
+    unsigned long long _endOffset;
+    NSUInteger _retryCount;
+    // Bumped when the upload stops, so callbacks from before are ignored
+    NSUInteger _generation;
+}
+
+#pragma mark - Lifecycle
+
+- (instancetype)initWithSession:(FBSession *)session
+                      graphPath:(NSString *)graphPath
+                        fileURL:(NSURL *)fileURL
+                     parameters:(NSDictionary *)parameters
+{
+    if ((self = [super init])) {
+        _session = [session retain];
+        _graphPath = [graphPath copy];
+        _fileURL = [fileURL retain];
+        _parameters = [parameters copy];
+        _retryPolicy = [[FBRequestRetryPolicy alloc] init];
+        _retryPolicy.maximumRetryCount = kDefaultMaximumRetryCount;
+        // Chunks go to one host in order, so a circuit breaker would only cut off the upload's own retries
+        _retryPolicy.circuitBreakerFailureThreshold = 0;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_connection cancel];
+    [_connection release];
+    [_session release];
+    [_graphPath release];
+    [_fileURL release];
+    [_parameters release];
+    [_uploadSessionID release];
+    [_videoID release];
+    [_retryPolicy release];
+    [_progressHandler release];
+    [_handler release];
+    [super dealloc];
+}
+
+#pragma mark - Public
+
+- (void)startWithCompletionHandler:(FBVideoUploadHandler)handler
+{
+    NSAssert(!self.handler, @"Cannot start an upload that is already running.");
+    self.handler = handler;
+    _retryCount = 0;
+
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:self.fileURL.path error:nil];
+    if (!attributes) {
+        [self failWithError:[NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadNoSuchFileError userInfo:nil]];
+        return;
+    }
+    self.fileSize = [attributes fileSize];
+
+    if (self.uploadSessionID) {
+        [self sendTransfer];
+    } else {
+        [self sendStart];
+    }
+}
+
+- (void)cancel
+{
+    if (!self.handler) {
+        return;
+    }
+    [self failWithError:[NSError errorWithDomain:FacebookSDKDomain code:FBErrorOperationCancelled userInfo:nil]];
+}
+
+#pragma mark - Phases
+
+- (void)sendStart
+{
+    NSDictionary *parameters = @{@"upload_phase" : @"start",
+                                 @"file_size" : [NSString stringWithFormat:@"%llu", self.fileSize]};
+    [self sendParameters:parameters resend:@selector(sendStart) handler:^(id result) {
+        self.uploadSessionID = [result objectForKey:@"upload_session_id"];
+        self.videoID = [result objectForKey:@"video_id"];
+        [self didAcknowledgeResult:result];
+    }];
+}
+
+- (void)sendTransfer
+{
+    if (_startOffset >= _endOffset) {
+        [self sendFinish];
+        return;
+    }
+
+    // Only the chunk on the wire is ever in memory
+    NSUInteger generation = _generation;
+    unsigned long long startOffset = _startOffset;
+    NSUInteger length = (NSUInteger)(_endOffset - _startOffset);
+    NSURL *fileURL = self.fileURL;
+    [self retain];
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneUtility), ^{
+        NSData *chunk = nil;
+        @try {
+            NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingFromURL:fileURL error:nil];
+            [fileHandle seekToFileOffset:startOffset];
+            chunk = [[fileHandle readDataOfLength:length] retain];
+            [fileHandle closeFile];
+        } @catch (NSException *exception) {
+            // seekToFileOffset: throws if the file has shrunk
+        }
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (generation == _generation) {
+                if (chunk.length != length) {
+                    [self failWithError:[NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:nil]];
+                } else {
+                    [self sendChunk:chunk];
+                }
+            }
+            [chunk release];
+            [self release];
+        });
+    });
+}
+
+- (void)sendChunk:(NSData *)chunk
+{
+    NSDictionary *parameters = @{@"upload_phase" : @"transfer",
+                                 @"upload_session_id" : self.uploadSessionID,
+                                 @"start_offset" : [NSString stringWithFormat:@"%llu", _startOffset],
+                                 @"video_file_chunk" : chunk};
+    [self sendParameters:parameters resend:@selector(sendTransfer) handler:^(id result) {
+        [self didAcknowledgeResult:result];
+    }];
+}
+
+- (void)sendFinish
+{
+    NSMutableDictionary *parameters = [NSMutableDictionary dictionaryWithDictionary:self.parameters];
+    [parameters setObject:@"finish" forKey:@"upload_phase"];
+    [parameters setObject:self.uploadSessionID forKey:@"upload_session_id"];
+    [self sendParameters:parameters resend:@selector(sendFinish) handler:^(id result) {
+        NSMutableDictionary *finished = [NSMutableDictionary dictionaryWithDictionary:result];
+        if (self.videoID) {
+            [finished setObject:self.videoID forKey:@"video_id"];
+        }
+        [self finishWithResult:[FBGraphObject graphObjectWrappingDictionary:finished] error:nil];
+    }];
+}
+
+#pragma mark - Private
+
+// Posts one phase's request; transient failures are sent again with the resend
+// selector after the retry policy's backoff, and anything else fails the upload.
+- (void)sendParameters:(NSDictionary *)parameters
+                resend:(SEL)resend
+               handler:(void (^)(id result))handler
+{
+    NSUInteger generation = _generation;
+    FBRequest *request = [[[FBRequest alloc] initWithSession:self.session
+                                                   graphPath:self.graphPath
+                                                  parameters:parameters
+                                                  HTTPMethod:@"POST"] autorelease];
+    // Graph paths ending in /videos are sent to graph-video
+    self.connection = [request startWithCompletionHandler:^(FBRequestConnection *connection, id result, NSError *error) {
+        if (generation != _generation) {
+            return;
+        }
+        self.connection = nil;
+
+        if (!error) {
+            _retryCount = 0;
+            handler(result);
+            return;
+        }
+
+        NSHTTPURLResponse *response = [[error userInfo] objectForKey:FBErrorHTTPStatusCodeKey] ? connection.urlResponse : nil;
+        NSError *innerError = [[error userInfo] objectForKey:FBErrorInnerErrorKey];
+        if (_retryCount < self.retryPolicy.maximumRetryCount &&
+            [self.retryPolicy shouldRetryAfterError:innerError response:response]) {
+            _retryCount++;
+            NSTimeInterval backoff = [self.retryPolicy backoffBeforeRetry:_retryCount];
+            [self retain];
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(backoff * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+                if (generation == _generation) {
+                    [self performSelector:resend];
+                }
+                [self release];
+            });
+            return;
+        }
+
+        [self failWithError:error];
+    }];
+}
+
+- (void)didAcknowledgeResult:(id)result
+{
+    _startOffset = FBVideoUploadOffset([result objectForKey:@"start_offset"]);
+    _endOffset = FBVideoUploadOffset([result objectForKey:@"end_offset"]);
+    self.bytesUploaded = _startOffset;
+    if (self.progressHandler) {
+        self.progressHandler(self, self.bytesUploaded, self.fileSize);
+    }
+    [self sendTransfer];
+}
+
+- (void)failWithError:(NSError *)error
+{
+    [self finishWithResult:nil error:error];
+}
+
+- (void)finishWithResult:(id<FBGraphObject>)result error:(NSError *)error
+{
+    _generation++;
+    [self.connection cancel];
+    self.connection = nil;
+
+    // Keep ourselves around for the handler, which may release the last reference
+    [[self retain] autorelease];
+    FBVideoUploadHandler handler = [[self.handler retain] autorelease];
+    self.handler = nil;
+    if (handler) {
+        handler(self, result, error);
+    }
+}
+
+@end
@@ -16,32 +16,140 @@
 
 #import "FBFrictionlessRecipientCache.h"
 
+#import "FBAccessTokenData.h"
+#import "FBDataDiskCache.h"
+#import "FBDispatch.h"
 #import "FBFrictionlessDialogSupportDelegate.h"
 #import "FBFrictionlessRequestSettings.h"
 #import "FBSession+Internal.h"
 #import "FBUtility.h"
 
+// how long a recipient list is trusted before a dialog presentation refreshes it
+static const NSTimeInterval kFBFrictionlessRecipientCacheTTL = 60 * 60;
+
+static NSString *const FBFrictionlessRecipientCacheRecipientIDsKey = @"recipientIDs";
+static NSString *const FBFrictionlessRecipientCacheUpdateTimeKey = @"updateTime";
+
+static NSURL *FBFrictionlessRecipientCacheURL(FBSession *session) {
+    NSString *accessToken = session.accessTokenData.accessToken;
+    if (!accessToken) {
+        return nil;
+    }
+    NSString *escapedToken = [FBUtility stringByURLEncodingString:accessToken];
+    return [NSURL URLWithString:[@"fbfrictionlesscache://recipients?access_token=" stringByAppendingString:escapedToken]];
+}
+
 @interface FBFrictionlessRecipientCache () <FBFrictionlessDialogSupportDelegate>
 @property (nonatomic, readwrite) BOOL frictionlessShouldMakeViewInvisible;
 @property (nonatomic, readwrite, retain) FBFrictionlessRequestSettings *frictionlessSettings;
+@property (nonatomic, retain) FBSession *persistedSession;
 @end
 
-@implementation FBFrictionlessRecipientCache
+@implementation FBFrictionlessRecipientCache {
+    NSTimeInterval _lastUpdateTime;
+    BOOL _refreshing;
+    BOOL _restoring;
+}
 
 - (instancetype)init {
     self = [super init];
     if (self) {
         self.frictionlessSettings = [[[FBFrictionlessRequestSettings alloc] init] autorelease];
         [self.frictionlessSettings enableWithFacebook:nil]; // sets the flag on
+
+        // the settings are also updated directly by request dialogs, so persist from there;
+        // not retained, the handler is cleared before we go away
+        __block FBFrictionlessRecipientCache *cache = self;
+        self.frictionlessSettings.recipientCacheDidUpdateHandler = ^{
+            [cache recipientCacheDidUpdate];
+        };
     }
     return self;
 }
 
 - (void)dealloc {
+    self.frictionlessSettings.recipientCacheDidUpdateHandler = nil;
     self.frictionlessSettings = nil;
+    [_persistedSession release];
     [super dealloc];
 }
 
+#pragma mark - Persistence
+
+- (void)recipientCacheDidUpdate {
+    if (_restoring) {
+        return;
+    }
+    _lastUpdateTime = [NSDate timeIntervalSinceReferenceDate];
+
+    NSURL *cacheURL = FBFrictionlessRecipientCacheURL(self.persistedSession);
+    if (!cacheURL) {
+        return;
+    }
+    NSDictionary *record = @{FBFrictionlessRecipientCacheRecipientIDsKey: self.frictionlessSettings.recipientIDs ?: @[],
+                             FBFrictionlessRecipientCacheUpdateTimeKey: @(_lastUpdateTime)};
+    dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneBackground), ^{
+        NSData *data = [NSPropertyListSerialization dataWithPropertyList:record
+                                                                  format:NSPropertyListBinaryFormat_v1_0
+                                                                 options:0
+                                                                   error:NULL];
+        if (data) {
+            [[FBDataDiskCache sharedCache] setData:data forURL:cacheURL];
+        }
+    });
+}
+
+// Restoring is not an update, so the original time is kept and nothing is written back.
+- (void)restoreRecipientIDs:(NSArray *)recipientIDs updateTime:(NSTimeInterval)updateTime {
+    _restoring = YES;
+    [self.frictionlessSettings updateRecipientCacheWithRecipients:recipientIDs];
+    _restoring = NO;
+    _lastUpdateTime = updateTime;
+}
+
+// Switches the cache to the given session, restoring what was last persisted for it.
+- (void)useSession:(FBSession *)session {
+    if (!session || session == self.persistedSession) {
+        return;
+    }
+    BOOL sessionChanged = (self.persistedSession != nil);
+    self.persistedSession = session;
+    if (sessionChanged) {
+        // another user's recipients must not make this user's dialogs invisible
+        [self restoreRecipientIDs:nil updateTime:0];
+    }
+
+    NSURL *cacheURL = FBFrictionlessRecipientCacheURL(session);
+    if (!cacheURL) {
+        return;
+    }
+    [self retain];
+    [[FBDataDiskCache sharedCache] dataForURL:cacheURL completion:^(NSData *data) {
+        // anything fetched meanwhile is newer than what is on disk
+        NSDictionary *record = nil;
+        if (data && _lastUpdateTime == 0 && session == self.persistedSession) {
+            record = [NSPropertyListSerialization propertyListWithData:data
+                                                               options:NSPropertyListImmutable
+                                                                format:NULL
+                                                                 error:NULL];
+        }
+        if ([record isKindOfClass:[NSDictionary class]]) {
+            NSArray *recipientIDs = record[FBFrictionlessRecipientCacheRecipientIDsKey];
+            NSNumber *updateTime = record[FBFrictionlessRecipientCacheUpdateTimeKey];
+            if ([recipientIDs isKindOfClass:[NSArray class]] && [updateTime isKindOfClass:[NSNumber class]]) {
+                [self restoreRecipientIDs:recipientIDs updateTime:[updateTime doubleValue]];
+            }
+        }
+        [self release];
+    }];
+}
+
+- (BOOL)isStale {
+    return ([NSDate timeIntervalSinceReferenceDate] - _lastUpdateTime) > kFBFrictionlessRecipientCacheTTL;
+}
+
+#pragma mark - Public
+
 - (NSArray *)recipientIDs {
     return self.frictionlessSettings.recipientIDs;
 }
@@ -79,12 +187,18 @@
     if (!session) {
         session = [FBSession activeSessionIfOpen];
     }
+    [self useSession:session];
 
+    _refreshing = YES;
     [[[[FBRequest alloc] initWithSession:session
                                graphPath:@"me/apprequestformerrecipients"]
       autorelease]
      startWithCompletionHandler:^(FBRequestConnection *connection, id result, NSError *error) {
-         [self.frictionlessSettings updateRecipientCacheWithRequestResult:result];
+         _refreshing = NO;
+         // a failed refresh leaves the last known list in place until the next attempt
+         if (!error && session == self.persistedSession) {
+             [self.frictionlessSettings updateRecipientCacheWithRequestResult:result];
+         }
          if (handler) {
              handler(connection, result, error);
          }
@@ -99,6 +213,16 @@
     // dialog is an apprequests dialog; noop if a non-apprequests dialog
     if ([dialog isEqualToString:@"apprequests"]) {
 
+        // the dialog reports the current list when it completes, so a refresh is
+        // only worth issuing once what we have has gone stale
+        if (!session) {
+            session = [FBSession activeSessionIfOpen];
+        }
+        [self useSession:session];
+        if (session && !_refreshing && [self isStale]) {
+            [self prefetchAndCacheForSession:session];
+        }
+
         // frictionless parameter means:
         //  a. show the "Don't show this again for these friends" checkbox
         //  b. if the developer is sending a targeted request, then skip the loading screen
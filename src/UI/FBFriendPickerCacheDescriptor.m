@@ -19,6 +19,7 @@
 #import "FBFriendPickerViewController+Internal.h"
 #import "FBGraphObjectPagingLoader.h"
 #import "FBGraphObjectTableDataSource.h"
+#import "FBMetrics.h"
 #import "FBRequest.h"
 #import "FBRequestConnection.h"
 #import "FBSession.h"
@@ -104,6 +105,7 @@
                                                               pagingMode:FBGraphObjectPagingModeImmediateViewless]
                    autorelease];
     self.loader.session = session;
+    self.loader.networkFeature = FBNetworkFeatureFriendPicker;
 
     self.loader.delegate = self;
 
@@ -17,7 +17,9 @@
 #import "FBFriendPickerViewController.h"
 #import "FBFriendPickerViewController+Internal.h"
 
+#import "FBAccessTokenData.h"
 #import "FBAppEvents+Internal.h"
+#import "FBDataDiskCache.h"
 #import "FBError.h"
 #import "FBFriendPickerCacheDescriptor.h"
 #import "FBFriendPickerViewDefaultPNG.h"
@@ -26,16 +28,26 @@
 #import "FBGraphObjectTableDataSource.h"
 #import "FBGraphObjectTableSelection.h"
 #import "FBLogger.h"
+#import "FBMetrics.h"
 #import "FBRequest.h"
 #import "FBRequestConnection.h"
 #import "FBSession+Internal.h"
 #import "FBSettings.h"
 #import "FBUtility.h"
+#import "FBViewController+Internal.h"
 
 NSString *const FBFriendPickerCacheIdentity = @"FBFriendPicker";
 
 int const FBRefreshCacheDelaySeconds = 2;
 
+// A friend list kept up to date with deltas is still fetched in full once this old
+static const NSTimeInterval kFullSyncInterval = 24 * 60 * 60;
+// Friend IDs asked for in one page; a list with more than this is fetched in full
+static NSString *const kDeltaSyncIDLimit = @"5000";
+// Objects the Graph API looks up in one ?ids= request
+static const NSUInteger kMaximumDeltaLookups = 50;
+static NSString *const kFullSyncFragment = @"synced";
+
 @interface FBFriendPickerViewController () <FBGraphObjectSelectionChangedDelegate,
 FBGraphObjectViewControllerDelegate,
 FBGraphObjectPagingLoaderDelegate>
@@ -44,11 +56,19 @@ FBGraphObjectPagingLoaderDelegate>
 @property (nonatomic, retain) FBGraphObjectTableSelection *selectionManager;
 @property (nonatomic, retain) FBGraphObjectPagingLoader *loader;
 @property (nonatomic) BOOL trackActiveSession;
+// Where the grouped, sorted sections of the current request are saved between opens
+@property (nonatomic, retain) NSURL *snapshotURL;
+// Fetching what changed since the list was cached, when delta sync is enabled
+@property (nonatomic, retain) FBRequestConnection *syncConnection;
 
 - (void)initialize;
 - (void)centerAndStartSpinner;
 - (void)loadDataSkippingRoundTripIfCached:(NSNumber *)skipRoundTripIfCached;
+- (void)syncCachedFriends;
+- (void)syncAddedFriendIDs:(NSArray *)addedIDs fields:(NSString *)fields removingFriendIDs:(NSSet *)removedIDs;
+- (void)applyDeltaRemovingFriendIDs:(NSSet *)removedIDs addingFriends:(NSArray *)added;
 - (FBRequest *)requestForLoadData;
+- (NSURL *)snapshotURLForRequest:(FBRequest *)request;
 - (void)addSessionObserver:(FBSession *)session;
 - (void)removeSessionObserver:(FBSession *)session;
 - (void)clearData;
@@ -110,6 +130,8 @@ FBGraphObjectPagingLoaderDelegate>
                  autorelease];
     self.loader = loader;
     self.loader.delegate = self;
+    self.loader.networkFeature = FBNetworkFeatureFriendPicker;
+    dataSource.networkFeature = FBNetworkFeatureFriendPicker;
 
     // Self
     self.allowsMultipleSelection = YES;
@@ -133,6 +155,9 @@ FBGraphObjectPagingLoaderDelegate>
     [_dataSource release];
     [_fieldsForRequest release];
     [_selectionManager release];
+    [_snapshotURL release];
+    [_syncConnection cancel];
+    [_syncConnection release];
     [_spinner release];
     [_tableView release];
     [_userID release];
@@ -164,6 +189,14 @@ FBGraphObjectPagingLoaderDelegate>
     self.dataSource.itemPicturesEnabled = itemPicturesEnabled;
 }
 
+- (NSString *)searchText {
+    return self.dataSource.searchText;
+}
+
+- (void)setSearchText:(NSString *)searchText {
+    self.dataSource.searchText = searchText;
+}
+
 - (NSArray *)selection {
     // There might be bogus items set via setSelection, so we need to check against
     // datasource and filter them out.
@@ -269,8 +302,10 @@ FBGraphObjectPagingLoaderDelegate>
 }
 
 - (void)updateView {
-    [self.dataSource update];
-    [self.tableView reloadData];
+    // sorted in the background, so a keystroke in a search field doesn't stall on a long list
+    [self.dataSource updateWithCompletion:^{
+        [self.tableView reloadData];
+    }];
 }
 
 - (void)clearSelection {
@@ -357,11 +392,184 @@ FBGraphObjectPagingLoaderDelegate>
 }
 
 - (void)loadDataSkippingRoundTripIfCached:(NSNumber *)skipRoundTripIfCached {
+    [self.syncConnection cancel];
+    self.syncConnection = nil;
     if (self.session) {
-        [self.loader startLoadingWithRequest:[self requestForLoadData]
+        FBRequest *request = [self requestForLoadData];
+        self.snapshotURL = [self snapshotURLForRequest:request];
+        self.loader.cancellationToken = self.cancellationToken;
+        self.dataSource.cancellationToken = self.cancellationToken;
+        [self.loader startLoadingWithRequest:request
                                cacheIdentity:FBFriendPickerCacheIdentity
                        skipRoundtripIfCached:skipRoundTripIfCached.boolValue];
+
+        if (skipRoundTripIfCached.boolValue) {
+            // Shows the list as it was last time while the pages are read back and merged;
+            // whatever the loader delivers first replaces it.
+            [self.dataSource restoreSnapshotFromCacheURL:self.snapshotURL completion:^(BOOL restored) {
+                if (restored) {
+                    [self.tableView reloadData];
+                }
+            }];
+        }
+    }
+}
+
+// When the list was last fetched in full, kept next to the snapshot
+- (NSURL *)fullSyncURL {
+    if (!self.snapshotURL) {
+        return nil;
+    }
+    return [NSURL URLWithString:[NSString stringWithFormat:@"%@#%@",
+                                 self.snapshotURL.absoluteString,
+                                 kFullSyncFragment]];
+}
+
+- (void)recordFullSync {
+    NSURL *url = [self fullSyncURL];
+    if (url) {
+        NSString *time = [NSString stringWithFormat:@"%f", [[NSDate date] timeIntervalSince1970]];
+        [[FBDataDiskCache sharedCache] setData:[time dataUsingEncoding:NSUTF8StringEncoding] forURL:url];
+    }
+}
+
+- (BOOL)needsFullSync {
+    NSURL *url = [self fullSyncURL];
+    NSData *data = url ? [[FBDataDiskCache sharedCache] dataForURL:url] : nil;
+    if (!data) {
+        return YES;
+    }
+    NSString *time = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+    return [[NSDate date] timeIntervalSince1970] - [time doubleValue] > kFullSyncInterval;
+}
+
+// Brings a list shown from the cache up to date from one page of friend IDs, looking up
+// only the friends that were added.  The Graph API offers no way to ask which friends
+// changed, so anything this can't work out falls back to fetching every page again.
+- (void)syncCachedFriends {
+    if (!self.session || !self.dataSource.hasGraphObjects || [self needsFullSync]) {
+        [self loadDataSkippingRoundTripIfCached:[NSNumber numberWithBool:NO]];
+        return;
+    }
+
+    // requestForLoadData would reset the sorting and grouping, so build the request directly
+    FBRequest *request = [FBFriendPickerViewController requestWithUserID:self.userID ?: @"me"
+                                                                  fields:self.fieldsForRequest
+                                                              dataSource:self.dataSource
+                                                                 session:self.session];
+    NSString *fields = [request.parameters objectForKey:@"fields"];
+    FBRequest *idsRequest = [FBRequest requestForGraphPath:request.graphPath
+                                                    fields:[NSSet setWithObject:@"id"]];
+    idsRequest.session = self.session;
+    [idsRequest.parameters setObject:kDeltaSyncIDLimit forKey:@"limit"];
+
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:idsRequest completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        if (innerConnection != self.syncConnection) {
+            return;
+        }
+        self.syncConnection = nil;
+
+        NSArray *friends = [result objectForKey:@"data"];
+        if (error ||
+            ![friends isKindOfClass:[NSArray class]] ||
+            [[result objectForKey:@"paging"] objectForKey:@"next"]) {
+            [self loadDataSkippingRoundTripIfCached:[NSNumber numberWithBool:NO]];
+            return;
+        }
+
+        NSSet *cachedIDs = [self.dataSource graphObjectIDs];
+        NSMutableSet *removedIDs = [[cachedIDs mutableCopy] autorelease];
+        NSMutableArray *addedIDs = [NSMutableArray array];
+        for (id<FBGraphObject> friend in friends) {
+            NSString *friendID = [friend objectForKey:@"id"];
+            if (![friendID isKindOfClass:[NSString class]]) {
+                continue;
+            }
+            [removedIDs removeObject:friendID];
+            if (![cachedIDs containsObject:friendID]) {
+                [addedIDs addObject:friendID];
+            }
+        }
+
+        if (addedIDs.count == 0) {
+            [self applyDeltaRemovingFriendIDs:removedIDs addingFriends:nil];
+        } else if (addedIDs.count > kMaximumDeltaLookups) {
+            [self loadDataSkippingRoundTripIfCached:[NSNumber numberWithBool:NO]];
+        } else {
+            [self syncAddedFriendIDs:addedIDs fields:fields removingFriendIDs:removedIDs];
+        }
+    }];
+    self.syncConnection = connection;
+    [connection start];
+}
+
+- (void)syncAddedFriendIDs:(NSArray *)addedIDs fields:(NSString *)fields removingFriendIDs:(NSSet *)removedIDs {
+    FBRequest *lookup = [[[FBRequest alloc] initWithSession:self.session
+                                                  graphPath:@""
+                                                 parameters:@{@"ids": [addedIDs componentsJoinedByString:@","],
+                                                              @"fields": fields ?: @"id"}
+                                                 HTTPMethod:nil]
+                         autorelease];
+
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:lookup completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        if (innerConnection != self.syncConnection) {
+            return;
+        }
+        self.syncConnection = nil;
+
+        if (error || ![result isKindOfClass:[NSDictionary class]]) {
+            [self loadDataSkippingRoundTripIfCached:[NSNumber numberWithBool:NO]];
+            return;
+        }
+        NSMutableArray *added = [NSMutableArray arrayWithCapacity:addedIDs.count];
+        for (NSString *friendID in addedIDs) {
+            id friend = [result objectForKey:friendID];
+            if ([friend isKindOfClass:[NSDictionary class]]) {
+                [added addObject:friend];
+            }
+        }
+        [self applyDeltaRemovingFriendIDs:removedIDs addingFriends:added];
+    }];
+    self.syncConnection = connection;
+    [connection start];
+}
+
+- (void)applyDeltaRemovingFriendIDs:(NSSet *)removedIDs addingFriends:(NSArray *)added {
+    if (removedIDs.count == 0 && added.count == 0) {
+        return;
     }
+
+    [self.dataSource removeGraphObjectsWithIDs:removedIDs];
+    if (added.count) {
+        [self.dataSource appendGraphObjects:added];
+    }
+    [self.dataSource updateWithCompletion:^{
+        [self.tableView reloadData];
+        // the merged list is what the next open shows first
+        if (self.snapshotURL) {
+            [self.dataSource writeSnapshotToCacheURL:self.snapshotURL];
+        }
+        if ([self.delegate respondsToSelector:@selector(friendPickerViewControllerDataDidChange:)]) {
+            [(id)self.delegate friendPickerViewControllerDataDidChange:self];
+        }
+    }];
+}
+
+// The access token puts the snapshot in the session's part of the disk cache, so it is
+// removed along with the session's cached pages.
+- (NSURL *)snapshotURLForRequest:(FBRequest *)request {
+    NSString *accessToken = self.session.accessTokenData.accessToken;
+    if (!accessToken) {
+        return nil;
+    }
+    NSDictionary *parameters = @{@"fields": [request.parameters objectForKey:@"fields"] ?: @"",
+                                 @"access_token": accessToken};
+    return [NSURL URLWithString:[NSString stringWithFormat:@"FBRequestCache://%@/snapshot/%@?%@",
+                                 FBFriendPickerCacheIdentity,
+                                 [FBUtility stringByURLEncodingString:request.graphPath],
+                                 [FBUtility stringBySerializingQueryParameters:parameters]]];
 }
 
 + (FBRequest *)requestWithUserID:(NSString *)userID
@@ -393,6 +601,14 @@ FBGraphObjectPagingLoaderDelegate>
     [self.spinner startAnimating];
 }
 
+- (void)cancelNetworkWorkForToken:(FBCancellationToken *)token {
+    // The loader feeds the data source, so it lets go first
+    [self.loader cancel];
+    self.loader.cancellationToken = self.cancellationToken;
+    [self.dataSource cancelPendingRequests];
+    self.dataSource.cancellationToken = self.cancellationToken;
+}
+
 - (void)logAppEvents:(BOOL)cancelled {
     [FBAppEvents logImplicitEvent:FBAppEventNameFriendPickerUsage
                        valueToSum:nil
@@ -502,6 +718,11 @@ FBGraphObjectPagingLoaderDelegate>
     // finished loading, stop animating
     [self.spinner stopAnimating];
 
+    if (!pagingLoader.isResultFromCache && self.snapshotURL) {
+        [self.dataSource writeSnapshotToCacheURL:self.snapshotURL];
+        [self recordFullSync];
+    }
+
     // Call the delegate from here as well, since this might be the first response of a query
     // that has no results.
     if ([self.delegate respondsToSelector:@selector(friendPickerViewControllerDataDidChange:)]) {
@@ -510,9 +731,15 @@ FBGraphObjectPagingLoaderDelegate>
 
     // if our current display is from cache, then kick-off a near-term refresh
     if (pagingLoader.isResultFromCache) {
-        [self performSelector:@selector(loadDataSkippingRoundTripIfCached:)
-                   withObject:[NSNumber numberWithBool:NO]
-                   afterDelay:FBRefreshCacheDelaySeconds];
+        if ([FBSettings isFriendListDeltaSyncEnabled]) {
+            [self performSelector:@selector(syncCachedFriends)
+                       withObject:nil
+                       afterDelay:FBRefreshCacheDelaySeconds];
+        } else {
+            [self performSelector:@selector(loadDataSkippingRoundTripIfCached:)
+                       withObject:[NSNumber numberWithBool:NO]
+                       afterDelay:FBRefreshCacheDelaySeconds];
+        }
     }
 }
 
@@ -36,6 +36,9 @@ FBSDK_EXTERN NSString *const FBLikeActionControllerAnimatedKey;
 @property (nonatomic, copy, readonly) NSString *socialSentence;
 
 - (void)refresh;
+// refreshes unless a refresh is running or finished recently; controls call this when they
+// appear on screen, so controllers only fetch state for what is actually shown
+- (void)controlDidBecomeVisible;
 - (void)toggleLikeWithSoundEnabled:(BOOL)soundEnabled;
 
 @end
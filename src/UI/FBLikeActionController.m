@@ -16,17 +16,26 @@
 
 #import "FBLikeActionController.h"
 
+#import <libkern/OSAtomic.h>
+
 #import <QuartzCore/QuartzCore.h>
 
+#import "FBAccessTokenData.h"
 #import "FBDataDiskCache.h"
 #import "FBDialogs+Internal.h"
 #import "FBDialogs.h"
+#import "FBDispatch.h"
 #import "FBLikeButtonPopWAV.h"
 #import "FBLikeDialogParams.h"
 #import "FBLogger.h"
+#import "FBMemoryBudget.h"
+#import "FBMetrics.h"
 #import "FBRequest+Internal.h"
 #import "FBRequest.h"
+#import "FBRequestConnection+Internal.h"
 #import "FBRequestConnection.h"
+#import "FBRequestTemplate.h"
+#import "FBSessionPool.h"
 
 #ifndef FB_BUILD_ONLY
 #define FB_BUILD_ONLY
@@ -47,14 +56,26 @@ static NSString *const kFBLikeControllerLikeKey = @"like";
 static NSString *const kFBLikeControllerRefreshKey = @"refresh";
 
 static NSString *const kFBLikeActionControllerGetObjectIDBatchKey = @"get-object-id";
-static NSString *const kFBLikeActionControllerObjectIDBatchResultKey = @"{result=get-object-id:$.id}";
 
 #define kFBLikeActionControllerAnimationDelay 0.5
 #define kFBLikeActionControllerAnimationDuration 0.2
 #define kFBLikeActionControllerSoundDelay 0.15
 
+// Refreshes requested within this long of each other share batches
+#define kFBLikeActionControllerRefreshDelay 0.1
+// The Graph API's batch limit, and the most requests a single refresh adds
+#define kFBLikeActionControllerMaximumBatchSize 50
+#define kFBLikeActionControllerRefreshRequestCount 3
+#define kFBLikeActionControllerRefreshesPerBatch (kFBLikeActionControllerMaximumBatchSize / kFBLikeActionControllerRefreshRequestCount)
+// A visible control doesn't refresh state that was fetched within this long
+#define kFBLikeActionControllerFreshnessInterval 300
+// Updates within this long of each other are persisted together
+#define kFBLikeActionControllerSerializationDelay 0.5
+// Rough size of a cached controller and its strings, for FBMemoryBudget
+#define kFBLikeActionControllerEstimatedCost 1024
+
 typedef NS_ENUM(NSUInteger, FBLikeActionControllerRefreshMode) {
-    FBLikeActionControllerRefreshModeInitial,
+    FBLikeActionControllerRefreshModeIfStale,
     FBLikeActionControllerRefreshModeForce,
 };
 
@@ -71,20 +92,44 @@ typedef void(^fb_like_action_block)(BOOL objectIsLiked,
                                     NSString *socialSentenceWithoutLike,
                                     NSString *unlikeToken);
 
-@interface FBLikeActionControllerCache : NSObject
-- (id)objectForKeyedSubscript:(id)key;
-- (void)setObject:(id)object forKeyedSubscript:(id)key;
+// Controllers hold one account's like state, so they are cached by account: its user ID
+// once known, otherwise its access token.  A session's address is no good as the key,
+// since a later session for another account can be allocated at a freed one's address.
+static NSString *FBLikeActionControllerCacheAccountKey(FBSession *session)
+{
+    FBAccessTokenData *tokenData = session.accessTokenData;
+    return tokenData.userID ?: tokenData.accessToken ?: @"";
+}
+
+// Controllers are cached per account, so that switching back to a session kept in the
+// FBSessionPool finds its controllers still warm.  Lookups only hold a spin lock long
+// enough to retain the dictionary of per-account NSCaches, which is replaced rather than
+// mutated, so they never wait out a store.
+// Controllers take requests to rebuild, so they are the last thing FBMemoryBudget sheds.
+@interface FBLikeActionControllerCache : NSObject <FBMemoryBudgetClient, NSCacheDelegate>
+- (id)objectForKey:(id)key session:(FBSession *)session;
+- (void)setObject:(id)object forKey:(id)key session:(FBSession *)session;
 @end
 
 @implementation FBLikeActionControllerCache
 {
-    NSCache *_cache;
+    // Read and replaced under _cachesByAccountLock
+    NSDictionary *_cachesByAccount;
+    OSSpinLock _cachesByAccountLock;
+    // The account keys each session has cached controllers under, so they can be dropped
+    // when it closes, by which time its token is gone.  Only touched while synchronized.
+    NSMutableDictionary *_accountKeysBySession;
+    // Controllers in all the caches, updated atomically
+    volatile int32_t _objectCount;
 }
 
 - (instancetype)init
 {
     if ((self = [super init])) {
-        _cache = [[NSCache alloc] init];
+        _cachesByAccount = [[NSDictionary alloc] init];
+        _cachesByAccountLock = OS_SPINLOCK_INIT;
+        _accountKeysBySession = [[NSMutableDictionary alloc] init];
+        [[FBMemoryBudget sharedBudget] registerClient:self priority:FBMemoryBudgetPriorityHigh];
 
         [[NSNotificationCenter defaultCenter] addObserver:self
                                                  selector:@selector(_activeSessionDidChangeWithNotification:)
@@ -108,29 +153,228 @@ typedef void(^fb_like_action_block)(BOOL objectIsLiked,
 
 - (void)dealloc
 {
+    [[FBMemoryBudget sharedBudget] unregisterClient:self];
     [[NSNotificationCenter defaultCenter] removeObserver:self];
-    [_cache release];
+    [_cachesByAccount release];
+    [_accountKeysBySession release];
     [super dealloc];
 }
 
-- (id)objectForKeyedSubscript:(id)key
+- (NSDictionary *)_cachesByAccount
 {
-    return [_cache objectForKey:key];
+    OSSpinLockLock(&_cachesByAccountLock);
+    NSDictionary *cachesByAccount = [_cachesByAccount retain];
+    OSSpinLockUnlock(&_cachesByAccountLock);
+    return [cachesByAccount autorelease];
 }
 
-- (void)setObject:(id)object forKeyedSubscript:(id)key
+- (id)objectForKey:(id)key session:(FBSession *)session
 {
-    [_cache setObject:object forKey:key];
+    NSDictionary *cachesByAccount = [self _cachesByAccount];
+    return [[[cachesByAccount[FBLikeActionControllerCacheAccountKey(session)] objectForKey:key] retain] autorelease];
+}
+
+- (void)setObject:(id)object forKey:(id)key session:(FBSession *)session
+{
+    NSString *accountKey = FBLikeActionControllerCacheAccountKey(session);
+    NSValue *sessionKey = [NSValue valueWithNonretainedObject:session];
+    @synchronized(self) {
+        NSMutableSet *accountKeys = _accountKeysBySession[sessionKey];
+        if (!accountKeys) {
+            accountKeys = [NSMutableSet set];
+            _accountKeysBySession[sessionKey] = accountKeys;
+        }
+        [accountKeys addObject:accountKey];
+
+        NSCache *cache = _cachesByAccount[accountKey];
+        if (!cache) {
+            cache = [[[NSCache alloc] init] autorelease];
+            cache.delegate = self;
+            NSMutableDictionary *cachesByAccount = [[_cachesByAccount mutableCopy] autorelease];
+            cachesByAccount[accountKey] = cache;
+            [self _publishCachesByAccount:cachesByAccount];
+        }
+        // Replacing doesn't tell the delegate, so remove first to keep the count right
+        [cache removeObjectForKey:key];
+        [cache setObject:object forKey:key];
+        OSAtomicIncrement32Barrier(&_objectCount);
+    }
+    [[FBMemoryBudget sharedBudget] clientDidGrow:self];
+}
+
+#pragma mark - FBMemoryBudgetClient
+
+- (NSUInteger)memoryBudgetCost
+{
+    return (NSUInteger)MAX(_objectCount, 0) * kFBLikeActionControllerEstimatedCost;
+}
+
+// NSCaches can only be emptied, not trimmed, so any shedding empties them all
+- (void)shedMemoryToCost:(NSUInteger)cost
+{
+    if (cost < self.memoryBudgetCost) {
+        NSDictionary *cachesByAccount = [self _cachesByAccount];
+        for (NSCache *cache in [cachesByAccount objectEnumerator]) {
+            [cache removeAllObjects];
+        }
+    }
+}
+
+#pragma mark - NSCacheDelegate
+
+- (void)cache:(NSCache *)cache willEvictObject:(id)obj
+{
+    OSAtomicDecrement32Barrier(&_objectCount);
+}
+
+// Must be called while synchronized on self, which is what lets stores read _cachesByAccount
+// without the spin lock.  Lookups have retained any dictionary they are still reading.
+- (void)_publishCachesByAccount:(NSDictionary *)cachesByAccount
+{
+    NSDictionary *published = [cachesByAccount copy];
+    OSSpinLockLock(&_cachesByAccountLock);
+    NSDictionary *retired = _cachesByAccount;
+    _cachesByAccount = published;
+    OSSpinLockUnlock(&_cachesByAccountLock);
+    [retired release];
 }
 
 - (void)_activeSessionDidChangeWithNotification:(NSNotification *)notification
 {
-    [_cache removeAllObjects];
+    // a session that is kept in the pool may become active again; anything else is
+    // not coming back, so drop what was cached for it
+    FBSession *session = notification.object;
+    if ([notification.name isEqualToString:FBSessionDidBecomeClosedActiveSessionNotification] ||
+        ([notification.name isEqualToString:FBSessionDidUnsetActiveSessionNotification] &&
+         ![[FBSessionPool sharedPool] containsSession:session])) {
+        @synchronized(self) {
+            NSValue *sessionKey = [NSValue valueWithNonretainedObject:session];
+            NSSet *accountKeys = [[_accountKeysBySession[sessionKey] retain] autorelease];
+            [_accountKeysBySession removeObjectForKey:sessionKey];
+            if (accountKeys.count) {
+                NSMutableDictionary *cachesByAccount = [[_cachesByAccount mutableCopy] autorelease];
+                for (NSString *accountKey in accountKeys) {
+                    // Emptied so its controllers are no longer counted
+                    [_cachesByAccount[accountKey] removeAllObjects];
+                    [cachesByAccount removeObjectForKey:accountKey];
+                }
+                [self _publishCachesByAccount:cachesByAccount];
+            }
+        }
+    }
     [[NSNotificationCenter defaultCenter] postNotificationName:FBLikeActionControllerDidResetNotification object:nil];
 }
 
 @end
 
+typedef void(^fb_like_action_controller_add_requests_block)(FBRequestConnection *connection, NSString *batchName);
+
+// Gathers the refreshes all controllers ask for within kFBLikeActionControllerRefreshDelay, and
+// sends them in as few batches as hold them, so a screen of like controls costs a request or two
+// rather than one per control.  Each refresh adds its requests through its block, naming any
+// request others depend on after batchName, which is unique within the connection.
+@interface FBLikeActionControllerRefreshCoordinator : NSObject
++ (instancetype)sharedCoordinator;
+- (void)addRefreshForSession:(FBSession *)session requestsBlock:(fb_like_action_controller_add_requests_block)block;
+@end
+
+@implementation FBLikeActionControllerRefreshCoordinator
+{
+    NSMutableArray *_pendingSessions;
+    NSMutableArray *_pendingBlocks;
+    BOOL _flushScheduled;
+}
+
++ (instancetype)sharedCoordinator
+{
+    static FBLikeActionControllerRefreshCoordinator *_sharedCoordinator = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _sharedCoordinator = [[FBLikeActionControllerRefreshCoordinator alloc] init];
+    });
+    return _sharedCoordinator;
+}
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        _pendingSessions = [[NSMutableArray alloc] init];
+        _pendingBlocks = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_pendingSessions release];
+    [_pendingBlocks release];
+    [super dealloc];
+}
+
+- (void)addRefreshForSession:(FBSession *)session requestsBlock:(fb_like_action_controller_add_requests_block)block
+{
+    BOOL flushNow = NO;
+    BOOL scheduleFlush = NO;
+    @synchronized(self) {
+        [_pendingSessions addObject:session];
+        [_pendingBlocks addObject:[[block copy] autorelease]];
+        if (_pendingBlocks.count >= kFBLikeActionControllerRefreshesPerBatch) {
+            flushNow = YES;
+        } else if (!_flushScheduled) {
+            _flushScheduled = YES;
+            scheduleFlush = YES;
+        }
+    }
+
+    if (flushNow) {
+        [self _flush];
+    } else if (scheduleFlush) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kFBLikeActionControllerRefreshDelay * NSEC_PER_SEC)),
+                       dispatch_get_main_queue(), ^{
+            [self _flush];
+        });
+    }
+}
+
+- (void)_flush
+{
+    NSArray *sessions = nil;
+    NSArray *blocks = nil;
+    @synchronized(self) {
+        sessions = [[_pendingSessions copy] autorelease];
+        blocks = [[_pendingBlocks copy] autorelease];
+        [_pendingSessions removeAllObjects];
+        [_pendingBlocks removeAllObjects];
+        _flushScheduled = NO;
+    }
+
+    // FBRequestConnection would shard a longer batch without regard to the batch names a
+    // refresh's requests refer to, so each connection is kept to one batch here
+    NSMutableIndexSet *remaining = [NSMutableIndexSet indexSetWithIndexesInRange:NSMakeRange(0, sessions.count)];
+    while (remaining.count) {
+        FBSession *session = sessions[remaining.firstIndex];
+        FBRequestConnection *connection = [[FBRequestConnection alloc] init];
+        connection.networkFeature = FBNetworkFeatureLike;
+        NSUInteger refreshCount = 0;
+        NSUInteger index = remaining.firstIndex;
+        while (index != NSNotFound && refreshCount < kFBLikeActionControllerRefreshesPerBatch) {
+            if (sessions[index] == session) {
+                fb_like_action_controller_add_requests_block block = blocks[index];
+                block(connection, [NSString stringWithFormat:@"%@-%lu",
+                                   kFBLikeActionControllerGetObjectIDBatchKey,
+                                   (unsigned long)refreshCount]);
+                refreshCount++;
+                [remaining removeIndex:index];
+            }
+            index = [remaining indexGreaterThanIndex:index];
+        }
+        [connection start];
+        [connection release];
+    }
+}
+
+@end
+
 @interface FBLikeActionController ()
 @property (nonatomic, assign, getter = isContentDiscarded) BOOL contentDiscarded;
 @property (nonatomic, assign) NSUInteger likeCountWithLike;
@@ -145,9 +389,13 @@ typedef void(^fb_like_action_block)(BOOL objectIsLiked,
 
 @implementation FBLikeActionController
 {
-    NSUInteger _contentAccessCount;
+    // Changed atomically, since cache hits begin access without a lock
+    volatile int32_t _contentAccessCount;
     FBSession *_session;
     FBLikeActionControllerRefreshState _state;
+    BOOL _stateUpdated;
+    NSTimeInterval _lastRefreshTime;
+    BOOL _serializationScheduled;
 }
 
 #pragma mark - Helper Functions
@@ -182,32 +430,26 @@ static BOOL _fbLikeActionControllerDisabled = NO;
     dispatch_once(&onceToken, ^{
         _cache = [[FBLikeActionControllerCache alloc] init];
     });
-    @synchronized(self) {
-        FBLikeActionController *controller = _cache[objectID];
-        FBSession *session = [FBSession activeSession];
-        BOOL controllerIsNew = NO;
-        if (!controller) {
-            NSData *cacheData = [[FBDataDiskCache sharedCache] dataForURL:FBLikeActionControllerCacheURL(objectID, session)];
-            if (cacheData) {
-                id object = [NSKeyedUnarchiver unarchiveObjectWithData:cacheData];
-                if ([object isKindOfClass:[self class]]) {
-                    controller = object;
-                    controllerIsNew = YES;
-                }
+    FBSession *session = [FBSession activeSession];
+    FBLikeActionController *controller = [_cache objectForKey:objectID session:session];
+    if (controller) {
+        [controller beginContentAccess];
+    } else {
+        // Misses are looked up again under the lock, so each object ID gets one controller.  Making
+        // one only starts its asynchronous disk read, so misses for different IDs barely wait here.
+        @synchronized(self) {
+            controller = [_cache objectForKey:objectID session:session];
+            if (controller) {
+                [controller beginContentAccess];
+            } else {
+                // the persisted state, if any, arrives shortly and is shown unless there is newer state by then
+                controller = [[[self alloc] initWithObjectID:objectID session:session] autorelease];
+                [controller _loadPersistedState];
+                [_cache setObject:controller forKey:objectID session:session];
             }
         }
-        if (!controller) {
-            controller = [[[self alloc] initWithObjectID:objectID session:session] autorelease];
-            controllerIsNew = YES;
-        }
-        if (controllerIsNew) {
-            _cache[objectID] = controller;
-        } else {
-            [controller beginContentAccess];
-        }
-        [controller _refreshWithMode:FBLikeActionControllerRefreshModeInitial];
-        return controller;
     }
+    return controller;
 }
 
 #pragma mark - Object Lifecycle
@@ -310,6 +552,11 @@ static const NSUInteger kFBLikeActionControllerCodingVersion = 1;
     [self _refreshWithMode:FBLikeActionControllerRefreshModeForce];
 }
 
+- (void)controlDidBecomeVisible
+{
+    [self _refreshWithMode:FBLikeActionControllerRefreshModeIfStale];
+}
+
 - (void)toggleLikeWithSoundEnabled:(BOOL)soundEnabled
 {
     [self _setExecuting:YES forKey:kFBLikeControllerLikeKey];
@@ -350,13 +597,13 @@ static const NSUInteger kFBLikeActionControllerCodingVersion = 1;
 - (BOOL)beginContentAccess
 {
     self.contentDiscarded = NO;
-    _contentAccessCount++;
+    OSAtomicIncrement32Barrier(&_contentAccessCount);
     return YES;
 }
 
 - (void)endContentAccess
 {
-    _contentAccessCount--;
+    OSAtomicDecrement32Barrier(&_contentAccessCount);
 }
 
 - (void)discardContentIfPossible
@@ -382,13 +629,17 @@ static void FBLikeActionControllerAddGetEngagementRequest(FBSession *session,
                                                           NSString *objectID,
                                                           fb_like_action_controller_get_engagement_completion_block completionHandler)
 {
-    FBRequest *request = [[FBRequest alloc] initWithSession:session
-                                                  graphPath:objectID
-                                                 parameters:@{
-                                                              @"fields": @"engagement.fields(count,social_sentence_with_like,social_sentence_without_like)",
-                                                              @"force_framework": @"ent",
-                                                              }
-                                                 HTTPMethod:@"GET"];
+    static FBRequestTemplate *requestTemplate = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        requestTemplate = [[FBRequestTemplate alloc] initWithGraphPath:@"%@"
+                                                            parameters:@{
+                                                                         @"fields": @"engagement.fields(count,social_sentence_with_like,social_sentence_without_like)",
+                                                                         @"force_framework": @"ent",
+                                                                         }
+                                                            HTTPMethod:@"GET"];
+    });
+    FBRequest *request = [requestTemplate requestWithSession:session pathArgument:objectID parameters:nil];
     [connection addRequest:request completionHandler:^(FBRequestConnection *connection, id result, NSError *error) {
         BOOL success = NO;
         NSUInteger likeCount = 0;
@@ -407,7 +658,6 @@ static void FBLikeActionControllerAddGetEngagementRequest(FBSession *session,
             completionHandler(success, likeCount, socialSentenceWithLike, socialSentenceWithoutLike);
         }
     }];
-    [request release];
 }
 
 typedef void(^fb_like_action_controller_get_object_id_completion_block)(BOOL success,
@@ -416,6 +666,7 @@ typedef void(^fb_like_action_controller_get_object_id_completion_block)(BOOL suc
 static void FBLikeActionControllerAddGetObjectIDRequest(FBSession *session,
                                                         FBRequestConnection *connection,
                                                         NSString *objectID,
+                                                        NSString *batchName,
                                                         fb_like_action_controller_get_object_id_completion_block completionHandler)
 {
     FBRequest *request = [[FBRequest alloc] initWithSession:session
@@ -443,7 +694,7 @@ static void FBLikeActionControllerAddGetObjectIDRequest(FBSession *session,
             completionHandler(success, objectID, objectIsPage);
         }
     } batchParameters:@{
-                        @"name": kFBLikeActionControllerGetObjectIDBatchKey,
+                        @"name": batchName,
                         @"omit_response_on_success": @NO,
                         }];
     [request release];
@@ -457,13 +708,16 @@ static void FBLikeActionControllerAddGetOGObjectLikeRequest(FBSession *session,
                                                             NSString *objectID,
                                                             fb_like_action_controller_get_og_object_like_completion_block completionHandler)
 {
-    FBRequest *request = [[FBRequest alloc] initWithSession:session
-                                                  graphPath:@"me/og.likes"
-                                                 parameters:@{
-                                                              @"fields": @"id,application",
-                                                              @"object": objectID,
-                                                              }
-                                                 HTTPMethod:@"GET"];
+    static FBRequestTemplate *requestTemplate = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        requestTemplate = [[FBRequestTemplate alloc] initWithGraphPath:@"me/og.likes"
+                                                            parameters:@{ @"fields": @"id,application" }
+                                                            HTTPMethod:@"GET"];
+    });
+    FBRequest *request = [requestTemplate requestWithSession:session
+                                                pathArgument:nil
+                                                  parameters:@{ @"object": objectID }];
     [connection addRequest:request completionHandler:^(FBRequestConnection *connection, id result, NSError *error) {
         BOOL success = NO;
         BOOL objectIsLiked = NO;
@@ -487,7 +741,6 @@ static void FBLikeActionControllerAddGetOGObjectLikeRequest(FBSession *session,
             completionHandler(success, objectIsLiked, unlikeToken);
         }
     }];
-    [request release];
 }
 
 typedef void(^fb_like_action_controller_publish_like_completion_block)(BOOL success);
@@ -595,16 +848,21 @@ static void FBLikeActionControllerAddRefreshRequests(FBSession *session,
 }
 
 - (NSString *)_ensureVerifiedObjectIDWithConnection:(FBRequestConnection *)connection
+{
+    return [self _ensureVerifiedObjectIDWithConnection:connection batchName:kFBLikeActionControllerGetObjectIDBatchKey];
+}
+
+- (NSString *)_ensureVerifiedObjectIDWithConnection:(FBRequestConnection *)connection batchName:(NSString *)batchName
 {
     NSString *objectID = self.verifiedObjectID;
     if (!objectID) {
-        FBLikeActionControllerAddGetObjectIDRequest(_session, connection, self.objectID, ^(BOOL success,
-                                                                                           NSString *verifiedObjectID,
-                                                                                           BOOL objectIsPage) {
+        FBLikeActionControllerAddGetObjectIDRequest(_session, connection, self.objectID, batchName, ^(BOOL success,
+                                                                                                      NSString *verifiedObjectID,
+                                                                                                      BOOL objectIsPage) {
             self.verifiedObjectID = verifiedObjectID;
             self.objectIsPage = objectIsPage;
         });
-        objectID = kFBLikeActionControllerObjectIDBatchResultKey;
+        objectID = [NSString stringWithFormat:@"{result=%@:$.id}", batchName];
     }
     return objectID;
 }
@@ -667,6 +925,7 @@ static void FBLikeActionControllerAddRefreshRequests(FBSession *session,
                     self.unlikeToken);
     }
     FBRequestConnection *connection = [[FBRequestConnection alloc] init];
+    connection.networkFeature = FBNetworkFeatureLike;
     NSString *objectID = [self _ensureVerifiedObjectIDWithConnection:connection];
     FBLikeActionControllerAddPublishLikeRequest(_session, connection, objectID, NULL);
     FBLikeActionControllerAddRefreshRequests(_session,
@@ -706,6 +965,7 @@ static void FBLikeActionControllerAddRefreshRequests(FBSession *session,
     }
 
     FBRequestConnection *connection = [[FBRequestConnection alloc] init];
+    connection.networkFeature = FBNetworkFeatureLike;
     NSString *objectID = [self _ensureVerifiedObjectIDWithConnection:connection];
     FBLikeActionControllerAddPublishUnlikeRequest(_session, connection, self.unlikeToken, NULL);
     FBLikeActionControllerAddRefreshRequests(_session,
@@ -742,9 +1002,11 @@ static void FBLikeActionControllerAddRefreshRequests(FBSession *session,
             }
             break;
         }
-        case FBLikeActionControllerRefreshModeInitial:{
-            // if we've already started any refresh, skip this
-            if (_state != FBLikeActionControllerRefreshStateNone) {
+        case FBLikeActionControllerRefreshModeIfStale:{
+            // skip if a refresh is running or recently finished
+            if (_state == FBLikeActionControllerRefreshStateActive ||
+                (_state == FBLikeActionControllerRefreshStateComplete &&
+                 [NSDate timeIntervalSinceReferenceDate] - _lastRefreshTime < kFBLikeActionControllerFreshnessInterval)) {
                 return;
             }
             break;
@@ -759,37 +1021,170 @@ static void FBLikeActionControllerAddRefreshRequests(FBSession *session,
     [self _setExecuting:YES forKey:kFBLikeControllerRefreshKey];
     _state = FBLikeActionControllerRefreshStateActive;
 
-    FBRequestConnection *connection = [[FBRequestConnection alloc] init];
-    NSString *objectID = [self _ensureVerifiedObjectIDWithConnection:connection];
-    FBLikeActionControllerAddRefreshRequests(_session,
-                                             connection,
-                                             objectID,
-                                             ^(BOOL objectIsLiked,
-                                               NSUInteger likeCountWithLike,
-                                               NSUInteger likeCountWithoutLike,
-                                               NSString *socialSentenceWithLike,
-                                               NSString *socialSentenceWithoutLike,
-                                               NSString *unlikeToken) {
-        [self _updateWithObjectIsLiked:objectIsLiked
-                     likeCountWithLike:likeCountWithLike
-                  likeCountWithoutLike:likeCountWithoutLike
-                socialSentenceWithLike:socialSentenceWithLike
-             socialSentenceWithoutLike:socialSentenceWithoutLike
-                           unlikeToken:unlikeToken
-                          soundEnabled:NO
-                              animated:NO
-                              deferred:NO];
-        [self _setExecuting:NO forKey:kFBLikeControllerRefreshKey];
-        _state = FBLikeActionControllerRefreshStateComplete;
-    });
-    [connection start];
-    [connection release];
+    // the coordinator keeps the block, and so self, until the requests are added
+    [[FBLikeActionControllerRefreshCoordinator sharedCoordinator] addRefreshForSession:_session
+                                                                         requestsBlock:^(FBRequestConnection *connection,
+                                                                                         NSString *batchName) {
+        NSString *objectID = [self _ensureVerifiedObjectIDWithConnection:connection batchName:batchName];
+        FBLikeActionControllerAddRefreshRequests(_session,
+                                                 connection,
+                                                 objectID,
+                                                 ^(BOOL objectIsLiked,
+                                                   NSUInteger likeCountWithLike,
+                                                   NSUInteger likeCountWithoutLike,
+                                                   NSString *socialSentenceWithLike,
+                                                   NSString *socialSentenceWithoutLike,
+                                                   NSString *unlikeToken) {
+            [self _updateWithObjectIsLiked:objectIsLiked
+                         likeCountWithLike:likeCountWithLike
+                      likeCountWithoutLike:likeCountWithoutLike
+                    socialSentenceWithLike:socialSentenceWithLike
+                 socialSentenceWithoutLike:socialSentenceWithoutLike
+                               unlikeToken:unlikeToken
+                              soundEnabled:NO
+                                  animated:NO
+                                  deferred:NO];
+            [self _setExecuting:NO forKey:kFBLikeControllerRefreshKey];
+            _state = FBLikeActionControllerRefreshStateComplete;
+            _lastRefreshTime = [NSDate timeIntervalSinceReferenceDate];
+        });
+    }];
+}
+
+// The like state is persisted as a fixed header followed by the object ID, both social
+// sentences and the unlike token, each as a 32 bit length and its UTF-8 bytes, or just
+// kFBLikeActionControllerRecordNilLength for nil.  Integers are little endian.
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t objectIsLiked;
+    uint16_t reserved;
+    uint64_t likeCountWithLike;
+    uint64_t likeCountWithoutLike;
+} FBLikeActionControllerRecordHeader;
+
+static const uint32_t kFBLikeActionControllerRecordMagic = 0x4B4C4246; // "FBLK" as stored
+static const uint8_t kFBLikeActionControllerRecordVersion = 1;
+static const uint32_t kFBLikeActionControllerRecordNilLength = UINT32_MAX;
+
+static void FBLikeActionControllerRecordAppendString(NSMutableData *record, NSString *string)
+{
+    NSData *bytes = [string dataUsingEncoding:NSUTF8StringEncoding];
+    uint32_t length = OSSwapHostToLittleInt32(bytes ? (uint32_t)bytes.length : kFBLikeActionControllerRecordNilLength);
+    [record appendBytes:&length length:sizeof(length)];
+    [record appendData:bytes];
+}
+
+// Reads the string at *offset and moves past it; returns NO if the record is cut short
+static BOOL FBLikeActionControllerRecordReadString(NSData *record, NSUInteger *offset, NSString **string)
+{
+    uint32_t length = 0;
+    if (*offset > record.length || sizeof(length) > record.length - *offset) {
+        return NO;
+    }
+    [record getBytes:&length range:NSMakeRange(*offset, sizeof(length))];
+    length = OSSwapLittleToHostInt32(length);
+    *offset += sizeof(length);
+    if (length == kFBLikeActionControllerRecordNilLength) {
+        *string = nil;
+        return YES;
+    }
+    if (length > record.length - *offset) {
+        return NO;
+    }
+    *string = [[[NSString alloc] initWithBytes:(const char *)record.bytes + *offset
+                                        length:length
+                                      encoding:NSUTF8StringEncoding] autorelease];
+    *offset += length;
+    return (*string != nil);
+}
+
+- (NSData *)_record
+{
+    FBLikeActionControllerRecordHeader header = {
+        .magic = OSSwapHostToLittleInt32(kFBLikeActionControllerRecordMagic),
+        .version = kFBLikeActionControllerRecordVersion,
+        .objectIsLiked = (self.objectIsLiked ? 1 : 0),
+        .reserved = 0,
+        .likeCountWithLike = OSSwapHostToLittleInt64(self.likeCountWithLike),
+        .likeCountWithoutLike = OSSwapHostToLittleInt64(self.likeCountWithoutLike),
+    };
+    NSMutableData *record = [NSMutableData dataWithBytes:&header length:sizeof(header)];
+    FBLikeActionControllerRecordAppendString(record, _objectID);
+    FBLikeActionControllerRecordAppendString(record, self.socialSentenceWithLike);
+    FBLikeActionControllerRecordAppendString(record, self.socialSentenceWithoutLike);
+    FBLikeActionControllerRecordAppendString(record, self.unlikeToken);
+    return record;
+}
+
+- (BOOL)_applyRecord:(NSData *)record
+{
+    FBLikeActionControllerRecordHeader header;
+    if (record.length < sizeof(header)) {
+        return NO;
+    }
+    [record getBytes:&header length:sizeof(header)];
+    if (OSSwapLittleToHostInt32(header.magic) != kFBLikeActionControllerRecordMagic ||
+        header.version != kFBLikeActionControllerRecordVersion) {
+        return NO;
+    }
+
+    NSUInteger offset = sizeof(header);
+    NSString *objectID = nil;
+    NSString *socialSentenceWithLike = nil;
+    NSString *socialSentenceWithoutLike = nil;
+    NSString *unlikeToken = nil;
+    if (!FBLikeActionControllerRecordReadString(record, &offset, &objectID) ||
+        !FBLikeActionControllerRecordReadString(record, &offset, &socialSentenceWithLike) ||
+        !FBLikeActionControllerRecordReadString(record, &offset, &socialSentenceWithoutLike) ||
+        !FBLikeActionControllerRecordReadString(record, &offset, &unlikeToken) ||
+        ![objectID isEqualToString:_objectID]) {
+        return NO;
+    }
+
+    self.objectIsLiked = (header.objectIsLiked != 0);
+    self.likeCountWithLike = (NSUInteger)OSSwapLittleToHostInt64(header.likeCountWithLike);
+    self.likeCountWithoutLike = (NSUInteger)OSSwapLittleToHostInt64(header.likeCountWithoutLike);
+    self.socialSentenceWithLike = socialSentenceWithLike;
+    self.socialSentenceWithoutLike = socialSentenceWithoutLike;
+    self.unlikeToken = unlikeToken;
+    return YES;
+}
+
+- (void)_loadPersistedState
+{
+    NSURL *cacheURL = FBLikeActionControllerCacheURL(_objectID, _session);
+    [[FBDataDiskCache sharedCache] dataForURL:cacheURL completion:^(NSData *data) {
+        // whatever the refresh or the user did meanwhile is newer
+        if (!data || _stateUpdated) {
+            return;
+        }
+        if ([self _applyRecord:data]) {
+            [[NSNotificationCenter defaultCenter] postNotificationName:FBLikeActionControllerDidUpdateNotification
+                                                                object:self
+                                                              userInfo:@{FBLikeActionControllerAnimatedKey: @NO}];
+        } else {
+            [[FBDataDiskCache sharedCache] removeDataForUrl:cacheURL];
+        }
+    }];
 }
 
 - (void)_serialize
 {
-    NSData *cacheData = [NSKeyedArchiver archivedDataWithRootObject:self];
-    [[FBDataDiskCache sharedCache] setData:cacheData forURL:FBLikeActionControllerCacheURL(_objectID, _session)];
+    // updates come in bursts (optimistic, then confirmed), so only the last of them is written
+    if (_serializationScheduled) {
+        return;
+    }
+    _serializationScheduled = YES;
+    dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kFBLikeActionControllerSerializationDelay * NSEC_PER_SEC));
+    dispatch_after(popTime, dispatch_get_main_queue(), ^{
+        _serializationScheduled = NO;
+        NSData *record = [self _record];
+        NSURL *cacheURL = FBLikeActionControllerCacheURL(_objectID, _session);
+        dispatch_async(FBDispatchGetGlobalQueue(FBDispatchLaneBackground), ^{
+            [[FBDataDiskCache sharedCache] setData:record forURL:cacheURL];
+        });
+    });
 }
 
 - (void)_setExecuting:(BOOL)executing forKey:(NSString *)key
@@ -850,6 +1245,7 @@ static void FBLikeActionControllerAddRefreshRequests(FBSession *session,
         self.socialSentenceWithLike = socialSentenceWithLike;
         self.socialSentenceWithoutLike = socialSentenceWithoutLike;
         self.unlikeToken = unlikeToken;
+        _stateUpdated = YES;
 
         FBLikeButtonPopWAV *likeSound = (objectIsLikedChanged && objectIsLiked && soundEnabled ? [FBLikeButtonPopWAV sharedLoader] : nil);
 
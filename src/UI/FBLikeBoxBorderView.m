@@ -24,6 +24,277 @@
 #define FBLikeBoxBorderCaretPadding 3.0
 #define FBLikeBoxBorderContentPadding 4.0
 
+#pragma mark - Helper Functions
+
+static BOOL FBLikeBoxBorderCaretIsHorizontal(FBLikeBoxCaretPosition caretPosition)
+{
+    return (caretPosition == FBLikeBoxCaretPositionTop || caretPosition == FBLikeBoxCaretPositionBottom);
+}
+
+static UIEdgeInsets FBLikeBoxBorderInsets(FBLikeBoxCaretPosition caretPosition, CGFloat borderWidth, CGFloat scale)
+{
+    // inset the border bounds by 1/2 of the border width, since it is drawn split between inside and outside of the path
+    CGFloat halfBorderWidth = FBPointsForScreenPixels(ceilf, scale, borderWidth / 2);
+    UIEdgeInsets borderInsets = UIEdgeInsetsMake(halfBorderWidth, halfBorderWidth, halfBorderWidth, halfBorderWidth);
+
+    // adjust the insets for the caret position
+    switch (caretPosition) {
+        case FBLikeBoxCaretPositionTop:{
+            borderInsets.top += FBLikeBoxBorderCaretHeight + FBLikeBoxBorderCaretPadding;
+            break;
+        }
+        case FBLikeBoxCaretPositionLeft:{
+            borderInsets.left += FBLikeBoxBorderCaretHeight + FBLikeBoxBorderCaretPadding;
+            break;
+        }
+        case FBLikeBoxCaretPositionBottom:{
+            borderInsets.bottom += FBLikeBoxBorderCaretHeight + FBLikeBoxBorderCaretPadding;
+            break;
+        }
+        case FBLikeBoxCaretPositionRight:{
+            borderInsets.right += FBLikeBoxBorderCaretHeight + FBLikeBoxBorderCaretPadding;
+            break;
+        }
+    }
+
+    return borderInsets;
+}
+
+static void FBLikeBoxBorderDraw(CGContextRef context,
+                                CGRect bounds,
+                                UIEdgeInsets borderInsets,
+                                FBLikeBoxCaretPosition caretPosition,
+                                CGFloat borderWidth,
+                                CGFloat borderCornerRadius,
+                                CGFloat contentScaleFactor,
+                                UIColor *backgroundColor,
+                                UIColor *fillColor,
+                                UIColor *foregroundColor)
+{
+    CGContextSaveGState(context);
+
+    // fill the background
+    if (backgroundColor) {
+        [backgroundColor setFill];
+        CGContextFillRect(context, bounds);
+    }
+
+    // configure the colors and lines
+    [fillColor setFill];
+    [foregroundColor setStroke];
+    CGContextSetLineJoin(context, kCGLineJoinRound);
+    CGContextSetLineWidth(context, borderWidth);
+
+    // get the frame of the box
+    CGRect borderFrame = UIEdgeInsetsInsetRect(bounds, borderInsets);
+
+    // define the arcs for the corners
+    const int start = 0;
+    const int tangent = 1;
+    const int end = 2;
+    CGPoint topLeftArc[3] = {
+        CGPointMake(CGRectGetMinX(borderFrame) + borderCornerRadius, CGRectGetMinY(borderFrame)),
+        CGPointMake(CGRectGetMinX(borderFrame), CGRectGetMinY(borderFrame)),
+        CGPointMake(CGRectGetMinX(borderFrame), CGRectGetMinY(borderFrame) + borderCornerRadius),
+    };
+    CGPoint bottomLeftArc[3] = {
+        CGPointMake(CGRectGetMinX(borderFrame), CGRectGetMaxY(borderFrame) - borderCornerRadius),
+        CGPointMake(CGRectGetMinX(borderFrame), CGRectGetMaxY(borderFrame)),
+        CGPointMake(CGRectGetMinX(borderFrame) + borderCornerRadius, CGRectGetMaxY(borderFrame)),
+    };
+    CGPoint bottomRightArc[3] = {
+        CGPointMake(CGRectGetMaxX(borderFrame) - borderCornerRadius, CGRectGetMaxY(borderFrame)),
+        CGPointMake(CGRectGetMaxX(borderFrame), CGRectGetMaxY(borderFrame)),
+        CGPointMake(CGRectGetMaxX(borderFrame), CGRectGetMaxY(borderFrame) - borderCornerRadius),
+    };
+    CGPoint topRightArc[3] = {
+        CGPointMake(CGRectGetMaxX(borderFrame), CGRectGetMinY(borderFrame) + borderCornerRadius),
+        CGPointMake(CGRectGetMaxX(borderFrame), CGRectGetMinY(borderFrame)),
+        CGPointMake(CGRectGetMaxX(borderFrame) - borderCornerRadius, CGRectGetMinY(borderFrame)),
+    };
+
+    // start a path on the context
+    CGContextBeginPath(context);
+
+    // position the caret and decide which lines to draw
+    CGPoint caretPoints[3];
+    switch (caretPosition) {
+        case FBLikeBoxCaretPositionTop:
+            CGContextMoveToPoint(context, topRightArc[end].x, topRightArc[end].y);
+            caretPoints[0] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame) + (FBLikeBoxBorderCaretWidth / 2)),
+                                         CGRectGetMinY(borderFrame));
+            caretPoints[1] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame)),
+                                         CGRectGetMinY(borderFrame) - FBLikeBoxBorderCaretHeight);
+            caretPoints[2] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame) - (FBLikeBoxBorderCaretWidth / 2)),
+                                         CGRectGetMinY(borderFrame));
+            CGContextAddLines(context, caretPoints, sizeof(caretPoints) / sizeof(caretPoints[0]));
+            CGContextAddArcToPoint(context, topLeftArc[tangent].x, topLeftArc[tangent].y, topLeftArc[end].x, topLeftArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, bottomLeftArc[start].x, bottomLeftArc[start].y);
+            CGContextAddArcToPoint(context, bottomLeftArc[tangent].x, bottomLeftArc[tangent].y, bottomLeftArc[end].x, bottomLeftArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, bottomRightArc[start].x, bottomRightArc[start].y);
+            CGContextAddArcToPoint(context, bottomRightArc[tangent].x, bottomRightArc[tangent].y, bottomRightArc[end].x, bottomRightArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, topRightArc[start].x, topRightArc[start].y);
+            CGContextAddArcToPoint(context, topRightArc[tangent].x, topRightArc[tangent].y, topRightArc[end].x, topRightArc[end].y, borderCornerRadius);
+            break;
+        case FBLikeBoxCaretPositionLeft:
+            CGContextMoveToPoint(context, topLeftArc[end].x, topLeftArc[end].y);
+            caretPoints[0] = CGPointMake(CGRectGetMinX(borderFrame),
+                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame) - (FBLikeBoxBorderCaretWidth / 2)));
+            caretPoints[1] = CGPointMake(CGRectGetMinX(borderFrame) - FBLikeBoxBorderCaretHeight,
+                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame)));
+            caretPoints[2] = CGPointMake(CGRectGetMinX(borderFrame),
+                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame) + (FBLikeBoxBorderCaretWidth / 2)));
+            CGContextAddLines(context, caretPoints, sizeof(caretPoints) / sizeof(caretPoints[0]));
+            CGContextAddArcToPoint(context, bottomLeftArc[tangent].x, bottomLeftArc[tangent].y, bottomLeftArc[end].x, bottomLeftArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, bottomRightArc[start].x, bottomRightArc[start].y);
+            CGContextAddArcToPoint(context, bottomRightArc[tangent].x, bottomRightArc[tangent].y, bottomRightArc[end].x, bottomRightArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, topRightArc[start].x, topRightArc[start].y);
+            CGContextAddArcToPoint(context, topRightArc[tangent].x, topRightArc[tangent].y, topRightArc[end].x, topRightArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, topLeftArc[start].x, topLeftArc[start].y);
+            CGContextAddArcToPoint(context, topLeftArc[tangent].x, topLeftArc[tangent].y, topLeftArc[end].x, topLeftArc[end].y, borderCornerRadius);
+            break;
+        case FBLikeBoxCaretPositionBottom:
+            CGContextMoveToPoint(context, bottomLeftArc[end].x, bottomLeftArc[end].y);
+            caretPoints[0] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame) - (FBLikeBoxBorderCaretWidth / 2)),
+                                         CGRectGetMaxY(borderFrame));
+            caretPoints[1] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame)),
+                                         CGRectGetMaxY(borderFrame) + FBLikeBoxBorderCaretHeight);
+            caretPoints[2] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame) + (FBLikeBoxBorderCaretWidth / 2)),
+                                         CGRectGetMaxY(borderFrame));
+            CGContextAddLines(context, caretPoints, sizeof(caretPoints) / sizeof(caretPoints[0]));
+            CGContextAddArcToPoint(context, bottomRightArc[tangent].x, bottomRightArc[tangent].y, bottomRightArc[end].x, bottomRightArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, topRightArc[start].x, topRightArc[start].y);
+            CGContextAddArcToPoint(context, topRightArc[tangent].x, topRightArc[tangent].y, topRightArc[end].x, topRightArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, topLeftArc[start].x, topLeftArc[start].y);
+            CGContextAddArcToPoint(context, topLeftArc[tangent].x, topLeftArc[tangent].y, topLeftArc[end].x, topLeftArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, bottomLeftArc[start].x, bottomLeftArc[start].y);
+            CGContextAddArcToPoint(context, bottomLeftArc[tangent].x, bottomLeftArc[tangent].y, bottomLeftArc[end].x, bottomLeftArc[end].y, borderCornerRadius);
+            break;
+        case FBLikeBoxCaretPositionRight:
+            CGContextMoveToPoint(context, bottomRightArc[end].x, bottomRightArc[end].y);
+            caretPoints[0] = CGPointMake(CGRectGetMaxX(borderFrame),
+                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame) + (FBLikeBoxBorderCaretWidth / 2)));
+            caretPoints[1] = CGPointMake(CGRectGetMaxX(borderFrame) + FBLikeBoxBorderCaretHeight,
+                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame)));
+            caretPoints[2] = CGPointMake(CGRectGetMaxX(borderFrame),
+                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame) - (FBLikeBoxBorderCaretWidth / 2)));
+            CGContextAddLines(context, caretPoints, sizeof(caretPoints) / sizeof(caretPoints[0]));
+            CGContextAddArcToPoint(context, topRightArc[tangent].x, topRightArc[tangent].y, topRightArc[end].x, topRightArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, topLeftArc[start].x, topLeftArc[start].y);
+            CGContextAddArcToPoint(context, topLeftArc[tangent].x, topLeftArc[tangent].y, topLeftArc[end].x, topLeftArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, bottomLeftArc[start].x, bottomLeftArc[start].y);
+            CGContextAddArcToPoint(context, bottomLeftArc[tangent].x, bottomLeftArc[tangent].y, bottomLeftArc[end].x, bottomLeftArc[end].y, borderCornerRadius);
+            CGContextAddLineToPoint(context, bottomRightArc[start].x, bottomRightArc[start].y);
+            CGContextAddArcToPoint(context, bottomRightArc[tangent].x, bottomRightArc[tangent].y, bottomRightArc[end].x, bottomRightArc[end].y, borderCornerRadius);
+            break;
+    }
+
+    // close and draw now that we have it all
+    CGContextClosePath(context);
+    CGContextDrawPath(context, kCGPathFillStroke);
+
+    CGContextRestoreGState(context);
+}
+
+static BOOL FBLikeBoxBorderPieceFits(UIImage *piece, CGSize size)
+{
+    UIEdgeInsets capInsets = piece.capInsets;
+    return (size.width >= capInsets.left + capInsets.right && size.height >= capInsets.top + capInsets.bottom);
+}
+
+// Returns the border as two stretchable pieces that meet where the caret is centered: left and right
+// of a caret on the top or bottom, above and below one on the left or right.  Each piece stretches
+// between its corners and its half of the caret.  Like boxes with the same style share the pieces.
+static NSArray *FBLikeBoxBorderChromePieces(FBLikeBoxCaretPosition caretPosition,
+                                            CGFloat borderWidth,
+                                            CGFloat borderCornerRadius,
+                                            CGFloat scale,
+                                            UIColor *backgroundColor,
+                                            UIColor *fillColor,
+                                            UIColor *foregroundColor)
+{
+    static NSCache *_cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _cache = [[NSCache alloc] init];
+    });
+
+    NSString *key = [NSString stringWithFormat:@"%lu|%f|%f|%f|%@|%@|%@",
+                     (unsigned long)caretPosition,
+                     borderWidth,
+                     borderCornerRadius,
+                     scale,
+                     backgroundColor,
+                     fillColor,
+                     foregroundColor];
+    NSArray *pieces = [_cache objectForKey:key];
+    if (pieces) {
+        return pieces;
+    }
+
+    // the smallest box with the corners, the caret, and a point to stretch on either side of it
+    UIEdgeInsets borderInsets = FBLikeBoxBorderInsets(caretPosition, borderWidth, scale);
+    CGFloat cornerLength = FBPointsForScreenPixels(ceilf, scale, borderCornerRadius + borderWidth);
+    CGFloat caretLength = FBPointsForScreenPixels(ceilf, scale, (FBLikeBoxBorderCaretWidth / 2) + borderWidth);
+    CGFloat splitLength = cornerLength + 1 + caretLength;
+    BOOL splitsWidth = FBLikeBoxBorderCaretIsHorizontal(caretPosition);
+    CGSize borderSize = (splitsWidth ?
+                         CGSizeMake(2 * splitLength, 2 * cornerLength + 1) :
+                         CGSizeMake(2 * cornerLength + 1, 2 * splitLength));
+    CGRect bounds = CGRectMake(0, 0, borderSize.width, borderSize.height);
+    bounds.size = FBEdgeInsetsOutsetSize(borderSize, borderInsets);
+
+    UIGraphicsBeginImageContextWithOptions(bounds.size, NO, scale);
+    FBLikeBoxBorderDraw(UIGraphicsGetCurrentContext(),
+                        bounds,
+                        borderInsets,
+                        caretPosition,
+                        borderWidth,
+                        borderCornerRadius,
+                        scale,
+                        backgroundColor,
+                        fillColor,
+                        foregroundColor);
+    CGImageRef image = CGBitmapContextCreateImage(UIGraphicsGetCurrentContext());
+    UIGraphicsEndImageContext();
+
+    CGRect firstFrame;
+    CGRect secondFrame;
+    CGFloat split = (splitsWidth ? borderInsets.left : borderInsets.top) + splitLength;
+    CGRectDivide(bounds, &firstFrame, &secondFrame, split, (splitsWidth ? CGRectMinXEdge : CGRectMinYEdge));
+    UIEdgeInsets firstCapInsets = UIEdgeInsetsMake(borderInsets.top + cornerLength,
+                                                   borderInsets.left + cornerLength,
+                                                   borderInsets.bottom + cornerLength,
+                                                   borderInsets.right + cornerLength);
+    UIEdgeInsets secondCapInsets = firstCapInsets;
+    if (splitsWidth) {
+        firstCapInsets.right = caretLength;
+        secondCapInsets.left = caretLength;
+    } else {
+        firstCapInsets.bottom = caretLength;
+        secondCapInsets.top = caretLength;
+    }
+
+    NSMutableArray *newPieces = [NSMutableArray arrayWithCapacity:2];
+    CGRect frames[2] = {firstFrame, secondFrame};
+    UIEdgeInsets capInsets[2] = {firstCapInsets, secondCapInsets};
+    for (int i = 0; i < 2; i++) {
+        CGRect pixelFrame = CGRectMake(frames[i].origin.x * scale,
+                                       frames[i].origin.y * scale,
+                                       frames[i].size.width * scale,
+                                       frames[i].size.height * scale);
+        CGImageRef pieceImage = CGImageCreateWithImageInRect(image, pixelFrame);
+        UIImage *piece = [UIImage imageWithCGImage:pieceImage scale:scale orientation:UIImageOrientationUp];
+        [newPieces addObject:[piece resizableImageWithCapInsets:capInsets[i] resizingMode:UIImageResizingModeStretch]];
+        CGImageRelease(pieceImage);
+    }
+    CGImageRelease(image);
+
+    pieces = [[newPieces copy] autorelease];
+    [_cache setObject:pieces forKey:key];
+    return pieces;
+}
+
 @implementation FBLikeBoxBorderView
 
 #pragma mark - Object Lifecycle
@@ -153,168 +424,55 @@
 
 - (void)drawRect:(CGRect)rect
 {
-    CGContextRef context = UIGraphicsGetCurrentContext();
-    CGContextSaveGState(context);
-
-    // read the configuration properties
     CGRect bounds = self.bounds;
+    CGFloat scale = self.contentScaleFactor;
+    UIEdgeInsets borderInsets = [self _borderInsets];
+    FBLikeBoxCaretPosition caretPosition = self.caretPosition;
     CGFloat borderWidth = self.borderWidth;
     CGFloat borderCornerRadius = self.borderCornerRadius;
-    CGFloat contentScaleFactor = self.contentScaleFactor;
-
-    // fill the background
-    if (self.backgroundColor) {
-        [self.backgroundColor setFill];
-        CGContextFillRect(context, bounds);
-    }
-
-    // configure the colors and lines
-    [self.fillColor setFill];
-    [self.foregroundColor setStroke];
-    CGContextSetLineJoin(context, kCGLineJoinRound);
-    CGContextSetLineWidth(context, borderWidth);
-
-    // get the frame of the box
-    CGRect borderFrame = UIEdgeInsetsInsetRect(bounds, [self _borderInsets]);
-
-    // define the arcs for the corners
-    const int start = 0;
-    const int tangent = 1;
-    const int end = 2;
-    CGPoint topLeftArc[3] = {
-        CGPointMake(CGRectGetMinX(borderFrame) + borderCornerRadius, CGRectGetMinY(borderFrame)),
-        CGPointMake(CGRectGetMinX(borderFrame), CGRectGetMinY(borderFrame)),
-        CGPointMake(CGRectGetMinX(borderFrame), CGRectGetMinY(borderFrame) + borderCornerRadius),
-    };
-    CGPoint bottomLeftArc[3] = {
-        CGPointMake(CGRectGetMinX(borderFrame), CGRectGetMaxY(borderFrame) - borderCornerRadius),
-        CGPointMake(CGRectGetMinX(borderFrame), CGRectGetMaxY(borderFrame)),
-        CGPointMake(CGRectGetMinX(borderFrame) + borderCornerRadius, CGRectGetMaxY(borderFrame)),
-    };
-    CGPoint bottomRightArc[3] = {
-        CGPointMake(CGRectGetMaxX(borderFrame) - borderCornerRadius, CGRectGetMaxY(borderFrame)),
-        CGPointMake(CGRectGetMaxX(borderFrame), CGRectGetMaxY(borderFrame)),
-        CGPointMake(CGRectGetMaxX(borderFrame), CGRectGetMaxY(borderFrame) - borderCornerRadius),
-    };
-    CGPoint topRightArc[3] = {
-        CGPointMake(CGRectGetMaxX(borderFrame), CGRectGetMinY(borderFrame) + borderCornerRadius),
-        CGPointMake(CGRectGetMaxX(borderFrame), CGRectGetMinY(borderFrame)),
-        CGPointMake(CGRectGetMaxX(borderFrame) - borderCornerRadius, CGRectGetMinY(borderFrame)),
-    };
 
-    // start a path on the context
-    CGContextBeginPath(context);
-
-    // position the caret and decide which lines to draw
-    CGPoint caretPoints[3];
-    switch (self.caretPosition) {
-        case FBLikeBoxCaretPositionTop:
-            CGContextMoveToPoint(context, topRightArc[end].x, topRightArc[end].y);
-            caretPoints[0] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame) + (FBLikeBoxBorderCaretWidth / 2)),
-                                         CGRectGetMinY(borderFrame));
-            caretPoints[1] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame)),
-                                         CGRectGetMinY(borderFrame) - FBLikeBoxBorderCaretHeight);
-            caretPoints[2] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame) - (FBLikeBoxBorderCaretWidth / 2)),
-                                         CGRectGetMinY(borderFrame));
-            CGContextAddLines(context, caretPoints, sizeof(caretPoints) / sizeof(caretPoints[0]));
-            CGContextAddArcToPoint(context, topLeftArc[tangent].x, topLeftArc[tangent].y, topLeftArc[end].x, topLeftArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, bottomLeftArc[start].x, bottomLeftArc[start].y);
-            CGContextAddArcToPoint(context, bottomLeftArc[tangent].x, bottomLeftArc[tangent].y, bottomLeftArc[end].x, bottomLeftArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, bottomRightArc[start].x, bottomRightArc[start].y);
-            CGContextAddArcToPoint(context, bottomRightArc[tangent].x, bottomRightArc[tangent].y, bottomRightArc[end].x, bottomRightArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, topRightArc[start].x, topRightArc[start].y);
-            CGContextAddArcToPoint(context, topRightArc[tangent].x, topRightArc[tangent].y, topRightArc[end].x, topRightArc[end].y, borderCornerRadius);
-            break;
-        case FBLikeBoxCaretPositionLeft:
-            CGContextMoveToPoint(context, topLeftArc[end].x, topLeftArc[end].y);
-            caretPoints[0] = CGPointMake(CGRectGetMinX(borderFrame),
-                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame) - (FBLikeBoxBorderCaretWidth / 2)));
-            caretPoints[1] = CGPointMake(CGRectGetMinX(borderFrame) - FBLikeBoxBorderCaretHeight,
-                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame)));
-            caretPoints[2] = CGPointMake(CGRectGetMinX(borderFrame),
-                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame) + (FBLikeBoxBorderCaretWidth / 2)));
-            CGContextAddLines(context, caretPoints, sizeof(caretPoints) / sizeof(caretPoints[0]));
-            CGContextAddArcToPoint(context, bottomLeftArc[tangent].x, bottomLeftArc[tangent].y, bottomLeftArc[end].x, bottomLeftArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, bottomRightArc[start].x, bottomRightArc[start].y);
-            CGContextAddArcToPoint(context, bottomRightArc[tangent].x, bottomRightArc[tangent].y, bottomRightArc[end].x, bottomRightArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, topRightArc[start].x, topRightArc[start].y);
-            CGContextAddArcToPoint(context, topRightArc[tangent].x, topRightArc[tangent].y, topRightArc[end].x, topRightArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, topLeftArc[start].x, topLeftArc[start].y);
-            CGContextAddArcToPoint(context, topLeftArc[tangent].x, topLeftArc[tangent].y, topLeftArc[end].x, topLeftArc[end].y, borderCornerRadius);
-            break;
-        case FBLikeBoxCaretPositionBottom:
-            CGContextMoveToPoint(context, bottomLeftArc[end].x, bottomLeftArc[end].y);
-            caretPoints[0] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame) - (FBLikeBoxBorderCaretWidth / 2)),
-                                         CGRectGetMaxY(borderFrame));
-            caretPoints[1] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame)),
-                                         CGRectGetMaxY(borderFrame) + FBLikeBoxBorderCaretHeight);
-            caretPoints[2] = CGPointMake(FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidX(borderFrame) + (FBLikeBoxBorderCaretWidth / 2)),
-                                         CGRectGetMaxY(borderFrame));
-            CGContextAddLines(context, caretPoints, sizeof(caretPoints) / sizeof(caretPoints[0]));
-            CGContextAddArcToPoint(context, bottomRightArc[tangent].x, bottomRightArc[tangent].y, bottomRightArc[end].x, bottomRightArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, topRightArc[start].x, topRightArc[start].y);
-            CGContextAddArcToPoint(context, topRightArc[tangent].x, topRightArc[tangent].y, topRightArc[end].x, topRightArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, topLeftArc[start].x, topLeftArc[start].y);
-            CGContextAddArcToPoint(context, topLeftArc[tangent].x, topLeftArc[tangent].y, topLeftArc[end].x, topLeftArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, bottomLeftArc[start].x, bottomLeftArc[start].y);
-            CGContextAddArcToPoint(context, bottomLeftArc[tangent].x, bottomLeftArc[tangent].y, bottomLeftArc[end].x, bottomLeftArc[end].y, borderCornerRadius);
-            break;
-        case FBLikeBoxCaretPositionRight:
-            CGContextMoveToPoint(context, bottomRightArc[end].x, bottomRightArc[end].y);
-            caretPoints[0] = CGPointMake(CGRectGetMaxX(borderFrame),
-                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame) + (FBLikeBoxBorderCaretWidth / 2)));
-            caretPoints[1] = CGPointMake(CGRectGetMaxX(borderFrame) + FBLikeBoxBorderCaretHeight,
-                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame)));
-            caretPoints[2] = CGPointMake(CGRectGetMaxX(borderFrame),
-                                         FBPointsForScreenPixels(floorf, contentScaleFactor, CGRectGetMidY(borderFrame) - (FBLikeBoxBorderCaretWidth / 2)));
-            CGContextAddLines(context, caretPoints, sizeof(caretPoints) / sizeof(caretPoints[0]));
-            CGContextAddArcToPoint(context, topRightArc[tangent].x, topRightArc[tangent].y, topRightArc[end].x, topRightArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, topLeftArc[start].x, topLeftArc[start].y);
-            CGContextAddArcToPoint(context, topLeftArc[tangent].x, topLeftArc[tangent].y, topLeftArc[end].x, topLeftArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, bottomLeftArc[start].x, bottomLeftArc[start].y);
-            CGContextAddArcToPoint(context, bottomLeftArc[tangent].x, bottomLeftArc[tangent].y, bottomLeftArc[end].x, bottomLeftArc[end].y, borderCornerRadius);
-            CGContextAddLineToPoint(context, bottomRightArc[start].x, bottomRightArc[start].y);
-            CGContextAddArcToPoint(context, bottomRightArc[tangent].x, bottomRightArc[tangent].y, bottomRightArc[end].x, bottomRightArc[end].y, borderCornerRadius);
-            break;
+    // split where the caret is centered, so each piece stretches away from it
+    CGRect borderFrame = UIEdgeInsetsInsetRect(bounds, borderInsets);
+    BOOL splitsWidth = FBLikeBoxBorderCaretIsHorizontal(caretPosition);
+    CGFloat split = (splitsWidth ?
+                     FBPointsForScreenPixels(floorf, scale, CGRectGetMidX(borderFrame)) :
+                     FBPointsForScreenPixels(floorf, scale, CGRectGetMidY(borderFrame)));
+    CGRect firstFrame;
+    CGRect secondFrame;
+    CGRectDivide(bounds, &firstFrame, &secondFrame, split, (splitsWidth ? CGRectMinXEdge : CGRectMinYEdge));
+
+    NSArray *pieces = FBLikeBoxBorderChromePieces(caretPosition,
+                                                  borderWidth,
+                                                  borderCornerRadius,
+                                                  scale,
+                                                  self.backgroundColor,
+                                                  self.fillColor,
+                                                  self.foregroundColor);
+    UIImage *firstPiece = pieces[0];
+    UIImage *secondPiece = pieces[1];
+    if (FBLikeBoxBorderPieceFits(firstPiece, firstFrame.size) && FBLikeBoxBorderPieceFits(secondPiece, secondFrame.size)) {
+        [firstPiece drawInRect:firstFrame];
+        [secondPiece drawInRect:secondFrame];
+    } else {
+        // too small to hold the corners and the caret
+        FBLikeBoxBorderDraw(UIGraphicsGetCurrentContext(),
+                            bounds,
+                            borderInsets,
+                            caretPosition,
+                            borderWidth,
+                            borderCornerRadius,
+                            scale,
+                            self.backgroundColor,
+                            self.fillColor,
+                            self.foregroundColor);
     }
-
-    // close and draw now that we have it all
-    CGContextClosePath(context);
-    CGContextDrawPath(context, kCGPathFillStroke);
-
-    CGContextRestoreGState(context);
 }
 
 #pragma mark - Helper Methods
 
 - (UIEdgeInsets)_borderInsets
 {
-    // inset the border bounds by 1/2 of the border width, since it is drawn split between inside and outside of the path
-    CGFloat scale = self.contentScaleFactor;
-    CGFloat halfBorderWidth = FBPointsForScreenPixels(ceilf, scale, self.borderWidth / 2);
-    UIEdgeInsets borderInsets = UIEdgeInsetsMake(halfBorderWidth, halfBorderWidth, halfBorderWidth, halfBorderWidth);
-
-    // adjust the insets for the caret position
-    switch (self.caretPosition) {
-        case FBLikeBoxCaretPositionTop:{
-            borderInsets.top += FBLikeBoxBorderCaretHeight + FBLikeBoxBorderCaretPadding;
-            break;
-        }
-        case FBLikeBoxCaretPositionLeft:{
-            borderInsets.left += FBLikeBoxBorderCaretHeight + FBLikeBoxBorderCaretPadding;
-            break;
-        }
-        case FBLikeBoxCaretPositionBottom:{
-            borderInsets.bottom += FBLikeBoxBorderCaretHeight + FBLikeBoxBorderCaretPadding;
-            break;
-        }
-        case FBLikeBoxCaretPositionRight:{
-            borderInsets.right += FBLikeBoxBorderCaretHeight + FBLikeBoxBorderCaretPadding;
-            break;
-        }
-    }
-
-    return borderInsets;
+    return FBLikeBoxBorderInsets(self.caretPosition, self.borderWidth, self.contentScaleFactor);
 }
 
 - (void)_initializeContent
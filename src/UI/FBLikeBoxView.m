@@ -18,6 +18,7 @@
 
 #import "FBColor.h"
 #import "FBLikeBoxBorderView.h"
+#import "FBUIHelpers.h"
 
 @implementation FBLikeBoxView
 {
@@ -94,7 +95,13 @@
 
 - (CGSize)sizeThatFits:(CGSize)size
 {
-    return [_borderView sizeThatFits:size];
+    // measured here rather than by the label, so the many boxes showing the same count share the result
+    UIEdgeInsets contentInsets = _borderView.contentInsets;
+    CGSize countSize = FBCachedTextSize(_likeCountLabel.text,
+                                        _likeCountLabel.font,
+                                        FBEdgeInsetsInsetSize(size, contentInsets),
+                                        NSLineBreakByClipping);
+    return FBEdgeInsetsOutsetSize(countSize, contentInsets);
 }
 
 #pragma mark - Helper Methods
@@ -140,14 +140,14 @@
 {
     UIFont *font = self.titleLabel.font;
     CGSize constrainedTitleSize = FBEdgeInsetsInsetSize(size, self.titleEdgeInsets);
-    CGSize normalTitleTextSize = FBTextSize([self titleForState:UIControlStateNormal],
-                                            font,
-                                            constrainedTitleSize,
-                                            NSLineBreakByClipping);
-    CGSize selectedTitleTextSize = FBTextSize([self titleForState:UIControlStateSelected],
-                                              font,
-                                              constrainedTitleSize,
-                                              NSLineBreakByClipping);
+    CGSize normalTitleTextSize = FBCachedTextSize([self titleForState:UIControlStateNormal],
+                                                  font,
+                                                  constrainedTitleSize,
+                                                  NSLineBreakByClipping);
+    CGSize selectedTitleTextSize = FBCachedTextSize([self titleForState:UIControlStateSelected],
+                                                    font,
+                                                    constrainedTitleSize,
+                                                    NSLineBreakByClipping);
     CGSize normalSize = [self _sizeWithTitleSize:normalTitleTextSize];
     CGSize selectedSize = [self _sizeWithTitleSize:selectedTitleTextSize];
 
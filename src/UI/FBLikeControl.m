@@ -19,6 +19,7 @@
 #import "FBLikeActionController.h"
 #import "FBLikeBoxView.h"
 #import "FBLikeButton.h"
+#import "FBLikeButtonPopWAV.h"
 #import "FBSocialSentenceView.h"
 
 typedef struct FBLikeControlLayout
@@ -73,6 +74,16 @@ typedef CGSize (^fb_like_control_sizing_block_t)(UIView *subview, CGSize constra
     [super dealloc];
 }
 
+- (void)didMoveToWindow
+{
+    [super didMoveToWindow];
+
+    // off-screen controls, such as those in unselected tabs, don't refresh
+    if (self.window) {
+        [_likeActionController controlDidBecomeVisible];
+    }
+}
+
 #pragma mark - Properties
 
 - (void)setBackgroundColor:(UIColor *)backgroundColor
@@ -289,6 +300,8 @@ typedef CGSize (^fb_like_control_sizing_block_t)(UIView *subview, CGSize constra
 - (void)_initializeContent
 {
     self.soundEnabled = YES;
+    // so the first like plays its sound without loading it
+    [FBLikeButtonPopWAV preload];
 
     _foregroundColor = [[UIColor blackColor] retain];
 
@@ -482,6 +495,9 @@ static CGSize FBLikeControlCalculateContentSize(FBLikeControlLayout layout)
     [_likeActionController release];
     _likeActionController = nil;
     _likeActionController = [[FBLikeActionController likeActionControllerForObjectID:_objectID] retain];
+    if (self.window) {
+        [_likeActionController controlDidBecomeVisible];
+    }
 }
 
 - (void)_updateLikeBoxCaretPosition
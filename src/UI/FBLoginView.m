@@ -18,6 +18,7 @@
 
 #import "FBAppEvents+Internal.h"
 #import "FBGraphUser.h"
+#import "FBImageResourceLoader.h"
 #import "FBLoginTooltipView.h"
 #import "FBLoginViewButtonPNG.h"
 #import "FBLoginViewButtonPressedPNG.h"
@@ -26,9 +27,9 @@
 #import "FBRequestConnection+Internal.h"
 #import "FBSession+Internal.h"
 #import "FBSession.h"
+#import "FBURLConnection.h"
 #import "FBUtility.h"
 
-static NSString *const FBLoginViewCacheIdentity = @"FBLoginView";
 // The design calls for 16 pixels of space on the right edge of the button
 static const float kButtonEndCapWidth = 16.0;
 // The button has a 12 pixel buffer to the right of the f logo
@@ -36,6 +37,16 @@ static const float kButtonPaddingWidth = 12.0;
 
 static CGSize g_buttonSize;
 
+// Button backgrounds decoded off the main thread, shared by every login view once ready.
+static UIImage *g_decodedButtonImage = nil;
+static UIImage *g_decodedButtonPressedImage = nil;
+static BOOL g_decodingButtonImages = NO;
+
+// The label text is measured once per pair of strings rather than for every login view.
+static NSString *g_measuredLogInText = nil;
+static NSString *g_measuredLogOutText = nil;
+static CGFloat g_measuredTextWidth = 0;
+
 // Forward declare our label wrapper that provides shadow blur
 @interface FBShadowLabel : UILabel
 
@@ -170,10 +181,14 @@ static CGSize g_buttonSize;
     };
     self.requestHandler = ^(FBRequestConnection *connection, NSMutableDictionary<FBGraphUser> *result, NSError *error) {
         if (result) {
-            weakSelf.user = result;
-            [weakSelf informDelegate:YES];
+            [weakSelf.session cacheUser:result];
+            if (![weakSelf.user isEqual:result]) {
+                weakSelf.user = result;
+                [weakSelf informDelegate:YES];
+            }
         } else {
-            weakSelf.user = nil;
+            // A user shown from the cache stays put; if the token is no longer good the
+            // session closes, and that clears it.
             if (weakSelf.session.isOpen) {
                 // Only inform the delegate of errors if the session remains open;
                 // since session closure errors will surface through the openActiveSession
@@ -228,21 +243,13 @@ static CGSize g_buttonSize;
     self.button.contentHorizontalAlignment = UIControlContentHorizontalAlignmentFill;
     self.button.autoresizingMask = UIViewAutoresizingFlexibleWidth;
 
-    // We want to make sure that when we stretch the image, it includes the curved edges and drop shadow
-    // We inset enough pixels to make sure that happens
-    UIEdgeInsets imageInsets = UIEdgeInsetsMake(4.0, 40.0, 4.0, 4.0);
-
-    UIImage *image = [[FBLoginViewButtonPNG image] resizableImageWithCapInsets:imageInsets];
-    [self.button setBackgroundImage:image forState:UIControlStateNormal];
-
-    image = [[FBLoginViewButtonPressedPNG image] resizableImageWithCapInsets:imageInsets];
-    [self.button setBackgroundImage:image forState:UIControlStateHighlighted];
+    UIImage *image = [self applyButtonImages];
 
     [self addSubview:self.button];
 
     // Compute the text size to figure out the overall size of the button
     UIFont *font = [UIFont fontWithName:@"HelveticaNeue-Bold" size:14.0];
-    float textSizeWidth = MAX([[self logInText] sizeWithFont:font].width, [[self logOutText] sizeWithFont:font].width);
+    float textSizeWidth = [self textWidthWithFont:font];
 
     // We make the button big enough to hold the image, the text, the padding to the right of the f and the end cap
     g_buttonSize = CGSizeMake(image.size.width + textSizeWidth + kButtonPaddingWidth + kButtonEndCapWidth, image.size.height);
@@ -286,6 +293,54 @@ static CGSize g_buttonSize;
 }
 #pragma GCC diagnostic warning "-Wdeprecated-declarations"
 
+// Sets the button backgrounds and returns the normal one, whose size drives the layout. Until the
+// shared decoded images are ready the bundled images are used as-is, and the first view to get here
+// starts decoding them in the background so later renders do not decode on the main thread.
+- (UIImage *)applyButtonImages {
+    UIImage *image = g_decodedButtonImage;
+    UIImage *pressedImage = g_decodedButtonPressedImage;
+    if (!image || !pressedImage) {
+        // We want to make sure that when we stretch the image, it includes the curved edges and drop shadow
+        // We inset enough pixels to make sure that happens
+        UIEdgeInsets imageInsets = UIEdgeInsetsMake(4.0, 40.0, 4.0, 4.0);
+        UIImage *bundledImage = [FBLoginViewButtonPNG image];
+        UIImage *bundledPressedImage = [FBLoginViewButtonPressedPNG image];
+        image = [bundledImage resizableImageWithCapInsets:imageInsets];
+        pressedImage = [bundledPressedImage resizableImageWithCapInsets:imageInsets];
+
+        if (!g_decodingButtonImages) {
+            g_decodingButtonImages = YES;
+            UIButton *button = self.button;
+            [FBImageResourceLoader decodeImage:bundledImage completion:^(UIImage *decodedImage) {
+                g_decodedButtonImage = [[decodedImage resizableImageWithCapInsets:imageInsets] retain];
+                [button setBackgroundImage:g_decodedButtonImage forState:UIControlStateNormal];
+            }];
+            [FBImageResourceLoader decodeImage:bundledPressedImage completion:^(UIImage *decodedImage) {
+                g_decodedButtonPressedImage = [[decodedImage resizableImageWithCapInsets:imageInsets] retain];
+                [button setBackgroundImage:g_decodedButtonPressedImage forState:UIControlStateHighlighted];
+            }];
+        }
+    }
+    [self.button setBackgroundImage:image forState:UIControlStateNormal];
+    [self.button setBackgroundImage:pressedImage forState:UIControlStateHighlighted];
+    return image;
+}
+
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+- (CGFloat)textWidthWithFont:(UIFont *)font {
+    NSString *logInText = [self logInText];
+    NSString *logOutText = [self logOutText];
+    if (![logInText isEqualToString:g_measuredLogInText] || ![logOutText isEqualToString:g_measuredLogOutText]) {
+        [g_measuredLogInText release];
+        g_measuredLogInText = [logInText copy];
+        [g_measuredLogOutText release];
+        g_measuredLogOutText = [logOutText copy];
+        g_measuredTextWidth = MAX([logInText sizeWithFont:font].width, [logOutText sizeWithFont:font].width);
+    }
+    return g_measuredTextWidth;
+}
+#pragma GCC diagnostic warning "-Wdeprecated-declarations"
+
 - (CGSize)intrinsicContentSize {
     return self.bounds.size;
 }
@@ -311,15 +366,21 @@ static CGSize g_buttonSize;
     }
 }
 
+// Shows the user saved with the token right away, if there is one, and refreshes it in the
+// background.  The refresh is a plain GET from the main thread, so it shares the call with any
+// other /me request in flight, such as FBUserSettingsViewController's.
 - (void)fetchMeInfo {
+    if (!self.user) {
+        // the delegate hears about it from informDelegate:, which follows every state change
+        self.user = [self.session cachedUser];
+    }
+
     FBRequest *request = [FBRequest requestForMe];
     [request setSession:self.session];
     self.request = [[[FBRequestConnection alloc] init] autorelease];
     [self.request addRequest:request
            completionHandler:self.requestHandler];
-    [self.request startWithCacheIdentity:FBLoginViewCacheIdentity
-                   skipRoundtripIfCached:YES];
-
+    [self.request start];
 }
 
 - (void)showTooltipIfNeeded {
@@ -339,6 +400,10 @@ static CGSize g_buttonSize;
 {
     [super didMoveToWindow];
 
+    if (self.window) {
+        [FBURLConnection prewarmConnections];
+    }
+
     if (self.window &&
         (self.tooltipBehavior == FBLoginViewTooltipBehaviorForceDisplay || !self.hasShownTooltipBubble)) {
         [self showTooltipIfNeeded];
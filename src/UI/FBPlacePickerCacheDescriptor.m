@@ -18,6 +18,7 @@
 
 #import "FBGraphObjectPagingLoader.h"
 #import "FBGraphObjectTableDataSource.h"
+#import "FBMetrics.h"
 #import "FBPlacePickerViewController+Internal.h"
 #import "FBPlacePickerViewController.h"
 
@@ -84,6 +85,7 @@
                                                               pagingMode:FBGraphObjectPagingModeAsNeeded]
                    autorelease];
     self.loader.session = session;
+    self.loader.networkFeature = FBNetworkFeaturePlacePicker;
     self.loader.delegate = self;
 
     // make sure we are around to handle the delegate call
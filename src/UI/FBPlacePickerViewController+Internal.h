@@ -37,4 +37,9 @@ FBSDK_EXTERN const NSInteger defaultRadius;
                                            fields:(NSSet *)fieldsForRequest
                                        datasource:(FBGraphObjectTableDataSource *)datasource
                                           session:(FBSession *)session;
+
+// The center of the geohash tile holding coordinate, at the coarsest precision whose tiles
+// are no more than a quarter of the radius across, so nearby coordinates share a search.
++ (CLLocationCoordinate2D)tileCenterForCoordinate:(CLLocationCoordinate2D)coordinate
+                                   radiusInMeters:(NSInteger)radius;
 @end
@@ -21,10 +21,13 @@
 #import "FBGraphObjectTableSelection.h"
 #import "FBAppEvents+Internal.h"
 #import "FBLogger.h"
+#import "FBMetrics.h"
 #import "FBPlacePickerViewController.h"
 #import "FBRequest.h"
+#import "FBRequestConnection+Internal.h"
 #import "FBRequestConnection.h"
 #import "FBUtility.h"
+#import "FBViewController+Internal.h"
 #import "FBPlacePickerCacheDescriptor.h"
 #import "FBSession+Internal.h"
 #import "FBSettings.h"
@@ -33,6 +36,13 @@
 NSString *const FBPlacePickerCacheIdentity = @"FBPlacePicker";
 
 static const NSInteger searchTextChangedTimerInterval = 2;
+// Search text changes are sent once typing pauses this long, or every
+// searchTextChangedTimerInterval while it doesn't
+static const NSTimeInterval kSearchTextDebounceInterval = 0.3;
+// Geohash precisions tried for search tiles, and the tile size relative to the radius
+static const NSUInteger kMaximumTilePrecision = 9;
+static const double kTileSizeToRadius = 0.25;
+static const double kMetersPerDegree = 111320.0;
 const NSInteger defaultResultsLimit = 100;
 const NSInteger defaultRadius = 1000; // 1km
 
@@ -45,10 +55,13 @@ FBGraphObjectPagingLoaderDelegate>
 @property (nonatomic, retain) FBGraphObjectPagingLoader *loader;
 @property (nonatomic, retain) NSTimer *searchTextChangedTimer;
 @property (nonatomic) BOOL trackActiveSession;
+// Cache key of the search last started, so repeats of it can be dropped
+@property (nonatomic, copy) NSString *lastSearchKey;
 
 - (void)initialize;
 - (void)loadDataPostThrottleSkippingRoundTripIfCached:(NSNumber *)skipRoundTripIfCached;
 - (NSTimer *)createSearchTextChangedTimer;
+- (void)searchTextDidSettle;
 - (void)updateView;
 - (void)centerAndStartSpinner;
 - (void)addSessionObserver:(FBSession *)session;
@@ -117,6 +130,8 @@ FBGraphObjectPagingLoaderDelegate>
                  autorelease];
     self.loader = loader;
     self.loader.delegate = self;
+    self.loader.networkFeature = FBNetworkFeaturePlacePicker;
+    dataSource.networkFeature = FBNetworkFeaturePlacePicker;
 
     // Self
     self.dataSource = dataSource;
@@ -141,6 +156,7 @@ FBGraphObjectPagingLoaderDelegate>
     [_fieldsForRequest release];
     [_searchText release];
     [_searchTextChangedTimer release];
+    [_lastSearchKey release];
     [_selectionManager release];
     [_spinner release];
     [_tableView release];
@@ -202,14 +218,21 @@ FBGraphObjectPagingLoaderDelegate>
     }
 
     // Sending a request on every keystroke is wasteful of bandwidth. Send a
-    // request the first time the user types something, then set up a 2-second timer
-    // and send whatever changes the user has made since then. (If nothing has changed
-    // in 2 seconds, we reset so the next change will cause an immediate re-query.)
+    // request the first time the user types something, then set up a 2-second timer.
+    // Later changes are sent once typing pauses, or when the timer fires if it never
+    // does. (If nothing has changed in 2 seconds, we reset so the next change will
+    // cause an immediate re-query.)
     if (!self.searchTextChangedTimer) {
         self.searchTextChangedTimer = [self createSearchTextChangedTimer];
         [self loadDataPostThrottleSkippingRoundTripIfCached:[NSNumber numberWithBool:YES]];
     } else {
         _hasSearchTextChangedSinceLastQuery = YES;
+        [NSObject cancelPreviousPerformRequestsWithTarget:self
+                                                 selector:@selector(searchTextDidSettle)
+                                                   object:nil];
+        [self performSelector:@selector(searchTextDidSettle)
+                   withObject:nil
+                   afterDelay:kSearchTextDebounceInterval];
     }
 }
 
@@ -302,7 +325,9 @@ FBGraphObjectPagingLoaderDelegate>
                                        datasource:(FBGraphObjectTableDataSource *)datasource
                                           session:(FBSession *)session {
 
-    FBRequest *request = [FBRequest requestForPlacesSearchAtCoordinate:coordinate
+    // Searches are made from the middle of a tile, so GPS jitter doesn't defeat the cache
+    FBRequest *request = [FBRequest requestForPlacesSearchAtCoordinate:[self tileCenterForCoordinate:coordinate
+                                                                                      radiusInMeters:radius]
                                                         radiusInMeters:radius
                                                           resultsLimit:resultsLimit
                                                             searchText:searchText];
@@ -325,6 +350,41 @@ FBGraphObjectPagingLoaderDelegate>
     return request;
 }
 
++ (CLLocationCoordinate2D)tileCenterForCoordinate:(CLLocationCoordinate2D)coordinate
+                                   radiusInMeters:(NSInteger)radius {
+    if (!CLLocationCoordinate2DIsValid(coordinate) || radius <= 0) {
+        return coordinate;
+    }
+
+    // Geohash tiles of precision p split longitude into 2^ceil(5p/2) columns and
+    // latitude into 2^floor(5p/2) rows; finer ones are only used when coarser ones
+    // are too big for the radius.
+    double maximumTileSize = radius * kTileSizeToRadius;
+    double metersPerLongitudeDegree = kMetersPerDegree * cos(coordinate.latitude * M_PI / 180.0);
+    double tileWidth = 360.0;
+    double tileHeight = 180.0;
+    for (NSUInteger precision = 1; precision <= kMaximumTilePrecision; precision++) {
+        NSUInteger bits = precision * 5;
+        tileWidth = 360.0 / (double)(1ULL << ((bits + 1) / 2));
+        tileHeight = 180.0 / (double)(1ULL << (bits / 2));
+        if (tileWidth * metersPerLongitudeDegree <= maximumTileSize &&
+            tileHeight * kMetersPerDegree <= maximumTileSize) {
+            break;
+        }
+    }
+
+    CLLocationCoordinate2D center;
+    center.longitude = (floor((coordinate.longitude + 180.0) / tileWidth) + 0.5) * tileWidth - 180.0;
+    center.latitude = (floor((coordinate.latitude + 90.0) / tileHeight) + 0.5) * tileHeight - 90.0;
+    return center;
+}
+
+- (void)searchTextDidSettle {
+    if (_hasSearchTextChangedSinceLastQuery) {
+        [self loadDataPostThrottleSkippingRoundTripIfCached:[NSNumber numberWithBool:YES]];
+    }
+}
+
 - (void)loadDataPostThrottleSkippingRoundTripIfCached:(NSNumber *)skipRoundTripIfCached {
     // Place queries require a session, so do nothing if we don't have one.
     if (self.session) {
@@ -336,6 +396,19 @@ FBGraphObjectPagingLoaderDelegate>
                                                                                   datasource:self.dataSource
                                                                                      session:self.session];
         _hasSearchTextChangedSinceLastQuery = NO;
+        [NSObject cancelPreviousPerformRequestsWithTarget:self
+                                                 selector:@selector(searchTextDidSettle)
+                                                   object:nil];
+
+        // A change that lands on the same tile and text as the search already shown,
+        // or under way, asks for nothing new; refreshes from the server still go out.
+        NSString *searchKey = [FBRequestConnection canonicalCacheKeyForRequests:@[request]];
+        if (skipRoundTripIfCached.boolValue && [searchKey isEqualToString:self.lastSearchKey]) {
+            return;
+        }
+        self.lastSearchKey = searchKey;
+        self.loader.cancellationToken = self.cancellationToken;
+        self.dataSource.cancellationToken = self.cancellationToken;
         [self.loader startLoadingWithRequest:request
                                cacheIdentity:FBPlacePickerCacheIdentity
                        skipRoundtripIfCached:skipRoundTripIfCached.boolValue];
@@ -344,8 +417,10 @@ FBGraphObjectPagingLoaderDelegate>
 
 - (void)updateView
 {
-    [self.dataSource update];
-    [self.tableView reloadData];
+    // sorted in the background, so a keystroke in a search field doesn't stall on a long list
+    [self.dataSource updateWithCompletion:^{
+        [self.tableView reloadData];
+    }];
 }
 
 - (NSTimer *)createSearchTextChangedTimer {
@@ -398,12 +473,21 @@ FBGraphObjectPagingLoaderDelegate>
 }
 
 - (void)clearData {
+    self.lastSearchKey = nil;
     [self.dataSource clearGraphObjects];
     [self.selectionManager clearSelectionInTableView:self.tableView];
     [self.tableView reloadData];
     [self.loader reset];
 }
 
+- (void)cancelNetworkWorkForToken:(FBCancellationToken *)token {
+    // The loader feeds the data source, so it lets go first
+    [self.loader cancel];
+    self.loader.cancellationToken = self.cancellationToken;
+    [self.dataSource cancelPendingRequests];
+    self.dataSource.cancellationToken = self.cancellationToken;
+}
+
 - (void)logAppEvents:(BOOL)cancelled {
     [FBAppEvents logImplicitEvent:FBAppEventNamePlacePickerUsage
                        valueToSum:nil
@@ -526,6 +610,8 @@ FBGraphObjectPagingLoaderDelegate>
 }
 
 - (void)pagingLoader:(FBGraphObjectPagingLoader *)pagingLoader handleError:(NSError *)error {
+    // a failed search is worth sending again
+    self.lastSearchKey = nil;
     if ([self.delegate respondsToSelector:@selector(placePickerViewController:handleError:)]) {
         [(id)self.delegate placePickerViewController:self handleError:error];
     }
@@ -533,6 +619,7 @@ FBGraphObjectPagingLoaderDelegate>
 }
 
 - (void)pagingLoaderWasCancelled:(FBGraphObjectPagingLoader *)pagingLoader {
+    self.lastSearchKey = nil;
     [self.spinner stopAnimating];
 }
 
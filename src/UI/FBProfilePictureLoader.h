@@ -0,0 +1,55 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+typedef void (^FBProfilePictureLoaderHandler)(UIImage *image, NSError *error);
+
+// Loads profile pictures on behalf of every FBProfilePictureView, so that views showing
+// the same picture share one request.  Loads are keyed by the profile ID and the size
+// parameters of the picture URL; while one is in flight, later loads with the same key
+// just wait for it, and the picture is decoded once per distinct view size.
+// Main thread only.
+@interface FBProfilePictureLoader : NSObject
+
++ (FBProfilePictureLoader *)sharedLoader;
+
+// Starts or joins a load, returning a token for cancelLoad:.  handler is called on the
+// main thread with the picture decoded for size, or with an error; it is not called for
+// a cancelled load.
+- (id)loadPictureForKey:(NSString *)key
+                    url:(NSURL *)url
+                   size:(CGSize)size
+                handler:(FBProfilePictureLoaderHandler)handler;
+
+// Stops waiting on a load.  The request itself is only cancelled once nobody waits on it,
+// unless it was started as a prefetch, which then carries on at prefetch priority.
+- (void)cancelLoad:(id)token;
+
+// Fetches the picture into the disk cache, and its redirect into FBURLRedirectCache, at
+// prefetch priority, unless it is cached or being loaded already.  A view that asks for
+// the same key while the prefetch is in flight joins it, and promotes it to a visible image.
+// Does nothing unless request scheduling is enabled, since without the scheduler a
+// prefetch would compete with the pictures on screen.
+- (void)prefetchPictureForKey:(NSString *)key url:(NSURL *)url;
+
+// Gives up on a prefetch.  Its request is cancelled, unless a view is waiting on it, in
+// which case it carries on for the view and is cancelled once the view stops waiting.
+- (void)cancelPrefetchForKey:(NSString *)key;
+
+@end
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBProfilePictureLoader.h"
+
+#import "FBImageDecoder.h"
+#import "FBMetrics.h"
+#import "FBSettings.h"
+#import "FBURLConnection.h"
+
+// One view waiting on a load
+@interface FBProfilePictureLoaderWaiter : NSObject
+
+@property (nonatomic, copy) NSString *key;
+@property (nonatomic, assign) CGSize size;
+@property (nonatomic, copy) FBProfilePictureLoaderHandler handler;
+@property (nonatomic, assign) BOOL cancelled;
+
+@end
+
+@implementation FBProfilePictureLoaderWaiter
+
+- (void)dealloc
+{
+    [_key release];
+    [_handler release];
+    [super dealloc];
+}
+
+@end
+
+@interface FBProfilePictureLoader ()
+
+// key -> FBURLConnection, and key -> array of FBProfilePictureLoaderWaiter
+@property (nonatomic, retain) NSMutableDictionary *connectionsByKey;
+@property (nonatomic, retain) NSMutableDictionary *waitersByKey;
+// Keys whose load was started by prefetchPictureForKey:url:
+@property (nonatomic, retain) NSMutableSet *prefetchKeys;
+
+- (void)startLoadForKey:(NSString *)key url:(NSURL *)url priority:(FBRequestPriority)priority;
+- (void)completeLoadForKey:(NSString *)key
+                connection:(FBURLConnection *)connection
+                     error:(NSError *)error
+                      data:(NSData *)data
+                       url:(NSURL *)url;
+
+@end
+
+@implementation FBProfilePictureLoader
+
++ (FBProfilePictureLoader *)sharedLoader
+{
+    static FBProfilePictureLoader *_instance;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        _instance = [[FBProfilePictureLoader alloc] init];
+    });
+
+    return _instance;
+}
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        self.connectionsByKey = [NSMutableDictionary dictionary];
+        self.waitersByKey = [NSMutableDictionary dictionary];
+        self.prefetchKeys = [NSMutableSet set];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_connectionsByKey release];
+    [_waitersByKey release];
+    [_prefetchKeys release];
+    [super dealloc];
+}
+
+- (id)loadPictureForKey:(NSString *)key
+                    url:(NSURL *)url
+                   size:(CGSize)size
+                handler:(FBProfilePictureLoaderHandler)handler
+{
+    FBProfilePictureLoaderWaiter *waiter = [[[FBProfilePictureLoaderWaiter alloc] init] autorelease];
+    waiter.key = key;
+    waiter.size = size;
+    waiter.handler = handler;
+
+    NSMutableArray *waiters = [self.waitersByKey objectForKey:key];
+    if (waiters) {
+        [waiters addObject:waiter];
+        // a prefetch that is now wanted on screen
+        [[self.connectionsByKey objectForKey:key] setPriority:FBRequestPriorityVisibleImage];
+        return waiter;
+    }
+    [self.waitersByKey setObject:[NSMutableArray arrayWithObject:waiter] forKey:key];
+    [self startLoadForKey:key url:url priority:FBRequestPriorityVisibleImage];
+    return waiter;
+}
+
+- (void)prefetchPictureForKey:(NSString *)key url:(NSURL *)url
+{
+    if (![FBSettings isRequestSchedulingEnabled] || [self.waitersByKey objectForKey:key]) {
+        return;
+    }
+    [self.waitersByKey setObject:[NSMutableArray array] forKey:key];
+    [self.prefetchKeys addObject:key];
+    [self startLoadForKey:key url:url priority:FBRequestPriorityPrefetch];
+}
+
+- (void)startLoadForKey:(NSString *)key url:(NSURL *)url priority:(FBRequestPriority)priority
+{
+    FBURLConnectionHandler connectionHandler =
+    ^(FBURLConnection *connection, NSError *error, NSURLResponse *response, NSData *data) {
+        [self completeLoadForKey:key connection:connection error:error data:data url:url];
+    };
+    FBURLConnection *connection = [[FBURLConnection alloc] initWithURL:url
+                                                     completionHandler:connectionHandler];
+    connection.networkFeature = FBNetworkFeatureProfilePicture;
+    // Fine to set after init, since the cache is always checked before the network
+    connection.priority = priority;
+    // the handler may already have run, if the picture came straight from the cache
+    if ([self.waitersByKey objectForKey:key]) {
+        [self.connectionsByKey setObject:connection forKey:key];
+    }
+    [connection release];
+}
+
+- (void)cancelPrefetchForKey:(NSString *)key
+{
+    if (![self.prefetchKeys containsObject:key]) {
+        return;
+    }
+    [self.prefetchKeys removeObject:key];
+    if ([[self.waitersByKey objectForKey:key] count] == 0) {
+        key = [[key retain] autorelease];
+        FBURLConnection *connection = [[[self.connectionsByKey objectForKey:key] retain] autorelease];
+        [self.waitersByKey removeObjectForKey:key];
+        [self.connectionsByKey removeObjectForKey:key];
+        [connection cancel];
+    }
+}
+
+- (void)cancelLoad:(id)token
+{
+    FBProfilePictureLoaderWaiter *waiter = token;
+    // it may be past the request, waiting on the decode
+    waiter.cancelled = YES;
+    NSMutableArray *waiters = [self.waitersByKey objectForKey:waiter.key];
+    if (![waiters containsObject:waiter]) {
+        return;
+    }
+    [waiters removeObjectIdenticalTo:waiter];
+    if (waiters.count == 0 && [self.prefetchKeys containsObject:waiter.key]) {
+        // still worth having for when the row comes back
+        [[self.connectionsByKey objectForKey:waiter.key] setPriority:FBRequestPriorityPrefetch];
+    } else if (waiters.count == 0) {
+        NSString *key = [[waiter.key retain] autorelease];
+        FBURLConnection *connection = [[[self.connectionsByKey objectForKey:key] retain] autorelease];
+        [self.waitersByKey removeObjectForKey:key];
+        [self.connectionsByKey removeObjectForKey:key];
+        // calls the handler with a cancellation, which finds nobody left to tell
+        [connection cancel];
+    }
+}
+
+- (void)completeLoadForKey:(NSString *)key
+                connection:(FBURLConnection *)connection
+                     error:(NSError *)error
+                      data:(NSData *)data
+                       url:(NSURL *)url
+{
+    FBURLConnection *currentConnection = [self.connectionsByKey objectForKey:key];
+    if (currentConnection && currentConnection != connection) {
+        // a load that was cancelled, finishing after a new one for the key started
+        return;
+    }
+    NSArray *waiters = [[[self.waitersByKey objectForKey:key] retain] autorelease];
+    [self.waitersByKey removeObjectForKey:key];
+    [self.connectionsByKey removeObjectForKey:key];
+    [self.prefetchKeys removeObject:key];
+
+    if (error) {
+        for (FBProfilePictureLoaderWaiter *waiter in waiters) {
+            if (!waiter.cancelled) {
+                waiter.handler(nil, error);
+            }
+        }
+        return;
+    }
+
+    // one decode per distinct size, shared by every view of that size
+    NSMutableDictionary *waitersBySize = [NSMutableDictionary dictionary];
+    for (FBProfilePictureLoaderWaiter *waiter in waiters) {
+        NSValue *size = [NSValue valueWithCGSize:waiter.size];
+        NSMutableArray *sameSize = [waitersBySize objectForKey:size];
+        if (!sameSize) {
+            sameSize = [NSMutableArray array];
+            [waitersBySize setObject:sameSize forKey:size];
+        }
+        [sameSize addObject:waiter];
+    }
+    [waitersBySize enumerateKeysAndObjectsUsingBlock:^(NSValue *size, NSArray *sameSize, BOOL *stop) {
+        [[FBImageDecoder sharedDecoder] decodeImageData:data
+                                                 forKey:url.absoluteString
+                                                   size:size.CGSizeValue
+                                                filling:NO
+                                             completion:^(UIImage *image) {
+            for (FBProfilePictureLoaderWaiter *waiter in sameSize) {
+                if (!waiter.cancelled) {
+                    waiter.handler(image, nil);
+                }
+            }
+        }];
+    }];
+}
+
+@end
@@ -17,18 +17,86 @@
 #import "FBProfilePictureView.h"
 
 #import "FBAccessTokenData.h"
+#import "FBImageDecoder.h"
+#import "FBProfilePictureLoader.h"
 #import "FBProfilePictureViewBlankProfilePortraitPNG.h"
 #import "FBProfilePictureViewBlankProfileSquarePNG.h"
 #import "FBSession.h"
 #import "FBSettings.h"
-#import "FBURLConnection.h"
 #import "FBUtility.h"
 
+// Square pictures are requested at the smallest of these widths, in pixels, that covers the
+// view, and scaled down to it when decoded.  Views of similar sizes, and a view going through
+// a bounds animation, then share one URL and one cache entry.
+static const int kSquarePictureBuckets[] = {64, 128, 256, 512, 1024};
+// Past the largest bucket, widths round up to a multiple of this
+static const int kSquarePictureLargeBucketStep = 512;
+
+static int FBProfilePictureBucketedWidth(int width) {
+    for (size_t i = 0; i < sizeof(kSquarePictureBuckets) / sizeof(kSquarePictureBuckets[0]); i++) {
+        if (width <= kSquarePictureBuckets[i]) {
+            return kSquarePictureBuckets[i];
+        }
+    }
+    return ((width + kSquarePictureLargeBucketStep - 1) / kSquarePictureLargeBucketStep) * kSquarePictureLargeBucketStep;
+}
+
+// The picture URL's size parameters for a view pointWidth points wide
+static NSDictionary *FBProfilePictureQueryParams(CGFloat pointWidth, FBProfilePictureCropping pictureCropping) {
+    static CGFloat screenScaleFactor = 0.0;
+    if (screenScaleFactor == 0.0) {
+        screenScaleFactor = [[UIScreen mainScreen] scale];
+    }
+
+    // Retina display doesn't increase the bounds that iOS returns.  The larger size to fetch needs
+    // to be calculated using the scale factor accessed above.
+    int width = (int)(pointWidth * screenScaleFactor);
+
+    if (pictureCropping == FBProfilePictureCroppingSquare) {
+        int bucketedWidth = FBProfilePictureBucketedWidth(width);
+        return @{
+                 @"width": @(bucketedWidth),
+                 @"height": @(bucketedWidth),
+                 };
+    }
+
+    // For non-square images, we choose between three variants knowing that the small profile picture is
+    // 50 pixels wide, normal is 100, and large is about 200.
+    if (width <= 50) {
+        return @{ @"type": @"small" };
+    } else if (width <= 100) {
+        return @{ @"type": @"normal" };
+    } else {
+        return @{ @"type": @"large" };
+    }
+}
+
+// Views showing the same picture at the same size share one load, keyed by this
+static NSString *FBProfilePictureLoadKey(NSString *profileID, NSDictionary *queryParams) {
+    return [NSString stringWithFormat:@"%@?%@",
+            profileID,
+            [FBUtility stringBySerializingQueryParameters:queryParams]];
+}
+
+static NSString *FBProfilePictureURLString(NSString *profileID, NSDictionary *queryParams) {
+    NSString *accessToken = [FBSession activeSession].accessTokenData.accessToken;
+    if (accessToken) {
+        NSMutableDictionary *mutableQueryParams = [[queryParams mutableCopy] autorelease];
+        mutableQueryParams[@"access_token"] = accessToken;
+        queryParams = mutableQueryParams;
+    }
+
+    return [NSString stringWithFormat:@"%@/%@/picture?%@",
+            [FBUtility buildFacebookUrlWithPre:@"https://graph."],
+            profileID,
+            [FBUtility stringBySerializingQueryParameters:queryParams]];
+}
+
 @interface FBProfilePictureView ()
 
 @property (copy, nonatomic) NSDictionary *currentImageQueryParams;
 
-@property (retain, nonatomic) FBURLConnection *connection;
+@property (retain, nonatomic) id pictureLoad;
 @property (retain, nonatomic) UIImageView *imageView;
 
 - (void)initialize;
@@ -44,7 +112,8 @@
 - (void)dealloc {
     [_profileID release];
     [_imageView release];
-    [_connection release];
+    [[FBProfilePictureLoader sharedLoader] cancelLoad:_pictureLoad];
+    [_pictureLoad release];
     [_currentImageQueryParams release];
 
     [super dealloc];
@@ -89,32 +158,30 @@
 
 #pragma mark -
 
-- (NSDictionary *)_generateQueryParams {
-    static CGFloat screenScaleFactor = 0.0;
-    if (screenScaleFactor == 0.0) {
-        screenScaleFactor = [[UIScreen mainScreen] scale];
++ (void)prefetchPicturesForProfileIDs:(NSArray *)profileIDs
+                                 size:(CGSize)size
+                      pictureCropping:(FBProfilePictureCropping)pictureCropping {
+    NSDictionary *queryParams = FBProfilePictureQueryParams(size.width, pictureCropping);
+    FBProfilePictureLoader *loader = [FBProfilePictureLoader sharedLoader];
+    for (NSString *profileID in profileIDs) {
+        NSString *urlString = FBProfilePictureURLString(profileID, queryParams);
+        [loader prefetchPictureForKey:FBProfilePictureLoadKey(profileID, queryParams)
+                                  url:[NSURL URLWithString:urlString]];
     }
+}
 
-    // Retina display doesn't increase the bounds that iOS returns.  The larger size to fetch needs
-    // to be calculated using the scale factor accessed above.
-    int width = (int)(self.bounds.size.width * screenScaleFactor);
-
-    if (self.pictureCropping == FBProfilePictureCroppingSquare) {
-        return @{
-                 @"width": @(width),
-                 @"height": @(width),
-                 };
++ (void)cancelPrefetchingPicturesForProfileIDs:(NSArray *)profileIDs
+                                          size:(CGSize)size
+                               pictureCropping:(FBProfilePictureCropping)pictureCropping {
+    NSDictionary *queryParams = FBProfilePictureQueryParams(size.width, pictureCropping);
+    FBProfilePictureLoader *loader = [FBProfilePictureLoader sharedLoader];
+    for (NSString *profileID in profileIDs) {
+        [loader cancelPrefetchForKey:FBProfilePictureLoadKey(profileID, queryParams)];
     }
+}
 
-    // For non-square images, we choose between three variants knowing that the small profile picture is
-    // 50 pixels wide, normal is 100, and large is about 200.
-    if (width <= 50) {
-        return @{ @"type": @"small" };
-    } else if (width <= 100) {
-        return @{ @"type": @"normal" };
-    } else {
-        return @{ @"type": @"large" };
-    }
+- (NSDictionary *)_generateQueryParams {
+    return FBProfilePictureQueryParams(self.bounds.size.width, self.pictureCropping);
 }
 
 - (UIImage *)_placeholderImage {
@@ -155,36 +222,40 @@
     // store the params without the accessToken
     self.currentImageQueryParams = imageQueryParams;
 
+    [[FBProfilePictureLoader sharedLoader] cancelLoad:self.pictureLoad];
+    self.pictureLoad = nil;
+
     if (self.profileID) {
-        [self.connection cancel];
+        // each refresh stores a new dictionary, so this tells a stale decode apart
+        NSDictionary *requestedQueryParams = self.currentImageQueryParams;
+        CGSize size = self.bounds.size;
+        NSString *loadKey = FBProfilePictureLoadKey(self.profileID, imageQueryParams);
+        NSString *urlString = FBProfilePictureURLString(self.profileID, imageQueryParams);
+        NSURL *url = [NSURL URLWithString:urlString];
 
-        FBURLConnectionHandler handler =
-        ^(FBURLConnection *connection, NSError *error, NSURLResponse *response, NSData *data) {
-            FBConditionalLog(self.connection == connection, FBLoggingBehaviorFBURLConnections, @"Inconsistent connection state");
+        UIImage *cachedImage = [[FBImageDecoder sharedDecoder] cachedImageForKey:urlString size:size filling:NO];
+        if (cachedImage) {
+            self.imageView.image = cachedImage;
+            [self ensureImageViewContentMode];
+            return;
+        }
 
-            self.connection = nil;
+        // The picture is decoded and scaled to the view in the background, since it is
+        // otherwise decompressed at full size on the main thread when first drawn.
+        self.pictureLoad = [[FBProfilePictureLoader sharedLoader] loadPictureForKey:loadKey
+                                                                                url:url
+                                                                               size:size
+                                                                            handler:^(UIImage *image, NSError *error) {
+            if (self.currentImageQueryParams != requestedQueryParams) {
+                // a newer picture has been asked for since
+                return;
+            }
+            self.pictureLoad = nil;
             if (!error) {
-                self.imageView.image = ([UIImage imageWithData:data] ?: [self _placeholderImage]);
+                self.imageView.image = (image ?: [self _placeholderImage]);
                 [self ensureImageViewContentMode];
             }
-        };
-
-        NSString *accessToken = [FBSession activeSession].accessTokenData.accessToken;
-        if (accessToken) {
-            NSMutableDictionary *mutableImageQueryParams = [imageQueryParams mutableCopy];
-            mutableImageQueryParams[@"access_token"] = accessToken;
-            imageQueryParams = [mutableImageQueryParams autorelease];
-        }
-
-        NSString *urlString = [NSString stringWithFormat:@"%@/%@/picture?%@",
-                               [FBUtility buildFacebookUrlWithPre:@"https://graph."],
-                               self.profileID,
-                               [FBUtility stringBySerializingQueryParameters:imageQueryParams]];
-        NSURL *url = [NSURL URLWithString:urlString];
-
-        self.connection = [[[FBURLConnection alloc] initWithURL:url
-                                              completionHandler:handler]
-                           autorelease];
+        }];
     } else {
         self.imageView.image = [self _placeholderImage];
         [self ensureImageViewContentMode];
@@ -135,7 +135,7 @@
 
 - (CGSize)sizeThatFits:(CGSize)size
 {
-    return FBTextSize(_text, _textLabel.font, size, NSLineBreakByWordWrapping);
+    return FBCachedTextSize(_text, _textLabel.font, size, NSLineBreakByWordWrapping);
 }
 
 #pragma mark - Helper Methods
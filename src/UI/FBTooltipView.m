@@ -391,7 +391,47 @@ CGMutablePathRef _createCloseCrossGlyphWithRect(CGRect rect)
 
 - (void)drawRect:(CGRect)rect
 {
-    // Ignore dirty rect and just redraw the entire nux bubble
+    static NSCache *_chromeCache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _chromeCache = [[NSCache alloc] init];
+    });
+
+    CGRect outerRect = [self _outerRect];
+    CGMutablePathRef outerPath = (_pointingUp ?
+                                  _createUpPointingBubbleWithRect(outerRect, _arrowMidpoint, _arrowHeight, kNUXCornerRadius + kNUXStrokeLineWidth) :
+                                  _createDownPointingBubbleWithRect(outerRect, _arrowMidpoint, _arrowHeight, kNUXCornerRadius + kNUXStrokeLineWidth));
+    self.layer.shadowPath = outerPath;
+    CFRelease(outerPath);
+
+    // The bubble only depends on these, so tooltips that look alike, and redraws of one that
+    // hasn't changed shape, composite the same bitmap instead of drawing the gradient again.
+    CGSize size = self.bounds.size;
+    CGFloat scale = self.contentScaleFactor;
+    NSString *key = [NSString stringWithFormat:@"%lu|%@|%f|%f|%d|%f|%f|%f",
+                     (unsigned long)_colorStyle,
+                     NSStringFromCGSize(size),
+                     _arrowMidpoint,
+                     _arrowHeight,
+                     _pointingUp,
+                     _textPadding,
+                     _verticalCrossOffset,
+                     scale];
+    UIImage *chrome = [_chromeCache objectForKey:key];
+    if (!chrome) {
+        UIGraphicsBeginImageContextWithOptions(size, NO, scale);
+        [self _drawChromeWithOuterRect:outerRect];
+        chrome = UIGraphicsGetImageFromCurrentImageContext();
+        UIGraphicsEndImageContext();
+        if (chrome) {
+            [_chromeCache setObject:chrome forKey:key];
+        }
+    }
+    [chrome drawInRect:self.bounds];
+}
+
+- (CGRect)_outerRect
+{
     CGFloat arrowSideMargin = 1 + 0.5f * MAX(kNUXRectInset, _arrowHeight);
     CGFloat arrowYMarginOffset = _pointingUp ? arrowSideMargin : kNUXRectInset;
     CGFloat halfStroke = kNUXStrokeLineWidth / 2.0;
@@ -399,7 +439,11 @@ CGMutablePathRef _createCloseCrossGlyphWithRect(CGRect rect)
                                   arrowYMarginOffset + halfStroke,
                                   self.bounds.size.width - 2 * kNUXRectInset - kNUXStrokeLineWidth,
                                   self.bounds.size.height - kNUXRectInset - arrowSideMargin - kNUXStrokeLineWidth);
-    outerRect = CGRectInset(outerRect, 5, 5);
+    return CGRectInset(outerRect, 5, 5);
+}
+
+- (void)_drawChromeWithOuterRect:(CGRect)outerRect
+{
     CGRect innerRect = CGRectInset(outerRect, kNUXStrokeLineWidth, kNUXStrokeLineWidth);
     CGRect fillRect = CGRectInset(innerRect, kNUXStrokeLineWidth/2.0, kNUXStrokeLineWidth/2.0);
     CGFloat closeCrossGlyphPositionY = MIN(CGRectGetMinY(fillRect) + _textPadding + _verticalCrossOffset,
@@ -409,15 +453,11 @@ CGMutablePathRef _createCloseCrossGlyphWithRect(CGRect rect)
 
     // setup and get paths
     CGContextRef context = UIGraphicsGetCurrentContext();
-    CGMutablePathRef outerPath;
     CGMutablePathRef innerPath;
     CGMutablePathRef fillPath;
     CGMutablePathRef crossCloseGlyphPath = _createCloseCrossGlyphWithRect(closeCrossGlyphRect);
     CGRect gradientRect = fillRect;
     if (_pointingUp) {
-        outerPath = _createUpPointingBubbleWithRect(outerRect,
-                                                    _arrowMidpoint, _arrowHeight,
-                                                    kNUXCornerRadius + kNUXStrokeLineWidth);
         innerPath = _createUpPointingBubbleWithRect(innerRect,
                                                     _arrowMidpoint, _arrowHeight,
                                                     kNUXCornerRadius);
@@ -427,9 +467,6 @@ CGMutablePathRef _createCloseCrossGlyphWithRect(CGRect rect)
         gradientRect.origin.y -= _arrowHeight;
         gradientRect.size.height += _arrowHeight;
     } else {
-        outerPath = _createDownPointingBubbleWithRect(outerRect,
-                                                      _arrowMidpoint, _arrowHeight,
-                                                      kNUXCornerRadius + kNUXStrokeLineWidth);
         innerPath = _createDownPointingBubbleWithRect(innerRect,
                                                       _arrowMidpoint, _arrowHeight,
                                                       kNUXCornerRadius);
@@ -438,7 +475,6 @@ CGMutablePathRef _createCloseCrossGlyphWithRect(CGRect rect)
                                                      kNUXCornerRadius - kNUXStrokeLineWidth);
         gradientRect.size.height += _arrowHeight;
     }
-    self.layer.shadowPath = outerPath;
 
     // This tooltip has two borders, so draw two strokes and a fill.
     CGColorRef strokeColor = _innerStrokeColor.CGColor;
@@ -460,7 +496,6 @@ CGMutablePathRef _createCloseCrossGlyphWithRect(CGRect rect)
     CGContextFillPath(context);
     CGGradientRelease(gradient);
     CGContextRestoreGState(context);
-    CFRelease(outerPath);
     CFRelease(innerPath);
     CFRelease(fillPath);
     CFRelease(crossCloseGlyphPath);
@@ -70,3 +70,11 @@ FBSDK_STATIC_INLINE CGSize FBTextSize(NSString *text, UIFont *font, CGSize const
     }
     return CGSizeMake(ceilf(size.width), ceilf(size.height));
 }
+
+/*!
+ @abstract Same as FBTextSize, but remembers the sizes it has measured.
+
+ @discussion For views measured on every layout pass, such as those in table cells.  Sizes are
+ kept per text, font, constrained size and line break mode.
+ */
+FBSDK_EXTERN CGSize FBCachedTextSize(NSString *text, UIFont *font, CGSize constrainedSize, NSLineBreakMode lineBreakMode);
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBUIHelpers.h"
+
+CGSize FBCachedTextSize(NSString *text, UIFont *font, CGSize constrainedSize, NSLineBreakMode lineBreakMode)
+{
+    if (!text || !font) {
+        return FBTextSize(text, font, constrainedSize, lineBreakMode);
+    }
+
+    static NSCache *_cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _cache = [[NSCache alloc] init];
+        _cache.countLimit = 500;
+    });
+
+    NSString *key = [NSString stringWithFormat:@"%@|%f|%f|%f|%ld|%@",
+                     font.fontName,
+                     font.pointSize,
+                     constrainedSize.width,
+                     constrainedSize.height,
+                     (long)lineBreakMode,
+                     text];
+    NSValue *cachedSize = [_cache objectForKey:key];
+    if (cachedSize) {
+        return [cachedSize CGSizeValue];
+    }
+    CGSize size = FBTextSize(text, font, constrainedSize, lineBreakMode);
+    [_cache setObject:[NSValue valueWithCGSize:size] forKey:key];
+    return size;
+}
@@ -61,8 +61,11 @@
     };
     self.requestHandler = ^(FBRequestConnection *connection, id result, NSError *error) {
         if (result) {
-            weakSelf.me = result;
-            [weakSelf updateControls];
+            [FBSession.activeSessionIfOpen cacheUser:result];
+            if (![weakSelf.me isEqual:result]) {
+                weakSelf.me = result;
+                [weakSelf updateControls];
+            }
         }
     };
 }
@@ -288,7 +291,14 @@
                                                     20);
         self.profilePicture.hidden = NO;
 
-        // Do we know the user's name? If not, request it.
+        // Do we know the user's name? If not, show the one saved with the token, if any, and
+        // request it; the request shares the call with FBLoginView's, if that is in flight.
+        if (self.me == nil) {
+            self.me = [FBSession.activeSession cachedUser];
+            if (self.me != nil) {
+                [[FBRequest requestForMe] startWithCompletionHandler:self.requestHandler];
+            }
+        }
         if (self.me != nil) {
             self.connectedStateLabel.text = self.me.name;
             self.profilePicture.profileID = [self.me objectForKey:@"id"];
@@ -18,5 +18,10 @@
 
 @interface FBViewController (Internal)
 
+// Called when the controller dismisses itself, after cancellationToken has been replaced
+// and before the old token is cancelled. Subclasses cancel their own work here and move
+// it onto the new token, so nothing is left attached to the cancelled one.
+- (void)cancelNetworkWorkForToken:(FBCancellationToken *)token;
+
 @end
 
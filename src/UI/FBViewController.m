@@ -17,6 +17,7 @@
 #import "FBViewController.h"
 #import "FBViewController+Internal.h"
 
+#import "FBCancellationToken.h"
 #import "FBLogger.h"
 #import "FBSettings.h"
 
@@ -27,6 +28,7 @@
 @property (nonatomic, copy) FBModalCompletionHandler handler;
 @property (nonatomic) BOOL autoDismiss;
 @property (nonatomic) BOOL dismissAnimated;
+@property (nonatomic, retain) FBCancellationToken *cancellationToken;
 
 - (void)cancelButtonPressed:(id)sender;
 - (void)doneButtonPressed:(id)sender;
@@ -41,6 +43,8 @@
 #pragma mark View controller lifecycle
 
 - (void)commonInit {
+    self.cancellationToken = [FBCancellationToken cancellationToken];
+
     // We do this at init-time rather than in viewDidLoad so the caller can change the buttons if
     // they want prior to the view loading.
     self.cancelButton = [[[UIBarButtonItem alloc] initWithBarButtonSystemItem:UIBarButtonSystemItemCancel
@@ -96,6 +100,7 @@
     [_navigationBar release];
     [_canvasView release];
     [_handler release];
+    [_cancellationToken release];
 }
 
 #pragma mark View lifecycle
@@ -263,6 +268,7 @@
     UIViewController *presentingViewController = [self presentingViewController];
     if (self.autoDismiss && presentingViewController) {
         [presentingViewController dismissViewControllerAnimated:self.dismissAnimated completion:nil];
+        [self cancelNetworkWork];
 
         [self logAppEvents:YES];
         if (self.handler) {
@@ -280,6 +286,7 @@
     UIViewController *presentingViewController = [self presentingViewController];
     if (self.autoDismiss && presentingViewController) {
         [presentingViewController dismissViewControllerAnimated:self.dismissAnimated completion:nil];
+        [self cancelNetworkWork];
 
         [self logAppEvents:NO];
         if (self.handler) {
@@ -289,6 +296,19 @@
     }
 }
 
+// Nothing on a dismissed screen needs its results any more; a new token covers
+// anything loaded if it is shown again.
+- (void)cancelNetworkWork {
+    FBCancellationToken *token = [[self.cancellationToken retain] autorelease];
+    self.cancellationToken = [FBCancellationToken cancellationToken];
+    [self cancelNetworkWorkForToken:token];
+    [token cancel];
+}
+
+- (void)cancelNetworkWorkForToken:(FBCancellationToken *)token {
+    // Subclasses with a loader and data source detach them here.
+}
+
 - (void)logAppEvents:(BOOL)cancelled {
     // Internal subclasses that will implicitly log app events will do so here.
 }
@@ -315,4 +315,8 @@
                                           handler:handler];
 }
 
++ (void)prewarm {
+    [FBDialog prewarm];
+}
+
 @end
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <OCMock/OCMock.h>
+
+#import "FBAppBridgeScheme.h"
+#import "FBTests.h"
+
+@interface FBAppBridgeSchemeTests : FBTests
+@end
+
+@implementation FBAppBridgeSchemeTests
+{
+    id _mockApplication;
+    id _anotherMockApplication;
+    NSMutableArray *_probedURLs;
+    BOOL _installed;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    _probedURLs = [[NSMutableArray alloc] init];
+    _installed = NO;
+
+    // As in FBAppBridgeTests, a second mock stubs +sharedApplication without a circular reference
+    _mockApplication = [OCMockObject niceMockForClass:[UIApplication class]];
+    _anotherMockApplication = [OCMockObject mockForClass:[UIApplication class]];
+    [[[_anotherMockApplication stub] andReturn:_mockApplication] sharedApplication];
+    [[[_mockApplication stub] andDo:^(NSInvocation *invocation) {
+        NSURL *url = nil;
+        [invocation getArgument:&url atIndex:2];
+        [_probedURLs addObject:url];
+        BOOL installed = _installed;
+        [invocation setReturnValue:&installed];
+    }] canOpenURL:OCMOCK_ANY];
+
+    // Start from an empty cache
+    [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationDidBecomeActiveNotification object:nil];
+}
+
+- (void)tearDown
+{
+    [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationDidBecomeActiveNotification object:nil];
+    _mockApplication = nil;
+    _anotherMockApplication = nil;
+    [_probedURLs release];
+    _probedURLs = nil;
+    [super tearDown];
+}
+
+- (void)testMissingAppIsProbedOnceUntilTheAppBecomesActive
+{
+    STAssertNil([FBAppBridgeScheme bridgeSchemeForFBAppForLike], nil);
+    NSUInteger probeCount = _probedURLs.count;
+    STAssertTrue(probeCount > 0, @"versions probed");
+
+    _installed = YES;
+    STAssertNil([FBAppBridgeScheme bridgeSchemeForFBAppForLike], @"missing app remembered");
+    STAssertEquals(_probedURLs.count, probeCount, @"no further probes");
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationDidBecomeActiveNotification object:nil];
+    STAssertEqualObjects([FBAppBridgeScheme bridgeSchemeForFBAppForLike].version, @"20140410", @"newest version found");
+    STAssertEquals(_probedURLs.count, probeCount + 1, @"probed again after becoming active");
+
+    STAssertEqualObjects([FBAppBridgeScheme bridgeSchemeForFBAppForLike].version, @"20140410", nil);
+    STAssertEquals(_probedURLs.count, probeCount + 1, @"installed version remembered");
+}
+
+- (void)testURLCarriesTheQueryThenTheVersion
+{
+    _installed = YES;
+    FBAppBridgeScheme *scheme = [FBAppBridgeScheme bridgeSchemeForFBAppForLike];
+    NSData *json = [@"{\"a\":\"b c\"}" dataUsingEncoding:NSUTF8StringEncoding];
+
+    STAssertEqualObjects([[scheme urlForMethod:@"share" queryParams:@{@"method_args": json}] absoluteString],
+                         @"fbapi://dialog/share?method_args=%7B%22a%22%3A%22b%20c%22%7D&version=20140410", nil);
+    STAssertEqualObjects([[scheme urlForMethod:@"share" queryParams:nil] absoluteString],
+                         @"fbapi://dialog/share?version=20140410", nil);
+}
+
+- (void)testMessengerIsCachedSeparatelyFromTheFacebookApp
+{
+    _installed = YES;
+    STAssertNotNil([FBAppBridgeScheme bridgeSchemeForFBAppForShareDialogPhotos], nil);
+    STAssertEquals(_probedURLs.count, (NSUInteger)1, nil);
+
+    STAssertNotNil([FBAppBridgeScheme bridgeSchemeForFBMessengerForShareDialogPhotos], nil);
+    STAssertEquals(_probedURLs.count, (NSUInteger)2, @"same method and a different app is probed");
+    STAssertEqualObjects([[_probedURLs lastObject] scheme], @"fb-messenger-api20140430", nil);
+
+    [FBAppBridgeScheme bridgeSchemeForFBAppForShareDialogPhotos];
+    [FBAppBridgeScheme bridgeSchemeForFBMessengerForShareDialogPhotos];
+    STAssertEquals(_probedURLs.count, (NSUInteger)2, @"both results remembered");
+}
+
+@end
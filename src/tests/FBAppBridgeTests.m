@@ -20,11 +20,15 @@
 
 #import "FBAppBridge.h"
 #import "FBAppBridgeScheme.h"
+#import "FBAppBridgeTypeToJSONConverter.h"
 #import "FBAppCall+Internal.h"
+#import "FBBase64.h"
+#import "FBCrypto.h"
 #import "FBDialogsData+Internal.h"
 #import "FBError.h"
 #import "FBIsStringRepresentingJSONDictionary.h"
 #import "FBIsURLHavingQueryParams.h"
+#import "FBSettings+Internal.h"
 #import "FBSettings.h"
 #import "FBTestBlocker.h"
 #import "FBUtility.h"
@@ -46,13 +50,22 @@ static NSString *const kNonAppBridgeAppCallURL = @"fb123456789://link?meal=Chick
 
 @property (nonatomic, retain) NSMutableDictionary *pendingAppCalls;
 @property (nonatomic, retain) NSMutableDictionary *callbacks;
+@property (nonatomic, copy) NSString *bundleID;
 
 + (NSString *)symmetricKeyAndForceRefresh:(BOOL)forceRefresh;
 
+- (NSDictionary *)decryptUrlQueryParams:(NSDictionary *)cipherParams
+                                 method:(NSString *)method
+                        fallbackHandler:(FBAppCallHandler)fallbackHandler;
+
 - (void)performDialogAppCall:(FBAppCall *)appCall
                 bridgeScheme:(FBAppBridgeScheme *)bridgeScheme
                      session:(FBSession *)session
            completionHandler:(FBAppCallHandler)handler;
+
+- (void)applicationDidEnterBackground:(NSNotification *)notification;
+- (void)savePasteboardNames:(NSArray *)pasteboardNames forAppCallID:(NSString *)appCallID;
+- (void)deletePasteboardsForAppCallID:(NSString *)appCallID;
 @end
 
 @implementation FBAppBridgeTests
@@ -337,6 +350,33 @@ static NSString *const kNonAppBridgeAppCallURL = @"fb123456789://link?meal=Chick
     assertThat(appBridge.callbacks, hasKey(appCall.ID));
 }
 
+- (void)testOldestPendingAppCallIsCancelledWhenTooManyArePending {
+    BOOL yes = YES;
+    [[[_mockApplication stub] andReturnValue:OCMOCK_VALUE(yes)] canOpenURL:OCMOCK_ANY];
+    [[[_mockApplication stub] andReturnValue:OCMOCK_VALUE(yes)] openURL:OCMOCK_ANY];
+
+    FBAppBridge *appBridge = [[[FBAppBridge alloc] init] autorelease];
+    FBAppCall *firstCall = [self newAppCall:YES];
+    NSError *__block firstCallError = nil;
+    [appBridge performDialogAppCall:firstCall
+                       bridgeScheme:testBridgeScheme
+                            session:nil
+                  completionHandler:^(FBAppCall *call) {
+                      firstCallError = call.error;
+                  }];
+
+    for (int i = 0; i < 8; i++) {
+        [appBridge performDialogAppCall:[self newAppCall:YES]
+                           bridgeScheme:testBridgeScheme
+                                session:nil
+                      completionHandler:nil];
+    }
+
+    assertThat(appBridge.pendingAppCalls, isNot(hasKey(firstCall.ID)));
+    assertThatInteger(appBridge.pendingAppCalls.count, equalToInteger(8));
+    assertThat(firstCallError, notNilValue());
+}
+
 - (void)testAppCallIsNotTrackedOnFailedOpen {
     BOOL no = NO;
     [[_mockApplication expect] canOpenURL:[NSURL URLWithString:@"fbapi://"]];
@@ -657,12 +697,211 @@ static NSString *const kNonAppBridgeAppCallURL = @"fb123456789://link?meal=Chick
     assertThat(appBridge.callbacks, isNot(hasKey(appCall.ID)));
 }
 
+#pragma mark Prepared call tests
+
+- (void)waitForPreparedCall:(FBAppBridgePreparedCall *)preparedCall {
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:5];
+    while (!preparedCall.finished && [deadline timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                                 beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    assertThatBool(preparedCall.finished, equalToBool(YES));
+}
+
+- (void)testPresentingAPreparedCallOpensThePreparedURL {
+    BOOL yes = YES;
+    // only the preparation builds the URL
+    [[_mockApplication expect] canOpenURL:[NSURL URLWithString:@"fbapi://"]];
+
+    FBAppCall *appCall = [self newAppCall:YES];
+    FBAppBridge *appBridge = [[[FBAppBridge alloc] init] autorelease];
+    [appBridge prepareDialogAppCall:appCall bridgeScheme:testBridgeScheme session:nil];
+    FBAppBridgePreparedCall *preparedCall = appCall.preparedBridgeCall;
+    assertThat(preparedCall, notNilValue());
+    [self waitForPreparedCall:preparedCall];
+    assertThat(preparedCall.url, notNilValue());
+
+    [[[_mockApplication expect] andReturnValue:OCMOCK_VALUE(yes)] openURL:preparedCall.url];
+    [appBridge performDialogAppCall:appCall
+                       bridgeScheme:testBridgeScheme
+                            session:nil
+                  completionHandler:^(FBAppCall *call) {}];
+
+    [_mockApplication verify];
+    assertThat(appCall.preparedBridgeCall, nilValue());
+    assertThat(appBridge.callbacks, hasKey(appCall.ID));
+}
+
+- (void)testCallPresentedBeforePreparationFinishesOpensWhenItDoes {
+    BOOL yes = YES;
+    [[_mockApplication expect] canOpenURL:[NSURL URLWithString:@"fbapi://"]];
+    [[[_mockApplication expect] andReturnValue:OCMOCK_VALUE(yes)] openURL:OCMOCK_ANY];
+
+    FBAppCall *appCall = [self newAppCall:YES];
+    FBAppBridge *appBridge = [[[FBAppBridge alloc] init] autorelease];
+    [appBridge prepareDialogAppCall:appCall bridgeScheme:testBridgeScheme session:nil];
+    FBAppBridgePreparedCall *preparedCall = [[appCall.preparedBridgeCall retain] autorelease];
+
+    // the preparation can't finish before the main queue runs again
+    [appBridge performDialogAppCall:appCall
+                       bridgeScheme:testBridgeScheme
+                            session:nil
+                  completionHandler:^(FBAppCall *call) {}];
+    assertThat(appBridge.callbacks, isNot(hasKey(appCall.ID)));
+    assertThat(preparedCall.pendingHandler, notNilValue());
+
+    [self waitForPreparedCall:preparedCall];
+
+    [_mockApplication verify];
+    assertThat(appBridge.callbacks, hasKey(appCall.ID));
+    assertThat(appCall.preparedBridgeCall, nilValue());
+}
+
+- (void)testCallPreparedForAnotherSchemeIsRebuilt {
+    BOOL yes = YES;
+    // once for the preparation, once for the rebuild
+    [[_mockApplication expect] canOpenURL:[NSURL URLWithString:@"fbapi://"]];
+    [[_mockApplication expect] canOpenURL:[NSURL URLWithString:@"fbapi://"]];
+    [[[_mockApplication expect] andReturnValue:OCMOCK_VALUE(yes)] openURL:OCMOCK_ANY];
+
+    FBAppCall *appCall = [self newAppCall:YES];
+    FBAppBridge *appBridge = [[[FBAppBridge alloc] init] autorelease];
+    [appBridge prepareDialogAppCall:appCall bridgeScheme:testBridgeScheme session:nil];
+    [self waitForPreparedCall:appCall.preparedBridgeCall];
+
+    FBAppBridgeScheme *otherScheme = [[[FBAppBridgeScheme alloc] init] autorelease];
+    [appBridge performDialogAppCall:appCall
+                       bridgeScheme:otherScheme
+                            session:nil
+                  completionHandler:^(FBAppCall *call) {}];
+
+    [_mockApplication verify];
+    assertThat(appCall.preparedBridgeCall, nilValue());
+}
+
 #pragma mark Encryption/decryption tests
 
-// TODO
+// The cipher params the Facebook app would send back for plainText
+- (NSDictionary *)cipherParamsForQuery:(NSString *)plainText appBridge:(FBAppBridge *)appBridge {
+    NSString *signedData = [@[appBridge.bundleID, kTestAppID, @"bridge", kTestDialogMethod, @"1"] componentsJoinedByString:@":"];
+    FBCrypto *crypto = [[[FBCrypto alloc] initWithMasterKey:[FBAppBridge symmetricKeyAndForceRefresh:NO]] autorelease];
+    NSString *cipherText = [crypto encrypt:[plainText dataUsingEncoding:NSUTF8StringEncoding]
+                      additionalDataToSign:[signedData dataUsingEncoding:NSUTF8StringEncoding]];
+    return @{@"cipher": cipherText, @"version": @"1"};
+}
+
+- (void)testDecryptedQueryIsParsedAndDecoded {
+    FBAppBridge *appBridge = [[[FBAppBridge alloc] init] autorelease];
+    appBridge.bundleID = kTestNonFacebookBundleIdentifier;
+    NSString *query = @"bridge_args=%7B%22action_id%22%3A%22abc%22%7D&plain=a+b%20c&empty=&=orphan&method_results=%7B%7D";
+
+    NSDictionary *params = [appBridge decryptUrlQueryParams:[self cipherParamsForQuery:query appBridge:appBridge]
+                                                     method:kTestDialogMethod
+                                            fallbackHandler:nil];
+
+    assertThat(params[@"bridge_args"], equalTo([@"{\"action_id\":\"abc\"}" dataUsingEncoding:NSUTF8StringEncoding]));
+    assertThat(params[@"method_results"], equalTo([@"{}" dataUsingEncoding:NSUTF8StringEncoding]));
+    assertThat(params[@"plain"], equalTo(@"a b c"));
+    assertThat(params[@"empty"], equalTo(@""));
+    assertThat(params[@"version"], equalTo(@"1"));
+    assertThatUnsignedInteger(params.count, equalToUnsignedInteger(5));
+}
+
+- (void)testEscapeSplitAcrossDecryptedChunksIsDecoded {
+    FBAppBridge *appBridge = [[[FBAppBridge alloc] init] autorelease];
+    appBridge.bundleID = kTestNonFacebookBundleIdentifier;
+    // puts the '%' of the escape at the last byte of the first 64KB chunk
+    NSString *padding = [@"" stringByPaddingToLength:64 * 1024 - 1 - 6 withString:@"a" startingAtIndex:0];
+    NSString *query = [NSString stringWithFormat:@"plain=%@%%41&bridge_args=%%7B%%7D", padding];
+
+    NSDictionary *params = [appBridge decryptUrlQueryParams:[self cipherParamsForQuery:query appBridge:appBridge]
+                                                     method:kTestDialogMethod
+                                            fallbackHandler:nil];
+
+    assertThat(params[@"plain"], equalTo([padding stringByAppendingString:@"A"]));
+    assertThat(params[@"bridge_args"], equalTo([@"{}" dataUsingEncoding:NSUTF8StringEncoding]));
+}
+
+- (void)testQuerySignedForAnotherMethodIsRejected {
+    FBAppBridge *appBridge = [[[FBAppBridge alloc] init] autorelease];
+    appBridge.bundleID = kTestNonFacebookBundleIdentifier;
+    NSDictionary *cipherParams = [self cipherParamsForQuery:@"plain=a" appBridge:appBridge];
+
+    assertThat([appBridge decryptUrlQueryParams:cipherParams method:@"other_dialog" fallbackHandler:nil], nilValue());
+}
 
 #pragma mark Pasteboard tests
 
-// TODO
+- (void)testLargeDataIsPassedOnPasteboard {
+    NSMutableData *largeData = [NSMutableData dataWithLength:256 * 1024];
+    NSData *smallData = [@"small" dataUsingEncoding:NSUTF8StringEncoding];
+    NSDictionary *arguments = @{@"large": largeData, @"small": smallData};
+
+    FBAppBridgeTypeToJSONConverter *converter = [[[FBAppBridgeTypeToJSONConverter alloc] init] autorelease];
+    NSDictionary *json = [converter jsonDictionaryFromDictionaryWithAppBridgeTypes:arguments];
+
+    assertThatInteger(converter.createdPasteboardNames.count, equalToInteger(1));
+    assertThat(json[@"large"][@"isPasteboard"], equalTo(@YES));
+    assertThat(json[@"large"][@"isBase64"], nilValue());
+    assertThat(json[@"small"][@"isBase64"], equalTo(@YES));
+
+    // reading the attachment back consumes the pasteboard
+    NSDictionary *roundTripped = [converter dictionaryWithAppBridgeTypesFromJSONDictionary:json];
+    assertThat(roundTripped[@"large"], equalTo(largeData));
+    assertThat(roundTripped[@"small"], equalTo(smallData));
+    assertThat([UIPasteboard pasteboardWithName:converter.createdPasteboardNames[0] create:NO], nilValue());
+}
+
+- (void)testPasteboardNamesAreSavedWhenEnteringTheBackground {
+    NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
+    [userDefaults setObject:@{@"saved-call": @[@"saved-board"]} forKey:@"FBAppBridgePasteboards"];
+
+    UIBackgroundTaskIdentifier taskID = 42;
+    [[[_mockApplication stub] andReturnValue:OCMOCK_VALUE(taskID)] beginBackgroundTaskWithExpirationHandler:OCMOCK_ANY];
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    [[[_mockApplication expect] andDo:^(NSInvocation *invocation) {
+        [blocker signal];
+    }] endBackgroundTask:taskID];
+
+    FBAppBridge *appBridge = [[[FBAppBridge alloc] init] autorelease];
+    [appBridge savePasteboardNames:@[@"new-board"] forAppCallID:@"new-call"];
+    [appBridge deletePasteboardsForAppCallID:@"saved-call"];
+    // nothing is written until the app goes to the background
+    assertThat([userDefaults objectForKey:@"FBAppBridgePasteboards"], equalTo(@{@"saved-call": @[@"saved-board"]}));
+
+    [appBridge applicationDidEnterBackground:nil];
+    STAssertTrue([blocker waitWithTimeout:5], @"background task ended");
+    [_mockApplication verify];
+    assertThat([userDefaults objectForKey:@"FBAppBridgePasteboards"], equalTo(@{@"new-call": @[@"new-board"]}));
+
+    // with nothing changed since, entering the background again writes nothing
+    [userDefaults removeObjectForKey:@"FBAppBridgePasteboards"];
+    [appBridge applicationDidEnterBackground:nil];
+    [self waitForMainQueueToFinish];
+    assertThat([userDefaults objectForKey:@"FBAppBridgePasteboards"], nilValue());
+}
+
+- (void)testNestedAttachmentsAreEncodedUpFront {
+    UIGraphicsBeginImageContextWithOptions(CGSizeMake(20, 10), YES, 1);
+    UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+    // Has no bitmap, so can't be encoded
+    UIImage *emptyImage = [[[UIImage alloc] init] autorelease];
+    NSData *data = [@"nested" dataUsingEncoding:NSUTF8StringEncoding];
+    NSDictionary *arguments = @{@"photos": @[image, emptyImage],
+                                @"object": @{@"data": data}};
+
+    FBAppBridgeTypeToJSONConverter *converter = [[[FBAppBridgeTypeToJSONConverter alloc] init] autorelease];
+    NSDictionary *json = [converter jsonDictionaryFromDictionaryWithAppBridgeTypes:arguments];
+
+    NSData *imageData = UIImageJPEGRepresentation(image, [FBSettings defaultJPEGCompressionQuality]);
+    assertThat(json[@"photos"][0][@"tag"], equalTo(@"png"));
+    assertThat(json[@"photos"][0][@"fbAppBridgeType_jsonReadyValue"], equalTo(FBEncodeBase64(imageData)));
+    assertThat(json[@"photos"][1][@"isBase64"], equalTo(@YES));
+    assertThat(json[@"photos"][1][@"fbAppBridgeType_jsonReadyValue"], equalTo(@""));
+    assertThat(json[@"object"][@"data"][@"tag"], equalTo(@"data"));
+    assertThat(json[@"object"][@"data"][@"fbAppBridgeType_jsonReadyValue"], equalTo(FBEncodeBase64(data)));
+    assertThatInteger(converter.createdPasteboardNames.count, equalToInteger(0));
+}
 
 @end
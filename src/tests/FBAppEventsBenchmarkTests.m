@@ -0,0 +1,280 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import <malloc/malloc.h>
+
+#import "FBAppEvents+Internal.h"
+#import "FBRequest.h"
+#import "FBRequestConnection.h"
+#import "FBSession+Internal.h"
+#import "FBSessionAppEventsState.h"
+#import "FBSessionManualTokenCachingStrategy.h"
+#import "FBUtility.h"
+
+// Throughput run for FBAppEvents, logging a game-like mix of events from several threads
+// to see how the buffering holds up. Like FBBenchmarkTests it only runs when
+// FB_RUN_BENCHMARKS is set. FB_APP_EVENTS_BENCHMARK_THREADS and
+// FB_APP_EVENTS_BENCHMARK_EVENTS set the number of logging threads and the events each
+// logs; FB_APP_EVENTS_BENCHMARK_RATE caps each thread at that many events per second,
+// and leaving it unset logs as fast as possible.
+static NSString *const kFBBenchmarkRunKey = @"FB_RUN_BENCHMARKS";
+static NSString *const kFBAppEventsBenchmarkThreadsKey = @"FB_APP_EVENTS_BENCHMARK_THREADS";
+static NSString *const kFBAppEventsBenchmarkEventsKey = @"FB_APP_EVENTS_BENCHMARK_EVENTS";
+static NSString *const kFBAppEventsBenchmarkRateKey = @"FB_APP_EVENTS_BENCHMARK_RATE";
+static const NSUInteger kFBAppEventsBenchmarkDefaultThreads = 4;
+static const NSUInteger kFBAppEventsBenchmarkDefaultEvents = 5000;
+
+static int FBAppEventsBenchmarkCompareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts the samples in place
+static double FBAppEventsBenchmarkPercentile(double *samples, NSUInteger count, double percentile)
+{
+    if (count == 0) {
+        return 0;
+    }
+    qsort(samples, count, sizeof(double), FBAppEventsBenchmarkCompareDoubles);
+    NSUInteger index = MIN(count - 1, (NSUInteger)(percentile * count));
+    return samples[index];
+}
+
+static size_t FBAppEventsBenchmarkBytesInUse(void)
+{
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(NULL, &statistics);
+    return statistics.size_in_use;
+}
+
+static NSUInteger FBAppEventsBenchmarkEnvironmentValue(NSString *key, NSUInteger defaultValue)
+{
+    NSInteger value = [[[[NSProcessInfo processInfo] environment] objectForKey:key] integerValue];
+    return value > 0 ? (NSUInteger)value : defaultValue;
+}
+
+// Private to FBAppEvents; the benchmark drives the flush steps one at a time
+@interface FBAppEvents (FBAppEventsBenchmarkTests)
+
+@property (readwrite, atomic, assign) dispatch_queue_t flushQueue;
+
++ (FBSession *)unaffinitizedSessionFromToken:(FBSessionTokenCachingStrategy *)tokenCachingStrategy
+                                       appID:(NSString *)appID;
++ (void)persistAppEventsData:(FBSessionAppEventsState *)appEventsState;
+- (NSDictionary *)prepareUploadForSession:(FBSession *)session;
+- (void)appendAttributionAndAdvertiserIDs:(NSMutableDictionary *)postParameters
+                                  session:(FBSession *)session;
+
+@end
+
+@interface FBAppEventsBenchmarkTests : SenTestCase
+
+@end
+
+@implementation FBAppEventsBenchmarkTests
+{
+    FBSession *_session;
+    FBAppEventsFlushBehavior _savedFlushBehavior;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    // A session with a token of its own, so the events land in its state rather than a shared one
+    FBSessionManualTokenCachingStrategy *tokenCaching = [[[FBSessionManualTokenCachingStrategy alloc] init] autorelease];
+    tokenCaching.accessToken = @"FBAppEventsBenchmarkTests|token";
+    tokenCaching.expirationDate = [NSDate dateWithTimeIntervalSinceNow:3600];
+    _session = [[FBAppEvents unaffinitizedSessionFromToken:tokenCaching appID:@"1234567890"] retain];
+
+    // Nothing goes out over the network; the flush steps are driven by hand
+    _savedFlushBehavior = [FBAppEvents flushBehavior];
+    [FBAppEvents setFlushBehavior:FBAppEventsFlushBehaviorExplicitOnly];
+}
+
+- (void)tearDown
+{
+    // Acknowledge everything, so none of it is recovered from the journal later
+    FBSessionAppEventsState *appEventsState = _session.appEventsState;
+    [appEventsState closeAggregationWindow];
+    while ([appEventsState getSpilledEventCount] || [appEventsState getAccumulatedEventCount]) {
+        [appEventsState restoreSpilledEvents];
+        [appEventsState moveAccumulatedEventsInFlight];
+        [appEventsState clearInFlightAndStats];
+    }
+    [appEventsState clearInFlightAndStats];
+    appEventsState.requestInFlight = NO;
+
+    [FBAppEvents setFlushBehavior:_savedFlushBehavior];
+    [_session release];
+    _session = nil;
+
+    [super tearDown];
+}
+
+- (BOOL)benchmarksEnabled
+{
+    return [[[NSProcessInfo processInfo] environment] objectForKey:kFBBenchmarkRunKey] != nil;
+}
+
+// Roughly what a game logs: frequent rounds and levels, some currency spending, and the odd purchase
+- (void)logGameEvent:(NSUInteger)index
+{
+    FBSession *session = _session;
+    uint32_t roll = arc4random_uniform(100);
+    if (roll < 50) {
+        [FBAppEvents logEvent:@"round_completed"
+                   valueToSum:[NSNumber numberWithUnsignedInt:arc4random_uniform(10000)]
+                   parameters:@{@"mode" : (index % 3 ? @"arcade" : @"ranked"),
+                                @"map" : [NSString stringWithFormat:@"map_%u", arc4random_uniform(12)],
+                                @"duration_seconds" : [NSNumber numberWithUnsignedInt:30 + arc4random_uniform(600)],
+                                @"won" : (roll % 2 ? FBAppEventParameterValueYes : FBAppEventParameterValueNo),
+                                }
+                      session:session];
+    } else if (roll < 75) {
+        [FBAppEvents logEvent:FBAppEventNameAchievedLevel
+                   valueToSum:nil
+                   parameters:@{FBAppEventParameterNameLevel : [NSString stringWithFormat:@"%u", 1 + arc4random_uniform(99)]}
+                      session:session];
+    } else if (roll < 90) {
+        [FBAppEvents logEvent:FBAppEventNameSpentCredits
+                   valueToSum:[NSNumber numberWithUnsignedInt:10 + arc4random_uniform(490)]
+                   parameters:@{FBAppEventParameterNameContentType : @"powerup",
+                                FBAppEventParameterNameContentID : [NSString stringWithFormat:@"item_%u", arc4random_uniform(40)],
+                                }
+                      session:session];
+    } else if (roll < 98) {
+        [FBAppEvents logEvent:FBAppEventNameUnlockedAchievement
+                   valueToSum:nil
+                   parameters:@{FBAppEventParameterNameDescription : [NSString stringWithFormat:@"achievement_%u", arc4random_uniform(200)]}
+                      session:session];
+    } else {
+        [FBAppEvents logEvent:FBAppEventNamePurchased
+                   valueToSum:[NSNumber numberWithDouble:0.99 + arc4random_uniform(20)]
+                   parameters:@{FBAppEventParameterNameCurrency : @"USD",
+                                FBAppEventParameterNameNumItems : [NSNumber numberWithUnsignedInt:1 + arc4random_uniform(5)],
+                                FBAppEventParameterNameContentType : @"gem_pack",
+                                }
+                      session:session];
+    }
+}
+
+- (void)testLoggingThroughput
+{
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+
+    NSUInteger threadCount = FBAppEventsBenchmarkEnvironmentValue(kFBAppEventsBenchmarkThreadsKey,
+                                                                  kFBAppEventsBenchmarkDefaultThreads);
+    NSUInteger eventsPerThread = FBAppEventsBenchmarkEnvironmentValue(kFBAppEventsBenchmarkEventsKey,
+                                                                      kFBAppEventsBenchmarkDefaultEvents);
+    NSUInteger rate = FBAppEventsBenchmarkEnvironmentValue(kFBAppEventsBenchmarkRateKey, 0);
+    NSUInteger sampleCount = threadCount * eventsPerThread;
+    FBSessionAppEventsState *appEventsState = _session.appEventsState;
+
+    // Gets the one-time setup, like reading back the journal, out of the way
+    @autoreleasepool {
+        [self logGameEvent:0];
+    }
+    size_t bytesBefore = FBAppEventsBenchmarkBytesInUse();
+
+    // Each thread writes its own stretch of the samples
+    double *samples = calloc(sampleCount, sizeof(double));
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    NSTimeInterval start = [FBUtility monotonicTime];
+    for (NSUInteger t = 0; t < threadCount; t++) {
+        double *threadSamples = samples + t * eventsPerThread;
+        dispatch_group_async(group, queue, ^{
+            NSTimeInterval threadStart = [FBUtility monotonicTime];
+            for (NSUInteger i = 0; i < eventsPerThread; i++) {
+                if (rate) {
+                    NSTimeInterval wait = threadStart + (double)i / rate - [FBUtility monotonicTime];
+                    if (wait > 0) {
+                        usleep((useconds_t)(wait * 1000000));
+                    }
+                }
+                @autoreleasepool {
+                    NSTimeInterval callStart = [FBUtility monotonicTime];
+                    [self logGameEvent:i];
+                    threadSamples[i] = ([FBUtility monotonicTime] - callStart) * 1000000;
+                }
+            }
+        });
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+    NSTimeInterval elapsed = [FBUtility monotonicTime] - start;
+
+    double p50 = FBAppEventsBenchmarkPercentile(samples, sampleCount, 0.5);
+    double p99 = FBAppEventsBenchmarkPercentile(samples, sampleCount, 0.99);
+    double maximum = samples[sampleCount - 1];
+    free(samples);
+
+    size_t bytesAfter = FBAppEventsBenchmarkBytesInUse();
+    NSUInteger accumulated = [appEventsState getAccumulatedEventCount];
+    NSUInteger spilled = [appEventsState getSpilledEventCount];
+    NSUInteger skipped = [appEventsState getNumSkippedEvents];
+    NSLog(@"FBAppEventsBenchmark logEvent: %lu threads, %.0f events/sec, p50 %.1f us, p99 %.1f us, max %.1f us",
+          (unsigned long)threadCount, sampleCount / elapsed, p50, p99, maximum);
+    NSLog(@"FBAppEventsBenchmark buffers: %lu accumulated, %lu spilled, %lu skipped, %.1f KB retained (%.0f bytes per buffered event)",
+          (unsigned long)accumulated, (unsigned long)spilled, (unsigned long)skipped,
+          ((double)bytesAfter - bytesBefore) / 1024,
+          accumulated ? ((double)bytesAfter - bytesBefore) / accumulated : 0);
+
+    // Every event was either kept somewhere or counted as skipped
+    STAssertTrue(accumulated + spilled + skipped >= sampleCount, @"events went missing");
+
+    // What a flush and a deactivation cost.  Persisting and starting the upload run on the main
+    // thread, preparing the upload on the flush queue.
+    FBAppEvents *appEvents = [FBAppEvents singleton];
+    start = [FBUtility monotonicTime];
+    [FBAppEvents persistAppEventsData:appEventsState];
+    NSTimeInterval persistTime = [FBUtility monotonicTime] - start;
+
+    __block NSDictionary *upload = nil;
+    __block NSTimeInterval prepareTime = 0;
+    dispatch_sync(appEvents.flushQueue, ^{
+        NSTimeInterval prepareStart = [FBUtility monotonicTime];
+        upload = [[appEvents prepareUploadForSession:_session] retain];
+        prepareTime = [FBUtility monotonicTime] - prepareStart;
+    });
+    STAssertNotNil(upload, @"expected events to upload");
+
+    // The same request building the flush does on the main thread, up to serializing the body
+    start = [FBUtility monotonicTime];
+    NSMutableDictionary *postParameters = [upload objectForKey:@"parameters"];
+    [appEvents appendAttributionAndAdvertiserIDs:postParameters session:_session];
+    FBRequest *request = [[[FBRequest alloc] initWithSession:_session
+                                                   graphPath:[NSString stringWithFormat:@"%@/activities", _session.appID]
+                                                  parameters:postParameters
+                                                  HTTPMethod:@"POST"] autorelease];
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:request completionHandler:nil];
+    [connection urlRequest];
+    NSTimeInterval requestTime = [FBUtility monotonicTime] - start;
+
+    NSLog(@"FBAppEventsBenchmark flush of %@ events: persist %.2f ms and request %.2f ms on the main thread, prepare %.2f ms on the flush queue",
+          [upload objectForKey:@"eventCount"], persistTime * 1000, requestTime * 1000, prepareTime * 1000);
+    [upload release];
+}
+
+@end
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import "FBAppEventsFlushPolicy.h"
+
+// Pins the conditions the policy reacts to
+@interface FBAppEventsTestFlushPolicy : FBAppEventsFlushPolicy
+
+@property (nonatomic, assign) BOOL reachable;
+@property (nonatomic, assign) BOOL batteryLow;
+
+@end
+
+@implementation FBAppEventsTestFlushPolicy
+
+- (BOOL)isNetworkReachable {
+    return self.reachable;
+}
+
+- (BOOL)isBatteryLow {
+    return self.batteryLow;
+}
+
+@end
+
+@interface FBAppEventsFlushPolicyTests : SenTestCase
+@end
+
+@implementation FBAppEventsFlushPolicyTests
+{
+    FBAppEventsTestFlushPolicy *_policy;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    _policy = [[FBAppEventsTestFlushPolicy alloc] init];
+    _policy.reachable = YES;
+}
+
+- (void)tearDown
+{
+    [_policy release];
+    _policy = nil;
+    [super tearDown];
+}
+
+- (void)testFlushesPastTheThreshold
+{
+    STAssertFalse([_policy shouldFlushWithPendingEventCount:100], nil);
+    STAssertTrue([_policy shouldFlushWithPendingEventCount:101], nil);
+    STAssertEquals((NSTimeInterval)60, [_policy flushIntervalWithPendingEventCount:0], nil);
+}
+
+- (void)testHoldsFlushesWhileUnreachable
+{
+    _policy.reachable = NO;
+    STAssertFalse([_policy shouldFlushWithPendingEventCount:999], @"an unreachable network should hold back flushes");
+}
+
+- (void)testBatchesMoreOnALowBattery
+{
+    _policy.batteryLow = YES;
+    STAssertFalse([_policy shouldFlushWithPendingEventCount:101], @"a low battery should raise the threshold");
+    STAssertTrue([_policy shouldFlushWithPendingEventCount:401], nil);
+    STAssertEquals((NSTimeInterval)240, [_policy flushIntervalWithPendingEventCount:0], nil);
+}
+
+- (void)testDrainsABacklogSooner
+{
+    _policy.batteryLow = YES;
+    // Half the buffer outweighs the battery
+    STAssertTrue([_policy shouldFlushWithPendingEventCount:500], nil);
+    STAssertEquals((NSTimeInterval)15, [_policy flushIntervalWithPendingEventCount:500], nil);
+
+    _policy.flushPeriod = 10;
+    STAssertEquals((NSTimeInterval)5, [_policy flushIntervalWithPendingEventCount:500], @"the interval should not drop below the minimum");
+}
+
+@end
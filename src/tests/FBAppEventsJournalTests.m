@@ -0,0 +1,251 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBAppEventsJournalTests.h"
+#import "FBAppEventsJournal.h"
+#import "FBSessionAppEventsState.h"
+
+@implementation FBAppEventsJournalTests
+{
+    NSString *_journalPath;
+}
+
+#pragma mark - Setup/Teardown
+
+- (void)setUp
+{
+    [super setUp];
+
+    _journalPath = [[NSTemporaryDirectory() stringByAppendingPathComponent:
+                     [NSString stringWithFormat:@"FBAppEventsJournalTests-%u", arc4random()]] retain];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:_journalPath error:nil];
+    [_journalPath release];
+    _journalPath = nil;
+
+    [super tearDown];
+}
+
+#pragma mark - Helpers
+
+- (NSDictionary *)eventNamed:(NSString *)name
+{
+    return @{@"event" : @{@"_eventName" : name}, @"isImplicit" : @NO};
+}
+
+- (NSArray *)eventNamesOf:(NSArray *)events
+{
+    NSMutableArray *names = [NSMutableArray array];
+    for (NSDictionary *event in events) {
+        // The journal hands events back already encoded
+        STAssertTrue([event[@"event"] isKindOfClass:[NSData class]], @"event should be encoded JSON");
+        NSDictionary *decoded = [NSJSONSerialization JSONObjectWithData:event[@"event"] options:0 error:nil];
+        [names addObject:decoded[@"_eventName"]];
+    }
+    return names;
+}
+
+#pragma mark - Tests
+
+- (void)testRecoversUnacknowledgedEvents
+{
+    FBAppEventsJournal *journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    NSDictionary *first = [journal appendEvent:[self eventNamed:@"first"]];
+    [journal appendEvent:[self eventNamed:@"second"]];
+    [journal appendEvent:[self eventNamed:@"third"]];
+    [journal recordSkippedEvent];
+    [journal acknowledgeEvents:@[first]];
+    [journal recordSkippedEvent];
+    [journal release];
+
+    journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    NSUInteger numSkipped = 0;
+    NSArray *recovered = [journal takeRecoveredEvents:&numSkipped];
+    STAssertEqualObjects((@[@"second", @"third"]), [self eventNamesOf:recovered], @"unexpected recovered events");
+    STAssertEquals((NSUInteger)1, numSkipped, @"acknowledging should have cleared the earlier skipped event");
+    STAssertEquals((NSUInteger)0, [journal takeRecoveredEvents:NULL].count, @"events should only be recovered once");
+
+    // New events follow the recovered ones
+    [journal appendEvent:[self eventNamed:@"fourth"]];
+    [journal acknowledgeEvents:recovered];
+    [journal release];
+
+    journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    recovered = [journal takeRecoveredEvents:NULL];
+    STAssertEqualObjects((@[@"fourth"]), [self eventNamesOf:recovered], @"unexpected recovered events");
+    [journal release];
+}
+
+- (void)testAcknowledgingOutOfOrder
+{
+    FBAppEventsJournal *journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    [journal appendEvent:[self eventNamed:@"first"]];
+    NSDictionary *second = [journal appendEvent:[self eventNamed:@"second"]];
+    [journal acknowledgeEvents:@[second]];
+    [journal release];
+
+    journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    NSArray *recovered = [journal takeRecoveredEvents:NULL];
+    STAssertEqualObjects((@[@"first"]), [self eventNamesOf:recovered], @"unexpected recovered events");
+
+    [journal acknowledgeEvents:recovered];
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:_journalPath error:nil];
+    STAssertEquals(16ULL, [attributes fileSize], @"an empty journal should shrink back to its header");
+    [journal release];
+}
+
+- (void)testAcknowledgingBySequenceNumberAfterRelaunch
+{
+    FBAppEventsJournal *journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    [journal appendEvent:[self eventNamed:@"first"]];
+    NSDictionary *second = [journal appendEvent:[self eventNamed:@"second"]];
+    [journal appendEvent:[self eventNamed:@"third"]];
+    [journal release];
+
+    // As when an earlier run's upload turns out to have gone through
+    journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    [journal acknowledgeEventsWithSequenceNumbers:@[[FBAppEventsJournal sequenceNumberOfEvent:second]]];
+    NSArray *recovered = [journal takeRecoveredEvents:NULL];
+    STAssertEqualObjects((@[@"first", @"third"]), [self eventNamesOf:recovered], @"acknowledged event should not be recovered");
+    [journal release];
+
+    journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    recovered = [journal takeRecoveredEvents:NULL];
+    STAssertEqualObjects((@[@"first", @"third"]), [self eventNamesOf:recovered], @"acknowledgement should be journaled");
+    [journal release];
+}
+
+- (void)testDropsTornRecord
+{
+    FBAppEventsJournal *journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    [journal appendEvent:[self eventNamed:@"first"]];
+    [journal appendEvent:[self eventNamed:@"second"]];
+    [journal release];
+
+    // Simulate a crash partway through writing the second record
+    NSData *data = [NSData dataWithContentsOfFile:_journalPath];
+    [[data subdataWithRange:NSMakeRange(0, data.length - 5)] writeToFile:_journalPath atomically:YES];
+
+    journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    NSArray *recovered = [journal takeRecoveredEvents:NULL];
+    STAssertEqualObjects((@[@"first"]), [self eventNamesOf:recovered], @"unexpected recovered events");
+
+    [journal appendEvent:[self eventNamed:@"third"]];
+    [journal release];
+
+    journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    recovered = [journal takeRecoveredEvents:NULL];
+    STAssertEqualObjects((@[@"first", @"third"]), [self eventNamesOf:recovered], @"unexpected recovered events");
+    [journal release];
+}
+
+- (void)testCompactsOnceMostOfTheFileIsAcknowledged
+{
+    FBAppEventsJournal *journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    NSString *padding = [@"" stringByPaddingToLength:1024 withString:@"x" startingAtIndex:0];
+    NSMutableArray *events = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 80; i++) {
+        [events addObject:[journal appendEvent:[self eventNamed:[NSString stringWithFormat:@"%lu%@", (unsigned long)i, padding]]]];
+    }
+    [journal appendEvent:[self eventNamed:@"last"]];
+
+    [journal acknowledgeEvents:events];
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:_journalPath error:nil];
+    STAssertTrue([attributes fileSize] < 1024, @"the acknowledged records should have been compacted away");
+    [journal appendEvent:[self eventNamed:@"after"]];
+    [journal release];
+
+    journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    NSArray *recovered = [journal takeRecoveredEvents:NULL];
+    STAssertEqualObjects((@[@"last", @"after"]), [self eventNamesOf:recovered], @"unexpected recovered events");
+    [journal release];
+}
+
+- (void)testReadsBackSpilledEvents
+{
+    FBAppEventsJournal *journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    NSDictionary *first = [journal appendEvent:[self eventNamed:@"first"]];
+    NSNumber *second = [journal spillEvent:[self eventNamed:@"second"]];
+    [journal appendEvent:[self eventNamed:@"third"]];
+    NSNumber *fourth = [journal spillEvent:[self eventNamed:@"fourth"]];
+    STAssertNotNil(second, @"spilling should hand back a sequence number");
+    STAssertNotNil(fourth, @"spilling should hand back a sequence number");
+
+    NSArray *spilled = [journal readEventsWithSequenceNumbers:@[second, fourth]];
+    STAssertEqualObjects((@[@"second", @"fourth"]), [self eventNamesOf:spilled], @"unexpected spilled events");
+
+    // Read back events acknowledge like any other
+    [journal acknowledgeEvents:@[first, spilled[0]]];
+    [journal release];
+
+    journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    NSArray *recovered = [journal takeRecoveredEvents:NULL];
+    STAssertEqualObjects((@[@"third", @"fourth"]), [self eventNamesOf:recovered], @"unexpected recovered events");
+    [journal release];
+}
+
+- (void)testFullBufferSpillsToTheJournalThenSkips
+{
+    FBAppEventsJournal *journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    FBSessionAppEventsState *state = [[FBSessionAppEventsState alloc] init];
+    state.journal = journal;
+    state.maxBufferedEventCount = 2;
+    state.maxSpilledEventCount = 2;
+
+    for (NSString *name in @[@"first", @"second", @"third", @"fourth", @"fifth"]) {
+        [state addEvent:@{@"_eventName" : name} isImplicit:NO];
+    }
+    STAssertEquals((NSUInteger)2, [state getAccumulatedEventCount], @"unexpected buffered events");
+    STAssertEquals((NSUInteger)2, [state getSpilledEventCount], @"unexpected spilled events");
+    STAssertEquals((NSUInteger)1, [state getNumSkippedEvents], @"only the event past the spill limit should be skipped");
+
+    // Nothing comes back until the buffer has room
+    [state restoreSpilledEvents];
+    STAssertEquals((NSUInteger)2, [state getSpilledEventCount], @"a full buffer should leave spilled events on disk");
+
+    [state moveAccumulatedEventsInFlight];
+    [state clearInFlightAndStats];
+    [state restoreSpilledEvents];
+    STAssertEquals((NSUInteger)0, [state getSpilledEventCount], @"spilled events should have been read back");
+    [state moveAccumulatedEventsInFlight];
+    STAssertEqualObjects((@[@"third", @"fourth"]), [self eventNamesOf:[state inFlightEvents]], @"unexpected restored events");
+
+    [state release];
+    [journal release];
+}
+
+- (void)testNoSpillLimitSkipsOnceTheBufferIsFull
+{
+    FBAppEventsJournal *journal = [[FBAppEventsJournal alloc] initWithPath:_journalPath];
+    FBSessionAppEventsState *state = [[FBSessionAppEventsState alloc] init];
+    state.journal = journal;
+    state.maxBufferedEventCount = 1;
+    state.maxSpilledEventCount = 0;
+
+    [state addEvent:@{@"_eventName" : @"first"} isImplicit:NO];
+    [state addEvent:@{@"_eventName" : @"second"} isImplicit:NO];
+    STAssertEquals((NSUInteger)0, [state getSpilledEventCount], @"nothing should spill");
+    STAssertEquals((NSUInteger)1, [state getNumSkippedEvents], @"the second event should be skipped");
+
+    [state release];
+    [journal release];
+}
+
+@end
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import "FBAppEvents+Internal.h"
+#import "FBRequest.h"
+#import "FBRequestConnection+Internal.h"
+#import "FBRequestConnection.h"
+#import "FBRequestMetadata.h"
+#import "FBSession+Internal.h"
+#import "FBSessionAppEventsState.h"
+#import "FBSessionManualTokenCachingStrategy.h"
+
+static NSString *const kFBAppEventsTestsAppID = @"1234567890";
+
+// Mirrors the private AppSupportsAttributionStatus in FBAppEvents.m
+typedef enum {
+    FBAppEventsTestsAttributionUnknown,
+    FBAppEventsTestsAttributionQueryInFlight,
+    FBAppEventsTestsAttributionTrue,
+    FBAppEventsTestsAttributionFalse,
+} FBAppEventsTestsAttributionStatus;
+
+@interface FBAppEvents (FBAppEventsTests)
+
+@property (readwrite, atomic) FBAppEventsTestsAttributionStatus appSupportsAttributionStatus;
+
++ (FBAppEvents *)singleton;
++ (FBSession *)unaffinitizedSessionFromToken:(FBSessionTokenCachingStrategy *)tokenCachingStrategy
+                                       appID:(NSString *)appID;
+
+@end
+
+@interface FBAppEventsTests : SenTestCase
+@end
+
+@implementation FBAppEventsTests
+{
+    FBSession *_session;
+    FBAppEventsFlushBehavior _savedFlushBehavior;
+    FBAppEventsTestsAttributionStatus _savedAttributionStatus;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    // A session with a token of its own, so the events land in its state rather than a shared one
+    FBSessionManualTokenCachingStrategy *tokenCaching = [[[FBSessionManualTokenCachingStrategy alloc] init] autorelease];
+    tokenCaching.accessToken = @"FBAppEventsTests|token";
+    tokenCaching.expirationDate = [NSDate dateWithTimeIntervalSinceNow:3600];
+    _session = [[FBAppEvents unaffinitizedSessionFromToken:tokenCaching appID:kFBAppEventsTestsAppID] retain];
+
+    _savedFlushBehavior = [FBAppEvents flushBehavior];
+    _savedAttributionStatus = [FBAppEvents singleton].appSupportsAttributionStatus;
+    [FBAppEvents setFlushBehavior:FBAppEventsFlushBehaviorAuto];
+    [FBAppEvents singleton].appSupportsAttributionStatus = FBAppEventsTestsAttributionFalse;
+}
+
+- (void)tearDown
+{
+    // Acknowledge everything, so none of it is recovered from the journal later
+    FBSessionAppEventsState *appEventsState = _session.appEventsState;
+    [appEventsState closeAggregationWindow];
+    while ([appEventsState getSpilledEventCount] || [appEventsState getAccumulatedEventCount]) {
+        [appEventsState restoreSpilledEvents];
+        [appEventsState moveAccumulatedEventsInFlight];
+        [appEventsState clearInFlightAndStats];
+    }
+    [appEventsState clearInFlightAndStats];
+    appEventsState.requestInFlight = NO;
+
+    [FBAppEvents singleton].appSupportsAttributionStatus = _savedAttributionStatus;
+    [FBAppEvents setFlushBehavior:_savedFlushBehavior];
+    [_session release];
+    _session = nil;
+
+    [super tearDown];
+}
+
+- (NSArray *)graphPathsOfConnection:(FBRequestConnection *)connection
+{
+    NSMutableArray *paths = [NSMutableArray array];
+    for (FBRequestMetadata *metadata in connection.requests) {
+        [paths addObject:metadata.request.graphPath];
+    }
+    return paths;
+}
+
+- (FBRequestConnection *)connectionAfterPiggybackingForAppID:(NSString *)appID maximumCount:(NSUInteger)maximumCount
+{
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [FBAppEvents addPiggybackRequestsToConnection:connection forAppID:appID maximumCount:maximumCount];
+    return connection;
+}
+
+- (void)testPendingEventsRideAnOutgoingBatch
+{
+    [FBAppEvents logEvent:@"piggybacked_event" valueToSum:nil parameters:nil session:_session];
+
+    FBRequestConnection *connection = [self connectionAfterPiggybackingForAppID:kFBAppEventsTestsAppID maximumCount:10];
+
+    NSArray *expected = @[[kFBAppEventsTestsAppID stringByAppendingString:@"/activities"]];
+    STAssertEqualObjects([self graphPathsOfConnection:connection], expected, @"the pending events should be posted");
+    STAssertTrue(_session.appEventsState.requestInFlight, @"the events should be in flight");
+
+    // Already in flight, so a second batch has nothing to take
+    connection = [self connectionAfterPiggybackingForAppID:kFBAppEventsTestsAppID maximumCount:10];
+    STAssertEquals(connection.requests.count, (NSUInteger)0, @"events in flight shouldn't be posted twice");
+}
+
+- (void)testEventsForAnotherAppStayBehind
+{
+    [FBAppEvents logEvent:@"piggybacked_event" valueToSum:nil parameters:nil session:_session];
+
+    FBRequestConnection *connection = [self connectionAfterPiggybackingForAppID:@"999" maximumCount:10];
+
+    STAssertEquals(connection.requests.count, (NSUInteger)0, @"a batch has a single app ID");
+    STAssertFalse(_session.appEventsState.requestInFlight, nil);
+}
+
+- (void)testNoRoomLeavesEventsBehind
+{
+    [FBAppEvents logEvent:@"piggybacked_event" valueToSum:nil parameters:nil session:_session];
+
+    FBRequestConnection *connection = [self connectionAfterPiggybackingForAppID:kFBAppEventsTestsAppID maximumCount:0];
+
+    STAssertEquals(connection.requests.count, (NSUInteger)0, nil);
+    STAssertFalse(_session.appEventsState.requestInFlight, nil);
+}
+
+- (void)testExplicitFlushingIsNotPiggybacked
+{
+    [FBAppEvents setFlushBehavior:FBAppEventsFlushBehaviorExplicitOnly];
+    [FBAppEvents logEvent:@"piggybacked_event" valueToSum:nil parameters:nil session:_session];
+
+    FBRequestConnection *connection = [self connectionAfterPiggybackingForAppID:kFBAppEventsTestsAppID maximumCount:10];
+
+    STAssertEquals(connection.requests.count, (NSUInteger)0, @"explicit flushing should be left to the app");
+    STAssertFalse(_session.appEventsState.requestInFlight, nil);
+}
+
+- (void)testUnknownAttributionSupportWaitsForTheTimerFlush
+{
+    [FBAppEvents singleton].appSupportsAttributionStatus = FBAppEventsTestsAttributionUnknown;
+    [FBAppEvents logEvent:@"piggybacked_event" valueToSum:nil parameters:nil session:_session];
+
+    FBRequestConnection *connection = [self connectionAfterPiggybackingForAppID:kFBAppEventsTestsAppID maximumCount:10];
+
+    STAssertEquals(connection.requests.count, (NSUInteger)0, @"the app settings have to be fetched first");
+    STAssertFalse(_session.appEventsState.requestInFlight, nil);
+}
+
+// The in-flight events once the aggregation window is closed, decoded
+- (NSArray *)flushedEvents
+{
+    FBSessionAppEventsState *appEventsState = _session.appEventsState;
+    [appEventsState closeAggregationWindow];
+    [appEventsState moveAccumulatedEventsInFlight];
+    return [NSJSONSerialization JSONObjectWithData:[appEventsState jsonDataForInFlightEvents:YES] options:0 error:nil];
+}
+
+- (void)testAggregatedEventsAreMergedUntilTheWindowCloses
+{
+    [FBAppEvents setAggregatesEvents:YES forEventName:@"aggregated_event"];
+    [FBAppEvents logEvent:@"aggregated_event" valueToSum:@1 parameters:nil session:_session];
+    [FBAppEvents logEvent:@"aggregated_event" valueToSum:@2 parameters:nil session:_session];
+    [FBAppEvents logEvent:@"aggregated_event" valueToSum:@3 parameters:nil session:_session];
+    [FBAppEvents logEvent:@"aggregated_event" valueToSum:nil parameters:@{ @"level" : @"2" } session:_session];
+    [FBAppEvents setAggregatesEvents:NO forEventName:@"aggregated_event"];
+
+    NSArray *events = [self flushedEvents];
+    STAssertEquals(events.count, (NSUInteger)2, @"events with different parameters should be kept apart");
+    for (NSDictionary *event in events) {
+        if ([event objectForKey:@"level"]) {
+            STAssertEqualObjects([event objectForKey:@"_eventCount"], @1, nil);
+        } else {
+            STAssertEqualObjects([event objectForKey:@"_eventCount"], @3, nil);
+            STAssertEqualObjects([event objectForKey:@"_valueToSum"], @6, @"the values should be summed");
+        }
+    }
+}
+
+- (void)testSamplingRateDropsOrTagsEvents
+{
+    [FBAppEvents setSamplingRate:0 forEventName:@"sampled_event"];
+    [FBAppEvents logEvent:@"sampled_event" valueToSum:nil parameters:nil session:_session];
+    STAssertEquals([_session.appEventsState getAccumulatedEventCount], (NSUInteger)0, @"a rate of 0 should keep nothing");
+
+    // All but certain to be kept
+    [FBAppEvents setSamplingRate:0.9999999 forEventName:@"sampled_event"];
+    [FBAppEvents logEvent:@"sampled_event" valueToSum:nil parameters:nil session:_session];
+    [FBAppEvents setSamplingRate:1 forEventName:@"sampled_event"];
+    [FBAppEvents logEvent:@"sampled_event" valueToSum:nil parameters:nil session:_session];
+
+    NSArray *events = [self flushedEvents];
+    STAssertEquals(events.count, (NSUInteger)2, nil);
+    STAssertEqualsWithAccuracy([[[events objectAtIndex:0] objectForKey:@"_samplingRate"] doubleValue], 0.9999999, 1e-9,
+                               @"kept events should say how they were sampled");
+    STAssertNil([[events objectAtIndex:1] objectForKey:@"_samplingRate"], @"a rate of 1 should turn sampling off");
+}
+
+@end
@@ -18,7 +18,9 @@
 
 #import <OHHTTPStubs/OHHTTPStubs.h>
 
+#import "FBAppLinkCache.h"
 #import "FBAppLinkResolver.h"
+#import "FBError.h"
 #import "FBTests.h"
 #import "FBUtility.h"
 
@@ -33,6 +35,8 @@ static NSString *const kAppLinkURL2String = @"http://example.com/0987654321";
 
 @interface FBAppLinkResolver (Testing)
 
+@property (nonatomic, assign) UIUserInterfaceIdiom userInterfaceIdiom;
+
 - (id)initWithUserInterfaceIdiom:(UIUserInterfaceIdiom)userInterfaceIdiom;
 
 @end
@@ -43,6 +47,21 @@ static NSString *const kAppLinkURL2String = @"http://example.com/0987654321";
 
 @implementation FBAppLinkResolverTests
 
+- (void)setUp
+{
+    [super setUp];
+    // Every test resolves the same URLs, so none may find another's results
+    [FBAppLinkCache sharedCache].persistsLinks = NO;
+    [[FBAppLinkCache sharedCache] removeAllAppLinks];
+}
+
+- (void)tearDown
+{
+    [[FBAppLinkCache sharedCache] removeAllAppLinks];
+    [FBAppLinkCache sharedCache].persistsLinks = YES;
+    [super tearDown];
+}
+
 - (void)waitForTaskOnMainThread:(BFTask *)task
 {
     while (!task.isCompleted) {
@@ -341,6 +360,192 @@ static NSString *const kAppLinkURL2String = @"http://example.com/0987654321";
     assertThat(error, is(notNilValue()));
 }
 
+- (void)testErrorsAreRememberedBriefly
+{
+    __block NSUInteger callCount = 0;
+    [self stubAllResponsesWithResult:@{
+                                   @"error" : @{}
+                                   }
+                          statusCode:404
+                            callback:^(NSURLRequest *request) {
+                                ++callCount;
+                            }];
+
+    FBAppLinkResolver *resolver = [FBAppLinkResolver resolver];
+    BFTask *task = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    [self waitForTaskOnMainThread:task];
+    NSUInteger expectedCallCount = callCount;
+
+    task = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    [self waitForTaskOnMainThread:task];
+    assertThat(task.error, is(notNilValue()));
+    assertThatUnsignedInteger(callCount, is(equalToUnsignedInteger(expectedCallCount)));
+}
+
+- (void)testOneFailedURLDoesNotFailTheOthers
+{
+    [self stubAllResponsesWithResult:@{
+                                   kAppLinkURL2String : @{
+                                           @"id": kAppLinkURL2String
+                                           }
+                                   }];
+    NSURL *failedURL = [NSURL URLWithString:kAppLinkURLString];
+    NSURL *url = [NSURL URLWithString:kAppLinkURL2String];
+    FBAppLinkResolver *resolver = [FBAppLinkResolver resolver];
+    [[FBAppLinkCache sharedCache] setError:[NSError errorWithDomain:FacebookSDKDomain code:FBErrorHTTPError userInfo:nil]
+                                    forURL:failedURL
+                                     idiom:resolver.userInterfaceIdiom];
+
+    BFTask *task = [resolver appLinksFromURLsInBackground:@[failedURL, url]];
+    [self waitForTaskOnMainThread:task];
+
+    assertThat(task.error, is(nilValue()));
+    NSDictionary *links = task.result;
+    assertThat(links[failedURL], is(nilValue()));
+    assertThat([links[url] sourceURL].absoluteString, is(equalTo(kAppLinkURL2String)));
+}
+
+- (void)testTransientErrorsAreNotRemembered
+{
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        return [OHHTTPStubsResponse responseWithError:[NSError errorWithDomain:NSURLErrorDomain
+                                                                          code:NSURLErrorNotConnectedToInternet
+                                                                      userInfo:nil]];
+    }];
+
+    NSURL *url = [NSURL URLWithString:kAppLinkURLString];
+    FBAppLinkResolver *resolver = [FBAppLinkResolver resolver];
+    BFTask *task = [resolver appLinkFromURLInBackground:url];
+    [self waitForTaskOnMainThread:task];
+
+    assertThat(task.error, is(notNilValue()));
+    assertThat([[FBAppLinkCache sharedCache] errorForURL:url idiom:resolver.userInterfaceIdiom], is(nilValue()));
+}
+
+- (void)testLinksWithoutMetadataUseNegativeTimeToLive
+{
+    __block NSUInteger callCount = 0;
+    [self stubAllResponsesWithResult:@{
+                                       kAppLinkURLString : @{
+                                               @"id": kAppLinkURLString
+                                               }
+                                       }
+                          statusCode:200
+                            callback:^(NSURLRequest *request) {
+                                ++callCount;
+                            }];
+
+    FBAppLinkCache *cache = [FBAppLinkCache sharedCache];
+    NSTimeInterval originalNegativeTimeToLive = cache.negativeTimeToLive;
+    cache.negativeTimeToLive = -1;
+
+    FBAppLinkResolver *resolver = [FBAppLinkResolver resolver];
+    BFTask *task = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    [self waitForTaskOnMainThread:task];
+    BFAppLink *link = task.result;
+    assertThat(link.webURL.absoluteString, is(equalTo(kAppLinkURLString)));
+    NSUInteger firstCallCount = callCount;
+
+    // already expired, so asked about again
+    task = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    [self waitForTaskOnMainThread:task];
+    assertThatUnsignedInteger(callCount, is(greaterThan(@(firstCallCount))));
+
+    cache.negativeTimeToLive = originalNegativeTimeToLive;
+}
+
+- (void)testResultsAreProcessedOffMainThread
+{
+    [self stubAllResponsesWithResult:@{
+                                       kAppLinkURLString : @{
+                                               @"id": kAppLinkURLString
+                                               }
+                                       }
+                          statusCode:200];
+
+    FBAppLinkResolver *resolver = [FBAppLinkResolver resolver];
+    __block BOOL completedOnMainThread = YES;
+    BFTask *task = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    BFTask *continuation = [task continueWithBlock:^id(BFTask *task) {
+        completedOnMainThread = [NSThread isMainThread];
+        return nil;
+    }];
+    [self waitForTaskOnMainThread:continuation];
+    assertThat(task.result, is(notNilValue()));
+    assertThatBool(completedOnMainThread, equalToBool(NO));
+}
+
+- (void)testResultsAreProcessedOnTheCallersQueue
+{
+    [self stubAllResponsesWithResult:@{
+                                       kAppLinkURLString : @{
+                                               @"id": kAppLinkURLString
+                                               }
+                                       }
+                          statusCode:200];
+
+    static char kProcessingQueueKey;
+    dispatch_queue_t queue = dispatch_queue_create("FBAppLinkResolverTests", DISPATCH_QUEUE_SERIAL);
+    dispatch_queue_set_specific(queue, &kProcessingQueueKey, &kProcessingQueueKey, NULL);
+
+    FBAppLinkResolver *resolver = [FBAppLinkResolver resolver];
+    resolver.processingQueue = queue;
+    assertThat(resolver.processingQueue, is(queue));
+
+    __block BOOL completedOnQueue = NO;
+    BFTask *task = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    BFTask *continuation = [task continueWithBlock:^id(BFTask *task) {
+        completedOnQueue = (dispatch_get_specific(&kProcessingQueueKey) != NULL);
+        return nil;
+    }];
+    [self waitForTaskOnMainThread:continuation];
+    assertThat(task.result, is(notNilValue()));
+    assertThatBool(completedOnQueue, equalToBool(YES));
+    dispatch_release(queue);
+}
+
+- (void)testPrefetchedLinksAreResolvedFromCache
+{
+    __block NSUInteger callCount = 0;
+    [self stubAllResponsesWithResult:@{
+                                       kAppLinkURLString : @{
+                                               @"iphone": @[
+                                                       @{
+                                                           @"app_name": @"Example",
+                                                           @"app_store_id": @"456",
+                                                           @"url": @"example://things/1234567890"
+                                                           }
+                                                       ],
+                                               @"id": kAppLinkURLString
+                                               }
+                                       }
+                          statusCode:200
+                            callback:^(NSURLRequest *request) {
+                                ++callCount;
+                            }];
+
+    NSURL *url = [NSURL URLWithString:kAppLinkURLString];
+    FBAppLinkResolver *resolver = [FBAppLinkResolver resolver];
+    [resolver prefetchAppLinksForURLs:@[url, url]];
+
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10];
+    while (![[FBAppLinkCache sharedCache] appLinkForURL:url idiom:UI_USER_INTERFACE_IDIOM()] &&
+           [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                                 beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    }
+    NSUInteger expectedCallCount = callCount;
+    assertThatUnsignedInteger(expectedCallCount, is(greaterThan(@0)));
+
+    BFTask *task = [resolver appLinkFromURLInBackground:url];
+    [self waitForTaskOnMainThread:task];
+    BFAppLink *link = task.result;
+    assertThat(link.sourceURL, is(equalTo(url)));
+    assertThatUnsignedInteger(callCount, is(equalToUnsignedInteger(expectedCallCount)));
+}
+
 - (void)testResultsAreCachedAndCacheIsUsed
 {
     __block NSUInteger callCount = 0;
@@ -377,6 +582,110 @@ static NSString *const kAppLinkURL2String = @"http://example.com/0987654321";
     assertThatUnsignedInteger(callCount, is(equalToUnsignedInteger(expectedCallCount)));
 }
 
+- (void)testCacheIsSharedAcrossResolvers
+{
+    __block NSUInteger callCount = 0;
+
+    [self stubAllResponsesWithResult:@{
+                                       kAppLinkURLString : @{
+                                               @"iphone": @[
+                                                       @{
+                                                           @"app_name": @"Example",
+                                                           @"app_store_id": @"456",
+                                                           @"url": @"example://things/1234567890"
+                                                           }
+                                                       ],
+                                               @"id": kAppLinkURLString
+                                               }
+                                       }
+                          statusCode:200
+                            callback:^(NSURLRequest *request) {
+                                ++callCount;
+                            }];
+
+    FBAppLinkResolver *resolver = [[[FBAppLinkResolver alloc] initWithUserInterfaceIdiom:UIUserInterfaceIdiomPhone] autorelease];
+    BFTask *task = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    [self waitForTaskOnMainThread:task];
+    NSUInteger expectedCallCount = callCount;
+
+    resolver = [[[FBAppLinkResolver alloc] initWithUserInterfaceIdiom:UIUserInterfaceIdiomPhone] autorelease];
+    task = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    [self waitForTaskOnMainThread:task];
+    assertThatUnsignedInteger(callCount, is(equalToUnsignedInteger(expectedCallCount)));
+    assertThat(task.result, is(notNilValue()));
+
+    // a pad asks for other targets, so it can't use what the phone resolved
+    resolver = [[[FBAppLinkResolver alloc] initWithUserInterfaceIdiom:UIUserInterfaceIdiomPad] autorelease];
+    task = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    [self waitForTaskOnMainThread:task];
+    assertThatUnsignedInteger(callCount, is(greaterThan(@(expectedCallCount))));
+}
+
+- (void)testOverlappingResolutionsShareOneRequest
+{
+    __block NSUInteger callCount = 0;
+
+    [self stubAllResponsesWithResult:@{
+                                       kAppLinkURLString : @{
+                                               @"ios": @[
+                                                       @{
+                                                           @"app_name": @"Example",
+                                                           @"app_store_id": @"123",
+                                                           @"url": @"example://things/1234567890"
+                                                           }
+                                                       ],
+                                               @"id": kAppLinkURLString
+                                               }
+                                       }
+                          statusCode:200
+                            callback:^(NSURLRequest *request) {
+                                ++callCount;
+                            }];
+
+    // Note: the callback may be called several times per request, so measure one resolution first.
+    FBAppLinkResolver *resolver = [[[FBAppLinkResolver alloc] initWithUserInterfaceIdiom:UIUserInterfaceIdiomPhone] autorelease];
+    BFTask *task = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    [self waitForTaskOnMainThread:task];
+    NSUInteger callsPerRequest = callCount;
+    [[FBAppLinkCache sharedCache] removeAllAppLinks];
+
+    callCount = 0;
+    FBAppLinkResolver *otherResolver = [[[FBAppLinkResolver alloc] initWithUserInterfaceIdiom:UIUserInterfaceIdiomPhone] autorelease];
+    BFTask *task1 = [resolver appLinkFromURLInBackground:[NSURL URLWithString:kAppLinkURLString]];
+    BFTask *task2 = [otherResolver appLinksFromURLsInBackground:@[[NSURL URLWithString:kAppLinkURLString]]];
+    [self waitForTaskOnMainThread:task1];
+    [self waitForTaskOnMainThread:task2];
+
+    assertThatUnsignedInteger(callCount, is(equalToUnsignedInteger(callsPerRequest)));
+    assertThat(task1.result, is(notNilValue()));
+    assertThat(task2.result[[NSURL URLWithString:kAppLinkURLString]], is(equalTo(task1.result)));
+}
+
+- (void)testCacheDropsLeastRecentlyUsedLinks
+{
+    FBAppLinkCache *cache = [[[FBAppLinkCache alloc] init] autorelease];
+    cache.persistsLinks = NO;
+    cache.countLimit = 4;
+
+    NSMutableArray *urls = [NSMutableArray array];
+    for (int i = 0; i < 5; i++) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://example.com/%d", i]];
+        [urls addObject:url];
+        [cache setAppLink:[BFAppLink appLinkWithSourceURL:url targets:@[] webURL:url] forURL:url idiom:UIUserInterfaceIdiomPhone];
+        [NSThread sleepForTimeInterval:0.01];
+        if (i == 3) {
+            // keep the first link in use
+            [cache appLinkForURL:urls[0] idiom:UIUserInterfaceIdiomPhone];
+            [NSThread sleepForTimeInterval:0.01];
+        }
+    }
+
+    assertThat([cache appLinkForURL:urls[0] idiom:UIUserInterfaceIdiomPhone], is(notNilValue()));
+    assertThat([cache appLinkForURL:urls[1] idiom:UIUserInterfaceIdiomPhone], is(nilValue()));
+    assertThat([cache appLinkForURL:urls[4] idiom:UIUserInterfaceIdiomPhone], is(notNilValue()));
+    assertThat([cache appLinkForURL:urls[4] idiom:UIUserInterfaceIdiomPad], is(nilValue()));
+}
+
 - (void)testMixOfCachedAndUncached
 {
     __block NSMutableDictionary *callCounts = [NSMutableDictionary dictionary];
@@ -438,4 +747,97 @@ static NSString *const kAppLinkURL2String = @"http://example.com/0987654321";
     assertThatUnsignedInteger(links.count, is(equalToUnsignedInteger(2)));
 }
 
+
+- (NSArray *)manyAppLinkURLs:(NSUInteger)count
+{
+    NSMutableArray *urls = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        [urls addObject:[NSURL URLWithString:[NSString stringWithFormat:@"http://example.com/many/%lu", (unsigned long)i]]];
+    }
+    return urls;
+}
+
+// A batch response of one entry per chunk, each carrying every URL's link; a chunk only reads its own
+- (NSArray *)batchResponseForURLs:(NSArray *)urls chunkStatusCodes:(NSArray *)statusCodes
+{
+    NSMutableDictionary *links = [NSMutableDictionary dictionary];
+    for (NSURL *url in urls) {
+        links[url.absoluteString] = @{@"ios": @[@{@"app_name": @"Example",
+                                                  @"app_store_id": @"123",
+                                                  @"url": @"example://things/1234567890"}],
+                                      @"id": url.absoluteString};
+    }
+    NSString *body = [FBUtility simpleJSONEncode:links];
+    NSString *errorBody = [FBUtility simpleJSONEncode:@{@"error": @{@"message": @"Too long", @"code": @100}}];
+    NSMutableArray *entries = [NSMutableArray arrayWithCapacity:statusCodes.count];
+    for (NSNumber *statusCode in statusCodes) {
+        [entries addObject:@{@"code": statusCode, @"body": statusCode.intValue == 200 ? body : errorBody}];
+    }
+    return entries;
+}
+
+- (void)testManyURLsAreSplitIntoChunksOfOneBatch
+{
+    // 50 URLs to a chunk, so two chunks, answered by one batch of two entries
+    NSArray *urls = [self manyAppLinkURLs:60];
+    [self stubAllResponsesWithResult:[self batchResponseForURLs:urls chunkStatusCodes:@[@200, @200]]];
+
+    FBAppLinkResolver *resolver = [[[FBAppLinkResolver alloc] initWithUserInterfaceIdiom:UIUserInterfaceIdiomPhone] autorelease];
+    BFTask *task = [resolver appLinksFromURLsInBackground:urls];
+    [self waitForTaskOnMainThread:task];
+
+    assertThat(task.error, is(nilValue()));
+    NSDictionary *links = task.result;
+    assertThatUnsignedInteger(links.count, is(equalToUnsignedInteger(urls.count)));
+    for (NSURL *url in urls) {
+        assertThat([[links[url] targets][0] appStoreId], is(equalTo(@"123")));
+    }
+}
+
+- (void)testLongURLsAreSplitByLength
+{
+    // each encoded URL takes up about a third of a chunk's length, so five of them take two chunks
+    NSString *padding = [@"" stringByPaddingToLength:450 withString:@"a" startingAtIndex:0];
+    NSMutableArray *urls = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 5; i++) {
+        [urls addObject:[NSURL URLWithString:[NSString stringWithFormat:@"http://example.com/%@/%lu", padding, (unsigned long)i]]];
+    }
+    [self stubAllResponsesWithResult:[self batchResponseForURLs:urls chunkStatusCodes:@[@200, @200]]];
+
+    FBAppLinkResolver *resolver = [[[FBAppLinkResolver alloc] initWithUserInterfaceIdiom:UIUserInterfaceIdiomPhone] autorelease];
+    BFTask *task = [resolver appLinksFromURLsInBackground:urls];
+    [self waitForTaskOnMainThread:task];
+
+    assertThat(task.error, is(nilValue()));
+    assertThatUnsignedInteger([task.result count], is(equalToUnsignedInteger(urls.count)));
+}
+
+- (void)testFailedChunkFailsTheTaskAndIsAskedForAgainLater
+{
+    NSArray *urls = [self manyAppLinkURLs:60];
+    [self stubAllResponsesWithResult:[self batchResponseForURLs:urls chunkStatusCodes:@[@200, @400]]];
+
+    FBAppLinkResolver *resolver = [[[FBAppLinkResolver alloc] initWithUserInterfaceIdiom:UIUserInterfaceIdiomPhone] autorelease];
+    BFTask *task = [resolver appLinksFromURLsInBackground:urls];
+    [self waitForTaskOnMainThread:task];
+    assertThat(task.error, is(notNilValue()));
+
+    // The failed URLs are no longer in flight, so asking again makes a new request
+    [OHHTTPStubs removeAllRequestHandlers];
+    [[FBAppLinkCache sharedCache] removeAllAppLinks];
+    NSURL *failedURL = urls.lastObject;
+    __block NSUInteger callCount = 0;
+    [self stubAllResponsesWithResult:@{failedURL.absoluteString: @{@"id": failedURL.absoluteString}}
+                          statusCode:200
+                            callback:^(NSURLRequest *request) {
+                                ++callCount;
+                            }];
+    BFTask *retryTask = [resolver appLinkFromURLInBackground:failedURL];
+    [self waitForTaskOnMainThread:retryTask];
+
+    assertThat(retryTask.error, is(nilValue()));
+    assertThat([retryTask.result sourceURL], is(equalTo(failedURL)));
+    assertThatUnsignedInteger(callCount, is(greaterThan(@0)));
+}
+
 @end
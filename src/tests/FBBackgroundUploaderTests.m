@@ -0,0 +1,88 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <OCMock/OCMock.h>
+#import <UIKit/UIKit.h>
+
+#import "FBAppEvents+Internal.h"
+#import "FBBackgroundUploader.h"
+#import "FBSettings.h"
+#import "FBTests.h"
+
+@interface FBBackgroundUploaderTests : FBTests
+@end
+
+@implementation FBBackgroundUploaderTests
+
+- (void)tearDown
+{
+    [FBSettings enableBackgroundUploads:NO];
+    [super tearDown];
+}
+
+- (void)waitForMainQueue
+{
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+}
+
+- (void)testEnablingAfterLaunchReconnectsAndReconcilesAppEvents
+{
+    if (![NSURLSession class]) {
+        return;
+    }
+    id appEvents = [OCMockObject partialMockForObject:[FBAppEvents singleton]];
+    [[appEvents expect] reconcileBackgroundUploads];
+
+    [FBSettings enableBackgroundUploads:YES];
+    [self waitForMainQueue];
+
+    [appEvents verify];
+    [appEvents stopMocking];
+}
+
+- (void)testResigningActiveDoesNotStartABackgroundFlush
+{
+    if (![NSURLSession class]) {
+        return;
+    }
+    [FBSettings enableBackgroundUploads:YES];
+    id appEvents = [OCMockObject partialMockForObject:[FBAppEvents singleton]];
+    [[appEvents reject] instanceFlush:FBAppEventsFlushReasonBackgroundUpload];
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationWillResignActiveNotification object:nil];
+    [self waitForMainQueue];
+
+    [appEvents verify];
+    [appEvents stopMocking];
+}
+
+- (void)testEnteringBackgroundStartsABackgroundFlush
+{
+    if (![NSURLSession class]) {
+        return;
+    }
+    [FBSettings enableBackgroundUploads:YES];
+    id appEvents = [OCMockObject partialMockForObject:[FBAppEvents singleton]];
+    [[appEvents expect] instanceFlush:FBAppEventsFlushReasonBackgroundUpload];
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationDidEnterBackgroundNotification object:nil];
+
+    [appEvents verify];
+    [appEvents stopMocking];
+}
+
+@end
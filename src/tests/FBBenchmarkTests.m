@@ -0,0 +1,216 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import <malloc/malloc.h>
+
+#import "FBBase64.h"
+#import "FBCrypto.h"
+#import "FBGraphObject.h"
+#import "FBGraphUser.h"
+#import "FBRequest.h"
+#import "FBRequestConnection.h"
+#import "FBUtility.h"
+
+// Benchmarks for the serialization hot paths. They take a while, so they only run when
+// FB_RUN_BENCHMARKS is set in the test environment. Each one reports operations per second
+// and the memory blocks still allocated per operation before the autorelease pool drains,
+// which counts the objects an operation creates but not malloc/free pairs within it.
+//
+// Set FB_BENCHMARK_OUTPUT to a path to write the results there as a plist, and
+// FB_BENCHMARK_BASELINE to such a plist from an earlier run to fail any benchmark that got
+// more than kFBBenchmarkTolerance slower.
+static NSString *const kFBBenchmarkRunKey = @"FB_RUN_BENCHMARKS";
+static NSString *const kFBBenchmarkOutputKey = @"FB_BENCHMARK_OUTPUT";
+static NSString *const kFBBenchmarkBaselineKey = @"FB_BENCHMARK_BASELINE";
+static const double kFBBenchmarkTolerance = 0.25;
+// Each benchmark runs batches until it has run at least this long
+static const NSTimeInterval kFBBenchmarkMinimumDuration = 0.5;
+
+static NSMutableDictionary *g_benchmarkResults;
+
+@interface FBBenchmarkTests : SenTestCase
+
+@end
+
+@implementation FBBenchmarkTests
+
++ (BOOL)benchmarksEnabled
+{
+    return [[[NSProcessInfo processInfo] environment] objectForKey:kFBBenchmarkRunKey] != nil;
+}
+
++ (void)tearDown
+{
+    NSString *outputPath = [[[NSProcessInfo processInfo] environment] objectForKey:kFBBenchmarkOutputKey];
+    if (outputPath && g_benchmarkResults) {
+        [g_benchmarkResults writeToFile:outputPath atomically:YES];
+    }
+    [super tearDown];
+}
+
+static size_t FBBenchmarkBlocksInUse(void)
+{
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(NULL, &statistics);
+    return statistics.blocks_in_use;
+}
+
+- (void)measure:(NSString *)name block:(void (^)(void))block
+{
+    if (![FBBenchmarkTests benchmarksEnabled]) {
+        return;
+    }
+
+    // Warm up caches, lazily built selectors and the like
+    @autoreleasepool {
+        block();
+    }
+
+    NSUInteger batchSize = 1;
+    NSUInteger operations = 0;
+    double blocksPerOperation = 0;
+    NSTimeInterval elapsed = 0;
+    while (elapsed < kFBBenchmarkMinimumDuration) {
+        @autoreleasepool {
+            size_t blocksBefore = FBBenchmarkBlocksInUse();
+            NSTimeInterval start = [FBUtility monotonicTime];
+            for (NSUInteger i = 0; i < batchSize; i++) {
+                block();
+            }
+            elapsed += [FBUtility monotonicTime] - start;
+            blocksPerOperation = ((double)FBBenchmarkBlocksInUse() - blocksBefore) / batchSize;
+        }
+        operations += batchSize;
+        batchSize *= 2;
+    }
+
+    double opsPerSecond = operations / elapsed;
+    NSLog(@"FBBenchmark %@: %.1f ops/sec, %.1f allocations/op", name, opsPerSecond, blocksPerOperation);
+
+    if (!g_benchmarkResults) {
+        g_benchmarkResults = [[NSMutableDictionary alloc] init];
+    }
+    [g_benchmarkResults setObject:@{@"opsPerSecond": @(opsPerSecond), @"allocationsPerOperation": @(blocksPerOperation)}
+                           forKey:name];
+
+    NSString *baselinePath = [[[NSProcessInfo processInfo] environment] objectForKey:kFBBenchmarkBaselineKey];
+    NSNumber *baseline = baselinePath ?
+        [[[NSDictionary dictionaryWithContentsOfFile:baselinePath] objectForKey:name] objectForKey:@"opsPerSecond"] : nil;
+    if (baseline) {
+        STAssertTrue(opsPerSecond >= baseline.doubleValue * (1 - kFBBenchmarkTolerance),
+                     @"%@ regressed: %.1f ops/sec against a baseline of %.1f", name, opsPerSecond, baseline.doubleValue);
+    }
+}
+
+- (NSDictionary *)sampleGraphResponse
+{
+    NSMutableArray *friends = [NSMutableArray arrayWithCapacity:100];
+    for (int i = 0; i < 100; i++) {
+        [friends addObject:@{@"id": [NSString stringWithFormat:@"%d", 100000 + i],
+                             @"name": [NSString stringWithFormat:@"Friend Number %d", i],
+                             @"picture": @{@"data": @{@"url": @"https://example.com/picture.jpg",
+                                                      @"is_silhouette": @NO}}}];
+    }
+    return @{@"data": friends, @"paging": @{@"next": @"https://graph.facebook.com/me/friends?after=abc"}};
+}
+
+- (void)testJSONEncodeDecode
+{
+    NSDictionary *response = [self sampleGraphResponse];
+    NSString *json = [FBUtility simpleJSONEncode:response];
+
+    [self measure:@"simpleJSONEncode:" block:^{
+        [FBUtility simpleJSONEncode:response];
+    }];
+    [self measure:@"simpleJSONDecode:" block:^{
+        [FBUtility simpleJSONDecode:json];
+    }];
+}
+
+- (void)testBase64EncodeDecode
+{
+    NSData *data = [FBCrypto randomBytes:64 * 1024];
+    NSString *encoded = FBEncodeBase64(data);
+
+    [self measure:@"FBEncodeBase64 64KB" block:^{
+        FBEncodeBase64(data);
+    }];
+    [self measure:@"FBDecodeBase64 64KB" block:^{
+        FBDecodeBase64(encoded);
+    }];
+}
+
+- (void)testURLEncoding
+{
+    NSString *value = @"message=Hello, world! & welcome to http://example.com/?a=b#c ünïcødé";
+
+    [self measure:@"stringByURLEncodingString:" block:^{
+        [FBUtility stringByURLEncodingString:value];
+    }];
+}
+
+- (void)testRequestBodyForBatches
+{
+    for (NSNumber *count in @[@1, @10, @50]) {
+        [self measure:[NSString stringWithFormat:@"FBRequestBody %@ requests", count] block:^{
+            FBRequestConnection *connection = [[FBRequestConnection alloc] init];
+            for (int i = 0; i < count.intValue; i++) {
+                FBRequest *request = [[FBRequest alloc] initWithSession:nil
+                                                              graphPath:[NSString stringWithFormat:@"%d", 4 + i]
+                                                             parameters:@{@"fields": @"id,name,picture"}
+                                                             HTTPMethod:@"GET"];
+                [connection addRequest:request completionHandler:nil];
+                [request release];
+            }
+            [connection urlRequest];
+            [connection release];
+        }];
+    }
+}
+
+- (void)testCryptoEncryptDecrypt
+{
+    FBCrypto *crypto = [[[FBCrypto alloc] initWithMasterKey:[FBCrypto makeMasterKey]] autorelease];
+    for (NSNumber *size in @[@1024, @(100 * 1024), @(1024 * 1024), @(10 * 1024 * 1024)]) {
+        NSData *plainText = [FBCrypto randomBytes:size.unsignedIntegerValue];
+        NSString *cipherText = [crypto encrypt:plainText additionalDataToSign:nil];
+
+        [self measure:[NSString stringWithFormat:@"FBCrypto encrypt %@ bytes", size] block:^{
+            [crypto encrypt:plainText additionalDataToSign:nil];
+        }];
+        [self measure:[NSString stringWithFormat:@"FBCrypto decrypt %@ bytes", size] block:^{
+            [crypto decrypt:cipherText additionalSignedData:nil];
+        }];
+    }
+}
+
+- (void)testGraphObjectPropertyAccess
+{
+    NSDictionary *response = [self sampleGraphResponse];
+
+    [self measure:@"FBGraphObject property access" block:^{
+        NSArray *friends = [[FBGraphObject graphObjectWrappingDictionary:response] objectForKey:@"data"];
+        for (id<FBGraphUser> user in friends) {
+            [user objectID];
+            [user name];
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,311 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import <libkern/OSAtomic.h>
+
+#import "FBCacheIndex.h"
+#import "FBDataDiskCache.h"
+#import "FBUtility.h"
+
+// Benchmark and stress runs for FBDataDiskCache and FBCacheIndex, to compare the cache
+// before and after changes to it. Like FBBenchmarkTests they only run when
+// FB_RUN_BENCHMARKS is set. FB_CACHE_BENCHMARK_KEYS sets how many distinct keys the
+// workloads use, 10000 by default; 100000 is the large configuration.
+static NSString *const kFBBenchmarkRunKey = @"FB_RUN_BENCHMARKS";
+static NSString *const kFBCacheBenchmarkKeysKey = @"FB_CACHE_BENCHMARK_KEYS";
+static const NSUInteger kFBCacheBenchmarkDefaultKeys = 10000;
+static const NSUInteger kFBCacheBenchmarkStressQueues = 4;
+
+static int FBCacheBenchmarkCompareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts the samples in place
+static double FBCacheBenchmarkPercentile(double *samples, NSUInteger count, double percentile)
+{
+    if (count == 0) {
+        return 0;
+    }
+    qsort(samples, count, sizeof(double), FBCacheBenchmarkCompareDoubles);
+    NSUInteger index = MIN(count - 1, (NSUInteger)(percentile * count));
+    return samples[index];
+}
+
+// Sizes roughly like what the SDK caches: mostly small JSON responses, some larger
+// pages, and the occasional picture.
+static NSUInteger FBCacheBenchmarkEntrySize(void)
+{
+    uint32_t roll = arc4random_uniform(100);
+    if (roll < 70) {
+        return 1024 + arc4random_uniform(7 * 1024);
+    } else if (roll < 95) {
+        return 8 * 1024 + arc4random_uniform(56 * 1024);
+    }
+    return 64 * 1024 + arc4random_uniform(448 * 1024);
+}
+
+@interface FBCacheBenchmarkTests : SenTestCase <FBCacheIndexFileDelegate>
+
+@end
+
+@implementation FBCacheBenchmarkTests
+{
+    NSString *_cacheFolder;
+    NSUInteger _keyCount;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    _cacheFolder = [[NSTemporaryDirectory() stringByAppendingPathComponent:
+                     [NSString stringWithFormat:@"FBCacheBenchmarkTests-%u", arc4random()]] retain];
+    [[NSFileManager defaultManager] createDirectoryAtPath:_cacheFolder
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:nil];
+    NSInteger keyCount = [[[[NSProcessInfo processInfo] environment] objectForKey:kFBCacheBenchmarkKeysKey] integerValue];
+    _keyCount = keyCount > 0 ? (NSUInteger)keyCount : kFBCacheBenchmarkDefaultKeys;
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:_cacheFolder error:nil];
+    [_cacheFolder release];
+    _cacheFolder = nil;
+
+    [super tearDown];
+}
+
+- (BOOL)benchmarksEnabled
+{
+    return [[[NSProcessInfo processInfo] environment] objectForKey:kFBBenchmarkRunKey] != nil;
+}
+
+- (NSURL *)URLForKey:(NSUInteger)key
+{
+    return [NSURL URLWithString:[NSString stringWithFormat:@"https://fbcachebenchmark.example.com/%lu", (unsigned long)key]];
+}
+
+// The index only looks at the length, so its entries can share one buffer
+- (NSData *)fillerDataOfSize:(NSUInteger)size
+{
+    static NSMutableData *filler;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        filler = [[NSMutableData alloc] initWithLength:512 * 1024];
+    });
+    return [NSData dataWithBytesNoCopy:filler.mutableBytes length:MIN(size, filler.length) freeWhenDone:NO];
+}
+
+// The first bytes identify the key, so the stress run can tell a torn or swapped entry
+- (NSData *)dataForKey:(NSUInteger)key size:(NSUInteger)size
+{
+    NSMutableData *data = [NSMutableData dataWithLength:MAX(size, sizeof(key))];
+    memcpy(data.mutableBytes, &key, sizeof(key));
+    return data;
+}
+
+- (void)removeKeysFromCache:(FBDataDiskCache *)cache
+{
+    for (NSUInteger key = 0; key < _keyCount; key++) {
+        [cache removeDataForUrl:[self URLForKey:key]];
+    }
+    dispatch_sync(cache.fileQueue, ^{});
+}
+
+#pragma mark - FBCacheIndexFileDelegate
+
+- (void)cacheIndex:(id<FBCacheIndexing>)cacheIndex
+ writeFileWithName:(NSString *)name
+              data:(NSData *)data
+{
+}
+
+- (void)cacheIndex:(id<FBCacheIndexing>)cacheIndex
+deleteFileWithName:(NSString *)name
+{
+}
+
+#pragma mark - Benchmarks
+
+- (void)testRandomizedIndexWorkload
+{
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+
+    FBCacheIndex *cacheIndex = [[[FBCacheIndex alloc] initWithCacheFolder:_cacheFolder] autorelease];
+    cacheIndex.diskCapacity = 100 * 1024 * 1024;
+    cacheIndex.delegate = self;
+
+    NSUInteger operations = _keyCount * 4;
+    NSUInteger gets = 0, sets = 0, removes = 0;
+    NSTimeInterval start = [FBUtility monotonicTime];
+    for (NSUInteger i = 0; i < operations; i++) {
+        @autoreleasepool {
+            NSString *key = [[self URLForKey:arc4random_uniform((uint32_t)_keyCount)] absoluteString];
+            uint32_t roll = arc4random_uniform(100);
+            if (roll < 70) {
+                [cacheIndex fileNameForKey:key];
+                gets++;
+            } else if (roll < 95) {
+                [cacheIndex storeFileForKey:key withData:[self fillerDataOfSize:FBCacheBenchmarkEntrySize()]];
+                sets++;
+            } else {
+                [cacheIndex removeEntryForKey:key];
+                removes++;
+            }
+        }
+    }
+    dispatch_sync(cacheIndex.databaseQueue, ^{});
+    NSTimeInterval elapsed = [FBUtility monotonicTime] - start;
+
+    NSLog(@"FBCacheBenchmark index workload: %lu keys, %.0f ops/sec (%lu gets, %lu sets, %lu removes)",
+          (unsigned long)_keyCount, operations / elapsed,
+          (unsigned long)gets, (unsigned long)sets, (unsigned long)removes);
+}
+
+- (void)testTrimAtCapacity
+{
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+
+    FBCacheIndex *cacheIndex = [[[FBCacheIndex alloc] initWithCacheFolder:_cacheFolder] autorelease];
+    cacheIndex.diskCapacity = 10 * 1024 * 1024;
+    cacheIndex.delegate = self;
+
+    // Fill well past capacity so every store beyond it has to trim
+    for (NSUInteger key = 0; key < _keyCount; key++) {
+        @autoreleasepool {
+            [cacheIndex storeFileForKey:[[self URLForKey:key] absoluteString]
+                               withData:[self fillerDataOfSize:FBCacheBenchmarkEntrySize()]];
+        }
+    }
+    dispatch_sync(cacheIndex.databaseQueue, ^{});
+
+    FBCacheIndexStatistics statistics = [cacheIndex statistics];
+    STAssertTrue(statistics.trimCount > 0, @"filling past capacity should have trimmed");
+    STAssertTrue(cacheIndex.currentDiskUsage <= cacheIndex.diskCapacity, @"trims should keep usage under capacity");
+    NSLog(@"FBCacheBenchmark trim: %llu trims, %.3f ms each, %llu entries evicted",
+          statistics.trimCount,
+          statistics.trimCount ? statistics.trimDuration * 1000 / statistics.trimCount : 0,
+          statistics.evictionCount);
+}
+
+- (void)testLookupLatency
+{
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+
+    FBDataDiskCache *cache = [FBDataDiskCache sharedCache];
+    NSUInteger memoryBudget = cache.cacheSizeMemory;
+    NSUInteger sampleCount = MIN(_keyCount, (NSUInteger)2000);
+
+    for (NSUInteger key = 0; key < sampleCount; key++) {
+        @autoreleasepool {
+            [cache setData:[self dataForKey:key size:FBCacheBenchmarkEntrySize()] forURL:[self URLForKey:key]];
+        }
+    }
+    dispatch_sync(cache.fileQueue, ^{});
+
+    double *samples = calloc(sampleCount, sizeof(double));
+    for (int pass = 0; pass < 2; pass++) {
+        BOOL disk = (pass == 1);
+        if (disk) {
+            // Too small for anything to stay in memory, so every hit is read from disk
+            cache.cacheSizeMemory = 1;
+        }
+        for (NSUInteger i = 0; i < sampleCount; i++) {
+            @autoreleasepool {
+                NSURL *url = [self URLForKey:arc4random_uniform((uint32_t)sampleCount)];
+                NSTimeInterval start = [FBUtility monotonicTime];
+                [cache dataForURL:url];
+                samples[i] = ([FBUtility monotonicTime] - start) * 1000000;
+            }
+        }
+        double p50 = FBCacheBenchmarkPercentile(samples, sampleCount, 0.5);
+        double p99 = FBCacheBenchmarkPercentile(samples, sampleCount, 0.99);
+        NSLog(@"FBCacheBenchmark dataForURL: %@ hits: p50 %.1f us, p99 %.1f us",
+              disk ? @"disk" : @"memory", p50, p99);
+    }
+    free(samples);
+
+    cache.cacheSizeMemory = memoryBudget;
+    [self removeKeysFromCache:cache];
+}
+
+- (void)testConcurrentAccessStress
+{
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+
+    FBDataDiskCache *cache = [FBDataDiskCache sharedCache];
+    NSUInteger keyCount = _keyCount;
+    NSUInteger operationsPerQueue = keyCount;
+    __block int32_t corruptEntries = 0;
+
+    dispatch_group_t group = dispatch_group_create();
+    NSTimeInterval start = [FBUtility monotonicTime];
+    for (NSUInteger q = 0; q < kFBCacheBenchmarkStressQueues; q++) {
+        dispatch_queue_t queue = dispatch_queue_create("com.facebook.sdk.FBCacheBenchmarkTests", DISPATCH_QUEUE_SERIAL);
+        dispatch_group_async(group, queue, ^{
+            for (NSUInteger i = 0; i < operationsPerQueue; i++) {
+                @autoreleasepool {
+                    NSUInteger key = arc4random_uniform((uint32_t)keyCount);
+                    NSURL *url = [self URLForKey:key];
+                    uint32_t roll = arc4random_uniform(100);
+                    if (roll < 60) {
+                        NSData *data = [cache dataForURL:url];
+                        NSUInteger storedKey = 0;
+                        if (data.length >= sizeof(storedKey)) {
+                            memcpy(&storedKey, data.bytes, sizeof(storedKey));
+                            if (storedKey != key) {
+                                OSAtomicIncrement32Barrier(&corruptEntries);
+                            }
+                        }
+                    } else if (roll < 90) {
+                        [cache setData:[self dataForKey:key size:FBCacheBenchmarkEntrySize()] forURL:url];
+                    } else {
+                        [cache removeDataForUrl:url];
+                    }
+                }
+            }
+        });
+        dispatch_release(queue);
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+    dispatch_sync(cache.fileQueue, ^{});
+    NSTimeInterval elapsed = [FBUtility monotonicTime] - start;
+
+    STAssertEquals(corruptEntries, (int32_t)0, @"lookups returned data stored for another key");
+    NSLog(@"FBCacheBenchmark concurrent stress: %lu queues, %.0f ops/sec",
+          (unsigned long)kFBCacheBenchmarkStressQueues,
+          kFBCacheBenchmarkStressQueues * operationsPerQueue / elapsed);
+
+    [self removeKeysFromCache:cache];
+}
+
+@end
@@ -19,6 +19,6 @@
 #import "FBDataDiskCache.h"
 #import "FBTests.h"
 
-@interface FBCacheTests : FBTests // TODO<FBCacheIndexFileDelegate>
+@interface FBCacheTests : FBTests <FBCacheIndexFileDelegate>
 
 @end
@@ -14,9 +14,15 @@
  * limitations under the License.
  */
 
+#import <sqlite3.h>
+
+#import <OCMock/OCMock.h>
+
+#import "FBAccessTokenData.h"
 #import "FBCacheTests.h"
 #import "FBDataDiskCache.h"
 #import "FBCacheIndex.h"
+#import "FBMappedCacheIndex.h"
 #import "FBTests.h"
 #import "FBTestBlocker.h"
 #import "FBCacheDescriptor.h"
@@ -29,17 +35,537 @@
 @class FBCacheEntityInfo;
 
 @implementation FBCacheTests
+{
+    NSString *_cacheFolder;
+    NSMutableArray *_writtenFiles;
+    NSMutableArray *_deletedFiles;
+}
 
 #pragma mark - Setup/Teardown
 
 - (void)setUp
 {
+    [super setUp];
+
+    _cacheFolder = [[NSTemporaryDirectory() stringByAppendingPathComponent:
+                     [NSString stringWithFormat:@"FBCacheTests-%u", arc4random()]] retain];
+    [[NSFileManager defaultManager] createDirectoryAtPath:_cacheFolder
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:nil];
+    _writtenFiles = [[NSMutableArray alloc] init];
+    _deletedFiles = [[NSMutableArray alloc] init];
 }
 
 - (void)tearDown
 {
+    [[NSFileManager defaultManager] removeItemAtPath:_cacheFolder error:nil];
+    [_cacheFolder release];
+    _cacheFolder = nil;
+    [_writtenFiles release];
+    _writtenFiles = nil;
+    [_deletedFiles release];
+    _deletedFiles = nil;
+
+    [super tearDown];
+}
+
+#pragma mark - Helpers
+
+- (FBCacheIndex *)createCacheIndex
+{
+    FBCacheIndex *cacheIndex = [[[FBCacheIndex alloc] initWithCacheFolder:_cacheFolder] autorelease];
+    cacheIndex.diskCapacity = 1024 * 1024;
+    cacheIndex.delegate = self;
+    return cacheIndex;
+}
+
+- (void)waitForCacheIndex:(FBCacheIndex *)cacheIndex
+{
+    dispatch_sync(cacheIndex.databaseQueue, ^{});
+}
+
+#pragma mark - FBCacheIndexFileDelegate
+
+- (void)cacheIndex:(id<FBCacheIndexing>)cacheIndex
+ writeFileWithName:(NSString *)name
+              data:(NSData *)data
+{
+    @synchronized(_writtenFiles) {
+        [_writtenFiles addObject:name];
+    }
+}
+
+- (void)cacheIndex:(id<FBCacheIndexing>)cacheIndex
+deleteFileWithName:(NSString *)name
+{
+    @synchronized(_deletedFiles) {
+        [_deletedFiles addObject:name];
+    }
 }
 
-// TODO: write unit tests
+#pragma mark - FBCacheIndex tests
+
+- (void)testStoreAndLookup
+{
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    NSData *data = [@"data" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSString *fileName = [cacheIndex storeFileForKey:@"key" withData:data];
+    assertThat(fileName, notNilValue());
+    assertThat([cacheIndex fileNameForKey:@"key"], equalTo(fileName));
+    assertThat(_writtenFiles, hasItem(fileName));
+    assertThat([cacheIndex fileNameForKey:@"missing"], nilValue());
+}
+
+- (void)testStoredEntriesAreVisibleBeforeBatchFlush
+{
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    cacheIndex.entryCacheCountLimit = 1;
+    NSData *data = [@"data" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSString *first = [cacheIndex storeFileForKey:@"first" withData:data];
+    [cacheIndex storeFileForKey:@"second" withData:data];
+    [self waitForCacheIndex:cacheIndex];
+
+    // "first" has been evicted from memory but may not have been committed yet
+    assertThat([cacheIndex fileNameForKey:@"first"], equalTo(first));
+}
+
+- (void)testRemoveEntriesInNamespaceFlushesPendingWrites
+{
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    NSData *data = [@"data" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSString *tokenFile = [cacheIndex storeFileForKey:@"http://a/?access_token=abc"
+                                             withData:data
+                                            namespace:@"abc"];
+    NSString *otherFile = [cacheIndex storeFileForKey:@"http://a/image"
+                                             withData:data
+                                            namespace:@""];
+
+    NSUInteger removedCount = [cacheIndex removeEntriesInNamespace:@"abc"];
+    [self waitForCacheIndex:cacheIndex];
+
+    assertThatUnsignedInteger(removedCount, equalToUnsignedInteger(1));
+    assertThat(_deletedFiles, hasItem(tokenFile));
+    assertThat([cacheIndex fileNameForKey:@"http://a/?access_token=abc"], nilValue());
+    assertThat([cacheIndex fileNameForKey:@"http://a/image"], equalTo(otherFile));
+}
+
+- (void)testRemoveEntriesInNilNamespace
+{
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    NSData *data = [@"data" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSString *legacyFile = [cacheIndex storeFileForKey:@"legacy" withData:data];
+    [cacheIndex storeFileForKey:@"shared" withData:data namespace:@""];
+
+    NSUInteger removedCount = [cacheIndex removeEntriesInNamespace:nil];
+    [self waitForCacheIndex:cacheIndex];
+
+    assertThatUnsignedInteger(removedCount, equalToUnsignedInteger(1));
+    assertThat(_deletedFiles, contains(legacyFile, nil));
+}
+
+- (void)testTrimEvictsLeastRecentlyUsedEntries
+{
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    cacheIndex.diskCapacity = 25;
+    NSData *data = [@"0123456789" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSString *oldest = [cacheIndex storeFileForKey:@"oldest" withData:data];
+    NSString *middle = [cacheIndex storeFileForKey:@"middle" withData:data];
+    NSString *newest = [cacheIndex storeFileForKey:@"newest" withData:data];
+    [self waitForCacheIndex:cacheIndex];
+
+    assertThat(_deletedFiles, hasItem(oldest));
+    assertThat(_deletedFiles, isNot(hasItem(middle)));
+    assertThat(_deletedFiles, isNot(hasItem(newest)));
+    assertThatUnsignedInteger(cacheIndex.currentDiskUsage, equalToUnsignedInteger(20));
+    assertThat([cacheIndex fileNameForKey:@"oldest"], nilValue());
+}
+
+- (void)testSupersedingAPendingWriteKeepsDiskUsage
+{
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    NSData *data = [@"0123456789" dataUsingEncoding:NSUTF8StringEncoding];
+
+    // Both writes land in the same pending batch
+    NSString *first = [cacheIndex storeFileForKey:@"key" withData:data];
+    NSString *second = [cacheIndex storeFileForKey:@"key" withData:data];
+    [self waitForCacheIndex:cacheIndex];
+
+    assertThat(_deletedFiles, contains(first, nil));
+    assertThatUnsignedInteger(cacheIndex.currentDiskUsage, equalToUnsignedInteger(10));
+    assertThat([cacheIndex fileNameForKey:@"key"], equalTo(second));
+}
+
+- (void)testTrimUpdatesStatistics
+{
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    cacheIndex.diskCapacity = 25;
+    NSData *data = [@"0123456789" dataUsingEncoding:NSUTF8StringEncoding];
+
+    [cacheIndex storeFileForKey:@"oldest" withData:data];
+    [cacheIndex storeFileForKey:@"middle" withData:data];
+    [cacheIndex storeFileForKey:@"newest" withData:data];
+    [self waitForCacheIndex:cacheIndex];
+
+    FBCacheIndexStatistics statistics = [cacheIndex statistics];
+    assertThatUnsignedLongLong(statistics.trimCount, equalToUnsignedLongLong(1));
+    assertThatUnsignedLongLong(statistics.evictionCount, equalToUnsignedLongLong(1));
+    assertThatUnsignedLongLong(statistics.evictedBytes, equalToUnsignedLongLong(10));
+
+    [cacheIndex resetStatistics];
+    assertThatUnsignedLongLong([cacheIndex statistics].trimCount, equalToUnsignedLongLong(0));
+}
+
+- (void)testReopenedIndexRestoresEntriesAndDiskUsage
+{
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    NSData *data = [@"0123456789" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSString *fileName = [cacheIndex storeFileForKey:@"key" withData:data];
+    [cacheIndex storeFileForKey:@"other" withData:data];
+    // Purging forces the pending batch to be committed first
+    [cacheIndex removeEntriesInNamespace:@"unused"];
+
+    FBCacheIndex *reopenedIndex = [self createCacheIndex];
+    [self waitForCacheIndex:reopenedIndex];
+
+    assertThatUnsignedInteger(reopenedIndex.currentDiskUsage, equalToUnsignedInteger(20));
+    assertThat([reopenedIndex fileNameForKey:@"key"], equalTo(fileName));
+}
+
+- (void)testOpeningLegacyDatabaseMigratesKeys
+{
+    // Laid out the way the index was before keys were hashed
+    sqlite3 *database = NULL;
+    NSString *databasePath = [_cacheFolder stringByAppendingPathComponent:@"cache.db"];
+    sqlite3_open(databasePath.UTF8String, &database);
+    sqlite3_exec(database,
+                 "CREATE TABLE cache_index "
+                 "(uuid TEXT, key TEXT PRIMARY KEY, access_time REAL, file_size INTEGER, namespace TEXT);"
+                 "CREATE INDEX cache_index_namespace ON cache_index (namespace);"
+                 "INSERT INTO cache_index VALUES ('legacy-file', 'http://a/?access_token=abc', 1, 10, 'abc');",
+                 NULL, NULL, NULL);
+    sqlite3_close(database);
+
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    [self waitForCacheIndex:cacheIndex];
+
+    assertThat([cacheIndex fileNameForKey:@"http://a/?access_token=abc"], equalTo(@"legacy-file"));
+    assertThatUnsignedInteger([cacheIndex removeEntriesInNamespace:@"abc"], equalToUnsignedInteger(1));
+    assertThat(_deletedFiles, contains(@"legacy-file", nil));
+}
+
+- (void)testOpeningDatabaseWithoutNamespacesPutsEntriesInTheNilNamespace
+{
+    // Laid out the way the index was before namespaces existed
+    sqlite3 *database = NULL;
+    NSString *databasePath = [_cacheFolder stringByAppendingPathComponent:@"cache.db"];
+    sqlite3_open(databasePath.UTF8String, &database);
+    sqlite3_exec(database,
+                 "CREATE TABLE cache_index "
+                 "(uuid TEXT, key TEXT PRIMARY KEY, access_time REAL, file_size INTEGER);"
+                 "INSERT INTO cache_index VALUES ('unscoped-file', 'http://a/?access_token=abc', 1, 10);",
+                 NULL, NULL, NULL);
+    sqlite3_close(database);
+
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    [self waitForCacheIndex:cacheIndex];
+
+    assertThatUnsignedInteger([cacheIndex removeEntriesInNamespace:@"abc"], equalToUnsignedInteger(0));
+    assertThatUnsignedInteger([cacheIndex removeEntriesInNamespace:nil], equalToUnsignedInteger(1));
+    assertThat(_deletedFiles, contains(@"unscoped-file", nil));
+}
+
+- (void)testCorruptDatabaseIsRecreated
+{
+    [[@"not a database" dataUsingEncoding:NSUTF8StringEncoding]
+     writeToFile:[_cacheFolder stringByAppendingPathComponent:@"cache.db"] atomically:YES];
+
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    assertThat(cacheIndex, notNilValue());
+    [self waitForCacheIndex:cacheIndex];
+
+    NSData *data = [@"data" dataUsingEncoding:NSUTF8StringEncoding];
+    NSString *fileName = [cacheIndex storeFileForKey:@"key" withData:data];
+    [cacheIndex removeEntriesInNamespace:@"unused"];
+
+    FBCacheIndex *reopenedIndex = [self createCacheIndex];
+    [self waitForCacheIndex:reopenedIndex];
+    assertThat([reopenedIndex fileNameForKey:@"key"], equalTo(fileName));
+}
+
+- (void)testOrphanedFilesAreSweptInTheBackground
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSDictionary *oldAttributes = @{NSFileModificationDate: [NSDate dateWithTimeIntervalSinceNow:-3600]};
+    for (NSString *name in @[@"orphan", @"recent"]) {
+        NSString *path = [_cacheFolder stringByAppendingPathComponent:name];
+        [[NSData data] writeToFile:path atomically:YES];
+        if ([name isEqualToString:@"orphan"]) {
+            [fileManager setAttributes:oldAttributes ofItemAtPath:path error:nil];
+        }
+    }
+
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    // The sweep runs a batch per pass through the queue
+    for (int i = 0; i < 5; i++) {
+        [self waitForCacheIndex:cacheIndex];
+    }
+
+    assertThat(_deletedFiles, contains(@"orphan", nil));
+}
+
+#pragma mark - FBMappedCacheIndex tests
+
+- (FBMappedCacheIndex *)newMappedCacheIndex
+{
+    FBMappedCacheIndex *cacheIndex = [[FBMappedCacheIndex alloc] initWithCacheFolder:_cacheFolder];
+    cacheIndex.diskCapacity = 1024 * 1024;
+    cacheIndex.delegate = self;
+    return cacheIndex;
+}
+
+- (void)testMappedIndexStoresAndReplacesEntries
+{
+    FBMappedCacheIndex *cacheIndex = [[self newMappedCacheIndex] autorelease];
+    NSData *data = [@"0123456789" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSString *first = [cacheIndex storeFileForKey:@"key" withData:data];
+    assertThat([cacheIndex fileNameForKey:@"key"], equalTo(first));
+    assertThat([cacheIndex fileNameForKey:@"missing"], nilValue());
+
+    NSString *second = [cacheIndex storeFileForKey:@"key" withData:data];
+    assertThat([cacheIndex fileNameForKey:@"key"], equalTo(second));
+    assertThat(_deletedFiles, contains(first, nil));
+    assertThatUnsignedInteger(cacheIndex.currentDiskUsage, equalToUnsignedInteger(10));
+}
+
+- (void)testMappedIndexRemovesEntriesInNamespace
+{
+    FBMappedCacheIndex *cacheIndex = [[self newMappedCacheIndex] autorelease];
+    NSData *data = [@"data" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSString *tokenFile = [cacheIndex storeFileForKey:@"http://a/?access_token=abc"
+                                             withData:data
+                                            namespace:@"abc"];
+    NSString *sharedFile = [cacheIndex storeFileForKey:@"http://a/image"
+                                              withData:data
+                                             namespace:@""];
+    NSString *legacyFile = [cacheIndex storeFileForKey:@"legacy" withData:data];
+
+    assertThatUnsignedInteger([cacheIndex removeEntriesInNamespace:@"abc"], equalToUnsignedInteger(1));
+    assertThatUnsignedInteger([cacheIndex removeEntriesInNamespace:nil], equalToUnsignedInteger(1));
+
+    assertThat(_deletedFiles, contains(tokenFile, legacyFile, nil));
+    assertThat([cacheIndex fileNameForKey:@"http://a/image"], equalTo(sharedFile));
+}
+
+- (void)testMappedIndexGrowsPastInitialCapacity
+{
+    FBMappedCacheIndex *cacheIndex = [[self newMappedCacheIndex] autorelease];
+    NSData *data = [@"x" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSMutableArray *fileNames = [NSMutableArray array];
+    for (int i = 0; i < 2000; i++) {
+        [fileNames addObject:[cacheIndex storeFileForKey:[NSString stringWithFormat:@"key%d", i] withData:data]];
+    }
+
+    assertThatUnsignedInteger(cacheIndex.currentDiskUsage, equalToUnsignedInteger(2000));
+    for (int i = 0; i < 2000; i += 97) {
+        assertThat([cacheIndex fileNameForKey:[NSString stringWithFormat:@"key%d", i]],
+                   equalTo([fileNames objectAtIndex:i]));
+    }
+}
+
+- (void)testReopenedMappedIndexRestoresEntriesAndDiskUsage
+{
+    FBMappedCacheIndex *cacheIndex = [self newMappedCacheIndex];
+    NSData *data = [@"0123456789" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSString *fileName = [cacheIndex storeFileForKey:@"key" withData:data];
+    [cacheIndex storeFileForKey:@"other" withData:data];
+    [cacheIndex storeFileForKey:@"removed" withData:data];
+    [cacheIndex removeEntryForKey:@"removed"];
+    [cacheIndex release];
+
+    FBMappedCacheIndex *reopenedIndex = [[self newMappedCacheIndex] autorelease];
+
+    assertThatUnsignedInteger(reopenedIndex.currentDiskUsage, equalToUnsignedInteger(20));
+    assertThat([reopenedIndex fileNameForKey:@"key"], equalTo(fileName));
+    assertThat([reopenedIndex fileNameForKey:@"removed"], nilValue());
+}
+
+- (void)testMappedIndexKeepsEntryWithTornAccessTime
+{
+    FBMappedCacheIndex *cacheIndex = [self newMappedCacheIndex];
+    NSData *data = [@"0123456789" dataUsingEncoding:NSUTF8StringEncoding];
+    NSString *fileName = [cacheIndex storeFileForKey:@"key" withData:data];
+    [cacheIndex fileNameForKey:@"key"];
+    [cacheIndex release];
+
+    // The access time follows the 48 byte file name and the namespace hash
+    NSString *tablePath = [_cacheFolder stringByAppendingPathComponent:@"cache.idx"];
+    NSMutableData *table = [NSMutableData dataWithContentsOfFile:tablePath];
+    NSData *nameBytes = [fileName dataUsingEncoding:NSUTF8StringEncoding];
+    NSRange nameRange = [table rangeOfData:nameBytes options:0 range:NSMakeRange(0, table.length)];
+    STAssertTrue(nameRange.location != NSNotFound, @"slot not found in table");
+    uint32_t torn = 0xdeadbeef;
+    [table replaceBytesInRange:NSMakeRange(nameRange.location + 48 + 8, sizeof(torn)) withBytes:&torn];
+    [table writeToFile:tablePath atomically:NO];
+
+    FBMappedCacheIndex *reopenedIndex = [[self newMappedCacheIndex] autorelease];
+
+    assertThat([reopenedIndex fileNameForKey:@"key"], equalTo(fileName));
+    assertThatUnsignedInteger(reopenedIndex.currentDiskUsage, equalToUnsignedInteger(10));
+}
+
+- (void)testStreamedWriterCommitsIntoCache
+{
+    FBDataDiskCache *cache = [[[FBDataDiskCache alloc] init] autorelease];
+    NSURL *url = [NSURL URLWithString:@"https://fbcdn.net/streamed.jpg"];
+
+    FBDataDiskCacheWriter *writer = [cache writerForURL:url];
+    [writer appendData:[@"0123" dataUsingEncoding:NSUTF8StringEncoding]];
+    [writer appendData:[@"456789" dataUsingEncoding:NSUTF8StringEncoding]];
+    NSData *committed = [writer commit];
+
+    NSData *expected = [@"0123456789" dataUsingEncoding:NSUTF8StringEncoding];
+    assertThat(committed, equalTo(expected));
+    assertThat([cache dataForURL:url], equalTo(expected));
+
+    [cache removeDataForUrl:url];
+}
+
+- (void)testRemovingSessionDataKeepsOtherSessionsEntries
+{
+    FBDataDiskCache *cache = [[[FBDataDiskCache alloc] init] autorelease];
+    NSData *data = [@"data" dataUsingEncoding:NSUTF8StringEncoding];
+    // The namespace is the decoded token, wherever it sits in the query
+    NSURL *sessionURL = [NSURL URLWithString:@"https://graph.facebook.com/me?access_token=abc%2B1&fields=id"];
+    NSURL *otherSessionURL = [NSURL URLWithString:@"https://graph.facebook.com/me?access_token=xyz"];
+    NSURL *sharedURL = [NSURL URLWithString:@"https://fbcdn.net/shared.jpg"];
+    [cache setData:data forURL:sessionURL];
+    [cache setData:data forURL:otherSessionURL];
+    [cache setData:data forURL:sharedURL];
+
+    FBAccessTokenData *tokenData = [FBAccessTokenData createTokenFromString:@"abc+1"
+                                                                permissions:nil
+                                                             expirationDate:nil
+                                                                  loginType:FBSessionLoginTypeNone
+                                                                refreshDate:nil];
+    id session = [OCMockObject niceMockForClass:[FBSession class]];
+    [[[session stub] andReturn:tokenData] accessTokenData];
+    [cache removeDataForSession:session];
+
+    assertThat([cache dataForURL:sessionURL], nilValue());
+    assertThat([cache dataForURL:sharedURL], nilValue());
+
+    // Read behind the queued file write
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block NSData *otherSessionData = nil;
+    [cache dataForURL:otherSessionURL completion:^(NSData *result) {
+        otherSessionData = [result retain];
+        [blocker signal];
+    }];
+    assertThatBool([blocker waitWithTimeout:5], equalToBool(YES));
+    assertThat([otherSessionData autorelease], equalTo(data));
+
+    [cache removeDataForUrl:otherSessionURL];
+}
+
+- (void)testDataCacheCountsHitsAndMisses
+{
+    FBDataDiskCache *cache = [[[FBDataDiskCache alloc] init] autorelease];
+    NSURL *url = [NSURL URLWithString:@"https://fbcdn.net/statistics.jpg"];
+    NSURL *missingURL = [NSURL URLWithString:@"https://fbcdn.net/missing.jpg"];
+    [cache resetStatistics];
+
+    [cache setData:[@"data" dataUsingEncoding:NSUTF8StringEncoding] forURL:url];
+    [cache dataForURL:url];
+    [cache dataForURL:missingURL];
+
+    FBDataDiskCacheStatistics statistics = [cache statistics];
+    assertThatUnsignedLongLong(statistics.memoryHits, equalToUnsignedLongLong(1));
+    assertThatUnsignedLongLong(statistics.misses, equalToUnsignedLongLong(1));
+    assertThatDouble(statistics.memoryHitRatio, equalToDouble(0.5));
+
+    [cache removeDataForUrl:url];
+}
+
+- (void)testDataCacheCountsDiskHitsAndWaits
+{
+    FBDataDiskCache *cache = [[[FBDataDiskCache alloc] init] autorelease];
+    NSURL *url = [NSURL URLWithString:@"https://fbcdn.net/disk-statistics.jpg"];
+    [cache resetStatistics];
+    assertThatDouble([cache statistics].memoryHitRatio, equalToDouble(0));
+
+    FBDataDiskCacheWriter *writer = [cache writerForURL:url];
+    [writer appendData:[@"data" dataUsingEncoding:NSUTF8StringEncoding]];
+    [writer commit];
+    assertThatUnsignedLongLong([cache statistics].syncWaitCount, greaterThanOrEqualTo(@1));
+    [cache shedMemoryToCost:0];
+
+    // The first lookup reads the file back in, the second finds it in memory
+    for (NSUInteger i = 0; i < 2; i++) {
+        FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+        [cache dataForURL:url completion:^(NSData *data) {
+            [blocker signal];
+        }];
+        assertThatBool([blocker waitWithTimeout:5], equalToBool(YES));
+    }
+
+    FBDataDiskCacheStatistics statistics = [cache statistics];
+    assertThatUnsignedLongLong(statistics.diskHits, equalToUnsignedLongLong(1));
+    assertThatUnsignedLongLong(statistics.memoryHits, equalToUnsignedLongLong(1));
+    assertThatUnsignedLongLong(statistics.misses, equalToUnsignedLongLong(0));
+    assertThatDouble(statistics.diskHitRatio, equalToDouble(0.5));
+
+    [cache removeDataForUrl:url];
+}
+
+- (void)testAdmissionRequiresRepeatedLookupsUnderPressure
+{
+    FBDataDiskCache *cache = [[[FBDataDiskCache alloc] init] autorelease];
+    NSURL *url = [NSURL URLWithString:@"https://fbcdn.net/admission.jpg"];
+    // Larger than the whole disk tier, so it could only be stored by evicting
+    NSUInteger length = 64 * 1024 * 1024;
+
+    assertThatBool([cache shouldAdmitDataOfLength:1 forURL:url], equalToBool(YES));
+    assertThatBool([cache shouldAdmitDataOfLength:length forURL:url], equalToBool(NO));
+
+    [cache dataForURL:url];
+    assertThatBool([cache shouldAdmitDataOfLength:length forURL:url], equalToBool(NO));
+
+    [cache dataForURL:url];
+    assertThatBool([cache shouldAdmitDataOfLength:length forURL:url], equalToBool(YES));
+}
+
+- (void)testConcurrentLookups
+{
+    FBCacheIndex *cacheIndex = [self createCacheIndex];
+    cacheIndex.entryCacheCountLimit = 4;
+    NSData *data = [@"data" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSMutableDictionary *fileNames = [NSMutableDictionary dictionary];
+    for (int i = 0; i < 32; i++) {
+        NSString *key = [NSString stringWithFormat:@"key%d", i];
+        [fileNames setObject:[cacheIndex storeFileForKey:key withData:data] forKey:key];
+    }
+    [self waitForCacheIndex:cacheIndex];
+
+    __block BOOL allFound = YES;
+    dispatch_apply(256, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        NSString *key = [NSString stringWithFormat:@"key%zu", i % 32];
+        if (![[cacheIndex fileNameForKey:key] isEqualToString:[fileNames objectForKey:key]]) {
+            allFound = NO;
+        }
+    });
+    assertThatBool(allFound, equalToBool(YES));
+}
 
 @end
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <SenTestingKit/SenTestingKit.h>
+#import <libkern/OSAtomic.h>
+
+#import "FBBase64.h"
+#import "FBCrypto.h"
+
+@interface FBCryptoTests : SenTestCase
+@end
+
+@implementation FBCryptoTests
+{
+    FBCrypto *_crypto;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    _crypto = [[FBCrypto alloc] initWithMasterKey:[FBCrypto makeMasterKey]];
+}
+
+- (void)tearDown
+{
+    [_crypto release];
+    _crypto = nil;
+    [super tearDown];
+}
+
+// Lengths either side of the 16 byte AES block and the 64KB chunk
+- (NSArray *)boundaryLengths
+{
+    return @[@0, @1, @15, @16, @17, @(64 * 1024 - 1), @(64 * 1024), @(64 * 1024 + 1), @(200 * 1024)];
+}
+
+- (void)testRoundTripsAcrossBlockAndChunkBoundaries
+{
+    NSData *signedData = [@"signed" dataUsingEncoding:NSUTF8StringEncoding];
+    for (NSNumber *length in [self boundaryLengths]) {
+        NSData *plainText = [FBCrypto randomBytes:length.unsignedIntegerValue] ?: [NSData data];
+        NSString *cipherText = [_crypto encrypt:plainText additionalDataToSign:signedData];
+        STAssertEqualObjects([_crypto decrypt:cipherText additionalSignedData:signedData], plainText,
+                             @"%@ bytes did not round trip", length);
+    }
+}
+
+- (void)testStreamedEncryptionDecryptsLikeTheInMemoryForm
+{
+    for (NSNumber *length in [self boundaryLengths]) {
+        NSData *plainText = [FBCrypto randomBytes:length.unsignedIntegerValue] ?: [NSData data];
+        NSInputStream *input = [NSInputStream inputStreamWithData:plainText];
+        NSData *cipherData = [_crypto encryptInputStream:input length:plainText.length additionalDataToSign:nil];
+        STAssertNotNil(cipherData, @"%@ bytes failed to encrypt", length);
+        STAssertEqualObjects([_crypto decrypt:FBEncodeBase64(cipherData) additionalSignedData:nil], plainText,
+                             @"%@ bytes did not round trip", length);
+
+        NSOutputStream *output = [NSOutputStream outputStreamToMemory];
+        STAssertTrue([_crypto decryptData:cipherData additionalSignedData:nil toOutputStream:output], nil);
+        STAssertEqualObjects([output propertyForKey:NSStreamDataWrittenToMemoryStreamKey], plainText,
+                             @"%@ bytes did not stream back out", length);
+        [output close];
+    }
+}
+
+- (void)testStreamEndingEarlyFailsEncryption
+{
+    NSData *plainText = [FBCrypto randomBytes:100];
+    NSInputStream *input = [NSInputStream inputStreamWithData:plainText];
+    STAssertNil([_crypto encryptInputStream:input length:101 additionalDataToSign:nil],
+                @"a stream shorter than its stated length should not encrypt");
+}
+
+- (void)testChunksArriveInOrderAndBoundedInSize
+{
+    NSData *plainText = [FBCrypto randomBytes:200 * 1024];
+    NSString *cipherText = [_crypto encrypt:plainText additionalDataToSign:nil];
+
+    NSMutableData *collected = [NSMutableData data];
+    __block size_t largestChunk = 0;
+    BOOL succeeded = [_crypto decrypt:cipherText additionalSignedData:nil chunkHandler:^BOOL(const uint8_t *bytes, size_t length) {
+        largestChunk = MAX(largestChunk, length);
+        [collected appendBytes:bytes length:length];
+        return YES;
+    }];
+
+    STAssertTrue(succeeded, nil);
+    STAssertEqualObjects(collected, plainText, @"chunks should add up to the plain text");
+    STAssertTrue(largestChunk <= 64 * 1024 + 16, @"a chunk was larger than the working buffer");
+}
+
+- (void)testChunkHandlerCanStopDecryption
+{
+    NSString *cipherText = [_crypto encrypt:[FBCrypto randomBytes:200 * 1024] additionalDataToSign:nil];
+    __block int calls = 0;
+    BOOL succeeded = [_crypto decrypt:cipherText additionalSignedData:nil chunkHandler:^BOOL(const uint8_t *bytes, size_t length) {
+        calls++;
+        return NO;
+    }];
+    STAssertFalse(succeeded, nil);
+    STAssertEquals(1, calls, @"no more chunks should be handed on after the handler says stop");
+}
+
+- (void)testTamperedCipherTextHandsNothingOn
+{
+    NSData *signedData = [@"signed" dataUsingEncoding:NSUTF8StringEncoding];
+    NSString *cipherText = [_crypto encrypt:[FBCrypto randomBytes:1000] additionalDataToSign:signedData];
+    NSMutableData *cipherData = [[FBDecodeBase64(cipherText) mutableCopy] autorelease];
+    ((uint8_t *)cipherData.mutableBytes)[cipherData.length - 1] ^= 1;
+
+    __block BOOL handedOn = NO;
+    STAssertFalse([_crypto decrypt:FBEncodeBase64(cipherData) additionalSignedData:signedData chunkHandler:^BOOL(const uint8_t *bytes, size_t length) {
+        handedOn = YES;
+        return YES;
+    }], nil);
+    STAssertFalse(handedOn, @"nothing should be handed on before the MAC is checked");
+
+    NSOutputStream *output = [NSOutputStream outputStreamToMemory];
+    STAssertFalse([_crypto decryptData:cipherData additionalSignedData:signedData toOutputStream:output], nil);
+    STAssertEquals((NSUInteger)0, [[output propertyForKey:NSStreamDataWrittenToMemoryStreamKey] length],
+                   @"nothing should be written when the MAC does not match");
+    [output close];
+
+    NSString *untampered = FBEncodeBase64(FBDecodeBase64(cipherText));
+    STAssertNil([_crypto decrypt:untampered additionalSignedData:[NSData data]],
+                @"the signed data should be covered by the MAC");
+}
+
+- (void)testReusedKeyStateMatchesAFreshInstance
+{
+    NSString *masterKey = [FBCrypto makeMasterKey];
+    FBCrypto *first = [[[FBCrypto alloc] initWithMasterKey:masterKey] autorelease];
+    NSData *plainText = [FBCrypto randomBytes:1000];
+    NSData *signedData = [@"signed" dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSMutableArray *cipherTexts = [NSMutableArray array];
+    for (int i = 0; i < 3; i++) {
+        [cipherTexts addObject:[first encrypt:plainText additionalDataToSign:signedData]];
+    }
+    STAssertFalse([cipherTexts[0] isEqualToString:cipherTexts[1]], @"each message should get its own IV");
+
+    // The key is only scheduled once per instance, so a later message must still be signed and encrypted
+    // as if by a newly keyed one
+    for (NSString *cipherText in cipherTexts) {
+        FBCrypto *fresh = [[[FBCrypto alloc] initWithMasterKey:masterKey] autorelease];
+        STAssertEqualObjects([fresh decrypt:cipherText additionalSignedData:signedData], plainText, nil);
+        STAssertEqualObjects([first decrypt:cipherText additionalSignedData:signedData], plainText, nil);
+    }
+}
+
+- (void)testSharedInstanceIsSafeAcrossThreads
+{
+    NSData *plainText = [FBCrypto randomBytes:100 * 1024];
+    __block int32_t failures = 0;
+    dispatch_apply(16, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        NSString *cipherText = [_crypto encrypt:plainText additionalDataToSign:nil];
+        if (![[_crypto decrypt:cipherText additionalSignedData:nil] isEqualToData:plainText]) {
+            OSAtomicIncrement32(&failures);
+        }
+    });
+    STAssertEquals(0, failures, @"concurrent callers should each get a cryptor of their own");
+}
+
+@end
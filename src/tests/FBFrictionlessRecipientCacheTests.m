@@ -0,0 +1,71 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "FBTests.h"
+
+#import "FBFrictionlessDialogSupportDelegate.h"
+#import "FBFrictionlessRecipientCache.h"
+#import "FBFrictionlessRequestSettings.h"
+
+@interface FBFrictionlessRecipientCacheTests : FBTests
+@end
+
+@implementation FBFrictionlessRecipientCacheTests
+
+- (void)testDeallocClearsSettingsHandler
+{
+    FBFrictionlessRequestSettings *settings = nil;
+    @autoreleasepool {
+        FBFrictionlessRecipientCache *cache = [[FBFrictionlessRecipientCache alloc] init];
+        settings = [[(id<FBFrictionlessDialogSupportDelegate>)cache frictionlessSettings] retain];
+        assertThat(settings.recipientCacheDidUpdateHandler, notNilValue());
+        [cache release];
+    }
+    // The handler does not keep the cache alive, so dealloc ran and cleared it
+    assertThat(settings.recipientCacheDidUpdateHandler, nilValue());
+    [settings release];
+}
+
+- (void)testLookupAcceptsStringsNumbersAndDictionaries
+{
+    FBFrictionlessRecipientCache *cache = [[[FBFrictionlessRecipientCache alloc] init] autorelease];
+    cache.recipientIDs = @[@"1", @"2"];
+
+    assertThatBool([cache isFrictionlessRecipient:@"1"], equalToBool(YES));
+    assertThatBool([cache isFrictionlessRecipient:@2], equalToBool(YES));
+    assertThatBool([cache isFrictionlessRecipient:@{@"id" : @"2"}], equalToBool(YES));
+    assertThatBool([cache isFrictionlessRecipient:@"3"], equalToBool(NO));
+    assertThatBool([cache areFrictionlessRecipients:@[@"1", @2]], equalToBool(YES));
+    assertThatBool([cache areFrictionlessRecipients:@[@"1", @"3"]], equalToBool(NO));
+}
+
+- (void)testDialogIsInvisibleOnlyWhenEveryRecipientIsCached
+{
+    FBFrictionlessRecipientCache *cache = [[[FBFrictionlessRecipientCache alloc] init] autorelease];
+    cache.recipientIDs = @[@"1", @"2"];
+    id<FBFrictionlessDialogSupportDelegate> delegate = (id<FBFrictionlessDialogSupportDelegate>)cache;
+
+    NSMutableDictionary *parameters = [NSMutableDictionary dictionaryWithObject:@"1,2" forKey:@"to"];
+    [cache webDialogsWillPresentDialog:@"apprequests" parameters:parameters session:nil];
+    assertThatBool([delegate frictionlessShouldMakeViewInvisible], equalToBool(YES));
+    assertThat(parameters[@"frictionless"], equalTo(@"1"));
+
+    parameters = [NSMutableDictionary dictionaryWithObject:@"[\"1\",\"3\"]" forKey:@"to"];
+    [cache webDialogsWillPresentDialog:@"apprequests" parameters:parameters session:nil];
+    assertThatBool([delegate frictionlessShouldMakeViewInvisible], equalToBool(NO));
+}
+
+@end
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <OCMock/OCMock.h>
+
+#import "FBFriendPickerViewController.h"
+#import "FBGraphObject.h"
+#import "FBGraphObjectTableDataSource.h"
+#import "FBRequestConnection.h"
+#import "FBTestBlocker.h"
+#import "FBTests.h"
+
+@interface FBFriendPickerViewController (Testing)
+
+@property (nonatomic, retain) FBGraphObjectTableDataSource *dataSource;
+@property (nonatomic, retain) FBRequestConnection *syncConnection;
+
+- (BOOL)needsFullSync;
+- (void)loadDataSkippingRoundTripIfCached:(NSNumber *)skipRoundTripIfCached;
+- (void)syncCachedFriends;
+
+@end
+
+@interface FBFriendPickerViewControllerTests : FBTests
+@end
+
+@implementation FBFriendPickerViewControllerTests
+
+// A picker showing alice (0), bill (1) and carl (2), with its last full fetch still recent
+- (id)mockPickerShowingCachedFriends
+{
+    FBFriendPickerViewController *picker = [[[FBFriendPickerViewController alloc] init] autorelease];
+    picker.session = [self createAndOpenSessionWithMockToken];
+
+    NSArray *names = @[@"alice", @"bill", @"carl"];
+    NSMutableArray *friends = [NSMutableArray array];
+    for (NSUInteger i = 0; i < names.count; i++) {
+        NSMutableDictionary<FBGraphObject> *friend = [FBGraphObject graphObject];
+        friend[@"id"] = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+        friend[@"name"] = names[i];
+        [friends addObject:friend];
+    }
+    [picker.dataSource appendGraphObjects:friends];
+    [self waitForUpdateOfDataSource:picker.dataSource];
+
+    id mockPicker = [OCMockObject partialMockForObject:picker];
+    [[[mockPicker stub] andReturnValue:OCMOCK_VALUE((BOOL){NO})] needsFullSync];
+    return mockPicker;
+}
+
+- (void)waitForUpdateOfDataSource:(FBGraphObjectTableDataSource *)dataSource
+{
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    [dataSource updateWithCompletion:^{
+        [blocker signal];
+    }];
+    STAssertTrue([blocker waitWithTimeout:2], @"update did not complete");
+}
+
+- (void)testSyncDropsRemovedFriendsAndLooksUpOnlyTheAdded
+{
+    id picker = [self mockPickerShowingCachedFriends];
+    NSMutableArray *lookups = [NSMutableArray array];
+    [self stubMatchingRequestsWithResponses:@{@"ids=": @{@"9": @{@"id": @"9", @"name": @"dave"}},
+                                              @"/friends": @{@"data": @[@{@"id": @"0"}, @{@"id": @"2"}, @{@"id": @"9"}]}}
+                                 statusCode:200
+                                   callback:^(NSURLRequest *request) {
+                                       if ([request.URL.absoluteString rangeOfString:@"ids="].location != NSNotFound) {
+                                           [lookups addObject:request.URL];
+                                       }
+                                   }];
+
+    [picker syncCachedFriends];
+
+    NSSet *expected = [NSSet setWithObjects:@"0", @"2", @"9", nil];
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:1] autorelease];
+    [blocker waitWithTimeout:2 periodicHandler:^(FBTestBlocker *innerBlocker) {
+        if ([[[picker dataSource] graphObjectIDs] isEqualToSet:expected]) {
+            [innerBlocker signal];
+        }
+    }];
+
+    STAssertEqualObjects([[picker dataSource] graphObjectIDs], expected, @"the list should match the IDs fetched");
+    STAssertTrue(lookups.count > 0, @"the added friend should have been looked up");
+    for (NSURL *url in lookups) {
+        NSString *query = [url.query stringByReplacingPercentEscapesUsingEncoding:NSUTF8StringEncoding];
+        STAssertTrue([query rangeOfString:@"ids=9&"].location != NSNotFound ||
+                     [query hasSuffix:@"ids=9"], @"only the added friend should be looked up: %@", query);
+    }
+    [picker stopMocking];
+}
+
+- (void)testSyncWithNothingChangedMakesNoLookup
+{
+    id picker = [self mockPickerShowingCachedFriends];
+    __block BOOL lookedUp = NO;
+    [self stubMatchingRequestsWithResponses:@{@"/friends": @{@"data": @[@{@"id": @"0"}, @{@"id": @"1"}, @{@"id": @"2"}]}}
+                                 statusCode:200
+                                   callback:^(NSURLRequest *request) {
+                                       if ([request.URL.absoluteString rangeOfString:@"ids="].location != NSNotFound) {
+                                           lookedUp = YES;
+                                       }
+                                   }];
+    [[picker reject] loadDataSkippingRoundTripIfCached:OCMOCK_ANY];
+
+    [picker syncCachedFriends];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:1] autorelease];
+    STAssertTrue([blocker waitWithTimeout:2 periodicHandler:^(FBTestBlocker *innerBlocker) {
+        if (![picker syncConnection]) {
+            [innerBlocker signal];
+        }
+    }], @"sync did not finish");
+
+    STAssertFalse(lookedUp, @"nothing was added, so nothing should be looked up");
+    NSSet *expected = [NSSet setWithObjects:@"0", @"1", @"2", nil];
+    STAssertEqualObjects([[picker dataSource] graphObjectIDs], expected, @"the list should be unchanged");
+    [picker verify];
+    [picker stopMocking];
+}
+
+- (void)testSyncFallsBackToAFullLoadWhenTheIDsSpanPages
+{
+    id picker = [self mockPickerShowingCachedFriends];
+    [self stubMatchingRequestsWithResponses:@{@"/friends": @{@"data": @[@{@"id": @"0"}],
+                                                             @"paging": @{@"next": @"https://graph.facebook.com/me/friends?after=0"}}}
+                                 statusCode:200
+                                   callback:nil];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    [[[picker expect] andDo:^(NSInvocation *invocation) {
+        [blocker signal];
+    }] loadDataSkippingRoundTripIfCached:[NSNumber numberWithBool:NO]];
+
+    [picker syncCachedFriends];
+
+    STAssertTrue([blocker waitWithTimeout:2], @"a full load should have been started");
+    [picker verify];
+    [picker stopMocking];
+}
+
+- (void)testSyncFallsBackToAFullLoadWhenTheLookupFails
+{
+    id picker = [self mockPickerShowingCachedFriends];
+    // the ID page succeeds; only the lookup of the added friend comes back with an error
+    [self stubMatchingRequestsWithResponses:@{@"ids=": @{@"error": @{@"message": @"boom", @"code": @1}},
+                                              @"/friends": @{@"data": @[@{@"id": @"0"}, @{@"id": @"9"}]}}
+                                 statusCode:200
+                                   callback:nil];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    [[[picker expect] andDo:^(NSInvocation *invocation) {
+        [blocker signal];
+    }] loadDataSkippingRoundTripIfCached:[NSNumber numberWithBool:NO]];
+
+    [picker syncCachedFriends];
+
+    STAssertTrue([blocker waitWithTimeout:2], @"a full load should have been started");
+    [picker verify];
+    [picker stopMocking];
+}
+
+@end
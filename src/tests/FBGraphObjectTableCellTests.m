@@ -0,0 +1,154 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <QuartzCore/QuartzCore.h>
+#import <SenTestingKit/SenTestingKit.h>
+
+#import "FBGraphObjectTableCell.h"
+#import "FBTestBlocker.h"
+
+// Counts the times it is drawn, and once told to, holds up the drawing until released
+@interface FBTableCellTestPicture : UIImage
+@property (nonatomic) int drawCount;
+@property (nonatomic, retain) FBTestBlocker *drawStarted;
+@property (nonatomic, retain) FBTestBlocker *drawReleased;
+@end
+
+@implementation FBTableCellTestPicture
+
+- (void)dealloc
+{
+    [_drawStarted release];
+    [_drawReleased release];
+    [super dealloc];
+}
+
+- (void)drawInRect:(CGRect)rect
+{
+    @synchronized(self) {
+        self.drawCount++;
+    }
+    [self.drawStarted signal];
+    [self.drawReleased waitWithTimeout:2];
+}
+
+@end
+
+@interface FBGraphObjectTableCell (Testing)
+
+@property (nonatomic, retain) CALayer *renderedContentLayer;
+
+@end
+
+@interface FBGraphObjectTableCellTests : SenTestCase
+@end
+
+@implementation FBGraphObjectTableCellTests
+
+- (FBGraphObjectTableCell *)prerenderedCellWithPicture:(UIImage *)picture pictureID:(NSString *)pictureID
+{
+    FBGraphObjectTableCell *cell = [[[FBGraphObjectTableCell alloc] initWithStyle:UITableViewCellStyleSubtitle
+                                                                  reuseIdentifier:@"Cell"] autorelease];
+    cell.frame = CGRectMake(0, 0, 320, [FBGraphObjectTableCell rowHeight]);
+    cell.prerenderedItemID = [[NSProcessInfo processInfo] globallyUniqueString];
+    cell.title = @"Title";
+    cell.subtitle = @"Subtitle";
+    cell.picture = picture;
+    cell.prerenderedPictureID = pictureID;
+    return cell;
+}
+
+- (BOOL)waitForRenderedContentOfCell:(FBGraphObjectTableCell *)cell
+{
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    return [blocker waitWithTimeout:2 periodicHandler:^(FBTestBlocker *innerBlocker) {
+        [cell layoutIfNeeded];
+        if (cell.renderedContentLayer.contents) {
+            [innerBlocker signal];
+        }
+    }];
+}
+
+- (void)testPrerenderedCellHidesItsLabelsAndShowsTheBitmap
+{
+    FBGraphObjectTableCell *cell = [self prerenderedCellWithPicture:nil pictureID:nil];
+    [cell layoutIfNeeded];
+
+    STAssertTrue(cell.textLabel.hidden, @"the title should be drawn into the bitmap");
+    STAssertTrue(cell.detailTextLabel.hidden, @"the subtitle should be drawn into the bitmap");
+    STAssertTrue([self waitForRenderedContentOfCell:cell], @"the bitmap never arrived");
+    STAssertFalse(cell.renderedContentLayer.hidden, nil);
+
+    cell.prerenderedItemID = nil;
+    [cell layoutIfNeeded];
+    STAssertFalse(cell.textLabel.hidden, @"a cell that isn't prerendered should use its labels");
+    STAssertTrue(cell.renderedContentLayer.hidden, nil);
+}
+
+- (void)testPictureWithoutAnIDIsNotPrerendered
+{
+    FBTableCellTestPicture *picture = [[[FBTableCellTestPicture alloc] init] autorelease];
+    FBGraphObjectTableCell *cell = [self prerenderedCellWithPicture:picture pictureID:nil];
+    [cell layoutIfNeeded];
+
+    STAssertFalse(cell.textLabel.hidden, nil);
+    STAssertNil(cell.renderedContentLayer.contents, nil);
+}
+
+- (void)testRowsWithTheSamePictureIDShareABitmap
+{
+    FBTableCellTestPicture *picture = [[[FBTableCellTestPicture alloc] init] autorelease];
+    FBGraphObjectTableCell *cell = [self prerenderedCellWithPicture:picture pictureID:@"http://a/picture.jpg"];
+    STAssertTrue([self waitForRenderedContentOfCell:cell], @"the bitmap never arrived");
+
+    // Another decode of the same picture is another image, but the same picture
+    FBTableCellTestPicture *samePicture = [[[FBTableCellTestPicture alloc] init] autorelease];
+    FBGraphObjectTableCell *otherCell = [self prerenderedCellWithPicture:samePicture pictureID:@"http://a/picture.jpg"];
+    otherCell.prerenderedItemID = cell.prerenderedItemID;
+    [otherCell layoutIfNeeded];
+
+    STAssertNotNil(otherCell.renderedContentLayer.contents, @"the bitmap should have come from the cache");
+    STAssertEquals(picture.drawCount, 1, nil);
+    STAssertEquals(samePicture.drawCount, 0, nil);
+}
+
+- (void)testReusedCellWithdrawsItsQueuedRender
+{
+    // Holds up the render queue so the next renders wait behind it
+    FBTableCellTestPicture *blockingPicture = [[[FBTableCellTestPicture alloc] init] autorelease];
+    blockingPicture.drawStarted = [[[FBTestBlocker alloc] init] autorelease];
+    blockingPicture.drawReleased = [[[FBTestBlocker alloc] init] autorelease];
+    FBGraphObjectTableCell *blockingCell = [self prerenderedCellWithPicture:blockingPicture pictureID:@"blocking"];
+    [blockingCell layoutIfNeeded];
+    STAssertTrue([blockingPicture.drawStarted waitWithTimeout:2], @"the first render never started");
+
+    FBTableCellTestPicture *firstPicture = [[[FBTableCellTestPicture alloc] init] autorelease];
+    FBTableCellTestPicture *secondPicture = [[[FBTableCellTestPicture alloc] init] autorelease];
+    FBGraphObjectTableCell *cell = [self prerenderedCellWithPicture:firstPicture pictureID:@"first"];
+    [cell layoutIfNeeded];
+    // Reused for another row before its render got a turn
+    cell.prerenderedItemID = [[NSProcessInfo processInfo] globallyUniqueString];
+    cell.picture = secondPicture;
+    cell.prerenderedPictureID = @"second";
+    [cell layoutIfNeeded];
+
+    [blockingPicture.drawReleased signal];
+    STAssertTrue([self waitForRenderedContentOfCell:cell], @"the new row's bitmap never arrived");
+    STAssertEquals(firstPicture.drawCount, 0, @"the withdrawn row should not have been drawn");
+    STAssertEquals(secondPicture.drawCount, 1, nil);
+}
+
+@end
@@ -0,0 +1,345 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <OCMock/OCMock.h>
+
+#import "FBTests.h"
+
+#import "FBGraphObject.h"
+#import "FBGraphObjectTableDataSource.h"
+
+@interface FBGraphObjectTableDataSourceTests : FBTests
+@end
+
+@implementation FBGraphObjectTableDataSourceTests
+
+- (NSMutableArray *)graphObjectsWithNames:(NSArray *)names
+{
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:names.count];
+    for (NSUInteger i = 0; i < names.count; i++) {
+        NSMutableDictionary<FBGraphObject> *object = [FBGraphObject graphObject];
+        object[@"id"] = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+        object[@"name"] = names[i];
+        [objects addObject:object];
+    }
+    return objects;
+}
+
+- (void)waitForUpdateOfDataSource:(FBGraphObjectTableDataSource *)dataSource
+{
+    __block BOOL updated = NO;
+    [dataSource updateWithCompletion:^{
+        updated = YES;
+    }];
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:2];
+    while (!updated && [deadline timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    STAssertTrue(updated, @"update did not complete");
+}
+
+- (NSArray *)namesInFirstSectionOfDataSource:(FBGraphObjectTableDataSource *)dataSource count:(NSUInteger)count
+{
+    NSMutableArray *names = [NSMutableArray array];
+    for (NSUInteger row = 0; row < count; row++) {
+        FBGraphObject *item = [dataSource itemAtIndexPath:[NSIndexPath indexPathForRow:row inSection:0]];
+        [names addObject:[item objectForKey:@"name"] ?: [NSNull null]];
+    }
+    return names;
+}
+
+- (void)testBackgroundSortUsesValuesReadWhenTheUpdateStarted
+{
+    FBGraphObjectTableDataSource *dataSource = [[[FBGraphObjectTableDataSource alloc] init] autorelease];
+    NSMutableArray *objects = [self graphObjectsWithNames:@[@"carol", @"Alice", @"bob"]];
+    [dataSource appendGraphObjects:objects];
+    [dataSource setSortingBySingleField:@"name" ascending:YES];
+
+    __block BOOL updated = NO;
+    [dataSource updateWithCompletion:^{
+        updated = YES;
+    }];
+    // Changed on the main thread while the sort may be running; the sort must not see it
+    objects[1][@"name"] = @"zed";
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:2];
+    while (!updated && [deadline timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+
+    STAssertTrue(updated, @"update did not complete");
+    NSArray *expected = @[@"zed", @"bob", @"carol"];
+    STAssertEqualObjects([self namesInFirstSectionOfDataSource:dataSource count:3], expected, @"unexpected order");
+    STAssertEquals([dataSource indexPathForItem:objects[1]].row, (NSInteger)0, @"reverse lookup out of step with the rows");
+    STAssertEquals([dataSource indexPathForItem:objects[0]].row, (NSInteger)2, @"reverse lookup out of step with the rows");
+}
+
+
+- (void)testGroupsItemsIntoSortedSections
+{
+    FBGraphObjectTableDataSource *dataSource = [[[FBGraphObjectTableDataSource alloc] init] autorelease];
+    dataSource.groupByField = @"name";
+    [dataSource appendGraphObjects:[self graphObjectsWithNames:@[@"bob", @"alice", @"Bill"]]];
+    [dataSource setSortingBySingleField:@"name" ascending:YES];
+    [self waitForUpdateOfDataSource:dataSource];
+
+    STAssertEqualObjects([[dataSource itemAtIndexPath:[NSIndexPath indexPathForRow:0 inSection:0]] objectForKey:@"name"],
+                         @"alice", @"unexpected first section");
+    STAssertEqualObjects([[dataSource itemAtIndexPath:[NSIndexPath indexPathForRow:0 inSection:1]] objectForKey:@"name"],
+                         @"Bill", @"unexpected order within section");
+    STAssertEqualObjects([[dataSource itemAtIndexPath:[NSIndexPath indexPathForRow:1 inSection:1]] objectForKey:@"name"],
+                         @"bob", @"unexpected order within section");
+}
+
+
+- (void)testColumnSortHonoursEachDescriptor
+{
+    FBGraphObjectTableDataSource *dataSource = [[[FBGraphObjectTableDataSource alloc] init] autorelease];
+    NSMutableArray *objects = [self graphObjectsWithNames:@[@"b", @"a", @"c", @"a", @"d"]];
+    NSArray *ranks = @[@1, @1, @2, @1, [NSNull null]];
+    for (NSUInteger i = 0; i < objects.count; i++) {
+        if (ranks[i] != [NSNull null]) {
+            objects[i][@"rank"] = ranks[i];
+        }
+    }
+    [dataSource appendGraphObjects:objects];
+    // A comparator descriptor first, then a selector one
+    dataSource.sortDescriptors = @[[NSSortDescriptor sortDescriptorWithKey:@"rank" ascending:NO comparator:^(id a, id b) {
+                                       return [a compare:b];
+                                   }],
+                                   [NSSortDescriptor sortDescriptorWithKey:@"name" ascending:YES selector:@selector(compare:)]];
+    [self waitForUpdateOfDataSource:dataSource];
+
+    // Missing values sort first, so last when descending, and equal rows keep their order
+    NSArray *expected = @[@"c", @"a", @"a", @"b", @"d"];
+    STAssertEqualObjects([self namesInFirstSectionOfDataSource:dataSource count:5], expected, @"unexpected order");
+    STAssertEquals([dataSource indexPathForItem:objects[1]].row, (NSInteger)1, @"equal rows should stay in order");
+    STAssertEquals([dataSource indexPathForItem:objects[3]].row, (NSInteger)2, @"equal rows should stay in order");
+}
+
+
+- (void)testLocalizedSortOrdersByFoldedNamesThenByTheCollator
+{
+    FBGraphObjectTableDataSource *dataSource = [[[FBGraphObjectTableDataSource alloc] init] autorelease];
+    [dataSource appendGraphObjects:[self graphObjectsWithNames:@[@"Eve", @"Zo\u00eb", @"\u00e9mile", @"emma", @"zoe", @"\u00c9MILE"]]];
+    [dataSource setSortingBySingleField:@"name" ascending:YES];
+    [self waitForUpdateOfDataSource:dataSource];
+
+    // Names that fold the same are ordered by the localized comparison, or left in order when it
+    // finds them equal
+    NSArray *expected = @[@"\u00e9mile", @"\u00c9MILE", @"emma", @"Eve", @"zoe", @"Zo\u00eb"];
+    STAssertEqualObjects([self namesInFirstSectionOfDataSource:dataSource count:6], expected, @"unexpected order");
+}
+
+- (void)testMergedPageUsesFoldedNamesLikeAFullSort
+{
+    FBGraphObjectTableDataSource *dataSource = [self groupedDataSourceWithNames:@[@"Eve", @"\u00e9mile", @"emma", @"Zo\u00eb"]];
+    [dataSource appendGraphObjects:[self appendedGraphObjectsWithNames:@[@"zoe", @"\u00c9milie"]]];
+    [self waitForUpdateOfDataSource:dataSource];
+
+    NSMutableArray *names = [NSMutableArray array];
+    for (NSInteger section = 0; section < 2; section++) {
+        NSInteger rows = [dataSource tableView:nil numberOfRowsInSection:section];
+        for (NSInteger row = 0; row < rows; row++) {
+            [names addObject:[[dataSource itemAtIndexPath:[NSIndexPath indexPathForRow:row inSection:section]] objectForKey:@"name"]];
+        }
+    }
+    NSArray *expected = @[@"\u00e9mile", @"\u00c9milie", @"emma", @"Eve", @"zoe", @"Zo\u00eb"];
+    STAssertEqualObjects(names, expected, @"merged rows out of order");
+}
+
+- (void)testSnapshotKeepsItemsAsTheyWereWhenWritten
+{
+    NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"fbtests://snapshot/%f",
+                                       [NSDate timeIntervalSinceReferenceDate]]];
+    FBGraphObjectTableDataSource *dataSource = [[[FBGraphObjectTableDataSource alloc] init] autorelease];
+    NSMutableArray *objects = [self graphObjectsWithNames:@[@"carol", @"Alice", @"bob"]];
+    [dataSource appendGraphObjects:objects];
+    [dataSource setSortingBySingleField:@"name" ascending:YES];
+    [self waitForUpdateOfDataSource:dataSource];
+
+    [dataSource writeSnapshotToCacheURL:url];
+    // Encoding happens in the background, after this change
+    objects[1][@"name"] = @"zed";
+
+    __block BOOL restored = NO;
+    FBGraphObjectTableDataSource *restoredDataSource = [[[FBGraphObjectTableDataSource alloc] init] autorelease];
+    [restoredDataSource setSortingBySingleField:@"name" ascending:YES];
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:2];
+    while (!restored && [deadline timeIntervalSinceNow] > 0) {
+        __block BOOL finished = NO;
+        [restoredDataSource restoreSnapshotFromCacheURL:url completion:^(BOOL didRestore) {
+            restored = didRestore;
+            finished = YES;
+        }];
+        while (!finished && [deadline timeIntervalSinceNow] > 0) {
+            [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+        }
+    }
+
+    STAssertTrue(restored, @"snapshot was not restored");
+    NSArray *expected = @[@"Alice", @"bob", @"carol"];
+    STAssertEqualObjects([self namesInFirstSectionOfDataSource:restoredDataSource count:3], expected,
+                         @"the snapshot should hold the names from when it was written");
+}
+
+
+// A sorted data source grouped by first letter, already showing names
+- (FBGraphObjectTableDataSource *)groupedDataSourceWithNames:(NSArray *)names
+{
+    FBGraphObjectTableDataSource *dataSource = [[[FBGraphObjectTableDataSource alloc] init] autorelease];
+    dataSource.groupByField = @"name";
+    [dataSource appendGraphObjects:[self graphObjectsWithNames:names]];
+    [dataSource setSortingBySingleField:@"name" ascending:YES];
+    [self waitForUpdateOfDataSource:dataSource];
+    return dataSource;
+}
+
+- (NSArray *)appendedGraphObjectsWithNames:(NSArray *)names
+{
+    NSMutableArray *objects = [self graphObjectsWithNames:names];
+    for (NSMutableDictionary *object in objects) {
+        object[@"id"] = [@"appended" stringByAppendingString:object[@"id"]];
+    }
+    return objects;
+}
+
+- (void)testAppendedPageIsInsertedIntoTheTable
+{
+    FBGraphObjectTableDataSource *dataSource = [self groupedDataSourceWithNames:@[@"alice", @"amy", @"bill", @"bob", @"carl", @"cat"]];
+    [dataSource appendGraphObjects:[self appendedGraphObjectsWithNames:@[@"dave", @"andy"]]];
+
+    id tableView = [OCMockObject mockForClass:[UITableView class]];
+    [[tableView expect] beginUpdates];
+    [[tableView expect] insertSections:[NSIndexSet indexSetWithIndex:3] withRowAnimation:UITableViewRowAnimationFade];
+    [[tableView expect] reloadSections:[NSIndexSet indexSet] withRowAnimation:UITableViewRowAnimationFade];
+    [[tableView expect] insertRowsAtIndexPaths:@[[NSIndexPath indexPathForRow:2 inSection:0]]
+                              withRowAnimation:UITableViewRowAnimationFade];
+    [[tableView expect] endUpdates];
+    [[tableView reject] reloadData];
+
+    [dataSource updateTableView:tableView];
+
+    [tableView verify];
+    STAssertEqualObjects([[dataSource itemAtIndexPath:[NSIndexPath indexPathForRow:2 inSection:0]] objectForKey:@"name"],
+                         @"andy", @"the inserted row should hold the appended item");
+}
+
+- (void)testAppendThatShowsSectionHeadersReloadsTheTable
+{
+    // one short of the count at which section headers appear
+    FBGraphObjectTableDataSource *dataSource = [self groupedDataSourceWithNames:@[@"alice", @"bill", @"bob", @"carl", @"cat"]];
+    [dataSource appendGraphObjects:[self appendedGraphObjectsWithNames:@[@"andy"]]];
+
+    id tableView = [OCMockObject mockForClass:[UITableView class]];
+    [[tableView expect] reloadData];
+
+    [dataSource updateTableView:tableView];
+
+    [tableView verify];
+}
+
+- (void)testUpdateWithNothingAppendedReloadsTheTable
+{
+    FBGraphObjectTableDataSource *dataSource = [self groupedDataSourceWithNames:@[@"alice", @"amy", @"bill", @"bob", @"carl", @"cat"]];
+
+    id tableView = [OCMockObject mockForClass:[UITableView class]];
+    [[tableView expect] reloadData];
+
+    [dataSource updateTableView:tableView];
+
+    [tableView verify];
+}
+
+
+- (void)testGraphObjectIDsListsTheShownItems
+{
+    FBGraphObjectTableDataSource *dataSource = [self groupedDataSourceWithNames:@[@"alice", @"bill", @"carl"]];
+
+    NSSet *expected = [NSSet setWithObjects:@"0", @"1", @"2", nil];
+    STAssertEqualObjects([dataSource graphObjectIDs], expected, @"unexpected IDs");
+}
+
+- (void)testIndexPathForItemLooksUpByID
+{
+    NSMutableArray *objects = [self graphObjectsWithNames:@[@"alice", @"amy", @"bill", @"anna"]];
+    // the later of two items sharing an ID is never the one found
+    objects[3][@"id"] = @"0";
+    NSMutableDictionary<FBGraphObject> *withoutID = objects[2];
+    [withoutID removeObjectForKey:@"id"];
+
+    FBGraphObjectTableDataSource *dataSource = [[[FBGraphObjectTableDataSource alloc] init] autorelease];
+    dataSource.groupByField = @"name";
+    [dataSource appendGraphObjects:objects];
+    [dataSource setSortingBySingleField:@"name" ascending:YES];
+    [self waitForUpdateOfDataSource:dataSource];
+
+    NSMutableDictionary<FBGraphObject> *sameID = [FBGraphObject graphObject];
+    sameID[@"id"] = @"1";
+    STAssertEqualObjects([dataSource indexPathForItem:sameID], [NSIndexPath indexPathForRow:1 inSection:0],
+                         @"another object with the same ID should be found");
+    STAssertEqualObjects([dataSource indexPathForItem:objects[3]], [NSIndexPath indexPathForRow:0 inSection:0],
+                         @"the first item with a duplicated ID should be found");
+    STAssertEqualObjects([dataSource indexPathForItem:withoutID], [NSIndexPath indexPathForRow:0 inSection:1],
+                         @"an item without an ID should still find itself");
+
+    NSMutableDictionary<FBGraphObject> *unknown = [FBGraphObject graphObject];
+    unknown[@"id"] = @"9";
+    STAssertNil([dataSource indexPathForItem:unknown], @"an unknown ID should not be found");
+
+    // appending moves rows after the insertion point
+    NSArray *appended = [self appendedGraphObjectsWithNames:@[@"aaron"]];
+    [dataSource appendGraphObjects:appended];
+    [self waitForUpdateOfDataSource:dataSource];
+    STAssertEqualObjects([dataSource indexPathForItem:appended[0]], [NSIndexPath indexPathForRow:0 inSection:0], nil);
+    STAssertEqualObjects([dataSource indexPathForItem:sameID], [NSIndexPath indexPathForRow:2 inSection:0],
+                         @"rows after an insertion should be reindexed");
+}
+
+- (void)testRemovedItemsLeaveTheRestInTheirSections
+{
+    FBGraphObjectTableDataSource *dataSource = [self groupedDataSourceWithNames:@[@"alice", @"amy", @"bill", @"bob", @"carl", @"cat"]];
+
+    // amy, bob and both c names
+    [dataSource removeGraphObjectsWithIDs:[NSSet setWithObjects:@"1", @"3", @"4", @"5", nil]];
+    [self waitForUpdateOfDataSource:dataSource];
+
+    NSSet *expected = [NSSet setWithObjects:@"0", @"2", nil];
+    STAssertEqualObjects([dataSource graphObjectIDs], expected, @"unexpected IDs after removal");
+    STAssertEquals([dataSource numberOfSectionsInTableView:nil], (NSInteger)2, @"emptied section should be gone");
+    STAssertEquals([dataSource tableView:nil numberOfRowsInSection:0], (NSInteger)1, @"unexpected rows in section");
+    STAssertEqualObjects([[dataSource itemAtIndexPath:[NSIndexPath indexPathForRow:0 inSection:0]] objectForKey:@"name"],
+                         @"alice", @"unexpected first section");
+    STAssertEqualObjects([[dataSource itemAtIndexPath:[NSIndexPath indexPathForRow:0 inSection:1]] objectForKey:@"name"],
+                         @"bill", @"unexpected second section");
+}
+
+- (void)testRemovingThenAppendingKeepsTheListSorted
+{
+    FBGraphObjectTableDataSource *dataSource = [self groupedDataSourceWithNames:@[@"alice", @"bill", @"carl"]];
+
+    [dataSource removeGraphObjectsWithIDs:[NSSet setWithObject:@"1"]];
+    [dataSource appendGraphObjects:[self appendedGraphObjectsWithNames:@[@"amy", @"ben"]]];
+    [self waitForUpdateOfDataSource:dataSource];
+
+    NSSet *expected = [NSSet setWithObjects:@"0", @"2", @"appended0", @"appended1", nil];
+    STAssertEqualObjects([dataSource graphObjectIDs], expected, @"unexpected IDs after the merge");
+    STAssertEqualObjects([[dataSource itemAtIndexPath:[NSIndexPath indexPathForRow:1 inSection:0]] objectForKey:@"name"],
+                         @"amy", @"appended item out of order");
+    STAssertEqualObjects([[dataSource itemAtIndexPath:[NSIndexPath indexPathForRow:0 inSection:1]] objectForKey:@"name"],
+                         @"ben", @"appended item should take the removed item's section");
+}
+
+@end
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "FBTests.h"
+
+#import "FBGraphObject.h"
+#import "FBGraphObjectTableDataSource.h"
+#import "FBGraphObjectTableSelection.h"
+
+@interface FBGraphObjectTableSelection (Testing)
+
+- (void)deselectItems:(NSArray *)items tableView:(UITableView *)tableView;
+- (void)selectionChanged;
+- (BOOL)selectionIncludesItem:(id<FBGraphObject>)item;
+
+@end
+
+// Counts the change notifications it is sent
+@interface FBGraphObjectTableSelectionTestDelegate : NSObject <FBGraphObjectSelectionChangedDelegate>
+
+@property (nonatomic) NSUInteger changeCount;
+
+@end
+
+@implementation FBGraphObjectTableSelectionTestDelegate
+
+- (void)graphObjectTableSelectionDidChange:(FBGraphObjectTableSelection *)selection {
+    self.changeCount++;
+}
+
+@end
+
+@interface FBGraphObjectTableSelectionTests : FBTests
+@end
+
+@implementation FBGraphObjectTableSelectionTests
+
+- (FBGraphObjectTableSelection *)newSelection
+{
+    FBGraphObjectTableDataSource *dataSource = [[[FBGraphObjectTableDataSource alloc] init] autorelease];
+    return [[FBGraphObjectTableSelection alloc] initWithDataSource:dataSource];
+}
+
+- (NSMutableDictionary<FBGraphObject> *)graphObjectWithID:(NSString *)objectID name:(NSString *)name
+{
+    NSMutableDictionary<FBGraphObject> *object = [FBGraphObject graphObject];
+    if (objectID) {
+        object[@"id"] = objectID;
+    }
+    object[@"name"] = name;
+    return object;
+}
+
+- (void)testItemsAreMatchedByID
+{
+    FBGraphObjectTableSelection *selection = [[self newSelection] autorelease];
+    id<FBGraphObject> amy = [self graphObjectWithID:@"1" name:@"amy"];
+    id<FBGraphObject> otherAmy = [self graphObjectWithID:@"1" name:@"amy (reloaded)"];
+
+    [selection selectItem:@[amy, otherAmy] tableView:nil];
+    STAssertEquals(selection.selection.count, (NSUInteger)1, @"same ID selected once");
+    STAssertTrue(selection.selection[0] == amy, @"first item with the ID kept");
+    STAssertTrue([selection selectionIncludesItem:otherAmy], nil);
+
+    [selection deselectItems:@[otherAmy] tableView:nil];
+    STAssertEquals(selection.selection.count, (NSUInteger)0, @"deselected through another object with the ID");
+    STAssertFalse([selection selectionIncludesItem:amy], nil);
+}
+
+- (void)testItemsWithoutIDOnlyMatchThemselves
+{
+    FBGraphObjectTableSelection *selection = [[self newSelection] autorelease];
+    id<FBGraphObject> first = [self graphObjectWithID:nil name:@"place"];
+    id<FBGraphObject> second = [self graphObjectWithID:nil name:@"place"];
+
+    [selection selectItem:@[first, second] tableView:nil];
+    STAssertEquals(selection.selection.count, (NSUInteger)2, @"equal items without an ID are both selected");
+    STAssertFalse([selection selectionIncludesItem:[self graphObjectWithID:nil name:@"place"]], nil);
+
+    [selection deselectItems:@[second] tableView:nil];
+    STAssertEquals(selection.selection.count, (NSUInteger)1, nil);
+    STAssertTrue(selection.selection[0] == first, @"only the identical item deselected");
+}
+
+- (void)testSelectionKeepsOrderAndIsCopiedOnlyAfterAChange
+{
+    FBGraphObjectTableSelection *selection = [[self newSelection] autorelease];
+    id<FBGraphObject> carol = [self graphObjectWithID:@"3" name:@"carol"];
+    id<FBGraphObject> amy = [self graphObjectWithID:@"1" name:@"amy"];
+    id<FBGraphObject> bob = [self graphObjectWithID:@"2" name:@"bob"];
+
+    [selection selectItem:@[carol, amy] tableView:nil];
+    NSArray *before = selection.selection;
+    STAssertTrue(selection.selection == before, @"unchanged selection not copied again");
+    STAssertEqualObjects([before valueForKey:@"name"], (@[@"carol", @"amy"]), nil);
+
+    [selection selectItem:@[bob] tableView:nil];
+    STAssertEqualObjects([selection.selection valueForKey:@"name"], (@[@"carol", @"amy", @"bob"]), nil);
+    STAssertEquals(before.count, (NSUInteger)2, @"earlier copy unaffected");
+}
+
+- (void)testClearingTheSelectionNotifiesOnceForPendingChanges
+{
+    FBGraphObjectTableSelection *selection = [[self newSelection] autorelease];
+    FBGraphObjectTableSelectionTestDelegate *delegate = [[[FBGraphObjectTableSelectionTestDelegate alloc] init] autorelease];
+    selection.delegate = delegate;
+    [selection selectItem:@[[self graphObjectWithID:@"1" name:@"amy"], [self graphObjectWithID:@"2" name:@"bob"]] tableView:nil];
+
+    [selection selectionChanged];
+    [selection clearSelectionInTableView:nil];
+    STAssertEquals(selection.selection.count, (NSUInteger)0, nil);
+    STAssertFalse([selection selectionIncludesItem:[self graphObjectWithID:@"1" name:@"amy"]], nil);
+
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.3]];
+    STAssertEquals(delegate.changeCount, (NSUInteger)1, @"changes folded into one notification");
+
+    // nothing to clear, so nothing to report
+    [selection clearSelectionInTableView:nil];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.3]];
+    STAssertEquals(delegate.changeCount, (NSUInteger)1, nil);
+    selection.delegate = nil;
+}
+
+@end
@@ -14,10 +14,13 @@
  * limitations under the License.
  */
 
+#import <objc/runtime.h>
+
 #import "FBRequest.h"
 #import "FBRequestConnection.h"
 #import "FBGraphObjectTests.h"
 #import "FBGraphObject.h"
+#import "FBGraphObjectSearchIndex.h"
 #import "FBGraphUser.h"
 #import "FBGraphPlace.h"
 #import "FBGraphLocation.h"
@@ -67,6 +70,10 @@
 @property (nonatomic, retain) NSString *name;
 @end
 
+@protocol ResolvedGraphObject<FBGraphObject>
+@property (nonatomic, retain) NSString *resolvedAccessorTitle;
+@end
+
 @protocol NamedGraphObjectWithExtras<NamedGraphObject>
 - (void)methodWithAnArg:(id)arg1 andAnotherArg:(id)arg2;
 @end
@@ -90,6 +97,17 @@
     assertThatBool(respondsToSelector, equalToBool(YES));
 }
 
+- (void)testResolvesAccessorsToMethods {
+    id<ResolvedGraphObject> graphObject = (id<ResolvedGraphObject>)[FBGraphObject graphObject];
+    [graphObject setResolvedAccessorTitle:@"A title"];
+    assertThat([graphObject resolvedAccessorTitle], equalTo(@"A title"));
+    assertThat([(NSDictionary *)graphObject objectForKey:@"resolvedAccessorTitle"], equalTo(@"A title"));
+
+    // Later calls go straight to the added methods rather than through forwarding
+    STAssertTrue(class_getInstanceMethod([FBGraphObject class], @selector(resolvedAccessorTitle)) != NULL, @"getter should be resolved");
+    STAssertTrue(class_getInstanceMethod([FBGraphObject class], @selector(setResolvedAccessorTitle:)) != NULL, @"setter should be resolved");
+}
+
 - (void)testDoesNotHandleNonGetterSetter {
     @try {
         id<NamedGraphObjectWithExtras> graphObject = (id<NamedGraphObjectWithExtras>)[FBGraphObject graphObject];
@@ -151,6 +169,50 @@
     STAssertNil([FBGraphObject graphObjectWrappingDictionary:nil], @"Wrong result for nil wrapper");
 }
 
+- (void)testWrappingCopiesOnFirstWrite
+{
+    NSDictionary *d = @{@"object" : @{@"name" : @"Joe"}};
+    NSMutableDictionary *obj = [FBGraphObject graphObjectWrappingDictionary:d];
+
+    [obj setObject:@"4" forKey:@"id"];
+    STAssertNil([d objectForKey:@"id"], @"Write reached the wrapped dictionary");
+    STAssertTrue([[obj objectForKey:@"id"] isEqual:@"4"], @"Write was lost");
+
+    // writes to nested objects stay visible through the parent
+    [[obj objectForKey:@"object"] setObject:@"Jane" forKey:@"name"];
+    STAssertTrue([[[obj objectForKey:@"object"] objectForKey:@"name"] isEqual:@"Jane"], @"Nested write was lost");
+    STAssertTrue([[[d objectForKey:@"object"] objectForKey:@"name"] isEqual:@"Joe"], @"Nested write reached the source");
+
+    // a mutable source changed after wrapping does not show through
+    NSMutableDictionary *source = [NSMutableDictionary dictionaryWithObject:@"Joe" forKey:@"name"];
+    NSMutableDictionary *obj2 = [FBGraphObject graphObjectWrappingDictionary:source];
+    [source setObject:@"Jane" forKey:@"name"];
+    STAssertTrue([[obj2 objectForKey:@"name"] isEqual:@"Joe"], @"Wrapper aliases the mutable source");
+}
+
+- (void)testReadOnlyWrappingLeavesSourceUntouched
+{
+    NSDictionary *nested = @{@"name" : @"Joe"};
+    NSArray *friends = @[nested];
+    NSDictionary *d = @{@"friends" : friends, @"id" : @"4"};
+
+    NSDictionary<FBGraphObject> *obj = [FBGraphObject readOnlyGraphObjectWrappingDictionary:d];
+    STAssertTrue([obj class] == [FBGraphObject class], @"Wrong class for resulting graph object");
+    STAssertTrue([obj.objectID isEqual:@"4"], @"Wrong id");
+
+    NSArray *arr = [obj objectForKey:@"friends"];
+    id first = [arr objectAtIndex:0];
+    STAssertTrue([first class] == [FBGraphObject class], @"Wrong class for array element");
+    STAssertTrue([[first objectForKey:@"name"] isEqual:@"Joe"], @"Wrong array contents");
+
+    // nothing was written back into the parsed response
+    STAssertTrue([d objectForKey:@"friends"] == friends, @"Source dictionary was modified");
+    STAssertTrue([friends objectAtIndex:0] == nested, @"Source array was modified");
+
+    STAssertThrows([(NSMutableDictionary *)obj setObject:@"5" forKey:@"id"], @"Read-only object accepted a write");
+    STAssertThrows([(NSMutableArray *)arr addObject:@"x"], @"Read-only array accepted a write");
+}
+
 - (void)testGraphObjectProtocolImplInference
 {
     // get an object
@@ -217,6 +279,21 @@
     STAssertTrue([FBGraphObject isGraphObjectID:objNoID sameAs:objNoID], @"no ID but same object");
 }
 
+- (void)testFieldsForProtocol
+{
+    NSSet *fields = [FBGraphObject fieldsForProtocol:@protocol(FBGraphPlace)];
+    NSSet *expected = [NSSet setWithObjects:@"id", @"name", @"category", @"location", nil];
+    STAssertEqualObjects(expected, fields, @"unexpected fields");
+
+    fields = [FBGraphObject fieldsForProtocol:@protocol(FBGraphUser)];
+    STAssertTrue([fields containsObject:@"first_name"], @"missing a property of the protocol");
+    STAssertFalse([fields containsObject:@"objectID"], @"objectID should be asked for as id");
+    STAssertFalse([fields containsObject:@"provisionedForPost"], @"FBGraphObject properties are not fields");
+
+    FBRequest *request = [FBRequest requestForGraphPath:@"me" projectedToProtocol:@protocol(FBGraphPlace)];
+    STAssertEqualObjects(@"category,id,location,name", request.parameters[@"fields"], @"fields should be sorted");
+}
+
 - (id)graphObjectWithUnwrappedData
 {
     NSDictionary *rawDictionary1 = [NSDictionary dictionaryWithObjectsAndKeys:@"world", @"hello", nil];
@@ -328,6 +405,21 @@
     assertThat([array objectAtIndex:1], equalTo(@"two"));
 }
 
+- (void)testSearchIndexMatchesFoldedWordPrefixes {
+    FBGraphObjectSearchIndex *index = [[[FBGraphObjectSearchIndex alloc] initWithField:@"name"] autorelease];
+    [index addItems:@[@{@"name": @"Zoë Smith"}, @{@"name": @"Bob Jones"}]];
+    [index addItems:@[@{@"id": @"3"}, @{@"name": @"zoe-anne jonas"}]];
+
+    assertThatInteger(index.indexedCount, equalToInteger(4));
+    NSMutableIndexSet *zoes = [NSMutableIndexSet indexSetWithIndex:0];
+    [zoes addIndex:3];
+    assertThat([index indexesOfItemsMatchingSearchText:@"ZOE"], equalTo(zoes));
+    assertThat([index indexesOfItemsMatchingSearchText:@"smi"], equalTo([NSIndexSet indexSetWithIndex:0]));
+    assertThat([index indexesOfItemsMatchingSearchText:@"jon zo"], equalTo([NSIndexSet indexSetWithIndex:3]));
+    assertThatInteger([index indexesOfItemsMatchingSearchText:@"mith"].count, equalToInteger(0));
+    STAssertNil([index indexesOfItemsMatchingSearchText:@" - "], @"no words means no search");
+}
+
 - (NSMutableDictionary<FBGraphObject> *)createGraphObjectWithArray {
     NSMutableDictionary *d = [NSMutableDictionary dictionary];
     [d setObject:[NSArray arrayWithObjects:@"one", [NSMutableDictionary dictionary], @"three", nil]
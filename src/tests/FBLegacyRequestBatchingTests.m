@@ -0,0 +1,164 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <OHHTTPStubs/OHHTTPStubs.h>
+
+#import "FBAccessTokenData.h"
+#import "FBRequest.h"
+#import "FBSessionTokenCachingStrategy.h"
+#import "FBSettings.h"
+#import "FBTestBlocker.h"
+#import "FBTestSession.h"
+#import "FBTests.h"
+#import "Facebook.h"
+
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+// Records each delegate callback as "<callback>:<graph path>"
+@interface FBLegacyRequestBatchingRecorder : NSObject <FBRequestDelegate>
+
+@property (nonatomic, readonly) NSMutableArray *events;
+@property (nonatomic, retain) FBTestBlocker *blocker;
+
+@end
+
+@implementation FBLegacyRequestBatchingRecorder
+
+- (instancetype)init
+{
+    if ((self = [super init])) {
+        _events = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_events release];
+    [_blocker release];
+    [super dealloc];
+}
+
+- (void)requestLoading:(FBRequest *)request
+{
+    [self.events addObject:[@"loading:" stringByAppendingString:request.graphPath]];
+}
+
+- (void)request:(FBRequest *)request didLoad:(id)result
+{
+    [self.events addObject:[@"load:" stringByAppendingString:request.graphPath]];
+    [self.blocker signal];
+}
+
+- (void)request:(FBRequest *)request didFailWithError:(NSError *)error
+{
+    [self.events addObject:[@"fail:" stringByAppendingString:request.graphPath]];
+    [self.blocker signal];
+}
+
+@end
+
+@interface FBLegacyRequestBatchingTests : FBTests
+@end
+
+@implementation FBLegacyRequestBatchingTests
+{
+    Facebook *_facebook;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    [FBSettings enableLegacyRequestBatching:YES];
+
+    FBTestSession *session = [[[FBTestSession alloc] initWithAppID:@"appid" permissions:nil defaultAudience:FBSessionDefaultAudienceOnlyMe urlSchemeSuffix:nil tokenCacheStrategy:[FBSessionTokenCachingStrategy nullCacheInstance]] autorelease];
+    FBAccessTokenData *tokenData = [FBAccessTokenData createTokenFromString:@"token" permissions:nil expirationDate:nil loginType:FBSessionLoginTypeFacebookViaSafari refreshDate:nil permissionsRefreshDate:[NSDate date]];
+    [session openFromAccessTokenData:tokenData completionHandler:nil];
+
+    _facebook = [[Facebook alloc] initWithAppId:@"appid" andDelegate:nil];
+    [_facebook setValue:session forKey:@"session"];
+
+    // A batch of n gets n copies of {"id":"4"}, anything sent on its own gets one
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        NSString *string = @"{\"id\":\"4\"}";
+        if ([request.HTTPMethod isEqualToString:@"POST"]) {
+            NSMutableArray *items = [NSMutableArray array];
+            for (int i = 0; i < 50; i++) {
+                [items addObject:@"{\"code\":200,\"body\":\"{\\\"id\\\":\\\"4\\\"}\"}"];
+            }
+            string = [NSString stringWithFormat:@"[%@]", [items componentsJoinedByString:@","]];
+        }
+        return [OHHTTPStubsResponse responseWithData:[string dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+}
+
+- (void)tearDown
+{
+    [OHHTTPStubs removeAllRequestHandlers];
+    [_facebook release];
+    _facebook = nil;
+    [FBSettings enableLegacyRequestBatching:NO];
+    [super tearDown];
+}
+
+- (void)testDelegatesHearLoadingOnTheNextPassThenResultsInOrder
+{
+    FBLegacyRequestBatchingRecorder *recorder = [[[FBLegacyRequestBatchingRecorder alloc] init] autorelease];
+    recorder.blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:3] autorelease];
+
+    NSMutableArray *requests = [NSMutableArray array];
+    for (NSString *path in @[@"a", @"b", @"c"]) {
+        [requests addObject:[_facebook requestWithGraphPath:path andDelegate:recorder]];
+    }
+
+    STAssertEquals((NSUInteger)0, recorder.events.count, @"nothing should be reported before the batch is sent");
+    for (FBRequest *request in requests) {
+        STAssertFalse([request loading], @"a request waiting for its batch is not loading yet");
+    }
+
+    STAssertTrue([recorder.blocker waitWithTimeout:1], @"timed out waiting for requests to return");
+    NSArray *expected = @[@"loading:a", @"loading:b", @"loading:c", @"load:a", @"load:b", @"load:c"];
+    STAssertEqualObjects(expected, recorder.events, @"unexpected delegate callbacks");
+    for (FBRequest *request in requests) {
+        STAssertEquals((FBRequestState)kFBRequestStateComplete, request.state, @"every request should have completed");
+    }
+}
+
+- (void)testMoreThanABatchOfRequestsAllHearBack
+{
+    FBLegacyRequestBatchingRecorder *recorder = [[[FBLegacyRequestBatchingRecorder alloc] init] autorelease];
+    recorder.blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:51] autorelease];
+
+    for (int i = 0; i < 51; i++) {
+        [_facebook requestWithGraphPath:[NSString stringWithFormat:@"%d", i] andDelegate:recorder];
+    }
+
+    STAssertTrue([recorder.blocker waitWithTimeout:1], @"timed out waiting for requests to return");
+    STAssertEquals((NSUInteger)102, recorder.events.count, @"each request should be reported loading and then loaded");
+    for (int i = 0; i < 51; i++) {
+        NSString *loading = [NSString stringWithFormat:@"loading:%d", i];
+        NSString *load = [NSString stringWithFormat:@"load:%d", i];
+        STAssertEqualObjects(loading, recorder.events[i], @"every request should be reported loading before any result");
+        STAssertEqualObjects(load, recorder.events[51 + i], @"results should come back in request order");
+    }
+}
+
+@end
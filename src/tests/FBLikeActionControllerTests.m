@@ -0,0 +1,187 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBTests.h"
+
+#import "FBLikeActionController.h"
+#import "FBRequest.h"
+#import "FBRequestConnection.h"
+
+typedef void(^fb_like_action_controller_add_requests_block)(FBRequestConnection *connection, NSString *batchName);
+
+// Declared in FBLikeActionController.m
+@interface FBLikeActionControllerRefreshCoordinator : NSObject
+- (void)addRefreshForSession:(FBSession *)session requestsBlock:(fb_like_action_controller_add_requests_block)block;
+@end
+
+@interface FBLikeActionController (Testing)
+
+@property (nonatomic, assign) NSUInteger likeCountWithLike;
+@property (nonatomic, assign) NSUInteger likeCountWithoutLike;
+@property (nonatomic, assign, readwrite) BOOL objectIsLiked;
+@property (nonatomic, copy) NSString *socialSentenceWithLike;
+@property (nonatomic, copy) NSString *socialSentenceWithoutLike;
+@property (nonatomic, copy) NSString *unlikeToken;
+
+- (instancetype)initWithObjectID:(NSString *)objectID session:(FBSession *)session;
+- (NSData *)_record;
+- (BOOL)_applyRecord:(NSData *)record;
+- (NSString *)_ensureVerifiedObjectIDWithConnection:(FBRequestConnection *)connection batchName:(NSString *)batchName;
+
+@end
+
+@interface FBLikeActionControllerTests : FBTests
+@end
+
+@implementation FBLikeActionControllerTests
+
+- (FBLikeActionController *)likedController
+{
+    FBLikeActionController *controller = [[[FBLikeActionController alloc] initWithObjectID:@"http://example.com/liked"
+                                                                                   session:nil] autorelease];
+    controller.objectIsLiked = YES;
+    controller.likeCountWithLike = 42;
+    controller.likeCountWithoutLike = 41;
+    controller.socialSentenceWithLike = @"You and 41 others like this.";
+    controller.socialSentenceWithoutLike = nil;
+    controller.unlikeToken = @"token";
+    return controller;
+}
+
+- (void)testRecordRoundTrips
+{
+    NSData *record = [[self likedController] _record];
+    FBLikeActionController *restored = [[[FBLikeActionController alloc] initWithObjectID:@"http://example.com/liked"
+                                                                                   session:nil] autorelease];
+
+    STAssertTrue([restored _applyRecord:record], nil);
+    STAssertTrue(restored.objectIsLiked, nil);
+    STAssertEquals(restored.likeCountWithLike, (NSUInteger)42, nil);
+    STAssertEquals(restored.likeCountWithoutLike, (NSUInteger)41, nil);
+    STAssertEqualObjects(restored.socialSentenceWithLike, @"You and 41 others like this.", nil);
+    STAssertNil(restored.socialSentenceWithoutLike, @"nil strings should come back as nil");
+    STAssertEqualObjects(restored.unlikeToken, @"token", nil);
+}
+
+- (void)testTruncatedRecordIsRejected
+{
+    NSData *record = [[self likedController] _record];
+    FBLikeActionController *restored = [[[FBLikeActionController alloc] initWithObjectID:@"http://example.com/liked"
+                                                                                   session:nil] autorelease];
+
+    for (NSUInteger length = 0; length < record.length; length++) {
+        STAssertFalse([restored _applyRecord:[record subdataWithRange:NSMakeRange(0, length)]],
+                      @"a record cut to %lu bytes should be rejected", (unsigned long)length);
+    }
+    STAssertNil(restored.unlikeToken, @"a rejected record should leave the state alone");
+}
+
+- (void)testHugeStringLengthIsRejected
+{
+    NSMutableData *record = [[[[self likedController] _record] mutableCopy] autorelease];
+    // The object ID's length follows the 24 byte header
+    uint32_t length = OSSwapHostToLittleInt32(UINT32_MAX - 1);
+    [record replaceBytesInRange:NSMakeRange(24, sizeof(length)) withBytes:&length];
+    FBLikeActionController *restored = [[[FBLikeActionController alloc] initWithObjectID:@"http://example.com/liked"
+                                                                                   session:nil] autorelease];
+
+    STAssertFalse([restored _applyRecord:record], nil);
+}
+
+
+#pragma mark - Refresh batching
+
+// Each refresh records the connection and batch name it is given, and adds one request so the
+// connection has something to send
+- (fb_like_action_controller_add_requests_block)refreshRecordingInto:(NSMutableArray *)log session:(FBSession *)session
+{
+    return [[^(FBRequestConnection *connection, NSString *batchName) {
+        [log addObject:@[connection, batchName]];
+        FBRequest *request = [[[FBRequest alloc] initWithSession:session graphPath:@"me"] autorelease];
+        [connection addRequest:request completionHandler:nil];
+    } copy] autorelease];
+}
+
+- (void)waitForRefreshCount:(NSUInteger)count inLog:(NSArray *)log
+{
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:2];
+    while (log.count < count && [deadline timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    STAssertEquals(log.count, count, @"not every refresh was sent");
+}
+
+- (void)testRefreshesAreGatheredIntoOneConnectionPerSession
+{
+    [self stubAllResponsesWithResult:@{}];
+    FBLikeActionControllerRefreshCoordinator *coordinator = [[[FBLikeActionControllerRefreshCoordinator alloc] init] autorelease];
+    FBSession *session = [self createAndOpenSessionWithMockToken];
+    FBSession *otherSession = [self createAndOpenSessionWithMockToken];
+    NSMutableArray *log = [NSMutableArray array];
+    NSMutableArray *otherLog = [NSMutableArray array];
+
+    [coordinator addRefreshForSession:session requestsBlock:[self refreshRecordingInto:log session:session]];
+    [coordinator addRefreshForSession:otherSession requestsBlock:[self refreshRecordingInto:otherLog session:otherSession]];
+    [coordinator addRefreshForSession:session requestsBlock:[self refreshRecordingInto:log session:session]];
+    STAssertEquals(log.count + otherLog.count, (NSUInteger)0, @"refreshes should wait for others to join them");
+
+    [self waitForRefreshCount:2 inLog:log];
+    [self waitForRefreshCount:1 inLog:otherLog];
+
+    STAssertEquals(log[0][0], log[1][0], @"refreshes for one session should share a connection");
+    STAssertFalse(log[0][0] == otherLog[0][0], @"each session should get its own connection");
+    STAssertEqualObjects(log[0][1], @"get-object-id-0", nil);
+    STAssertEqualObjects(log[1][1], @"get-object-id-1", @"batch names should be unique within a connection");
+    STAssertEqualObjects(otherLog[0][1], @"get-object-id-0", nil);
+}
+
+- (void)testAFullBatchIsSentWithoutWaiting
+{
+    [self stubAllResponsesWithResult:@{}];
+    FBLikeActionControllerRefreshCoordinator *coordinator = [[[FBLikeActionControllerRefreshCoordinator alloc] init] autorelease];
+    FBSession *session = [self createAndOpenSessionWithMockToken];
+    NSMutableArray *log = [NSMutableArray array];
+
+    // 50 requests to a batch, and up to 3 per refresh
+    for (NSUInteger i = 0; i < 16; i++) {
+        [coordinator addRefreshForSession:session requestsBlock:[self refreshRecordingInto:log session:session]];
+    }
+    STAssertEquals(log.count, (NSUInteger)16, @"a full batch should go out at once");
+    for (NSArray *entry in log) {
+        STAssertEquals(entry[0], log[0][0], @"a full batch should share one connection");
+    }
+
+    [coordinator addRefreshForSession:session requestsBlock:[self refreshRecordingInto:log session:session]];
+    STAssertEquals(log.count, (NSUInteger)16, @"the next refresh should wait for a new batch");
+    [self waitForRefreshCount:17 inLog:log];
+    STAssertFalse(log[16][0] == log[0][0], @"the next refresh should start a new connection");
+    STAssertEqualObjects(log[16][1], @"get-object-id-0", nil);
+}
+
+- (void)testUnverifiedObjectIDRefersToItsOwnLookup
+{
+    FBSession *session = [self createAndOpenSessionWithMockToken];
+    FBLikeActionController *controller = [[[FBLikeActionController alloc] initWithObjectID:@"http://example.com/liked"
+                                                                                   session:session] autorelease];
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+
+    NSString *objectID = [controller _ensureVerifiedObjectIDWithConnection:connection batchName:@"get-object-id-3"];
+
+    STAssertEqualObjects(objectID, @"{result=get-object-id-3:$.id}", @"the ID should come from this refresh's lookup");
+}
+
+@end
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import "FBLikeBoxBorderView.h"
+
+// The RGBA bytes of one point of an image drawn at a scale of 1
+static void FBLikeBoxBorderViewTestsPixel(UIImage *image, CGPoint point, uint8_t pixel[4])
+{
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(pixel, 1, 1, 8, 4, colorSpace,
+                                                 kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+    CGColorSpaceRelease(colorSpace);
+    memset(pixel, 0, 4);
+    CGContextDrawImage(context,
+                       CGRectMake(-point.x, point.y + 1 - image.size.height, image.size.width, image.size.height),
+                       image.CGImage);
+    CGContextRelease(context);
+}
+
+@interface FBLikeBoxBorderViewTests : SenTestCase
+@end
+
+@implementation FBLikeBoxBorderViewTests
+
+- (UIImage *)renderBorderOfSize:(CGSize)size
+{
+    FBLikeBoxBorderView *view = [[[FBLikeBoxBorderView alloc] initWithFrame:CGRectMake(0, 0, size.width, size.height)] autorelease];
+    view.contentScaleFactor = 1.0;
+    view.borderWidth = 2.0;
+    view.caretPosition = FBLikeBoxCaretPositionBottom;
+    view.fillColor = [UIColor redColor];
+    view.foregroundColor = [UIColor blueColor];
+
+    UIGraphicsBeginImageContextWithOptions(size, NO, 1.0);
+    [view drawRect:view.bounds];
+    UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+    return image;
+}
+
+- (void)assertPixelOf:(UIImage *)image at:(CGPoint)point isRed:(uint8_t)red green:(uint8_t)green blue:(uint8_t)blue alpha:(uint8_t)alpha
+{
+    uint8_t pixel[4];
+    FBLikeBoxBorderViewTestsPixel(image, point, pixel);
+    STAssertTrue(pixel[0] == red && pixel[1] == green && pixel[2] == blue && pixel[3] == alpha,
+                 @"unexpected pixel at %@: %u %u %u %u", NSStringFromCGPoint(point),
+                 pixel[0], pixel[1], pixel[2], pixel[3]);
+}
+
+- (void)testStretchedBorderKeepsItsEdgesAndCaret
+{
+    // large enough to be drawn from the stretched pieces, on either side of the caret
+    for (NSNumber *width in @[@100, @101, @240]) {
+        CGSize size = CGSizeMake(width.floatValue, 40);
+        UIImage *image = [self renderBorderOfSize:size];
+        CGFloat caretX = floorf(1 + (size.width - 2) / 2);
+
+        // the fill, including where the two pieces meet
+        [self assertPixelOf:image at:CGPointMake(size.width / 4, 15) isRed:255 green:0 blue:0 alpha:255];
+        [self assertPixelOf:image at:CGPointMake(caretX - 1, 15) isRed:255 green:0 blue:0 alpha:255];
+        [self assertPixelOf:image at:CGPointMake(caretX, 15) isRed:255 green:0 blue:0 alpha:255];
+        // the straight part of the left and top edges
+        [self assertPixelOf:image at:CGPointMake(0, 15) isRed:0 green:0 blue:255 alpha:255];
+        [self assertPixelOf:image at:CGPointMake(size.width / 4, 0) isRed:0 green:0 blue:255 alpha:255];
+        // below the box, only the caret is drawn
+        [self assertPixelOf:image at:CGPointMake(size.width / 4, 35) isRed:0 green:0 blue:0 alpha:0];
+        uint8_t pixel[4];
+        FBLikeBoxBorderViewTestsPixel(image, CGPointMake(caretX, 34), pixel);
+        STAssertTrue(pixel[3] > 0, @"the caret should be drawn at its center, %@ wide", width);
+    }
+}
+
+- (void)testBorderTooSmallForThePiecesIsStillDrawn
+{
+    UIImage *image = [self renderBorderOfSize:CGSizeMake(8, 12)];
+
+    uint8_t pixel[4];
+    FBLikeBoxBorderViewTestsPixel(image, CGPointMake(4, 3), pixel);
+    STAssertTrue(pixel[3] > 0, @"a small border should be drawn from its path");
+}
+
+@end
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import "FBLogger.h"
+#import "FBSettings.h"
+
+// Declared in FBLogger.m
+@interface FBLoggerRedactor : NSObject
+- (instancetype)initWithPatterns:(NSArray *)patterns replacements:(NSArray *)replacements;
+- (void)redactString:(NSMutableString *)string;
+@end
+
+@interface FBLoggerTests : SenTestCase
+@end
+
+@implementation FBLoggerTests
+{
+    NSSet *_originalBehaviors;
+    FBLoggingHandler _originalHandler;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    _originalBehaviors = [[FBSettings loggingBehavior] retain];
+    _originalHandler = [[FBLogger sinkHandler] retain];
+    [FBSettings setLoggingBehavior:[NSSet setWithObject:FBLoggingBehaviorInformational]];
+}
+
+- (void)tearDown
+{
+    [FBLogger setSinkHandler:_originalHandler];
+    [FBSettings setLoggingBehavior:_originalBehaviors];
+    [_originalHandler release];
+    [_originalBehaviors release];
+    [super tearDown];
+}
+
+- (NSString *)redact:(NSString *)string patterns:(NSArray *)patterns replacements:(NSArray *)replacements
+{
+    FBLoggerRedactor *redactor = [[[FBLoggerRedactor alloc] initWithPatterns:patterns replacements:replacements] autorelease];
+    NSMutableString *redacted = [[string mutableCopy] autorelease];
+    [redactor redactString:redacted];
+    return redacted;
+}
+
+// What a single log entry looks like once it has been through the logger
+- (NSString *)loggedString:(NSString *)string
+{
+    __block NSString *logged = nil;
+    [FBLogger setSinkHandler:^(NSString *logEntry) {
+        logged = [[logEntry copy] autorelease];
+    }];
+    [FBLogger singleShotLogEntry:FBLoggingBehaviorInformational logEntry:string];
+    [FBLogger flushSink];
+    return logged;
+}
+
+- (void)testEveryPatternIsReplacedInOnePass
+{
+    NSString *redacted = [self redact:@"token=aaa&other=bbb&again=aaa"
+                             patterns:@[@"aaa", @"bbb"]
+                         replacements:@[@"ACCESS_TOKEN_REMOVED", @"B"]];
+
+    STAssertEqualObjects(redacted, @"token=ACCESS_TOKEN_REMOVED&other=B&again=ACCESS_TOKEN_REMOVED", nil);
+}
+
+- (void)testLeftmostThenLongestMatchWins
+{
+    // overlapping matches: the one starting first is taken, and its overlap is left alone
+    STAssertEqualObjects([self redact:@"xabcdx" patterns:@[@"abc", @"bcd"] replacements:@[@"1", @"2"]],
+                         @"x1dx", nil);
+    // a pattern that is a prefix of another gives way to the longer one
+    STAssertEqualObjects([self redact:@"xabcdx" patterns:@[@"ab", @"abcd"] replacements:@[@"1", @"2"]],
+                         @"x2x", nil);
+    // a partial match of a long pattern still finds a short one inside it
+    STAssertEqualObjects([self redact:@"abce" patterns:@[@"abcd", @"bc"] replacements:@[@"1", @"2"]],
+                         @"a2e", nil);
+}
+
+- (void)testStringWithoutMatchesIsLeftAlone
+{
+    STAssertEqualObjects([self redact:@"nothing to see" patterns:@[@"token"] replacements:@[@"X"]],
+                         @"nothing to see", nil);
+    STAssertEqualObjects([self redact:@"" patterns:@[@"token"] replacements:@[@"X"]], @"", nil);
+}
+
+- (void)testOldestRegisteredStringIsEvicted
+{
+    NSString *prefix = [[NSProcessInfo processInfo] globallyUniqueString];
+    NSString *oldest = [prefix stringByAppendingString:@"-oldest"];
+    NSString *kept = [prefix stringByAppendingString:@"-kept"];
+    [FBLogger registerStringToReplace:oldest replaceWith:@"OLDEST"];
+    [FBLogger registerStringToReplace:kept replaceWith:@"KEPT"];
+
+    // one more than the set holds, re-registering the kept string partway through
+    for (NSUInteger i = 0; i < 100; i++) {
+        [FBLogger registerStringToReplace:[NSString stringWithFormat:@"%@-%lu", prefix, (unsigned long)i]
+                              replaceWith:@"FILLER"];
+        if (i == 50) {
+            [FBLogger registerStringToReplace:kept replaceWith:@"KEPT"];
+        }
+    }
+
+    NSString *logged = [self loggedString:[NSString stringWithFormat:@"%@ %@", oldest, kept]];
+    STAssertTrue([logged rangeOfString:oldest].location != NSNotFound, @"the oldest string should have been evicted");
+    STAssertTrue([logged rangeOfString:@"KEPT"].location != NSNotFound, @"a string registered again should be kept");
+    STAssertTrue([logged rangeOfString:kept].location == NSNotFound, @"a string registered again should be kept");
+}
+
+- (void)testRegisteringANewReplacementTakesEffect
+{
+    NSString *token = [[NSProcessInfo processInfo] globallyUniqueString];
+    [FBLogger registerStringToReplace:token replaceWith:@"FIRST"];
+    [FBLogger registerStringToReplace:token replaceWith:@"SECOND"];
+
+    NSString *logged = [self loggedString:token];
+    STAssertTrue([logged rangeOfString:@"SECOND"].location != NSNotFound, @"the newest replacement should be used: %@", logged);
+}
+
+@end
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBTests.h"
+
+#import "FBMaintenanceScheduler.h"
+#import "FBTestBlocker.h"
+#import "FBUtility.h"
+
+@interface FBMaintenanceSchedulerTests : FBTests
+@end
+
+@implementation FBMaintenanceSchedulerTests
+
+- (void)testTasksWithinLeewayShareAWakeup
+{
+    FBMaintenanceScheduler *scheduler = [[[FBMaintenanceScheduler alloc] init] autorelease];
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:2] autorelease];
+    __block NSTimeInterval firstRun = 0;
+    __block NSTimeInterval secondRun = 0;
+
+    id first = [scheduler addTaskWithInterval:0.2 leeway:0 queue:dispatch_get_main_queue() block:^{
+        if (!firstRun) {
+            firstRun = [FBUtility monotonicTime];
+            [blocker signal];
+        }
+    }];
+    // Due later, but close enough to go with the first
+    id second = [scheduler addTaskWithInterval:0.4 leeway:0.3 queue:dispatch_get_main_queue() block:^{
+        if (!secondRun) {
+            secondRun = [FBUtility monotonicTime];
+            [blocker signal];
+        }
+    }];
+
+    STAssertTrue([blocker waitWithTimeout:2], @"timed out waiting for tasks to run");
+    STAssertEqualsWithAccuracy(secondRun, firstRun, 0.1, @"tasks should have run in the same wakeup");
+
+    [scheduler removeTask:first];
+    [scheduler removeTask:second];
+}
+
+- (void)testSetIntervalPostponesNextRun
+{
+    FBMaintenanceScheduler *scheduler = [[[FBMaintenanceScheduler alloc] init] autorelease];
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block int runs = 0;
+
+    id task = [scheduler addTaskWithInterval:0.1 leeway:0 queue:dispatch_get_main_queue() block:^{
+        runs++;
+        [blocker signal];
+    }];
+    [scheduler setInterval:60 forTask:task];
+
+    STAssertFalse([blocker waitWithTimeout:0.5], @"task should not run before its new interval");
+    STAssertEquals(runs, 0, @"task should not have run");
+
+    [scheduler removeTask:task];
+}
+
+@end
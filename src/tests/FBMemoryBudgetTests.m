@@ -0,0 +1,79 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#import "FBTests.h"
+
+#import "FBMemoryBudget.h"
+
+@interface FBMemoryBudgetTestClient : NSObject <FBMemoryBudgetClient>
+@property (nonatomic, assign) NSUInteger memoryBudgetCost;
+@property (nonatomic, assign) NSUInteger shedCount;
+@end
+
+@implementation FBMemoryBudgetTestClient
+
+- (void)shedMemoryToCost:(NSUInteger)cost
+{
+    self.shedCount++;
+    self.memoryBudgetCost = MIN(self.memoryBudgetCost, cost);
+}
+
+@end
+
+@interface FBMemoryBudgetTests : FBTests
+@end
+
+@implementation FBMemoryBudgetTests
+
+- (void)testCheapestClientsAreShedFirst
+{
+    FBMemoryBudget *budget = [[[FBMemoryBudget alloc] init] autorelease];
+    FBMemoryBudgetTestClient *expensive = [[[FBMemoryBudgetTestClient alloc] init] autorelease];
+    FBMemoryBudgetTestClient *cheap = [[[FBMemoryBudgetTestClient alloc] init] autorelease];
+    expensive.memoryBudgetCost = 600;
+    cheap.memoryBudgetCost = 600;
+    // Registered out of order, to check they are sorted by priority
+    [budget registerClient:expensive priority:FBMemoryBudgetPriorityHigh];
+    [budget registerClient:cheap priority:FBMemoryBudgetPriorityLow];
+
+    STAssertEquals([budget shedToCeiling:1000], (NSUInteger)1000, @"should shed just down to the ceiling");
+    STAssertEquals(cheap.memoryBudgetCost, (NSUInteger)400, @"the cheap client should give up the excess");
+    STAssertEquals(expensive.shedCount, (NSUInteger)0, @"the expensive client should be left alone");
+
+    STAssertEquals([budget shedToCeiling:100], (NSUInteger)100, @"should shed just down to the ceiling");
+    STAssertEquals(cheap.memoryBudgetCost, (NSUInteger)0, @"the cheap client should be emptied first");
+    STAssertEquals(expensive.memoryBudgetCost, (NSUInteger)100, @"the expensive client should keep what fits");
+
+    [budget unregisterClient:cheap];
+    [budget unregisterClient:expensive];
+}
+
+- (void)testNothingIsShedUnderTheCeiling
+{
+    FBMemoryBudget *budget = [[[FBMemoryBudget alloc] init] autorelease];
+    FBMemoryBudgetTestClient *client = [[[FBMemoryBudgetTestClient alloc] init] autorelease];
+    client.memoryBudgetCost = 100;
+    [budget registerClient:client priority:FBMemoryBudgetPriorityDefault];
+
+    STAssertEquals([budget shedToCeiling:budget.ceiling], (NSUInteger)100, @"total should be unchanged");
+    STAssertEquals(client.shedCount, (NSUInteger)0, @"nothing should be shed");
+
+    [budget unregisterClient:client];
+}
+
+@end
@@ -0,0 +1,437 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import <mach/mach.h>
+
+#import "FBFriendPickerViewController.h"
+#import "FBGraphObjectTableDataSource.h"
+#import "FBPlacePickerViewController+Internal.h"
+#import "FBPlacePickerViewController.h"
+#import "FBRequest.h"
+#import "FBRequestConnection.h"
+#import "FBSession.h"
+#import "FBSettings.h"
+#import "FBSessionManualTokenCachingStrategy.h"
+#import "FBURLReplayTransport.h"
+#import "FBUtility.h"
+
+// Load, search and scroll timings for the friend and place pickers, against canned friend
+// and place lists played back through FBURLReplayTransport, so FBGraphObjectTableDataSource
+// and FBGraphObjectPagingLoader can be compared across changes without a network. Like
+// FBBenchmarkTests they only run when FB_RUN_BENCHMARKS is set; FB_PICKER_BENCHMARK_LATENCY
+// adds that many milliseconds before each replayed response.
+//
+// Scrolling moves the table a frame at a time, laying it out after each step, and counts a
+// frame as dropped for every 1/60s a step takes past the first.
+static NSString *const kFBBenchmarkRunKey = @"FB_RUN_BENCHMARKS";
+static NSString *const kFBPickerBenchmarkLatencyKey = @"FB_PICKER_BENCHMARK_LATENCY";
+static const NSUInteger kFBPickerBenchmarkFriendCount = 5000;
+static const NSUInteger kFBPickerBenchmarkFriendPageSize = 500;
+static const NSUInteger kFBPickerBenchmarkPlaceCount = 2000;
+static const NSTimeInterval kFBPickerBenchmarkFrameDuration = 1.0 / 60;
+static const NSTimeInterval kFBPickerBenchmarkTimeout = 60;
+static NSString *const kFBPickerBenchmarkPictureURL = @"https://fbpickerbenchmark.example.com/picture.png";
+
+static const char *const kFBPickerBenchmarkFirstNames[] = {
+    "Alice", "Andre", "Anna", "Bjorn", "Carmen", "Chen", "Daniel", "Elena", "Farah", "Giulia",
+    "Hiro", "Ines", "Jonas", "Kofi", "Lena", "Marco", "Nadia", "Olu", "Priya", "Rafael",
+};
+static const char *const kFBPickerBenchmarkLastNames[] = {
+    "Anderson", "Berg", "Costa", "Dubois", "Evans", "Fischer", "Garcia", "Haddad", "Ivanova", "Jensen",
+    "Kim", "Lopez", "Moreau", "Nakamura", "Okafor", "Petrov", "Rossi", "Silva", "Tanaka", "Weber",
+};
+
+static size_t FBPickerBenchmarkResidentBytes(void)
+{
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return (size_t)info.resident_size;
+}
+
+// Private to the pickers; the benchmark records exactly the requests they make
+@interface FBFriendPickerViewController (FBPickerBenchmarkTests)
+
+- (FBGraphObjectTableDataSource *)dataSource;
+- (FBRequest *)requestForLoadData;
+
+@end
+
+@interface FBPlacePickerViewController (FBPickerBenchmarkTests)
+
+- (FBGraphObjectTableDataSource *)dataSource;
+
+@end
+
+@interface FBPickerBenchmarkTests : SenTestCase
+
+@end
+
+@implementation FBPickerBenchmarkTests
+{
+    NSString *_replayDirectory;
+    FBURLReplayTransport *_transport;
+    FBSession *_session;
+    UIWindow *_window;
+    size_t _peakResidentBytes;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    _replayDirectory = [[NSTemporaryDirectory() stringByAppendingPathComponent:
+                         [NSString stringWithFormat:@"FBPickerBenchmarkTests-%u", arc4random()]] retain];
+    _transport = [[FBURLReplayTransport alloc] initWithDirectory:_replayDirectory
+                                                            mode:FBURLReplayTransportModeReplay];
+    _transport.latency = [[[[NSProcessInfo processInfo] environment] objectForKey:kFBPickerBenchmarkLatencyKey] doubleValue] / 1000;
+
+    // A fresh token each run, so nothing is answered from pages or snapshots cached by an earlier one
+    FBSessionManualTokenCachingStrategy *tokenCaching = [[[FBSessionManualTokenCachingStrategy alloc] init] autorelease];
+    tokenCaching.accessToken = [NSString stringWithFormat:@"FBPickerBenchmarkTests%u", arc4random()];
+    tokenCaching.expirationDate = [NSDate dateWithTimeIntervalSinceNow:3600];
+    _session = [[FBSession alloc] initWithAppID:@"1234567890"
+                                    permissions:nil
+                                urlSchemeSuffix:nil
+                             tokenCacheStrategy:tokenCaching];
+
+    _window = [[UIWindow alloc] initWithFrame:CGRectMake(0, 0, 320, 568)];
+}
+
+- (void)tearDown
+{
+    [FBURLReplayTransport setActiveTransport:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:_replayDirectory error:nil];
+    _window.rootViewController = nil;
+    [_window release];
+    _window = nil;
+    [_session release];
+    _session = nil;
+    [_transport release];
+    _transport = nil;
+    [_replayDirectory release];
+    _replayDirectory = nil;
+
+    [super tearDown];
+}
+
+- (BOOL)benchmarksEnabled
+{
+    return [[[NSProcessInfo processInfo] environment] objectForKey:kFBBenchmarkRunKey] != nil;
+}
+
+#pragma mark - Canned data
+
+- (void)recordResult:(NSDictionary *)result forURLRequest:(NSURLRequest *)urlRequest
+{
+    NSHTTPURLResponse *response = [[[NSHTTPURLResponse alloc] initWithURL:urlRequest.URL
+                                                               statusCode:200
+                                                              HTTPVersion:@"HTTP/1.1"
+                                                             headerFields:@{ @"Content-Type" : @"text/javascript" }]
+                                   autorelease];
+    [_transport recordResponse:response
+                          data:[NSJSONSerialization dataWithJSONObject:result options:0 error:nil]
+                    forRequest:urlRequest];
+}
+
+- (void)recordResult:(NSDictionary *)result forRequest:(FBRequest *)request
+{
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:request completionHandler:nil];
+    [self recordResult:result forURLRequest:connection.urlRequest];
+}
+
+// Every row shows the same picture, so after the first load it comes from the image cache
+- (void)recordPicture
+{
+    UIGraphicsBeginImageContext(CGSizeMake(100, 100));
+    [[UIColor grayColor] setFill];
+    UIRectFill(CGRectMake(0, 0, 100, 100));
+    NSData *data = UIImagePNGRepresentation(UIGraphicsGetImageFromCurrentImageContext());
+    UIGraphicsEndImageContext();
+
+    NSURL *url = [NSURL URLWithString:kFBPickerBenchmarkPictureURL];
+    NSHTTPURLResponse *response = [[[NSHTTPURLResponse alloc] initWithURL:url
+                                                               statusCode:200
+                                                              HTTPVersion:@"HTTP/1.1"
+                                                             headerFields:@{ @"Content-Type" : @"image/png" }]
+                                   autorelease];
+    [_transport recordResponse:response data:data forRequest:[NSURLRequest requestWithURL:url]];
+}
+
+- (NSDictionary *)picture
+{
+    return @{@"data" : @{@"url" : kFBPickerBenchmarkPictureURL, @"is_silhouette" : @NO}};
+}
+
+- (NSDictionary *)friendAtIndex:(NSUInteger)index
+{
+    NSUInteger firstCount = sizeof(kFBPickerBenchmarkFirstNames) / sizeof(kFBPickerBenchmarkFirstNames[0]);
+    NSUInteger lastCount = sizeof(kFBPickerBenchmarkLastNames) / sizeof(kFBPickerBenchmarkLastNames[0]);
+    NSString *firstName = [NSString stringWithUTF8String:kFBPickerBenchmarkFirstNames[index % firstCount]];
+    NSString *lastName = [NSString stringWithUTF8String:kFBPickerBenchmarkLastNames[(index / firstCount) % lastCount]];
+    return @{@"id" : [NSString stringWithFormat:@"%lu", (unsigned long)(100000 + index)],
+             @"name" : [NSString stringWithFormat:@"%@ %@ %lu", firstName, lastName, (unsigned long)index],
+             @"first_name" : firstName,
+             @"last_name" : lastName,
+             @"picture" : [self picture],
+             };
+}
+
+- (NSDictionary *)placeAtIndex:(NSUInteger)index
+{
+    return @{@"id" : [NSString stringWithFormat:@"%lu", (unsigned long)(200000 + index)],
+             @"name" : [NSString stringWithFormat:@"Place %lu", (unsigned long)index],
+             @"category" : (index % 3 ? @"Restaurant/cafe" : @"Local business"),
+             @"were_here_count" : [NSNumber numberWithUnsignedInteger:index * 7 % 5000],
+             @"location" : @{@"street" : [NSString stringWithFormat:@"%lu Main St", (unsigned long)(index + 1)],
+                             @"city" : @"Menlo Park",
+                             @"state" : @"CA",
+                             @"country" : @"United States",
+                             @"zip" : @"94025",
+                             @"latitude" : [NSNumber numberWithDouble:37.48 + index * 0.00001],
+                             @"longitude" : [NSNumber numberWithDouble:-122.15 - index * 0.00001],
+                             },
+             @"picture" : [self picture],
+             };
+}
+
+// The first page answers the picker's own request; later pages are reached through their next links
+- (NSUInteger)recordFriendsForRequest:(FBRequest *)request
+{
+    NSUInteger pageCount = (kFBPickerBenchmarkFriendCount + kFBPickerBenchmarkFriendPageSize - 1) / kFBPickerBenchmarkFriendPageSize;
+    for (NSUInteger page = 0; page < pageCount; page++) {
+        @autoreleasepool {
+            NSMutableArray *friends = [NSMutableArray arrayWithCapacity:kFBPickerBenchmarkFriendPageSize];
+            NSUInteger end = MIN(kFBPickerBenchmarkFriendCount, (page + 1) * kFBPickerBenchmarkFriendPageSize);
+            for (NSUInteger i = page * kFBPickerBenchmarkFriendPageSize; i < end; i++) {
+                [friends addObject:[self friendAtIndex:i]];
+            }
+            NSMutableDictionary *result = [NSMutableDictionary dictionaryWithObject:friends forKey:@"data"];
+            if (page + 1 < pageCount) {
+                [result setObject:@{@"next" : [self nextLinkForFriendPage:page + 1]} forKey:@"paging"];
+            }
+            if (page == 0) {
+                [self recordResult:result forRequest:request];
+            } else {
+                NSURL *url = [NSURL URLWithString:[self nextLinkForFriendPage:page]];
+                [self recordResult:result forURLRequest:[NSURLRequest requestWithURL:url]];
+            }
+        }
+    }
+    return pageCount;
+}
+
+- (NSString *)nextLinkForFriendPage:(NSUInteger)page
+{
+    return [NSString stringWithFormat:@"https://graph.facebook.com/me/friends?limit=%lu&after=page%lu",
+            (unsigned long)kFBPickerBenchmarkFriendPageSize, (unsigned long)page];
+}
+
+#pragma mark - Measuring
+
+- (void)samplePeakMemory
+{
+    _peakResidentBytes = MAX(_peakResidentBytes, FBPickerBenchmarkResidentBytes());
+}
+
+// Runs the main run loop until the condition holds, returning how long that took or -1 on timeout
+- (NSTimeInterval)runUntil:(BOOL (^)(void))condition
+{
+    NSTimeInterval start = [FBUtility monotonicTime];
+    while (!condition()) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.005]];
+        [self samplePeakMemory];
+        if ([FBUtility monotonicTime] - start > kFBPickerBenchmarkTimeout) {
+            return -1;
+        }
+    }
+    return [FBUtility monotonicTime] - start;
+}
+
+- (NSUInteger)rowCountOfTableView:(UITableView *)tableView
+{
+    NSUInteger rows = 0;
+    for (NSInteger section = 0; section < tableView.numberOfSections; section++) {
+        rows += [tableView numberOfRowsInSection:section];
+    }
+    return rows;
+}
+
+// A fling down from the top and back, decelerating the way UIScrollView does, returning the dropped frames
+- (NSUInteger)flingTableView:(UITableView *)tableView frames:(NSUInteger *)frameCount
+{
+    CGFloat maxOffset = MAX(0, tableView.contentSize.height - tableView.bounds.size.height);
+    NSUInteger frames = 0;
+    NSUInteger dropped = 0;
+    for (int direction = 1; direction >= -1; direction -= 2) {
+        CGFloat velocity = 8000 * direction;
+        while (fabs(velocity) > 20) {
+            CGFloat offset = tableView.contentOffset.y + velocity * kFBPickerBenchmarkFrameDuration;
+            offset = MAX(0, MIN(maxOffset, offset));
+
+            NSTimeInterval start = [FBUtility monotonicTime];
+            tableView.contentOffset = CGPointMake(0, offset);
+            [tableView layoutIfNeeded];
+            // Lets picture loads and other main queue work in, as a real frame would
+            [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate date]];
+            NSTimeInterval elapsed = [FBUtility monotonicTime] - start;
+
+            frames++;
+            if (elapsed > kFBPickerBenchmarkFrameDuration) {
+                dropped += (NSUInteger)(elapsed / kFBPickerBenchmarkFrameDuration);
+            }
+            [self samplePeakMemory];
+
+            velocity *= pow(UIScrollViewDecelerationRateNormal, kFBPickerBenchmarkFrameDuration * 1000);
+            if (offset <= 0 || offset >= maxOffset) {
+                break;
+            }
+        }
+    }
+    *frameCount = frames;
+    return dropped;
+}
+
+- (void)logFlingOfTableView:(UITableView *)tableView name:(NSString *)name
+{
+    NSUInteger frames = 0;
+    NSUInteger dropped = [self flingTableView:tableView frames:&frames];
+    NSLog(@"FBPickerBenchmark %@ fling: %lu frames, %lu dropped", name, (unsigned long)frames, (unsigned long)dropped);
+}
+
+#pragma mark - Benchmarks
+
+- (void)testFriendPicker
+{
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+
+    _peakResidentBytes = FBPickerBenchmarkResidentBytes();
+    size_t residentBytesBefore = _peakResidentBytes;
+
+    FBFriendPickerViewController *picker = [[[FBFriendPickerViewController alloc] init] autorelease];
+    picker.session = _session;
+    _window.rootViewController = picker;
+    [_window makeKeyAndVisible];
+
+    NSUInteger pageCount = [self recordFriendsForRequest:[picker requestForLoadData]];
+    [self recordPicture];
+    [FBURLReplayTransport setActiveTransport:_transport];
+
+    UITableView *tableView = picker.tableView;
+    [picker loadData];
+    NSTimeInterval firstRow = [self runUntil:^BOOL{
+        [tableView layoutIfNeeded];
+        return tableView.visibleCells.count > 0;
+    }];
+    NSTimeInterval fullLoad = [self runUntil:^BOOL{
+        return [self rowCountOfTableView:tableView] == kFBPickerBenchmarkFriendCount;
+    }];
+    STAssertTrue(firstRow >= 0 && fullLoad >= 0, @"timed out loading friends");
+    NSLog(@"FBPickerBenchmark friends: first row %.0f ms, all %lu friends in %lu pages %.0f ms",
+          firstRow * 1000, (unsigned long)kFBPickerBenchmarkFriendCount, (unsigned long)pageCount,
+          (firstRow + fullLoad) * 1000);
+
+    [self logFlingOfTableView:tableView name:@"friends"];
+
+    // Typing a name a letter at a time, then clearing it, as the picker's search bar would
+    for (NSString *searchText in @[@"a", @"an", @"ann", @"anna", @""]) {
+        __block BOOL updated = NO;
+        NSTimeInterval start = [FBUtility monotonicTime];
+        picker.searchText = searchText;
+        [picker.dataSource updateWithCompletion:^{
+            [tableView reloadData];
+            [tableView layoutIfNeeded];
+            updated = YES;
+        }];
+        BOOL finished = [self runUntil:^BOOL{ return updated; }] >= 0;
+        STAssertTrue(finished, @"timed out searching for '%@'", searchText);
+        NSLog(@"FBPickerBenchmark friends search '%@': %lu rows in %.1f ms", searchText,
+              (unsigned long)[self rowCountOfTableView:tableView], ([FBUtility monotonicTime] - start) * 1000);
+    }
+
+    [self logFlingOfTableView:tableView name:@"friends after search"];
+
+    [FBSettings enablePrerenderedPickerRows:YES];
+    [tableView reloadData];
+    [self logFlingOfTableView:tableView name:@"friends prerendered"];
+    [FBSettings enablePrerenderedPickerRows:NO];
+
+    NSLog(@"FBPickerBenchmark friends peak memory: %.1f MB (%.1f MB above the start)",
+          _peakResidentBytes / (1024.0 * 1024), ((double)_peakResidentBytes - residentBytesBefore) / (1024 * 1024));
+    NSLog(@"FBPickerBenchmark friends replay: %lu replayed, %lu missed",
+          (unsigned long)_transport.replayedCount, (unsigned long)_transport.missedCount);
+}
+
+- (void)testPlacePicker
+{
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+
+    _peakResidentBytes = FBPickerBenchmarkResidentBytes();
+    size_t residentBytesBefore = _peakResidentBytes;
+
+    FBPlacePickerViewController *picker = [[[FBPlacePickerViewController alloc] init] autorelease];
+    picker.session = _session;
+    picker.locationCoordinate = CLLocationCoordinate2DMake(37.48, -122.15);
+    picker.radiusInMeters = 1000;
+    picker.resultsLimit = kFBPickerBenchmarkPlaceCount;
+    _window.rootViewController = picker;
+    [_window makeKeyAndVisible];
+
+    NSMutableArray *places = [NSMutableArray arrayWithCapacity:kFBPickerBenchmarkPlaceCount];
+    for (NSUInteger i = 0; i < kFBPickerBenchmarkPlaceCount; i++) {
+        [places addObject:[self placeAtIndex:i]];
+    }
+    FBRequest *request = [FBPlacePickerViewController requestForPlacesSearchAtCoordinate:picker.locationCoordinate
+                                                                          radiusInMeters:picker.radiusInMeters
+                                                                            resultsLimit:picker.resultsLimit
+                                                                              searchText:picker.searchText
+                                                                                  fields:picker.fieldsForRequest
+                                                                              datasource:picker.dataSource
+                                                                                 session:_session];
+    [self recordResult:@{@"data" : places} forRequest:request];
+    [self recordPicture];
+    [FBURLReplayTransport setActiveTransport:_transport];
+
+    UITableView *tableView = picker.tableView;
+    [picker loadData];
+    NSTimeInterval firstRow = [self runUntil:^BOOL{
+        [tableView layoutIfNeeded];
+        return tableView.visibleCells.count > 0;
+    }];
+    NSTimeInterval fullLoad = [self runUntil:^BOOL{
+        return [self rowCountOfTableView:tableView] == kFBPickerBenchmarkPlaceCount;
+    }];
+    STAssertTrue(firstRow >= 0 && fullLoad >= 0, @"timed out loading places");
+    NSLog(@"FBPickerBenchmark places: first row %.0f ms, all %lu places %.0f ms",
+          firstRow * 1000, (unsigned long)kFBPickerBenchmarkPlaceCount, (firstRow + fullLoad) * 1000);
+
+    [self logFlingOfTableView:tableView name:@"places"];
+
+    NSLog(@"FBPickerBenchmark places peak memory: %.1f MB (%.1f MB above the start)",
+          _peakResidentBytes / (1024.0 * 1024), ((double)_peakResidentBytes - residentBytesBefore) / (1024 * 1024));
+}
+
+@end
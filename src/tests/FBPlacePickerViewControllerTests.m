@@ -0,0 +1,79 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBTests.h"
+
+#import "FBCancellationToken.h"
+#import "FBGraphObjectPagingLoader.h"
+#import "FBPlacePickerViewController+Internal.h"
+
+@interface FBPlacePickerViewController (Testing)
+
+@property (nonatomic, retain) FBGraphObjectTableDataSource *dataSource;
+@property (nonatomic, retain) FBGraphObjectPagingLoader *loader;
+
+- (void)cancelNetworkWork;
+
+@end
+
+@interface FBPlacePickerViewControllerTests : FBTests
+@end
+
+@implementation FBPlacePickerViewControllerTests
+
+- (void)testNearbyCoordinatesShareASearchTile
+{
+    CLLocationCoordinate2D coordinate = CLLocationCoordinate2DMake(37.4848, -122.1484);
+    CLLocationCoordinate2D jittered = CLLocationCoordinate2DMake(coordinate.latitude + 0.00002,
+                                                                 coordinate.longitude - 0.00002);
+    CLLocationCoordinate2D center = [FBPlacePickerViewController tileCenterForCoordinate:coordinate
+                                                                          radiusInMeters:1000];
+    CLLocationCoordinate2D jitteredCenter = [FBPlacePickerViewController tileCenterForCoordinate:jittered
+                                                                                  radiusInMeters:1000];
+
+    // Unless the jitter happens to cross a tile edge, which these coordinates don't
+    STAssertEquals(center.latitude, jitteredCenter.latitude, @"jitter should land in the same tile");
+    STAssertEquals(center.longitude, jitteredCenter.longitude, @"jitter should land in the same tile");
+
+    // Tiles are kept to a quarter of the radius, so the center moves by less than that
+    STAssertEqualsWithAccuracy(coordinate.latitude, center.latitude, 250.0 / 111320.0, @"tile too large");
+    STAssertEqualsWithAccuracy(coordinate.longitude, center.longitude, 250.0 / 111320.0, @"tile too large");
+}
+
+- (void)testInvalidCoordinateIsLeftAlone
+{
+    CLLocationCoordinate2D center = [FBPlacePickerViewController tileCenterForCoordinate:kCLLocationCoordinate2DInvalid
+                                                                          radiusInMeters:1000];
+    STAssertFalse(CLLocationCoordinate2DIsValid(center), @"an invalid coordinate should not be snapped");
+}
+
+- (void)testDismissingMovesLoaderAndDataSourceOffTheCancelledToken
+{
+    FBPlacePickerViewController *picker = [[[FBPlacePickerViewController alloc] init] autorelease];
+    FBCancellationToken *oldToken = [[picker.cancellationToken retain] autorelease];
+    picker.loader.cancellationToken = oldToken;
+    picker.dataSource.cancellationToken = oldToken;
+
+    [picker cancelNetworkWork];
+
+    STAssertTrue(oldToken.isCancellationRequested, nil);
+    STAssertFalse(picker.cancellationToken.isCancellationRequested, nil);
+    STAssertEquals(picker.loader.cancellationToken, picker.cancellationToken, @"the loader should be on the new token");
+    STAssertEquals(picker.dataSource.cancellationToken, picker.cancellationToken, @"the data source should be on the new token");
+}
+
+@end
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <OHHTTPStubs/OHHTTPStubs.h>
+
+#import "FBProfilePictureLoader.h"
+#import "FBSettings.h"
+#import "FBTests.h"
+#import "FBURLConnection.h"
+
+@interface FBProfilePictureLoader (Testing)
+
+@property (nonatomic, retain) NSMutableDictionary *connectionsByKey;
+
+@end
+
+@interface FBProfilePictureLoaderTests : FBTests
+@end
+
+@implementation FBProfilePictureLoaderTests
+{
+    FBProfilePictureLoader *_loader;
+    NSString *_key;
+    NSURL *_url;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    [FBSettings enableRequestScheduling:YES];
+    // keeps every load in flight for the length of a test
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        return [OHHTTPStubsResponse responseWithData:[NSData data]
+                                          statusCode:200
+                                        responseTime:60
+                                             headers:nil];
+    }];
+
+    _loader = [[FBProfilePictureLoader alloc] init];
+    _key = [[[NSProcessInfo processInfo] globallyUniqueString] copy];
+    _url = [[NSURL alloc] initWithString:[@"https://graph.facebook.com/picture/" stringByAppendingString:_key]];
+}
+
+- (void)tearDown
+{
+    for (FBURLConnection *connection in [_loader.connectionsByKey allValues]) {
+        [connection cancel];
+    }
+    [_loader release];
+    [_key release];
+    [_url release];
+    [OHHTTPStubs removeAllRequestHandlers];
+    [FBSettings enableRequestScheduling:NO];
+    [super tearDown];
+}
+
+- (FBURLConnection *)connection
+{
+    return [_loader.connectionsByKey objectForKey:_key];
+}
+
+- (void)testViewJoiningAPrefetchPromotesItAndLeavingDemotesIt
+{
+    [_loader prefetchPictureForKey:_key url:_url];
+    FBURLConnection *prefetch = [self connection];
+    STAssertNotNil(prefetch, @"the prefetch should have started a load");
+    STAssertEquals(FBRequestPriorityPrefetch, prefetch.priority, @"a prefetch should start at prefetch priority");
+
+    id token = [_loader loadPictureForKey:_key url:_url size:CGSizeMake(50, 50) handler:^(UIImage *image, NSError *error) {}];
+    STAssertEquals(prefetch, [self connection], @"the view should have joined the prefetch");
+    STAssertEquals(FBRequestPriorityVisibleImage, prefetch.priority, @"a prefetch wanted on screen should be promoted");
+
+    [_loader cancelLoad:token];
+    STAssertEquals(prefetch, [self connection], @"a prefetch should outlive the view that joined it");
+    STAssertEquals(FBRequestPriorityPrefetch, prefetch.priority, @"a prefetch nobody waits on should be demoted");
+}
+
+- (void)testCancellingAPrefetchStopsItsLoad
+{
+    [_loader prefetchPictureForKey:_key url:_url];
+    STAssertNotNil([self connection], @"the prefetch should have started a load");
+
+    [_loader cancelPrefetchForKey:_key];
+    STAssertNil([self connection], @"a cancelled prefetch should not be loading");
+}
+
+- (void)testCancellingAPrefetchAViewJoinedLeavesItToTheView
+{
+    [_loader prefetchPictureForKey:_key url:_url];
+    FBURLConnection *prefetch = [self connection];
+    id token = [_loader loadPictureForKey:_key url:_url size:CGSizeMake(50, 50) handler:^(UIImage *image, NSError *error) {}];
+
+    [_loader cancelPrefetchForKey:_key];
+    STAssertEquals(prefetch, [self connection], @"the view should still be waiting on the load");
+
+    [_loader cancelLoad:token];
+    STAssertNil([self connection], @"the load should go once the view stops waiting");
+}
+
+- (void)testPrefetchingNeedsRequestScheduling
+{
+    [FBSettings enableRequestScheduling:NO];
+    [_loader prefetchPictureForKey:_key url:_url];
+    STAssertNil([self connection], @"without the scheduler a prefetch would compete with visible pictures");
+}
+
+@end
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBTests.h"
+
+#import "FBCancellationToken.h"
+#import "FBRequest.h"
+#import "FBRequestConnection+Internal.h"
+#import "FBRequestConnectionRetryManager.h"
+
+@interface FBRequestConnectionRetryManager (Testing)
+
+- (void)repairSuccessAddingToConnections:(NSMutableDictionary *)connections;
+
+@end
+
+@interface FBRequestConnectionRetryManagerTests : FBTests
+@end
+
+@implementation FBRequestConnectionRetryManagerTests
+
+// A connection with one request, and a retry manager holding it as if the request failed
+// with an error that needs the session repaired
+- (FBRequestConnectionRetryManager *)retryManagerWithEntryName:(NSString *)name
+                                                    connection:(FBRequestConnection **)connectionOut
+{
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:[[[FBRequest alloc] initWithSession:nil graphPath:@"me"] autorelease]
+         completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {}
+            batchEntryName:name];
+    FBRequestConnectionRetryManager *manager = [[[FBRequestConnectionRetryManager alloc] initWithFBRequestConnection:connection] autorelease];
+    for (FBRequestMetadata *metadata in connection.requests) {
+        [manager addRequestMetadata:metadata];
+    }
+    *connectionOut = connection;
+    return manager;
+}
+
+- (void)testReplaysShareAConnectionWhenTheyCan
+{
+    FBRequestConnection *first = nil;
+    FBRequestConnection *second = nil;
+    FBRequestConnectionRetryManager *firstManager = [self retryManagerWithEntryName:@"first" connection:&first];
+    FBRequestConnectionRetryManager *secondManager = [self retryManagerWithEntryName:@"second" connection:&second];
+
+    NSMutableDictionary *connections = [NSMutableDictionary dictionary];
+    [firstManager repairSuccessAddingToConnections:connections];
+    [secondManager repairSuccessAddingToConnections:connections];
+
+    STAssertEquals((NSUInteger)1, connections.count, @"compatible replays should be batched together");
+    STAssertEquals((NSUInteger)2, [[connections.allValues[0] requests] count], nil);
+}
+
+- (void)testReplaysWithTheSameEntryNameGetTheirOwnConnections
+{
+    FBRequestConnection *first = nil;
+    FBRequestConnection *second = nil;
+    FBRequestConnectionRetryManager *firstManager = [self retryManagerWithEntryName:@"parent" connection:&first];
+    FBRequestConnectionRetryManager *secondManager = [self retryManagerWithEntryName:@"parent" connection:&second];
+
+    NSMutableDictionary *connections = [NSMutableDictionary dictionary];
+    [firstManager repairSuccessAddingToConnections:connections];
+    [secondManager repairSuccessAddingToConnections:connections];
+
+    STAssertEquals((NSUInteger)2, connections.count, @"a batch can't hold two entries with the same name");
+    for (FBRequestConnection *connection in connections.allValues) {
+        STAssertEquals((NSUInteger)1, connection.requests.count, nil);
+    }
+}
+
+- (void)testReplayKeepsTheOriginalConnectionSettings
+{
+    FBRequestConnection *first = nil;
+    FBRequestConnection *second = nil;
+    FBRequestConnectionRetryManager *firstManager = [self retryManagerWithEntryName:nil connection:&first];
+    FBRequestConnectionRetryManager *secondManager = [self retryManagerWithEntryName:nil connection:&second];
+    FBCancellationToken *token = [FBCancellationToken cancellationToken];
+    first.cancellationToken = token;
+    first.priority = FBRequestPriorityPrefetch;
+    first.networkFeature = @"feature";
+
+    NSMutableDictionary *connections = [NSMutableDictionary dictionary];
+    [firstManager repairSuccessAddingToConnections:connections];
+    [secondManager repairSuccessAddingToConnections:connections];
+
+    STAssertEquals((NSUInteger)2, connections.count, @"replays set up differently should not be merged");
+    FBRequestConnection *replay = nil;
+    for (FBRequestConnection *connection in connections.allValues) {
+        if (connection.cancellationToken == token) {
+            replay = connection;
+        }
+    }
+    STAssertNotNil(replay, @"the replay should be cancelled along with the original");
+    STAssertEquals(FBRequestPriorityPrefetch, replay.priority, nil);
+    STAssertEqualObjects(@"feature", replay.networkFeature, nil);
+}
+
+@end
@@ -21,9 +21,14 @@
 #import <OHHTTPStubs/OHHTTPStubs.h>
 
 #import "FBAccessTokenData.h"
+#import "FBCancellationToken.h"
+#import "FBDataDiskCache.h"
+#import "FBError.h"
+#import "FBMetrics.h"
 #import "FBRequest.h"
 #import "FBRequestConnection+Internal.h"
 #import "FBRequestConnection.h"
+#import "FBRequestTimings.h"
 #import "FBSession.h"
 #import "FBSessionTokenCachingStrategy.h"
 #import "FBSettings.h"
@@ -32,6 +37,7 @@
 #import "FBTestSession+Internal.h"
 #import "FBTestSession.h"
 #import "FBURLConnection.h"
+#import "FBURLReplayTransport.h"
 #import "FBUtility.h"
 
 @interface MockFBSystemAccountStoreAdapter : FBSystemAccountStoreAdapter {
@@ -94,6 +100,9 @@
 @interface FBRequestConnection (Testing)
 
 - (FBURLConnection *)newFBURLConnection;
+- (NSArray *)shardRanges;
+- (NSMutableURLRequest *)backgroundUploadRequest;
+- (id)parseJSONOrOtherwise:(NSData *)data error:(NSError **)error;
 
 @end
 
@@ -148,6 +157,586 @@
     [connection release];
 }
 
+- (void)testSplitsRequestsBeyondMaximumBatchSize
+{
+    FBTestSession *session = [[[FBTestSession alloc] initWithAppID:@"appid" permissions:nil defaultAudience:FBSessionDefaultAudienceOnlyMe urlSchemeSuffix:nil tokenCacheStrategy:[FBSessionTokenCachingStrategy nullCacheInstance]] autorelease];
+    FBAccessTokenData *tokenData = [FBAccessTokenData createTokenFromString:@"token" permissions:nil expirationDate:nil loginType:FBSessionLoginTypeFacebookViaSafari refreshDate:nil permissionsRefreshDate:[NSDate date]];
+    [session openFromAccessTokenData:tokenData completionHandler:nil];
+
+    const int requestTotal = 60;
+    __block int batchCount = 0;
+
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        // 60 requests go out as two batches of 30
+        NSMutableArray *items = [NSMutableArray array];
+        for (int i = 0; i < requestTotal / 2; i++) {
+            [items addObject:@"{\"code\":200,\"body\":\"{\\\"id\\\":\\\"4\\\"}\"}"];
+        }
+        NSData *data = [[NSString stringWithFormat:@"[%@]", [items componentsJoinedByString:@","]]
+                        dataUsingEncoding:NSUTF8StringEncoding];
+        batchCount++;
+
+        return [OHHTTPStubsResponse responseWithData:data
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:requestTotal] autorelease];
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    __block int successCount = 0;
+    for (int i = 0; i < requestTotal; i++) {
+        FBRequest *request = [[[FBRequest alloc] initWithSession:session graphPath:@"4"] autorelease];
+        [connection addRequest:request completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+            if (!error && [result[@"id"] isEqualToString:@"4"]) {
+                successCount++;
+            }
+            [blocker signal];
+        }];
+    }
+
+    [connection start];
+
+    STAssertTrue([blocker waitWithTimeout:1], @"timed out waiting for requests to return");
+    STAssertEquals(2, batchCount, @"expected the requests to be split into two batches");
+    STAssertEquals(requestTotal, successCount, @"every request should have succeeded");
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (void)testBackgroundUploadRequestCarriesTokenInHeaderOnly
+{
+    FBTestSession *session = [[[FBTestSession alloc] initWithAppID:@"appid" permissions:nil defaultAudience:FBSessionDefaultAudienceOnlyMe urlSchemeSuffix:nil tokenCacheStrategy:[FBSessionTokenCachingStrategy nullCacheInstance]] autorelease];
+    FBAccessTokenData *tokenData = [FBAccessTokenData createTokenFromString:@"secrettoken" permissions:nil expirationDate:nil loginType:FBSessionLoginTypeFacebookViaSafari refreshDate:nil permissionsRefreshDate:[NSDate date]];
+    [session openFromAccessTokenData:tokenData completionHandler:nil];
+
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    for (int i = 0; i < 2; i++) {
+        [connection addRequest:[[[FBRequest alloc] initWithSession:session
+                                                         graphPath:@"me/feed"
+                                                        parameters:@{@"message" : @"hello"}
+                                                        HTTPMethod:@"POST"] autorelease]
+             completionHandler:nil];
+    }
+
+    NSMutableURLRequest *request = [connection backgroundUploadRequest];
+    NSString *body = [[[NSString alloc] initWithData:request.HTTPBody encoding:NSUTF8StringEncoding] autorelease];
+
+    STAssertEqualObjects([request valueForHTTPHeaderField:@"Authorization"], @"OAuth secrettoken", nil);
+    STAssertTrue([body rangeOfString:@"secrettoken"].location == NSNotFound, @"the body is written to disk: %@", body);
+    STAssertTrue([request.URL.absoluteString rangeOfString:@"secrettoken"].location == NSNotFound, nil);
+}
+
+- (void)testShardedConnectionCanBeReleasedAfterCompleting
+{
+    FBTestSession *session = [[[FBTestSession alloc] initWithAppID:@"appid" permissions:nil defaultAudience:FBSessionDefaultAudienceOnlyMe urlSchemeSuffix:nil tokenCacheStrategy:[FBSessionTokenCachingStrategy nullCacheInstance]] autorelease];
+    FBAccessTokenData *tokenData = [FBAccessTokenData createTokenFromString:@"token" permissions:nil expirationDate:nil loginType:FBSessionLoginTypeFacebookViaSafari refreshDate:nil permissionsRefreshDate:[NSDate date]];
+    [session openFromAccessTokenData:tokenData completionHandler:nil];
+
+    const int requestTotal = 120;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        // 120 requests go out as three batches of 40
+        NSMutableArray *items = [NSMutableArray array];
+        for (int i = 0; i < requestTotal / 3; i++) {
+            [items addObject:@"{\"code\":200,\"body\":\"{\\\"id\\\":\\\"4\\\"}\"}"];
+        }
+        NSData *data = [[NSString stringWithFormat:@"[%@]", [items componentsJoinedByString:@","]]
+                        dataUsingEncoding:NSUTF8StringEncoding];
+        return [OHHTTPStubsResponse responseWithData:data
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:requestTotal] autorelease];
+    @autoreleasepool {
+        FBRequestConnection *connection = [[FBRequestConnection alloc] init];
+        for (int i = 0; i < requestTotal; i++) {
+            FBRequest *request = [[[FBRequest alloc] initWithSession:session graphPath:@"4"] autorelease];
+            [connection addRequest:request completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+                [blocker signal];
+            }];
+        }
+        [connection start];
+
+        STAssertTrue([blocker waitWithTimeout:1], @"timed out waiting for requests to return");
+        // Tears down the connection and with it each shard's FBURLConnection
+        [connection release];
+    }
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (FBRequestConnection *)connectionWithIndependentRequests:(NSUInteger)independentCount
+                                     thenDependentRunOf:(NSUInteger)runLength
+                                    thenIndependentOnes:(NSUInteger)trailingCount
+{
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    for (NSUInteger i = 0; i < independentCount; i++) {
+        [connection addRequest:[FBRequest requestForGraphPath:@"4"] completionHandler:nil];
+    }
+    for (NSUInteger i = 0; i < runLength; i++) {
+        if (i == 0) {
+            [connection addRequest:[FBRequest requestForGraphPath:@"4"] completionHandler:nil batchEntryName:@"parent"];
+        } else {
+            [connection addRequest:[FBRequest requestForGraphPath:@"{result=parent:$.id}"] completionHandler:nil];
+        }
+    }
+    for (NSUInteger i = 0; i < trailingCount; i++) {
+        [connection addRequest:[FBRequest requestForGraphPath:@"4"] completionHandler:nil];
+    }
+    return connection;
+}
+
+- (void)testShardRangesKeepDependentRequestsTogether
+{
+    FBRequestConnection *connection = [self connectionWithIndependentRequests:49 thenDependentRunOf:2 thenIndependentOnes:0];
+    NSArray *expected = @[[NSValue valueWithRange:NSMakeRange(0, 49)],
+                          [NSValue valueWithRange:NSMakeRange(49, 2)]];
+    STAssertEqualObjects([connection shardRanges], expected, @"the pair should not have been split");
+}
+
+- (void)testShardRangesNeverExceedMaximumBatchSize
+{
+    FBRequestConnection *connection = [self connectionWithIndependentRequests:0 thenDependentRunOf:60 thenIndependentOnes:0];
+    NSArray *expected = @[[NSValue valueWithRange:NSMakeRange(0, 50)],
+                          [NSValue valueWithRange:NSMakeRange(50, 10)]];
+    STAssertEqualObjects([connection shardRanges], expected, @"a run longer than a batch should have been cut");
+
+    connection = [self connectionWithIndependentRequests:30 thenDependentRunOf:30 thenIndependentOnes:30];
+    NSUInteger total = 0;
+    for (NSValue *range in [connection shardRanges]) {
+        STAssertTrue(range.rangeValue.length <= 50, @"shard too large");
+        STAssertEquals(total, range.rangeValue.location, @"shards should be contiguous");
+        total += range.rangeValue.length;
+    }
+    STAssertEquals((NSUInteger)90, total, @"every request should be in a shard");
+}
+
+- (void)testSingleRequestShardIsSentUnbatched
+{
+    FBTestSession *session = [[[FBTestSession alloc] initWithAppID:@"appid" permissions:nil defaultAudience:FBSessionDefaultAudienceOnlyMe urlSchemeSuffix:nil tokenCacheStrategy:[FBSessionTokenCachingStrategy nullCacheInstance]] autorelease];
+    FBAccessTokenData *tokenData = [FBAccessTokenData createTokenFromString:@"token" permissions:nil expirationDate:nil loginType:FBSessionLoginTypeFacebookViaSafari refreshDate:nil permissionsRefreshDate:[NSDate date]];
+    [session openFromAccessTokenData:tokenData completionHandler:nil];
+
+    __block int unbatchedCount = 0;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        NSString *string = @"{\"id\":\"4\"}";
+        if ([request.HTTPMethod isEqualToString:@"POST"]) {
+            // the run of 50
+            NSMutableArray *items = [NSMutableArray array];
+            for (int i = 0; i < 50; i++) {
+                [items addObject:@"{\"code\":200,\"body\":\"{\\\"id\\\":\\\"4\\\"}\"}"];
+            }
+            string = [NSString stringWithFormat:@"[%@]", [items componentsJoinedByString:@","]];
+        } else {
+            unbatchedCount++;
+        }
+        return [OHHTTPStubsResponse responseWithData:[string dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:51] autorelease];
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    __block int successCount = 0;
+    FBRequestHandler handler = ^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        if (!error && [result[@"id"] isEqualToString:@"4"]) {
+            successCount++;
+        }
+        [blocker signal];
+    };
+    [connection addRequest:[[[FBRequest alloc] initWithSession:session graphPath:@"4"] autorelease]
+         completionHandler:handler
+            batchEntryName:@"parent"];
+    for (int i = 1; i < 50; i++) {
+        [connection addRequest:[[[FBRequest alloc] initWithSession:session graphPath:@"{result=parent:$.id}"] autorelease]
+             completionHandler:handler];
+    }
+    [connection addRequest:[[[FBRequest alloc] initWithSession:session graphPath:@"4"] autorelease]
+         completionHandler:handler];
+
+    [connection start];
+
+    STAssertTrue([blocker waitWithTimeout:1], @"timed out waiting for requests to return");
+    STAssertEquals(1, unbatchedCount, @"the last request should have gone out on its own");
+    STAssertEquals(51, successCount, @"every request should have succeeded");
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (void)testCallsHandlersOnCompletionQueue
+{
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        return [OHHTTPStubsResponse responseWithData:[@"{\"id\":\"4\"}" dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+
+    dispatch_queue_t queue = dispatch_queue_create("com.facebook.sdk.tests.completion", DISPATCH_QUEUE_SERIAL);
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    connection.completionQueue = queue;
+    __block BOOL calledOnMainThread = YES;
+    __block id handlerResult = nil;
+    FBRequest *request = [[[FBRequest alloc] initWithSession:nil graphPath:@"4"] autorelease];
+    [connection addRequest:request completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        calledOnMainThread = [NSThread isMainThread];
+        handlerResult = [result retain];
+        [blocker signal];
+    }];
+
+    [connection start];
+
+    STAssertTrue([blocker waitWithTimeout:1], @"timed out waiting for request to return");
+    STAssertFalse(calledOnMainThread, @"handler should have been called on the completion queue");
+    STAssertEqualObjects(@"4", handlerResult[@"id"], @"unexpected result");
+    [handlerResult release];
+    dispatch_release(queue);
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (void)testWrapsNonJSONResponse
+{
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        return [OHHTTPStubsResponse responseWithData:[@"true" dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    FBRequest *request = [[[FBRequest alloc] initWithSession:nil graphPath:@"4/likes"] autorelease];
+    request.HTTPMethod = @"DELETE";
+    [connection addRequest:request completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        STAssertNil(error, @"unexpected error %@", error);
+        STAssertEqualObjects(@"true", result[FBNonJSONResponseProperty], @"expected the raw response");
+        [blocker signal];
+    }];
+
+    [connection start];
+
+    STAssertTrue([blocker waitWithTimeout:1], @"timed out waiting for request to return");
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (void)testBatchBodiesDecodedInRequestOrder
+{
+    NSUInteger count = 40;
+    NSMutableArray *items = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        // Every fifth body isn't JSON, so wrapped results are mixed in with parsed ones
+        NSString *body = (i % 5 == 4) ? @"true" : [NSString stringWithFormat:@"{\"id\":\"%lu\"}", (unsigned long)i];
+        [items addObject:@{@"code" : @200, @"body" : body}];
+    }
+    NSData *responseData = [NSJSONSerialization dataWithJSONObject:items options:0 error:nil];
+
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        return [OHHTTPStubsResponse responseWithData:responseData
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:(NSInteger)count] autorelease];
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    for (NSUInteger i = 0; i < count; i++) {
+        FBRequest *request = [[[FBRequest alloc] initWithSession:nil graphPath:@"me"] autorelease];
+        [connection addRequest:request completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+            STAssertNil(error, @"unexpected error %@", error);
+            if (i % 5 == 4) {
+                STAssertEqualObjects(@"true", result[FBNonJSONResponseProperty], @"expected the raw body for %lu", (unsigned long)i);
+            } else {
+                NSString *expected = [NSString stringWithFormat:@"%lu", (unsigned long)i];
+                STAssertEqualObjects(expected, result[@"id"], @"body delivered to the wrong handler");
+            }
+            [blocker signal];
+        }];
+    }
+
+    [connection start];
+
+    STAssertTrue([blocker waitWithTimeout:2], @"timed out waiting for batch to return");
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (int)sendCachedRequestsWithCacheControl:(NSString *)cacheControl
+{
+    __block int serverRequests = 0;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        serverRequests++;
+        return [OHHTTPStubsResponse responseWithData:[@"{\"id\":\"4\"}" dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:@{@"Cache-Control" : cacheControl}];
+    }];
+
+    // A parameter of its own keeps earlier runs' entries from answering
+    NSDictionary *parameters = @{@"fields" : [[NSProcessInfo processInfo] globallyUniqueString]};
+    for (int i = 0; i < 2; i++) {
+        FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+        FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+        FBRequest *request = [[[FBRequest alloc] initWithSession:nil
+                                                       graphPath:@"4"
+                                                      parameters:parameters
+                                                      HTTPMethod:nil] autorelease];
+        request.cachePolicy = FBRequestCachePolicyCacheFirst;
+        [connection addRequest:request completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+            STAssertNil(error, @"unexpected error %@", error);
+            STAssertEqualObjects(@"4", result[@"id"], @"unexpected result");
+            [blocker signal];
+        }];
+        [connection start];
+        STAssertTrue([blocker waitWithTimeout:1], @"timed out waiting for request to return");
+    }
+
+    [OHHTTPStubs removeAllRequestHandlers];
+    return serverRequests;
+}
+
+- (FBRequestConnection *)startConnectionAnsweredFromCacheWithString:(NSString *)cachedString
+                                                            handler:(FBRequestHandler)handler
+{
+    id mockCache = [OCMockObject niceMockForClass:[FBDataDiskCache class]];
+    [[[mockCache stub] andReturn:[cachedString dataUsingEncoding:NSUTF8StringEncoding]] dataForURL:OCMOCK_ANY];
+    id mockCacheClass = [OCMockObject mockForClass:[FBDataDiskCache class]];
+    [[[mockCacheClass stub] andReturn:mockCache] sharedCache];
+
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:[[[FBRequest alloc] initWithSession:nil graphPath:@"4"] autorelease]
+         completionHandler:handler];
+    [connection startWithCacheIdentity:@"FBRequestConnectionTests" skipRoundtripIfCached:YES];
+    return connection;
+}
+
+- (void)testCacheHitIsParsedOffTheMainThread
+{
+    NSMutableArray *parsedOnMainThread = [NSMutableArray array];
+    [FBSettings setTraceHandler:^(FBTracePoint point, BOOL begin, uintptr_t identifier) {
+        if (point == FBTracePointParseResponse && begin) {
+            @synchronized (parsedOnMainThread) {
+                [parsedOnMainThread addObject:@([NSThread isMainThread])];
+            }
+        }
+    }];
+    [FBSettings enableTracing:YES];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block BOOL handlerCalled = NO;
+    __block BOOL handledOnMainThread = NO;
+    __block id handledResult = nil;
+    FBRequestConnection *connection = [self startConnectionAnsweredFromCacheWithString:@"{\"id\":\"4\"}"
+                                                                              handler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        STAssertNil(error, @"unexpected error %@", error);
+        handlerCalled = YES;
+        handledOnMainThread = [NSThread isMainThread];
+        handledResult = [result retain];
+        [blocker signal];
+    }];
+    STAssertFalse(handlerCalled, @"cache hits complete asynchronously");
+    STAssertTrue([blocker waitWithTimeout:2], @"timed out waiting for the cached result");
+    [FBSettings enableTracing:NO];
+    [FBSettings setTraceHandler:nil];
+
+    STAssertTrue(connection.isResultFromCache, nil);
+    STAssertTrue(handledOnMainThread, @"handler called on the main thread");
+    STAssertEqualObjects(handledResult[@"id"], @"4", nil);
+    STAssertEqualObjects(parsedOnMainThread, @[@NO], @"cached data parsed once, in the background");
+    [handledResult release];
+}
+
+- (void)testCacheFirstRequestServedFromCacheWhileFresh
+{
+    STAssertEquals(1, [self sendCachedRequestsWithCacheControl:@"private, max-age=60"],
+                   @"the second request should have been answered from the cache");
+}
+
+- (void)testCacheFirstRequestHonorsNoStore
+{
+    STAssertEquals(2, [self sendCachedRequestsWithCacheControl:@"no-store"],
+                   @"a no-store response should not have been cached");
+}
+
+- (void)testCancellationTokenCancelsConnections
+{
+    __block int requestCount = 0;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        requestCount++;
+        return [OHHTTPStubsResponse responseWithData:[@"true" dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:1
+                                             headers:nil];
+    }];
+
+    FBCancellationToken *token = [FBCancellationToken cancellationToken];
+    __block int cancelledCount = 0;
+    FBRequestHandler handler = ^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        STAssertEquals((NSInteger)FBErrorOperationCancelled, error.code, @"expected a cancellation, got %@", error);
+        cancelledCount++;
+    };
+
+    FBRequestConnection *running = [[[FBRequestConnection alloc] init] autorelease];
+    [running addRequest:[[[FBRequest alloc] initWithSession:nil graphPath:@"4"] autorelease] completionHandler:handler];
+    [running startWithCancellationToken:token];
+    [token cancel];
+    [self waitForMainQueueToFinish];
+    STAssertEquals(1, cancelledCount, @"the running connection should have been cancelled");
+
+    FBRequestConnection *late = [[[FBRequestConnection alloc] init] autorelease];
+    [late addRequest:[[[FBRequest alloc] initWithSession:nil graphPath:@"5"] autorelease] completionHandler:handler];
+    [late startWithCancellationToken:token];
+    [self waitForMainQueueToFinish];
+    STAssertEquals(2, cancelledCount, @"a connection started with a cancelled token should not run");
+    STAssertTrue(requestCount <= 1, @"only the first connection may have reached the network");
+
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (void)testCancellingWhileImagesEncodeReportsCancellation
+{
+    __block int requestCount = 0;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        requestCount++;
+        return [OHHTTPStubsResponse responseWithData:[@"true" dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+
+    UIGraphicsBeginImageContextWithOptions(CGSizeMake(10, 10), YES, 1);
+    UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+    FBRequest *request = [[[FBRequest alloc] initWithSession:nil
+                                                   graphPath:@"me/photos"
+                                                  parameters:@{ @"picture" : image }
+                                                  HTTPMethod:@"POST"] autorelease];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block NSInteger errorCode = 0;
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:request completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        errorCode = error.code;
+        [blocker signal];
+    }];
+    // On the main thread, so the image is still being encoded when this cancels
+    [connection start];
+    [connection cancel];
+
+    STAssertTrue([blocker waitWithTimeout:5], @"the handler should still be called");
+    STAssertEquals(errorCode, (NSInteger)FBErrorOperationCancelled, nil);
+    STAssertEquals(requestCount, 0, @"a connection cancelled while encoding should not reach the network");
+
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (void)testTimingsAvailableInHandler
+{
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        return [OHHTTPStubsResponse responseWithData:[@"{\"id\":\"4\"}" dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    STAssertNil(connection.timings, @"no timings before start");
+    __block NSTimeInterval totalDuration = 0;
+    __block NSTimeInterval timeToFirstByte = 0;
+    FBRequest *request = [[[FBRequest alloc] initWithSession:nil graphPath:@"4"] autorelease];
+    [connection addRequest:request completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        totalDuration = innerConnection.timings.totalDuration;
+        timeToFirstByte = innerConnection.timings.timeToFirstByte;
+        [blocker signal];
+    }];
+
+    [connection start];
+
+    STAssertTrue([blocker waitWithTimeout:1], @"timed out waiting for request to return");
+    STAssertTrue(totalDuration > 0, @"expected a total duration");
+    STAssertTrue(timeToFirstByte <= totalDuration, @"first byte should come before the handler");
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (void)testReplayTransportDrivesRequestPipeline
+{
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[FBUtility newUUIDString] autorelease]];
+    FBURLReplayTransport *transport = [[[FBURLReplayTransport alloc] initWithDirectory:directory
+                                                                                  mode:FBURLReplayTransportModeReplay]
+                                       autorelease];
+    transport.latency = 0.01;
+    transport.bytesPerSecond = 1000;
+
+    FBRequest *request = [[[FBRequest alloc] initWithSession:nil graphPath:@"4"] autorelease];
+    FBRequestConnection *recordingConnection = [[[FBRequestConnection alloc] init] autorelease];
+    [recordingConnection addRequest:request completionHandler:nil];
+    NSURLRequest *urlRequest = recordingConnection.urlRequest;
+    NSHTTPURLResponse *response = [[[NSHTTPURLResponse alloc] initWithURL:urlRequest.URL
+                                                               statusCode:200
+                                                              HTTPVersion:@"HTTP/1.1"
+                                                             headerFields:@{ @"Content-Type" : @"text/javascript" }]
+                                   autorelease];
+    [transport recordResponse:response
+                         data:[@"{\"id\":\"4\",\"name\":\"Mark\"}" dataUsingEncoding:NSUTF8StringEncoding]
+                   forRequest:urlRequest];
+    [FBURLReplayTransport setActiveTransport:transport];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block id name = nil;
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:request completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+        name = [[result objectForKey:@"name"] retain];
+        [blocker signal];
+    }];
+    [connection start];
+
+    STAssertTrue([blocker waitWithTimeout:2], @"timed out waiting for the replayed response");
+    STAssertEqualObjects(name, @"Mark", @"replayed response parsed");
+    STAssertEquals(transport.replayedCount, (NSUInteger)1, @"request answered from the recording");
+    STAssertEquals(transport.missedCount, (NSUInteger)0, @"no unmatched requests");
+
+    [name release];
+    [FBURLReplayTransport setActiveTransport:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+- (void)testParseJSONOrOtherwiseLooksPastLeadingBytes
+{
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    NSError *error = nil;
+
+    NSData *data = [@"\xEF\xBB\xBF \r\n{\"id\":\"4\"}" dataUsingEncoding:NSISOLatin1StringEncoding];
+    id parsed = [connection parseJSONOrOtherwise:data error:&error];
+    STAssertNil(error, nil);
+    STAssertEqualObjects(parsed, @{ @"id" : @"4" }, @"a byte order mark and whitespace should not hide the object");
+
+    // Looks like an object but isn't one, so it comes back as it was
+    data = [@"{truncated" dataUsingEncoding:NSUTF8StringEncoding];
+    parsed = [connection parseJSONOrOtherwise:data error:&error];
+    STAssertNil(error, @"a response that fails to parse should not be an error");
+    STAssertEqualObjects(parsed[FBNonJSONResponseProperty], @"{truncated", nil);
+}
+
 - (void)testNoRequests
 {
     FBRequestConnection *connection = [[FBRequestConnection alloc] init];
@@ -558,6 +1147,136 @@
     STAssertNotNil(ret, @"failed to serialize to NSMutableURLRequest with two object posts.");
 }
 
+- (void)testResultReferenceNamesParentAndSetsDependsOn {
+    [FBSettings setDefaultAppID:kTestAppId];
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+
+    FBRequest *upload = [FBRequest requestWithGraphPath:@"me/staging_resources"
+                                             parameters:@{@"file" : @"placeholder"}
+                                             HTTPMethod:@"POST"];
+    [connection addRequest:upload completionHandler:nil];
+    NSString *reference = [connection resultReferenceForRequest:upload JSONPath:@"$.uri"];
+    STAssertEqualObjects(reference, @"{result=fbsdk_result_0:$.uri}", @"unexpected reference");
+
+    FBRequest *post = [FBRequest requestWithGraphPath:@"me/objects/fb_sample_scrumps:meal"
+                                           parameters:@{@"image" : reference}
+                                           HTTPMethod:@"POST"];
+    [connection addRequest:post completionHandler:nil];
+
+    NSDictionary *batchParameters = [connection getRequestMetadata:upload].batchParameters;
+    STAssertEqualObjects(batchParameters[@"name"], @"fbsdk_result_0", @"parent should have been named");
+    STAssertEqualObjects(batchParameters[@"omit_response_on_success"], @NO, @"parent should keep its response");
+
+    NSString *body = [[[NSString alloc] initWithData:[connection urlRequest].HTTPBody
+                                            encoding:NSUTF8StringEncoding] autorelease];
+    STAssertTrue([body rangeOfString:@"\"depends_on\":\"fbsdk_result_0\""].location != NSNotFound,
+                 @"child should depend on the parent");
+}
+
+- (void)testFileURLAttachmentIsSentVerbatim {
+    [FBSettings setDefaultAppID:kTestAppId];
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"FBRequestConnectionTests.jpg"];
+    const char jpeg[] = "\xFF\xD8\xFF\xE0 not re-encoded \xFF\xD9";
+    NSData *contents = [NSData dataWithBytes:jpeg length:sizeof(jpeg) - 1];
+    [contents writeToFile:path atomically:YES];
+
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    FBRequest *upload = [FBRequest requestWithGraphPath:@"me/photos"
+                                             parameters:@{@"source" : [NSURL fileURLWithPath:path]}
+                                             HTTPMethod:@"POST"];
+    [connection addRequest:upload completionHandler:nil];
+    NSData *body = [connection urlRequest].HTTPBody;
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+
+    STAssertTrue([body rangeOfData:contents options:0 range:NSMakeRange(0, body.length)].location != NSNotFound,
+                 @"file should be attached as it is on disk");
+    NSData *header = [@"filename=\"FBRequestConnectionTests.jpg\"\r\nContent-Type: image/jpeg"
+                      dataUsingEncoding:NSUTF8StringEncoding];
+    STAssertTrue([body rangeOfData:header options:0 range:NSMakeRange(0, body.length)].location != NSNotFound,
+                 @"attachment should be named after the file and typed by its extension");
+}
+
+- (void)testUnreadableFileAttachmentFailsTheRequest {
+    [FBSettings setDefaultAppID:kTestAppId];
+    __block NSUInteger sent = 0;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        sent++;
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        return [OHHTTPStubsResponse responseWithData:[@"{\"id\":\"1\"}" dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"FBRequestConnectionTests-missing.jpg"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block NSError *handlerError = nil;
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:[FBRequest requestWithGraphPath:@"me/photos"
+                                                parameters:@{@"source" : [NSURL fileURLWithPath:path]}
+                                                HTTPMethod:@"POST"]
+         completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+             handlerError = [error retain];
+             [blocker signal];
+         }];
+    [connection start];
+
+    STAssertTrue([blocker waitWithTimeout:1], @"timed out waiting for the handler");
+    STAssertEquals(handlerError.code, (NSInteger)FBErrorRequestConnectionApi, nil);
+    STAssertEquals(sent, (NSUInteger)0, @"a request missing its attachment should not be sent");
+    [handlerError release];
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (void)testCanonicalCacheKeyIgnoresParameterOrderAndVolatileParameters {
+    FBRequest *first = [FBRequest requestWithGraphPath:@"me/friends"
+                                            parameters:@{@"fields" : @"id,name", @"limit" : @"100"}
+                                            HTTPMethod:nil];
+    FBRequest *second = [FBRequest requestWithGraphPath:@"me/friends"
+                                             parameters:@{@"limit" : @"100",
+                                                          @"fields" : @"id,name",
+                                                          @"access_token" : @"refreshed",
+                                                          @"format" : @"json",
+                                                          @"sdk" : @"ios"}
+                                             HTTPMethod:nil];
+    FBRequest *other = [FBRequest requestWithGraphPath:@"me/friends"
+                                            parameters:@{@"fields" : @"id", @"limit" : @"100"}
+                                            HTTPMethod:nil];
+
+    NSString *key = [FBRequestConnection canonicalCacheKeyForRequests:@[first]];
+    STAssertEqualObjects([FBRequestConnection canonicalCacheKeyForRequests:@[second]], key,
+                         @"equal requests should share a key");
+    STAssertFalse([[FBRequestConnection canonicalCacheKeyForRequests:@[other]] isEqualToString:key],
+                  @"different fields should get a different key");
+    STAssertTrue([key rangeOfString:@"access_token"].location == NSNotFound, @"token should be left out");
+}
+
+- (void)testCanonicalCacheKeyTellsNonScalarParametersApart {
+    NSData *data = [@"first" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *otherData = [@"second" dataUsingEncoding:NSUTF8StringEncoding];
+    NSString *key = [FBRequestConnection canonicalCacheKeyForRequests:@[[FBRequest requestWithGraphPath:@"me/objects"
+                                                                                            parameters:@{@"blob" : data}
+                                                                                            HTTPMethod:nil]]];
+    NSString *sameKey = [FBRequestConnection canonicalCacheKeyForRequests:@[[FBRequest requestWithGraphPath:@"me/objects"
+                                                                                                parameters:@{@"blob" : [[data mutableCopy] autorelease]}
+                                                                                                HTTPMethod:nil]]];
+    NSString *otherKey = [FBRequestConnection canonicalCacheKeyForRequests:@[[FBRequest requestWithGraphPath:@"me/objects"
+                                                                                                 parameters:@{@"blob" : otherData}
+                                                                                                 HTTPMethod:nil]]];
+    NSString *objectKey = [FBRequestConnection canonicalCacheKeyForRequests:@[[FBRequest requestWithGraphPath:@"me/objects"
+                                                                                                  parameters:@{@"object" : @{@"b" : @"2", @"a" : @"1"}}
+                                                                                                  HTTPMethod:nil]]];
+    NSString *otherObjectKey = [FBRequestConnection canonicalCacheKeyForRequests:@[[FBRequest requestWithGraphPath:@"me/objects"
+                                                                                                       parameters:@{@"object" : @{@"a" : @"1"}}
+                                                                                                       HTTPMethod:nil]]];
+
+    STAssertEqualObjects(sameKey, key, @"equal attachments should share a key");
+    STAssertFalse([otherKey isEqualToString:key], @"different attachments should get different keys");
+    STAssertFalse([otherObjectKey isEqualToString:objectKey], @"different objects should get different keys");
+}
+
 - (void)testOpenGraphObjectPostBogus {
     NSMutableDictionary<FBGraphObject> *object =
     [FBGraphObject openGraphObjectForPostWithType:@"fb_sample_scrumps:meal"
@@ -728,4 +1447,152 @@
     }
 }
 
+// Enough 100 msec samples for hedging to kick in, at its minimum delay
+- (void)seedRequestLatency
+{
+    [[FBMetrics sharedMetrics] reset];
+    for (int i = 0; i < 20; i++) {
+        [[FBMetrics sharedMetrics] recordValue:100 forMetric:FBMetricRequestLatency];
+    }
+}
+
+- (void)testSlowReadIsHedgedAndTheFirstResponseWins
+{
+    [self seedRequestLatency];
+    [FBSettings enableRequestHedging:YES];
+
+    __block int sentCount = 0;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        sentCount++;
+        NSString *string = (sentCount == 1) ? @"{\"id\":\"slow\"}" : @"{\"id\":\"hedge\"}";
+        return [OHHTTPStubsResponse responseWithData:[string dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:(sentCount == 1) ? 10 : 0
+                                             headers:nil];
+    }];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block int handlerCount = 0;
+    __block id handlerResult = nil;
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:[[[FBRequest alloc] initWithSession:nil graphPath:[[NSProcessInfo processInfo] globallyUniqueString]] autorelease]
+         completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+             handlerCount++;
+             handlerResult = [result retain];
+             [blocker signal];
+         }];
+    [connection start];
+
+    STAssertTrue([blocker waitWithTimeout:3], @"the hedge should have answered well before the slow request");
+    [blocker waitWithTimeout:0.5];
+    STAssertEquals(2, sentCount, @"one hedge should have been sent");
+    STAssertEquals(1, handlerCount, @"only the first response should be delivered");
+    STAssertEqualObjects(@"hedge", handlerResult[@"id"], nil);
+
+    [handlerResult release];
+    [FBSettings enableRequestHedging:NO];
+    [[FBMetrics sharedMetrics] reset];
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+- (void)testWritesAreNotHedged
+{
+    [self seedRequestLatency];
+    [FBSettings enableRequestHedging:YES];
+
+    __block int sentCount = 0;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        sentCount++;
+        return [OHHTTPStubsResponse responseWithData:[@"true" dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:1
+                                             headers:nil];
+    }];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:[[[FBRequest alloc] initWithSession:nil
+                                                     graphPath:[[NSProcessInfo processInfo] globallyUniqueString]
+                                                    parameters:@{@"message": @"hello"}
+                                                    HTTPMethod:@"POST"] autorelease]
+         completionHandler:^(FBRequestConnection *innerConnection, id result, NSError *error) {
+             [blocker signal];
+         }];
+    [connection start];
+
+    STAssertTrue([blocker waitWithTimeout:3], @"timed out waiting for the request to return");
+    STAssertEquals(1, sentCount, @"a request that changes state must only be sent once");
+
+    [FBSettings enableRequestHedging:NO];
+    [[FBMetrics sharedMetrics] reset];
+    [OHHTTPStubs removeAllRequestHandlers];
+}
+
+
+- (void)testRequestPipelineTracePointsComeInOrderedPairs
+{
+    FBSession *session = [self createAndOpenSessionWithMockToken];
+    [self stubAllResponsesWithResult:@{@"id": @"4"}];
+
+    NSArray *phases = @[@(FBTracePointBuildRequestBody),
+                        @(FBTracePointNetwork),
+                        @(FBTracePointParseResponse),
+                        @(FBTracePointCompletion)];
+    NSMutableArray *events = [NSMutableArray array];
+    [FBSettings setTraceHandler:^(FBTracePoint point, BOOL begin, uintptr_t identifier) {
+        if ([phases containsObject:@(point)]) {
+            @synchronized (events) {
+                [events addObject:@[@(point), @(begin), @(identifier)]];
+            }
+        }
+    }];
+    [FBSettings enableTracing:YES];
+
+    FBRequestConnection *connection = [[[FBRequestConnection alloc] init] autorelease];
+    [connection addRequest:[[[FBRequest alloc] initWithSession:session graphPath:@"4"] autorelease] completionHandler:nil];
+    [connection start];
+
+    // the completion phase ends once the handlers have run
+    NSArray *completionEnd = @[@(FBTracePointCompletion), @NO, @((uintptr_t)connection)];
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:1] autorelease];
+    BOOL completed = [blocker waitWithTimeout:2 periodicHandler:^(FBTestBlocker *innerBlocker) {
+        @synchronized (events) {
+            if ([events containsObject:completionEnd]) {
+                [innerBlocker signal];
+            }
+        }
+    }];
+    [FBSettings enableTracing:NO];
+    [FBSettings setTraceHandler:nil];
+    STAssertTrue(completed, @"the completion phase never ended");
+
+    NSArray *recorded = nil;
+    @synchronized (events) {
+        recorded = [[events copy] autorelease];
+    }
+    NSUInteger previousBegin = 0;
+    for (NSNumber *phase in phases) {
+        NSIndexSet *begins = [recorded indexesOfObjectsPassingTest:^BOOL(NSArray *event, NSUInteger index, BOOL *stop) {
+            return [event[0] isEqual:phase] && [event[1] boolValue];
+        }];
+        NSIndexSet *ends = [recorded indexesOfObjectsPassingTest:^BOOL(NSArray *event, NSUInteger index, BOOL *stop) {
+            return [event[0] isEqual:phase] && ![event[1] boolValue];
+        }];
+        STAssertEquals(begins.count, (NSUInteger)1, @"phase %@ should begin once", phase);
+        STAssertEquals(ends.count, (NSUInteger)1, @"phase %@ should end once", phase);
+        if (begins.count != 1 || ends.count != 1) {
+            continue;
+        }
+        STAssertTrue(begins.firstIndex < ends.firstIndex, @"phase %@ should begin before it ends", phase);
+        STAssertEqualObjects(recorded[begins.firstIndex][2], recorded[ends.firstIndex][2],
+                             @"phase %@ should end with the identifier it began with", phase);
+        STAssertTrue(begins.firstIndex >= previousBegin, @"phase %@ began out of order", phase);
+        previousBegin = begins.firstIndex;
+    }
+}
+
 @end
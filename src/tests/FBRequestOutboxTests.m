@@ -0,0 +1,98 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBTests.h"
+
+#import "FBError.h"
+#import "FBRequest.h"
+#import "FBRequestOutbox.h"
+
+@interface FBRequestOutboxTests : FBTests
+@end
+
+@implementation FBRequestOutboxTests
+{
+    NSString *_outboxPath;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    _outboxPath = [[NSTemporaryDirectory() stringByAppendingPathComponent:
+                    [NSString stringWithFormat:@"FBRequestOutboxTests-%u", arc4random()]] retain];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:_outboxPath error:nil];
+    [_outboxPath release];
+    _outboxPath = nil;
+
+    [super tearDown];
+}
+
+- (NSError *)offlineError
+{
+    NSError *innerError = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNotConnectedToInternet userInfo:nil];
+    return [NSError errorWithDomain:FacebookSDKDomain
+                               code:FBErrorHTTPError
+                           userInfo:@{FBErrorInnerErrorKey : innerError}];
+}
+
+- (FBRequest *)statusUpdateRequest
+{
+    return [[[FBRequest alloc] initWithSession:nil
+                                     graphPath:@"me/feed"
+                                    parameters:@{@"message" : @"hello", @"access_token" : @"token"}
+                                    HTTPMethod:@"POST"] autorelease];
+}
+
+- (void)testOfflinePostIsJournaledAndSurvivesRelaunch
+{
+    FBRequestOutbox *outbox = [[FBRequestOutbox alloc] initWithPath:_outboxPath];
+    NSError *reported = [outbox queueRequest:[self statusUpdateRequest] afterError:[self offlineError]];
+
+    STAssertEqualObjects(reported.userInfo[FBErrorRequestQueuedOfflineKey], @YES, @"should report the request as queued");
+    STAssertEquals(outbox.pendingRequestCount, (NSUInteger)1, @"should journal the request");
+    [outbox release];
+
+    outbox = [[FBRequestOutbox alloc] initWithPath:_outboxPath];
+    STAssertEquals(outbox.pendingRequestCount, (NSUInteger)1, @"should read the journal back");
+    [outbox release];
+}
+
+- (void)testRequestsThatCantBeRepeatedAreNotJournaled
+{
+    FBRequestOutbox *outbox = [[FBRequestOutbox alloc] initWithPath:_outboxPath];
+
+    NSError *apiError = [NSError errorWithDomain:FacebookSDKDomain code:FBErrorRequestConnectionApi userInfo:nil];
+    NSError *reported = [outbox queueRequest:[self statusUpdateRequest] afterError:apiError];
+    STAssertEquals(reported, apiError, @"API errors should be reported unchanged");
+
+    FBRequest *get = [[[FBRequest alloc] initWithSession:nil graphPath:@"me"] autorelease];
+    [outbox queueRequest:get afterError:[self offlineError]];
+
+    FBRequest *upload = [self statusUpdateRequest];
+    upload.parameters[@"picture"] = [NSData dataWithBytes:"x" length:1];
+    [outbox queueRequest:upload afterError:[self offlineError]];
+
+    STAssertEquals(outbox.pendingRequestCount, (NSUInteger)0, @"nothing should be journaled");
+    [outbox release];
+}
+
+@end
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#import "FBTests.h"
+
+#import "FBRequestRetryPolicy.h"
+#import "FBRequestRetryPolicy+Internal.h"
+
+@interface FBRequestRetryPolicyTests : FBTests
+@end
+
+@implementation FBRequestRetryPolicyTests
+
+- (NSHTTPURLResponse *)responseWithStatusCode:(NSInteger)statusCode
+{
+    return [[[NSHTTPURLResponse alloc] initWithURL:[NSURL URLWithString:@"https://graph.facebook.com/me"]
+                                        statusCode:statusCode
+                                       HTTPVersion:@"HTTP/1.1"
+                                      headerFields:nil] autorelease];
+}
+
+- (void)testRetriesOnlyTransientFailures
+{
+    FBRequestRetryPolicy *policy = [[[FBRequestRetryPolicy alloc] init] autorelease];
+    NSError *timeout = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil];
+    NSError *offline = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNotConnectedToInternet userInfo:nil];
+
+    assertThatBool([policy shouldRetryAfterError:timeout response:nil], equalToBool(YES));
+    assertThatBool([policy shouldRetryAfterError:offline response:nil], equalToBool(NO));
+    assertThatBool([policy shouldRetryAfterError:nil response:[self responseWithStatusCode:503]], equalToBool(YES));
+    assertThatBool([policy shouldRetryAfterError:nil response:[self responseWithStatusCode:501]], equalToBool(NO));
+    assertThatBool([policy shouldRetryAfterError:nil response:[self responseWithStatusCode:400]], equalToBool(NO));
+}
+
+- (void)testBackoffIsCappedAndJittered
+{
+    FBRequestRetryPolicy *policy = [[[FBRequestRetryPolicy alloc] init] autorelease];
+    policy.initialBackoff = 1;
+    policy.maximumBackoff = 4;
+
+    for (int i = 0; i < 20; i++) {
+        NSTimeInterval first = [policy backoffBeforeRetry:1];
+        assertThatBool(first >= 0 && first <= 1, equalToBool(YES));
+        NSTimeInterval tenth = [policy backoffBeforeRetry:10];
+        assertThatBool(tenth >= 0 && tenth <= 4, equalToBool(YES));
+    }
+}
+
+- (void)testCircuitOpensAfterConsecutiveFailuresAndClosesOnSuccess
+{
+    FBRequestRetryPolicy *policy = [[[FBRequestRetryPolicy alloc] init] autorelease];
+    policy.circuitBreakerFailureThreshold = 3;
+    policy.circuitBreakerResetInterval = 0;
+    NSString *host = @"graph.facebook.com";
+
+    [policy recordFailureForHost:host];
+    [policy recordFailureForHost:host];
+    [policy recordSuccessForHost:host];
+    [policy recordFailureForHost:host];
+    [policy recordFailureForHost:host];
+    assertThatBool([policy isCircuitOpenForHost:host], equalToBool(NO));
+
+    [policy recordFailureForHost:host];
+    assertThatBool([policy isCircuitOpenForHost:host], equalToBool(YES));
+    assertThat(policy.hostsWithOpenCircuits, equalTo([NSSet setWithObject:host]));
+
+    // With no reset interval a trial request goes through right away
+    assertThatBool([policy shouldAllowRequestToHost:host], equalToBool(YES));
+    [policy recordSuccessForHost:host];
+    assertThatBool([policy isCircuitOpenForHost:host], equalToBool(NO));
+    assertThatBool([policy shouldAllowRequestToHost:@"other.example.com"], equalToBool(YES));
+}
+
+- (void)testOpenCircuitRejectsUntilResetInterval
+{
+    FBRequestRetryPolicy *policy = [[[FBRequestRetryPolicy alloc] init] autorelease];
+    policy.circuitBreakerFailureThreshold = 1;
+    policy.circuitBreakerResetInterval = 60;
+    NSString *host = @"graph.facebook.com";
+
+    [policy recordFailureForHost:host];
+    assertThatBool([policy shouldAllowRequestToHost:host], equalToBool(NO));
+}
+
+@end
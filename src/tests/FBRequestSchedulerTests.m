@@ -0,0 +1,124 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import "FBTests.h"
+
+#import "FBRequestScheduler.h"
+#import "FBSettings.h"
+#import "FBTestBlocker.h"
+
+@interface FBRequestSchedulerTests : FBTests
+@end
+
+@implementation FBRequestSchedulerTests
+
+- (void)setUp
+{
+    [super setUp];
+    [FBSettings enableRequestScheduling:YES];
+}
+
+- (void)tearDown
+{
+    [FBSettings enableRequestScheduling:NO];
+    [super tearDown];
+}
+
+- (void)testRequestsOverTheLimitWaitForASlot
+{
+    FBRequestScheduler *scheduler = [[[FBRequestScheduler alloc] init] autorelease];
+    [scheduler setLimit:1 forPriority:FBRequestPriorityBackground];
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block BOOL firstStarted = NO;
+    __block BOOL secondStarted = NO;
+
+    id first = [scheduler scheduleRequestWithPriority:FBRequestPriorityBackground start:^{
+        firstStarted = YES;
+    }];
+    id second = [scheduler scheduleRequestWithPriority:FBRequestPriorityBackground start:^{
+        secondStarted = YES;
+        [blocker signal];
+    }];
+    STAssertTrue(firstStarted, @"a request with a free slot should start right away");
+    STAssertFalse(secondStarted, @"a request over the limit should wait");
+
+    [scheduler finishRequest:first];
+    STAssertTrue([blocker waitWithTimeout:1], @"the waiting request should start once the slot frees up");
+    [scheduler finishRequest:second];
+}
+
+- (void)testHigherPriorityGoesFirst
+{
+    FBRequestScheduler *scheduler = [[[FBRequestScheduler alloc] init] autorelease];
+    [scheduler setLimit:1 forPriority:FBRequestPriorityUserInitiated];
+    [scheduler setLimit:0 forPriority:FBRequestPriorityPrefetch];
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    NSMutableArray *order = [NSMutableArray array];
+
+    id blocking = [scheduler scheduleRequestWithPriority:FBRequestPriorityUserInitiated start:^{}];
+    id prefetch = [scheduler scheduleRequestWithPriority:FBRequestPriorityPrefetch start:^{
+        [order addObject:@"prefetch"];
+        [blocker signal];
+    }];
+    id user = [scheduler scheduleRequestWithPriority:FBRequestPriorityUserInitiated start:^{
+        [order addObject:@"user"];
+    }];
+
+    // Opening up the prefetch limit and the user initiated slot together
+    [scheduler setPriority:FBRequestPriorityBackground forRequest:blocking];
+    [scheduler setLimit:1 forPriority:FBRequestPriorityPrefetch];
+    STAssertTrue([blocker waitWithTimeout:1], @"timed out waiting for the prefetch");
+    STAssertEqualObjects(order, (@[@"user", @"prefetch"]), @"the user initiated request should start first");
+
+    [scheduler finishRequest:blocking];
+    [scheduler finishRequest:prefetch];
+    [scheduler finishRequest:user];
+}
+
+- (void)testPromotingAWaitingRequest
+{
+    FBRequestScheduler *scheduler = [[[FBRequestScheduler alloc] init] autorelease];
+    [scheduler setLimit:0 forPriority:FBRequestPriorityPrefetch];
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+
+    id request = [scheduler scheduleRequestWithPriority:FBRequestPriorityPrefetch start:^{
+        [blocker signal];
+    }];
+    STAssertFalse([blocker waitWithTimeout:0.1], @"a prefetch should wait while its limit is 0");
+
+    [scheduler setPriority:FBRequestPriorityVisibleImage forRequest:request];
+    STAssertTrue([blocker waitWithTimeout:1], @"a promoted request should start");
+    [scheduler finishRequest:request];
+}
+
+- (void)testFinishedRequestsNeverStart
+{
+    FBRequestScheduler *scheduler = [[[FBRequestScheduler alloc] init] autorelease];
+    [scheduler setLimit:0 forPriority:FBRequestPriorityBackground];
+    __block BOOL started = NO;
+
+    id request = [scheduler scheduleRequestWithPriority:FBRequestPriorityBackground start:^{
+        started = YES;
+    }];
+    [scheduler finishRequest:request];
+    [scheduler setLimit:1 forPriority:FBRequestPriorityBackground];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+
+    STAssertFalse(started, @"a cancelled request should not start");
+}
+
+@end
@@ -20,7 +20,9 @@
 
 #import "FBRequest.h"
 #import "FBRequestConnection+Internal.h"
+#import "FBRequestTemplate.h"
 #import "FBTestBlocker.h"
+#import "FBUtility.h"
 #import "Facebook.h"
 
 // This is just to silence compiler warnings since we access internal methods in some tests.
@@ -145,6 +147,35 @@
     [FBSettings setFacebookDomainPart:nil];
 }
 
+- (void)testTemplateRequestSerializesLikePlainRequest {
+    FBRequestTemplate *requestTemplate = [[FBRequestTemplate alloc] initWithGraphPath:@"%@/likes"
+                                                                           parameters:@{ @"fields" : @"id,name", @"limit" : @25 }
+                                                                           HTTPMethod:nil];
+    FBRequest *templateRequest = [requestTemplate requestWithSession:nil
+                                                        pathArgument:@"4"
+                                                          parameters:@{ @"after" : @"cursor" }];
+    FBRequest *plainRequest = [[[FBRequest alloc] initWithSession:nil
+                                                        graphPath:@"4/likes"
+                                                       parameters:@{ @"fields" : @"id,name", @"limit" : @25, @"after" : @"cursor" }
+                                                       HTTPMethod:nil] autorelease];
+
+    FBRequestConnection *dummy = [[[FBRequestConnection alloc] init] autorelease];
+    NSString *templateURL = [dummy urlStringForSingleRequest:templateRequest forBatch:YES];
+    NSString *plainURL = [dummy urlStringForSingleRequest:plainRequest forBatch:YES];
+
+    assertThat(templateRequest.graphPath, equalTo(@"4/likes"));
+    assertThat([FBUtility queryParamsDictionaryFromFBURL:[NSURL URLWithString:templateURL]],
+               equalTo([FBUtility queryParamsDictionaryFromFBURL:[NSURL URLWithString:plainURL]]));
+
+    // a changed template parameter is encoded afresh
+    templateRequest.parameters[@"fields"] = @"id";
+    templateURL = [dummy urlStringForSingleRequest:templateRequest forBatch:YES];
+    assertThat([FBUtility queryParamsDictionaryFromFBURL:[NSURL URLWithString:templateURL]],
+               hasEntry(@"fields", @"id"));
+
+    [requestTemplate release];
+}
+
 - (void)testCanInitWithHTTPMethod {
     FBRequest *request = [[FBRequest alloc] initWithSession:nil
                                                   graphPath:nil
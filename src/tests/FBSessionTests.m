@@ -23,6 +23,9 @@
 #import "FBUtility.h"
 #import "FBSessionTokenCachingStrategy.h"
 #import "FBSessionUtility.h"
+#import "FBSession+Internal.h"
+#import "FBSessionAuthLogger.h"
+#import "FBSessionPool.h"
 #import "FBSystemAccountStoreAdapter.h"
 #import "FBAccessTokenData+Internal.h"
 #import "FBError.h"
@@ -581,6 +584,46 @@ static NSString *kURLSchemeSuffix = @"URLSuffix";
     assertThatInt(session.state, equalToInt(FBSessionStateCreatedTokenLoaded));
 }
 
+- (void)testCachedUserIsSavedWithTokenInformation {
+    FBAccessTokenData *token = [FBAccessTokenData createTokenFromString:kTestToken
+                                                            permissions:nil
+                                                         expirationDate:[NSDate dateWithTimeIntervalSinceNow:3600]
+                                                              loginType:FBSessionLoginTypeNone
+                                                            refreshDate:nil];
+    token.cachedUser = @{ @"id" : @"4", @"name" : @"Mark", @"location" : @{ @"id" : @"1" } };
+
+    FBAccessTokenData *restored = [FBAccessTokenData createTokenFromDictionary:[token dictionary]];
+
+    assertThat(restored.cachedUser, equalTo(token.cachedUser));
+}
+
+- (void)testCacheUserIsIgnoredForAnotherUser {
+    FBAccessTokenData *mockToken = [self createValidMockToken];
+    FBSessionTokenCachingStrategy *mockStrategy = [self createMockTokenCachingStrategyWithToken:mockToken];
+    // only expected once; the mock would throw on a second save
+    [[(id)mockStrategy expect] cacheFBAccessTokenData:[OCMArg any]];
+    [[(id)mockStrategy stub] clearToken];
+
+    FBSession *session = [[FBSession alloc] initWithAppID:kTestAppId
+                                              permissions:nil
+                                          defaultAudience:FBSessionDefaultAudienceNone
+                                          urlSchemeSuffix:nil
+                                       tokenCacheStrategy:mockStrategy];
+    [session openWithCompletionHandler:nil];
+
+    [session cacheUser:(NSDictionary<FBGraphUser> *)@{ @"id" : @"4", @"name" : @"Mark", @"birthday" : @"05/14" }];
+    [session cacheUser:(NSDictionary<FBGraphUser> *)@{ @"id" : @"5", @"name" : @"Chris" }];
+    // same ID and name, so there is nothing new to save
+    [session cacheUser:(NSDictionary<FBGraphUser> *)@{ @"id" : @"4", @"name" : @"Mark", @"birthday" : @"05/15" }];
+
+    [(id)mockStrategy verify];
+    assertThat([session cachedUser], equalTo(@{ @"id" : @"4", @"name" : @"Mark" }));
+
+    [session closeAndClearTokenInformation];
+    assertThat([session cachedUser], nilValue());
+
+    [session release];
+}
 
 - (void)testCloseDoesNotSendDidBecomeClosedNotificationIfOpenSessionNotActiveSession {
     [FBSession setDefaultAppID:kTestAppId];
@@ -1354,6 +1397,115 @@ static NSString *kURLSchemeSuffix = @"URLSuffix";
     assertThatInteger(cookiesForFacebook.count, equalToInteger(0));
 }
 
+- (void)testAsynchronousCacheInstanceReadsItsOwnWrites {
+    FBSessionTokenCachingStrategy *strategy =
+    [FBSessionTokenCachingStrategy asynchronousCacheInstanceWithUserDefaultTokenInformationKeyName:@"FBSessionTestsAsyncTokenKey"];
+    NSDictionary *tokenInformation = @{FBTokenInformationTokenKey: @"token",
+                                       FBTokenInformationExpirationDateKey: [NSDate distantFuture]};
+
+    [strategy cacheTokenInformation:tokenInformation];
+    assertThat([strategy fetchTokenInformation], equalTo(tokenInformation));
+
+    [strategy clearToken];
+    assertThat([strategy fetchTokenInformation], nilValue());
+}
+
+- (void)testRefreshAccessTokenIfNeededOnClosedSessionSendsNothing {
+    FBSession *session = [[FBSession alloc] initWithAppID:kTestAppId
+                                              permissions:nil
+                                          urlSchemeSuffix:nil
+                                       tokenCacheStrategy:[FBSessionTokenCachingStrategy nullCacheInstance]];
+    __block BOOL handlerCalled = NO;
+    [session refreshAccessTokenIfNeededWithCompletionHandler:^(FBSession *innerSession, BOOL didRefresh, NSError *error) {
+        handlerCalled = YES;
+        STAssertFalse(didRefresh, @"a closed session has nothing to refresh");
+        assertThat(error, nilValue());
+    }];
+    STAssertTrue(handlerCalled, @"handler should be called right away");
+    [session release];
+}
+
+- (void)testSessionPoolTracksSessionsByKey {
+    FBSession *session = [[FBSession alloc] initWithAppID:kTestAppId
+                                              permissions:nil
+                                          urlSchemeSuffix:nil
+                                       tokenCacheStrategy:[FBSessionTokenCachingStrategy nullCacheInstance]];
+    FBSessionPool *pool = [[FBSessionPool alloc] init];
+
+    [pool addSession:session forKey:@"first"];
+    assertThat([pool sessionForKey:@"first"], sameInstance(session));
+    assertThat(pool.keys, equalTo(@[@"first"]));
+    STAssertTrue([pool containsSession:session], @"pooled session should be found");
+
+    [pool removeSessionForKey:@"first"];
+    assertThat([pool sessionForKey:@"first"], nilValue());
+    STAssertFalse([pool containsSession:session], @"removed session should not be found");
+
+    [pool release];
+    [session release];
+}
+
+- (void)testAuthLoggerClientStateCarriesStartTime {
+    FBSessionAuthLogger *logger = [[FBSessionAuthLogger alloc] initWithSession:nil
+                                                                            ID:@"logger-id"
+                                                                    authMethod:nil
+                                                                     startTime:@1234.5];
+    NSDictionary *clientState = [logger clientStateForAuthMethod:FBSessionAuthLoggerAuthMethodBrowser];
+
+    assertThat(clientState[FBSessionAuthLoggerParamIDKey], equalTo(@"logger-id"));
+    assertThat(clientState[FBSessionAuthLoggerParamAuthMethodKey], equalTo(FBSessionAuthLoggerAuthMethodBrowser));
+    assertThat(clientState[FBSessionAuthLoggerParamStartTimeKey], equalTo(@1234.5));
+    [logger release];
+}
+
+- (void)testAuthLoggerReportsPhaseTimingsWhenAuthEnds {
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block NSString *reportedMethod = nil;
+    __block NSString *reportedResult = nil;
+    __block NSDictionary *reportedTimings = nil;
+    [FBSessionAuthLogger setTimingHandler:^(NSString *authMethod, NSString *result, NSDictionary *phaseTimings) {
+        reportedMethod = [authMethod copy];
+        reportedResult = [result copy];
+        reportedTimings = [phaseTimings retain];
+        [blocker signal];
+    }];
+
+    FBSessionAuthLogger *logger = [[FBSessionAuthLogger alloc] initWithSession:nil ID:@"logger-id" authMethod:nil];
+    // Before the start there is nothing to measure from
+    [logger logPhase:FBSessionAuthLoggerPhaseCallbackReceived];
+    [logger logStartAuth];
+    [logger logStartAuthMethod:FBSessionAuthLoggerAuthMethodBrowser];
+    [logger logEndAuthWithResult:FBSessionAuthLoggerResultSuccess error:nil];
+    [logger release];
+
+    assertThatBool([blocker waitWithTimeout:2], equalToBool(YES));
+    assertThat(reportedMethod, equalTo(FBSessionAuthLoggerAuthMethodBrowser));
+    assertThat(reportedResult, equalTo(FBSessionAuthLoggerResultSuccess));
+    assertThat([NSSet setWithArray:reportedTimings.allKeys],
+               equalTo([NSSet setWithObjects:FBSessionAuthLoggerPhaseMethodStart, FBSessionAuthLoggerPhaseEnd, nil]));
+    assertThatDouble([reportedTimings[FBSessionAuthLoggerPhaseEnd] doubleValue], greaterThanOrEqualTo(@0));
+
+    [reportedMethod release];
+    [reportedResult release];
+    [reportedTimings release];
+    [FBSessionAuthLogger setTimingHandler:nil];
+}
+
+- (void)testAuthLoggerNeverStartedReportsNoTimings {
+    __block BOOL reported = NO;
+    [FBSessionAuthLogger setTimingHandler:^(NSString *authMethod, NSString *result, NSDictionary *phaseTimings) {
+        reported = YES;
+    }];
+
+    FBSessionAuthLogger *logger = [[FBSessionAuthLogger alloc] initWithSession:nil ID:@"logger-id" authMethod:nil];
+    [logger logEndAuthWithResult:FBSessionAuthLoggerResultError error:nil];
+    [logger release];
+    [self waitForMainQueueToFinish];
+
+    assertThatBool(reported, equalToBool(NO));
+    [FBSessionAuthLogger setTimingHandler:nil];
+}
+
 #pragma mark Helpers
 
 - (BOOL)isSystemVersionAtLeast:(NSString *)desiredVersion {
@@ -19,7 +19,13 @@
 #define FB_BUILD_ONLY
 #endif
 
+#import "FBLogger.h"
+#import "FBMainThreadWatchdog.h"
+#import "FBRequest.h"
+#import "FBSettings+Internal.h"
 #import "FBSettings.h"
+#import "FBStartupProfiler.h"
+#import "FBTestBlocker.h"
 
 #ifdef FB_BUILD_ONLY
 #undef FB_BUILD_ONLY
@@ -45,4 +51,343 @@
     STAssertFalse([FBSettings isBetaFeatureEnabled:FBBetaFeaturesShareDialog], @"share dialog enabled");
 }
 
+- (void)testLoggingBehaviorCheckTracksSettings
+{
+    NSSet *originalBehaviors = [[FBSettings loggingBehavior] retain];
+
+    [FBSettings setLoggingBehavior:[NSSet setWithObject:FBLoggingBehaviorFBRequests]];
+    STAssertTrue([FBLogger isLoggingBehaviorEnabled:FBLoggingBehaviorFBRequests], @"requests logging enabled");
+    STAssertFalse([FBLogger isLoggingBehaviorEnabled:FBLoggingBehaviorAppEvents], @"app events logging disabled");
+
+    [FBSettings setLoggingBehavior:[NSSet set]];
+    STAssertFalse([FBLogger isLoggingBehaviorEnabled:FBLoggingBehaviorFBRequests], @"requests logging disabled");
+
+    FBLogger *logger = [[[FBLogger alloc] initWithLoggingBehavior:FBLoggingBehaviorFBRequests] autorelease];
+    FBLoggerAppendFormat(logger, @"%@", @"ignored");
+    STAssertFalse(logger.isActive, @"logger inactive");
+    STAssertNil(logger.contents, @"nothing accumulated");
+
+    [FBSettings setLoggingBehavior:originalBehaviors];
+    [originalBehaviors release];
+}
+
+- (void)testAsynchronousLoggingDeliversToHandler
+{
+    NSSet *originalBehaviors = [[FBSettings loggingBehavior] retain];
+    NSMutableArray *entries = [NSMutableArray array];
+
+    [FBSettings setLoggingBehavior:[NSSet setWithObject:FBLoggingBehaviorInformational]];
+    [FBSettings setLoggingHandler:^(NSString *logEntry) {
+        @synchronized (entries) {
+            [entries addObject:logEntry];
+        }
+    }];
+    [FBSettings enableAsynchronousLogging:YES];
+
+    [FBLogger singleShotLogEntry:FBLoggingBehaviorInformational logEntry:@"queued entry"];
+    [FBLogger flushSink];
+
+    @synchronized (entries) {
+        STAssertTrue([entries containsObject:@"queued entry"], @"entry delivered to the handler");
+    }
+
+    [FBSettings enableAsynchronousLogging:NO];
+    [FBSettings setLoggingHandler:nil];
+    [FBSettings setLoggingBehavior:originalBehaviors];
+    [originalBehaviors release];
+}
+
+- (void)testSynchronousLoggingDeliversOnTheLoggingThread
+{
+    NSSet *originalBehaviors = [[FBSettings loggingBehavior] retain];
+    NSMutableArray *threads = [NSMutableArray array];
+
+    [FBSettings setLoggingBehavior:[NSSet setWithObject:FBLoggingBehaviorInformational]];
+    [FBSettings setLoggingHandler:^(NSString *logEntry) {
+        [threads addObject:[NSThread currentThread]];
+    }];
+
+    [FBLogger singleShotLogEntry:FBLoggingBehaviorInformational logEntry:@"immediate entry"];
+    STAssertEqualObjects(threads, @[[NSThread currentThread]], @"entry delivered before the call returns");
+
+    [FBSettings setLoggingHandler:nil];
+    [FBSettings setLoggingBehavior:originalBehaviors];
+    [originalBehaviors release];
+}
+
+- (void)testDisablingAsynchronousLoggingFlushesQueuedEntries
+{
+    NSSet *originalBehaviors = [[FBSettings loggingBehavior] retain];
+    NSMutableArray *entries = [NSMutableArray array];
+
+    [FBSettings setLoggingBehavior:[NSSet setWithObject:FBLoggingBehaviorInformational]];
+    [FBSettings setLoggingHandler:^(NSString *logEntry) {
+        @synchronized (entries) {
+            [entries addObject:logEntry];
+        }
+    }];
+    [FBSettings enableAsynchronousLogging:YES];
+    [FBLogger singleShotLogEntry:FBLoggingBehaviorInformational logEntry:@"pending entry"];
+    [FBSettings enableAsynchronousLogging:NO];
+
+    @synchronized (entries) {
+        STAssertTrue([entries containsObject:@"pending entry"], @"queued entry written when disabled");
+    }
+    STAssertFalse([FBSettings isAsynchronousLoggingEnabled], @"asynchronous logging disabled");
+
+    [FBSettings setLoggingHandler:nil];
+    [FBSettings setLoggingBehavior:originalBehaviors];
+    [originalBehaviors release];
+}
+
+- (void)testAsynchronousLoggingDropsEntriesWhenTheBufferIsFull
+{
+    NSSet *originalBehaviors = [[FBSettings loggingBehavior] retain];
+    NSMutableArray *entries = [NSMutableArray array];
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    dispatch_semaphore_t gate = dispatch_semaphore_create(0);
+    NSUInteger droppedBefore = [FBLogger droppedEntryCount];
+
+    [FBSettings setLoggingBehavior:[NSSet setWithObject:FBLoggingBehaviorInformational]];
+    [FBSettings setLoggingHandler:^(NSString *logEntry) {
+        if ([logEntry isEqualToString:@"blocking entry"]) {
+            dispatch_semaphore_signal(started);
+            dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+        }
+        @synchronized (entries) {
+            [entries addObject:logEntry];
+        }
+    }];
+    [FBSettings enableAsynchronousLogging:YES];
+
+    // Hold the drain inside the handler while the 1024 slots fill up
+    [FBLogger singleShotLogEntry:FBLoggingBehaviorInformational logEntry:@"blocking entry"];
+    dispatch_semaphore_wait(started, DISPATCH_TIME_FOREVER);
+    for (int i = 0; i < 1030; i++) {
+        [FBLogger singleShotLogEntry:FBLoggingBehaviorInformational logEntry:[NSString stringWithFormat:@"entry %d", i]];
+    }
+    dispatch_semaphore_signal(gate);
+    [FBLogger flushSink];
+
+    STAssertEquals([FBLogger droppedEntryCount] - droppedBefore, (NSUInteger)6, @"entries past the buffer dropped");
+    @synchronized (entries) {
+        STAssertEquals(entries.count, (NSUInteger)1026, @"blocking entry, 1024 queued entries and the drop report");
+        STAssertEqualObjects([entries objectAtIndex:1024], @"entry 1023", @"queued entries kept in order");
+        STAssertEqualObjects([entries lastObject], @"6 log entries were dropped because logging fell behind", @"drop reported");
+    }
+
+    [FBSettings enableAsynchronousLogging:NO];
+    [FBSettings setLoggingHandler:nil];
+    [FBSettings setLoggingBehavior:originalBehaviors];
+    [originalBehaviors release];
+    dispatch_release(started);
+    dispatch_release(gate);
+}
+
+- (void)testFileLoggingHandlerAppendsLines
+{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:
+                      [NSString stringWithFormat:@"FBSettingsTests-%u.log", arc4random()]];
+    [@"existing\n" writeToFile:path atomically:YES encoding:NSUTF8StringEncoding error:NULL];
+
+    FBLoggingHandler handler = [FBSettings loggingHandlerWritingToFileAtPath:path];
+    handler(@"first");
+    handler(@"second");
+
+    NSString *contents = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:NULL];
+    STAssertEqualObjects(contents, @"existing\nfirst\nsecond\n", @"entries appended one per line");
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testTracePointsReachHandlerOnlyWhenEnabled
+{
+    NSMutableArray *events = [NSMutableArray array];
+    [FBSettings setTraceHandler:^(FBTracePoint point, BOOL begin, uintptr_t identifier) {
+        if (point == FBTracePointRequestCreate) {
+            [events addObject:@[@(begin), @(identifier)]];
+        }
+    }];
+
+    [[[FBRequest alloc] initWithSession:nil graphPath:@"me"] release];
+    STAssertEquals(events.count, (NSUInteger)0, @"no trace points while tracing is disabled");
+
+    [FBSettings enableTracing:YES];
+    STAssertTrue([FBSettings isTracingEnabled], @"tracing enabled");
+    FBRequest *request = [[FBRequest alloc] initWithSession:nil graphPath:@"me"];
+    [FBSettings enableTracing:NO];
+
+    STAssertEquals(events.count, (NSUInteger)2, @"begin and end of the request construction");
+    STAssertEqualObjects(events[0], (@[@YES, @((uintptr_t)request)]), @"begin for the new request");
+    STAssertEqualObjects(events[1], (@[@NO, @((uintptr_t)request)]), @"end for the new request");
+
+    [request release];
+    [FBSettings setTraceHandler:nil];
+}
+
+- (void)measuredCallSleepingFor:(useconds_t)microseconds
+{
+    FBMainThreadWatchdogMeasure();
+    usleep(microseconds);
+}
+
+- (void)testMainThreadWatchdogReportsCallsOverBudget
+{
+    NSSet *originalBehaviors = [[FBSettings loggingBehavior] retain];
+    NSMutableArray *entries = [NSMutableArray array];
+    [FBSettings setLoggingBehavior:[NSSet setWithObject:FBLoggingBehaviorPerformanceCharacteristics]];
+    [FBSettings setLoggingHandler:^(NSString *logEntry) {
+        [entries addObject:logEntry];
+    }];
+
+    [FBSettings setMainThreadWorkBudget:0.005];
+    NSUInteger overrunCount = [FBMainThreadWatchdog overrunCount];
+
+    [self measuredCallSleepingFor:0];
+    STAssertEquals([FBMainThreadWatchdog overrunCount], overrunCount, @"quick call isn't reported");
+
+    [self measuredCallSleepingFor:20000];
+    STAssertEquals([FBMainThreadWatchdog overrunCount], overrunCount + 1, @"slow call is reported");
+    STAssertEquals(entries.count, (NSUInteger)1, @"one report logged");
+    STAssertTrue([entries.lastObject rangeOfString:@"measuredCallSleepingFor:"].location != NSNotFound,
+                 @"report names the call");
+
+    [FBSettings setMainThreadWorkBudget:0];
+    [self measuredCallSleepingFor:20000];
+    STAssertEquals([FBMainThreadWatchdog overrunCount], overrunCount + 1, @"nothing measured without a budget");
+
+    [FBSettings setLoggingHandler:nil];
+    [FBSettings setLoggingBehavior:originalBehaviors];
+    [originalBehaviors release];
+}
+
+- (void)measuredOuterCallSleepingFor:(useconds_t)microseconds
+{
+    FBMainThreadWatchdogMeasure();
+    [self measuredCallSleepingFor:microseconds];
+}
+
+- (BOOL)measuredCallReturningEarlyAfterSleepingFor:(useconds_t)microseconds
+{
+    FBMainThreadWatchdogMeasure();
+    usleep(microseconds);
+    if (microseconds) {
+        return YES;
+    }
+    usleep(microseconds);
+    return NO;
+}
+
+- (void)testMainThreadWatchdogReportsNestedCallsAsTheOuterOne
+{
+    NSSet *originalBehaviors = [[FBSettings loggingBehavior] retain];
+    NSMutableArray *entries = [NSMutableArray array];
+    [FBSettings setLoggingBehavior:[NSSet setWithObject:FBLoggingBehaviorPerformanceCharacteristics]];
+    [FBSettings setLoggingHandler:^(NSString *logEntry) {
+        [entries addObject:logEntry];
+    }];
+    [FBSettings setMainThreadWorkBudget:0.005];
+    NSUInteger overrunCount = [FBMainThreadWatchdog overrunCount];
+
+    [self measuredOuterCallSleepingFor:20000];
+    STAssertEquals([FBMainThreadWatchdog overrunCount], overrunCount + 1, @"nested calls are reported once");
+    STAssertEquals(entries.count, (NSUInteger)1, @"one report logged");
+    NSString *report = [entries.lastObject componentsSeparatedByString:@"\n"][0];
+    STAssertTrue([report rangeOfString:@"measuredOuterCallSleepingFor:"].location != NSNotFound,
+                 @"report names the outer call: %@", report);
+
+    // the depth went back to zero, so the next call is measured on its own
+    [self measuredCallSleepingFor:20000];
+    STAssertEquals([FBMainThreadWatchdog overrunCount], overrunCount + 2, @"later call is measured");
+
+    [FBSettings setMainThreadWorkBudget:0];
+    [FBSettings setLoggingHandler:nil];
+    [FBSettings setLoggingBehavior:originalBehaviors];
+    [originalBehaviors release];
+}
+
+- (void)testMainThreadWatchdogMeasuresEarlyReturns
+{
+    [FBSettings setMainThreadWorkBudget:0.005];
+    NSUInteger overrunCount = [FBMainThreadWatchdog overrunCount];
+
+    STAssertTrue([self measuredCallReturningEarlyAfterSleepingFor:20000], nil);
+    STAssertEquals([FBMainThreadWatchdog overrunCount], overrunCount + 1, @"an early return is still measured");
+
+    [FBSettings setMainThreadWorkBudget:0];
+}
+
+- (void)testMainThreadWatchdogIgnoresOtherThreads
+{
+    [FBSettings setMainThreadWorkBudget:0.005];
+    NSUInteger overrunCount = [FBMainThreadWatchdog overrunCount];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [self measuredCallSleepingFor:20000];
+        [blocker signal];
+    });
+    STAssertTrue([blocker waitWithTimeout:2], @"background call did not finish");
+    STAssertEquals([FBMainThreadWatchdog overrunCount], overrunCount, @"only main thread time is measured");
+
+    [FBSettings setMainThreadWorkBudget:0];
+}
+
+- (void)profiledSetupSleepingFor:(useconds_t)microseconds
+{
+    FBStartupProfilerMeasure("FBSettingsTests setup");
+    usleep(microseconds);
+}
+
+- (void)testStartupProfileAddsUpSetupWhileEnabled
+{
+    [self profiledSetupSleepingFor:1000];
+    STAssertNil([[FBSettings startupProfile] objectForKey:@"FBSettingsTests setup"], @"nothing measured while disabled");
+
+    [FBSettings enableStartupProfiling:YES];
+    [self profiledSetupSleepingFor:10000];
+    [self profiledSetupSleepingFor:10000];
+    [FBSettings enableStartupProfiling:NO];
+    [self profiledSetupSleepingFor:10000];
+
+    NSDictionary *entry = [[FBSettings startupProfile] objectForKey:@"FBSettingsTests setup"];
+    STAssertEqualObjects([entry objectForKey:FBStartupProfileCountKey], @2, @"both runs while enabled counted");
+    STAssertEqualObjects([entry objectForKey:FBStartupProfileThreadKey], @"main", @"ran on the main thread");
+    double duration = [[entry objectForKey:FBStartupProfileDurationKey] doubleValue];
+    STAssertTrue(duration >= 0.02, @"durations add up");
+    STAssertEqualsWithAccuracy([[entry objectForKey:FBStartupProfileMainThreadDurationKey] doubleValue], duration, 0.0001,
+                               @"all of it on the main thread");
+
+    [FBStartupProfiler reset];
+}
+
+- (void)testSettingChangesPublishNewSnapshot
+{
+    NSString *originalAppID = [[FBSettings defaultAppID] retain];
+    [FBSettings setDefaultAppID:@"1111"];
+    FBSettingsSnapshot *snapshot = [FBSettings snapshot];
+    STAssertEquals([FBSettings snapshot], snapshot, @"unchanged settings keep the snapshot");
+
+    [FBSettings setDefaultAppID:@"2222"];
+    STAssertEqualObjects(snapshot.appID, @"1111", @"earlier snapshot left as it was");
+    STAssertEqualObjects([FBSettings snapshot].appID, @"2222", @"change published");
+    STAssertEqualObjects([FBSettings defaultAppID], @"2222", @"getter reads the new snapshot");
+
+    [FBSettings setDefaultAppID:originalAppID];
+    [originalAppID release];
+}
+
+- (void)testPrewarmCallsHandlerOnMainThread
+{
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] initWithExpectedSignalCount:1] autorelease];
+    __block BOOL calledOnMainThread = NO;
+
+    [FBSettings prewarmWithCompletionHandler:^{
+        calledOnMainThread = [NSThread isMainThread];
+        [blocker signal];
+    }];
+
+    STAssertTrue([blocker waitWithTimeout:10], @"prewarm finished");
+    STAssertTrue(calledOnMainThread, @"handler called on the main thread");
+}
+
 @end
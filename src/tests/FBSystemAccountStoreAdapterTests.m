@@ -0,0 +1,108 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Accounts/Accounts.h>
+
+#import "FBSystemAccountStoreAdapter.h"
+#import "FBTests.h"
+
+@interface FBSystemAccountStoreAdapter (Testing)
+
+@property (retain, nonatomic, readonly) ACAccountStore *accountStore;
+@property (retain, nonatomic, readonly) ACAccountType *accountTypeFB;
+
+@end
+
+@interface FBSystemAccountStoreAdapterTests : FBTests
+@end
+
+@implementation FBSystemAccountStoreAdapterTests
+
+// An adapter whose account store has one account, and whose renew completion is handed to
+// `completion` rather than called
+- (FBSystemAccountStoreAdapter *)adapterWithRenewCompletion:(void (^*)(ACAccountCredentialRenewResult, NSError *))completion
+                                                  renewCount:(int *)renewCount {
+    id mockAccountType = [OCMockObject niceMockForClass:[ACAccountType class]];
+    [[[mockAccountType stub] andReturnValue:@YES] accessGranted];
+
+    id mockAccountStore = [OCMockObject niceMockForClass:[ACAccountStore class]];
+    [[[mockAccountStore stub] andReturn:@[ @"account" ]] accountsWithAccountType:[OCMArg any]];
+    [[[mockAccountStore stub] andDo:^(NSInvocation *invocation) {
+        void (^renewCompletion)(ACAccountCredentialRenewResult, NSError *);
+        [invocation getArgument:&renewCompletion atIndex:3];
+        *completion = [[renewCompletion copy] autorelease];
+        (*renewCount)++;
+    }] renewCredentialsForAccount:[OCMArg any] completion:[OCMArg any]];
+
+    FBSystemAccountStoreAdapter *adapter = [[[FBSystemAccountStoreAdapter alloc] init] autorelease];
+    id mockAdapter = [OCMockObject partialMockForObject:adapter];
+    [[[mockAdapter stub] andReturn:mockAccountStore] accountStore];
+    [[[mockAdapter stub] andReturn:mockAccountType] accountTypeFB];
+    return mockAdapter;
+}
+
+- (void)testConcurrentRenewsShareOneCall {
+    __block void (^completion)(ACAccountCredentialRenewResult, NSError *) = nil;
+    int renewCount = 0;
+    FBSystemAccountStoreAdapter *adapter = [self adapterWithRenewCompletion:&completion renewCount:&renewCount];
+
+    __block int handlerCount = 0;
+    for (int i = 0; i < 3; i++) {
+        [adapter renewSystemAuthorization:^(ACAccountCredentialRenewResult result, NSError *error) {
+            STAssertEquals(result, ACAccountCredentialRenewResultRenewed, @"every caller should get the shared result");
+            handlerCount++;
+        }];
+    }
+    STAssertEquals(renewCount, 1, @"only the first renew should reach the account store");
+    STAssertNotNil(completion, nil);
+
+    completion(ACAccountCredentialRenewResultRenewed, nil);
+    [self waitForMainQueueToFinish];
+    STAssertEquals(handlerCount, 3, nil);
+
+    // a renew right after that one completed is answered with its result
+    [adapter renewSystemAuthorization:^(ACAccountCredentialRenewResult result, NSError *error) {
+        handlerCount++;
+    }];
+    [self waitForMainQueueToFinish];
+    STAssertEquals(renewCount, 1, nil);
+    STAssertEquals(handlerCount, 4, nil);
+}
+
+- (void)testFailedRenewIsNotReused {
+    __block void (^completion)(ACAccountCredentialRenewResult, NSError *) = nil;
+    int renewCount = 0;
+    FBSystemAccountStoreAdapter *adapter = [self adapterWithRenewCompletion:&completion renewCount:&renewCount];
+
+    [adapter renewSystemAuthorization:nil];
+    completion(ACAccountCredentialRenewResultRejected, nil);
+    [self waitForMainQueueToFinish];
+
+    [adapter renewSystemAuthorization:nil];
+    STAssertEquals(renewCount, 2, @"a rejected renew should not answer the next request");
+    completion(ACAccountCredentialRenewResultFailed, [NSError errorWithDomain:ACErrorDomain code:ACErrorUnknown userInfo:nil]);
+    [self waitForMainQueueToFinish];
+
+    [adapter renewSystemAuthorization:nil];
+    STAssertEquals(renewCount, 3, @"a failed renew should not answer the next request");
+    completion(ACAccountCredentialRenewResultRenewed, nil);
+    [self waitForMainQueueToFinish];
+
+    [adapter renewSystemAuthorization:nil];
+    STAssertEquals(renewCount, 3, nil);
+}
+
+@end
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <SenTestingKit/SenTestingKit.h>
+#import <libkern/OSAtomic.h>
+
+#import "FBTask.h"
+#import "FBTaskCompletionSource.h"
+#import "FBTaskExecutor.h"
+
+@interface FBTaskTests : SenTestCase
+
+@end
+
+@implementation FBTaskTests
+
+- (void)waitForTask:(FBTask *)task {
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:5];
+    while (!task.isCompleted && [deadline timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                                 beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    STAssertTrue(task.isCompleted, @"task did not complete in time");
+}
+
+- (void)testContinuationsRunInOrderAdded {
+    FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
+    NSMutableArray *order = [NSMutableArray array];
+    for (int i = 0; i < 3; i++) {
+        [tcs.task dependentTaskWithBlock:^id(FBTask *task) {
+            [order addObject:@(i)];
+            return nil;
+        } executor:[FBTaskExecutor immediateExecutor]];
+    }
+    tcs.result = @"done";
+
+    STAssertEqualObjects(order, (@[@0, @1, @2]), nil);
+
+    __block BOOL ranImmediately = NO;
+    [tcs.task dependentTaskWithBlock:^id(FBTask *task) {
+        ranImmediately = YES;
+        return nil;
+    } executor:[FBTaskExecutor immediateExecutor]];
+    STAssertTrue(ranImmediately, @"continuation on a completed task should run right away");
+}
+
+- (void)testMainThreadExecutorRunsInlineOnMainThread {
+    __block BOOL ran = NO;
+    [[FBTaskExecutor mainThreadExecutor] execute:^{
+        ran = YES;
+    }];
+    STAssertTrue(ran, nil);
+
+    ran = NO;
+    [[FBTaskExecutor asyncExecutorWithDispatchQueue:dispatch_get_main_queue()] execute:^{
+        ran = YES;
+    }];
+    STAssertFalse(ran, @"the async executor should never run inline");
+}
+
+- (void)testAllTasksGathersResultsInOrder {
+    FBTaskCompletionSource *first = [FBTaskCompletionSource taskCompletionSource];
+    FBTaskCompletionSource *second = [FBTaskCompletionSource taskCompletionSource];
+    FBTask *all = [FBTask taskForCompletionOfAllTasks:@[first.task, second.task]];
+
+    second.result = @"b";
+    STAssertFalse(all.isCompleted, nil);
+    first.result = nil;
+
+    [self waitForTask:all];
+    STAssertEqualObjects(all.result, (@[[NSNull null], @"b"]), nil);
+}
+
+- (void)testAllTasksFailFastCancelsSiblings {
+    FBTaskCompletionSource *failing = [FBTaskCompletionSource taskCompletionSource];
+    FBTaskCompletionSource *slow = [FBTaskCompletionSource taskCompletionSource];
+    FBTask *all = [FBTask taskForCompletionOfAllTasks:@[slow.task, failing.task] failFast:YES];
+
+    NSError *error = [NSError errorWithDomain:@"test" code:1 userInfo:nil];
+    failing.error = error;
+
+    [self waitForTask:all];
+    STAssertEquals(all.error, error, nil);
+    STAssertTrue(slow.task.isCancelled, @"the remaining task should have been cancelled");
+    STAssertNoThrow(slow.result = @"late", @"a source of a cancelled task may still finish");
+}
+
+- (void)testAnyTaskTakesFirstSuccess {
+    FBTaskCompletionSource *failing = [FBTaskCompletionSource taskCompletionSource];
+    FBTaskCompletionSource *succeeding = [FBTaskCompletionSource taskCompletionSource];
+    FBTask *any = [FBTask taskForCompletionOfAnyTask:@[failing.task, succeeding.task]];
+
+    failing.error = [NSError errorWithDomain:@"test" code:1 userInfo:nil];
+    succeeding.result = @"winner";
+
+    [self waitForTask:any];
+    STAssertEqualObjects(any.result, @"winner", nil);
+}
+
+- (void)testQueueExecutorRunsInlineOnlyOnceOnItsQueue {
+    dispatch_queue_t queue = dispatch_queue_create("com.facebook.sdk.FBTaskTests", DISPATCH_QUEUE_SERIAL);
+    FBTaskExecutor *executor = [FBTaskExecutor executorWithDispatchQueue:queue];
+
+    __block BOOL ranInline = NO;
+    [executor execute:^{
+        ranInline = YES;
+    }];
+    STAssertFalse(ranInline, @"off the queue the block should be dispatched");
+
+    __block BOOL nestedRanInline = NO;
+    dispatch_sync(queue, ^{}); // let the first block finish
+    [executor execute:^{
+        [executor execute:^{
+            nestedRanInline = YES;
+        }];
+    }];
+    dispatch_sync(queue, ^{
+        STAssertTrue(nestedRanInline, @"a block dispatched by the executor should run nested blocks inline");
+    });
+
+    __block BOOL plainBlockRanInline = NO;
+    dispatch_sync(queue, ^{
+        [executor execute:^{
+            plainBlockRanInline = YES;
+        }];
+        STAssertFalse(plainBlockRanInline, @"only blocks the executor dispatched count as on its queue");
+    });
+    dispatch_sync(queue, ^{});
+    STAssertTrue(plainBlockRanInline, nil);
+
+    dispatch_release(queue);
+}
+
+- (void)testOnlyOneRacingOutcomeWins {
+    for (int round = 0; round < 100; round++) {
+        FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
+        __block int32_t winners = 0;
+        dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            BOOL won = (i % 2) ? [tcs trySetResult:@(i)] : [tcs trySetCancelled];
+            if (won) {
+                OSAtomicIncrement32(&winners);
+            }
+        });
+        STAssertEquals(1, winners, @"exactly one outcome should have been accepted");
+        STAssertTrue(tcs.task.isCompleted, nil);
+        STAssertTrue(tcs.task.isCancelled != (tcs.task.result != nil), @"the task should carry the winner's outcome only");
+    }
+}
+
+- (void)testContinuationsAddedWhileCompletingRunExactlyOnce {
+    for (int round = 0; round < 100; round++) {
+        FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
+        __block int32_t runs = 0;
+        dispatch_apply(16, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            if (i == 8) {
+                tcs.result = @"done";
+            }
+            [tcs.task dependentTaskWithBlock:^id(FBTask *task) {
+                OSAtomicIncrement32(&runs);
+                return nil;
+            } executor:[FBTaskExecutor immediateExecutor]];
+        });
+        STAssertEquals(16, runs, @"every continuation should run once, whether added before or after completion");
+    }
+}
+
+- (void)testContinuationMayAddContinuations {
+    FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
+    __block BOOL nestedRan = NO;
+    [tcs.task dependentTaskWithBlock:^id(FBTask *task) {
+        [task dependentTaskWithBlock:^id(FBTask *task) {
+            nestedRan = YES;
+            return nil;
+        } executor:[FBTaskExecutor immediateExecutor]];
+        return nil;
+    } executor:[FBTaskExecutor immediateExecutor]];
+    tcs.result = nil;
+
+    STAssertTrue(nestedRan, @"a continuation added from a continuation should run straight away");
+}
+
+- (void)testWaitingWakesWhenCompletedFromAnotherThread {
+    FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
+    FBTaskCompletionSource *waited = [FBTaskCompletionSource taskCompletionSource];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [tcs.task waitUntilFinished];
+        waited.result = tcs.task.result;
+    });
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 50 * NSEC_PER_MSEC),
+                   dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        tcs.result = @"done";
+    });
+
+    [self waitForTask:waited.task];
+    STAssertEqualObjects(waited.task.result, @"done", @"the waiter should see the outcome it was woken for");
+}
+
+- (void)testSettingAnOutcomeTwiceThrows {
+    FBTaskCompletionSource *tcs = [FBTaskCompletionSource taskCompletionSource];
+    tcs.result = @"first";
+    STAssertThrows(tcs.result = @"second", nil);
+    STAssertThrows(tcs.error = [NSError errorWithDomain:@"test" code:1 userInfo:nil], nil);
+    STAssertFalse([tcs trySetCancelled], nil);
+    STAssertEqualObjects(tcs.task.result, @"first", @"the first outcome should stand");
+}
+
+@end
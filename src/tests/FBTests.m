@@ -23,6 +23,7 @@
 #import "FBRequestConnection.h"
 #import "FBSessionTokenCachingStrategy.h"
 #import "FBTestBlocker.h"
+#import "FBURLSessionTransport.h"
 #import "FBUtility.h"
 
 NSString *kTestToken = @"This is a token";
@@ -30,9 +31,17 @@ NSString *kTestAppId = @"AnAppId";
 
 @implementation FBTests
 
+- (void)setUp
+{
+    [super setUp];
+    // The HTTP stubs only see NSURLConnection traffic
+    [FBURLSessionTransport setEnabled:NO];
+}
+
 - (void)tearDown
 {
     [OHHTTPStubs removeAllRequestHandlers];
+    [FBURLSessionTransport setEnabled:YES];
     [super tearDown];
 }
 
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import "FBTooltipView.h"
+
+@interface FBTooltipViewTests : SenTestCase
+@end
+
+@implementation FBTooltipViewTests
+
+- (NSData *)renderTooltip:(FBTooltipView *)tooltip
+{
+    UIGraphicsBeginImageContextWithOptions(tooltip.bounds.size, NO, tooltip.contentScaleFactor);
+    [tooltip drawRect:tooltip.bounds];
+    UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+    return UIImagePNGRepresentation(image);
+}
+
+- (void)testCachedBubbleFollowsTheColorStyle
+{
+    UIView *hostView = [[[UIView alloc] initWithFrame:CGRectMake(0, 0, 320, 480)] autorelease];
+    FBTooltipView *tooltip = [[[FBTooltipView alloc] initWithTagline:@"Tagline"
+                                                             message:@"A message long enough to wrap onto a second line"
+                                                          colorStyle:FBTooltipColorStyleFriendlyBlue] autorelease];
+    [tooltip presentInView:hostView withArrowPosition:CGPointMake(160, 100) direction:FBTooltipViewArrowDirectionUp];
+
+    NSData *blue = [self renderTooltip:tooltip];
+    tooltip.colorStyle = FBTooltipColorStyleNeutralGray;
+    NSData *gray = [self renderTooltip:tooltip];
+    tooltip.colorStyle = FBTooltipColorStyleFriendlyBlue;
+    NSData *blueAgain = [self renderTooltip:tooltip];
+
+    STAssertNotNil(blue, @"the tooltip was not drawn");
+    STAssertFalse([blue isEqualToData:gray], @"a new color style should not reuse the old bubble");
+    STAssertEqualObjects(blueAgain, blue, @"the same style should draw the same bubble");
+    [tooltip dismiss];
+}
+
+- (void)testCachedBubbleFollowsTheArrowDirection
+{
+    UIView *hostView = [[[UIView alloc] initWithFrame:CGRectMake(0, 0, 320, 480)] autorelease];
+    FBTooltipView *tooltip = [[[FBTooltipView alloc] initWithTagline:nil
+                                                             message:@"Message"
+                                                          colorStyle:FBTooltipColorStyleFriendlyBlue] autorelease];
+    [tooltip presentInView:hostView withArrowPosition:CGPointMake(160, 100) direction:FBTooltipViewArrowDirectionUp];
+    NSData *up = [self renderTooltip:tooltip];
+    [tooltip presentInView:hostView withArrowPosition:CGPointMake(160, 300) direction:FBTooltipViewArrowDirectionDown];
+    NSData *down = [self renderTooltip:tooltip];
+
+    STAssertFalse([up isEqualToData:down], @"pointing the other way should not reuse the old bubble");
+    [tooltip dismiss];
+}
+
+@end
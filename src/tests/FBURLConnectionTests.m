@@ -19,6 +19,9 @@
 #import "FBTestBlocker.h"
 #import "FBDataDiskCache.h"
 #import "FBError.h"
+#import "FBRequestRetryPolicy.h"
+#import "FBSettings.h"
+#import "FBURLSessionTransport.h"
 
 #import <OHHTTPStubs/OHHTTPStubs.h>
 
@@ -33,6 +36,7 @@
 - (FBDataDiskCache *)getCache;
 - (BOOL)shouldShortCircuitRedirectResponse:(NSURLResponse *)redirectResponse;
 - (void)logMessage:(NSString *)message;
++ (void)noteCDNHost:(NSString *)host;
 
 @end
 
@@ -366,7 +370,7 @@
     [request release];
 }
 
-- (void)testWithCachedURLCallsHandlerImmediately {
+- (void)testWithCachedURLCallsHandlerWithoutRoundtrip {
     [self setupHTTPStubWithStatus:200 andString:@"Hello World" delayed:0];
 
     NSURLRequest *request = [self newRequest];
@@ -381,6 +385,31 @@
                                                                  completionHandler:_handler
                                                                      dataDiskCache:mockDataDiskCache];
 
+    [_blocker waitWithTimeout:0.2];
+
+    assertThatBool(_handlerCalled, equalToBool(YES));
+
+    [connection release];
+    [request release];
+}
+
+- (void)testCachedLookupDoesNotCallHandlerFromInit {
+    NSURLRequest *request = [self newRequest];
+
+    [self setHandlerExpectingStatus:0 andString:@"Hello World"];
+
+    id mockDataDiskCache = [self createMockDiskCacheReturning:@"Hello World"
+                                                       forURL:@"http://www.example.com"];
+
+    TestFBURLConnection *connection = [[TestFBURLConnection alloc] initWithRequest:request
+                                                             skipRoundTripIfCached:YES
+                                                                 completionHandler:_handler
+                                                                     dataDiskCache:mockDataDiskCache];
+
+    assertThatBool(_handlerCalled, equalToBool(NO));
+
+    [_blocker waitWithTimeout:0.2];
+
     assertThatBool(_handlerCalled, equalToBool(YES));
 
     [connection release];
@@ -459,11 +488,88 @@
     [_blocker waitWithTimeout:.2];
 
     [mockDataDiskCache verify];
+    assertThat([[NSUserDefaults standardUserDefaults] stringForKey:@"com.facebook.sdk:FBURLConnectionLastCDNHost"],
+               equalTo(@"www.akamaihd.net"));
 
     [connection release];
     [request release];
 }
 
+- (void)testPrewarmingWaitsForTheSettingAndIncludesTheLastCDNHost {
+    id mockTransport = [OCMockObject mockForClass:[FBURLSessionTransport class]];
+    id mockTransportClass = [OCMockObject mockForClass:[FBURLSessionTransport class]];
+    [[[mockTransportClass stub] andReturn:mockTransport] sharedTransport];
+    BOOL yes = YES;
+    [[[mockTransportClass stub] andReturnValue:OCMOCK_VALUE(yes)] isEnabled];
+
+    // off by default, so the strict mock sees nothing
+    [FBURLConnection prewarmConnections];
+
+    [FBURLConnection noteCDNHost:@"scontent-a.xx.fbcdn.net"];
+    [[mockTransport expect] prewarmConnectionsToHosts:@[@"graph.facebook.com", @"scontent-a.xx.fbcdn.net"]];
+    [FBSettings enableConnectionPrewarming:YES];
+    [FBURLConnection prewarmConnections];
+    [mockTransport verify];
+
+    [FBSettings enableConnectionPrewarming:NO];
+    [[NSUserDefaults standardUserDefaults] removeObjectForKey:@"com.facebook.sdk:FBURLConnectionLastCDNHost"];
+}
+
+- (void)testPrewarmSkipsHostsPrewarmedWithinAMinute {
+    FBURLSessionTransport *transport = [[[FBURLSessionTransport alloc] init] autorelease];
+    [(NSURLSession *)[transport valueForKey:@"_session"] invalidateAndCancel];
+
+    NSMutableArray *requests = [NSMutableArray array];
+    id mockSession = [OCMockObject niceMockForClass:[NSURLSession class]];
+    [[[mockSession stub] andDo:^(NSInvocation *invocation) {
+        NSURLRequest *request = nil;
+        [invocation getArgument:&request atIndex:2];
+        [requests addObject:request];
+        id task = [OCMockObject niceMockForClass:[NSURLSessionDataTask class]];
+        [invocation setReturnValue:&task];
+    }] dataTaskWithRequest:OCMOCK_ANY];
+    [transport setValue:mockSession forKey:@"_session"];
+
+    [transport prewarmConnectionsToHosts:@[@"graph.facebook.com", @"scontent-a.xx.fbcdn.net"]];
+    [transport prewarmConnectionsToHosts:@[@"graph.facebook.com", @"scontent-b.xx.fbcdn.net"]];
+
+    assertThat([requests valueForKeyPath:@"URL.absoluteString"],
+               equalTo(@[@"https://graph.facebook.com/", @"https://scontent-a.xx.fbcdn.net/", @"https://scontent-b.xx.fbcdn.net/"]));
+    assertThat([requests valueForKey:@"HTTPMethod"], equalTo(@[@"HEAD", @"HEAD", @"HEAD"]));
+}
+
+- (void)testSessionRedirectStoppedByTheDelegateIsNotReportedAgain {
+    FBURLSessionTransport *transport = [[[FBURLSessionTransport alloc] init] autorelease];
+    [(NSURLSession *)[transport valueForKey:@"_session"] invalidateAndCancel];
+
+    NSUInteger taskIdentifier = 7;
+    id task = [OCMockObject niceMockForClass:[NSURLSessionDataTask class]];
+    [[[task stub] andReturnValue:OCMOCK_VALUE(taskIdentifier)] taskIdentifier];
+    [[task expect] cancel];
+    id mockSession = [OCMockObject niceMockForClass:[NSURLSession class]];
+    [[[mockSession stub] andReturn:task] dataTaskWithRequest:OCMOCK_ANY];
+    [transport setValue:mockSession forKey:@"_session"];
+
+    // Strict, so a didFailWithError: for the cancellation fails the test
+    id delegate = [OCMockObject mockForProtocol:@protocol(NSURLConnectionDataDelegate)];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[NSURL URLWithString:@"https://graph.facebook.com/me"]];
+    [[[delegate expect] andReturn:nil] connection:nil willSendRequest:request redirectResponse:OCMOCK_ANY];
+    [transport startTaskWithRequest:request delegate:delegate];
+
+    __block BOOL completionCalled = NO;
+    [transport URLSession:mockSession task:task willPerformHTTPRedirection:nil newRequest:request completionHandler:^(NSURLRequest *newRequest) {
+        STAssertNil(newRequest, @"redirect not followed");
+        completionCalled = YES;
+    }];
+    [transport URLSession:mockSession
+                     task:task
+     didCompleteWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+
+    STAssertTrue(completionCalled, nil);
+    [task verify];
+    [delegate verify];
+}
+
 - (void)testRedirectResponsesSucceed {
     [self setupHTTPStubWithStatus:200 andString:@"Hello World" delayed:0];
 
@@ -508,6 +614,86 @@
     [request release];
 }
 
+- (void)testTransientFailureIsRetriedAndHandlerCalledOnce {
+    __block int attempts = 0;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        attempts++;
+        return [OHHTTPStubsResponse responseWithData:[@"Hello World" dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:(attempts == 1 ? 503 : 200)
+                                        responseTime:0
+                                             headers:nil];
+    }];
+
+    FBRequestRetryPolicy *policy = [[[FBRequestRetryPolicy alloc] init] autorelease];
+    policy.maximumRetryCount = 2;
+    policy.initialBackoff = 0;
+    __block int handlerCalls = 0;
+    NSURLRequest *request = [self newRequest];
+    FBURLConnection *connection = [[FBURLConnection alloc] initWithRequest:request
+                                                     skipRoundTripIfCached:NO
+                                                               retryPolicy:policy
+                                                         completionHandler:^(FBURLConnection *innerConnection, NSError *error, NSURLResponse *response, NSData *responseData) {
+        handlerCalls++;
+        assertThatInteger([(NSHTTPURLResponse *)response statusCode], equalToInteger(200));
+        [_blocker signal];
+    }];
+
+    assertThatBool([_blocker waitWithTimeout:1], equalToBool(YES));
+    // Give a second handler call the chance to happen, if there were going to be one
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    assertThatInt(attempts, equalToInt(2));
+    assertThatInt(handlerCalls, equalToInt(1));
+
+    [connection release];
+    [request release];
+}
+
+- (void)testOpenCircuitFailsWithoutSendingRequest {
+    __block int attempts = 0;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        attempts++;
+        return [OHHTTPStubsResponse responseWithData:nil statusCode:503 responseTime:0 headers:nil];
+    }];
+
+    FBRequestRetryPolicy *policy = [[[FBRequestRetryPolicy alloc] init] autorelease];
+    policy.maximumRetryCount = 3;
+    policy.circuitBreakerFailureThreshold = 1;
+    policy.circuitBreakerResetInterval = 60;
+    NSURLRequest *request = [self newRequest];
+
+    // The first failure opens the circuit, so it is not retried
+    FBURLConnection *first = [[FBURLConnection alloc] initWithRequest:request
+                                                skipRoundTripIfCached:NO
+                                                          retryPolicy:policy
+                                                    completionHandler:^(FBURLConnection *innerConnection, NSError *error, NSURLResponse *response, NSData *responseData) {
+        [_blocker signal];
+    }];
+    assertThatBool([_blocker waitWithTimeout:1], equalToBool(YES));
+    assertThatInt(attempts, equalToInt(1));
+
+    FBTestBlocker *rejectedBlocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block NSError *rejection = nil;
+    FBURLConnection *second = [[FBURLConnection alloc] initWithRequest:request
+                                                 skipRoundTripIfCached:NO
+                                                           retryPolicy:policy
+                                                     completionHandler:^(FBURLConnection *innerConnection, NSError *error, NSURLResponse *response, NSData *responseData) {
+        rejection = [error retain];
+        [rejectedBlocker signal];
+    }];
+    assertThatBool([rejectedBlocker waitWithTimeout:1], equalToBool(YES));
+    assertThatInteger(rejection.code, equalToInteger(FBErrorServiceUnavailable));
+    assertThatInt(attempts, equalToInt(1));
+
+    [rejection release];
+    [first release];
+    [second release];
+    [request release];
+}
+
 
 #pragma mark Helpers
 
@@ -599,10 +785,23 @@
 
     id mockDataDiskCache = [OCMockObject mockForClass:[FBDataDiskCache class]];
     [[[mockDataDiskCache stub] andReturn:data] dataForURL:[NSURL URLWithString:url]];
+    [self stubMockDiskCache:mockDataDiskCache asyncLookupReturning:data forURL:url];
 
     return mockDataDiskCache;
 }
 
+- (void)stubMockDiskCache:(id)mockDataDiskCache asyncLookupReturning:(NSData *)data forURL:(NSString *)url {
+    [[[mockDataDiskCache stub] andDo:^(NSInvocation *invocation) {
+        // Like the real cache, always complete asynchronously on the main thread
+        FBDataDiskCacheCompletionHandler completion = nil;
+        [invocation getArgument:&completion atIndex:3];
+        completion = [[completion copy] autorelease];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(data);
+        });
+    }] dataForURL:[NSURL URLWithString:url] completion:[OCMArg any]];
+}
+
 - (FBDataDiskCache *)createMockDiskCacheExpecting:(NSString *)string forURL:(NSString *)url {
     NSData *data = nil;
     if (string != nil) {
@@ -611,6 +810,7 @@
 
     id mockDataDiskCache = [OCMockObject mockForClass:[FBDataDiskCache class]];
     [[[mockDataDiskCache stub] andReturn:nil] dataForURL:[NSURL URLWithString:url]];
+    [self stubMockDiskCache:mockDataDiskCache asyncLookupReturning:nil forURL:url];
     [[mockDataDiskCache expect] setData:data forURL:[NSURL URLWithString:url]];
     
     return mockDataDiskCache;
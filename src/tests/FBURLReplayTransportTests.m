@@ -0,0 +1,186 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "FBTests.h"
+#import "FBTestBlocker.h"
+#import "FBURLReplayTransport.h"
+
+// Collects the callbacks a replayed request makes
+@interface FBURLReplayTestDelegate : NSObject
+
+@property (nonatomic, retain) FBTestBlocker *blocker;
+@property (nonatomic, retain) NSHTTPURLResponse *response;
+@property (nonatomic, retain) NSMutableArray *slices;
+@property (nonatomic, retain) NSError *error;
+@property (nonatomic) BOOL finished;
+
+@end
+
+@implementation FBURLReplayTestDelegate
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _blocker = [[FBTestBlocker alloc] init];
+        _slices = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_blocker release];
+    [_response release];
+    [_slices release];
+    [_error release];
+    [super dealloc];
+}
+
+- (void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)response {
+    self.response = (NSHTTPURLResponse *)response;
+}
+
+- (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data {
+    [self.slices addObject:data];
+}
+
+- (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error {
+    self.error = error;
+    [self.blocker signal];
+}
+
+- (void)connectionDidFinishLoading:(NSURLConnection *)connection {
+    self.finished = YES;
+    [self.blocker signal];
+}
+
+- (NSString *)body {
+    NSMutableData *body = [NSMutableData data];
+    for (NSData *slice in self.slices) {
+        [body appendData:slice];
+    }
+    return [[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding] autorelease];
+}
+
+@end
+
+@interface FBURLReplayTransportTests : FBTests
+@end
+
+@implementation FBURLReplayTransportTests
+{
+    NSString *_directory;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    _directory = [[NSTemporaryDirectory() stringByAppendingPathComponent:
+                   [NSString stringWithFormat:@"FBURLReplayTransportTests-%u", arc4random()]] retain];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:_directory error:NULL];
+    [_directory release];
+    _directory = nil;
+    [super tearDown];
+}
+
+- (NSURLRequest *)requestForURLString:(NSString *)URLString
+{
+    return [NSURLRequest requestWithURL:[NSURL URLWithString:URLString]];
+}
+
+- (void)recordBody:(NSString *)body forURLString:(NSString *)URLString inTransport:(FBURLReplayTransport *)transport
+{
+    NSURL *url = [NSURL URLWithString:URLString];
+    NSHTTPURLResponse *response = [[[NSHTTPURLResponse alloc] initWithURL:url
+                                                               statusCode:200
+                                                              HTTPVersion:@"HTTP/1.1"
+                                                             headerFields:@{}] autorelease];
+    [transport recordResponse:response
+                         data:[body dataUsingEncoding:NSUTF8StringEncoding]
+                   forRequest:[self requestForURLString:URLString]];
+}
+
+- (FBURLReplayTestDelegate *)replayURLString:(NSString *)URLString withTransport:(FBURLReplayTransport *)transport
+{
+    FBURLReplayTestDelegate *delegate = [[[FBURLReplayTestDelegate alloc] init] autorelease];
+    [transport startWithRequest:[self requestForURLString:URLString] delegate:delegate];
+    STAssertTrue([delegate.blocker waitWithTimeout:2], @"replay did not complete");
+    return delegate;
+}
+
+- (void)testMatchingIgnoresTheTokenAndQueryOrder
+{
+    FBURLReplayTransport *recorder = [[[FBURLReplayTransport alloc] initWithDirectory:_directory
+                                                                                 mode:FBURLReplayTransportModeRecord] autorelease];
+    [self recordBody:@"first" forURLString:@"https://graph.facebook.com/me?a=1&b=2&access_token=old" inTransport:recorder];
+    [self recordBody:@"second" forURLString:@"https://graph.facebook.com/me?b=2&a=1" inTransport:recorder];
+
+    // A new transport reads the recordings back from the directory
+    FBURLReplayTransport *transport = [[[FBURLReplayTransport alloc] initWithDirectory:_directory
+                                                                                  mode:FBURLReplayTransportModeReplay] autorelease];
+    NSString *URLString = @"https://graph.facebook.com/me?access_token=new&b=2&a=1";
+    STAssertEqualObjects([[self replayURLString:URLString withTransport:transport] body], @"first", nil);
+    STAssertEqualObjects([[self replayURLString:URLString withTransport:transport] body], @"second", nil);
+    // The last recording repeats
+    STAssertEqualObjects([[self replayURLString:URLString withTransport:transport] body], @"second", nil);
+    STAssertEquals(transport.replayedCount, (NSUInteger)3, nil);
+}
+
+- (void)testUnmatchedRequestFailsAsOffline
+{
+    FBURLReplayTransport *transport = [[[FBURLReplayTransport alloc] initWithDirectory:_directory
+                                                                                  mode:FBURLReplayTransportModeReplay] autorelease];
+    FBURLReplayTestDelegate *delegate = [self replayURLString:@"https://graph.facebook.com/unknown" withTransport:transport];
+
+    STAssertEquals(delegate.error.code, (NSInteger)NSURLErrorNotConnectedToInternet, nil);
+    STAssertFalse(delegate.finished, nil);
+    STAssertEquals(transport.missedCount, (NSUInteger)1, nil);
+    STAssertEquals(transport.replayedCount, (NSUInteger)0, nil);
+}
+
+- (void)testBandwidthLimitDeliversTheBodyInSlices
+{
+    FBURLReplayTransport *transport = [[[FBURLReplayTransport alloc] initWithDirectory:_directory
+                                                                                  mode:FBURLReplayTransportModeReplay] autorelease];
+    NSString *URLString = @"https://graph.facebook.com/me";
+    [self recordBody:@"0123456789" forURLString:URLString inTransport:transport];
+    // 3 bytes per 10ms slice
+    transport.bytesPerSecond = 300;
+
+    FBURLReplayTestDelegate *delegate = [self replayURLString:URLString withTransport:transport];
+    STAssertEquals(delegate.response.statusCode, (NSInteger)200, nil);
+    STAssertEquals(delegate.slices.count, (NSUInteger)4, nil);
+    STAssertEqualObjects([delegate body], @"0123456789", nil);
+}
+
+- (void)testCancelledReplayMakesNoCallbacks
+{
+    FBURLReplayTransport *transport = [[[FBURLReplayTransport alloc] initWithDirectory:_directory
+                                                                                  mode:FBURLReplayTransportModeReplay] autorelease];
+    NSString *URLString = @"https://graph.facebook.com/me";
+    [self recordBody:@"body" forURLString:URLString inTransport:transport];
+    transport.latency = 0.05;
+
+    FBURLReplayTestDelegate *delegate = [[[FBURLReplayTestDelegate alloc] init] autorelease];
+    [[transport startWithRequest:[self requestForURLString:URLString] delegate:delegate] cancel];
+
+    STAssertFalse([delegate.blocker waitWithTimeout:0.2], @"a cancelled replay should not complete");
+    STAssertNil(delegate.response, nil);
+}
+
+@end
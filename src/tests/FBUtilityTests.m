@@ -21,6 +21,10 @@
 #define FB_BUILD_ONLY
 #endif
 
+#import "FBBase64.h"
+#import "FBMetrics.h"
+#import "FBSettings.h"
+#import "FBTestBlocker.h"
 #import "FBUtility.h"
 
 #ifdef FB_BUILD_ONLY
@@ -81,4 +85,251 @@
 
 }
 
+- (void)testCachedUrlPrefixFollowsDomainPart
+{
+    assertThat([FBUtility facebookURLPrefixWithPre:@"https://graph." version:@"v9.9"],
+               equalTo(@"https://graph.facebook.com/v9.9"));
+    assertThat([FBUtility facebookURLPrefixWithPre:@"https://graph." version:@""],
+               equalTo(@"https://graph.facebook.com"));
+
+    [FBSettings setFacebookDomainPart:@"beta"];
+    @try {
+        assertThat([FBUtility facebookURLPrefixWithPre:@"https://graph." version:@"v9.9"],
+                   equalTo(@"https://graph.beta.facebook.com/v9.9"));
+    } @finally {
+        [FBSettings setFacebookDomainPart:nil];
+    }
+    assertThat([FBUtility facebookURLPrefixWithPre:@"https://graph." version:@"v9.9"],
+               equalTo(@"https://graph.facebook.com/v9.9"));
+}
+
+- (void)testAppendURLEncodedStringMatchesStringEncoding
+{
+    NSArray *strings = @[@"plain", @"a b&c=d", @"100% [done]+more?", @"caf\u00e9 \u2019quoted\u2019", @"-_.~"];
+    for (NSString *string in strings) {
+        NSMutableData *data = [NSMutableData dataWithBytes:"x=" length:2];
+        [FBUtility appendURLEncodedString:string toData:data];
+        NSString *appended = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+        assertThat(appended, equalTo([@"x=" stringByAppendingString:[FBUtility stringByURLEncodingString:string]]));
+    }
+}
+
+- (void)testAppendSerializedQueryParametersEscapesDataAsItsString
+{
+    NSString *json = @"{\"a\":\"b c&d\"}";
+    NSMutableData *data = [NSMutableData dataWithBytes:"x?" length:2];
+    [FBUtility appendSerializedQueryParameters:@{@"args" : [json dataUsingEncoding:NSUTF8StringEncoding]} toData:data];
+    NSString *appended = [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+    // no separator before the first parameter, even though data isn't empty
+    assertThat(appended, equalTo([@"x?args=" stringByAppendingString:[FBUtility stringByURLEncodingString:json]]));
+}
+
+- (void)testURLEncodingRoundTrips
+{
+    NSArray *strings = @[@"AbCdEfGhIjKlMnOpQrStUvWxYz0123456789", @"AbCdEfGhIjKlMnOp QrStUvWxYz/0123456789", @"caf\u00e9"];
+    for (NSString *string in strings) {
+        NSString *encoded = [FBUtility stringByURLEncodingString:string];
+        assertThat([FBUtility stringByURLDecodingString:encoded], equalTo(string));
+    }
+    assertThat([FBUtility stringByURLEncodingString:@"AbCdEfGhIjKlMnOp QrSt"], equalTo(@"AbCdEfGhIjKlMnOp%20QrSt"));
+
+    assertThat([FBUtility stringBySerializingQueryParameters:@{@"q" : @"a b", @"limit" : @5}],
+               anyOf(equalTo(@"q=a%20b&limit=5"), equalTo(@"limit=5&q=a%20b"), nil));
+    assertThat([FBUtility stringBySerializingQueryParameters:nil], equalTo(@""));
+}
+
+- (void)testBase64RoundTrips
+{
+    // long enough for whole vector blocks plus every length of tail
+    for (NSUInteger length = 0; length < 200; length++) {
+        NSMutableData *data = [NSMutableData dataWithLength:length];
+        unsigned char *bytes = data.mutableBytes;
+        for (NSUInteger i = 0; i < length; i++) {
+            bytes[i] = (unsigned char)(i * 37 + 11);
+        }
+        NSString *encoded = FBEncodeBase64(data);
+        assertThatUnsignedInteger(encoded.length, equalToUnsignedInteger(FBEncodeBase64Length(length)));
+        assertThat(FBDecodeBase64(encoded), equalTo(data));
+    }
+    assertThat(FBEncodeBase64([@"Man" dataUsingEncoding:NSASCIIStringEncoding]), equalTo(@"TWFu"));
+    assertThat(FBDecodeBase64(@"TW Fu"), equalTo([@"Man" dataUsingEncoding:NSASCIIStringEncoding]));
+}
+
+- (void)testGzipData
+{
+    NSMutableString *json = [NSMutableString stringWithString:@"["];
+    for (int i = 0; i < 500; i++) {
+        [json appendFormat:@"{\"_eventName\":\"fb_mobile_activate_app\",\"_logTime\":%d},", i];
+    }
+    NSData *data = [json dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSData *compressed = [FBUtility gzipData:data];
+
+    assertThat(compressed, notNilValue());
+    assertThatBool(compressed.length < data.length / 4, equalToBool(YES));
+    // The gzip magic number
+    const unsigned char *bytes = compressed.bytes;
+    assertThatInt(bytes[0], equalToInt(0x1f));
+    assertThatInt(bytes[1], equalToInt(0x8b));
+
+    assertThat([FBUtility gunzipData:compressed], equalTo(data));
+    assertThat([FBUtility gunzipData:[compressed subdataWithRange:NSMakeRange(0, compressed.length / 2)]], nilValue());
+}
+
+- (void)testJPEGDataForImagesKeepsOrderAndMarksFailures
+{
+    NSMutableArray *images = [NSMutableArray array];
+    for (CGFloat width = 10; width <= 40; width += 10) {
+        UIGraphicsBeginImageContextWithOptions(CGSizeMake(width, 10), YES, 1);
+        [images addObject:UIGraphicsGetImageFromCurrentImageContext()];
+        UIGraphicsEndImageContext();
+    }
+    // Has no bitmap, so can't be encoded
+    [images insertObject:[[[UIImage alloc] init] autorelease] atIndex:2];
+
+    NSArray *imageData = [FBUtility JPEGDataForImages:images];
+    assertThatUnsignedInteger(imageData.count, equalToUnsignedInteger(images.count));
+    assertThat(imageData[2], equalTo([NSNull null]));
+    assertThatFloat([UIImage imageWithData:imageData[0]].size.width, equalToFloat(10));
+    assertThatFloat([UIImage imageWithData:imageData[4]].size.width, equalToFloat(40));
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    __block BOOL calledBackOnMainThread = NO;
+    __block NSUInteger asyncCount = 0;
+    [FBUtility JPEGDataForImages:images completion:^(NSArray *asyncImageData) {
+        calledBackOnMainThread = [NSThread isMainThread];
+        asyncCount = asyncImageData.count;
+        [blocker signal];
+    }];
+    assertThatBool([blocker waitWithTimeout:5], equalToBool(YES));
+    assertThatBool(calledBackOnMainThread, equalToBool(YES));
+    assertThatUnsignedInteger(asyncCount, equalToUnsignedInteger(images.count));
+}
+
+- (void)testJPEGDataForUploadImageScalesDownToMaximumDimension
+{
+    UIGraphicsBeginImageContextWithOptions(CGSizeMake(400, 100), YES, 1);
+    [[UIColor redColor] setFill];
+    UIRectFill(CGRectMake(0, 0, 400, 100));
+    UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+
+    [FBSettings setMaximumUploadImageDimension:200];
+    UIImage *scaled = [UIImage imageWithData:[FBUtility JPEGDataForUploadImage:image]];
+    [FBSettings setMaximumUploadImageDimension:0];
+    UIImage *full = [UIImage imageWithData:[FBUtility JPEGDataForUploadImage:image]];
+
+    assertThatFloat(scaled.size.width, equalToFloat(200));
+    assertThatFloat(scaled.size.height, equalToFloat(50));
+    assertThatFloat(full.size.width, equalToFloat(400));
+}
+
+- (void)testMetricsHistogramsAndSpans
+{
+    FBMetrics *metrics = [[[FBMetrics alloc] init] autorelease];
+    [metrics recordValue:0.5 forMetric:FBMetricBytesSent];
+    [metrics recordValue:3 forMetric:FBMetricBytesSent];
+    [metrics incrementCounter:FBMetricCacheHits by:3];
+    [metrics incrementCounter:FBMetricCacheMisses by:1];
+
+    NSDictionary *sent = [[metrics snapshot] objectForKey:FBMetricBytesSent];
+    assertThat([sent objectForKey:FBMetricCountKey], equalToInt(2));
+    assertThat([sent objectForKey:FBMetricMaxKey], equalToDouble(3));
+    NSArray *buckets = [sent objectForKey:FBMetricBucketsKey];
+    assertThat([buckets objectAtIndex:0], equalToInt(1));
+    assertThat([buckets objectAtIndex:2], equalToInt(1));
+    assertThatDouble(metrics.cacheHitRate, equalToDouble(0.75));
+
+    NSObject *tag = [[[NSObject alloc] init] autorelease];
+    [metrics beginSpanForTag:tag];
+    assertThatInt(metrics.openSpanCount, equalToInt(1));
+    double elapsed = -1;
+    assertThatBool([metrics endSpanForTag:tag metric:FBMetricRequestLatency elapsedMilliseconds:&elapsed], equalToBool(YES));
+    assertThatBool(elapsed >= 0, equalToBool(YES));
+    assertThatBool([metrics endSpanForTag:tag metric:nil elapsedMilliseconds:NULL], equalToBool(NO));
+    assertThatInt(metrics.openSpanCount, equalToInt(0));
+}
+
+- (void)testMetricsPercentileEstimates
+{
+    FBMetrics *metrics = [[[FBMetrics alloc] init] autorelease];
+    NSUInteger sampleCount = 1;
+    assertThatDouble([metrics estimatedPercentile:50 forMetric:FBMetricRequestLatency sampleCount:&sampleCount], equalToDouble(0));
+    assertThatInt(sampleCount, equalToInt(0));
+
+    for (int i = 0; i < 90; i++) {
+        [metrics recordValue:100 forMetric:FBMetricRequestLatency];
+    }
+    for (int i = 0; i < 10; i++) {
+        [metrics recordValue:1000 forMetric:FBMetricRequestLatency];
+    }
+    // Clamped to the minimum within the [64, 128) bucket
+    assertThatDouble([metrics estimatedPercentile:50 forMetric:FBMetricRequestLatency sampleCount:&sampleCount], equalToDouble(100));
+    assertThatInt(sampleCount, equalToInt(100));
+    // Half way through the [512, 1024) bucket
+    assertThatDouble([metrics estimatedPercentile:95 forMetric:FBMetricRequestLatency sampleCount:NULL], equalToDouble(768));
+    assertThatDouble([metrics estimatedPercentile:100 forMetric:FBMetricRequestLatency sampleCount:NULL], equalToDouble(1000));
+}
+
+- (void)testAllocationSampleRecordsPeakHeapGrowth
+{
+    FBMetrics *metrics = [[[FBMetrics alloc] init] autorelease];
+    FBMetricsAllocationSample sample;
+    [metrics beginAllocationSample:&sample];
+
+    void *block = malloc(1024 * 1024);
+    memset(block, 1, 1024 * 1024);
+    [metrics updateAllocationSample:&sample];
+    free(block);
+    [metrics endAllocationSample:&sample metric:FBMetricBatchEncodingPeakBytes];
+
+    NSDictionary *peak = [[metrics snapshot] objectForKey:FBMetricBatchEncodingPeakBytes];
+    assertThat([peak objectForKey:FBMetricCountKey], equalToInt(1));
+    assertThatBool([[peak objectForKey:FBMetricMaxKey] doubleValue] >= 1024 * 1024, equalToBool(YES));
+}
+
+- (void)testNetworkUsageAccountedByFeature
+{
+    FBMetrics *metrics = [[[FBMetrics alloc] init] autorelease];
+    [metrics recordBytesSent:100 bytesReceived:2000 forFeature:FBNetworkFeatureAppEvents];
+    [metrics recordBytesSent:50 bytesReceived:1000 forFeature:FBNetworkFeatureAppEvents];
+    [metrics recordBytesSent:10 bytesReceived:20 forFeature:nil];
+
+    NSDictionary *usage = [metrics networkUsageByFeature];
+    assertThatInt(usage.count, equalToInt(2));
+    NSDictionary *appEvents = [usage objectForKey:FBNetworkFeatureAppEvents];
+    assertThat([appEvents objectForKey:FBMetricCountKey], equalToInt(2));
+    assertThat([appEvents objectForKey:FBMetricBytesSent], equalToInt(150));
+    assertThat([appEvents objectForKey:FBMetricBytesReceived], equalToInt(3000));
+    assertThat([[usage objectForKey:FBNetworkFeatureOther] objectForKey:FBMetricBytesReceived], equalToInt(20));
+
+    [metrics reset];
+    assertThatInt([metrics networkUsageByFeature].count, equalToInt(0));
+}
+
+- (void)testQueryParamsParsedOnceWithinScopeAndForgottenAfter
+{
+    NSURL *url = [NSURL URLWithString:@"fb1234://authorize?state=abc#access_token=SECRET&expires_in=3600"];
+    NSDictionary *unscoped = [FBUtility queryParamsDictionaryFromFBURL:url];
+    assertThat(unscoped[@"access_token"], equalTo(@"SECRET"));
+
+    __block NSDictionary *first = nil;
+    __block NSDictionary *second = nil;
+    [FBUtility parseQueryParamsOnceForURL:url during:^{
+        first = [[FBUtility queryParamsDictionaryFromFBURL:url] retain];
+        [(NSMutableDictionary *)first removeObjectForKey:@"state"];
+        second = [[FBUtility queryParamsDictionaryFromFBURL:url] retain];
+    }];
+    assertThat(second, equalTo(unscoped));
+    STAssertTrue(first != second, @"each caller should get its own copy");
+    STAssertNil(first[@"state"], nil);
+    [first release];
+    [second release];
+
+    for (id value in [[[NSThread currentThread] threadDictionary] allValues]) {
+        STAssertFalse([[value description] rangeOfString:@"SECRET"].location != NSNotFound,
+                      @"the URL's parameters should not outlive the scope");
+    }
+}
+
 @end
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2010-present Facebook.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#import <OHHTTPStubs/OHHTTPStubs.h>
+
+#import "FBError.h"
+#import "FBRequestRetryPolicy.h"
+#import "FBTestBlocker.h"
+#import "FBTests.h"
+#import "FBUtility.h"
+#import "FBVideoUpload.h"
+
+@interface FBVideoUploadTests : FBTests
+@end
+
+@implementation FBVideoUploadTests
+{
+    NSString *_path;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    _path = [[NSTemporaryDirectory() stringByAppendingPathComponent:[[FBUtility newUUIDString] autorelease]] retain];
+    NSMutableData *video = [NSMutableData dataWithLength:3000];
+    [video writeToFile:_path atomically:YES];
+}
+
+- (void)tearDown
+{
+    [OHHTTPStubs removeAllRequestHandlers];
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+    [_path release];
+    _path = nil;
+    [super tearDown];
+}
+
+// Answers the start phase, then acknowledges 1000 byte chunks, then the finish phase, failing the
+// requests whose numbers are in failures with a 503
+- (NSMutableArray *)stubUploadFailingRequests:(NSIndexSet *)failures
+{
+    NSMutableArray *hosts = [NSMutableArray array];
+    __block NSUInteger requestNumber = 0;
+    __block unsigned long long offset = 0;
+    [OHHTTPStubs shouldStubRequestsPassingTest:^BOOL(NSURLRequest *request) {
+        return YES;
+    } withStubResponse:^OHHTTPStubsResponse *(NSURLRequest *request) {
+        [hosts addObject:request.URL.host];
+        if ([failures containsIndex:requestNumber++]) {
+            return [OHHTTPStubsResponse responseWithData:[NSData data] statusCode:503 responseTime:0 headers:nil];
+        }
+
+        NSString *json;
+        if (requestNumber == 1) {
+            json = @"{\"upload_session_id\":\"1\",\"video_id\":\"2\",\"start_offset\":\"0\",\"end_offset\":\"1000\"}";
+        } else if (offset < 3000) {
+            offset += 1000;
+            json = [NSString stringWithFormat:@"{\"start_offset\":\"%llu\",\"end_offset\":\"%llu\"}", offset, MIN(offset + 1000, 3000ULL)];
+        } else {
+            json = @"{\"success\":true}";
+        }
+        return [OHHTTPStubsResponse responseWithData:[json dataUsingEncoding:NSUTF8StringEncoding]
+                                          statusCode:200
+                                        responseTime:0
+                                             headers:nil];
+    }];
+    return hosts;
+}
+
+- (FBVideoUpload *)newUpload
+{
+    FBVideoUpload *upload = [[FBVideoUpload alloc] initWithSession:nil
+                                                         graphPath:@"me/videos"
+                                                           fileURL:[NSURL fileURLWithPath:_path]
+                                                        parameters:@{@"title" : @"test"}];
+    upload.retryPolicy.initialBackoff = 0.01;
+    return upload;
+}
+
+- (void)testUploadsInChunks
+{
+    NSMutableArray *hosts = [self stubUploadFailingRequests:nil];
+    FBVideoUpload *upload = [[self newUpload] autorelease];
+    NSMutableArray *progress = [NSMutableArray array];
+    upload.progressHandler = ^(FBVideoUpload *innerUpload, unsigned long long bytesUploaded, unsigned long long totalBytes) {
+        [progress addObject:@(bytesUploaded)];
+    };
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    [upload startWithCompletionHandler:^(FBVideoUpload *innerUpload, id<FBGraphObject> result, NSError *error) {
+        STAssertNil(error, @"unexpected error %@", error);
+        STAssertEqualObjects(@"2", result[@"video_id"], @"expected the video ID");
+        [blocker signal];
+    }];
+
+    STAssertTrue([blocker waitWithTimeout:5], @"timed out waiting for upload");
+    STAssertEqualObjects((@[@0, @1000, @2000, @3000]), progress, @"unexpected progress");
+    STAssertEquals(hosts.count, (NSUInteger)5, @"expected start, three chunks and finish");
+    STAssertTrue([hosts[0] hasPrefix:@"graph-video."], @"videos should be posted to graph-video");
+}
+
+- (void)testRetriesChunkAfterTransientFailure
+{
+    // The second chunk fails once
+    [self stubUploadFailingRequests:[NSIndexSet indexSetWithIndex:2]];
+    FBVideoUpload *upload = [[self newUpload] autorelease];
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    [upload startWithCompletionHandler:^(FBVideoUpload *innerUpload, id<FBGraphObject> result, NSError *error) {
+        STAssertNil(error, @"the chunk should have been sent again");
+        [blocker signal];
+    }];
+
+    STAssertTrue([blocker waitWithTimeout:5], @"timed out waiting for upload");
+    STAssertEquals(upload.bytesUploaded, (unsigned long long)3000, @"everything should be acknowledged");
+}
+
+- (void)testResumesFromLastAcknowledgedOffset
+{
+    [self stubUploadFailingRequests:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(2, 6)]];
+    FBVideoUpload *upload = [[self newUpload] autorelease];
+    upload.retryPolicy.maximumRetryCount = 2;
+
+    FBTestBlocker *blocker = [[[FBTestBlocker alloc] init] autorelease];
+    [upload startWithCompletionHandler:^(FBVideoUpload *innerUpload, id<FBGraphObject> result, NSError *error) {
+        STAssertNotNil(error, @"retries should have run out");
+        [blocker signal];
+    }];
+    STAssertTrue([blocker waitWithTimeout:5], @"timed out waiting for upload to fail");
+    STAssertEquals(upload.bytesUploaded, (unsigned long long)1000, @"only the first chunk should be acknowledged");
+    STAssertEqualObjects(@"1", upload.uploadSessionID, @"the upload session should be kept");
+
+    // Requests 2 to 7 fail; three attempts were used up above, and this run gets through after three more
+    upload.retryPolicy.maximumRetryCount = 5;
+    blocker = [[[FBTestBlocker alloc] init] autorelease];
+    [upload startWithCompletionHandler:^(FBVideoUpload *innerUpload, id<FBGraphObject> result, NSError *error) {
+        STAssertNil(error, @"unexpected error %@", error);
+        [blocker signal];
+    }];
+    STAssertTrue([blocker waitWithTimeout:5], @"timed out waiting for upload to resume");
+    STAssertEquals(upload.bytesUploaded, (unsigned long long)3000, @"everything should be acknowledged");
+}
+
+@end